@@ -0,0 +1,92 @@
+/**
+ * @file seqlock.h
+ * @brief Счетчик последовательности для чтения разделяемых данных без блокировки
+ * 
+ * Писатель увеличивает счетчик до и после изменения данных, поэтому во время
+ * записи счетчик нечетный. Читатель копирует данные и повторяет чтение, если
+ * счетчик был нечетным или изменился за время копирования. Писатели должны
+ * быть упорядочены между собой внешней блокировкой.
+ * 
+ * Заголовок общий для обеих прошивок (main/ и esp32-h2-zigbee-window/).
+ * 
+ * Пример чтения:
+ * @code
+ * uint32_t seq;
+ * do {
+ *     seq = seqlock_read_begin(&lock);
+ *     snapshot = shared;
+ * } while (seqlock_read_retry(&lock, seq));
+ * @endcode
+ */
+
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+/**
+ * @brief Счетчик последовательности
+ */
+typedef struct {
+    atomic_uint sequence;       ///< Четный - данные согласованы, нечетный - идет запись
+} seqlock_t;
+
+/**
+ * @brief Начальное значение счетчика
+ */
+#define SEQLOCK_INITIALIZER { .sequence = 0 }
+
+/**
+ * @brief Начало чтения
+ * 
+ * @param lock Счетчик последовательности
+ * @return uint32_t Значение счетчика для передачи в seqlock_read_retry()
+ */
+static inline uint32_t seqlock_read_begin(seqlock_t *lock)
+{
+    uint32_t seq;
+    
+    // Ожидание завершения записи, начатой на другом ядре
+    while ((seq = atomic_load_explicit(&lock->sequence, memory_order_acquire)) & 1) {
+    }
+    
+    return seq;
+}
+
+/**
+ * @brief Проверка необходимости повторить чтение
+ * 
+ * @param lock Счетчик последовательности
+ * @param start Значение, полученное от seqlock_read_begin()
+ * @return bool true, если данные изменились во время чтения
+ */
+static inline bool seqlock_read_retry(seqlock_t *lock, uint32_t start)
+{
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit(&lock->sequence, memory_order_relaxed) != start;
+}
+
+/**
+ * @brief Начало записи (под блокировкой писателей)
+ * 
+ * @param lock Счетчик последовательности
+ */
+static inline void seqlock_write_begin(seqlock_t *lock)
+{
+    atomic_fetch_add_explicit(&lock->sequence, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
+
+/**
+ * @brief Завершение записи и публикация данных
+ * 
+ * @param lock Счетчик последовательности
+ */
+static inline void seqlock_write_end(seqlock_t *lock)
+{
+    atomic_fetch_add_explicit(&lock->sequence, 1, memory_order_release);
+}
+
+#endif /* SEQLOCK_H */
@@ -4,16 +4,74 @@
  */
 
 #include <string.h>
+#include <stdatomic.h>
 #include "esp_zigbee_lib.h"
+#include "zb_radio.h"
 #include "esp_log.h"
 #include "nvs_flash.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include "esp_timer.h"
+#include "esp_random.h"
+#include "sdkconfig.h"
 
 #define TAG "ESP_ZIGBEE"
 
+// Глубина очереди сообщений по умолчанию
+#define ZB_DEFAULT_QUEUE_DEPTH 10
+
+// Максимальная длина данных команды в сообщении
+#define ZB_MAX_COMMAND_LEN 8
+
+// Параметры механизма переподключения
+#define ZB_REJOIN_FAST_ATTEMPTS    2        // Попыток быстрого переподключения к родителю
+#define ZB_REJOIN_BASE_DELAY_MS    1000     // Базовая задержка между попытками (мс)
+#define ZB_REJOIN_MAX_DELAY_MS     300000   // Максимальная задержка между попытками (5 минут)
+#define ZB_REJOIN_START_SPREAD_MS  5000     // Разброс первой попытки после запуска (мс)
+#define ZB_REJOIN_ATTEMPT_BUDGET   16       // Попыток до паузы (ограничение расхода энергии)
+#define ZB_REJOIN_REST_MS          3600000  // Пауза после исчерпания бюджета попыток (1 час)
+
+// Параметры надежной доставки отчетов
+#define ZB_RELIABLE_MAX_RETRIES    5        // Повторов отчета после потери APS-подтверждения
+#define ZB_RELIABLE_BASE_DELAY_MS  500      // Базовая задержка перед повтором (мс)
+#define ZB_RELIABLE_MAX_DELAY_MS   30000    // Максимальная задержка перед повтором (мс)
+#define ZB_CONFIRM_TIMEOUT_MS      10000    // Ожидание статуса отправки кадра (мс)
+
+// Слоты надежной доставки: состояние окна и по одному на тип уведомления
+#define ZB_SLOT_WINDOW_STATE       0
+#define ZB_SLOT_ALERT_BASE         1
+#define ZB_SLOT_COUNT              (ZB_SLOT_ALERT_BASE + ESP_ZIGBEE_ALERT_MAX)
+
+// Дескрипторы кадров радиотракта: номера слотов и отчет кластера Diagnostics
+#define ZB_TX_HANDLE_DIAGNOSTICS   ZB_SLOT_COUNT
+#define ZB_TX_HANDLE_COUNT         (ZB_SLOT_COUNT + 1)
+
+// Адаптивная мощность передачи: верхняя граница задается в menuconfig (Kconfig.projbuild)
+#define ZB_TXP_MAX_DBM             CONFIG_ESP_ZB_TX_POWER
+#define ZB_TXP_MIN_DBM             (-6)     // Нижняя граница мощности передачи (дБм)
+#define ZB_TXP_STEP_DOWN_DB        2        // Шаг снижения мощности (дБ)
+#define ZB_TXP_STEP_UP_DB          6        // Шаг повышения после потери подтверждения (дБ)
+#define ZB_TXP_STEP_DOWN_FRAMES    8        // Подтвержденных попыток подряд перед снижением
+#define ZB_TXP_TARGET_MARGIN_DB    10       // Требуемый запас уровня сигнала у родителя (дБ)
+#define ZB_TXP_MIN_LQI             100      // Минимальный сглаженный LQI для снижения мощности
+#define ZB_TXP_PARENT_POWER_DBM    20       // Предполагаемая мощность передачи родителя (дБм)
+#define ZB_RX_SENSITIVITY_DBM      (-100)   // Чувствительность приемника 802.15.4 (дБм)
+
+// Модель тока передатчика для оценки энергии (ориентировочные параметры,
+// для точного расчета заменить измеренными на плате)
+#define ZB_TX_BASE_CURRENT_UA      11000    // Ток радиотракта без учета выходной мощности (мкА)
+#define ZB_TX_SUPPLY_MV            3300     // Напряжение питания радиотракта (мВ)
+#define ZB_TX_PA_EFFICIENCY_PCT    30       // КПД усилителя мощности (%)
+#define ZB_TX_FRAME_AIRTIME_US     2000     // Длительность одной попытки передачи отчета (мкс)
+
+// Этапы переподключения к сети
+typedef enum {
+    ZB_REJOIN_STAGE_FAST = 0,  // Быстрое переподключение на известном канале и PAN
+    ZB_REJOIN_STAGE_SCAN = 1   // Полное сканирование маски каналов
+} zb_rejoin_stage_t;
+
 /* 
  * Примечание: Это заглушка для интеграции с реальным ESP-ZigBee SDK.
  * В реальном проекте здесь должна быть полноценная интеграция с ESP-ZigBee SDK.
@@ -23,7 +81,9 @@
 typedef enum {
     ZB_MSG_WINDOW_STATE = 0,   // Состояние окна (режим и процент открытия)
     ZB_MSG_ALERT = 1,          // Уведомление
-    ZB_MSG_RESET = 2           // Сброс устройства
+    ZB_MSG_RESET = 2,          // Сброс устройства
+    ZB_MSG_COMMAND = 3,        // Входящая команда
+    ZB_MSG_DIAGNOSTICS = 4     // Периодический отчет кластера Diagnostics
 } zb_message_type_t;
 
 // Структура сообщения ZigBee
@@ -31,30 +91,149 @@ typedef struct {
     zb_message_type_t type;    // Тип сообщения
     uint8_t param1;            // Параметр 1
     uint8_t param2;            // Параметр 2
+    uint8_t len;               // Длина данных команды
+    uint8_t data[ZB_MAX_COMMAND_LEN]; // Данные команды
+    uint8_t lqi;               // LQI входящей команды
+    int8_t rssi;               // RSSI входящей команды (дБм)
+    int64_t timestamp_us;      // Время постановки в очередь (мкс)
 } zb_message_t;
 
+// Слот надежной доставки: последнее неподтвержденное значение атрибута
+typedef struct {
+    bool pending;              // Значение ожидает подтверждения
+    uint8_t attempts;          // Выполнено попыток отправки
+    int64_t next_try_us;       // Время следующей попытки (мкс)
+    bool superseded;           // Значение замещено, пока прежнее ожидало статуса отправки
+    zb_message_t message;      // Отправляемое значение
+} zb_report_slot_t;
+
+// Кадр, переданный радиотракту и ожидающий статуса отправки
+typedef struct {
+    bool in_flight;            // Статус отправки еще не получен
+    zb_radio_frame_type_t type; // Тип кадра
+    int8_t tx_power_dbm;       // Мощность, на которой передан кадр (дБм)
+    int64_t deadline_us;       // Срок ожидания статуса (мкс)
+} zb_tx_frame_t;
+
 // Текущее состояние ZigBee
 static struct {
     esp_zigbee_state_t state;                // Состояние соединения
     bool initialized;                        // Статус инициализации
     esp_zigbee_config_t config;             // Конфигурация
     QueueHandle_t message_queue;            // Очередь сообщений
+    SemaphoreHandle_t enqueue_lock;         // Очередность отправителей при вытеснении
+    StaticSemaphore_t enqueue_lock_buffer;  // Память мьютекса отправителей
     TaskHandle_t process_task_handle;       // Задача обработки
+    portMUX_TYPE pending_lock;              // Защита слота отложенного состояния
+    zb_message_t pending_state;             // Последнее состояние окна (режим объединения)
+    bool pending_state_valid;               // Слот отложенного состояния заполнен
+    uint32_t coalesced_reports;             // Счетчик объединенных отчетов
+    bool was_connected;                     // Устройство уже подключалось к сети
+    bool network_known;                     // Известны параметры сети (канал, PAN)
     uint32_t last_report_time;              // Время последнего отчета
     uint32_t connection_retry_count;        // Счетчик попыток соединения
+    zb_rejoin_stage_t rejoin_stage;         // Текущий этап переподключения
+    uint32_t rejoin_budget;                 // Оставшийся бюджет попыток до паузы
 } zb_ctx = {
     .state = ESP_ZIGBEE_STATE_DISCONNECTED,
     .initialized = false,
     .message_queue = NULL,
     .process_task_handle = NULL,
+    .pending_lock = portMUX_INITIALIZER_UNLOCKED,
+    .pending_state_valid = false,
+    .coalesced_reports = 0,
+    .was_connected = false,
+    .network_known = false,
     .last_report_time = 0,
-    .connection_retry_count = 0
+    .connection_retry_count = 0,
+    .rejoin_stage = ZB_REJOIN_STAGE_FAST,
+    .rejoin_budget = ZB_REJOIN_ATTEMPT_BUDGET
+};
+
+// Счетчики кластера Diagnostics (атомарные, обновляются из любых задач)
+static struct {
+    _Atomic uint32_t mac_rx;
+    _Atomic uint32_t mac_tx;
+    _Atomic uint32_t mac_tx_retries;
+    _Atomic uint32_t mac_tx_failures;
+    _Atomic uint32_t aps_ack_failures;
+    _Atomic uint8_t last_lqi;
+    _Atomic int8_t last_rssi;
+    _Atomic uint32_t parent_changes;
+    _Atomic uint32_t queue_overflows;
+    _Atomic uint32_t report_drops;
+    _Atomic uint32_t reliable_submitted;
+    _Atomic uint32_t reliable_delivered;
+    _Atomic uint32_t reliable_superseded;
+    _Atomic uint32_t reliable_abandoned;
+    _Atomic uint32_t reliable_frames;
+    _Atomic int8_t tx_power_dbm;
+    _Atomic uint32_t tx_power_decreases;
+    _Atomic uint32_t tx_power_increases;
+} diag;
+
+#define DIAG_ADD(counter, n) atomic_fetch_add_explicit(&diag.counter, (n), memory_order_relaxed)
+#define DIAG_INC(counter)    DIAG_ADD(counter, 1)
+
+// Слоты надежной доставки (используются только задачей обработки)
+static zb_report_slot_t report_slots[ZB_SLOT_COUNT];
+
+// Кадры, ожидающие статуса отправки (используются только задачей обработки)
+static zb_tx_frame_t tx_frames[ZB_TX_HANDLE_COUNT];
+
+// Статусы отправки от радиотракта (защищены zb_ctx.pending_lock)
+static struct {
+    uint32_t ready;                          // Дескрипторы с полученным статусом
+    zb_radio_confirm_t confirm[ZB_TX_HANDLE_COUNT];
+} tx_confirms;
+
+// Регулятор мощности передачи для текущего родителя (используется только задачей обработки)
+static struct {
+    int8_t tx_power_dbm;                     // Текущая мощность передачи (дБм)
+    int32_t rssi_avg_x8;                     // Сглаженный RSSI подтверждений родителя (1/8 дБм)
+    int32_t lqi_avg_x8;                      // Сглаженный LQI подтверждений родителя (1/8)
+    bool link_valid;                         // Есть измерения канала до текущего родителя
+    uint8_t ok_streak;                       // Подтвержденных попыток подряд
+} txp_ctx = {
+    .tx_power_dbm = ZB_TXP_MAX_DBM,
+    .link_valid = false,
+    .ok_streak = 0
+};
+
+// Смена родителя: регулятор начинает с максимальной мощности
+static _Atomic bool txp_parent_changed;
+
+// Оценка энергии передачи (пишется задачей обработки, читается под pending_lock)
+static esp_zigbee_tx_energy_stats_t tx_energy;
+
+// Выходная мощность усилителя (мкВт) для ZB_TXP_MIN_DBM...20 дБм с шагом 1 дБ
+static const uint32_t tx_output_uw[] = {
+    251, 316, 398, 501, 631, 794, 1000, 1259, 1585, 1995, 2512, 3162, 3981, 5012,
+    6310, 7943, 10000, 12589, 15849, 19953, 25119, 31623, 39811, 50119, 63096, 79433, 100000
 };
 
 // Прототипы функций
 static void zigbee_process_task(void *pvParameters);
 static esp_err_t zigbee_process_message(zb_message_t *message);
+static esp_err_t zigbee_enqueue_message(zb_message_t *message);
+static esp_err_t zigbee_tx_send(uint8_t handle, zb_radio_frame_type_t type, const zb_message_t *message);
+static void zigbee_reliable_flush(void);
+static void zigbee_tx_poll(int64_t now);
 static void zigbee_connection_timer_callback(void *arg);
+static void zigbee_diag_timer_callback(void *arg);
+static void zigbee_retry_timer_callback(void *arg);
+static esp_err_t zigbee_rejoin_begin(void);
+static void zigbee_txp_apply(int8_t tx_power_dbm);
+static void zigbee_radio_confirm_cb(uint8_t handle, const zb_radio_confirm_t *confirm);
+static void zigbee_radio_command_cb(uint8_t cmd, const uint8_t *data, uint8_t len, uint8_t lqi, int8_t rssi);
+static void zigbee_radio_link_lost_cb(void);
+
+// Колбэки радиотракта
+static const zb_radio_callbacks_t radio_callbacks = {
+    .on_confirm = zigbee_radio_confirm_cb,
+    .on_command = zigbee_radio_command_cb,
+    .on_link_lost = zigbee_radio_link_lost_cb
+};
 
 // Обработчик соединения ZigBee
 static esp_timer_handle_t connection_timer;
@@ -63,32 +242,137 @@ static esp_timer_create_args_t connection_timer_args = {
     .name = "zigbee_conn_timer"
 };
 
+// Таймер периодического отчета кластера Diagnostics
+static esp_timer_handle_t diag_timer;
+static esp_timer_create_args_t diag_timer_args = {
+    .callback = &zigbee_diag_timer_callback,
+    .name = "zigbee_diag_timer"
+};
+
+// Таймер повтора неподтвержденных отчетов
+static esp_timer_handle_t retry_timer;
+static esp_timer_create_args_t retry_timer_args = {
+    .callback = &zigbee_retry_timer_callback,
+    .name = "zigbee_retry_timer"
+};
+
 /**
- * @brief Колбэк таймера соединения
+ * @brief Расчет задержки перед следующей попыткой переподключения
+ * 
+ * Задержка растет экспоненциально с номером попытки. Случайная половина
+ * интервала разносит во времени попытки устройств, потерявших сеть
+ * одновременно (например, после отключения электричества в доме).
  */
-static void zigbee_connection_timer_callback(void *arg) 
+static uint32_t zigbee_rejoin_backoff_ms(uint32_t attempt)
 {
-    if (zb_ctx.state == ESP_ZIGBEE_STATE_CONNECTING) {
-        zb_ctx.connection_retry_count++;
-        
-        // Симуляция соединения для заглушки
-        if (zb_ctx.connection_retry_count >= 3) {
-            zb_ctx.state = ESP_ZIGBEE_STATE_CONNECTED;
-            ESP_LOGI(TAG, "ZigBee подключено к сети");
-            
-            // Симуляция сопряжения
-            vTaskDelay(pdMS_TO_TICKS(1000));
-            zb_ctx.state = ESP_ZIGBEE_STATE_PAIRED;
-            ESP_LOGI(TAG, "ZigBee сопряжено с координатором");
-            
-            // Вызываем колбэк подключения, если задан
-            if (zb_ctx.config.on_connected) {
-                zb_ctx.config.on_connected();
-            }
-        } else {
-            ESP_LOGW(TAG, "Попытка подключения ZigBee (%d)...", zb_ctx.connection_retry_count);
+    uint32_t delay = ZB_REJOIN_MAX_DELAY_MS;
+    
+    if (attempt < 20) {
+        delay = ZB_REJOIN_BASE_DELAY_MS << attempt;
+        if (delay > ZB_REJOIN_MAX_DELAY_MS) {
+            delay = ZB_REJOIN_MAX_DELAY_MS;
         }
     }
+    
+    return delay / 2 + esp_random() % (delay / 2 + 1);
+}
+
+/**
+ * @brief Завершение переподключения после успешного входа в сеть
+ */
+static void zigbee_rejoin_complete(void)
+{
+    zb_ctx.state = ESP_ZIGBEE_STATE_CONNECTED;
+    ESP_LOGI(TAG, "ZigBee подключено к сети (попыток: %lu)", 
+             (unsigned long)zb_ctx.connection_retry_count);
+    
+    // Симуляция сопряжения
+    zb_ctx.state = ESP_ZIGBEE_STATE_PAIRED;
+    ESP_LOGI(TAG, "ZigBee сопряжено с координатором");
+    
+    // Повторное подключение означает выбор нового родителя
+    if (zb_ctx.was_connected) {
+        DIAG_INC(parent_changes);
+        atomic_store_explicit(&txp_parent_changed, true, memory_order_relaxed);
+    }
+    zb_ctx.was_connected = true;
+    zb_ctx.network_known = true;
+    
+    zb_ctx.connection_retry_count = 0;
+    zb_ctx.rejoin_budget = ZB_REJOIN_ATTEMPT_BUDGET;
+    
+    // Вызываем колбэк подключения, если задан
+    if (zb_ctx.config.on_connected) {
+        zb_ctx.config.on_connected();
+    }
+    
+    // Досылаем отчеты, не подтвержденные до потери связи
+    xTaskNotifyGive(zb_ctx.process_task_handle);
+}
+
+/**
+ * @brief Колбэк таймера соединения (одна попытка переподключения)
+ */
+static void zigbee_connection_timer_callback(void *arg) 
+{
+    if (zb_ctx.state != ESP_ZIGBEE_STATE_CONNECTING) {
+        return;
+    }
+    
+    zb_ctx.connection_retry_count++;
+    zb_ctx.rejoin_budget--;
+    
+    if (zb_ctx.rejoin_stage == ZB_REJOIN_STAGE_FAST) {
+        ESP_LOGI(TAG, "Быстрое переподключение к родителю (попытка %lu)", 
+                 (unsigned long)zb_ctx.connection_retry_count);
+    } else {
+        ESP_LOGI(TAG, "Сканирование каналов (попытка %lu)", 
+                 (unsigned long)zb_ctx.connection_retry_count);
+    }
+    
+    if (zb_radio_join(zb_ctx.rejoin_stage == ZB_REJOIN_STAGE_SCAN)) {
+        zigbee_rejoin_complete();
+        return;
+    }
+    
+    // Быстрое переподключение не удалось - переходим к полному сканированию
+    if (zb_ctx.rejoin_stage == ZB_REJOIN_STAGE_FAST && 
+        zb_ctx.connection_retry_count >= ZB_REJOIN_FAST_ATTEMPTS) {
+        ESP_LOGW(TAG, "Родитель недоступен, переход к сканированию каналов");
+        zb_ctx.rejoin_stage = ZB_REJOIN_STAGE_SCAN;
+    }
+    
+    uint32_t delay_ms;
+    if (zb_ctx.rejoin_budget == 0) {
+        // Бюджет исчерпан - делаем долгую паузу, чтобы не разряжать батарею
+        ESP_LOGW(TAG, "Бюджет попыток исчерпан, пауза %d мин", ZB_REJOIN_REST_MS / 60000);
+        zb_ctx.rejoin_budget = ZB_REJOIN_ATTEMPT_BUDGET;
+        delay_ms = ZB_REJOIN_REST_MS;
+    } else {
+        delay_ms = zigbee_rejoin_backoff_ms(zb_ctx.connection_retry_count);
+    }
+    
+    esp_timer_start_once(connection_timer, (uint64_t)delay_ms * 1000);
+}
+
+/**
+ * @brief Запуск механизма переподключения к сети
+ */
+static esp_err_t zigbee_rejoin_begin(void)
+{
+    zb_ctx.connection_retry_count = 0;
+    zb_ctx.rejoin_budget = ZB_REJOIN_ATTEMPT_BUDGET;
+    zb_ctx.rejoin_stage = zb_ctx.network_known ? ZB_REJOIN_STAGE_FAST : ZB_REJOIN_STAGE_SCAN;
+    zb_ctx.state = ESP_ZIGBEE_STATE_CONNECTING;
+    
+    if (esp_timer_is_active(connection_timer)) {
+        esp_timer_stop(connection_timer);
+    }
+    
+    // Первая попытка со случайной задержкой, чтобы устройства не обращались
+    // к координатору одновременно
+    uint32_t delay_ms = esp_random() % ZB_REJOIN_START_SPREAD_MS;
+    return esp_timer_start_once(connection_timer, (uint64_t)delay_ms * 1000);
 }
 
 /**
@@ -111,21 +395,64 @@ esp_err_t esp_zigbee_init(esp_zigbee_config_t *config)
     // Копируем конфигурацию
     memcpy(&zb_ctx.config, config, sizeof(esp_zigbee_config_t));
     
+    esp_err_t err = zb_radio_init(&radio_callbacks);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Не удалось инициализировать радиотракт: %s", esp_err_to_name(err));
+        return err;
+    }
+    
+    // Регулятор начинает с максимальной мощности передачи
+    zigbee_txp_apply(ZB_TXP_MAX_DBM);
+    
     // Создаем очередь сообщений
-    zb_ctx.message_queue = xQueueCreate(10, sizeof(zb_message_t));
+    if (zb_ctx.config.queue_depth == 0) {
+        zb_ctx.config.queue_depth = ZB_DEFAULT_QUEUE_DEPTH;
+    }
+    
+    zb_ctx.message_queue = xQueueCreate(zb_ctx.config.queue_depth, sizeof(zb_message_t));
     if (zb_ctx.message_queue == NULL) {
         ESP_LOGE(TAG, "Не удалось создать очередь сообщений");
         return ESP_ERR_NO_MEM;
     }
+    zb_ctx.enqueue_lock = xSemaphoreCreateMutexStatic(&zb_ctx.enqueue_lock_buffer);
     
     // Создаем таймер соединения
-    esp_err_t err = esp_timer_create(&connection_timer_args, &connection_timer);
+    err = esp_timer_create(&connection_timer_args, &connection_timer);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Не удалось создать таймер соединения: %s", esp_err_to_name(err));
         vQueueDelete(zb_ctx.message_queue);
         return err;
     }
     
+    // Создаем таймер повтора отчетов
+    err = esp_timer_create(&retry_timer_args, &retry_timer);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Не удалось создать таймер повтора отчетов: %s", esp_err_to_name(err));
+        esp_timer_delete(connection_timer);
+        vQueueDelete(zb_ctx.message_queue);
+        return err;
+    }
+    
+    // Создаем таймер отчета кластера Diagnostics
+    if (zb_ctx.config.diag_report_interval_ms > 0) {
+        err = esp_timer_create(&diag_timer_args, &diag_timer);
+        if (err == ESP_OK) {
+            err = esp_timer_start_periodic(diag_timer, 
+                                           (uint64_t)zb_ctx.config.diag_report_interval_ms * 1000);
+        }
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Не удалось запустить таймер диагностики: %s", esp_err_to_name(err));
+            if (diag_timer != NULL) {
+                esp_timer_delete(diag_timer);
+                diag_timer = NULL;
+            }
+            esp_timer_delete(retry_timer);
+            esp_timer_delete(connection_timer);
+            vQueueDelete(zb_ctx.message_queue);
+            return err;
+        }
+    }
+    
     // Создаем задачу обработки сообщений
     BaseType_t task_created = xTaskCreate(
         zigbee_process_task,
@@ -138,6 +465,12 @@ esp_err_t esp_zigbee_init(esp_zigbee_config_t *config)
     
     if (task_created != pdPASS) {
         ESP_LOGE(TAG, "Не удалось создать задачу обработки ZigBee");
+        if (diag_timer != NULL) {
+            esp_timer_stop(diag_timer);
+            esp_timer_delete(diag_timer);
+            diag_timer = NULL;
+        }
+        esp_timer_delete(retry_timer);
         esp_timer_delete(connection_timer);
         vQueueDelete(zb_ctx.message_queue);
         return ESP_ERR_NO_MEM;
@@ -167,14 +500,8 @@ esp_err_t esp_zigbee_start(void)
         return ESP_OK;
     }
     
-    // Сбрасываем счетчик попыток подключения
-    zb_ctx.connection_retry_count = 0;
-    
-    // Устанавливаем состояние "подключение"
-    zb_ctx.state = ESP_ZIGBEE_STATE_CONNECTING;
-    
-    // Запускаем таймер соединения (периодический)
-    esp_err_t err = esp_timer_start_periodic(connection_timer, 2000000); // 2 секунды
+    // Запускаем переподключение: сначала к известной сети, затем сканирование
+    esp_err_t err = zigbee_rejoin_begin();
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Не удалось запустить таймер соединения: %s", esp_err_to_name(err));
         zb_ctx.state = ESP_ZIGBEE_STATE_ERROR;
@@ -203,9 +530,11 @@ esp_err_t esp_zigbee_stop(void)
     }
     
     // Останавливаем таймер соединения
-    esp_err_t err = esp_timer_stop(connection_timer);
-    if (err != ESP_OK) {
-        ESP_LOGW(TAG, "Ошибка при остановке таймера соединения: %s", esp_err_to_name(err));
+    if (esp_timer_is_active(connection_timer)) {
+        esp_err_t err = esp_timer_stop(connection_timer);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Ошибка при остановке таймера соединения: %s", esp_err_to_name(err));
+        }
     }
     
     // Вызываем колбэк отключения, если задан
@@ -252,11 +581,10 @@ esp_err_t esp_zigbee_report_window_state(esp_zigbee_window_mode_t mode, uint8_t
         return ESP_ERR_INVALID_ARG;
     }
     
-    // Если не подключены, выходим с ошибкой
+    // Без сети отчет ждет в слоте надежной доставки до переподключения
     if (zb_ctx.state != ESP_ZIGBEE_STATE_CONNECTED && 
         zb_ctx.state != ESP_ZIGBEE_STATE_PAIRED) {
-        ESP_LOGW(TAG, "Невозможно отправить отчет: ZigBee не подключено");
-        return ESP_ERR_INVALID_STATE;
+        ESP_LOGI(TAG, "ZigBee не подключено, отчет будет отправлен после подключения");
     }
     
     // Создаем и отправляем сообщение в очередь
@@ -266,9 +594,9 @@ esp_err_t esp_zigbee_report_window_state(esp_zigbee_window_mode_t mode, uint8_t
         .param2 = percentage
     };
     
-    if (xQueueSend(zb_ctx.message_queue, &message, pdMS_TO_TICKS(100)) != pdPASS) {
-        ESP_LOGE(TAG, "Не удалось отправить сообщение в очередь");
-        return ESP_FAIL;
+    esp_err_t err = zigbee_enqueue_message(&message);
+    if (err != ESP_OK) {
+        return err;
     }
     
     // Запоминаем время последнего отчета
@@ -295,11 +623,10 @@ esp_err_t esp_zigbee_send_alert(esp_zigbee_alert_type_t alert_type, uint8_t valu
         return ESP_ERR_INVALID_ARG;
     }
     
-    // Если не подключены, выходим с ошибкой
+    // Без сети уведомление ждет в слоте надежной доставки до переподключения
     if (zb_ctx.state != ESP_ZIGBEE_STATE_CONNECTED && 
         zb_ctx.state != ESP_ZIGBEE_STATE_PAIRED) {
-        ESP_LOGW(TAG, "Невозможно отправить уведомление: ZigBee не подключено");
-        return ESP_ERR_INVALID_STATE;
+        ESP_LOGI(TAG, "ZigBee не подключено, уведомление будет отправлено после подключения");
     }
     
     // Создаем и отправляем сообщение в очередь
@@ -309,12 +636,7 @@ esp_err_t esp_zigbee_send_alert(esp_zigbee_alert_type_t alert_type, uint8_t valu
         .param2 = value
     };
     
-    if (xQueueSend(zb_ctx.message_queue, &message, pdMS_TO_TICKS(100)) != pdPASS) {
-        ESP_LOGE(TAG, "Не удалось отправить сообщение в очередь");
-        return ESP_FAIL;
-    }
-    
-    return ESP_OK;
+    return zigbee_enqueue_message(&message);
 }
 
 /**
@@ -353,6 +675,11 @@ esp_err_t esp_zigbee_reset(bool clear_network)
         return err;
     }
     
+    // После очистки сети быстрое переподключение невозможно
+    if (clear_network) {
+        zb_ctx.network_known = false;
+    }
+    
     // Создаем и отправляем сообщение сброса в очередь
     zb_message_t message = {
         .type = ZB_MSG_RESET,
@@ -360,9 +687,9 @@ esp_err_t esp_zigbee_reset(bool clear_network)
         .param2 = 0
     };
     
-    if (xQueueSend(zb_ctx.message_queue, &message, pdMS_TO_TICKS(100)) != pdPASS) {
-        ESP_LOGE(TAG, "Не удалось отправить сообщение сброса в очередь");
-        return ESP_FAIL;
+    err = zigbee_enqueue_message(&message);
+    if (err != ESP_OK) {
+        return err;
     }
     
     // Запускаем ZigBee снова
@@ -376,28 +703,221 @@ esp_err_t esp_zigbee_reset(bool clear_network)
     return ESP_OK;
 }
 
+/**
+ * @brief Постановка сообщения в очередь без блокировки вызывающей задачи
+ * 
+ * При переполнении очереди самое старое сообщение вытесняется. Отправители
+ * выполняют вытеснение по очереди, иначе освобожденное место может занять
+ * другой отправитель. В режиме объединения отчеты о состоянии окна не
+ * занимают место в очереди: новый отчет замещает еще не обработанный
+ * предыдущий.
+ */
+static esp_err_t zigbee_enqueue_message(zb_message_t *message)
+{
+    message->timestamp_us = esp_timer_get_time();
+    
+    if (zb_ctx.config.queue_policy == ESP_ZIGBEE_QUEUE_COALESCE &&
+        message->type == ZB_MSG_WINDOW_STATE) {
+        taskENTER_CRITICAL(&zb_ctx.pending_lock);
+        if (zb_ctx.pending_state_valid) {
+            zb_ctx.coalesced_reports++;
+        }
+        zb_ctx.pending_state = *message;
+        zb_ctx.pending_state_valid = true;
+        taskEXIT_CRITICAL(&zb_ctx.pending_lock);
+    } else {
+        // Задача обработки только забирает сообщения, поэтому место,
+        // освобожденное под мьютексом, достается этому отправителю
+        xSemaphoreTake(zb_ctx.enqueue_lock, portMAX_DELAY);
+        
+        bool queued = xQueueSend(zb_ctx.message_queue, message, 0) == pdPASS;
+        if (!queued) {
+            // Очередь заполнена - вытесняем самое старое сообщение
+            zb_message_t dropped;
+            if (xQueueReceive(zb_ctx.message_queue, &dropped, 0) == pdPASS) {
+                DIAG_INC(queue_overflows);
+                ESP_LOGW(TAG, "Очередь переполнена, вытеснено сообщение типа %d", dropped.type);
+            }
+            queued = xQueueSend(zb_ctx.message_queue, message, 0) == pdPASS;
+        }
+        
+        xSemaphoreGive(zb_ctx.enqueue_lock);
+        
+        if (!queued) {
+            ESP_LOGE(TAG, "Не удалось отправить сообщение в очередь");
+            return ESP_FAIL;
+        }
+    }
+    
+    // Будим задачу обработки
+    xTaskNotifyGive(zb_ctx.process_task_handle);
+    
+    return ESP_OK;
+}
+
 /**
  * @brief Задача обработки сообщений ZigBee
+ * 
+ * За одно пробуждение обрабатываются все накопленные сообщения. В режиме
+ * объединения последнее состояние окна отправляется раньше уведомлений,
+ * накопленных в очереди: уведомления описывают уже отправленное состояние.
  */
 static void zigbee_process_task(void *pvParameters)
 {
     ESP_LOGI(TAG, "Задача обработки ZigBee запущена");
     
     zb_message_t message;
+    bool have_state;
     
     while (1) {
-        // Ждем сообщение в очереди
-        if (xQueueReceive(zb_ctx.message_queue, &message, pdMS_TO_TICKS(100)) == pdPASS) {
-            // Обрабатываем полученное сообщение
+        // Ждем уведомления о новых сообщениях
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        
+        // Сначала последнее объединенное состояние окна
+        taskENTER_CRITICAL(&zb_ctx.pending_lock);
+        have_state = zb_ctx.pending_state_valid;
+        message = zb_ctx.pending_state;
+        zb_ctx.pending_state_valid = false;
+        taskEXIT_CRITICAL(&zb_ctx.pending_lock);
+        
+        if (have_state) {
             zigbee_process_message(&message);
         }
         
-        // Симуляция обработки входящих команд
-        // В реальной реализации здесь был бы код для проверки и обработки
-        // входящих команд от ZigBee-координатора.
+        // Затем все сообщения, накопившиеся в очереди
+        while (xQueueReceive(zb_ctx.message_queue, &message, 0) == pdPASS) {
+            zigbee_process_message(&message);
+        }
+        
+        // Отправляем новые и повторяем неподтвержденные отчеты
+        zigbee_reliable_flush();
+    }
+}
+
+/**
+ * @brief Помещение значения в слот надежной доставки
+ * 
+ * Новое значение замещает еще не подтвержденное старое: повторно
+ * отправлять устаревшее состояние нет смысла. Если старое значение ждет
+ * статуса отправки, новое передается сразу после его получения.
+ */
+static void zigbee_reliable_submit(uint8_t slot, const zb_message_t *message)
+{
+    zb_report_slot_t *report_slot = &report_slots[slot];
+    
+    if (report_slot->pending) {
+        DIAG_INC(reliable_superseded);
+    }
+    DIAG_INC(reliable_submitted);
+    
+    report_slot->message = *message;
+    report_slot->pending = true;
+    report_slot->attempts = 0;
+    report_slot->next_try_us = 0;
+    report_slot->superseded = tx_frames[slot].in_flight;
+}
+
+/**
+ * @brief Задержка перед повтором отчета
+ */
+static uint32_t zigbee_reliable_backoff_ms(uint8_t attempts)
+{
+    uint32_t delay = ZB_RELIABLE_BASE_DELAY_MS << (attempts - 1);
+    if (delay > ZB_RELIABLE_MAX_DELAY_MS) {
+        delay = ZB_RELIABLE_MAX_DELAY_MS;
+    }
+    
+    return delay / 2 + esp_random() % (delay / 2 + 1);
+}
+
+/**
+ * @brief Учет результата попытки доставки значения слота
+ */
+static void zigbee_reliable_on_result(uint8_t slot, bool acked, int64_t now)
+{
+    zb_report_slot_t *report_slot = &report_slots[slot];
+    
+    // Статус относится к замещенному значению: новое отправляется без задержки
+    if (report_slot->superseded) {
+        report_slot->superseded = false;
+        return;
+    }
+    
+    if (acked) {
+        report_slot->pending = false;
+        DIAG_INC(reliable_delivered);
+    } else if (report_slot->attempts > ZB_RELIABLE_MAX_RETRIES) {
+        ESP_LOGW(TAG, "Отчет слота %d не доставлен после %d попыток", slot, report_slot->attempts);
+        report_slot->pending = false;
+        DIAG_INC(reliable_abandoned);
+        DIAG_INC(report_drops);
+    } else {
+        report_slot->next_try_us = now + 
+            (int64_t)zigbee_reliable_backoff_ms(report_slot->attempts) * 1000;
+    }
+}
+
+/**
+ * @brief Обработка статусов отправки и передача слотов, срок попытки которых наступил
+ * 
+ * Слот освобождается по APS-подтверждению или после исчерпания повторов.
+ * Таймер повтора взводится на ближайшую из оставшихся попыток или на
+ * срок ожидания статуса отправки.
+ */
+static void zigbee_reliable_flush(void)
+{
+    int64_t now = esp_timer_get_time();
+    int64_t next_try_us = INT64_MAX;
+    
+    zigbee_tx_poll(now);
+    
+    // Без сети значения остаются в слотах до переподключения
+    bool connected = zb_ctx.state == ESP_ZIGBEE_STATE_CONNECTED || 
+                     zb_ctx.state == ESP_ZIGBEE_STATE_PAIRED;
+    
+    for (uint8_t i = 0; i < ZB_SLOT_COUNT; i++) {
+        zb_report_slot_t *report_slot = &report_slots[i];
+        
+        if (connected && report_slot->pending && !tx_frames[i].in_flight && 
+            report_slot->next_try_us <= now) {
+            zb_radio_frame_type_t type = (i == ZB_SLOT_WINDOW_STATE) ? 
+                                         ZB_RADIO_FRAME_REPORT : ZB_RADIO_FRAME_ALERT;
+            report_slot->attempts++;
+            
+            if (zigbee_tx_send(i, type, &report_slot->message) != ESP_OK) {
+                zigbee_reliable_on_result(i, false, now);
+            }
+        }
         
-        vTaskDelay(pdMS_TO_TICKS(10)); // Небольшая задержка для экономии ресурсов
+        if (tx_frames[i].in_flight) {
+            if (tx_frames[i].deadline_us < next_try_us) {
+                next_try_us = tx_frames[i].deadline_us;
+            }
+        } else if (connected && report_slot->pending && report_slot->next_try_us < next_try_us) {
+            next_try_us = report_slot->next_try_us;
+        }
     }
+    
+    const zb_tx_frame_t *diag_frame = &tx_frames[ZB_TX_HANDLE_DIAGNOSTICS];
+    if (diag_frame->in_flight && diag_frame->deadline_us < next_try_us) {
+        next_try_us = diag_frame->deadline_us;
+    }
+    
+    if (esp_timer_is_active(retry_timer)) {
+        esp_timer_stop(retry_timer);
+    }
+    
+    if (next_try_us != INT64_MAX) {
+        esp_timer_start_once(retry_timer, next_try_us > now ? (uint64_t)(next_try_us - now) : 0);
+    }
+}
+
+/**
+ * @brief Колбэк таймера повтора отчетов
+ */
+static void zigbee_retry_timer_callback(void *arg)
+{
+    xTaskNotifyGive(zb_ctx.process_task_handle);
 }
 
 /**
@@ -414,13 +934,13 @@ static esp_err_t zigbee_process_message(zb_message_t *message)
         case ZB_MSG_WINDOW_STATE:
             ESP_LOGI(TAG, "Обработка сообщения состояния окна: режим=%d, процент=%d%%", 
                      message->param1, message->param2);
-            // Симуляция отправки отчета состояния окна
+            zigbee_reliable_submit(ZB_SLOT_WINDOW_STATE, message);
             break;
             
         case ZB_MSG_ALERT:
             ESP_LOGI(TAG, "Обработка сообщения уведомления: тип=%d, значение=%d", 
                      message->param1, message->param2);
-            // Симуляция отправки уведомления
+            zigbee_reliable_submit(ZB_SLOT_ALERT_BASE + message->param1, message);
             break;
             
         case ZB_MSG_RESET:
@@ -429,10 +949,404 @@ static esp_err_t zigbee_process_message(zb_message_t *message)
             // Симуляция сброса устройства
             break;
             
+        case ZB_MSG_COMMAND:
+            ESP_LOGI(TAG, "Обработка входящей команды: cmd=%d, len=%d", 
+                     message->param1, message->len);
+            
+            DIAG_INC(mac_rx);
+            atomic_store_explicit(&diag.last_lqi, message->lqi, memory_order_relaxed);
+            atomic_store_explicit(&diag.last_rssi, message->rssi, memory_order_relaxed);
+            
+            if (zb_ctx.config.on_command) {
+                zb_ctx.config.on_command(message->param1, message->data, message->len);
+            }
+            break;
+            
+        case ZB_MSG_DIAGNOSTICS:
+            if (zb_ctx.state == ESP_ZIGBEE_STATE_CONNECTED || 
+                zb_ctx.state == ESP_ZIGBEE_STATE_PAIRED) {
+                if (tx_frames[ZB_TX_HANDLE_DIAGNOSTICS].in_flight) {
+                    // Предыдущий отчет еще ждет статуса отправки
+                    DIAG_INC(report_drops);
+                } else {
+                    zigbee_tx_send(ZB_TX_HANDLE_DIAGNOSTICS, ZB_RADIO_FRAME_DIAGNOSTICS, message);
+                }
+            }
+            
+            // Эффективность надежной доставки: кадров в эфире на доставленное значение
+            {
+                uint32_t delivered = atomic_load_explicit(&diag.reliable_delivered, memory_order_relaxed);
+                uint32_t frames = atomic_load_explicit(&diag.reliable_frames, memory_order_relaxed);
+                if (delivered > 0) {
+                    ESP_LOGI(TAG, "Надежная доставка: доставлено=%lu, кадров на значение=%lu.%02lu",
+                             (unsigned long)delivered, (unsigned long)(frames / delivered),
+                             (unsigned long)((frames % delivered) * 100 / delivered));
+                }
+            }
+            
+            // Экономия энергии передачи относительно постоянной максимальной мощности
+            if (zb_ctx.config.adaptive_tx_power) {
+                esp_zigbee_tx_energy_stats_t energy;
+                esp_zigbee_get_tx_energy_stats(&energy);
+                if (energy.frames > 0 && energy.baseline_charge_nc >= energy.charge_nc) {
+                    uint64_t saved_nc = energy.baseline_charge_nc - energy.charge_nc;
+                    ESP_LOGI(TAG, "Мощность передачи: %d дБм, экономия на кадр: %lu нКл (%lu%%)",
+                             txp_ctx.tx_power_dbm, (unsigned long)(saved_nc / energy.frames),
+                             (unsigned long)(saved_nc * 100 / energy.baseline_charge_nc));
+                }
+            }
+            break;
+            
         default:
             ESP_LOGW(TAG, "Неизвестный тип сообщения: %d", message->type);
             return ESP_ERR_INVALID_ARG;
     }
     
     return ESP_OK;
-} 
\ No newline at end of file
+}
+
+/**
+ * @brief Установка мощности передачи радио и учет ее в диагностике
+ */
+static void zigbee_txp_apply(int8_t tx_power_dbm)
+{
+    zb_radio_set_tx_power(tx_power_dbm);
+    txp_ctx.tx_power_dbm = tx_power_dbm;
+    atomic_store_explicit(&diag.tx_power_dbm, tx_power_dbm, memory_order_relaxed);
+}
+
+/**
+ * @brief Ток передатчика на заданной мощности (мкА)
+ */
+static uint32_t zigbee_txp_current_ua(int8_t tx_power_dbm)
+{
+    int32_t index = tx_power_dbm - ZB_TXP_MIN_DBM;
+    int32_t last = (int32_t)(sizeof(tx_output_uw) / sizeof(tx_output_uw[0])) - 1;
+    
+    index = index < 0 ? 0 : (index > last ? last : index);
+    return ZB_TX_BASE_CURRENT_UA +
+           tx_output_uw[index] * 1000 / (ZB_TX_SUPPLY_MV * ZB_TX_PA_EFFICIENCY_PCT / 100);
+}
+
+/**
+ * @brief Учет статуса отправки кадра регулятором мощности
+ * 
+ * Затухание до родителя оценивается по RSSI его APS-подтверждений (канал
+ * считается взаимным). Мощность снижается, пока запас у родителя на
+ * сниженной мощности не меньше ZB_TXP_TARGET_MARGIN_DB, и сразу
+ * повышается, если кадр не подтвержден или потребовал повторов MAC.
+ * Подтверждение без измерения канала (LQI 0) мощность не снижает.
+ */
+static void zigbee_txp_on_confirm(const zb_radio_confirm_t *confirm)
+{
+    if (!zb_ctx.config.adaptive_tx_power) {
+        return;
+    }
+    
+    if (atomic_exchange_explicit(&txp_parent_changed, false, memory_order_relaxed)) {
+        txp_ctx.link_valid = false;
+        txp_ctx.ok_streak = 0;
+        zigbee_txp_apply(ZB_TXP_MAX_DBM);
+    }
+    
+    if (!confirm->acked || confirm->attempts > 1) {
+        txp_ctx.ok_streak = 0;
+        
+        if (txp_ctx.tx_power_dbm < ZB_TXP_MAX_DBM) {
+            int8_t tx_power = txp_ctx.tx_power_dbm + ZB_TXP_STEP_UP_DB;
+            zigbee_txp_apply(tx_power > ZB_TXP_MAX_DBM ? ZB_TXP_MAX_DBM : tx_power);
+            DIAG_INC(tx_power_increases);
+            ESP_LOGI(TAG, "Потеря подтверждения: мощность передачи повышена до %d дБм", txp_ctx.tx_power_dbm);
+        }
+        return;
+    }
+    
+    if (confirm->lqi == 0) {
+        return;
+    }
+    
+    // Экспоненциальное сглаживание с весом 1/8
+    if (!txp_ctx.link_valid) {
+        txp_ctx.rssi_avg_x8 = confirm->rssi * 8;
+        txp_ctx.lqi_avg_x8 = confirm->lqi * 8;
+        txp_ctx.link_valid = true;
+    } else {
+        txp_ctx.rssi_avg_x8 += confirm->rssi - txp_ctx.rssi_avg_x8 / 8;
+        txp_ctx.lqi_avg_x8 += confirm->lqi - txp_ctx.lqi_avg_x8 / 8;
+    }
+    
+    if (++txp_ctx.ok_streak < ZB_TXP_STEP_DOWN_FRAMES) {
+        return;
+    }
+    txp_ctx.ok_streak = 0;
+    
+    int8_t tx_power = txp_ctx.tx_power_dbm - ZB_TXP_STEP_DOWN_DB;
+    if (tx_power < ZB_TXP_MIN_DBM || txp_ctx.lqi_avg_x8 / 8 < ZB_TXP_MIN_LQI) {
+        return;
+    }
+    
+    int32_t path_loss = ZB_TXP_PARENT_POWER_DBM - txp_ctx.rssi_avg_x8 / 8;
+    int32_t margin = tx_power - path_loss - ZB_RX_SENSITIVITY_DBM;
+    if (margin < ZB_TXP_TARGET_MARGIN_DB) {
+        return;
+    }
+    
+    zigbee_txp_apply(tx_power);
+    DIAG_INC(tx_power_decreases);
+    ESP_LOGD(TAG, "Запас сигнала %ld дБ: мощность передачи снижена до %d дБм", (long)margin, tx_power);
+}
+
+/**
+ * @brief Передача кадра радиотракту
+ */
+static esp_err_t zigbee_tx_send(uint8_t handle, zb_radio_frame_type_t type, const zb_message_t *message)
+{
+    zb_tx_frame_t *frame = &tx_frames[handle];
+    zb_radio_frame_t radio_frame = {
+        .type = type,
+        .param1 = message->param1,
+        .param2 = message->param2
+    };
+    
+    // Статус может прийти до возврата из zb_radio_send()
+    frame->in_flight = true;
+    frame->type = type;
+    frame->tx_power_dbm = txp_ctx.tx_power_dbm;
+    frame->deadline_us = esp_timer_get_time() + (int64_t)ZB_CONFIRM_TIMEOUT_MS * 1000;
+    
+    esp_err_t err = zb_radio_send(handle, &radio_frame);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Радиотракт не принял кадр типа %d: %s", type, esp_err_to_name(err));
+        frame->in_flight = false;
+    }
+    
+    return err;
+}
+
+/**
+ * @brief Учет статуса отправки кадра в диагностике, оценке энергии и регуляторе мощности
+ * 
+ * Базовая линия энергии - те же попытки передачи на максимальной мощности.
+ * 
+ * @return true, если кадр подтвержден
+ */
+static bool zigbee_tx_complete(uint8_t handle, const zb_radio_confirm_t *confirm)
+{
+    const zb_tx_frame_t *frame = &tx_frames[handle];
+    uint8_t attempts = confirm->attempts > 0 ? confirm->attempts : 1;
+    
+    uint64_t charge_nc = (uint64_t)attempts * zigbee_txp_current_ua(frame->tx_power_dbm) * 
+                         ZB_TX_FRAME_AIRTIME_US / 1000;
+    uint64_t baseline_nc = (uint64_t)attempts * zigbee_txp_current_ua(ZB_TXP_MAX_DBM) * 
+                           ZB_TX_FRAME_AIRTIME_US / 1000;
+    
+    taskENTER_CRITICAL(&zb_ctx.pending_lock);
+    tx_energy.frames++;
+    tx_energy.attempts += attempts;
+    tx_energy.charge_nc += charge_nc;
+    tx_energy.baseline_charge_nc += baseline_nc;
+    taskEXIT_CRITICAL(&zb_ctx.pending_lock);
+    
+    DIAG_ADD(mac_tx, attempts);
+    DIAG_ADD(mac_tx_retries, attempts - 1);
+    if (frame->type != ZB_RADIO_FRAME_DIAGNOSTICS) {
+        DIAG_ADD(reliable_frames, attempts);
+    }
+    
+    if (confirm->acked) {
+        // Подтверждение - последнее принятое сообщение
+        if (confirm->lqi != 0) {
+            atomic_store_explicit(&diag.last_lqi, confirm->lqi, memory_order_relaxed);
+            atomic_store_explicit(&diag.last_rssi, confirm->rssi, memory_order_relaxed);
+        }
+    } else {
+        ESP_LOGW(TAG, "Кадр типа %d не подтвержден после %d попыток", frame->type, attempts);
+        DIAG_INC(mac_tx_failures);
+        DIAG_INC(aps_ack_failures);
+        
+        // Отчеты и уведомления повторяются слотами надежной доставки
+        if (frame->type == ZB_RADIO_FRAME_DIAGNOSTICS) {
+            DIAG_INC(report_drops);
+        }
+    }
+    
+    zigbee_txp_on_confirm(confirm);
+    
+    return confirm->acked;
+}
+
+/**
+ * @brief Обработка полученных статусов отправки и истекших сроков ожидания
+ */
+static void zigbee_tx_poll(int64_t now)
+{
+    zb_radio_confirm_t confirms[ZB_TX_HANDLE_COUNT];
+    
+    taskENTER_CRITICAL(&zb_ctx.pending_lock);
+    uint32_t ready = tx_confirms.ready;
+    tx_confirms.ready = 0;
+    memcpy(confirms, tx_confirms.confirm, sizeof(confirms));
+    taskEXIT_CRITICAL(&zb_ctx.pending_lock);
+    
+    for (uint8_t handle = 0; handle < ZB_TX_HANDLE_COUNT; handle++) {
+        zb_tx_frame_t *frame = &tx_frames[handle];
+        bool acked;
+        
+        if (!frame->in_flight) {
+            continue;
+        }
+        
+        if (ready & (1U << handle)) {
+            acked = zigbee_tx_complete(handle, &confirms[handle]);
+        } else if (frame->deadline_us <= now) {
+            // Статус отправки не пришел: попытка считается неудачной
+            ESP_LOGW(TAG, "Нет статуса отправки кадра типа %d", frame->type);
+            DIAG_INC(aps_ack_failures);
+            if (frame->type == ZB_RADIO_FRAME_DIAGNOSTICS) {
+                DIAG_INC(report_drops);
+            }
+            acked = false;
+        } else {
+            continue;
+        }
+        
+        frame->in_flight = false;
+        if (handle < ZB_SLOT_COUNT) {
+            zigbee_reliable_on_result(handle, acked, now);
+        }
+    }
+}
+
+/**
+ * @brief Статус отправки кадра от радиотракта
+ */
+static void zigbee_radio_confirm_cb(uint8_t handle, const zb_radio_confirm_t *confirm)
+{
+    if (handle >= ZB_TX_HANDLE_COUNT || confirm == NULL) {
+        return;
+    }
+    
+    taskENTER_CRITICAL(&zb_ctx.pending_lock);
+    tx_confirms.confirm[handle] = *confirm;
+    tx_confirms.ready |= 1U << handle;
+    taskEXIT_CRITICAL(&zb_ctx.pending_lock);
+    
+    xTaskNotifyGive(zb_ctx.process_task_handle);
+}
+
+/**
+ * @brief Входящая команда от радиотракта
+ */
+static void zigbee_radio_command_cb(uint8_t cmd, const uint8_t *data, uint8_t len, uint8_t lqi, int8_t rssi)
+{
+    if (len > ZB_MAX_COMMAND_LEN || (len > 0 && data == NULL)) {
+        ESP_LOGW(TAG, "Неверные данные команды: cmd=%d, len=%d", cmd, len);
+        return;
+    }
+    
+    zb_message_t message = {
+        .type = ZB_MSG_COMMAND,
+        .param1 = cmd,
+        .param2 = 0,
+        .len = len,
+        .lqi = lqi,
+        .rssi = rssi
+    };
+    
+    if (len > 0) {
+        memcpy(message.data, data, len);
+    }
+    
+    zigbee_enqueue_message(&message);
+}
+
+/**
+ * @brief Потеря родительского узла: запуск переподключения
+ */
+static void zigbee_radio_link_lost_cb(void)
+{
+    if (zb_ctx.state != ESP_ZIGBEE_STATE_CONNECTED && 
+        zb_ctx.state != ESP_ZIGBEE_STATE_PAIRED) {
+        return;
+    }
+    
+    ESP_LOGW(TAG, "Связь с родительским узлом потеряна");
+    
+    if (zb_ctx.config.on_disconnected) {
+        zb_ctx.config.on_disconnected();
+    }
+    
+    zigbee_rejoin_begin();
+}
+
+/**
+ * @brief Колбэк таймера отчета кластера Diagnostics
+ */
+static void zigbee_diag_timer_callback(void *arg)
+{
+    zb_message_t message = {
+        .type = ZB_MSG_DIAGNOSTICS
+    };
+    
+    zigbee_enqueue_message(&message);
+}
+
+/**
+ * @brief Получение снимка счетчиков кластера Diagnostics
+ */
+esp_err_t esp_zigbee_get_diagnostics(esp_zigbee_diag_counters_t *counters)
+{
+    if (counters == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    counters->mac_rx = atomic_load_explicit(&diag.mac_rx, memory_order_relaxed);
+    counters->mac_tx = atomic_load_explicit(&diag.mac_tx, memory_order_relaxed);
+    counters->mac_tx_retries = atomic_load_explicit(&diag.mac_tx_retries, memory_order_relaxed);
+    counters->mac_tx_failures = atomic_load_explicit(&diag.mac_tx_failures, memory_order_relaxed);
+    counters->aps_ack_failures = atomic_load_explicit(&diag.aps_ack_failures, memory_order_relaxed);
+    counters->last_lqi = atomic_load_explicit(&diag.last_lqi, memory_order_relaxed);
+    counters->last_rssi = atomic_load_explicit(&diag.last_rssi, memory_order_relaxed);
+    counters->parent_changes = atomic_load_explicit(&diag.parent_changes, memory_order_relaxed);
+    counters->queue_overflows = atomic_load_explicit(&diag.queue_overflows, memory_order_relaxed);
+    counters->report_drops = atomic_load_explicit(&diag.report_drops, memory_order_relaxed);
+    counters->tx_power_dbm = atomic_load_explicit(&diag.tx_power_dbm, memory_order_relaxed);
+    counters->tx_power_decreases = atomic_load_explicit(&diag.tx_power_decreases, memory_order_relaxed);
+    counters->tx_power_increases = atomic_load_explicit(&diag.tx_power_increases, memory_order_relaxed);
+    
+    return ESP_OK;
+}
+
+/**
+ * @brief Получение статистики надежной доставки отчетов
+ */
+esp_err_t esp_zigbee_get_reliable_stats(esp_zigbee_reliable_stats_t *stats)
+{
+    if (stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    stats->submitted = atomic_load_explicit(&diag.reliable_submitted, memory_order_relaxed);
+    stats->delivered = atomic_load_explicit(&diag.reliable_delivered, memory_order_relaxed);
+    stats->superseded = atomic_load_explicit(&diag.reliable_superseded, memory_order_relaxed);
+    stats->abandoned = atomic_load_explicit(&diag.reliable_abandoned, memory_order_relaxed);
+    stats->frames_sent = atomic_load_explicit(&diag.reliable_frames, memory_order_relaxed);
+    
+    return ESP_OK;
+}
+
+/**
+ * @brief Получение оценки энергии передачи
+ */
+esp_err_t esp_zigbee_get_tx_energy_stats(esp_zigbee_tx_energy_stats_t *stats)
+{
+    if (stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    taskENTER_CRITICAL(&zb_ctx.pending_lock);
+    *stats = tx_energy;
+    taskEXIT_CRITICAL(&zb_ctx.pending_lock);
+    
+    return ESP_OK;
+}
@@ -36,6 +36,14 @@ typedef enum {
     ESP_ZIGBEE_ALERT_MAX
 } esp_zigbee_alert_type_t;
 
+/**
+ * @brief Политика обработки переполнения очереди сообщений
+ */
+typedef enum {
+    ESP_ZIGBEE_QUEUE_DROP_OLDEST,    // Вытеснять самое старое сообщение в очереди
+    ESP_ZIGBEE_QUEUE_COALESCE        // Объединять отчеты о состоянии окна (хранится только последний)
+} esp_zigbee_queue_policy_t;
+
 /**
  * @brief Конфигурация библиотеки ESP ZigBee
  */
@@ -45,6 +53,10 @@ typedef struct {
     uint8_t channel;                 // Канал (0 для автоматического)
     bool auto_join;                  // Автоматическое подключение к сети
     uint32_t join_timeout_ms;        // Таймаут подключения (мс)
+    uint8_t queue_depth;             // Глубина очереди сообщений (0 - по умолчанию)
+    esp_zigbee_queue_policy_t queue_policy; // Политика при переполнении очереди
+    uint32_t diag_report_interval_ms; // Интервал отчета кластера Diagnostics (0 - отключен)
+    bool adaptive_tx_power;          // Подбор мощности передачи по качеству связи (false - всегда максимальная)
     void (*on_connected)(void);      // Колбэк подключения
     void (*on_disconnected)(void);   // Колбэк отключения
     void (*on_command)(uint8_t cmd, const uint8_t *data, uint16_t len); // Колбэк команды
@@ -59,6 +71,71 @@ typedef enum {
     ESP_ZIGBEE_WINDOW_MODE_VENTILATE // Окно в режиме проветривания
 } esp_zigbee_window_mode_t;
 
+/**
+ * @brief Атрибуты кластера Diagnostics (0x0B05)
+ */
+#define ESP_ZIGBEE_DIAG_CLUSTER_ID           0x0B05
+#define ESP_ZIGBEE_DIAG_ATTR_MAC_RX_UCAST    0x0102  // Принято кадров MAC
+#define ESP_ZIGBEE_DIAG_ATTR_MAC_TX_UCAST    0x0103  // Передано кадров MAC
+#define ESP_ZIGBEE_DIAG_ATTR_MAC_TX_RETRY    0x0104  // Повторные передачи MAC
+#define ESP_ZIGBEE_DIAG_ATTR_MAC_TX_FAIL     0x0105  // Неудачные передачи MAC
+#define ESP_ZIGBEE_DIAG_ATTR_APS_TX_FAIL     0x010B  // Неполученные APS-подтверждения
+#define ESP_ZIGBEE_DIAG_ATTR_LAST_LQI        0x011C  // LQI последнего сообщения
+#define ESP_ZIGBEE_DIAG_ATTR_LAST_RSSI       0x011D  // RSSI последнего сообщения
+#define ESP_ZIGBEE_DIAG_ATTR_PARENT_CHANGES  0xF000  // Смены родителя (атрибут производителя)
+#define ESP_ZIGBEE_DIAG_ATTR_QUEUE_OVERFLOWS 0xF001  // Переполнения очереди (атрибут производителя)
+#define ESP_ZIGBEE_DIAG_ATTR_REPORT_DROPS    0xF002  // Потерянные отчеты (атрибут производителя)
+#define ESP_ZIGBEE_DIAG_ATTR_TX_POWER        0xF003  // Текущая мощность передачи, дБм (атрибут производителя)
+#define ESP_ZIGBEE_DIAG_ATTR_TX_POWER_DOWN   0xF004  // Снижения мощности передачи (атрибут производителя)
+#define ESP_ZIGBEE_DIAG_ATTR_TX_POWER_UP     0xF005  // Повышения мощности передачи (атрибут производителя)
+
+/**
+ * @brief Снимок счетчиков кластера Diagnostics
+ */
+typedef struct {
+    uint32_t mac_rx;                 // Принято кадров MAC
+    uint32_t mac_tx;                 // Передано кадров MAC
+    uint32_t mac_tx_retries;         // Повторные передачи MAC
+    uint32_t mac_tx_failures;        // Неудачные передачи MAC
+    uint32_t aps_ack_failures;       // Неполученные APS-подтверждения
+    uint8_t last_lqi;                // LQI последнего сообщения
+    int8_t last_rssi;                // RSSI последнего сообщения (дБм)
+    uint32_t parent_changes;         // Смены родительского узла
+    uint32_t queue_overflows;        // Вытесненные из очереди сообщения
+    uint32_t report_drops;           // Потерянные отчеты и уведомления
+    int8_t tx_power_dbm;             // Текущая мощность передачи (дБм)
+    uint32_t tx_power_decreases;     // Снижения мощности при запасе по уровню сигнала
+    uint32_t tx_power_increases;     // Повышения мощности после потери подтверждения
+} esp_zigbee_diag_counters_t;
+
+/**
+ * @brief Статистика надежной доставки отчетов и уведомлений
+ * 
+ * Отношение frames_sent / delivered - количество кадров в эфире
+ * на одно доставленное состояние.
+ */
+typedef struct {
+    uint32_t submitted;              // Значений поставлено на отправку
+    uint32_t delivered;              // Значений подтверждено получателем
+    uint32_t superseded;             // Неподтвержденных значений замещено более новыми
+    uint32_t abandoned;              // Значений отброшено после исчерпания повторов
+    uint32_t frames_sent;            // Кадров передано в эфир (с учетом повторов)
+} esp_zigbee_reliable_stats_t;
+
+/**
+ * @brief Оценка энергии передачи при адаптивной мощности
+ * 
+ * Заряд считается по модели тока передатчика для каждой попытки из
+ * статуса отправки кадра. Базовая линия - те же попытки на максимальной
+ * мощности (CONFIG_ESP_ZB_TX_POWER).
+ */
+typedef struct {
+    uint32_t frames;                 // Передано кадров
+    uint32_t attempts;               // Попыток передачи (с учетом повторов MAC)
+    uint64_t charge_nc;              // Израсходованный заряд (нКл)
+    uint64_t baseline_charge_nc;     // Заряд на максимальной мощности (нКл)
+} esp_zigbee_tx_energy_stats_t;
+
 /**
  * @brief Инициализация библиотеки ESP ZigBee
  * 
@@ -91,6 +168,9 @@ esp_zigbee_state_t esp_zigbee_get_state(void);
 /**
  * @brief Отправка отчета о состоянии окна
  * 
+ * Без подключения к сети отчет остается в слоте надежной доставки
+ * и отправляется после переподключения.
+ * 
  * @param mode Режим работы окна
  * @param percentage Процент открытия
  * @return esp_err_t ESP_OK при успешной отправке
@@ -100,6 +180,9 @@ esp_err_t esp_zigbee_report_window_state(esp_zigbee_window_mode_t mode, uint8_t
 /**
  * @brief Отправка уведомления о событии
  * 
+ * Без подключения к сети уведомление остается в слоте надежной доставки
+ * и отправляется после переподключения.
+ * 
  * @param alert_type Тип уведомления
  * @param value Дополнительные данные (опционально)
  * @return esp_err_t ESP_OK при успешной отправке
@@ -121,6 +204,34 @@ esp_err_t esp_zigbee_process_commands(void);
  */
 esp_err_t esp_zigbee_reset(bool clear_network);
 
+/**
+ * @brief Получение снимка счетчиков кластера Diagnostics
+ * 
+ * @param counters Указатель на структуру для записи счетчиков
+ * @return esp_err_t ESP_OK при успешном получении
+ */
+esp_err_t esp_zigbee_get_diagnostics(esp_zigbee_diag_counters_t *counters);
+
+/**
+ * @brief Получение статистики надежной доставки отчетов
+ * 
+ * Отчеты о состоянии окна и уведомления хранятся в слотах до получения
+ * APS-подтверждения и повторяются с растущей задержкой. Новое значение
+ * замещает неподтвержденное старое того же слота.
+ * 
+ * @param stats Указатель на структуру для записи статистики
+ * @return esp_err_t ESP_OK при успешном получении
+ */
+esp_err_t esp_zigbee_get_reliable_stats(esp_zigbee_reliable_stats_t *stats);
+
+/**
+ * @brief Получение оценки энергии передачи
+ * 
+ * @param stats Указатель на структуру для записи статистики
+ * @return esp_err_t ESP_OK при успешном получении
+ */
+esp_err_t esp_zigbee_get_tx_energy_stats(esp_zigbee_tx_energy_stats_t *stats);
+
 #ifdef __cplusplus
 }
 #endif
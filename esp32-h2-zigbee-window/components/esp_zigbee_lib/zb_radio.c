@@ -0,0 +1,72 @@
+/**
+ * @file zb_radio.c
+ * @brief Радиотракт библиотеки ESP ZigBee (заглушка без стека ZigBee)
+ * 
+ * Кадры подтверждаются с первой попытки без измерения канала, вход в сеть
+ * всегда успешен. При интеграции со стеком статус отправки передается в
+ * on_confirm из колбэка статуса отправки ZCL, LQI и RSSI подтверждения -
+ * из счетчиков диагностики стека.
+ */
+
+#include "zb_radio.h"
+#include "sdkconfig.h"
+#ifdef CONFIG_ZB_ENABLED
+#include "esp_zigbee_core.h"
+#endif
+
+// Колбэки библиотеки
+static zb_radio_callbacks_t radio_callbacks;
+
+/**
+ * @brief Инициализация радиотракта
+ */
+esp_err_t zb_radio_init(const zb_radio_callbacks_t *callbacks)
+{
+    if (callbacks == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    radio_callbacks = *callbacks;
+    return ESP_OK;
+}
+
+/**
+ * @brief Передача кадра
+ */
+esp_err_t zb_radio_send(uint8_t handle, const zb_radio_frame_t *frame)
+{
+    if (frame == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    zb_radio_confirm_t confirm = {
+        .acked = true,
+        .attempts = 1,
+        .lqi = 0,
+        .rssi = 0
+    };
+    
+    if (radio_callbacks.on_confirm) {
+        radio_callbacks.on_confirm(handle, &confirm);
+    }
+    
+    return ESP_OK;
+}
+
+/**
+ * @brief Попытка входа в сеть
+ */
+bool zb_radio_join(bool scan)
+{
+    return true;
+}
+
+/**
+ * @brief Установка мощности передачи
+ */
+void zb_radio_set_tx_power(int8_t tx_power_dbm)
+{
+#ifdef CONFIG_ZB_ENABLED
+    esp_zb_set_tx_power(tx_power_dbm);
+#endif
+}
@@ -0,0 +1,91 @@
+/**
+ * @file zb_radio.h
+ * @brief Радиотракт библиотеки ESP ZigBee: передача кадров, статусы отправки и вход в сеть
+ * 
+ * Граница между логикой библиотеки (очередь, надежная доставка, регулятор
+ * мощности) и стеком ZigBee. Статус отправки каждого кадра приходит
+ * асинхронно через on_confirm. При сборке на хосте вместо zb_radio.c
+ * подключается модель канала из test/host/sim.
+ */
+
+#ifndef ZB_RADIO_H
+#define ZB_RADIO_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/**
+ * @brief Тип исходящего кадра
+ */
+typedef enum {
+    ZB_RADIO_FRAME_REPORT,           // Отчет о состоянии окна
+    ZB_RADIO_FRAME_ALERT,            // Уведомление
+    ZB_RADIO_FRAME_DIAGNOSTICS       // Отчет кластера Diagnostics
+} zb_radio_frame_type_t;
+
+/**
+ * @brief Исходящий кадр
+ */
+typedef struct {
+    zb_radio_frame_type_t type;      // Тип кадра
+    uint8_t param1;                  // Режим окна или тип уведомления
+    uint8_t param2;                  // Процент открытия или значение уведомления
+} zb_radio_frame_t;
+
+/**
+ * @brief Статус отправки кадра
+ */
+typedef struct {
+    bool acked;                      // Получено APS-подтверждение
+    uint8_t attempts;                // Попыток передачи в эфире (с повторами MAC)
+    uint8_t lqi;                     // LQI подтверждения (0 - канал не измерен)
+    int8_t rssi;                     // RSSI подтверждения (дБм)
+} zb_radio_confirm_t;
+
+/**
+ * @brief Колбэки радиотракта (вызываются из контекста стека ZigBee)
+ */
+typedef struct {
+    void (*on_confirm)(uint8_t handle, const zb_radio_confirm_t *confirm); // Статус отправки кадра
+    void (*on_command)(uint8_t cmd, const uint8_t *data, uint8_t len,
+                       uint8_t lqi, int8_t rssi);                         // Входящая команда
+    void (*on_link_lost)(void);                                           // Потеря родительского узла
+} zb_radio_callbacks_t;
+
+/**
+ * @brief Инициализация радиотракта
+ * 
+ * @param callbacks Колбэки библиотеки
+ * @return esp_err_t ESP_OK при успешной инициализации
+ */
+esp_err_t zb_radio_init(const zb_radio_callbacks_t *callbacks);
+
+/**
+ * @brief Передача кадра
+ * 
+ * Статус отправки приходит в on_confirm с тем же дескриптором, в том числе
+ * до возврата из функции.
+ * 
+ * @param handle Дескриптор кадра
+ * @param frame Кадр
+ * @return esp_err_t ESP_OK, если кадр передан стеку (on_confirm будет вызван)
+ */
+esp_err_t zb_radio_send(uint8_t handle, const zb_radio_frame_t *frame);
+
+/**
+ * @brief Попытка входа в сеть
+ * 
+ * @param scan true - сканирование всех каналов, false - известная сеть
+ * @return bool true, если устройство вошло в сеть
+ */
+bool zb_radio_join(bool scan);
+
+/**
+ * @brief Установка мощности передачи
+ * 
+ * @param tx_power_dbm Мощность передачи (дБм)
+ */
+void zb_radio_set_tx_power(int8_t tx_power_dbm);
+
+#endif /* ZB_RADIO_H */
@@ -28,6 +28,9 @@ static TaskHandle_t zigbee_task_handle = NULL;
 static TaskHandle_t power_task_handle = NULL;
 static TaskHandle_t ota_task_handle = NULL;
 
+// Колбэк перед глубоким сном
+static void power_before_sleep(void);
+
 // Конфигурации компонентов
 static servo_config_t handle_servo_config = {
     .gpio_pin = 4,                  // GPIO для сервопривода ручки
@@ -50,12 +53,14 @@ static power_config_t power_config = {
     .external_power_gpio = 6,       // GPIO для определения внешнего питания
     .low_battery_threshold = 3.2,   // Порог низкого заряда батареи (В)
     .critical_battery_threshold = 2.8, // Порог критического заряда батареи (В)
-    .check_interval_ms = 60000      // Интервал проверки состояния батареи (мс)
+    .check_interval_ms = 60000,     // Интервал проверки состояния батареи (мс)
+    .on_before_sleep = power_before_sleep // Запись несохраненного состояния
 };
 
 static state_config_t state_config = {
     .save_to_nvs = true,            // Сохранять состояние в NVS
-    .save_interval_ms = 300000,     // Интервал автоматического сохранения (мс)
+    .debounce_ms = 2000,            // Запись после 2 секунд без изменений
+    .save_interval_ms = 30000,      // Не позже 30 секунд после первого изменения
     .restore_on_boot = true         // Восстанавливать состояние при загрузке
 };
 
@@ -125,6 +130,12 @@ static void zigbee_command_handler(uint8_t cmd, const uint8_t *data, uint16_t le
     zigbee_device_report_state(mode, percentage);
 }
 
+// Запись несохраненного состояния перед глубоким сном
+static void power_before_sleep(void)
+{
+    state_save();
+}
+
 // Задача управления состоянием
 static void state_task(void *pvParameter)
 {
@@ -253,6 +253,11 @@ esp_err_t power_enter_deep_sleep(uint32_t sleep_time_ms)
     // В реальном коде здесь была бы настройка пробуждения по GPIO
     // esp_sleep_enable_ext0_wakeup(power_ctx.config.external_power_gpio, 1);
     
+    // Сохраняем состояние перед сном
+    if (power_ctx.config.on_before_sleep) {
+        power_ctx.config.on_before_sleep();
+    }
+    
     ESP_LOGI(TAG, "Переход в глубокий сон...");
     
     // В реальном коде здесь был бы переход в глубокий сон
@@ -34,6 +34,13 @@ typedef enum {
     POWER_MODE_DEEP_SLEEP = 2     ///< Режим глубокого сна
 } power_mode_t;
 
+/**
+ * @brief Тип колбэка подготовки ко сну
+ * 
+ * Вызывается перед переходом в глубокий сон для записи несохраненных данных.
+ */
+typedef void (*power_sleep_cb_t)(void);
+
 /**
  * @brief Конфигурация управления питанием
  */
@@ -43,6 +50,7 @@ typedef struct {
     float low_battery_threshold;    ///< Порог низкого заряда батареи (В)
     float critical_battery_threshold; ///< Порог критического заряда батареи (В)
     uint32_t check_interval_ms;     ///< Интервал проверки состояния батареи (мс)
+    power_sleep_cb_t on_before_sleep; ///< Колбэк перед глубоким сном (NULL - не используется)
 } power_config_t;
 
 /**
@@ -6,20 +6,56 @@
 #include "state_management.h"
 #include "servo_control.h"
 #include "zigbee_device.h"
+#include "seqlock.h"
 #include "esp_log.h"
 #include "esp_timer.h"
 #include "nvs_flash.h"
 #include "nvs.h"
+#include "esp_rom_crc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
 #include <string.h>
+#include <stddef.h>
 
 #define TAG "STATE"
 
+// Параметры задачи отложенной записи
+#define STATE_PERSIST_TASK_PRIORITY  1       // Ниже всех задач устройства
+#define STATE_PERSIST_STACK_SIZE     2048
+#define STATE_DEFAULT_DEBOUNCE_MS    2000
+
+// Биты измененных полей
+#define STATE_DIRTY_MODE             (1 << 0)
+#define STATE_DIRTY_HANDLE_POS       (1 << 1)
+#define STATE_DIRTY_GAP_PERCENTAGE   (1 << 2)
+#define STATE_DIRTY_CALIBRATED       (1 << 3)
+
 // Ключи NVS для хранения состояния
 #define NVS_NAMESPACE           "window_state"   // Пространство имен NVS
-#define NVS_KEY_MODE            "mode"           // Режим работы окна
-#define NVS_KEY_HANDLE_POS      "handle_pos"     // Положение ручки
-#define NVS_KEY_GAP_PERCENTAGE  "gap_pct"        // Процент открытия зазора
-#define NVS_KEY_CALIBRATED      "calibrated"     // Статус калибровки
+#define NVS_KEY_STATE           "state"          // Запись состояния с версией и CRC32
+#define STATE_RECORD_VERSION    1                // Текущая версия записи
+
+// Ключи устаревшего формата (одно поле - один ключ), переносятся в запись при восстановлении
+#define NVS_KEY_LEGACY_MODE         "mode"           // Режим работы окна
+#define NVS_KEY_LEGACY_HANDLE_POS   "handle_pos"     // Положение ручки
+#define NVS_KEY_LEGACY_GAP          "gap_pct"        // Процент открытия зазора
+#define NVS_KEY_LEGACY_CALIBRATED   "calibrated"     // Статус калибровки
+#define NVS_KEY_LEGACY_WINDOW_MODE  "window_mode"    // Режим окна прошивки main
+#define NVS_KEY_LEGACY_ACTIVITY     "activity_time"  // Время активности прошивки main
+
+// Флаги записи состояния
+#define STATE_RECORD_FLAG_CALIBRATED (1 << 0)
+
+// Запись состояния в NVS
+typedef struct __attribute__((packed)) {
+    uint8_t version;                // Версия формата (STATE_RECORD_VERSION)
+    uint8_t mode;                   // Режим работы окна
+    uint8_t handle_pos;             // Положение ручки
+    uint8_t gap_percentage;         // Процент открытия зазора
+    uint8_t flags;                  // STATE_RECORD_FLAG_*
+    uint32_t crc;                   // CRC32 предыдущих полей
+} state_record_t;
 
 // Текущее состояние
 static struct {
@@ -29,18 +65,38 @@ static struct {
     uint64_t last_save_time;        // Время последнего сохранения
     nvs_handle_t nvs_handle;        // Указатель на NVS
     bool nvs_opened;                // Статус открытия NVS
+    window_state_t persisted;       // Значения, записанные в NVS
+    uint32_t dirty_mask;            // Измененные и еще не записанные поля
+    portMUX_TYPE lock;              // Защита снимка состояния и dirty_mask, упорядочивает писателей
+    seqlock_t seq;                  // Публикация состояния для читателей без блокировки
+    SemaphoreHandle_t persist_mutex; // Блокировка записи в NVS
+    TaskHandle_t persist_task;      // Задача отложенной записи
 } state_ctx = {
     .initialized = false,
     .last_save_time = 0,
-    .nvs_opened = false
+    .nvs_opened = false,
+    .dirty_mask = 0,
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+    .seq = SEQLOCK_INITIALIZER,
+    .persist_mutex = NULL,
+    .persist_task = NULL
 };
 
 // Прототипы вспомогательных функций
-static esp_err_t state_save_to_nvs(void);
+static esp_err_t state_save_to_nvs(uint32_t dirty, const window_state_t *snapshot);
 static esp_err_t state_restore_from_nvs(void);
+static esp_err_t state_read_record(state_record_t *record);
+static esp_err_t state_migrate_legacy(state_record_t *record);
+static void state_record_seal(state_record_t *record);
 static esp_err_t state_open_nvs(void);
 static void state_close_nvs(void);
 static void state_update_last_action_time(void);
+static void state_mark_dirty(uint32_t fields);
+static void state_publish_begin(void);
+static void state_publish_end(void);
+static window_state_t state_snapshot(void);
+static void state_persist_task(void *pvParameter);
+static void state_shutdown_handler(void);
 
 /**
  * @brief Инициализация модуля управления состоянием
@@ -70,6 +126,10 @@ esp_err_t state_init(state_config_t *config)
     state_ctx.state.in_motion = false;
     state_ctx.state.last_action_time = 0;
     
+    if (state_ctx.config.debounce_ms == 0) {
+        state_ctx.config.debounce_ms = STATE_DEFAULT_DEBOUNCE_MS;
+    }
+    
     // Если настроено сохранение в NVS, открываем NVS
     if (state_ctx.config.save_to_nvs) {
         esp_err_t err = state_open_nvs();
@@ -91,6 +151,35 @@ esp_err_t state_init(state_config_t *config)
         }
     }
     
+    // Восстановленные значения совпадают с записанными
+    state_ctx.persisted = state_ctx.state;
+    state_ctx.dirty_mask = 0;
+    
+    if (state_ctx.config.save_to_nvs) {
+        state_ctx.persist_mutex = xSemaphoreCreateMutex();
+        if (state_ctx.persist_mutex == NULL) {
+            ESP_LOGE(TAG, "Не удалось создать мьютекс записи состояния");
+            state_close_nvs();
+            return ESP_ERR_NO_MEM;
+        }
+        
+        // Изменения записываются низкоприоритетной задачей после паузы
+        if (xTaskCreate(state_persist_task, "state_persist", STATE_PERSIST_STACK_SIZE, NULL,
+                        STATE_PERSIST_TASK_PRIORITY, &state_ctx.persist_task) != pdPASS) {
+            ESP_LOGE(TAG, "Не удалось создать задачу записи состояния");
+            vSemaphoreDelete(state_ctx.persist_mutex);
+            state_ctx.persist_mutex = NULL;
+            state_close_nvs();
+            return ESP_ERR_NO_MEM;
+        }
+        
+        // Несохраненные изменения записываются перед программной перезагрузкой
+        esp_err_t err = esp_register_shutdown_handler(state_shutdown_handler);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Не удалось зарегистрировать обработчик перезагрузки: %s", esp_err_to_name(err));
+        }
+    }
+    
     state_ctx.initialized = true;
     state_ctx.last_save_time = esp_timer_get_time() / 1000; // мс
     
@@ -176,15 +265,16 @@ esp_err_t state_set_window_mode(window_mode_t mode)
     }
     
     // Обновляем состояние
+    state_publish_begin();
     state_ctx.state.mode = mode;
     state_ctx.state.handle_pos = new_handle_pos;
     
     if (mode != WINDOW_MODE_CUSTOM) {
         state_ctx.state.gap_percentage = new_gap_percentage;
     }
-    
     state_ctx.state.in_motion = true;
     state_update_last_action_time();
+    state_publish_end();
     
     // Отправляем отчет о состоянии через ZigBee
     zigbee_device_report_state(mode, state_ctx.state.gap_percentage);
@@ -192,10 +282,8 @@ esp_err_t state_set_window_mode(window_mode_t mode)
     // Отправляем уведомление об изменении режима
     zigbee_device_send_alert(ZIGBEE_ALERT_MODE_CHANGED, (uint8_t)mode);
     
-    // Если настроено сохранение в NVS, сохраняем состояние
-    if (state_ctx.config.save_to_nvs && state_ctx.nvs_opened) {
-        state_save_to_nvs();
-    }
+    // Запись в NVS выполняется фоновой задачей, а не в пути обработки команды
+    state_mark_dirty(STATE_DIRTY_MODE | STATE_DIRTY_HANDLE_POS | STATE_DIRTY_GAP_PERCENTAGE);
     
     ESP_LOGI(TAG, "Режим работы установлен: %d", mode);
     
@@ -257,18 +345,17 @@ esp_err_t state_set_handle_position(handle_position_t position)
     }
     
     // Обновляем состояние
+    state_publish_begin();
     state_ctx.state.handle_pos = position;
     state_ctx.state.mode = new_mode;
     state_ctx.state.in_motion = true;
     state_update_last_action_time();
+    state_publish_end();
     
     // Отправляем отчет о состоянии через ZigBee
     zigbee_device_report_state(new_mode, state_ctx.state.gap_percentage);
     
-    // Если настроено сохранение в NVS, сохраняем состояние
-    if (state_ctx.config.save_to_nvs && state_ctx.nvs_opened) {
-        state_save_to_nvs();
-    }
+    state_mark_dirty(STATE_DIRTY_MODE | STATE_DIRTY_HANDLE_POS);
     
     ESP_LOGI(TAG, "Положение ручки установлено: %d", position);
     
@@ -306,6 +393,8 @@ esp_err_t state_set_gap_percentage(uint8_t percentage)
         return err;
     }
     
+    state_publish_begin();
+    
     // Если ручка в положении Открыто или Вентиляция, и процент не соответствует режиму,
     // переключаемся в пользовательский режим
     if ((state_ctx.state.handle_pos == HANDLE_POSITION_OPEN && percentage != 100) ||
@@ -318,14 +407,12 @@ esp_err_t state_set_gap_percentage(uint8_t percentage)
     state_ctx.state.gap_percentage = percentage;
     state_ctx.state.in_motion = true;
     state_update_last_action_time();
+    state_publish_end();
     
     // Отправляем отчет о состоянии через ZigBee
     zigbee_device_report_state(state_ctx.state.mode, percentage);
     
-    // Если настроено сохранение в NVS, сохраняем состояние
-    if (state_ctx.config.save_to_nvs && state_ctx.nvs_opened) {
-        state_save_to_nvs();
-    }
+    state_mark_dirty(STATE_DIRTY_MODE | STATE_DIRTY_GAP_PERCENTAGE);
     
     ESP_LOGI(TAG, "Процент открытия установлен: %d%%", percentage);
     
@@ -337,11 +424,13 @@ esp_err_t state_set_gap_percentage(uint8_t percentage)
  */
 window_state_t state_get_window_state(void)
 {
-    // Обновляем данные из физических устройств
-    state_ctx.state.handle_pos = servo_get_handle_position();
-    state_ctx.state.gap_percentage = servo_get_gap_percentage();
+    window_state_t state = state_snapshot();
+    
+    // Положение берется из физических устройств
+    state.handle_pos = servo_get_handle_position();
+    state.gap_percentage = servo_get_gap_percentage();
     
-    return state_ctx.state;
+    return state;
 }
 
 /**
@@ -349,7 +438,7 @@ window_state_t state_get_window_state(void)
  */
 window_mode_t state_get_window_mode(void)
 {
-    return state_ctx.state.mode;
+    return state_snapshot().mode;
 }
 
 /**
@@ -378,7 +467,26 @@ esp_err_t state_save(void)
         }
     }
     
-    return state_save_to_nvs();
+    xSemaphoreTake(state_ctx.persist_mutex, portMAX_DELAY);
+    
+    // Снимок измененных полей
+    taskENTER_CRITICAL(&state_ctx.lock);
+    uint32_t dirty = state_ctx.dirty_mask;
+    window_state_t snapshot = state_ctx.state;
+    state_ctx.dirty_mask = 0;
+    taskEXIT_CRITICAL(&state_ctx.lock);
+    
+    esp_err_t err = state_save_to_nvs(dirty, &snapshot);
+    if (err != ESP_OK) {
+        // Поля остаются измененными до следующей попытки
+        taskENTER_CRITICAL(&state_ctx.lock);
+        state_ctx.dirty_mask |= dirty;
+        taskEXIT_CRITICAL(&state_ctx.lock);
+    }
+    
+    xSemaphoreGive(state_ctx.persist_mutex);
+    
+    return err;
 }
 
 /**
@@ -408,7 +516,16 @@ esp_err_t state_restore(void)
     }
     
     // Восстанавливаем состояние из NVS
+    xSemaphoreTake(state_ctx.persist_mutex, portMAX_DELAY);
     esp_err_t err = state_restore_from_nvs();
+    if (err == ESP_OK) {
+        taskENTER_CRITICAL(&state_ctx.lock);
+        state_ctx.persisted = state_ctx.state;
+        state_ctx.dirty_mask = 0;
+        taskEXIT_CRITICAL(&state_ctx.lock);
+    }
+    xSemaphoreGive(state_ctx.persist_mutex);
+    
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Ошибка восстановления из NVS: %s", esp_err_to_name(err));
         return err;
@@ -451,12 +568,14 @@ esp_err_t state_factory_reset(void)
     }
     
     // Устанавливаем заводские настройки
+    state_publish_begin();
     state_ctx.state.mode = WINDOW_MODE_CLOSED;
     state_ctx.state.handle_pos = HANDLE_POSITION_CLOSED;
     state_ctx.state.gap_percentage = 0;
     state_ctx.state.calibrated = false;
     state_ctx.state.in_motion = false;
     state_update_last_action_time();
+    state_publish_end();
     
     // Применяем заводские настройки
     // Устанавливаем положение ручки
@@ -473,17 +592,26 @@ esp_err_t state_factory_reset(void)
         return err;
     }
     
-    // Если NVS открыт, очищаем данные
-    if (state_ctx.nvs_opened) {
+    // Если NVS открыт, очищаем данные (после очистки загружаются заводские значения)
+    if (state_ctx.nvs_opened && state_ctx.persist_mutex != NULL) {
+        xSemaphoreTake(state_ctx.persist_mutex, portMAX_DELAY);
+        
         err = nvs_erase_all(state_ctx.nvs_handle);
-        if (err != ESP_OK) {
-            ESP_LOGE(TAG, "Ошибка очистки NVS: %s", esp_err_to_name(err));
-            return err;
+        if (err == ESP_OK) {
+            err = nvs_commit(state_ctx.nvs_handle);
+        }
+        
+        if (err == ESP_OK) {
+            taskENTER_CRITICAL(&state_ctx.lock);
+            state_ctx.persisted = state_ctx.state;
+            state_ctx.dirty_mask = 0;
+            taskEXIT_CRITICAL(&state_ctx.lock);
         }
         
-        err = nvs_commit(state_ctx.nvs_handle);
+        xSemaphoreGive(state_ctx.persist_mutex);
+        
         if (err != ESP_OK) {
-            ESP_LOGE(TAG, "Ошибка коммита NVS: %s", esp_err_to_name(err));
+            ESP_LOGE(TAG, "Ошибка очистки NVS: %s", esp_err_to_name(err));
             return err;
         }
     }
@@ -506,25 +634,16 @@ esp_err_t state_task_handler(void)
         return ESP_ERR_INVALID_STATE;
     }
     
-    // Проверяем необходимость автоматического сохранения
-    if (state_ctx.config.save_to_nvs && state_ctx.nvs_opened) {
-        uint64_t current_time = esp_timer_get_time() / 1000; // мс
-        
-        // Если прошел интервал сохранения, сохраняем состояние
-        if (current_time - state_ctx.last_save_time >= state_ctx.config.save_interval_ms) {
-            ESP_LOGI(TAG, "Автоматическое сохранение состояния");
-            state_save_to_nvs();
-            state_ctx.last_save_time = current_time;
-        }
-    }
-    
     // Проверяем статус движения
-    if (state_ctx.state.in_motion) {
+    window_state_t state = state_snapshot();
+    if (state.in_motion) {
         uint64_t current_time = esp_timer_get_time() / 1000; // мс
         
         // Если прошло больше 5 секунд с последнего действия, считаем что движение завершено
-        if (current_time - state_ctx.state.last_action_time >= 5000) {
+        if (current_time - state.last_action_time >= 5000) {
+            state_publish_begin();
             state_ctx.state.in_motion = false;
+            state_publish_end();
             ESP_LOGI(TAG, "Движение завершено");
         }
     }
@@ -534,39 +653,38 @@ esp_err_t state_task_handler(void)
 
 /**
  * @brief Внутренняя функция сохранения состояния в NVS
+ * 
+ * Запись выполняется, только если измененные поля отличаются от записанных
+ * ранее; иначе NVS не затрагивается. Вызывается под persist_mutex.
  */
-static esp_err_t state_save_to_nvs(void)
+static esp_err_t state_save_to_nvs(uint32_t dirty, const window_state_t *snapshot)
 {
     if (!state_ctx.nvs_opened) {
         ESP_LOGE(TAG, "NVS не открыта");
         return ESP_ERR_INVALID_STATE;
     }
     
-    // Сохраняем режим работы
-    esp_err_t err = nvs_set_u8(state_ctx.nvs_handle, NVS_KEY_MODE, (uint8_t)state_ctx.state.mode);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Ошибка сохранения режима: %s", esp_err_to_name(err));
-        return err;
-    }
-    
-    // Сохраняем положение ручки
-    err = nvs_set_u8(state_ctx.nvs_handle, NVS_KEY_HANDLE_POS, (uint8_t)state_ctx.state.handle_pos);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Ошибка сохранения положения ручки: %s", esp_err_to_name(err));
-        return err;
+    if (dirty == 0 ||
+        (snapshot->mode == state_ctx.persisted.mode &&
+         snapshot->handle_pos == state_ctx.persisted.handle_pos &&
+         snapshot->gap_percentage == state_ctx.persisted.gap_percentage &&
+         snapshot->calibrated == state_ctx.persisted.calibrated)) {
+        return ESP_OK;
     }
     
-    // Сохраняем процент открытия зазора
-    err = nvs_set_u8(state_ctx.nvs_handle, NVS_KEY_GAP_PERCENTAGE, state_ctx.state.gap_percentage);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Ошибка сохранения процента открытия: %s", esp_err_to_name(err));
-        return err;
-    }
+    state_record_t record = {
+        .version = STATE_RECORD_VERSION,
+        .mode = (uint8_t)snapshot->mode,
+        .handle_pos = (uint8_t)snapshot->handle_pos,
+        .gap_percentage = snapshot->gap_percentage,
+        .flags = snapshot->calibrated ? STATE_RECORD_FLAG_CALIBRATED : 0
+    };
+    state_record_seal(&record);
     
-    // Сохраняем статус калибровки
-    err = nvs_set_u8(state_ctx.nvs_handle, NVS_KEY_CALIBRATED, state_ctx.state.calibrated ? 1 : 0);
+    // Запись целиком заменяет предыдущую, поэтому поля не расходятся при сбое питания
+    esp_err_t err = nvs_set_blob(state_ctx.nvs_handle, NVS_KEY_STATE, &record, sizeof(record));
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Ошибка сохранения статуса калибровки: %s", esp_err_to_name(err));
+        ESP_LOGE(TAG, "Ошибка сохранения состояния: %s", esp_err_to_name(err));
         return err;
     }
     
@@ -577,6 +695,12 @@ static esp_err_t state_save_to_nvs(void)
         return err;
     }
     
+    state_ctx.persisted.mode = snapshot->mode;
+    state_ctx.persisted.handle_pos = snapshot->handle_pos;
+    state_ctx.persisted.gap_percentage = snapshot->gap_percentage;
+    state_ctx.persisted.calibrated = snapshot->calibrated;
+    state_ctx.last_save_time = esp_timer_get_time() / 1000; // мс
+    
     ESP_LOGI(TAG, "Состояние успешно сохранено в NVS");
     
     return ESP_OK;
@@ -592,46 +716,158 @@ static esp_err_t state_restore_from_nvs(void)
         return ESP_ERR_INVALID_STATE;
     }
     
-    // Временные переменные для восстановления
-    uint8_t mode_val, handle_pos_val, gap_percentage_val, calibrated_val;
+    state_record_t record;
     
-    // Восстанавливаем режим работы
-    esp_err_t err = nvs_get_u8(state_ctx.nvs_handle, NVS_KEY_MODE, &mode_val);
-    if (err == ESP_OK) {
-        state_ctx.state.mode = (window_mode_t)mode_val;
-    } else if (err != ESP_ERR_NVS_NOT_FOUND) {
-        ESP_LOGE(TAG, "Ошибка восстановления режима: %s", esp_err_to_name(err));
-        return err;
+    // Одно чтение записи вместо поиска каждого ключа
+    esp_err_t err = state_read_record(&record);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        err = state_migrate_legacy(&record);
+        if (err == ESP_ERR_NVS_NOT_FOUND) {
+            // Состояние еще не сохранялось
+            return ESP_OK;
+        }
     }
     
-    // Восстанавливаем положение ручки
-    err = nvs_get_u8(state_ctx.nvs_handle, NVS_KEY_HANDLE_POS, &handle_pos_val);
-    if (err == ESP_OK) {
-        state_ctx.state.handle_pos = (handle_position_t)handle_pos_val;
-    } else if (err != ESP_ERR_NVS_NOT_FOUND) {
-        ESP_LOGE(TAG, "Ошибка восстановления положения ручки: %s", esp_err_to_name(err));
+    if (err != ESP_OK) {
+        // Поврежденное состояние не применяется, запись будет перезаписана при первом изменении
+        ESP_LOGE(TAG, "Сохраненное состояние отклонено: %s", esp_err_to_name(err));
         return err;
     }
     
-    // Восстанавливаем процент открытия зазора
-    err = nvs_get_u8(state_ctx.nvs_handle, NVS_KEY_GAP_PERCENTAGE, &gap_percentage_val);
-    if (err == ESP_OK) {
-        state_ctx.state.gap_percentage = gap_percentage_val;
-    } else if (err != ESP_ERR_NVS_NOT_FOUND) {
-        ESP_LOGE(TAG, "Ошибка восстановления процента открытия: %s", esp_err_to_name(err));
+    state_publish_begin();
+    state_ctx.state.mode = (window_mode_t)record.mode;
+    state_ctx.state.handle_pos = (handle_position_t)record.handle_pos;
+    state_ctx.state.gap_percentage = record.gap_percentage;
+    state_ctx.state.calibrated = (record.flags & STATE_RECORD_FLAG_CALIBRATED) != 0;
+    state_publish_end();
+    
+    ESP_LOGI(TAG, "Состояние успешно восстановлено из NVS");
+    
+    return ESP_OK;
+}
+
+/**
+ * @brief Расчет CRC32 записи состояния
+ */
+static void state_record_seal(state_record_t *record)
+{
+    record->crc = esp_rom_crc32_le(0, (const uint8_t *)record, offsetof(state_record_t, crc));
+}
+
+/**
+ * @brief Чтение и проверка записи состояния
+ * 
+ * @return ESP_ERR_NVS_NOT_FOUND, если записи нет; ESP_ERR_INVALID_SIZE,
+ *         ESP_ERR_INVALID_CRC или ESP_ERR_INVALID_VERSION для поврежденной записи
+ */
+static esp_err_t state_read_record(state_record_t *record)
+{
+    size_t size = sizeof(state_record_t);
+    esp_err_t err = nvs_get_blob(state_ctx.nvs_handle, NVS_KEY_STATE, record, &size);
+    if (err == ESP_ERR_NVS_INVALID_LENGTH) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (err != ESP_OK) {
         return err;
     }
     
-    // Восстанавливаем статус калибровки
-    err = nvs_get_u8(state_ctx.nvs_handle, NVS_KEY_CALIBRATED, &calibrated_val);
+    if (size == 0) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    
+    // Более новые форматы не читаются (откат прошивки после обновления)
+    if (record->version > STATE_RECORD_VERSION) {
+        return ESP_ERR_INVALID_VERSION;
+    }
+    
+    // Переходы со старых версий записи добавляются здесь по мере изменения формата,
+    // каждая версия приводится к следующей до STATE_RECORD_VERSION
+    if (size != sizeof(state_record_t)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    
+    uint32_t crc = record->crc;
+    state_record_seal(record);
+    if (record->crc != crc) {
+        return ESP_ERR_INVALID_CRC;
+    }
+    
+    if (record->mode > WINDOW_MODE_CUSTOM ||
+        (record->handle_pos != HANDLE_POSITION_CLOSED &&
+         record->handle_pos != HANDLE_POSITION_OPEN &&
+         record->handle_pos != HANDLE_POSITION_VENTILATE) ||
+        record->gap_percentage > 100) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    return ESP_OK;
+}
+
+/**
+ * @brief Перенос состояния из ключей устаревшего формата в запись
+ * 
+ * Понимает раскладку ключей обеих прошивок ("mode"/"handle_pos" и "window_mode").
+ * После записи новой записи старые ключи удаляются.
+ * 
+ * @return ESP_ERR_NVS_NOT_FOUND, если старых ключей нет
+ */
+static esp_err_t state_migrate_legacy(state_record_t *record)
+{
+    uint8_t mode;
+    uint8_t handle_pos;
+    uint8_t gap = 0;
+    uint8_t calibrated = 0;
+    
+    esp_err_t err = nvs_get_u8(state_ctx.nvs_handle, NVS_KEY_LEGACY_MODE, &mode);
     if (err == ESP_OK) {
-        state_ctx.state.calibrated = (calibrated_val == 1);
-    } else if (err != ESP_ERR_NVS_NOT_FOUND) {
-        ESP_LOGE(TAG, "Ошибка восстановления статуса калибровки: %s", esp_err_to_name(err));
+        if (nvs_get_u8(state_ctx.nvs_handle, NVS_KEY_LEGACY_HANDLE_POS, &handle_pos) != ESP_OK) {
+            handle_pos = HANDLE_POSITION_CLOSED;
+        }
+    } else if (err == ESP_ERR_NVS_NOT_FOUND) {
+        // Прошивка main хранила только режим (0 - закрыто, 1 - открыто, 2 - проветривание),
+        // положение ручки однозначно следует из него
+        err = nvs_get_u8(state_ctx.nvs_handle, NVS_KEY_LEGACY_WINDOW_MODE, &mode);
+        handle_pos = mode == WINDOW_MODE_OPEN ? HANDLE_POSITION_OPEN :
+                     mode == WINDOW_MODE_VENTILATE ? HANDLE_POSITION_VENTILATE : HANDLE_POSITION_CLOSED;
+    }
+    if (err != ESP_OK) {
         return err;
     }
     
-    ESP_LOGI(TAG, "Состояние успешно восстановлено из NVS");
+    nvs_get_u8(state_ctx.nvs_handle, NVS_KEY_LEGACY_GAP, &gap);
+    nvs_get_u8(state_ctx.nvs_handle, NVS_KEY_LEGACY_CALIBRATED, &calibrated);
+    
+    if (handle_pos != HANDLE_POSITION_OPEN && handle_pos != HANDLE_POSITION_VENTILATE) {
+        handle_pos = HANDLE_POSITION_CLOSED;
+    }
+    
+    record->version = STATE_RECORD_VERSION;
+    record->mode = mode <= WINDOW_MODE_CUSTOM ? mode : WINDOW_MODE_CLOSED;
+    record->handle_pos = handle_pos;
+    record->gap_percentage = gap <= 100 ? gap : 0;
+    record->flags = calibrated == 1 ? STATE_RECORD_FLAG_CALIBRATED : 0;
+    state_record_seal(record);
+    
+    err = nvs_set_blob(state_ctx.nvs_handle, NVS_KEY_STATE, record, sizeof(state_record_t));
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Ошибка записи перенесенного состояния: %s", esp_err_to_name(err));
+        return ESP_OK; // Значения прочитаны, перенос повторится при следующем восстановлении
+    }
+    
+    static const char *legacy_keys[] = {
+        NVS_KEY_LEGACY_MODE, NVS_KEY_LEGACY_HANDLE_POS, NVS_KEY_LEGACY_GAP,
+        NVS_KEY_LEGACY_CALIBRATED, NVS_KEY_LEGACY_WINDOW_MODE, NVS_KEY_LEGACY_ACTIVITY
+    };
+    for (size_t i = 0; i < sizeof(legacy_keys) / sizeof(legacy_keys[0]); i++) {
+        nvs_erase_key(state_ctx.nvs_handle, legacy_keys[i]);
+    }
+    
+    err = nvs_commit(state_ctx.nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Ошибка фиксации перенесенного состояния: %s", esp_err_to_name(err));
+    } else {
+        ESP_LOGI(TAG, "Состояние перенесено из ключей устаревшего формата");
+    }
     
     return ESP_OK;
 }
@@ -674,8 +910,94 @@ static void state_close_nvs(void)
 
 /**
  * @brief Внутренняя функция обновления времени последнего действия
+ * 
+ * Вызывается между state_publish_begin() и state_publish_end().
  */
 static void state_update_last_action_time(void)
 {
     state_ctx.state.last_action_time = esp_timer_get_time() / 1000; // мс
-} 
\ No newline at end of file
+}
+
+/**
+ * @brief Начало изменения состояния
+ */
+static void state_publish_begin(void)
+{
+    taskENTER_CRITICAL(&state_ctx.lock);
+    seqlock_write_begin(&state_ctx.seq);
+}
+
+/**
+ * @brief Публикация измененного состояния для читателей
+ */
+static void state_publish_end(void)
+{
+    seqlock_write_end(&state_ctx.seq);
+    taskEXIT_CRITICAL(&state_ctx.lock);
+}
+
+/**
+ * @brief Согласованный снимок состояния без блокировки
+ * 
+ * Копия повторяется, если во время чтения состояние было изменено.
+ */
+static window_state_t state_snapshot(void)
+{
+    window_state_t snapshot;
+    uint32_t seq;
+    
+    do {
+        seq = seqlock_read_begin(&state_ctx.seq);
+        snapshot = state_ctx.state;
+    } while (seqlock_read_retry(&state_ctx.seq, seq));
+    
+    return snapshot;
+}
+
+/**
+ * @brief Пометка полей измененными и запуск отложенной записи
+ */
+static void state_mark_dirty(uint32_t fields)
+{
+    if (!state_ctx.config.save_to_nvs) {
+        return;
+    }
+    
+    taskENTER_CRITICAL(&state_ctx.lock);
+    state_ctx.dirty_mask |= fields;
+    taskEXIT_CRITICAL(&state_ctx.lock);
+    
+    if (state_ctx.persist_task != NULL) {
+        xTaskNotifyGive(state_ctx.persist_task);
+    }
+}
+
+/**
+ * @brief Задача отложенной записи состояния
+ * 
+ * Запись выполняется после debounce_ms без новых изменений, но не позже
+ * save_interval_ms после первого изменения, поэтому серия команд
+ * приводит к одной фиксации NVS.
+ */
+static void state_persist_task(void *pvParameter)
+{
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        TickType_t first_change = xTaskGetTickCount();
+        
+        // Ожидание паузы в изменениях
+        while (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(state_ctx.config.debounce_ms)) > 0 &&
+               (xTaskGetTickCount() - first_change) < pdMS_TO_TICKS(state_ctx.config.save_interval_ms)) {
+        }
+        
+        state_save();
+    }
+}
+
+/**
+ * @brief Запись несохраненных изменений перед перезагрузкой
+ */
+static void state_shutdown_handler(void)
+{
+    state_save();
+}
@@ -42,7 +42,8 @@ typedef struct {
  */
 typedef struct {
     bool save_to_nvs;             ///< Сохранять состояние в NVS
-    uint32_t save_interval_ms;    ///< Интервал автоматического сохранения (мс)
+    uint32_t debounce_ms;         ///< Пауза без изменений перед записью в NVS (мс)
+    uint32_t save_interval_ms;    ///< Максимальная задержка записи при непрерывных изменениях (мс)
     bool restore_on_boot;         ///< Восстанавливать состояние при загрузке
 } state_config_t;
 
@@ -81,6 +82,9 @@ esp_err_t state_set_gap_percentage(uint8_t percentage);
 /**
  * @brief Получение текущего состояния окна
  * 
+ * Снимок согласован и читается без блокировки; положение ручки и зазора
+ * берется из модуля сервоприводов.
+ * 
  * @return window_state_t Текущее состояние окна
  */
 window_state_t state_get_window_state(void);
@@ -93,7 +97,11 @@ window_state_t state_get_window_state(void);
 window_mode_t state_get_window_mode(void);
 
 /**
- * @brief Сохранение текущего состояния
+ * @brief Немедленная запись несохраненных изменений
+ * 
+ * Изменения состояния записывает фоновая задача после паузы debounce_ms.
+ * Функция вызывается перед сном и перезагрузкой; если изменений нет,
+ * NVS не затрагивается.
  * 
  * @return esp_err_t ESP_OK при успешном сохранении
  */
@@ -9,6 +9,7 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
+#include "freertos/queue.h"
 #include "esp_timer.h"
 
 #define TAG "ZIGBEE_DEVICE"
@@ -18,6 +19,22 @@
 #define ZIGBEE_EVENT_DISCONNECTED   (1 << 1)
 #define ZIGBEE_EVENT_COMMAND        (1 << 2)
 
+// Очередь команд: колбэк библиотеки только копирует команду,
+// обработка выполняется задачей команд модуля
+#define ZIGBEE_CMD_QUEUE_DEPTH      8
+#define ZIGBEE_CMD_MAX_DATA_LEN     8
+
+// Копия принятой команды
+typedef struct {
+    uint8_t cmd;                         // Код команды
+    uint8_t len;                         // Длина данных
+    uint8_t data[ZIGBEE_CMD_MAX_DATA_LEN]; // Данные команды
+} zigbee_command_t;
+
+// Статическая очередь команд
+static StaticQueue_t cmd_queue_buffer;
+static uint8_t cmd_queue_storage[ZIGBEE_CMD_QUEUE_DEPTH * sizeof(zigbee_command_t)];
+
 // Конфигурация ZigBee по умолчанию
 static const esp_zigbee_config_t default_config = {
     .device_name = "ESP32-H2-Window",    // Имя устройства
@@ -25,6 +42,10 @@ static const esp_zigbee_config_t default_config = {
     .channel = 0,                        // Автоматический выбор канала
     .auto_join = true,                   // Автоматическое подключение
     .join_timeout_ms = 30000,            // Таймаут подключения (30 секунд)
+    .queue_depth = 16,                   // Глубина очереди сообщений
+    .queue_policy = ESP_ZIGBEE_QUEUE_COALESCE, // Важно только последнее состояние окна
+    .diag_report_interval_ms = 600000,   // Отчет диагностики раз в 10 минут
+    .adaptive_tx_power = true,           // Мощность передачи по качеству канала
     .on_connected = NULL,                // Будет установлен ниже
     .on_disconnected = NULL,             // Будет установлен ниже
     .on_command = NULL                   // Будет установлен ниже
@@ -38,6 +59,7 @@ static struct {
     uint8_t current_percentage;          // Текущий процент открытия
     TaskHandle_t command_task_handle;    // Задача обработки команд
     EventGroupHandle_t event_group;      // Группа событий
+    QueueHandle_t command_queue;         // Очередь принятых команд
     zigbee_command_callback_t command_callback; // Колбэк команд
 } zigbee_ctx = {
     .initialized = false,
@@ -46,6 +68,7 @@ static struct {
     .current_percentage = 0,
     .command_task_handle = NULL,
     .event_group = NULL,
+    .command_queue = NULL,
     .command_callback = NULL
 };
 
@@ -79,6 +102,9 @@ esp_err_t zigbee_device_init(zigbee_command_callback_t callback)
         return ESP_ERR_NO_MEM;
     }
     
+    zigbee_ctx.command_queue = xQueueCreateStatic(ZIGBEE_CMD_QUEUE_DEPTH, sizeof(zigbee_command_t),
+                                                  cmd_queue_storage, &cmd_queue_buffer);
+    
     // Инициализация ZigBee библиотеки
     esp_zigbee_config_t config = default_config;
     config.on_connected = zigbee_on_connected;
@@ -326,6 +352,7 @@ static void zigbee_command_task(void *pvParameters)
     ESP_LOGI(TAG, "Задача обработки команд ZigBee запущена");
     
     EventBits_t bits;
+    zigbee_command_t command;
     
     while (1) {
         // Ждем событий ZigBee
@@ -369,7 +396,13 @@ static void zigbee_command_task(void *pvParameters)
         
         if (bits & ZIGBEE_EVENT_COMMAND) {
             ESP_LOGI(TAG, "Событие: Получена команда ZigBee");
-            // Обработка команды производится в колбэке zigbee_on_command
+            
+            // Выполняем все накопившиеся команды вне задачи библиотеки
+            while (xQueueReceive(zigbee_ctx.command_queue, &command, 0) == pdPASS) {
+                if (zigbee_ctx.command_callback != NULL) {
+                    zigbee_ctx.command_callback(command.cmd, command.data, command.len);
+                }
+            }
         }
         
         // Обрабатываем входящие команды периодически
@@ -407,13 +440,26 @@ static void zigbee_on_disconnected(void)
  */
 static void zigbee_on_command(uint8_t cmd, const uint8_t *data, uint16_t len)
 {
-    ESP_LOGI(TAG, "Колбэк: Получена команда ZigBee: cmd=%d, len=%d", cmd, len);
+    // Колбэк выполняется в задаче библиотеки: только копируем команду
+    zigbee_command_t command = {
+        .cmd = cmd
+    };
+    
+    if (len > ZIGBEE_CMD_MAX_DATA_LEN) {
+        ESP_LOGW(TAG, "Слишком длинные данные команды %d: %d байт", cmd, len);
+        return;
+    }
     
-    // Устанавливаем событие команды
-    xEventGroupSetBits(zigbee_ctx.event_group, ZIGBEE_EVENT_COMMAND);
+    command.len = (uint8_t)len;
+    if (len > 0) {
+        memcpy(command.data, data, len);
+    }
     
-    // Вызываем пользовательский колбэк, если задан
-    if (zigbee_ctx.command_callback != NULL) {
-        zigbee_ctx.command_callback(cmd, data, len);
+    if (xQueueSend(zigbee_ctx.command_queue, &command, 0) != pdPASS) {
+        ESP_LOGW(TAG, "Очередь команд заполнена, команда %d отброшена", cmd);
+        return;
     }
+    
+    // Будим задачу обработки команд
+    xEventGroupSetBits(zigbee_ctx.event_group, ZIGBEE_EVENT_COMMAND);
 } 
\ No newline at end of file
@@ -0,0 +1,216 @@
+/**
+ * @file automation.c
+ * @brief Реализация правил локальной автоматизации
+ */
+
+#include "automation.h"
+#include <string.h>
+#include "esp_log.h"
+#include "nvs.h"
+
+static const char *TAG = "AUTOMATION";
+
+// Хранение правил в NVS одним блобом
+#define AUTOMATION_NVS_NAMESPACE "automation"
+#define AUTOMATION_NVS_KEY_RULES "rules"
+
+// Признак свободной записи
+#define AUTOMATION_SENSOR_NONE 0xFF
+
+// Биты Alarm1 и Alarm2 статуса зоны IAS
+#define IAS_ZONE_ALARM_BITS 0x0003
+
+// Правило автоматизации (6 байт)
+typedef struct __attribute__((packed)) {
+    uint8_t sensor;           // Тип события датчика (0xFF - запись свободна)
+    uint8_t condition;        // Условие срабатывания
+    int16_t threshold;        // Порог
+    uint8_t window_mode;      // Режим окна при срабатывании
+    uint8_t gap_percentage;   // Процент открытия зазора при срабатывании
+} automation_rule_t;
+
+// Таблица правил: индекс правила задается хабом
+static automation_rule_t rules[AUTOMATION_RULES_SIZE];
+
+// Выполнялось ли условие правила при предыдущем событии
+static bool rule_active[AUTOMATION_RULES_SIZE];
+
+/**
+ * @brief Заполнение таблицы правилами по умолчанию
+ */
+static void automation_load_defaults(void)
+{
+    memset(rules, AUTOMATION_SENSOR_NONE, sizeof(rules));
+    
+    // Датчик дождя или открытия (тревога зоны IAS) - закрыть окно
+    rules[0] = (automation_rule_t) {
+        .sensor = ESP_ZIGBEE_SENSOR_IAS_ZONE,
+        .condition = AUTOMATION_COND_BITS_SET,
+        .threshold = IAS_ZONE_ALARM_BITS,
+        .window_mode = WINDOW_MODE_CLOSED,
+        .gap_percentage = 0
+    };
+    
+    // Температура выше 26 °C - проветривание
+    rules[1] = (automation_rule_t) {
+        .sensor = ESP_ZIGBEE_SENSOR_TEMPERATURE,
+        .condition = AUTOMATION_COND_ABOVE,
+        .threshold = 2600,
+        .window_mode = WINDOW_MODE_VENT,
+        .gap_percentage = 0
+    };
+}
+
+/**
+ * @brief Запись таблицы правил в NVS
+ */
+static esp_err_t automation_save(void)
+{
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(AUTOMATION_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Ошибка открытия NVS: %s", esp_err_to_name(err));
+        return err;
+    }
+    
+    err = nvs_set_blob(handle, AUTOMATION_NVS_KEY_RULES, rules, sizeof(rules));
+    if (err == ESP_OK) {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Ошибка сохранения правил: %s", esp_err_to_name(err));
+    }
+    
+    return err;
+}
+
+/**
+ * @brief Проверка условия правила для значения события
+ */
+static bool automation_condition_met(const automation_rule_t *rule, int32_t value)
+{
+    switch (rule->condition) {
+        case AUTOMATION_COND_EQUAL:
+            return value == rule->threshold;
+        case AUTOMATION_COND_ABOVE:
+            return value > rule->threshold;
+        case AUTOMATION_COND_BELOW:
+            return value < rule->threshold;
+        case AUTOMATION_COND_BITS_SET:
+            return (value & (uint16_t)rule->threshold) != 0;
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief Инициализация правил и загрузка их из NVS
+ */
+esp_err_t automation_init(void)
+{
+    memset(rule_active, 0, sizeof(rule_active));
+    
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(AUTOMATION_NVS_NAMESPACE, NVS_READONLY, &handle);
+    if (err == ESP_OK) {
+        size_t size = sizeof(rules);
+        err = nvs_get_blob(handle, AUTOMATION_NVS_KEY_RULES, rules, &size);
+        nvs_close(handle);
+        
+        if (err == ESP_OK && size == sizeof(rules)) {
+            return ESP_OK;
+        }
+        
+        if (err != ESP_ERR_NVS_NOT_FOUND) {
+            ESP_LOGW(TAG, "Таблица правил повреждена, используются правила по умолчанию");
+        }
+    }
+    
+    // Правила еще не настраивались
+    automation_load_defaults();
+    return ESP_OK;
+}
+
+/**
+ * @brief Запись правила (существующее правило перезаписывается)
+ */
+esp_err_t automation_set_rule(uint8_t index, esp_zigbee_sensor_type_t sensor,
+                              automation_condition_t condition, int16_t threshold,
+                              window_mode_t mode, uint8_t gap_percentage)
+{
+    if (index >= AUTOMATION_RULES_SIZE || sensor > ESP_ZIGBEE_SENSOR_TEMPERATURE ||
+        condition > AUTOMATION_COND_BITS_SET || mode > WINDOW_MODE_VENT || gap_percentage > 100) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    rules[index] = (automation_rule_t) {
+        .sensor = (uint8_t)sensor,
+        .condition = (uint8_t)condition,
+        .threshold = threshold,
+        .window_mode = (uint8_t)mode,
+        .gap_percentage = gap_percentage
+    };
+    rule_active[index] = false;
+    
+    ESP_LOGI(TAG, "Правило %d: датчик=%d, условие=%d, порог=%d, режим=%d, зазор=%d%%",
+             index, sensor, condition, threshold, mode, gap_percentage);
+    
+    return automation_save();
+}
+
+/**
+ * @brief Удаление правила
+ */
+esp_err_t automation_clear_rule(uint8_t index)
+{
+    if (index == AUTOMATION_ALL_RULES) {
+        memset(rules, AUTOMATION_SENSOR_NONE, sizeof(rules));
+        memset(rule_active, 0, sizeof(rule_active));
+    } else if (index < AUTOMATION_RULES_SIZE) {
+        memset(&rules[index], AUTOMATION_SENSOR_NONE, sizeof(automation_rule_t));
+        rule_active[index] = false;
+    } else {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    return automation_save();
+}
+
+/**
+ * @brief Проверка события датчика по таблице правил
+ */
+bool automation_evaluate(const esp_zigbee_sensor_event_t *event, window_mode_t *mode, uint8_t *gap_percentage)
+{
+    if (event == NULL || mode == NULL || gap_percentage == NULL) {
+        return false;
+    }
+    
+    int fired = -1;
+    
+    for (int i = 0; i < AUTOMATION_RULES_SIZE; i++) {
+        if (rules[i].sensor != event->type) {
+            continue;
+        }
+        
+        bool met = automation_condition_met(&rules[i], event->value);
+        
+        // Срабатывание только на переходе условия в истинное
+        if (met && !rule_active[i] && fired < 0) {
+            fired = i;
+        }
+        rule_active[i] = met;
+    }
+    
+    if (fired < 0) {
+        return false;
+    }
+    
+    ESP_LOGI(TAG, "Сработало правило %d (датчик 0x%04X, значение %ld)",
+             fired, event->src_addr, (long)event->value);
+    
+    *mode = (window_mode_t)rules[fired].window_mode;
+    *gap_percentage = rules[fired].gap_percentage;
+    return true;
+}
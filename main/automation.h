@@ -0,0 +1,83 @@
+/**
+ * @file automation.h
+ * @brief Правила локальной автоматизации по событиям привязанных датчиков
+ */
+
+#ifndef AUTOMATION_H
+#define AUTOMATION_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "servo_control.h"
+#include "esp_zigbee_lib.h"
+
+/**
+ * @brief Максимальное количество правил
+ */
+#define AUTOMATION_RULES_SIZE 8
+
+/**
+ * @brief Индекс для удаления всех правил
+ */
+#define AUTOMATION_ALL_RULES 0xFF
+
+/**
+ * @brief Условие срабатывания правила
+ */
+typedef enum {
+    AUTOMATION_COND_EQUAL = 0,      ///< Значение равно порогу
+    AUTOMATION_COND_ABOVE = 1,      ///< Значение больше порога
+    AUTOMATION_COND_BELOW = 2,      ///< Значение меньше порога
+    AUTOMATION_COND_BITS_SET = 3    ///< Установлен любой из битов порога
+} automation_condition_t;
+
+/**
+ * @brief Инициализация правил и загрузка их из NVS
+ * 
+ * При отсутствии сохраненных правил используются правила по умолчанию:
+ * тревога зоны IAS закрывает окно, температура выше 26 °C включает проветривание.
+ * 
+ * @return esp_err_t ESP_OK при успешной инициализации
+ */
+esp_err_t automation_init(void);
+
+/**
+ * @brief Запись правила (существующее правило перезаписывается)
+ * 
+ * @param index Индекс правила (0 - AUTOMATION_RULES_SIZE-1)
+ * @param sensor Тип события датчика
+ * @param condition Условие срабатывания
+ * @param threshold Порог (для температуры - сотые доли °C)
+ * @param mode Режим окна при срабатывании
+ * @param gap_percentage Процент открытия зазора при срабатывании
+ * @return esp_err_t ESP_OK при успешной записи
+ */
+esp_err_t automation_set_rule(uint8_t index, esp_zigbee_sensor_type_t sensor,
+                              automation_condition_t condition, int16_t threshold,
+                              window_mode_t mode, uint8_t gap_percentage);
+
+/**
+ * @brief Удаление правила
+ * 
+ * @param index Индекс правила или AUTOMATION_ALL_RULES
+ * @return esp_err_t ESP_OK при успешном удалении
+ */
+esp_err_t automation_clear_rule(uint8_t index);
+
+/**
+ * @brief Проверка события датчика по таблице правил
+ * 
+ * Правило срабатывает только при переходе условия из ложного в истинное,
+ * поэтому повторные отчеты датчика не двигают окно. При одновременном
+ * срабатывании нескольких правил выполняется первое по индексу.
+ * Проверка не выделяет память и проходит таблицу один раз.
+ * 
+ * @param event Событие датчика
+ * @param mode Указатель для записи режима окна
+ * @param gap_percentage Указатель для записи процента открытия зазора
+ * @return bool true, если сработало правило
+ */
+bool automation_evaluate(const esp_zigbee_sensor_event_t *event, window_mode_t *mode, uint8_t *gap_percentage);
+
+#endif /* AUTOMATION_H */
@@ -0,0 +1,62 @@
+/**
+ * @file cmd_dedup.c
+ * @brief Кэш последних команд ZCL для подавления повторов
+ */
+
+#include "cmd_dedup.h"
+#include "esp_timer.h"
+
+// Запись кэша последних команд
+typedef struct {
+    uint16_t src_addr;          // Адрес отправителя
+    uint8_t src_endpoint;       // Эндпоинт отправителя
+    uint8_t tsn;                // Порядковый номер ZCL
+    uint8_t cmd;                // Команда библиотеки (учитывает кластер)
+    bool valid;                 // Запись занята
+    int64_t time_ms;            // Время приема (мс)
+} cmd_dedup_entry_t;
+
+// Кэш используется только из задачи стека ZigBee и не требует блокировки
+static struct {
+    cmd_dedup_entry_t entries[CMD_DEDUP_ENTRIES];
+    uint8_t next;
+} dedup_ctx;
+
+/**
+ * @brief Проверка команды по кэшу последних команд
+ */
+bool cmd_dedup_is_duplicate(uint8_t cmd, const esp_zigbee_cmd_info_t *info)
+{
+    int64_t now_ms = esp_timer_get_time() / 1000;
+    
+    for (uint8_t i = 0; i < CMD_DEDUP_ENTRIES; i++) {
+        const cmd_dedup_entry_t *entry = &dedup_ctx.entries[i];
+        
+        if (entry->valid &&
+            entry->tsn == info->tsn &&
+            entry->src_addr == info->src_addr &&
+            entry->src_endpoint == info->src_endpoint &&
+            entry->cmd == cmd &&
+            now_ms - entry->time_ms < CMD_DEDUP_EXPIRY_MS) {
+            return true;
+        }
+    }
+    
+    return false;
+}
+
+/**
+ * @brief Запись принятой команды
+ */
+void cmd_dedup_record(uint8_t cmd, const esp_zigbee_cmd_info_t *info)
+{
+    cmd_dedup_entry_t *entry = &dedup_ctx.entries[dedup_ctx.next];
+    
+    entry->src_addr = info->src_addr;
+    entry->src_endpoint = info->src_endpoint;
+    entry->tsn = info->tsn;
+    entry->cmd = cmd;
+    entry->valid = true;
+    entry->time_ms = esp_timer_get_time() / 1000;
+    dedup_ctx.next = (dedup_ctx.next + 1) % CMD_DEDUP_ENTRIES;
+}
@@ -0,0 +1,46 @@
+/**
+ * @file cmd_dedup.h
+ * @brief Подавление повторных команд ZCL по источнику и порядковому номеру
+ * 
+ * Хаб повторяет команду, не получив подтверждения, с тем же TSN. Команда
+ * запоминается только после того, как приложение приняло ее к исполнению:
+ * повтор отброшенной команды должен быть выполнен.
+ */
+
+#ifndef CMD_DEDUP_H
+#define CMD_DEDUP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_zigbee_lib.h"
+
+/**
+ * @brief Размер кэша последних команд
+ */
+#define CMD_DEDUP_ENTRIES 8
+
+/**
+ * @brief Время жизни записи, мс (перекрывает повторы APS и ZCL)
+ */
+#define CMD_DEDUP_EXPIRY_MS 10000
+
+/**
+ * @brief Проверка команды по кэшу последних команд
+ * 
+ * Повтор - тот же источник, эндпоинт, TSN и команда в пределах срока жизни записи.
+ * 
+ * @param cmd Команда библиотеки (учитывает кластер)
+ * @param info Источник команды
+ * @return bool true, если команда уже принята к исполнению
+ */
+bool cmd_dedup_is_duplicate(uint8_t cmd, const esp_zigbee_cmd_info_t *info);
+
+/**
+ * @brief Запись принятой команды на место самой старой записи кэша
+ * 
+ * @param cmd Команда библиотеки
+ * @param info Источник команды
+ */
+void cmd_dedup_record(uint8_t cmd, const esp_zigbee_cmd_info_t *info);
+
+#endif /* CMD_DEDUP_H */
@@ -0,0 +1,356 @@
+/**
+ * @file device_config.c
+ * @brief Реализация реестра настраиваемых параметров устройства
+ */
+
+#include "device_config.h"
+#include <string.h>
+#include <stdbool.h>
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+static const char *TAG = "DEVICE_CONFIG";
+
+// Конфигурация хранится одной записью: пакет конфигурации и CRC32 (LE32)
+#define CONFIG_NVS_NAMESPACE    "dev_config"
+#define CONFIG_NVS_KEY          "config"
+#define CONFIG_CRC_SIZE         4
+
+// Запись может быть длиннее текущего пакета, если ее сохранила более новая прошивка
+#define CONFIG_NVS_MAX_LEN      (DEVICE_CONFIG_PACKET_MAX_LEN * 2 + CONFIG_CRC_SIZE)
+
+// Описание параметра
+typedef struct {
+    config_type_t type;     // Тип значения
+    uint32_t min;           // Минимальное допустимое значение
+    uint32_t max;           // Максимальное допустимое значение
+    uint32_t def;           // Значение по умолчанию
+} config_descriptor_t;
+
+// Реестр параметров
+static const config_descriptor_t descriptors[CONFIG_KEY_MAX] = {
+    [CONFIG_KEY_ANGLE_OPEN] = {
+        .type = CONFIG_TYPE_U8, .min = 10, .max = 180, .def = 90
+    },
+    [CONFIG_KEY_ANGLE_VENT] = {
+        .type = CONFIG_TYPE_U8, .min = 10, .max = 180, .def = 180
+    },
+    [CONFIG_KEY_RESISTANCE_THRESHOLD] = {
+        .type = CONFIG_TYPE_U16, .min = 100, .max = 4095, .def = 2000
+    },
+    [CONFIG_KEY_SERVO_STEP_DELAY_MS] = {
+        .type = CONFIG_TYPE_U8, .min = 1, .max = 100, .def = 15
+    },
+    [CONFIG_KEY_POWER_CHECK_INTERVAL_MS] = {
+        .type = CONFIG_TYPE_U32, .min = 1000, .max = 600000, .def = 10000
+    },
+    [CONFIG_KEY_REPORT_INTERVAL_MS] = {
+        .type = CONFIG_TYPE_U32, .min = 1000, .max = 3600000, .def = 10000
+    },
+};
+
+// Текущие значения (выровненные 32-битные слова читаются без блокировки)
+static uint32_t config_values[CONFIG_KEY_MAX];
+
+// Контекст реестра
+static struct {
+    SemaphoreHandle_t mutex;        // Упорядочивание изменений и записи в NVS
+    nvs_handle_t nvs_handle;        // Пространство имен конфигурации
+} config_ctx = {
+    .mutex = NULL
+};
+
+// Прототипы вспомогательных функций
+static size_t config_type_width(config_type_t type);
+static bool config_value_valid(config_key_t key, uint32_t value);
+static esp_err_t config_parse(const uint8_t *data, size_t len, uint32_t *values, bool strict);
+static esp_err_t config_persist(void);
+static void config_load(void);
+
+/**
+ * @brief Размер значения в пакете
+ */
+static size_t config_type_width(config_type_t type)
+{
+    switch (type) {
+        case CONFIG_TYPE_U8:
+            return 1;
+        case CONFIG_TYPE_U16:
+            return 2;
+        case CONFIG_TYPE_U32:
+            return 4;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @brief Проверка значения по диапазону параметра
+ */
+static bool config_value_valid(config_key_t key, uint32_t value)
+{
+    return key < CONFIG_KEY_MAX &&
+           value >= descriptors[key].min && value <= descriptors[key].max;
+}
+
+/**
+ * @brief Разбор пакета конфигурации
+ * 
+ * В строгом режиме (команда хаба) любая неверная запись отклоняет весь пакет.
+ * При чтении из NVS неизвестные ключи пропускаются, а недопустимые значения
+ * остаются значениями по умолчанию.
+ */
+static esp_err_t config_parse(const uint8_t *data, size_t len, uint32_t *values, bool strict)
+{
+    if (len < 2 || data[0] != DEVICE_CONFIG_PACKET_VERSION) {
+        return ESP_ERR_INVALID_VERSION;
+    }
+    
+    uint8_t count = data[1];
+    size_t pos = 2;
+    
+    for (uint8_t i = 0; i < count; i++) {
+        if (pos + 2 > len) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        
+        uint8_t key = data[pos];
+        config_type_t type = (config_type_t)data[pos + 1];
+        size_t width = config_type_width(type);
+        
+        // Без известного типа нельзя найти начало следующей записи
+        if (width == 0 || pos + 2 + width > len) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        
+        uint32_t value = 0;
+        for (size_t b = 0; b < width; b++) {
+            value |= (uint32_t)data[pos + 2 + b] << (8 * b);
+        }
+        pos += 2 + width;
+        
+        if (key >= CONFIG_KEY_MAX || descriptors[key].type != type ||
+            !config_value_valid((config_key_t)key, value)) {
+            if (strict) {
+                ESP_LOGW(TAG, "Недопустимый параметр %d: тип=%d, значение=%lu",
+                         key, type, (unsigned long)value);
+                return ESP_ERR_INVALID_ARG;
+            }
+            continue;
+        }
+        
+        values[key] = value;
+    }
+    
+    if (strict && pos != len) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    
+    return ESP_OK;
+}
+
+/**
+ * @brief Запись текущих значений в NVS (вызывается под mutex)
+ */
+static esp_err_t config_persist(void)
+{
+    uint8_t blob[DEVICE_CONFIG_PACKET_MAX_LEN + CONFIG_CRC_SIZE];
+    size_t len = 0;
+    
+    esp_err_t err = device_config_export(blob, DEVICE_CONFIG_PACKET_MAX_LEN, &len);
+    if (err != ESP_OK) {
+        return err;
+    }
+    
+    uint32_t crc = esp_rom_crc32_le(0, blob, len);
+    for (int b = 0; b < CONFIG_CRC_SIZE; b++) {
+        blob[len++] = (crc >> (8 * b)) & 0xFF;
+    }
+    
+    err = nvs_set_blob(config_ctx.nvs_handle, CONFIG_NVS_KEY, blob, len);
+    if (err == ESP_OK) {
+        err = nvs_commit(config_ctx.nvs_handle);
+    }
+    
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Ошибка сохранения конфигурации: %s", esp_err_to_name(err));
+    }
+    
+    return err;
+}
+
+/**
+ * @brief Чтение сохраненных значений из NVS
+ */
+static void config_load(void)
+{
+    uint8_t blob[CONFIG_NVS_MAX_LEN];
+    size_t len = sizeof(blob);
+    
+    esp_err_t err = nvs_get_blob(config_ctx.nvs_handle, CONFIG_NVS_KEY, blob, &len);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        ESP_LOGI(TAG, "Сохраненной конфигурации нет, используются значения по умолчанию");
+        return;
+    }
+    
+    if (err != ESP_OK || len <= CONFIG_CRC_SIZE) {
+        ESP_LOGW(TAG, "Ошибка чтения конфигурации: %s", esp_err_to_name(err));
+        return;
+    }
+    
+    len -= CONFIG_CRC_SIZE;
+    uint32_t stored_crc = blob[len] | (blob[len + 1] << 8) | (blob[len + 2] << 16) |
+                          ((uint32_t)blob[len + 3] << 24);
+    if (esp_rom_crc32_le(0, blob, len) != stored_crc) {
+        ESP_LOGW(TAG, "Конфигурация повреждена, используются значения по умолчанию");
+        return;
+    }
+    
+    // Значения применяются только из целой записи
+    uint32_t values[CONFIG_KEY_MAX];
+    memcpy(values, config_values, sizeof(values));
+    
+    err = config_parse(blob, len, values, false);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Неверный формат конфигурации: %s", esp_err_to_name(err));
+        return;
+    }
+    
+    memcpy(config_values, values, sizeof(config_values));
+}
+
+/**
+ * @brief Инициализация реестра параметров
+ */
+esp_err_t device_config_init(void)
+{
+    for (int key = 0; key < CONFIG_KEY_MAX; key++) {
+        config_values[key] = descriptors[key].def;
+    }
+    
+    config_ctx.mutex = xSemaphoreCreateMutex();
+    if (config_ctx.mutex == NULL) {
+        ESP_LOGE(TAG, "Не удалось создать мьютекс конфигурации");
+        return ESP_ERR_NO_MEM;
+    }
+    
+    esp_err_t err = nvs_open(CONFIG_NVS_NAMESPACE, NVS_READWRITE, &config_ctx.nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Ошибка открытия NVS: %s", esp_err_to_name(err));
+        return err;
+    }
+    
+    config_load();
+    
+    ESP_LOGI(TAG, "Конфигурация загружена: открыто=%lu°, проветривание=%lu°, порог=%lu",
+             (unsigned long)config_values[CONFIG_KEY_ANGLE_OPEN],
+             (unsigned long)config_values[CONFIG_KEY_ANGLE_VENT],
+             (unsigned long)config_values[CONFIG_KEY_RESISTANCE_THRESHOLD]);
+    return ESP_OK;
+}
+
+/**
+ * @brief Чтение параметра
+ */
+uint32_t device_config_get(config_key_t key)
+{
+    if (key >= CONFIG_KEY_MAX) {
+        return 0;
+    }
+    
+    return config_values[key];
+}
+
+/**
+ * @brief Изменение одного параметра с сохранением в NVS
+ */
+esp_err_t device_config_set(config_key_t key, uint32_t value)
+{
+    if (!config_value_valid(key, value)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    if (config_ctx.mutex == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    xSemaphoreTake(config_ctx.mutex, portMAX_DELAY);
+    esp_err_t err = ESP_OK;
+    if (config_values[key] != value) {
+        config_values[key] = value;
+        err = config_persist();
+    }
+    xSemaphoreGive(config_ctx.mutex);
+    
+    return err;
+}
+
+/**
+ * @brief Выгрузка всех параметров в пакет конфигурации
+ */
+esp_err_t device_config_export(uint8_t *buf, size_t buf_size, size_t *out_len)
+{
+    if (buf == NULL || out_len == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    size_t pos = 2;
+    for (int key = 0; key < CONFIG_KEY_MAX; key++) {
+        size_t width = config_type_width(descriptors[key].type);
+        if (pos + 2 + width > buf_size) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        
+        uint32_t value = config_values[key];
+        buf[pos] = (uint8_t)key;
+        buf[pos + 1] = (uint8_t)descriptors[key].type;
+        for (size_t b = 0; b < width; b++) {
+            buf[pos + 2 + b] = (value >> (8 * b)) & 0xFF;
+        }
+        pos += 2 + width;
+    }
+    
+    buf[0] = DEVICE_CONFIG_PACKET_VERSION;
+    buf[1] = CONFIG_KEY_MAX;
+    
+    *out_len = pos;
+    return ESP_OK;
+}
+
+/**
+ * @brief Применение пакета конфигурации с сохранением в NVS
+ */
+esp_err_t device_config_import(const uint8_t *data, size_t len)
+{
+    if (data == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    if (config_ctx.mutex == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    xSemaphoreTake(config_ctx.mutex, portMAX_DELAY);
+    
+    uint32_t values[CONFIG_KEY_MAX];
+    memcpy(values, config_values, sizeof(values));
+    
+    esp_err_t err = config_parse(data, len, values, true);
+    if (err == ESP_OK && memcmp(values, config_values, sizeof(values)) != 0) {
+        // Каждое значение - одно слово, читатели видят старое или новое значение
+        for (int key = 0; key < CONFIG_KEY_MAX; key++) {
+            config_values[key] = values[key];
+        }
+        err = config_persist();
+        if (err == ESP_OK) {
+            ESP_LOGI(TAG, "Конфигурация обновлена");
+        }
+    }
+    
+    xSemaphoreGive(config_ctx.mutex);
+    
+    return err;
+}
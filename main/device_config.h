@@ -0,0 +1,105 @@
+/**
+ * @file device_config.h
+ * @brief Настраиваемые параметры устройства
+ * 
+ * Реестр параметров (ключ, тип, диапазон, значение по умолчанию) хранится
+ * в RAM и сохраняется в NVS одной записью с CRC32. Модули читают значения
+ * через device_config_get() без обращения к флеш, поэтому параметры можно
+ * менять по ZigBee без обновления прошивки.
+ * 
+ * Пакет конфигурации: версия (1 байт), число записей N (1 байт), далее
+ * N записей: ключ (1 байт), тип (1 байт), значение (LE, 1/2/4 байта по типу).
+ * Тот же формат используется для чтения атрибута, команды записи и NVS.
+ */
+
+#ifndef DEVICE_CONFIG_H
+#define DEVICE_CONFIG_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+/**
+ * @brief Версия формата пакета конфигурации
+ */
+#define DEVICE_CONFIG_PACKET_VERSION 1
+
+/**
+ * @brief Максимальная длина пакета со всеми параметрами
+ */
+#define DEVICE_CONFIG_PACKET_MAX_LEN 32
+
+/**
+ * @brief Типы значений параметров
+ */
+typedef enum {
+    CONFIG_TYPE_U8 = 1,             ///< uint8_t
+    CONFIG_TYPE_U16 = 2,            ///< uint16_t
+    CONFIG_TYPE_U32 = 3             ///< uint32_t
+} config_type_t;
+
+/**
+ * @brief Ключи параметров (значения ключей передаются по ZigBee и не меняются)
+ */
+typedef enum {
+    CONFIG_KEY_ANGLE_OPEN = 0,              ///< Угол ручки в режиме "открыто", градусы (U8)
+    CONFIG_KEY_ANGLE_VENT = 1,              ///< Угол ручки в режиме проветривания, градусы (U8)
+    CONFIG_KEY_RESISTANCE_THRESHOLD = 2,    ///< Порог датчика тока для обнаружения сопротивления (U16)
+    CONFIG_KEY_SERVO_STEP_DELAY_MS = 3,     ///< Пауза между шагами плавного движения, мс (U8)
+    CONFIG_KEY_POWER_CHECK_INTERVAL_MS = 4, ///< Период проверки питания, мс (U32)
+    CONFIG_KEY_REPORT_INTERVAL_MS = 5,      ///< Период отправки состояния в ZigBee, мс (U32)
+    CONFIG_KEY_MAX
+} config_key_t;
+
+/**
+ * @brief Инициализация реестра параметров
+ * 
+ * Читает сохраненные значения из NVS. Отсутствующие или недопустимые
+ * значения заменяются значениями по умолчанию.
+ * 
+ * @return esp_err_t ESP_OK при успешной инициализации
+ */
+esp_err_t device_config_init(void);
+
+/**
+ * @brief Чтение параметра
+ * 
+ * Значение берется из RAM, функцию можно вызывать из любой задачи.
+ * 
+ * @param key Ключ параметра
+ * @return uint32_t Текущее значение (0 при неизвестном ключе)
+ */
+uint32_t device_config_get(config_key_t key);
+
+/**
+ * @brief Изменение одного параметра с сохранением в NVS
+ * 
+ * @param key Ключ параметра
+ * @param value Новое значение
+ * @return esp_err_t ESP_ERR_INVALID_ARG, если значение вне допустимого диапазона
+ */
+esp_err_t device_config_set(config_key_t key, uint32_t value);
+
+/**
+ * @brief Выгрузка всех параметров в пакет конфигурации
+ * 
+ * @param buf Буфер для пакета
+ * @param buf_size Размер буфера
+ * @param out_len Длина пакета
+ * @return esp_err_t ESP_OK при успешной выгрузке
+ */
+esp_err_t device_config_export(uint8_t *buf, size_t buf_size, size_t *out_len);
+
+/**
+ * @brief Применение пакета конфигурации с сохранением в NVS
+ * 
+ * Пакет может содержать часть параметров. Изменения применяются, только
+ * если все записи пакета допустимы.
+ * 
+ * @param data Пакет конфигурации
+ * @param len Длина пакета
+ * @return esp_err_t ESP_ERR_INVALID_ARG при неизвестном ключе, неверном типе или значении
+ */
+esp_err_t device_config_import(const uint8_t *data, size_t len);
+
+#endif /* DEVICE_CONFIG_H */
@@ -6,36 +6,124 @@
  */
 
 #include "esp_zigbee_lib.h"
+#include "cmd_dedup.h"
+#include "report_dest.h"
+#include "rejoin_backoff.h"
 #include "esp_log.h"
 #include "esp_err.h"
 #include <string.h>
 #include <stdlib.h>
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 
 // Включение официальных заголовочных файлов ESP-ZB стека
 #include "esp_zb_device.h"
+#include "esp_zb_zdo.h"
 #include "esp_zb_zcl.h"
 #include "esp_zb_zcl_window_covering.h"
 
 static const char *TAG = "ESP_ZIGBEE_LIB";
 
+// Параметры механизма переподключения
+#define REJOIN_FAST_ATTEMPTS    2        // Попыток быстрого переподключения к родителю
+
+// Получатель по умолчанию
+#define COORDINATOR_ADDR        REPORT_DEST_COORDINATOR_ADDR
+#define COORDINATOR_ENDPOINT    REPORT_DEST_COORDINATOR_EP
+
+// Параметры роли маршрутизатора
+#define ROUTER_MAX_CHILDREN     10       // Максимум дочерних конечных устройств
+
+// Параметры кластера Diagnostics
+#define DIAG_REFRESH_MS         600000   // Обновление атрибутов из счетчиков стека (10 минут)
+
+// Параметры надежной доставки отчетов
+#define REPORT_MAX_RETRIES      5        // Повторов после потери APS-подтверждения
+#define REPORT_BASE_DELAY_MS    500      // Базовая задержка перед повтором (мс)
+#define REPORT_MAX_DELAY_MS     30000    // Максимальная задержка перед повтором (мс)
+#define REPORT_ACK_TIMEOUT_MS   3000     // Ожидание статуса отправки от стека (мс)
+
+// Слоты надежной доставки: атрибуты Window Covering и по одному на тип уведомления
+#define REPORT_SLOT_ATTRS       0
+#define REPORT_SLOT_ALERT_BASE  1
+#define REPORT_SLOT_COUNT       (REPORT_SLOT_ALERT_BASE + ESP_ZIGBEE_ALERT_PROTECTION + 1)
+
+// Слот надежной доставки: последнее неподтвержденное значение. Атрибуты
+// берутся из таблицы кластера в момент отправки, поэтому новое значение
+// замещает старое без отдельной копии
+typedef struct {
+    bool pending;               // Значение ожидает подтверждения
+    bool in_flight;             // Кадры отправлены, ждем статусов от стека
+    uint8_t attempts;           // Выполнено попыток отправки
+    uint8_t generation;         // Номер значения (меняется при замещении)
+    uint8_t alarm_code;         // Код уведомления (только слоты уведомлений)
+    uint8_t unacked;            // Маска получателей без APS-подтверждения
+    uint8_t tsn[REPORT_DEST_MAX]; // Порядковый номер ZCL кадра каждому получателю
+    int64_t next_try_ms;        // Время повтора или конца ожидания статуса (мс)
+} report_slot_t;
+
+// Этапы переподключения к сети
+typedef enum {
+    REJOIN_STAGE_FAST = 0,  // Быстрое переподключение на известном канале и PAN
+    REJOIN_STAGE_SCAN = 1   // Полное сканирование маски каналов
+} rejoin_stage_t;
+
 // Контекст библиотеки
 static struct {
     bool initialized;
     bool started;
     bool pairing_enabled;
+    bool connected;
     esp_zigbee_config_t config;
+    esp_zigbee_network_info_t restore_network;
+    bool has_restore_network;
     esp_zigbee_device_type_t device_type;
     esp_zb_ep_handle_t window_ep;
     uint8_t endpoint_id;
+    bool rejoin_active;
+    rejoin_stage_t rejoin_stage;
+    rejoin_backoff_t rejoin_backoff;
+    uint32_t rejoin_saved_mask;
+    bool rejoin_mask_saved;
+    uint32_t duplicates_suppressed;
+    uint16_t parent_address;
+    bool parent_known;
+    uint32_t parent_changes;
+    SemaphoreHandle_t leave_done;
 } zigbee_ctx = {
     .initialized = false,
     .started = false,
     .pairing_enabled = false,
+    .connected = false,
+    .has_restore_network = false,
     .device_type = ESP_ZIGBEE_DEVICE_TYPE_END_DEVICE,
     .window_ep = NULL,
-    .endpoint_id = 1
+    .endpoint_id = 1,
+    .rejoin_active = false,
+    .rejoin_stage = REJOIN_STAGE_FAST,
+    .rejoin_mask_saved = false,
+    .duplicates_suppressed = 0,
+    .parent_address = 0,
+    .parent_known = false,
+    .parent_changes = 0,
+    .leave_done = NULL
 };
 
+// Слоты надежной доставки и счетчики эффективности: значения принимаются
+// задачами приложения, отправляются и подтверждаются в контексте стека
+static struct {
+    report_slot_t slots[REPORT_SLOT_COUNT];
+    uint32_t submitted;
+    uint32_t delivered;
+    uint32_t superseded;
+    uint32_t abandoned;
+    uint32_t frames;
+} report_ctx;
+
+static portMUX_TYPE report_slot_lock = portMUX_INITIALIZER_UNLOCKED;
+
 // Идентификаторы кластера и атрибутов
 #define WINDOW_COVERING_CLUSTER_ID        0x0102
 #define WINDOW_COVERING_TYPE_ATTRIBUTE_ID 0x0000
@@ -48,6 +136,100 @@ static struct {
 #define WINDOW_COVERING_STOP_CMD_ID       0x02
 #define WINDOW_COVERING_GO_TO_POS_CMD_ID  0x05
 
+// Собственные команды производителя кластера Window Covering
+#define WINDOW_COVERING_SET_SCHEDULE_CMD_ID   0xF0
+#define WINDOW_COVERING_CLEAR_SCHEDULE_CMD_ID 0xF1
+#define WINDOW_COVERING_SET_RULE_CMD_ID       0xF2
+#define WINDOW_COVERING_CLEAR_RULE_CMD_ID     0xF3
+#define WINDOW_COVERING_READ_HISTORY_CMD_ID   0xF4
+#define WINDOW_COVERING_WRITE_CONFIG_CMD_ID   0xF5
+
+// Кластеры групп и сцен
+#define GROUPS_CLUSTER_ID                 0x0004
+#define SCENES_CLUSTER_ID                 0x0005
+
+// Идентификаторы команд кластера сцен
+#define SCENES_REMOVE_CMD_ID              0x02
+#define SCENES_REMOVE_ALL_CMD_ID          0x03
+#define SCENES_STORE_CMD_ID               0x04
+#define SCENES_RECALL_CMD_ID              0x05
+
+// Кластер времени (клиент)
+#define TIME_CLUSTER_ID                   0x000A
+#define TIME_LOCAL_TIME_ATTRIBUTE_ID      0x0007
+
+// Клиентские кластеры для событий привязанных датчиков
+#define ON_OFF_CLUSTER_ID                 0x0006
+#define ON_OFF_OFF_CMD_ID                 0x00
+#define ON_OFF_ON_CMD_ID                  0x01
+#define IAS_ZONE_CLUSTER_ID               0x0500
+#define IAS_ZONE_STATUS_CHANGE_CMD_ID     0x00
+#define TEMP_MEASUREMENT_CLUSTER_ID       0x0402
+#define TEMP_MEASURED_VALUE_ATTRIBUTE_ID  0x0000
+#define TEMP_MEASURED_VALUE_INVALID       ((int16_t)0x8000)
+
+// Кластер OTA Upgrade (клиент, сервер обновлений - координатор)
+#define OTA_UPGRADE_CLUSTER_ID            0x0019
+
+// Кластер Diagnostics (сервер): счетчики MAC и APS из стека
+#define DIAGNOSTICS_CLUSTER_ID            0x0B05
+#define DIAG_MAC_RX_UCAST_ATTRIBUTE_ID    0x0102
+#define DIAG_MAC_TX_UCAST_ATTRIBUTE_ID    0x0103
+#define DIAG_MAC_TX_RETRY_ATTRIBUTE_ID    0x0104
+#define DIAG_MAC_TX_FAIL_ATTRIBUTE_ID     0x0105
+#define DIAG_APS_TX_FAIL_ATTRIBUTE_ID     0x010B
+#define DIAG_LAST_LQI_ATTRIBUTE_ID        0x011C
+#define DIAG_LAST_RSSI_ATTRIBUTE_ID       0x011D
+
+// Счетчики библиотеки без стандартного атрибута (атрибуты производителя)
+#define DIAG_PARENT_CHANGES_ATTRIBUTE_ID  0xF000
+#define DIAG_DUPLICATES_ATTRIBUTE_ID      0xF001
+
+// Значения атрибутов кластера Diagnostics
+static struct {
+    uint32_t mac_rx_ucast;
+    uint32_t mac_tx_ucast;
+    uint16_t mac_tx_retry;
+    uint16_t mac_tx_fail;
+    uint16_t aps_tx_fail;
+    uint8_t last_lqi;
+    int8_t last_rssi;
+    uint32_t parent_changes;
+    uint32_t duplicates;
+} diag_values;
+
+static const struct {
+    uint16_t attr_id;
+    bool manufacturer;
+    esp_zb_zcl_attr_type_t type;
+    void *value;
+    size_t size;
+} diag_attrs[] = {
+    { DIAG_MAC_RX_UCAST_ATTRIBUTE_ID, false, ESP_ZB_ZCL_ATTR_TYPE_U32, &diag_values.mac_rx_ucast, sizeof(uint32_t) },
+    { DIAG_MAC_TX_UCAST_ATTRIBUTE_ID, false, ESP_ZB_ZCL_ATTR_TYPE_U32, &diag_values.mac_tx_ucast, sizeof(uint32_t) },
+    { DIAG_MAC_TX_RETRY_ATTRIBUTE_ID, false, ESP_ZB_ZCL_ATTR_TYPE_U16, &diag_values.mac_tx_retry, sizeof(uint16_t) },
+    { DIAG_MAC_TX_FAIL_ATTRIBUTE_ID, false, ESP_ZB_ZCL_ATTR_TYPE_U16, &diag_values.mac_tx_fail, sizeof(uint16_t) },
+    { DIAG_APS_TX_FAIL_ATTRIBUTE_ID, false, ESP_ZB_ZCL_ATTR_TYPE_U16, &diag_values.aps_tx_fail, sizeof(uint16_t) },
+    { DIAG_LAST_LQI_ATTRIBUTE_ID, false, ESP_ZB_ZCL_ATTR_TYPE_U8, &diag_values.last_lqi, sizeof(uint8_t) },
+    { DIAG_LAST_RSSI_ATTRIBUTE_ID, false, ESP_ZB_ZCL_ATTR_TYPE_S8, &diag_values.last_rssi, sizeof(int8_t) },
+    { DIAG_PARENT_CHANGES_ATTRIBUTE_ID, true, ESP_ZB_ZCL_ATTR_TYPE_U32, &diag_values.parent_changes, sizeof(uint32_t) },
+    { DIAG_DUPLICATES_ATTRIBUTE_ID, true, ESP_ZB_ZCL_ATTR_TYPE_U32, &diag_values.duplicates, sizeof(uint32_t) },
+};
+
+#define DIAG_ATTR_COUNT (sizeof(diag_attrs) / sizeof(diag_attrs[0]))
+
+// Собственные атрибуты производителя (octet string: первый байт - длина)
+static struct {
+    uint16_t attr_id;
+    uint8_t value[ESP_ZIGBEE_MANUF_ATTR_MAX_LEN + 1];
+} manuf_attrs[] = {
+    { .attr_id = ESP_ZIGBEE_MANUF_ATTR_LATENCY_HIST },
+    { .attr_id = ESP_ZIGBEE_MANUF_ATTR_HISTORY_PAGE },
+    { .attr_id = ESP_ZIGBEE_MANUF_ATTR_CONFIG },
+};
+
+#define MANUF_ATTR_COUNT (sizeof(manuf_attrs) / sizeof(manuf_attrs[0]))
+
 // Преобразовать команду ZigBee в нашу команду
 static uint8_t convert_zb_cmd_to_esp_cmd(uint8_t zb_cmd)
 {
@@ -60,11 +242,69 @@ static uint8_t convert_zb_cmd_to_esp_cmd(uint8_t zb_cmd)
             return ESP_ZIGBEE_CMD_STOP;
         case WINDOW_COVERING_GO_TO_POS_CMD_ID:
             return ESP_ZIGBEE_CMD_SET_POSITION;
+        case WINDOW_COVERING_SET_SCHEDULE_CMD_ID:
+            return ESP_ZIGBEE_CMD_SET_SCHEDULE;
+        case WINDOW_COVERING_CLEAR_SCHEDULE_CMD_ID:
+            return ESP_ZIGBEE_CMD_CLEAR_SCHEDULE;
+        case WINDOW_COVERING_SET_RULE_CMD_ID:
+            return ESP_ZIGBEE_CMD_SET_RULE;
+        case WINDOW_COVERING_CLEAR_RULE_CMD_ID:
+            return ESP_ZIGBEE_CMD_CLEAR_RULE;
+        case WINDOW_COVERING_READ_HISTORY_CMD_ID:
+            return ESP_ZIGBEE_CMD_READ_HISTORY;
+        case WINDOW_COVERING_WRITE_CONFIG_CMD_ID:
+            return ESP_ZIGBEE_CMD_WRITE_CONFIG;
         default:
             return 0xFF; // Неизвестная команда
     }
 }
 
+// Преобразовать команду кластера сцен в нашу команду
+static uint8_t convert_scenes_cmd_to_esp_cmd(uint8_t zb_cmd)
+{
+    switch (zb_cmd) {
+        case SCENES_STORE_CMD_ID:
+            return ESP_ZIGBEE_CMD_STORE_SCENE;
+        case SCENES_RECALL_CMD_ID:
+            return ESP_ZIGBEE_CMD_RECALL_SCENE;
+        case SCENES_REMOVE_CMD_ID:
+            return ESP_ZIGBEE_CMD_REMOVE_SCENE;
+        case SCENES_REMOVE_ALL_CMD_ID:
+            return ESP_ZIGBEE_CMD_REMOVE_ALL_SCENES;
+        default:
+            return 0xFF; // Команда обрабатывается стеком
+    }
+}
+
+// Передача команды приложению вместе со сведениями об источнике. Команда
+// попадает в кэш повторов только после того, как приложение приняло ее:
+// повтор хаба после переполнения очереди приложения будет выполнен
+static void dispatch_command(uint8_t esp_cmd, const esp_zb_zcl_cmd_t *cmd_info)
+{
+    esp_zigbee_cmd_info_t info = {
+        .src_addr = cmd_info->src_addr,
+        .src_endpoint = cmd_info->src_endpoint,
+        .tsn = cmd_info->tsn,
+        .group_addressed = cmd_info->is_group,
+        .group_id = cmd_info->group_id
+    };
+    
+    // Повтор уже выполненной команды подтверждается стеком, но не исполняется
+    if (cmd_dedup_is_duplicate(esp_cmd, &info)) {
+        zigbee_ctx.duplicates_suppressed++;
+        ESP_LOGW(TAG, "Повтор команды %d от 0x%04X (TSN=%d) пропущен, всего повторов: %lu",
+                 esp_cmd, cmd_info->src_addr, cmd_info->tsn,
+                 (unsigned long)zigbee_ctx.duplicates_suppressed);
+        return;
+    }
+    
+    // Проверка на наличие колбэка для команд
+    if (zigbee_ctx.config.on_command &&
+        zigbee_ctx.config.on_command(esp_cmd, cmd_info->payload, cmd_info->payload_size, &info)) {
+        cmd_dedup_record(esp_cmd, &info);
+    }
+}
+
 // Колбэк для команд кластера
 static esp_err_t window_covering_cluster_handler(esp_zb_zcl_cmd_t *cmd_info)
 {
@@ -76,18 +316,561 @@ static esp_err_t window_covering_cluster_handler(esp_zb_zcl_cmd_t *cmd_info)
         return ESP_ERR_INVALID_ARG;
     }
     
-    // Проверка на наличие колбэка для команд
-    if (zigbee_ctx.config.on_command) {
-        const uint8_t *data = cmd_info->payload;
-        uint16_t len = cmd_info->payload_size;
+    dispatch_command(esp_cmd, cmd_info);
+    
+    return ESP_OK;
+}
+
+// Колбэк для команд кластера сцен
+static esp_err_t scenes_cluster_handler(esp_zb_zcl_cmd_t *cmd_info)
+{
+    ESP_LOGI(TAG, "Получена команда сцен: ID=%d, группа=%d", cmd_info->cmd_id, cmd_info->is_group);
+    
+    uint8_t esp_cmd = convert_scenes_cmd_to_esp_cmd(cmd_info->cmd_id);
+    if (esp_cmd == 0xFF) {
+        // Add/View/Get Scene Membership обслуживает стек
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    
+    // Одиночный вызов неизвестной сцены стек отклоняет ответом Default Response
+    // со статусом NOT_FOUND; групповые вызовы по ZCL остаются без ответа
+    if (esp_cmd == ESP_ZIGBEE_CMD_RECALL_SCENE && !cmd_info->is_group &&
+        cmd_info->payload_size >= 3 && zigbee_ctx.config.on_scene_lookup != NULL) {
+        uint16_t group_id = cmd_info->payload[0] | (cmd_info->payload[1] << 8);
+        uint8_t scene_id = cmd_info->payload[2];
+        
+        if (!zigbee_ctx.config.on_scene_lookup(group_id, scene_id)) {
+            ESP_LOGW(TAG, "Вызов неизвестной сцены %d группы 0x%04X", scene_id, group_id);
+            return ESP_ERR_NOT_FOUND;
+        }
+    }
+    
+    dispatch_command(esp_cmd, cmd_info);
+    
+    return ESP_OK;
+}
+
+// Колбэк для команд сервера OTA Upgrade
+static esp_err_t ota_upgrade_client_handler(esp_zb_zcl_cmd_t *cmd_info)
+{
+    if (zigbee_ctx.config.on_ota == NULL) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    
+    zigbee_ctx.config.on_ota(cmd_info->cmd_id, cmd_info->payload, cmd_info->payload_size);
+    return ESP_OK;
+}
+
+// Передача события привязанного датчика приложению
+static void dispatch_sensor_event(esp_zigbee_sensor_type_t type, uint16_t src_addr,
+                                  uint8_t src_endpoint, int32_t value)
+{
+    if (zigbee_ctx.config.on_sensor) {
+        esp_zigbee_sensor_event_t event = {
+            .type = type,
+            .src_addr = src_addr,
+            .src_endpoint = src_endpoint,
+            .value = value
+        };
         
-        // Вызов колбэка
-        zigbee_ctx.config.on_command(esp_cmd, data, len);
+        zigbee_ctx.config.on_sensor(&event);
+    }
+}
+
+// Колбэк для команд On/Off от привязанных датчиков и выключателей
+static esp_err_t on_off_client_handler(esp_zb_zcl_cmd_t *cmd_info)
+{
+    if (cmd_info->cmd_id != ON_OFF_OFF_CMD_ID && cmd_info->cmd_id != ON_OFF_ON_CMD_ID) {
+        // Toggle и команды с эффектами не имеют однозначного состояния
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    
+    dispatch_sensor_event(ESP_ZIGBEE_SENSOR_ON_OFF, cmd_info->src_addr, cmd_info->src_endpoint,
+                          cmd_info->cmd_id == ON_OFF_ON_CMD_ID ? 1 : 0);
+    return ESP_OK;
+}
+
+// Колбэк для уведомлений зоны IAS (датчики дождя, протечки, открытия)
+static esp_err_t ias_zone_client_handler(esp_zb_zcl_cmd_t *cmd_info)
+{
+    if (cmd_info->cmd_id != IAS_ZONE_STATUS_CHANGE_CMD_ID || cmd_info->payload_size < 2) {
+        return ESP_ERR_NOT_SUPPORTED;
     }
     
+    uint16_t zone_status = cmd_info->payload[0] | (cmd_info->payload[1] << 8);
+    dispatch_sensor_event(ESP_ZIGBEE_SENSOR_IAS_ZONE, cmd_info->src_addr, cmd_info->src_endpoint,
+                          zone_status);
     return ESP_OK;
 }
 
+// Колбэк входящих отчетов об атрибутах (температура от привязанных датчиков)
+static void zigbee_report_attr_cb(const esp_zb_zcl_report_attr_message_t *message)
+{
+    if (message->cluster_id != TEMP_MEASUREMENT_CLUSTER_ID ||
+        message->attr_id != TEMP_MEASURED_VALUE_ATTRIBUTE_ID ||
+        message->size != sizeof(int16_t)) {
+        return;
+    }
+    
+    int16_t temperature;
+    memcpy(&temperature, message->value, sizeof(temperature));
+    if (temperature == TEMP_MEASURED_VALUE_INVALID) {
+        return;
+    }
+    
+    dispatch_sensor_event(ESP_ZIGBEE_SENSOR_TEMPERATURE, message->src_addr, message->src_endpoint,
+                          temperature);
+}
+
+// Колбэк ответа на чтение атрибутов (время от координатора)
+static void zigbee_read_attr_resp_cb(const esp_zb_zcl_read_attr_resp_t *resp)
+{
+    if (resp->cluster_id != TIME_CLUSTER_ID || resp->attr_id != TIME_LOCAL_TIME_ATTRIBUTE_ID) {
+        return;
+    }
+    
+    if (resp->status != ESP_ZB_ZCL_STATUS_SUCCESS || resp->size != sizeof(uint32_t)) {
+        ESP_LOGW(TAG, "Координатор не вернул время: статус=%d", resp->status);
+        return;
+    }
+    
+    uint32_t local_time;
+    memcpy(&local_time, resp->value, sizeof(local_time));
+    ESP_LOGI(TAG, "Получено время от координатора: %lu", (unsigned long)local_time);
+    
+    if (zigbee_ctx.config.on_time) {
+        zigbee_ctx.config.on_time(local_time);
+    }
+}
+
+// Одна попытка переподключения (выполняется в контексте стека ZigBee)
+static void rejoin_attempt_cb(uint8_t param)
+{
+    if (!zigbee_ctx.rejoin_active || !zigbee_ctx.started) {
+        return;
+    }
+    
+    // Задержка до следующей попытки на случай, если эта не завершится подключением
+    uint32_t delay_ms = rejoin_backoff_next(&zigbee_ctx.rejoin_backoff);
+    uint32_t attempt = zigbee_ctx.rejoin_backoff.attempt;
+    
+    if (zigbee_ctx.rejoin_stage == REJOIN_STAGE_FAST && 
+        attempt > REJOIN_FAST_ATTEMPTS) {
+        ESP_LOGW(TAG, "Родитель недоступен, переход к сканированию каналов");
+        zigbee_ctx.rejoin_stage = REJOIN_STAGE_SCAN;
+    }
+    
+    if (zigbee_ctx.rejoin_stage == REJOIN_STAGE_FAST) {
+        // Переподключение по сохраненным параметрам сети без сканирования
+        ESP_LOGI(TAG, "Быстрое переподключение (попытка %lu)", (unsigned long)attempt);
+        esp_zb_bdb_start_top_level_commissioning(ESP_ZB_BDB_MODE_INITIALIZATION);
+    } else {
+        ESP_LOGI(TAG, "Сканирование каналов (попытка %lu)", (unsigned long)attempt);
+        
+        // Маска каналов из конфигурации возвращается после переподключения
+        if (!zigbee_ctx.rejoin_mask_saved) {
+            zigbee_ctx.rejoin_saved_mask = esp_zb_get_primary_network_channel_set();
+            zigbee_ctx.rejoin_mask_saved = true;
+        }
+        esp_zb_set_primary_network_channel_set(ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK);
+        esp_zb_bdb_start_top_level_commissioning(ESP_ZB_BDB_MODE_NETWORK_STEERING);
+    }
+    
+    esp_zb_scheduler_alarm(rejoin_attempt_cb, 0, delay_ms);
+}
+
+// Запуск механизма переподключения после потери сети
+static void rejoin_start(void)
+{
+    if (zigbee_ctx.rejoin_active) {
+        return;
+    }
+    
+    zigbee_ctx.rejoin_active = true;
+    zigbee_ctx.rejoin_stage = REJOIN_STAGE_FAST;
+    
+    esp_zb_scheduler_alarm(rejoin_attempt_cb, 0, rejoin_backoff_start(&zigbee_ctx.rejoin_backoff));
+}
+
+// Остановка механизма переподключения
+static void rejoin_stop(void)
+{
+    if (!zigbee_ctx.rejoin_active) {
+        return;
+    }
+    
+    esp_zb_scheduler_alarm_cancel(rejoin_attempt_cb, 0);
+    zigbee_ctx.rejoin_active = false;
+    
+    // Сканирование всех каналов нужно было только для поиска сети
+    if (zigbee_ctx.rejoin_mask_saved) {
+        esp_zb_set_primary_network_channel_set(zigbee_ctx.rejoin_saved_mask);
+        zigbee_ctx.rejoin_mask_saved = false;
+    }
+}
+
+// Обновление атрибутов кластера Diagnostics из счетчиков стека (выполняется
+// в контексте стека ZigBee); изменившиеся значения попадают в отчеты,
+// настроенные хабом
+static void diagnostics_refresh_cb(uint8_t param)
+{
+    esp_zb_diagnostics_info_t info;
+    if (esp_zb_nwk_get_diagnostics(&info) == ESP_OK) {
+        diag_values.mac_rx_ucast = info.mac_rx_ucast;
+        diag_values.mac_tx_ucast = info.mac_tx_ucast;
+        diag_values.mac_tx_retry = (uint16_t)info.mac_tx_ucast_retry;
+        diag_values.mac_tx_fail = (uint16_t)info.mac_tx_ucast_fail;
+        diag_values.aps_tx_fail = (uint16_t)info.aps_tx_ucast_fail;
+        diag_values.last_lqi = info.last_msg_lqi;
+        diag_values.last_rssi = info.last_msg_rssi;
+    }
+    diag_values.parent_changes = zigbee_ctx.parent_changes;
+    diag_values.duplicates = zigbee_ctx.duplicates_suppressed;
+    
+    // Эффективность надежной доставки: кадров в эфире на доставленное значение
+    portENTER_CRITICAL(&report_slot_lock);
+    uint32_t submitted = report_ctx.submitted;
+    uint32_t delivered = report_ctx.delivered;
+    uint32_t frames = report_ctx.frames;
+    uint32_t superseded = report_ctx.superseded;
+    uint32_t abandoned = report_ctx.abandoned;
+    portEXIT_CRITICAL(&report_slot_lock);
+    
+    if (delivered > 0) {
+        ESP_LOGI(TAG, "Доставка отчетов: принято=%lu, доставлено=%lu, замещено=%lu, потеряно=%lu, "
+                 "кадров на значение=%lu.%02lu", (unsigned long)submitted, (unsigned long)delivered,
+                 (unsigned long)superseded, (unsigned long)abandoned, (unsigned long)(frames / delivered), (unsigned long)((frames % delivered) * 100 / delivered));
+    }
+    
+    for (size_t i = 0; i < DIAG_ATTR_COUNT; i++) {
+        if (diag_attrs[i].manufacturer) {
+            esp_zb_zcl_set_manufacturer_attribute_val(
+                zigbee_ctx.window_ep,
+                DIAGNOSTICS_CLUSTER_ID,
+                ZB_ZCL_CLUSTER_SERVER_ROLE,
+                ESP_ZIGBEE_MANUFACTURER_CODE,
+                diag_attrs[i].attr_id,
+                diag_attrs[i].value,
+                false);
+        } else {
+            esp_zb_zcl_set_attribute_val(
+                zigbee_ctx.window_ep,
+                DIAGNOSTICS_CLUSTER_ID,
+                ZB_ZCL_CLUSTER_SERVER_ROLE,
+                diag_attrs[i].attr_id,
+                diag_attrs[i].value,
+                diag_attrs[i].size);
+        }
+    }
+    
+    if (zigbee_ctx.started) {
+        esp_zb_scheduler_alarm(diagnostics_refresh_cb, 0, DIAG_REFRESH_MS);
+    }
+}
+
+// Учет смены родительского узла после подключения к сети
+static void diagnostics_track_parent(void)
+{
+    uint16_t parent = esp_zb_nwk_get_parent_address();
+    
+    if (zigbee_ctx.parent_known && parent != zigbee_ctx.parent_address) {
+        zigbee_ctx.parent_changes++;
+        ESP_LOGI(TAG, "Смена родителя: 0x%04X -> 0x%04X", zigbee_ctx.parent_address, parent);
+    }
+    zigbee_ctx.parent_address = parent;
+    zigbee_ctx.parent_known = true;
+}
+
+// Начать доставку слотов заново: после смены списка получателей маски
+// и порядковые номера отправленных кадров больше не действительны
+static void report_slots_restart(void)
+{
+    portENTER_CRITICAL(&report_slot_lock);
+    for (uint8_t i = 0; i < REPORT_SLOT_COUNT; i++) {
+        report_slot_t *slot = &report_ctx.slots[i];
+        slot->in_flight = false;
+        slot->attempts = 0;
+        slot->unacked = 0xFF;
+        slot->next_try_ms = 0;
+    }
+    portEXIT_CRITICAL(&report_slot_lock);
+}
+
+// Чтение таблицы привязок стека для списка получателей отчетов
+static uint8_t report_dests_read_bindings(report_dest_binding_t *bindings, uint8_t max)
+{
+    esp_zb_binding_entry_t entries[REPORT_DEST_BINDING_SCAN_MAX];
+    
+    if (max > REPORT_DEST_BINDING_SCAN_MAX) {
+        max = REPORT_DEST_BINDING_SCAN_MAX;
+    }
+    uint8_t total = esp_zb_binding_table_get(entries, max);
+    
+    for (uint8_t i = 0; i < total; i++) {
+        bindings[i].src_endpoint = entries[i].src_endpoint;
+        bindings[i].cluster_id = entries[i].cluster_id;
+        bindings[i].dest.addr_mode = entries[i].dst_addr_mode;
+        memcpy(&bindings[i].dest.addr, &entries[i].dst_addr_u, sizeof(bindings[i].dest.addr));
+        bindings[i].dest.endpoint = entries[i].dst_endpoint;
+    }
+    
+    return total;
+}
+
+// Перестроить список получателей отчетов по таблице привязок стека
+static void report_dests_rebuild(void)
+{
+    report_dest_rebuild(report_dests_read_bindings, zigbee_ctx.endpoint_id, WINDOW_COVERING_CLUSTER_ID);
+    
+    // Маски получателей в слотах относились к прежнему списку
+    report_slots_restart();
+}
+
+// Заполнить адрес получателя в базовой части ZCL команды; возвращает режим адресации
+static esp_zb_zcl_address_mode_t report_dest_apply(const report_dest_t *dest, esp_zb_zcl_basic_cmd_t *basic)
+{
+    memcpy(&basic->dst_addr_u, &dest->addr, sizeof(dest->addr));
+    basic->dst_endpoint = dest->endpoint;
+    basic->src_endpoint = zigbee_ctx.endpoint_id;
+    return (esp_zb_zcl_address_mode_t)dest->addr_mode;
+}
+
+// Задержка перед повтором отчета: экспоненциальный рост со случайной половиной
+static uint32_t report_backoff_ms(uint8_t attempts)
+{
+    uint32_t delay = REPORT_BASE_DELAY_MS << (attempts - 1);
+    if (delay > REPORT_MAX_DELAY_MS) {
+        delay = REPORT_MAX_DELAY_MS;
+    }
+    
+    return delay / 2 + esp_random() % (delay / 2 + 1);
+}
+
+// Неудачная попытка: повтор с задержкой или отказ после исчерпания повторов
+// (вызывается под report_slot_lock); возвращает true при отказе от значения
+static bool report_slot_failed(report_slot_t *slot, int64_t now_ms)
+{
+    slot->in_flight = false;
+    
+    if (slot->attempts > REPORT_MAX_RETRIES) {
+        slot->pending = false;
+        report_ctx.abandoned++;
+        return true;
+    }
+    
+    slot->next_try_ms = now_ms + report_backoff_ms(slot->attempts);
+    return false;
+}
+
+// Отправить значение слота получателям, еще не подтвердившим прием
+// (выполняется в контексте стека ZigBee)
+static void report_slot_send(uint8_t index, report_slot_t *slot)
+{
+    report_dest_t dests[REPORT_DEST_MAX];
+    uint8_t count = report_dest_snapshot(dests);
+    uint8_t tsn[REPORT_DEST_MAX] = { 0 };
+    uint8_t unacked = 0;
+    uint8_t frames = 0;
+    
+    portENTER_CRITICAL(&report_slot_lock);
+    uint8_t targets = slot->unacked & (uint8_t)((1U << count) - 1);
+    uint8_t generation = slot->generation;
+    uint8_t alarm_code = slot->alarm_code;
+    portEXIT_CRITICAL(&report_slot_lock);
+    
+    for (uint8_t i = 0; i < count; i++) {
+        if (!(targets & (1U << i))) {
+            continue;
+        }
+        
+        if (index == REPORT_SLOT_ATTRS) {
+            esp_zb_zcl_report_attr_cmd_t report_cmd = {
+                .cluster_id = WINDOW_COVERING_CLUSTER_ID,
+                .cluster_role = ZB_ZCL_CLUSTER_SERVER_ROLE,
+            };
+            report_cmd.address_mode = report_dest_apply(&dests[i], &report_cmd.zcl_basic_cmd);
+            tsn[i] = esp_zb_zcl_report_attr(&report_cmd);
+        } else {
+            esp_zb_zcl_alarm_cmd_t alarm_cmd = {
+                .alarm_code = alarm_code,
+                .cluster_id = WINDOW_COVERING_CLUSTER_ID,
+            };
+            alarm_cmd.address_mode = report_dest_apply(&dests[i], &alarm_cmd.zcl_basic_cmd);
+            tsn[i] = esp_zb_zcl_alarm(&alarm_cmd);
+        }
+        frames++;
+        
+        // Групповые кадры не подтверждаются на уровне APS
+        if (dests[i].addr_mode != REPORT_DEST_ADDR_MODE_GROUP) {
+            unacked |= 1U << i;
+        }
+    }
+    
+    portENTER_CRITICAL(&report_slot_lock);
+    report_ctx.frames += frames;
+    if (slot->generation == generation) {
+        memcpy(slot->tsn, tsn, sizeof(slot->tsn));
+        slot->unacked = unacked;
+        if (unacked == 0) {
+            slot->pending = false;
+            report_ctx.delivered++;
+        } else {
+            slot->in_flight = true;
+            slot->next_try_ms = esp_timer_get_time() / 1000 + REPORT_ACK_TIMEOUT_MS;
+        }
+    }
+    portEXIT_CRITICAL(&report_slot_lock);
+}
+
+// Проход по слотам: отправка значений, срок попытки которых наступил, и
+// планирование следующего прохода (выполняется в контексте стека ZigBee)
+static void report_flush_cb(uint8_t param)
+{
+    // Без сети значения остаются в слотах до переподключения
+    if (!zigbee_ctx.connected) {
+        return;
+    }
+    
+    int64_t now_ms = esp_timer_get_time() / 1000;
+    int64_t next_ms = INT64_MAX;
+    
+    for (uint8_t i = 0; i < REPORT_SLOT_COUNT; i++) {
+        report_slot_t *slot = &report_ctx.slots[i];
+        bool send = false;
+        bool abandoned = false;
+        
+        portENTER_CRITICAL(&report_slot_lock);
+        if (slot->pending && slot->next_try_ms <= now_ms) {
+            if (slot->in_flight) {
+                // Статус отправки не пришел: попытка считается неудачной
+                abandoned = report_slot_failed(slot, now_ms);
+            } else {
+                slot->attempts++;
+                send = true;
+            }
+        }
+        portEXIT_CRITICAL(&report_slot_lock);
+        
+        if (abandoned) {
+            ESP_LOGW(TAG, "Отчет слота %d не доставлен после %d попыток", i, REPORT_MAX_RETRIES + 1);
+        }
+        
+        if (send) {
+            report_slot_send(i, slot);
+        }
+        
+        portENTER_CRITICAL(&report_slot_lock);
+        if (slot->pending && slot->next_try_ms < next_ms) {
+            next_ms = slot->next_try_ms;
+        }
+        portEXIT_CRITICAL(&report_slot_lock);
+    }
+    
+    esp_zb_scheduler_alarm_cancel(report_flush_cb, 0);
+    if (next_ms != INT64_MAX) {
+        esp_zb_scheduler_alarm(report_flush_cb, 0, next_ms > now_ms ? (uint32_t)(next_ms - now_ms) : 0);
+    }
+}
+
+// Запланировать немедленный проход по слотам. Планировщик стека не
+// защищен от задач приложения: вызывается из колбэков стека или под
+// блокировкой esp_zb_lock_acquire()
+static void report_flush_schedule(void)
+{
+    esp_zb_scheduler_alarm_cancel(report_flush_cb, 0);
+    esp_zb_scheduler_alarm(report_flush_cb, 0, 0);
+}
+
+// Поместить новое значение в слот; неподтвержденное прежнее значение
+// замещается и больше не повторяется (вызывается задачами приложения)
+static void report_slot_submit(uint8_t index, uint8_t alarm_code)
+{
+    report_slot_t *slot = &report_ctx.slots[index];
+    
+    portENTER_CRITICAL(&report_slot_lock);
+    if (slot->pending) {
+        report_ctx.superseded++;
+    }
+    report_ctx.submitted++;
+    slot->pending = true;
+    slot->in_flight = false;
+    slot->attempts = 0;
+    slot->generation++;
+    slot->alarm_code = alarm_code;
+    slot->unacked = 0xFF;
+    slot->next_try_ms = 0;
+    portEXIT_CRITICAL(&report_slot_lock);
+    
+    // Без сети значение ждет в слоте до переподключения. Блокировка стека
+    // рекурсивна: отчет из колбэка подключения тоже проходит здесь
+    if (zigbee_ctx.connected) {
+        esp_zb_lock_acquire(portMAX_DELAY);
+        report_flush_schedule();
+        esp_zb_lock_release();
+    }
+}
+
+// Колбэк статуса отправки ZCL кадра: APS-подтверждение получателя или отказ
+static void report_send_status_cb(const esp_zb_zcl_command_send_status_message_t *message)
+{
+    int64_t now_ms = esp_timer_get_time() / 1000;
+    bool failed = false;
+    bool abandoned = false;
+    bool attrs_delivered = false;
+    
+    portENTER_CRITICAL(&report_slot_lock);
+    for (uint8_t i = 0; i < REPORT_SLOT_COUNT; i++) {
+        report_slot_t *slot = &report_ctx.slots[i];
+        if (!slot->in_flight) {
+            continue;
+        }
+        
+        for (uint8_t dest = 0; dest < REPORT_DEST_MAX; dest++) {
+            if (!(slot->unacked & (1U << dest)) || slot->tsn[dest] != message->tsn) {
+                continue;
+            }
+            
+            if (message->status != ESP_OK) {
+                failed = true;
+                abandoned = report_slot_failed(slot, now_ms);
+            } else {
+                slot->unacked &= ~(1U << dest);
+                if (slot->unacked == 0) {
+                    slot->pending = false;
+                    slot->in_flight = false;
+                    report_ctx.delivered++;
+                    attrs_delivered |= (i == REPORT_SLOT_ATTRS);
+                }
+            }
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&report_slot_lock);
+    
+    if (abandoned) {
+        ESP_LOGW(TAG, "Отчет не доставлен после %d попыток", REPORT_MAX_RETRIES + 1);
+    }
+    
+    if (attrs_delivered && zigbee_ctx.config.on_report_sent) {
+        zigbee_ctx.config.on_report_sent();
+    }
+    
+    // Повтор планируется проходом по слотам на срок с учетом задержки
+    if (failed) {
+        report_flush_schedule();
+    }
+}
+
+// Колбэк изменения таблицы привязок (Bind/Unbind от контроллера)
+static void zigbee_binding_changed_cb(void)
+{
+    report_dests_rebuild();
+    
+    if (zigbee_ctx.connected) {
+        report_flush_schedule();
+    }
+}
+
 // Колбэк для подключения к сети
 static void zigbee_network_state_changed_cb(esp_zb_nwk_state_t state)
 {
@@ -96,15 +879,28 @@ static void zigbee_network_state_changed_cb(esp_zb_nwk_state_t state)
     switch (state) {
         case ESP_ZB_NWK_STATE_CONNECTED:
             ESP_LOGI(TAG, "Устройство подключено к сети ZigBee");
+            zigbee_ctx.connected = true;
+            rejoin_stop();
+            report_dests_rebuild();
+            diagnostics_track_parent();
             if (zigbee_ctx.config.on_connected) {
                 zigbee_ctx.config.on_connected();
             }
+            
+            // Досылаем значения, накопленные в слотах без сети
+            report_flush_schedule();
             break;
         case ESP_ZB_NWK_STATE_DISCONNECTED:
             ESP_LOGW(TAG, "Устройство отключено от сети ZigBee");
+            zigbee_ctx.connected = false;
             if (zigbee_ctx.config.on_disconnected) {
                 zigbee_ctx.config.on_disconnected();
             }
+            
+            // Восстанавливаем подключение, если устройство не остановлено
+            if (zigbee_ctx.started) {
+                rejoin_start();
+            }
             break;
         default:
             break;
@@ -131,6 +927,18 @@ esp_err_t esp_zigbee_init(const esp_zigbee_config_t *config)
     // Сохранение конфигурации
     memcpy(&zigbee_ctx.config, config, sizeof(esp_zigbee_config_t));
     
+    // Копируем сохраненные параметры сети, указатель в конфигурации не храним
+    zigbee_ctx.has_restore_network = (config->restore_network != NULL);
+    if (zigbee_ctx.has_restore_network) {
+        memcpy(&zigbee_ctx.restore_network, config->restore_network, sizeof(esp_zigbee_network_info_t));
+    }
+    zigbee_ctx.config.restore_network = NULL;
+    
+    zigbee_ctx.leave_done = xSemaphoreCreateBinary();
+    if (zigbee_ctx.leave_done == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    
     // Инициализация стека ZigBee
     esp_zb_platform_config_t platform_config = {
         .radio_config = {
@@ -143,7 +951,7 @@ esp_err_t esp_zigbee_init(const esp_zigbee_config_t *config)
     
     ESP_ERROR_CHECK(esp_zb_platform_config(&platform_config));
     
-    // Создание устройства ZigBee
+    // Создание устройства ZigBee: роль определяется источником питания
     esp_zb_cfg_t zb_config = {
         .device_type = ESP_ZB_DEVICE_TYPE_END_DEVICE,
         .nwk_cfg = {
@@ -154,11 +962,33 @@ esp_err_t esp_zigbee_init(const esp_zigbee_config_t *config)
         },
     };
     
+    if (config->role == ESP_ZIGBEE_ROLE_ROUTER) {
+        zb_config.device_type = ESP_ZB_DEVICE_TYPE_ROUTER;
+        zb_config.nwk_cfg.zczr_cfg.max_children = ROUTER_MAX_CHILDREN;
+    }
+    
     ESP_ERROR_CHECK(esp_zb_init(&zb_config));
     
+    // Конечное устройство на батарее выключает приемник между опросами родителя
+    esp_zb_sleep_enable(config->role == ESP_ZIGBEE_ROLE_END_DEVICE);
+    ESP_LOGI(TAG, "Роль в сети: %s",
+             config->role == ESP_ZIGBEE_ROLE_ROUTER ? "маршрутизатор" : "спящее конечное устройство");
+    
     // Установка колбэка изменения состояния сети
     ESP_ERROR_CHECK(esp_zb_set_network_state_change_cb(zigbee_network_state_changed_cb));
     
+    // Установка колбэка изменения таблицы привязок
+    ESP_ERROR_CHECK(esp_zb_set_binding_change_cb(zigbee_binding_changed_cb));
+    
+    // Установка колбэка ответов на чтение атрибутов
+    ESP_ERROR_CHECK(esp_zb_set_read_attr_resp_cb(zigbee_read_attr_resp_cb));
+    
+    // Установка колбэка входящих отчетов об атрибутах
+    ESP_ERROR_CHECK(esp_zb_set_report_attr_cb(zigbee_report_attr_cb));
+    
+    // Установка колбэка статуса отправки (APS-подтверждения отчетов)
+    ESP_ERROR_CHECK(esp_zb_set_command_send_status_cb(report_send_status_cb));
+    
     // Создание эндпоинта для устройства окна
     esp_zb_window_covering_cfg_t window_covering_cfg = {
         .type = 0x01,                    // Тип устройства (жалюзи/окно)
@@ -181,6 +1011,73 @@ esp_err_t esp_zigbee_init(const esp_zigbee_config_t *config)
         WINDOW_COVERING_CLUSTER_ID,
         window_covering_cluster_handler));
     
+    // Кластеры групп и сцен: одна групповая команда управляет всеми окнами комнаты
+    ESP_ERROR_CHECK(esp_zb_ep_add_cluster(zigbee_ctx.window_ep, GROUPS_CLUSTER_ID, ZB_ZCL_CLUSTER_SERVER_ROLE));
+    ESP_ERROR_CHECK(esp_zb_ep_add_cluster(zigbee_ctx.window_ep, SCENES_CLUSTER_ID, ZB_ZCL_CLUSTER_SERVER_ROLE));
+    ESP_ERROR_CHECK(esp_zb_cluster_update_commands(
+        zigbee_ctx.window_ep,
+        SCENES_CLUSTER_ID,
+        scenes_cluster_handler));
+    
+    // Клиент кластера Time для синхронизации часов с координатором
+    ESP_ERROR_CHECK(esp_zb_ep_add_cluster(zigbee_ctx.window_ep, TIME_CLUSTER_ID, ZB_ZCL_CLUSTER_CLIENT_ROLE));
+    
+    // Клиенты On/Off, IAS Zone и Temperature Measurement для локальной автоматизации:
+    // привязанные датчики обращаются к окну напрямую, без хаба
+    ESP_ERROR_CHECK(esp_zb_ep_add_cluster(zigbee_ctx.window_ep, ON_OFF_CLUSTER_ID, ZB_ZCL_CLUSTER_CLIENT_ROLE));
+    ESP_ERROR_CHECK(esp_zb_ep_add_cluster(zigbee_ctx.window_ep, IAS_ZONE_CLUSTER_ID, ZB_ZCL_CLUSTER_CLIENT_ROLE));
+    ESP_ERROR_CHECK(esp_zb_ep_add_cluster(zigbee_ctx.window_ep, TEMP_MEASUREMENT_CLUSTER_ID, ZB_ZCL_CLUSTER_CLIENT_ROLE));
+    ESP_ERROR_CHECK(esp_zb_cluster_update_commands(
+        zigbee_ctx.window_ep,
+        ON_OFF_CLUSTER_ID,
+        on_off_client_handler));
+    ESP_ERROR_CHECK(esp_zb_cluster_update_commands(
+        zigbee_ctx.window_ep,
+        IAS_ZONE_CLUSTER_ID,
+        ias_zone_client_handler));
+    
+    // Клиент OTA Upgrade: обновление прошивки по радиоканалу ZigBee
+    ESP_ERROR_CHECK(esp_zb_ep_add_cluster(zigbee_ctx.window_ep, OTA_UPGRADE_CLUSTER_ID, ZB_ZCL_CLUSTER_CLIENT_ROLE));
+    ESP_ERROR_CHECK(esp_zb_cluster_update_commands(
+        zigbee_ctx.window_ep,
+        OTA_UPGRADE_CLUSTER_ID,
+        ota_upgrade_client_handler));
+    
+    // Сервер Diagnostics: хаб отличает слабую связь от занятого устройства
+    ESP_ERROR_CHECK(esp_zb_ep_add_cluster(zigbee_ctx.window_ep, DIAGNOSTICS_CLUSTER_ID, ZB_ZCL_CLUSTER_SERVER_ROLE));
+    for (size_t i = 0; i < DIAG_ATTR_COUNT; i++) {
+        if (diag_attrs[i].manufacturer) {
+            ESP_ERROR_CHECK(esp_zb_cluster_add_manufacturer_attr(
+                zigbee_ctx.window_ep,
+                DIAGNOSTICS_CLUSTER_ID,
+                diag_attrs[i].attr_id,
+                ESP_ZIGBEE_MANUFACTURER_CODE,
+                diag_attrs[i].type,
+                ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING,
+                diag_attrs[i].value));
+        } else {
+            ESP_ERROR_CHECK(esp_zb_cluster_add_attr(
+                zigbee_ctx.window_ep,
+                DIAGNOSTICS_CLUSTER_ID,
+                diag_attrs[i].attr_id,
+                diag_attrs[i].type,
+                ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING,
+                diag_attrs[i].value));
+        }
+    }
+    
+    // Регистрация собственных атрибутов производителя
+    for (size_t i = 0; i < MANUF_ATTR_COUNT; i++) {
+        ESP_ERROR_CHECK(esp_zb_cluster_add_manufacturer_attr(
+            zigbee_ctx.window_ep,
+            WINDOW_COVERING_CLUSTER_ID,
+            manuf_attrs[i].attr_id,
+            ESP_ZIGBEE_MANUFACTURER_CODE,
+            ESP_ZB_ZCL_ATTR_TYPE_OCTET_STRING,
+            ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY,
+            manuf_attrs[i].value));
+    }
+    
     zigbee_ctx.initialized = true;
     ESP_LOGI(TAG, "ZigBee библиотека успешно инициализирована");
     
@@ -204,14 +1101,50 @@ esp_err_t esp_zigbee_start(void)
         return ESP_OK;
     }
     
-    // Запуск ZigBee стека и подключение к сети
-    ESP_LOGI(TAG, "Запуск ZigBee стека и поиск сети...");
-    esp_zb_start(false);  // False означает, что устройство не является координатором
+    if (zigbee_ctx.has_restore_network) {
+        // Возврат в известную сеть на сохраненном канале без сканирования
+        const esp_zigbee_network_info_t *net = &zigbee_ctx.restore_network;
+        ESP_LOGI(TAG, "Восстановление сети: PAN=0x%04X, канал=%d, адрес=0x%04X",
+                 net->pan_id, net->channel, net->short_address);
+        
+        esp_zb_set_primary_network_channel_set(1UL << net->channel);
+        esp_zb_set_pan_id(net->pan_id);
+        esp_zb_set_extended_pan_id(net->extended_pan_id);
+        esp_zb_nwk_set_outgoing_frame_counter(net->nwk_frame_counter);
+        
+        if (zigbee_ctx.config.rejoin_network) {
+            // Адрес и родитель выданы в прежней роли: повторное подключение
+            // к той же сети с возможностями новой роли
+            ESP_LOGI(TAG, "Роль изменилась, повторное подключение к сохраненной сети");
+            esp_zb_start(false);
+            esp_zb_bdb_start_top_level_commissioning(ESP_ZB_BDB_MODE_NETWORK_STEERING);
+        } else {
+            esp_zb_set_short_address(net->short_address);
+            esp_zb_nwk_set_parent_address(net->parent_address);
+            
+            esp_zb_start(false);  // False означает, что устройство не является координатором
+            esp_zb_bdb_start_top_level_commissioning(ESP_ZB_BDB_MODE_INITIALIZATION);
+        }
+    } else {
+        // Первое подключение: предпочтительный канал из конфигурации или все каналы
+        if (zigbee_ctx.config.channel != 0) {
+            esp_zb_set_primary_network_channel_set(1UL << zigbee_ctx.config.channel);
+        } else {
+            esp_zb_set_primary_network_channel_set(ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK);
+        }
+        
+        ESP_LOGI(TAG, "Запуск ZigBee стека и поиск сети...");
+        esp_zb_start(false);  // False означает, что устройство не является координатором
+    }
     
     // Запуск основного цикла ZigBee (должен выполняться в отдельной задаче)
     esp_zb_main_loop_iteration();
     
+    // Привязки восстанавливаются стеком из собственного хранилища
+    report_dests_rebuild();
+    
     zigbee_ctx.started = true;
+    esp_zb_scheduler_alarm(diagnostics_refresh_cb, 0, DIAG_REFRESH_MS);
     ESP_LOGI(TAG, "ZigBee библиотека успешно запущена");
     
     return ESP_OK;
@@ -234,8 +1167,13 @@ esp_err_t esp_zigbee_stop(void)
         return ESP_OK;
     }
     
-    // Остановка ZigBee стека
+    // Остановка ZigBee стека (вызывается задачей приложения)
+    esp_zb_lock_acquire(portMAX_DELAY);
+    rejoin_stop();
+    esp_zb_scheduler_alarm_cancel(diagnostics_refresh_cb, 0);
+    esp_zb_scheduler_alarm_cancel(report_flush_cb, 0);
     esp_zb_scheduler_reset();
+    esp_zb_lock_release();
     
     zigbee_ctx.started = false;
     zigbee_ctx.pairing_enabled = false;
@@ -244,6 +1182,49 @@ esp_err_t esp_zigbee_stop(void)
     return ESP_OK;
 }
 
+/**
+ * @brief Подтверждение выхода из сети (контекст стека)
+ */
+static void leave_confirm_cb(esp_zb_zdp_status_t zdo_status, void *user_ctx)
+{
+    if (zdo_status != ESP_ZB_ZDP_STATUS_SUCCESS) {
+        ESP_LOGW(TAG, "Выход из сети не подтвержден: статус 0x%02X", zdo_status);
+    }
+    xSemaphoreGive(zigbee_ctx.leave_done);
+}
+
+/**
+ * @brief Выход из сети с уведомлением родителя
+ */
+esp_err_t esp_zigbee_leave(bool rejoin)
+{
+    if (!zigbee_ctx.started || !zigbee_ctx.connected) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    // Запрос выхода, адресованный самому устройству, стек передает родителю
+    esp_zb_zdo_mgmt_leave_req_param_t req = {
+        .dst_nwk_addr = esp_zb_get_short_address(),
+        .remove_children = false,
+        .rejoin = rejoin
+    };
+    esp_zb_get_long_address(req.device_address);
+    
+    // Переподключение после выхода не запускается
+    rejoin_stop();
+    xSemaphoreTake(zigbee_ctx.leave_done, 0);
+    esp_zb_zdo_device_leave_req(&req, leave_confirm_cb, NULL);
+    
+    if (xSemaphoreTake(zigbee_ctx.leave_done, pdMS_TO_TICKS(ESP_ZIGBEE_LEAVE_TIMEOUT_MS)) != pdTRUE) {
+        ESP_LOGW(TAG, "Нет подтверждения выхода из сети");
+        return ESP_ERR_TIMEOUT;
+    }
+    
+    zigbee_ctx.connected = false;
+    ESP_LOGI(TAG, "Устройство вышло из сети%s", rejoin ? " (ожидается повторное подключение)" : "");
+    return ESP_OK;
+}
+
 /**
  * @brief Установка типа устройства
  */
@@ -321,6 +1302,89 @@ esp_err_t esp_zigbee_enable_pairing(bool enable)
     return ESP_OK;
 }
 
+/**
+ * @brief Получение параметров текущей сети
+ */
+esp_err_t esp_zigbee_get_network_info(esp_zigbee_network_info_t *info)
+{
+    if (info == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    if (!zigbee_ctx.initialized || !zigbee_ctx.connected) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    info->pan_id = esp_zb_get_pan_id();
+    esp_zb_get_extended_pan_id(info->extended_pan_id);
+    info->channel = esp_zb_get_current_channel();
+    info->short_address = esp_zb_get_short_address();
+    info->parent_address = esp_zb_nwk_get_parent_address();
+    info->nwk_frame_counter = esp_zb_nwk_get_outgoing_frame_counter();
+    
+    return ESP_OK;
+}
+
+/**
+ * @brief Запрос текущего времени у координатора
+ */
+esp_err_t esp_zigbee_request_time(void)
+{
+    if (!zigbee_ctx.initialized || !zigbee_ctx.connected) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    uint16_t attr_id = TIME_LOCAL_TIME_ATTRIBUTE_ID;
+    
+    // Сервер кластера Time находится на координаторе
+    esp_zb_zcl_read_attr_cmd_t read_cmd = {
+        .zcl_basic_cmd = {
+            .dst_addr_u.addr_short = COORDINATOR_ADDR,
+            .dst_endpoint = COORDINATOR_ENDPOINT,
+            .src_endpoint = zigbee_ctx.endpoint_id,
+        },
+        .address_mode = ESP_ZB_APS_ADDR_MODE_16_ENDP_PRESENT,
+        .clusterID = TIME_CLUSTER_ID,
+        .attr_number = 1,
+        .attr_field = &attr_id,
+    };
+    
+    esp_zb_zcl_read_attr_cmd_req(&read_cmd);
+    
+    ESP_LOGI(TAG, "Запрос времени у координатора отправлен");
+    return ESP_OK;
+}
+
+/**
+ * @brief Отправка команды клиента OTA Upgrade серверу обновлений
+ */
+esp_err_t esp_zigbee_send_ota_command(uint8_t cmd_id, const uint8_t *payload, uint16_t len)
+{
+    if (!zigbee_ctx.initialized || !zigbee_ctx.connected) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    esp_zb_zcl_custom_cluster_cmd_t ota_cmd = {
+        .zcl_basic_cmd = {
+            .dst_addr_u.addr_short = COORDINATOR_ADDR,
+            .dst_endpoint = COORDINATOR_ENDPOINT,
+            .src_endpoint = zigbee_ctx.endpoint_id,
+        },
+        .address_mode = ESP_ZB_APS_ADDR_MODE_16_ENDP_PRESENT,
+        .cluster_id = OTA_UPGRADE_CLUSTER_ID,
+        .direction = ESP_ZB_ZCL_CMD_DIRECTION_TO_SRV,
+        .custom_cmd_id = cmd_id,
+        .data = {
+            .size = len,
+            .value = payload,
+        },
+    };
+    
+    esp_zb_zcl_custom_cluster_cmd_req(&ota_cmd);
+    
+    return ESP_OK;
+}
+
 /**
  * @brief Обработка входящих команд ZigBee
  */
@@ -346,8 +1410,8 @@ esp_err_t esp_zigbee_report_window_state(esp_zigbee_window_mode_t mode, uint8_t
 {
     ESP_LOGI(TAG, "Отправка состояния окна: режим=%d, положение=%d%%", mode, position);
     
-    if (!zigbee_ctx.initialized || !zigbee_ctx.started) {
-        ESP_LOGE(TAG, "ZigBee библиотека не инициализирована или не запущена");
+    if (!zigbee_ctx.initialized) {
+        ESP_LOGE(TAG, "ZigBee библиотека не инициализирована");
         return ESP_ERR_INVALID_STATE;
     }
     
@@ -395,20 +1459,10 @@ esp_err_t esp_zigbee_report_window_state(esp_zigbee_window_mode_t mode, uint8_t
         ESP_LOGW(TAG, "Не удалось установить атрибут положения: %d", pos_status);
     }
     
-    // Отправка отчета об изменении атрибутов
-    esp_zb_zcl_report_attr_cmd_t report_cmd = {
-        .zcl_basic_cmd = {
-            .dst_addr_u.addr_short = 0x0000,  // Адрес координатора
-            .dst_endpoint = 1,
-            .src_endpoint = zigbee_ctx.endpoint_id,
-        },
-        .cluster_id = WINDOW_COVERING_CLUSTER_ID,
-        .cluster_role = ZB_ZCL_CLUSTER_SERVER_ROLE,
-    };
-    
-    esp_zb_zcl_report_attr(&report_cmd);
+    // Отчет об изменении атрибутов уходит привязанным получателям через слот
+    report_slot_submit(REPORT_SLOT_ATTRS, 0);
     
-    ESP_LOGI(TAG, "Состояние окна успешно отправлено");
+    ESP_LOGI(TAG, "Состояние окна принято к отправке");
     return ESP_OK;
 }
 
@@ -419,8 +1473,8 @@ esp_err_t esp_zigbee_report_window_mode(uint8_t mode)
 {
     ESP_LOGI(TAG, "Отправка режима окна: %d", mode);
     
-    if (!zigbee_ctx.initialized || !zigbee_ctx.started) {
-        ESP_LOGE(TAG, "ZigBee библиотека не инициализирована или не запущена");
+    if (!zigbee_ctx.initialized) {
+        ESP_LOGE(TAG, "ZigBee библиотека не инициализирована");
         return ESP_ERR_INVALID_STATE;
     }
     
@@ -438,20 +1492,10 @@ esp_err_t esp_zigbee_report_window_mode(uint8_t mode)
         return ESP_FAIL;
     }
     
-    // Отправка отчета об изменении атрибута
-    esp_zb_zcl_report_attr_cmd_t report_cmd = {
-        .zcl_basic_cmd = {
-            .dst_addr_u.addr_short = 0x0000,  // Адрес координатора
-            .dst_endpoint = 1,
-            .src_endpoint = zigbee_ctx.endpoint_id,
-        },
-        .cluster_id = WINDOW_COVERING_CLUSTER_ID,
-        .cluster_role = ZB_ZCL_CLUSTER_SERVER_ROLE,
-    };
-    
-    esp_zb_zcl_report_attr(&report_cmd);
+    // Отчет об изменении атрибута уходит привязанным получателям через слот
+    report_slot_submit(REPORT_SLOT_ATTRS, 0);
     
-    ESP_LOGI(TAG, "Режим окна успешно отправлен");
+    ESP_LOGI(TAG, "Режим окна принят к отправке");
     return ESP_OK;
 }
 
@@ -462,8 +1506,8 @@ esp_err_t esp_zigbee_report_position(uint8_t position)
 {
     ESP_LOGI(TAG, "Отправка положения окна: %d%%", position);
     
-    if (!zigbee_ctx.initialized || !zigbee_ctx.started) {
-        ESP_LOGE(TAG, "ZigBee библиотека не инициализирована или не запущена");
+    if (!zigbee_ctx.initialized) {
+        ESP_LOGE(TAG, "ZigBee библиотека не инициализирована");
         return ESP_ERR_INVALID_STATE;
     }
     
@@ -481,20 +1525,10 @@ esp_err_t esp_zigbee_report_position(uint8_t position)
         return ESP_FAIL;
     }
     
-    // Отправка отчета об изменении атрибута
-    esp_zb_zcl_report_attr_cmd_t report_cmd = {
-        .zcl_basic_cmd = {
-            .dst_addr_u.addr_short = 0x0000,  // Адрес координатора
-            .dst_endpoint = 1,
-            .src_endpoint = zigbee_ctx.endpoint_id,
-        },
-        .cluster_id = WINDOW_COVERING_CLUSTER_ID,
-        .cluster_role = ZB_ZCL_CLUSTER_SERVER_ROLE,
-    };
-    
-    esp_zb_zcl_report_attr(&report_cmd);
+    // Отчет об изменении атрибута уходит привязанным получателям через слот
+    report_slot_submit(REPORT_SLOT_ATTRS, 0);
     
-    ESP_LOGI(TAG, "Положение окна успешно отправлено");
+    ESP_LOGI(TAG, "Положение окна принято к отправке");
     return ESP_OK;
 }
 
@@ -505,8 +1539,8 @@ esp_err_t esp_zigbee_send_alert(esp_zigbee_alert_type_t alert_type, uint8_t valu
 {
     ESP_LOGI(TAG, "Отправка уведомления: тип=%d, значение=%d", alert_type, value);
     
-    if (!zigbee_ctx.initialized || !zigbee_ctx.started) {
-        ESP_LOGE(TAG, "ZigBee библиотека не инициализирована или не запущена");
+    if (!zigbee_ctx.initialized) {
+        ESP_LOGE(TAG, "ZigBee библиотека не инициализирована");
         return ESP_ERR_INVALID_STATE;
     }
     
@@ -527,23 +1561,56 @@ esp_err_t esp_zigbee_send_alert(esp_zigbee_alert_type_t alert_type, uint8_t valu
             alarm_code = 0x04;  // Сработала защита
             break;
         default:
-            alarm_code = 0xFF;  // Неизвестный тип
-            break;
+            ESP_LOGE(TAG, "Неизвестный тип уведомления: %d", alert_type);
+            return ESP_ERR_INVALID_ARG;
     }
     
-    // Отправка уведомления через кластер Alarms
-    esp_zb_zcl_alarm_cmd_t alarm_cmd = {
-        .zcl_basic_cmd = {
-            .dst_addr_u.addr_short = 0x0000,  // Адрес координатора
-            .dst_endpoint = 1,
-            .src_endpoint = zigbee_ctx.endpoint_id,
-        },
-        .alarm_code = alarm_code,
-        .cluster_id = WINDOW_COVERING_CLUSTER_ID,
-    };
-    
-    esp_zb_zcl_alarm(&alarm_cmd);
+    // Уведомление кластера Alarms уходит привязанным получателям через слот типа
+    report_slot_submit(REPORT_SLOT_ALERT_BASE + alert_type, alarm_code);
     
-    ESP_LOGI(TAG, "Уведомление успешно отправлено");
+    ESP_LOGI(TAG, "Уведомление принято к отправке");
     return ESP_OK;
-} 
\ No newline at end of file
+}
+
+/**
+ * @brief Обновление значения собственного атрибута производителя
+ */
+esp_err_t esp_zigbee_set_manuf_attribute(uint16_t attr_id, const uint8_t *data, uint16_t len)
+{
+    if (!zigbee_ctx.initialized) {
+        ESP_LOGE(TAG, "ZigBee библиотека не инициализирована");
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    if (data == NULL || len > ESP_ZIGBEE_MANUF_ATTR_MAX_LEN) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    for (size_t i = 0; i < MANUF_ATTR_COUNT; i++) {
+        if (manuf_attrs[i].attr_id != attr_id) {
+            continue;
+        }
+        
+        manuf_attrs[i].value[0] = (uint8_t)len;
+        memcpy(&manuf_attrs[i].value[1], data, len);
+        
+        esp_zb_zcl_status_t status = esp_zb_zcl_set_manufacturer_attribute_val(
+            zigbee_ctx.window_ep,
+            WINDOW_COVERING_CLUSTER_ID,
+            ZB_ZCL_CLUSTER_SERVER_ROLE,
+            ESP_ZIGBEE_MANUFACTURER_CODE,
+            attr_id,
+            manuf_attrs[i].value,
+            false);
+        
+        if (status != ESP_ZB_ZCL_STATUS_SUCCESS) {
+            ESP_LOGW(TAG, "Не удалось обновить атрибут 0x%04X: %d", attr_id, status);
+            return ESP_FAIL;
+        }
+        
+        return ESP_OK;
+    }
+    
+    ESP_LOGW(TAG, "Неизвестный атрибут производителя: 0x%04X", attr_id);
+    return ESP_ERR_NOT_FOUND;
+}
@@ -29,6 +29,14 @@ typedef enum {
     ESP_ZIGBEE_DEVICE_TYPE_COVER          // Шторы/жалюзи/окна
 } esp_zigbee_device_type_t;
 
+/**
+ * @brief Роль устройства в сети ZigBee
+ */
+typedef enum {
+    ESP_ZIGBEE_ROLE_END_DEVICE = 0,       // Спящее конечное устройство (питание от батареи)
+    ESP_ZIGBEE_ROLE_ROUTER = 1            // Маршрутизатор (внешнее питание)
+} esp_zigbee_role_t;
+
 /**
  * @brief Режимы окна для отчета через ZigBee
  */
@@ -57,9 +65,71 @@ typedef enum {
     ESP_ZIGBEE_CMD_SET_POSITION,    // Установка положения
     ESP_ZIGBEE_CMD_STOP,            // Остановка движения
     ESP_ZIGBEE_CMD_CALIBRATE,       // Калибровка
-    ESP_ZIGBEE_CMD_PING             // Проверка связи
+    ESP_ZIGBEE_CMD_PING,            // Проверка связи
+    ESP_ZIGBEE_CMD_STORE_SCENE,     // Сохранение сцены (данные: группа LE16, сцена)
+    ESP_ZIGBEE_CMD_RECALL_SCENE,    // Вызов сцены (данные: группа LE16, сцена)
+    ESP_ZIGBEE_CMD_REMOVE_SCENE,    // Удаление сцены (данные: группа LE16, сцена)
+    ESP_ZIGBEE_CMD_REMOVE_ALL_SCENES, // Удаление всех сцен группы (данные: группа LE16)
+    ESP_ZIGBEE_CMD_SET_SCHEDULE,    // Запись расписания (данные: индекс, дни недели, час, минута, режим, зазор)
+    ESP_ZIGBEE_CMD_CLEAR_SCHEDULE,  // Удаление расписания (данные: индекс, 0xFF - все записи)
+    ESP_ZIGBEE_CMD_SET_RULE,        // Запись правила автоматизации (данные: индекс, датчик, условие, порог LE16, режим, зазор)
+    ESP_ZIGBEE_CMD_CLEAR_RULE,      // Удаление правила автоматизации (данные: индекс, 0xFF - все правила)
+    ESP_ZIGBEE_CMD_READ_HISTORY,    // Выгрузка страницы журнала событий (данные: номер первого события LE32)
+    ESP_ZIGBEE_CMD_WRITE_CONFIG     // Запись параметров устройства (данные: пакет конфигурации, см. device_config.h)
 } esp_zigbee_cmd_t;
 
+/**
+ * @brief Сведения об источнике входящей команды
+ */
+typedef struct {
+    uint16_t src_addr;              // Короткий адрес отправителя
+    uint8_t src_endpoint;           // Эндпоинт отправителя
+    uint8_t tsn;                    // Порядковый номер ZCL
+    bool group_addressed;           // Команда адресована группе
+    uint16_t group_id;              // Идентификатор группы (если адресована группе)
+} esp_zigbee_cmd_info_t;
+
+/**
+ * @brief Типы событий от привязанных датчиков
+ */
+typedef enum {
+    ESP_ZIGBEE_SENSOR_ON_OFF = 0,       // Команда On/Off (значение: 0 - выкл, 1 - вкл)
+    ESP_ZIGBEE_SENSOR_IAS_ZONE = 1,     // Изменение статуса зоны IAS (значение: биты ZoneStatus)
+    ESP_ZIGBEE_SENSOR_TEMPERATURE = 2   // Отчет о температуре (значение: сотые доли °C)
+} esp_zigbee_sensor_type_t;
+
+/**
+ * @brief Событие от привязанного датчика
+ */
+typedef struct {
+    esp_zigbee_sensor_type_t type;  // Тип события
+    uint16_t src_addr;              // Короткий адрес датчика
+    uint8_t src_endpoint;           // Эндпоинт датчика
+    int32_t value;                  // Значение события
+} esp_zigbee_sensor_event_t;
+
+/**
+ * @brief Код производителя для собственных атрибутов
+ */
+#define ESP_ZIGBEE_MANUFACTURER_CODE 0x131B
+
+/**
+ * @brief Собственные атрибуты производителя кластера Window Covering
+ */
+#define ESP_ZIGBEE_MANUF_ATTR_LATENCY_HIST 0xF000 // Гистограммы задержек команд
+#define ESP_ZIGBEE_MANUF_ATTR_HISTORY_PAGE 0xF001 // Страница журнала событий
+#define ESP_ZIGBEE_MANUF_ATTR_CONFIG       0xF002 // Текущие параметры устройства
+
+/**
+ * @brief Максимальная длина значения собственного атрибута (octet string)
+ */
+#define ESP_ZIGBEE_MANUF_ATTR_MAX_LEN 254
+
+/**
+ * @brief Время ожидания подтверждения выхода из сети, мс
+ */
+#define ESP_ZIGBEE_LEAVE_TIMEOUT_MS 3000
+
 /**
  * @brief Тип колбэка для события подключения к сети ZigBee
  */
@@ -72,8 +142,69 @@ typedef void (*esp_zigbee_disconnected_cb_t)(void);
 
 /**
  * @brief Тип колбэка для события получения команды
+ * 
+ * @return bool true, если команда принята к исполнению. Непринятая команда
+ *         не запоминается для подавления повторов, и ее повтор хабом будет выполнен
+ */
+typedef bool (*esp_zigbee_command_cb_t)(uint8_t cmd, const uint8_t *data, uint16_t len,
+                                        const esp_zigbee_cmd_info_t *info);
+
+/**
+ * @brief Тип колбэка синхронизации времени
+ * 
+ * @param local_time Местное время в секундах от 2000-01-01 00:00 (атрибут LocalTime кластера Time)
+ */
+typedef void (*esp_zigbee_time_cb_t)(uint32_t local_time);
+
+/**
+ * @brief Тип колбэка события от привязанного датчика
+ */
+typedef void (*esp_zigbee_sensor_cb_t)(const esp_zigbee_sensor_event_t *event);
+
+/**
+ * @brief Тип колбэка команды сервера OTA Upgrade (кластер 0x0019)
+ * 
+ * Вызывается в контексте стека ZigBee: обработчик должен только скопировать
+ * данные и передать их своей задаче.
+ * 
+ * @param cmd_id Идентификатор команды ZCL (Image Notify, Query Next Image Response...)
+ * @param payload Полезная нагрузка команды
+ * @param len Длина полезной нагрузки
+ */
+typedef void (*esp_zigbee_ota_cb_t)(uint8_t cmd_id, const uint8_t *payload, uint16_t len);
+
+/**
+ * @brief Тип колбэка проверки наличия сцены
+ * 
+ * Вызывается в контексте стека ZigBee при одиночном вызове сцены, чтобы
+ * ответить координатору статусом NOT_FOUND для неизвестной сцены.
+ * 
+ * @param group_id Идентификатор группы
+ * @param scene_id Идентификатор сцены
+ * @return bool true, если сцена есть в таблице
+ */
+typedef bool (*esp_zigbee_scene_lookup_cb_t)(uint16_t group_id, uint8_t scene_id);
+
+/**
+ * @brief Тип колбэка доставки отчета атрибутов Window Covering
+ * 
+ * Вызывается в контексте стека ZigBee, когда последнее принятое к отправке
+ * значение атрибутов подтверждено (APS) всеми получателями. Замещенные
+ * значения не подтверждаются.
  */
-typedef void (*esp_zigbee_command_cb_t)(uint8_t cmd, const uint8_t *data, uint16_t len);
+typedef void (*esp_zigbee_report_sent_cb_t)(void);
+
+/**
+ * @brief Параметры сети, в которую вошло устройство
+ */
+typedef struct {
+    uint16_t pan_id;                        // Идентификатор сети
+    uint8_t extended_pan_id[8];             // Расширенный идентификатор сети
+    uint8_t channel;                        // Номер канала
+    uint16_t short_address;                 // Короткий адрес устройства
+    uint16_t parent_address;                // Короткий адрес родительского узла
+    uint32_t nwk_frame_counter;             // Счетчик исходящих кадров сетевого ключа
+} esp_zigbee_network_info_t;
 
 /**
  * @brief Конфигурация ZigBee устройства
@@ -82,11 +213,19 @@ typedef struct {
     const char *device_name;                // Имя устройства
     uint16_t pan_id;                        // Идентификатор сети (0 для автовыбора)
     uint8_t channel;                        // Номер канала (0 для автовыбора)
+    const esp_zigbee_network_info_t *restore_network; // Сохраненные параметры сети (NULL - новое подключение)
+    esp_zigbee_role_t role;                 // Роль в сети (задается при инициализации)
+    bool rejoin_network;                    // Сеть сохранена в другой роли: вход повторным подключением
     bool auto_join;                         // Автоматическое подключение
     uint32_t join_timeout_ms;               // Таймаут подключения в мс
     esp_zigbee_connected_cb_t on_connected;     // Колбэк подключения
     esp_zigbee_disconnected_cb_t on_disconnected; // Колбэк отключения
     esp_zigbee_command_cb_t on_command;         // Колбэк команды
+    esp_zigbee_time_cb_t on_time;               // Колбэк синхронизации времени
+    esp_zigbee_sensor_cb_t on_sensor;           // Колбэк событий привязанных датчиков
+    esp_zigbee_ota_cb_t on_ota;                 // Колбэк команд сервера OTA
+    esp_zigbee_scene_lookup_cb_t on_scene_lookup; // Колбэк проверки наличия сцены
+    esp_zigbee_report_sent_cb_t on_report_sent; // Колбэк доставки отчета атрибутов
 } esp_zigbee_config_t;
 
 /**
@@ -111,6 +250,18 @@ esp_err_t esp_zigbee_start(void);
  */
 esp_err_t esp_zigbee_stop(void);
 
+/**
+ * @brief Выход из сети с уведомлением родителя
+ * 
+ * Родитель удаляет запись об устройстве; при rejoin = true координатор
+ * ожидает повторного подключения того же устройства. Функция ждет
+ * подтверждения не дольше ESP_ZIGBEE_LEAVE_TIMEOUT_MS.
+ * 
+ * @param rejoin Устройство вернется в сеть повторным подключением
+ * @return esp_err_t ESP_OK при подтвержденном выходе, ESP_ERR_TIMEOUT без подтверждения
+ */
+esp_err_t esp_zigbee_leave(bool rejoin);
+
 /**
  * @brief Установка типа устройства
  * 
@@ -127,6 +278,33 @@ esp_err_t esp_zigbee_set_device_type(esp_zigbee_device_type_t device_type);
  */
 esp_err_t esp_zigbee_enable_pairing(bool enable);
 
+/**
+ * @brief Получение параметров текущей сети
+ * 
+ * @param info Указатель на структуру для записи параметров
+ * @return esp_err_t ESP_OK при успешном получении, ESP_ERR_INVALID_STATE если сеть не подключена
+ */
+esp_err_t esp_zigbee_get_network_info(esp_zigbee_network_info_t *info);
+
+/**
+ * @brief Запрос текущего времени у координатора (клиент кластера Time)
+ * 
+ * Ответ доставляется асинхронно в колбэк on_time.
+ * 
+ * @return esp_err_t ESP_OK при успешной отправке запроса
+ */
+esp_err_t esp_zigbee_request_time(void);
+
+/**
+ * @brief Отправка команды клиента OTA Upgrade серверу обновлений (координатору)
+ * 
+ * @param cmd_id Идентификатор команды ZCL (Query Next Image, Image Block Request...)
+ * @param payload Полезная нагрузка команды
+ * @param len Длина полезной нагрузки
+ * @return esp_err_t ESP_OK при успешной отправке
+ */
+esp_err_t esp_zigbee_send_ota_command(uint8_t cmd_id, const uint8_t *payload, uint16_t len);
+
 /**
  * @brief Обработка входящих команд ZigBee
  * 
@@ -137,14 +315,18 @@ esp_err_t esp_zigbee_process_commands(void);
 /**
  * @brief Отправка состояния окна
  * 
+ * Значение помещается в слот надежной доставки: кадр повторяется, пока
+ * получатели не подтвердят прием на уровне APS, а новое значение замещает
+ * неподтвержденное. Без сети значение ждет в слоте до подключения.
+ * 
  * @param mode Режим работы окна
  * @param position Положение (процент открытия)
- * @return esp_err_t ESP_OK при успешной отправке
+ * @return esp_err_t ESP_OK, если значение принято к отправке
  */
 esp_err_t esp_zigbee_report_window_state(esp_zigbee_window_mode_t mode, uint8_t position);
 
 /**
- * @brief Отправка режима окна
+ * @brief Отправка режима окна (через слот надежной доставки)
  * 
  * @param mode Режим работы окна
  * @return esp_err_t ESP_OK при успешной отправке
@@ -152,7 +334,7 @@ esp_err_t esp_zigbee_report_window_state(esp_zigbee_window_mode_t mode, uint8_t
 esp_err_t esp_zigbee_report_window_mode(uint8_t mode);
 
 /**
- * @brief Отправка положения окна
+ * @brief Отправка положения окна (через слот надежной доставки)
  * 
  * @param position Положение (процент открытия)
  * @return esp_err_t ESP_OK при успешной отправке
@@ -162,12 +344,24 @@ esp_err_t esp_zigbee_report_position(uint8_t position);
 /**
  * @brief Отправка уведомления о событии
  * 
+ * У каждого типа уведомления свой слот надежной доставки.
+ * 
  * @param alert_type Тип уведомления
  * @param value Значение (зависит от типа уведомления)
  * @return esp_err_t ESP_OK при успешной отправке
  */
 esp_err_t esp_zigbee_send_alert(esp_zigbee_alert_type_t alert_type, uint8_t value);
 
+/**
+ * @brief Обновление значения собственного атрибута производителя
+ * 
+ * @param attr_id Идентификатор атрибута (ESP_ZIGBEE_MANUF_ATTR_*)
+ * @param data Значение атрибута
+ * @param len Длина значения (не более ESP_ZIGBEE_MANUF_ATTR_MAX_LEN)
+ * @return esp_err_t ESP_OK при успешном обновлении
+ */
+esp_err_t esp_zigbee_set_manuf_attribute(uint16_t attr_id, const uint8_t *data, uint16_t len);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,71 @@
+/**
+ * @file event_bus.c
+ * @brief Реализация шины внутренних событий устройства
+ */
+
+#include "event_bus.h"
+#include <stddef.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static const char *TAG = "EVENT_BUS";
+
+// Подписчик события
+typedef struct {
+    event_bus_handler_t handler;    // Обработчик
+    void *ctx;                      // Контекст обработчика
+} event_bus_subscriber_t;
+
+// Таблицы подписчиков по типам событий
+static event_bus_subscriber_t subscribers[EVENT_BUS_MAX][EVENT_BUS_MAX_SUBSCRIBERS];
+static volatile uint8_t subscriber_count[EVENT_BUS_MAX];
+static portMUX_TYPE bus_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief Подписка на события одного типа
+ */
+esp_err_t event_bus_subscribe(event_bus_id_t id, event_bus_handler_t handler, void *ctx)
+{
+    if (id >= EVENT_BUS_MAX || handler == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    esp_err_t err = ESP_OK;
+    
+    taskENTER_CRITICAL(&bus_lock);
+    uint8_t count = subscriber_count[id];
+    if (count < EVENT_BUS_MAX_SUBSCRIBERS) {
+        subscribers[id][count].handler = handler;
+        subscribers[id][count].ctx = ctx;
+        // Запись становится видна издателям только после заполнения
+        subscriber_count[id] = count + 1;
+    } else {
+        err = ESP_ERR_NO_MEM;
+    }
+    taskEXIT_CRITICAL(&bus_lock);
+    
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Таблица подписчиков события %d заполнена", id);
+    }
+    
+    return err;
+}
+
+/**
+ * @brief Публикация события
+ */
+esp_err_t event_bus_publish(const event_bus_event_t *event)
+{
+    if (event == NULL || event->id >= EVENT_BUS_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    uint8_t count = subscriber_count[event->id];
+    for (uint8_t i = 0; i < count; i++) {
+        const event_bus_subscriber_t *subscriber = &subscribers[event->id][i];
+        subscriber->handler(event, subscriber->ctx);
+    }
+    
+    return ESP_OK;
+}
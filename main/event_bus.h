@@ -0,0 +1,79 @@
+/**
+ * @file event_bus.h
+ * @brief Шина внутренних событий устройства
+ * 
+ * Подписчики хранятся в статических таблицах по типам событий. Событие
+ * передается подписчикам синхронно в задаче издателя в порядке подписки,
+ * без очередей и выделения памяти. Обработчик не должен надолго блокироваться.
+ */
+
+#ifndef EVENT_BUS_H
+#define EVENT_BUS_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "servo_control.h"
+#include "event_history.h"
+
+/**
+ * @brief Максимальное число подписчиков одного типа событий
+ */
+#define EVENT_BUS_MAX_SUBSCRIBERS 4
+
+/**
+ * @brief Типы событий шины
+ */
+typedef enum {
+    EVENT_BUS_POSITION_CHANGED = 0,     ///< Окно заняло новое положение
+    EVENT_BUS_RESISTANCE_DETECTED,      ///< Обнаружено механическое сопротивление
+    EVENT_BUS_MAX
+} event_bus_id_t;
+
+/**
+ * @brief Событие шины с данными
+ */
+typedef struct {
+    event_bus_id_t id;                  ///< Тип события
+    union {
+        struct {
+            window_mode_t mode;         ///< Режим окна
+            uint8_t gap_percentage;     ///< Процент открытия зазора
+            event_source_t source;      ///< Источник команды
+        } position;                     ///< EVENT_BUS_POSITION_CHANGED
+        struct {
+            uint8_t handle_angle;       ///< Угол ручки в момент остановки
+        } resistance;                   ///< EVENT_BUS_RESISTANCE_DETECTED
+    };
+} event_bus_event_t;
+
+/**
+ * @brief Обработчик события
+ * 
+ * @param event Событие (действительно только на время вызова)
+ * @param ctx Контекст, переданный при подписке
+ */
+typedef void (*event_bus_handler_t)(const event_bus_event_t *event, void *ctx);
+
+/**
+ * @brief Подписка на события одного типа
+ * 
+ * Подписка выполняется при инициализации модулей, до публикации событий.
+ * 
+ * @param id Тип события
+ * @param handler Обработчик
+ * @param ctx Контекст обработчика
+ * @return esp_err_t ESP_ERR_NO_MEM, если таблица подписчиков заполнена
+ */
+esp_err_t event_bus_subscribe(event_bus_id_t id, event_bus_handler_t handler, void *ctx);
+
+/**
+ * @brief Публикация события
+ * 
+ * Обработчики вызываются в текущей задаче в порядке подписки.
+ * 
+ * @param event Событие
+ * @return esp_err_t ESP_ERR_INVALID_ARG при неизвестном типе события
+ */
+esp_err_t event_bus_publish(const event_bus_event_t *event);
+
+#endif /* EVENT_BUS_H */
@@ -0,0 +1,305 @@
+/**
+ * @file event_history.c
+ * @brief Реализация журнала событий устройства
+ */
+
+#include "event_history.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "schedule.h"
+#include "state_management.h"
+#include "event_bus.h"
+
+static const char *TAG = "EVENT_HISTORY";
+
+// Журнал хранится в NVS страницами, чтобы новое событие перезаписывало одну страницу
+#define HISTORY_NVS_NAMESPACE   "evt_history"
+#define HISTORY_PAGE_RECORDS    16
+#define HISTORY_PAGE_COUNT      (EVENT_HISTORY_SIZE / HISTORY_PAGE_RECORDS)
+
+// Кольцевой буфер: событие с номером N хранится в записи (N - 1) % EVENT_HISTORY_SIZE
+static event_record_t records[EVENT_HISTORY_SIZE];
+
+// Прототипы вспомогательных функций
+static void history_page_key(int page, char *key, size_t key_size);
+static void history_load(void);
+static void history_put_le32(uint8_t *buf, uint32_t value);
+static void history_on_position_changed(const event_bus_event_t *event, void *ctx);
+static void history_on_resistance_detected(const event_bus_event_t *event, void *ctx);
+
+// Контекст журнала
+static struct {
+    SemaphoreHandle_t mutex;        // Защита буфера и счетчиков
+    nvs_handle_t nvs_handle;        // Пространство имен журнала
+    bool loaded;                    // Буфер прочитан из NVS
+    uint32_t next_sequence;         // Номер следующего события
+    uint32_t dirty_pages;           // Страницы с незаписанными событиями
+} history_ctx = {
+    .mutex = NULL,
+    .loaded = false,
+    .next_sequence = 1,
+    .dirty_pages = 0
+};
+
+/**
+ * @brief Ключ NVS страницы журнала
+ */
+static void history_page_key(int page, char *key, size_t key_size)
+{
+    snprintf(key, key_size, "page%d", page);
+}
+
+/**
+ * @brief Чтение журнала из NVS (вызывается под mutex)
+ */
+static void history_load(void)
+{
+    if (history_ctx.loaded) {
+        return;
+    }
+    
+    history_ctx.loaded = true;
+    
+    for (int page = 0; page < HISTORY_PAGE_COUNT; page++) {
+        char key[12];
+        history_page_key(page, key, sizeof(key));
+        
+        event_record_t *dst = &records[page * HISTORY_PAGE_RECORDS];
+        size_t size = HISTORY_PAGE_RECORDS * sizeof(event_record_t);
+        esp_err_t err = nvs_get_blob(history_ctx.nvs_handle, key, dst, &size);
+        if (err != ESP_OK || size != HISTORY_PAGE_RECORDS * sizeof(event_record_t)) {
+            // Страница еще не записывалась или повреждена
+            memset(dst, 0, HISTORY_PAGE_RECORDS * sizeof(event_record_t));
+            continue;
+        }
+        
+        // Номер следующего события продолжает самый новый сохраненный
+        for (int i = 0; i < HISTORY_PAGE_RECORDS; i++) {
+            if (dst[i].sequence >= history_ctx.next_sequence) {
+                history_ctx.next_sequence = dst[i].sequence + 1;
+            }
+        }
+    }
+    
+    ESP_LOGI(TAG, "Журнал событий загружен, следующее событие: %lu",
+             (unsigned long)history_ctx.next_sequence);
+}
+
+/**
+ * @brief Запись числа в буфер в порядке little-endian
+ */
+static void history_put_le32(uint8_t *buf, uint32_t value)
+{
+    buf[0] = value & 0xFF;
+    buf[1] = (value >> 8) & 0xFF;
+    buf[2] = (value >> 16) & 0xFF;
+    buf[3] = (value >> 24) & 0xFF;
+}
+
+/**
+ * @brief Инициализация журнала событий
+ */
+esp_err_t event_history_init(void)
+{
+    history_ctx.mutex = xSemaphoreCreateMutex();
+    if (history_ctx.mutex == NULL) {
+        ESP_LOGE(TAG, "Не удалось создать мьютекс журнала событий");
+        return ESP_ERR_NO_MEM;
+    }
+    
+    esp_err_t err = nvs_open(HISTORY_NVS_NAMESPACE, NVS_READWRITE, &history_ctx.nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Ошибка открытия NVS: %s", esp_err_to_name(err));
+        return err;
+    }
+    
+    // События окна поступают через шину событий
+    err = event_bus_subscribe(EVENT_BUS_POSITION_CHANGED, history_on_position_changed, NULL);
+    if (err == ESP_OK) {
+        err = event_bus_subscribe(EVENT_BUS_RESISTANCE_DETECTED, history_on_resistance_detected, NULL);
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+    
+    // Новые события записываются вместе с состоянием устройства
+    return state_register_flush_hook(event_history_flush);
+}
+
+/**
+ * @brief Обработчик события смены положения окна
+ */
+static void history_on_position_changed(const event_bus_event_t *event, void *ctx)
+{
+    // Источник изменения попадает в журнал событий
+    event_history_record(EVENT_TYPE_MODE_CHANGE, event->position.source,
+                         (uint16_t)event->position.mode | ((uint16_t)event->position.gap_percentage << 8));
+}
+
+/**
+ * @brief Обработчик события механического сопротивления
+ */
+static void history_on_resistance_detected(const event_bus_event_t *event, void *ctx)
+{
+    event_history_record(EVENT_TYPE_STALL, EVENT_SOURCE_SYSTEM, event->resistance.handle_angle);
+}
+
+/**
+ * @brief Добавление события
+ */
+esp_err_t event_history_record(event_type_t type, event_source_t source, uint16_t data)
+{
+    if (history_ctx.mutex == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    event_record_t record = {
+        .type = (uint8_t)type,
+        .source = (uint8_t)source,
+        .data = data
+    };
+    
+    // До синхронизации часов время отсчитывается от загрузки
+    uint32_t timestamp;
+    if (schedule_get_time(&timestamp)) {
+        record.timestamp = timestamp;
+    } else {
+        record.timestamp = (uint32_t)(esp_timer_get_time() / 1000000);
+        record.source |= EVENT_FLAG_UPTIME;
+    }
+    
+    xSemaphoreTake(history_ctx.mutex, portMAX_DELAY);
+    history_load();
+    
+    record.sequence = history_ctx.next_sequence++;
+    uint32_t index = (record.sequence - 1) % EVENT_HISTORY_SIZE;
+    records[index] = record;
+    history_ctx.dirty_pages |= 1UL << (index / HISTORY_PAGE_RECORDS);
+    xSemaphoreGive(history_ctx.mutex);
+    
+    ESP_LOGD(TAG, "Событие %lu: тип=%d, источник=0x%02X, данные=0x%04X",
+             (unsigned long)record.sequence, record.type, record.source, record.data);
+    
+    // Страница перезаписывается целиком, поэтому NVS обновляется один раз
+    // на заполненную страницу; остальные события записываются перед сном
+    // или перезагрузкой
+    if (index % HISTORY_PAGE_RECORDS == HISTORY_PAGE_RECORDS - 1) {
+        state_request_flush();
+    } else {
+        state_request_flush_on_save();
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Запись новых событий в энергонезависимую память
+ */
+esp_err_t event_history_flush(void)
+{
+    if (history_ctx.mutex == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    event_record_t page_records[HISTORY_PAGE_RECORDS];
+    bool written = false;
+    esp_err_t err = ESP_OK;
+    
+    for (int page = 0; page < HISTORY_PAGE_COUNT && err == ESP_OK; page++) {
+        // Страница копируется под mutex, запись во флеш не задерживает новые события
+        xSemaphoreTake(history_ctx.mutex, portMAX_DELAY);
+        bool dirty = (history_ctx.dirty_pages & (1UL << page)) != 0;
+        if (dirty) {
+            memcpy(page_records, &records[page * HISTORY_PAGE_RECORDS], sizeof(page_records));
+            history_ctx.dirty_pages &= ~(1UL << page);
+        }
+        xSemaphoreGive(history_ctx.mutex);
+        
+        if (!dirty) {
+            continue;
+        }
+        
+        char key[12];
+        history_page_key(page, key, sizeof(key));
+        err = nvs_set_blob(history_ctx.nvs_handle, key, page_records, sizeof(page_records));
+        if (err != ESP_OK) {
+            // Страница будет записана при следующей попытке
+            xSemaphoreTake(history_ctx.mutex, portMAX_DELAY);
+            history_ctx.dirty_pages |= 1UL << page;
+            xSemaphoreGive(history_ctx.mutex);
+            ESP_LOGE(TAG, "Ошибка записи страницы журнала %d: %s", page, esp_err_to_name(err));
+            break;
+        }
+        written = true;
+    }
+    
+    if (written) {
+        esp_err_t commit_err = nvs_commit(history_ctx.nvs_handle);
+        if (commit_err != ESP_OK) {
+            ESP_LOGE(TAG, "Ошибка фиксации журнала событий: %s", esp_err_to_name(commit_err));
+            err = commit_err;
+        }
+    }
+    
+    return err;
+}
+
+/**
+ * @brief Выгрузка страницы журнала
+ */
+esp_err_t event_history_export(uint32_t from_sequence, uint8_t *buf, size_t buf_size, size_t *out_len)
+{
+    if (buf == NULL || out_len == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    if (buf_size < EVENT_HISTORY_PAGE_HEADER_SIZE) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    
+    if (history_ctx.mutex == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    size_t max_records = (buf_size - EVENT_HISTORY_PAGE_HEADER_SIZE) / sizeof(event_record_t);
+    size_t pos = EVENT_HISTORY_PAGE_HEADER_SIZE;
+    uint8_t count = 0;
+    
+    xSemaphoreTake(history_ctx.mutex, portMAX_DELAY);
+    history_load();
+    
+    // Более старые события уже перезаписаны
+    uint32_t oldest = history_ctx.next_sequence > EVENT_HISTORY_SIZE ?
+                      history_ctx.next_sequence - EVENT_HISTORY_SIZE : 1;
+    uint32_t sequence = from_sequence < oldest ? oldest : from_sequence;
+    
+    for (; sequence < history_ctx.next_sequence && count < max_records; sequence++) {
+        const event_record_t *record = &records[(sequence - 1) % EVENT_HISTORY_SIZE];
+        if (record->sequence != sequence) {
+            // Событие потеряно (например, страница не была записана до сброса)
+            continue;
+        }
+        
+        history_put_le32(&buf[pos], record->sequence);
+        history_put_le32(&buf[pos + 4], record->timestamp);
+        buf[pos + 8] = record->type;
+        buf[pos + 9] = record->source;
+        buf[pos + 10] = record->data & 0xFF;
+        buf[pos + 11] = record->data >> 8;
+        pos += sizeof(event_record_t);
+        count++;
+    }
+    xSemaphoreGive(history_ctx.mutex);
+    
+    buf[0] = EVENT_HISTORY_PAGE_VERSION;
+    buf[1] = count;
+    history_put_le32(&buf[2], sequence);
+    
+    *out_len = pos;
+    return ESP_OK;
+}
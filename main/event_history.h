@@ -0,0 +1,130 @@
+/**
+ * @file event_history.h
+ * @brief Журнал событий устройства в энергонезависимой памяти
+ * 
+ * Кольцевой буфер из EVENT_HISTORY_SIZE записей по 12 байт: смены режима
+ * с источником команды, заклинивания, переходы уровня батареи, перезагрузки
+ * и результаты OTA. Страница из 16 записей попадает в NVS отложенной записью
+ * модуля состояния, когда заполнится, а незаполненная - перед сном или
+ * перезагрузкой; при отключении питания теряется не более одной страницы.
+ * 
+ * Журнал читается хабом постранично: команда производителя задает номер
+ * первого события, страница выгружается в собственный атрибут производителя.
+ */
+
+#ifndef EVENT_HISTORY_H
+#define EVENT_HISTORY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+/**
+ * @brief Количество записей в кольцевом буфере
+ */
+#define EVENT_HISTORY_SIZE 128
+
+/**
+ * @brief Версия формата страницы выгрузки
+ */
+#define EVENT_HISTORY_PAGE_VERSION 1
+
+/**
+ * @brief Размер заголовка страницы выгрузки
+ * 
+ * Заголовок: версия (1 байт), число записей (1 байт), номер события для
+ * запроса следующей страницы (LE32). Далее следуют записи event_record_t.
+ */
+#define EVENT_HISTORY_PAGE_HEADER_SIZE 6
+
+/**
+ * @brief Флаг источника: время записи отсчитано от загрузки (часы не синхронизированы)
+ */
+#define EVENT_FLAG_UPTIME 0x80
+
+/**
+ * @brief Типы событий
+ */
+typedef enum {
+    EVENT_TYPE_MODE_CHANGE = 1,     ///< Смена положения (данные: режим, зазор << 8)
+    EVENT_TYPE_STALL = 2,           ///< Механическое сопротивление (данные: угол ручки)
+    EVENT_TYPE_BATTERY = 3,         ///< Смена уровня батареи (данные: event_battery_level_t, заряд % << 8)
+    EVENT_TYPE_REBOOT = 4,          ///< Перезагрузка (данные: причина сброса esp_reset_reason_t)
+    EVENT_TYPE_OTA_RESULT = 5       ///< Результат загрузки OTA (данные: статус ZCL Upgrade End)
+} event_type_t;
+
+/**
+ * @brief Источники событий
+ */
+typedef enum {
+    EVENT_SOURCE_SYSTEM = 0,        ///< Само устройство (загрузка, датчики, OTA)
+    EVENT_SOURCE_ZIGBEE = 1,        ///< Команда или сцена от хаба
+    EVENT_SOURCE_SCHEDULE = 2,      ///< Локальное расписание
+    EVENT_SOURCE_AUTOMATION = 3     ///< Правило локальной автоматизации
+} event_source_t;
+
+/**
+ * @brief Уровни батареи для события EVENT_TYPE_BATTERY
+ */
+typedef enum {
+    EVENT_BATTERY_NORMAL = 0,       ///< Заряд восстановлен
+    EVENT_BATTERY_LOW = 1,          ///< Низкий заряд
+    EVENT_BATTERY_CRITICAL = 2      ///< Критически низкий заряд
+} event_battery_level_t;
+
+/**
+ * @brief Запись журнала (12 байт, little-endian)
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t sequence;              ///< Номер события, растет через перезагрузки (0 - запись пуста)
+    uint32_t timestamp;             ///< Местное время от 2000-01-01 (с) или время от загрузки при EVENT_FLAG_UPTIME
+    uint8_t type;                   ///< event_type_t
+    uint8_t source;                 ///< event_source_t | EVENT_FLAG_*
+    uint16_t data;                  ///< Данные события
+} event_record_t;
+
+/**
+ * @brief Инициализация журнала событий
+ * 
+ * Журнал читается из NVS при первом обращении, поэтому пробуждение
+ * без событий не затрагивает флеш.
+ * 
+ * @return esp_err_t ESP_OK при успешной инициализации
+ */
+esp_err_t event_history_init(void);
+
+/**
+ * @brief Добавление события
+ * 
+ * @param type Тип события
+ * @param source Источник события
+ * @param data Данные события (см. event_type_t)
+ * @return esp_err_t ESP_OK при успешном добавлении
+ */
+esp_err_t event_history_record(event_type_t type, event_source_t source, uint16_t data);
+
+/**
+ * @brief Запись новых событий в энергонезависимую память
+ * 
+ * Вызывается задачей отложенной записи модуля состояния и из state_save()
+ * перед сном или перезагрузкой.
+ * 
+ * @return esp_err_t ESP_OK при успешной записи
+ */
+esp_err_t event_history_flush(void);
+
+/**
+ * @brief Выгрузка страницы журнала
+ * 
+ * Страница начинается с самого старого сохраненного события с номером
+ * не меньше from_sequence. Пустая страница означает конец журнала.
+ * 
+ * @param from_sequence Номер первого запрашиваемого события
+ * @param buf Буфер для страницы
+ * @param buf_size Размер буфера
+ * @param out_len Длина страницы
+ * @return esp_err_t ESP_OK при успешной выгрузке
+ */
+esp_err_t event_history_export(uint32_t from_sequence, uint8_t *buf, size_t buf_size, size_t *out_len);
+
+#endif /* EVENT_HISTORY_H */
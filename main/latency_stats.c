@@ -0,0 +1,108 @@
+/**
+ * @file latency_stats.c
+ * @brief Реализация гистограмм задержек обработки команд ZigBee
+ */
+
+#include "latency_stats.h"
+#include <string.h>
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+// Размер выгрузки: заголовок и счетчики всех этапов
+#define LATENCY_EXPORT_SIZE (2 + LATENCY_STAGE_MAX * LATENCY_HIST_BUCKETS * sizeof(uint16_t))
+
+// Гистограммы задержек по этапам (этапы отмечаются из задач исполнителя,
+// таймеров и стека ZigBee, поэтому изменения выполняются под блокировкой)
+static uint32_t histograms[LATENCY_STAGE_MAX][LATENCY_HIST_BUCKETS];
+static portMUX_TYPE histograms_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief Получение номера корзины для задержки
+ */
+uint8_t latency_bucket_index(uint32_t delta_us)
+{
+    if (delta_us < 2) {
+        return 0;
+    }
+    
+    // Номер старшего установленного бита
+    uint8_t index = 31 - __builtin_clz(delta_us);
+    return index < LATENCY_HIST_BUCKETS ? index : LATENCY_HIST_BUCKETS - 1;
+}
+
+/**
+ * @brief Начало трассировки команды (этап приема)
+ */
+void latency_trace_begin(latency_trace_t *trace)
+{
+    trace->receive_time_us = esp_timer_get_time();
+}
+
+/**
+ * @brief Отметка этапа обработки команды
+ */
+void latency_trace_mark(const latency_trace_t *trace, latency_stage_t stage)
+{
+    if (stage >= LATENCY_STAGE_MAX || trace->receive_time_us == 0) {
+        return;
+    }
+    
+    int64_t delta = esp_timer_get_time() - trace->receive_time_us;
+    if (delta < 0) {
+        delta = 0;
+    } else if (delta > UINT32_MAX) {
+        delta = UINT32_MAX;
+    }
+    
+    uint8_t bucket = latency_bucket_index((uint32_t)delta);
+    
+    taskENTER_CRITICAL(&histograms_lock);
+    histograms[stage][bucket]++;
+    taskEXIT_CRITICAL(&histograms_lock);
+}
+
+/**
+ * @brief Выгрузка гистограмм в компактный двоичный формат
+ */
+esp_err_t latency_stats_export(uint8_t *buf, size_t buf_size, size_t *out_len)
+{
+    if (buf == NULL || out_len == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    if (buf_size < LATENCY_EXPORT_SIZE) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    
+    // Согласованная копия всех гистограмм
+    static uint32_t snapshot[LATENCY_STAGE_MAX][LATENCY_HIST_BUCKETS];
+    taskENTER_CRITICAL(&histograms_lock);
+    memcpy(snapshot, histograms, sizeof(snapshot));
+    taskEXIT_CRITICAL(&histograms_lock);
+    
+    size_t pos = 0;
+    buf[pos++] = LATENCY_EXPORT_VERSION;
+    buf[pos++] = LATENCY_HIST_BUCKETS;
+    
+    for (int stage = 0; stage < LATENCY_STAGE_MAX; stage++) {
+        for (int bucket = 0; bucket < LATENCY_HIST_BUCKETS; bucket++) {
+            uint32_t count = snapshot[stage][bucket];
+            uint16_t value = count > UINT16_MAX ? UINT16_MAX : (uint16_t)count;
+            buf[pos++] = value & 0xFF;
+            buf[pos++] = value >> 8;
+        }
+    }
+    
+    *out_len = pos;
+    return ESP_OK;
+}
+
+/**
+ * @brief Сброс всех гистограмм
+ */
+void latency_stats_reset(void)
+{
+    taskENTER_CRITICAL(&histograms_lock);
+    memset(histograms, 0, sizeof(histograms));
+    taskEXIT_CRITICAL(&histograms_lock);
+}
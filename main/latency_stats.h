@@ -0,0 +1,88 @@
+/**
+ * @file latency_stats.h
+ * @brief Гистограммы задержек обработки команд ZigBee
+ */
+
+#ifndef LATENCY_STATS_H
+#define LATENCY_STATS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+/**
+ * @brief Количество корзин гистограммы
+ * 
+ * Корзина i содержит задержки в диапазоне [2^i, 2^(i+1)) мкс,
+ * последняя корзина - все задержки от 2^23 мкс (около 8,4 с) и выше.
+ */
+#define LATENCY_HIST_BUCKETS 24
+
+/**
+ * @brief Версия формата выгрузки гистограмм
+ */
+#define LATENCY_EXPORT_VERSION 1
+
+/**
+ * @brief Этапы обработки команды (задержка отсчитывается от приема)
+ */
+typedef enum {
+    LATENCY_STAGE_DISPATCH = 0,     ///< Команда передана исполнителю
+    LATENCY_STAGE_MOTION_START,     ///< Начало движения сервопривода
+    LATENCY_STAGE_MOTION_END,       ///< Окончание движения сервопривода
+    LATENCY_STAGE_REPORT_QUEUED,    ///< Отчет поставлен в очередь
+    LATENCY_STAGE_REPORT_SENT,      ///< Отчет подтвержден получателями (APS)
+    LATENCY_STAGE_MAX
+} latency_stage_t;
+
+/**
+ * @brief Трасса одной команды
+ */
+typedef struct {
+    int64_t receive_time_us;        ///< Время приема команды (мкс)
+} latency_trace_t;
+
+/**
+ * @brief Начало трассировки команды (этап приема)
+ * 
+ * @param trace Трасса команды
+ */
+void latency_trace_begin(latency_trace_t *trace);
+
+/**
+ * @brief Отметка этапа обработки команды
+ * 
+ * Задержка от приема команды добавляется в гистограмму этапа.
+ * 
+ * @param trace Трасса команды
+ * @param stage Этап обработки
+ */
+void latency_trace_mark(const latency_trace_t *trace, latency_stage_t stage);
+
+/**
+ * @brief Получение номера корзины для задержки
+ * 
+ * @param delta_us Задержка в микросекундах
+ * @return uint8_t Номер корзины (0 - LATENCY_HIST_BUCKETS-1)
+ */
+uint8_t latency_bucket_index(uint32_t delta_us);
+
+/**
+ * @brief Выгрузка гистограмм в компактный двоичный формат
+ * 
+ * Формат: версия (1 байт), количество корзин (1 байт), затем для каждого
+ * этапа счетчики корзин в формате uint16 little-endian с насыщением.
+ * 
+ * @param buf Буфер для записи
+ * @param buf_size Размер буфера
+ * @param out_len Фактическая длина выгрузки
+ * @return esp_err_t ESP_OK при успешной выгрузке, ESP_ERR_INVALID_SIZE если буфер мал
+ */
+esp_err_t latency_stats_export(uint8_t *buf, size_t buf_size, size_t *out_len);
+
+/**
+ * @brief Сброс всех гистограмм
+ */
+void latency_stats_reset(void);
+
+#endif /* LATENCY_STATS_H */
@@ -10,9 +10,9 @@
 #include "esp_system.h"
 #include "esp_log.h"
 #include "esp_err.h"
+#include "esp_sleep.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "freertos/event_groups.h"
 #include "nvs_flash.h"
 
 // Подключение заголовочных файлов модулей
@@ -21,6 +21,11 @@
 #include "ota_update.h"
 #include "power_management.h"
 #include "state_management.h"
+#include "retained_state.h"
+#include "event_history.h"
+#include "event_bus.h"
+#include "device_config.h"
+#include "schedule.h"
 
 // Определение тегов для логов
 static const char* TAG = "WINDOW_MAIN";
@@ -30,36 +35,22 @@ static const char* TAG = "WINDOW_MAIN";
 #define GAP_SERVO_PIN    5    // Пин для сервопривода зазора
 
 // Определение задержек и периодов (в миллисекундах)
-#define ZIGBEE_REPORT_INTERVAL  10000  // Интервал отправки состояния в ZigBee
-#define STATE_SAVE_INTERVAL     60000  // Интервал сохранения состояния
 #define OTA_CHECK_INTERVAL     300000  // Интервал проверки обновлений (5 минут)
 
 // Определение приоритетов задач
 #define TASK_PRIORITY_ZIGBEE    5
-#define TASK_PRIORITY_OTA       3
 #define TASK_PRIORITY_POWER     4
 #define TASK_PRIORITY_MAIN      2
 
 // Размеры стека задач (в словах)
 #define STACK_SIZE_ZIGBEE       4096
-#define STACK_SIZE_OTA          4096
 #define STACK_SIZE_POWER        2048
 #define STACK_SIZE_MAIN         2048
 
-// Определение битов событий
-#define EVENT_WINDOW_MODE_CHANGED   (1 << 0)
-#define EVENT_GAP_CHANGED           (1 << 1)
-#define EVENT_RESISTANCE_DETECTED   (1 << 2)
-#define EVENT_CALIBRATION_REQUIRED  (1 << 3)
-
 // Дескрипторы задач
 TaskHandle_t xTaskZigBee = NULL;
-TaskHandle_t xTaskOTA = NULL;
 TaskHandle_t xTaskPower = NULL;
 
-// Группа событий
-EventGroupHandle_t xWindowEvents;
-
 // Прототипы функций
 static void init_nvs(void);
 static void start_services(void);
@@ -67,6 +58,11 @@ static void init_device(void);
 static void main_task(void *pvParameter);
 static void zigbee_task(void *pvParameter);
 static void handle_window_events(void);
+static void on_power_source_changed(power_source_t source);
+static void on_before_sleep(void);
+static void record_battery_transition(void);
+static void on_position_changed(const event_bus_event_t *event, void *ctx);
+static void on_resistance_detected(const event_bus_event_t *event, void *ctx);
 
 /**
  * @brief Точка входа в программу
@@ -78,9 +74,6 @@ void app_main(void)
     // Инициализация NVS (энергонезависимая память)
     init_nvs();
     
-    // Инициализация группы событий
-    xWindowEvents = xEventGroupCreate();
-    
     // Инициализация устройства и его компонентов
     init_device();
     
@@ -115,52 +108,104 @@ static void init_device(void)
 {
     ESP_LOGI(TAG, "Инициализация компонентов устройства");
     
+    // После пробуждения из глубокого сна состояние берется из RTC-памяти
+    retained_state_t retained;
+    bool warm_wake = retained_state_restore(&retained);
+    
+    // Настраиваемые параметры нужны модулям с первого обращения
+    ESP_ERROR_CHECK(device_config_init());
+    
     // Инициализация модуля управления состоянием
     ESP_ERROR_CHECK(state_init());
     
-    // Загрузка состояния из памяти
-    ESP_ERROR_CHECK(state_load());
+    // Журнал событий записывается вместе с состоянием
+    ESP_ERROR_CHECK(event_history_init());
     
-    // Инициализация модуля управления сервоприводами
-    ESP_ERROR_CHECK(servo_init(HANDLE_SERVO_PIN, GAP_SERVO_PIN));
+    // Уведомления хаба о событиях окна
+    ESP_ERROR_CHECK(event_bus_subscribe(EVENT_BUS_POSITION_CHANGED, on_position_changed, NULL));
+    ESP_ERROR_CHECK(event_bus_subscribe(EVENT_BUS_RESISTANCE_DETECTED, on_resistance_detected, NULL));
     
-    // Проверка необходимости калибровки
-    if (state_is_calibration_required()) {
-        ESP_LOGI(TAG, "Требуется калибровка сервоприводов");
-        ESP_ERROR_CHECK(servo_calibrate());
-        ESP_ERROR_CHECK(state_update_calibration(true));
+    // Пробуждение из глубокого сна перезагрузкой не считается
+    esp_reset_reason_t reset_reason = esp_reset_reason();
+    if (reset_reason != ESP_RST_DEEPSLEEP) {
+        event_history_record(EVENT_TYPE_REBOOT, EVENT_SOURCE_SYSTEM, (uint16_t)reset_reason);
+    }
+    
+    // Загрузка состояния из памяти (NVS читается только при холодном запуске)
+    if (warm_wake) {
+        ESP_ERROR_CHECK(state_restore(retained.window_mode, retained.gap_percentage, retained.calibrated));
+    } else {
+        ESP_ERROR_CHECK(state_load());
+    }
+    
+    // Сервоприводы запускаются в сохраненном положении: после сна - в точных
+    // углах из RTC-памяти, при холодном запуске - в углах сохраненного режима
+    servo_position_t position;
+    if (warm_wake) {
+        position = (servo_position_t) {
+            .mode = retained.window_mode,
+            .gap_percentage = retained.gap_percentage,
+            .handle_angle = retained.handle_angle,
+            .gap_angle = retained.gap_angle
+        };
+    } else {
+        device_state_t saved = state_get_current();
+        servo_position_from_state(saved.window_mode, saved.gap_percentage, &position);
     }
     
+    // Инициализация модуля управления сервоприводами
+    ESP_ERROR_CHECK(servo_init(HANDLE_SERVO_PIN, GAP_SERVO_PIN, &position));
+    
+    // Инициализация управления питанием (источник питания определяет роль в сети ZigBee)
+    power_config_t power_config = {
+        .source = POWER_SOURCE_BATTERY,
+        .low_battery_threshold = 3300,         // 3.3V
+        .critical_battery_threshold = 3000,    // 3.0V
+        .sleep_timeout_ms = 300000,            // 5 минут
+        .enable_auto_sleep = true,
+        .on_source_change = on_power_source_changed,
+        .on_before_sleep = on_before_sleep
+    };
+    ESP_ERROR_CHECK(power_init(&power_config));
+    
     // Инициализация ZigBee
     zigbee_config_t zigbee_config = {
         .device_name = "Smart Window",
         .manufacturer = "Custom",
         .model = "ESP32-H2-Window-1.0",
-        .pan_id = 0x1234,
-        .channel = 15,
-        .dev_type = ZIGBEE_DEVICE_TYPE_COVER // Тип "шторы" для Алисы
+        .pan_id = 0,                          // Автовыбор при первом подключении
+        .channel = 0,                         // Далее используются сохраненные параметры сети
+        .dev_type = ZIGBEE_DEVICE_TYPE_COVER, // Тип "шторы" для Алисы
+        .mains_powered = (power_get_source() == POWER_SOURCE_EXTERNAL),
+        .saved_network = (warm_wake && retained.network_valid) ? &retained.network : NULL
     };
     ESP_ERROR_CHECK(zigbee_init(&zigbee_config));
     
+    // Часы расписания продолжают ход после сна без запроса времени у хаба
+    if (warm_wake && retained.time_valid) {
+        schedule_resume_time(retained.sleep_local_time, retained.local_time);
+    }
+    
+    // Калибровка выполняется исполнителем команд в фоне, загрузка ее не ждет
+    if (state_is_calibration_required()) {
+        ESP_LOGI(TAG, "Требуется калибровка сервоприводов");
+        zigbee_request_calibration();
+    }
+    
     // Инициализация OTA
     ota_config_t ota_config = {
-        .server_url = "https://example.com/firmware",
         .firmware_version = "1.0.0",
+        .file_version = 0x01000000,           // 1.0.0 в формате версии файла OTA ZigBee
+        .image_type = 0x0001,
+        .block_size = 48,                     // Блок помещается в один кадр без фрагментации
+        .page_mode = true,                    // Страница запрашивается одной командой
+        .page_size = 512,
+        .response_spacing_ms = 20,
         .check_interval_ms = OTA_CHECK_INTERVAL,
         .auto_check = true,
         .auto_update = false
     };
     ESP_ERROR_CHECK(ota_init(&ota_config));
-    
-    // Инициализация управления питанием
-    power_config_t power_config = {
-        .source = POWER_SOURCE_BATTERY,
-        .low_battery_threshold = 3300,         // 3.3V
-        .critical_battery_threshold = 3000,    // 3.0V
-        .sleep_timeout_ms = 300000,            // 5 минут
-        .enable_auto_sleep = true
-    };
-    ESP_ERROR_CHECK(power_init(&power_config));
 }
 
 /**
@@ -176,13 +221,79 @@ static void start_services(void)
     
     // Запуск OTA
     ESP_ERROR_CHECK(ota_start());
-    xTaskCreate(ota_task_handler, "ota_task", STACK_SIZE_OTA, NULL, TASK_PRIORITY_OTA, &xTaskOTA);
     
     // Запуск управления питанием
     ESP_ERROR_CHECK(power_start());
     xTaskCreate(power_task_handler, "power_task", STACK_SIZE_POWER, NULL, TASK_PRIORITY_POWER, &xTaskPower);
 }
 
+/**
+ * @brief Колбэк смены источника питания
+ */
+static void on_power_source_changed(power_source_t source)
+{
+    zigbee_power_source_changed(source == POWER_SOURCE_EXTERNAL);
+}
+
+/**
+ * @brief Обработчик события смены положения окна
+ */
+static void on_position_changed(const event_bus_event_t *event, void *ctx)
+{
+    // О своих командах хаб знает из отчетов, уведомляем только о локальных изменениях
+    if (event->position.source != EVENT_SOURCE_ZIGBEE &&
+        zigbee_get_state() == ZIGBEE_STATE_CONNECTED) {
+        zigbee_send_alert(ZIGBEE_ALERT_MODE_CHANGE, (uint8_t)event->position.mode);
+    }
+}
+
+/**
+ * @brief Обработчик события механического сопротивления
+ */
+static void on_resistance_detected(const event_bus_event_t *event, void *ctx)
+{
+    ESP_LOGW(TAG, "Обнаружено механическое сопротивление, угол ручки: %d", event->resistance.handle_angle);
+    
+    // Отправка уведомления через ZigBee
+    if (zigbee_get_state() == ZIGBEE_STATE_CONNECTED) {
+        ESP_LOGI(TAG, "Отправка уведомления о механическом сопротивлении");
+        zigbee_send_alert(ZIGBEE_ALERT_RESISTANCE, 1);
+    }
+}
+
+/**
+ * @brief Колбэк перед глубоким сном
+ */
+static void on_before_sleep(void)
+{
+    // Ближайшая запись расписания будит устройство (заменяет таймер сна по
+    // бездействию); при критическом заряде окно не двигается
+    uint32_t due_in;
+    if (!power_is_critical_battery() && schedule_get_next_due_in(&due_in)) {
+        ESP_LOGI(TAG, "Пробуждение к записи расписания через %lu с", (unsigned long)due_in);
+        esp_sleep_enable_timer_wakeup((uint64_t)(due_in > 0 ? due_in : 1) * 1000000);
+    }
+    
+    // Копия в RTC-памяти должна совпадать с NVS, иначе после сна читается NVS
+    if (state_save() != ESP_OK) {
+        retained_state_invalidate();
+        return;
+    }
+    
+    device_state_t state = state_get_current();
+    retained_state_t retained = {
+        .window_mode = state.window_mode,
+        .gap_percentage = state.gap_percentage,
+        .calibrated = state.calibrated,
+        .handle_angle = servo_get_handle_angle(),
+        .gap_angle = servo_get_gap_angle()
+    };
+    retained.network_valid = zigbee_get_saved_network(&retained.network);
+    retained.time_valid = schedule_get_time(&retained.sleep_local_time);
+    
+    retained_state_store(&retained);
+}
+
 /**
  * @brief Задача ZigBee
  */
@@ -190,8 +301,8 @@ static void zigbee_task(void *pvParameter)
 {
     ESP_LOGI(TAG, "Запуск задачи ZigBee");
     
-    // Включение режима сопряжения при первом запуске
-    if (zigbee_get_state() == ZIGBEE_STATE_DISCONNECTED) {
+    // Включение режима сопряжения только если устройство еще не входило в сеть
+    if (!zigbee_has_saved_network()) {
         ESP_LOGI(TAG, "Включение режима сопряжения ZigBee");
         zigbee_enable_pairing_mode(300); // 5 минут
     }
@@ -203,39 +314,12 @@ static void zigbee_task(void *pvParameter)
         zigbee_process_incoming_commands();
         
         // Периодическая отправка состояния
-        if ((xTaskGetTickCount() - xLastReportTime) >= pdMS_TO_TICKS(ZIGBEE_REPORT_INTERVAL)) {
+        if ((xTaskGetTickCount() - xLastReportTime) >= pdMS_TO_TICKS(device_config_get(CONFIG_KEY_REPORT_INTERVAL_MS))) {
             ESP_LOGI(TAG, "Отправка состояния в ZigBee");
             zigbee_report_state();
             xLastReportTime = xTaskGetTickCount();
         }
         
-        // Обработка событий окна
-        EventBits_t uxBits = xEventGroupGetBits(xWindowEvents);
-        
-        // Если изменился режим окна или зазор
-        if (uxBits & (EVENT_WINDOW_MODE_CHANGED | EVENT_GAP_CHANGED)) {
-            window_mode_t mode = servo_get_window_mode();
-            uint8_t gap = servo_get_gap();
-            
-            // Отправляем новое состояние
-            zigbee_send_window_mode(mode);
-            zigbee_send_gap_position(gap);
-            
-            // Отправляем уведомление об изменении режима
-            zigbee_send_alert(ZIGBEE_ALERT_MODE_CHANGE, (uint8_t)mode);
-            
-            // Сбрасываем события
-            xEventGroupClearBits(xWindowEvents, EVENT_WINDOW_MODE_CHANGED | EVENT_GAP_CHANGED);
-        }
-        
-        // Обработка обнаружения сопротивления
-        if (uxBits & EVENT_RESISTANCE_DETECTED) {
-            ESP_LOGW(TAG, "Обнаружено механическое сопротивление");
-            
-            // Сбрасываем событие
-            xEventGroupClearBits(xWindowEvents, EVENT_RESISTANCE_DETECTED);
-        }
-        
         // Проверка состояния батареи
         if (power_is_low_battery()) {
             // Отправка уведомления о низком заряде
@@ -254,31 +338,16 @@ static void main_task(void *pvParameter)
 {
     ESP_LOGI(TAG, "Запуск основной задачи");
     
-    // Восстановление последнего состояния
-    device_state_t current_state = state_get_current();
-    
-    // Установка окна в последнее известное состояние
-    ESP_LOGI(TAG, "Восстановление последнего состояния: режим=%d, зазор=%d%%", 
-             current_state.window_mode, current_state.gap_percentage);
-    
-    servo_set_window_mode(current_state.window_mode);
-    servo_set_gap(current_state.gap_percentage);
-    
-    // Отключение сервоприводов после установки
-    servo_disable();
-    
-    TickType_t xLastSaveTime = xTaskGetTickCount();
+    // Восстановление последнего состояния и отключение сервоприводов выполняет
+    // исполнитель команд: так они не пересекаются с фоновой калибровкой
+    zigbee_request_position_restore();
     
     for (;;) {
         // Обработка событий окна
         handle_window_events();
         
-        // Периодическое сохранение состояния
-        if ((xTaskGetTickCount() - xLastSaveTime) >= pdMS_TO_TICKS(STATE_SAVE_INTERVAL)) {
-            ESP_LOGI(TAG, "Сохранение состояния");
-            state_save();
-            xLastSaveTime = xTaskGetTickCount();
-        }
+        // Переходы уровня батареи записываются в журнал событий
+        record_battery_transition();
         
         // Проверка состояния батареи
         if (power_is_low_battery()) {
@@ -304,23 +373,43 @@ static void handle_window_events(void)
 {
     // Проверка обнаружения сопротивления
     if (servo_check_resistance()) {
-        ESP_LOGW(TAG, "Обнаружено механическое сопротивление");
-        
         // Остановка сервоприводов
         servo_disable();
         
-        // Обновление состояния
-        state_update_resistance_detected(true);
-        
-        // Отправка уведомления через ZigBee
-        if (zigbee_get_state() == ZIGBEE_STATE_CONNECTED) {
-            ESP_LOGI(TAG, "Отправка уведомления о механическом сопротивлении");
-            zigbee_send_alert(ZIGBEE_ALERT_RESISTANCE, 1);
+        // Событие публикуется один раз при появлении сопротивления
+        if (!state_is_resistance_detected()) {
+            state_update_resistance_detected(true);
+            
+            event_bus_event_t event = {
+                .id = EVENT_BUS_RESISTANCE_DETECTED,
+                .resistance = {
+                    .handle_angle = servo_get_handle_angle()
+                }
+            };
+            event_bus_publish(&event);
         }
-        
-        // Установка события
-        xEventGroupSetBits(xWindowEvents, EVENT_RESISTANCE_DETECTED);
     } else {
         state_update_resistance_detected(false);
     }
-} 
\ No newline at end of file
+} 
+
+/**
+ * @brief Запись перехода уровня батареи в журнал событий
+ */
+static void record_battery_transition(void)
+{
+    static event_battery_level_t last_level = EVENT_BATTERY_NORMAL;
+    
+    event_battery_level_t level = EVENT_BATTERY_NORMAL;
+    if (power_is_critical_battery()) {
+        level = EVENT_BATTERY_CRITICAL;
+    } else if (power_is_low_battery()) {
+        level = EVENT_BATTERY_LOW;
+    }
+    
+    if (level != last_level) {
+        event_history_record(EVENT_TYPE_BATTERY, EVENT_SOURCE_SYSTEM,
+                             (uint16_t)level | ((uint16_t)power_get_battery_level() << 8));
+        last_level = level;
+    }
+}
\ No newline at end of file
@@ -1,17 +1,28 @@
 /**
  * @file ota_update.c
  * @brief Реализация модуля OTA-обновлений для умного окна
+ * 
+ * У ESP32-H2 нет Wi-Fi, поэтому прошивка загружается по ZigBee: модуль
+ * реализует клиент кластера OTA Upgrade (0x0019). Блоки образа пишутся
+ * напрямую в неактивный OTA-раздел через буфер размером в сектор флеш,
+ * после каждого записанного сектора прогресс сохраняется в NVS, и
+ * прерванная загрузка продолжается с этого места.
  */
 
 #include "ota_update.h"
+#include <string.h>
 #include "esp_log.h"
 #include "esp_system.h"
-#include "esp_http_client.h"
-#include "esp_https_ota.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
 #include "freertos/event_groups.h"
 #include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "nvs.h"
+#include "esp_zigbee_lib.h"
+#include "event_history.h"
 
 // Определение тега для логов
 static const char* TAG = "OTA_UPDATE";
@@ -23,6 +34,72 @@ static const char* TAG = "OTA_UPDATE";
 #define OTA_EVENT_CHECK_UPDATE     (1 << 0)
 #define OTA_EVENT_START_DOWNLOAD   (1 << 1)
 #define OTA_EVENT_APPLY_UPDATE     (1 << 2)
+#define OTA_EVENT_ALL              (OTA_EVENT_CHECK_UPDATE | OTA_EVENT_START_DOWNLOAD | OTA_EVENT_APPLY_UPDATE)
+
+// Команды кластера OTA Upgrade
+#define OTA_CMD_IMAGE_NOTIFY            0x00
+#define OTA_CMD_QUERY_NEXT_IMAGE_REQ    0x01
+#define OTA_CMD_QUERY_NEXT_IMAGE_RSP    0x02
+#define OTA_CMD_IMAGE_BLOCK_REQ         0x03
+#define OTA_CMD_IMAGE_PAGE_REQ          0x04
+#define OTA_CMD_IMAGE_BLOCK_RSP         0x05
+#define OTA_CMD_UPGRADE_END_REQ         0x06
+#define OTA_CMD_UPGRADE_END_RSP         0x07
+
+// Статусы ZCL, используемые кластером OTA Upgrade
+#define OTA_STATUS_SUCCESS              0x00
+#define OTA_STATUS_ABORT                0x95
+#define OTA_STATUS_INVALID_IMAGE        0x96
+#define OTA_STATUS_WAIT_FOR_DATA        0x97
+#define OTA_STATUS_NO_IMAGE_AVAILABLE   0x98
+
+// Формат файла OTA ZigBee
+#define OTA_FILE_MAGIC                  0x0BEEF11E
+#define OTA_FILE_FIXED_HEADER_SIZE      8       // Магическое число, версия и длина заголовка
+#define OTA_SUBELEMENT_HEADER_SIZE      6       // Тег и длина подэлемента
+#define OTA_TAG_UPGRADE_IMAGE           0x0000  // Подэлемент с образом приложения
+
+// Параметры обмена
+#define OTA_POLL_INTERVAL_MS            100     // Период опроса очереди и таймаутов
+#define OTA_RESPONSE_TIMEOUT_MS         5000    // Ожидание ответа сервера
+#define OTA_MAX_RETRIES                 10      // Повторов запроса подряд до ошибки
+#define OTA_DEFAULT_BLOCK_SIZE          48      // Размер блока по умолчанию
+#define OTA_DEFAULT_PAGE_SIZE           512     // Размер страницы по умолчанию
+#define OTA_MSG_QUEUE_DEPTH             8       // Глубина очереди команд сервера
+#define OTA_MSG_MAX_PAYLOAD             (14 + OTA_MAX_BLOCK_SIZE) // Image Block Response с данными
+
+// Размер сектора флеш: единица стирания и сохранения прогресса
+#define OTA_SECTOR_SIZE                 4096
+
+// Хранение прогресса загрузки в NVS
+#define OTA_NVS_NAMESPACE               "ota"
+#define OTA_NVS_KEY_PROGRESS            "progress"
+
+// Команда сервера, переданная из контекста стека
+typedef struct {
+    uint8_t cmd_id;                         // Идентификатор команды ZCL
+    uint8_t len;                            // Длина полезной нагрузки
+    uint8_t payload[OTA_MSG_MAX_PAYLOAD];   // Полезная нагрузка
+} ota_msg_t;
+
+// Файл OTA, предложенный сервером
+typedef struct {
+    uint16_t manuf_code;        // Код производителя
+    uint16_t image_type;        // Тип образа
+    uint32_t file_version;      // Версия файла
+    uint32_t image_size;        // Размер файла OTA (байт)
+} ota_image_t;
+
+// Прогресс загрузки (сохраняется в NVS после каждого записанного сектора)
+typedef struct {
+    ota_image_t image;          // Загружаемый файл
+    uint32_t partition_address; // Адрес раздела, в который пишется образ
+    uint32_t file_offset;       // Смещение в файле OTA
+    uint32_t header_length;     // Длина заголовка файла (0 - еще не разобран)
+    uint32_t element_remaining; // Остаток данных текущего подэлемента
+    uint16_t element_tag;       // Тег текущего подэлемента
+    uint32_t image_written;     // Записано в раздел байт образа приложения
+} ota_progress_t;
 
 // Структура данных состояния OTA
 typedef struct {
@@ -33,6 +110,22 @@ typedef struct {
     char new_version[OTA_VERSION_BUFFER_SIZE];      // Новая версия прошивки
     TaskHandle_t task_handle;          // Хендл задачи OTA
     EventGroupHandle_t event_group;    // Группа событий OTA
+    QueueHandle_t msg_queue;           // Очередь команд сервера OTA
+    const esp_partition_t *partition;  // Раздел, в который пишется образ
+    ota_progress_t progress;           // Прогресс загрузки
+    bool image_available;              // Сервер предложил образ (progress.image)
+    bool download_requested;           // Загрузка запрошена до ответа сервера
+    bool waiting_for_data;             // Сервер попросил повторить запрос позже
+    uint32_t page_end;                 // Конец запрошенной страницы в файле
+    int64_t deadline_ms;               // Срок ожидания ответа сервера
+    int64_t apply_at_ms;               // Время перезагрузки в новую прошивку (0 - не задано)
+    uint8_t retries;                   // Повторов запроса подряд
+    uint8_t header_fill;               // Заполнение буфера заголовка
+    uint8_t header_buf[OTA_FILE_FIXED_HEADER_SIZE];  // Заголовок файла или подэлемента
+    uint16_t sector_fill;              // Заполнение буфера сектора
+    int64_t transfer_start_ms;         // Начало загрузки
+    uint32_t transfer_requests;        // Отправлено запросов блоков и страниц
+    uint32_t transfer_timeouts;        // Истекло ожиданий ответа
 } ota_state_data_t;
 
 // Текущее состояние OTA
@@ -40,13 +133,654 @@ static ota_state_data_t ota_data = {
     .state = OTA_STATE_IDLE,
     .download_progress = 0,
     .task_handle = NULL,
+    .msg_queue = NULL,
+    .partition = NULL,
 };
 
+// Буфер сектора: образ пишется во флеш целыми стертыми секторами
+static uint8_t sector_buf[OTA_SECTOR_SIZE];
+
 // Прототипы вспомогательных функций
-static esp_err_t http_event_handler(esp_http_client_event_t *evt);
-static esp_err_t validate_image_header(esp_app_desc_t *new_app_info);
 static esp_err_t ota_check_for_update(void);
-static esp_err_t ota_download_and_apply_update(void);
+static esp_err_t ota_start_download(void);
+static void ota_request_next(void);
+static void ota_handle_message(const ota_msg_t *msg);
+static void ota_check_deadlines(void);
+
+/**
+ * @brief Текущее время в миллисекундах
+ */
+static int64_t ota_now_ms(void)
+{
+    return esp_timer_get_time() / 1000;
+}
+
+/**
+ * @brief Чтение 16-битного значения (little-endian)
+ */
+static uint16_t ota_get_le16(const uint8_t *data)
+{
+    return data[0] | (data[1] << 8);
+}
+
+/**
+ * @brief Чтение 32-битного значения (little-endian)
+ */
+static uint32_t ota_get_le32(const uint8_t *data)
+{
+    return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+/**
+ * @brief Запись 16-битного значения (little-endian)
+ */
+static uint8_t *ota_put_le16(uint8_t *data, uint16_t value)
+{
+    data[0] = value & 0xFF;
+    data[1] = (value >> 8) & 0xFF;
+    return data + 2;
+}
+
+/**
+ * @brief Запись 32-битного значения (little-endian)
+ */
+static uint8_t *ota_put_le32(uint8_t *data, uint32_t value)
+{
+    data[0] = value & 0xFF;
+    data[1] = (value >> 8) & 0xFF;
+    data[2] = (value >> 16) & 0xFF;
+    data[3] = (value >> 24) & 0xFF;
+    return data + 4;
+}
+
+/**
+ * @brief Запись идентификатора файла (код производителя, тип, версия)
+ */
+static uint8_t *ota_put_image_id(uint8_t *data, const ota_image_t *image)
+{
+    data = ota_put_le16(data, image->manuf_code);
+    data = ota_put_le16(data, image->image_type);
+    return ota_put_le32(data, image->file_version);
+}
+
+/**
+ * @brief Проверка, что команда относится к загружаемому файлу
+ */
+static bool ota_image_id_matches(const uint8_t *data)
+{
+    return ota_get_le16(&data[0]) == ota_data.progress.image.manuf_code &&
+           ota_get_le16(&data[2]) == ota_data.progress.image.image_type &&
+           ota_get_le32(&data[4]) == ota_data.progress.image.file_version;
+}
+
+/**
+ * @brief Сохранение прогресса загрузки в NVS
+ */
+static esp_err_t ota_save_progress(void)
+{
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(OTA_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Ошибка открытия NVS: %s", esp_err_to_name(err));
+        return err;
+    }
+    
+    err = nvs_set_blob(handle, OTA_NVS_KEY_PROGRESS, &ota_data.progress, sizeof(ota_progress_t));
+    if (err == ESP_OK) {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Ошибка сохранения прогресса загрузки: %s", esp_err_to_name(err));
+    }
+    
+    return err;
+}
+
+/**
+ * @brief Загрузка сохраненного прогресса из NVS
+ */
+static bool ota_load_progress(void)
+{
+    nvs_handle_t handle;
+    if (nvs_open(OTA_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        return false;
+    }
+    
+    size_t size = sizeof(ota_progress_t);
+    esp_err_t err = nvs_get_blob(handle, OTA_NVS_KEY_PROGRESS, &ota_data.progress, &size);
+    nvs_close(handle);
+    
+    if (err != ESP_OK || size != sizeof(ota_progress_t)) {
+        memset(&ota_data.progress, 0, sizeof(ota_progress_t));
+        return false;
+    }
+    
+    return true;
+}
+
+/**
+ * @brief Удаление сохраненного прогресса (загрузка завершена или отменена)
+ */
+static void ota_clear_progress(void)
+{
+    memset(&ota_data.progress, 0, sizeof(ota_progress_t));
+    
+    nvs_handle_t handle;
+    if (nvs_open(OTA_NVS_NAMESPACE, NVS_READWRITE, &handle) == ESP_OK) {
+        nvs_erase_key(handle, OTA_NVS_KEY_PROGRESS);
+        nvs_commit(handle);
+        nvs_close(handle);
+    }
+}
+
+/**
+ * @brief Запись буфера сектора в раздел и сохранение прогресса
+ */
+static esp_err_t ota_flush_sector(void)
+{
+    if (ota_data.sector_fill == 0) {
+        return ESP_OK;
+    }
+    
+    // Образ пишется только целыми секторами, поэтому смещение выровнено
+    esp_err_t err = esp_partition_erase_range(ota_data.partition, ota_data.progress.image_written, OTA_SECTOR_SIZE);
+    if (err == ESP_OK) {
+        err = esp_partition_write(ota_data.partition, ota_data.progress.image_written,
+                                  sector_buf, ota_data.sector_fill);
+    }
+    
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Ошибка записи во флеш по смещению 0x%lx: %s",
+                 (unsigned long)ota_data.progress.image_written, esp_err_to_name(err));
+        return err;
+    }
+    
+    ota_data.progress.image_written += ota_data.sector_fill;
+    ota_data.sector_fill = 0;
+    
+    // Повтор после перезагрузки начнется с первого байта следующего сектора
+    ota_save_progress();
+    
+    return ESP_OK;
+}
+
+/**
+ * @brief Разбор очередного фрагмента файла OTA, начиная с progress.file_offset
+ */
+static esp_err_t ota_parse_chunk(const uint8_t *data, uint32_t len)
+{
+    ota_progress_t *progress = &ota_data.progress;
+    
+    while (len > 0) {
+        uint32_t take;
+        
+        if (progress->header_length == 0) {
+            // Фиксированная часть заголовка файла
+            take = OTA_FILE_FIXED_HEADER_SIZE - ota_data.header_fill;
+            take = take < len ? take : len;
+            memcpy(&ota_data.header_buf[ota_data.header_fill], data, take);
+            ota_data.header_fill += take;
+            
+            if (ota_data.header_fill == OTA_FILE_FIXED_HEADER_SIZE) {
+                ota_data.header_fill = 0;
+                
+                if (ota_get_le32(&ota_data.header_buf[0]) != OTA_FILE_MAGIC) {
+                    ESP_LOGE(TAG, "Неверное магическое число файла OTA");
+                    return ESP_ERR_INVALID_VERSION;
+                }
+                
+                progress->header_length = ota_get_le16(&ota_data.header_buf[6]);
+                if (progress->header_length < OTA_FILE_FIXED_HEADER_SIZE) {
+                    ESP_LOGE(TAG, "Неверная длина заголовка файла OTA: %lu",
+                             (unsigned long)progress->header_length);
+                    return ESP_ERR_INVALID_SIZE;
+                }
+            }
+        } else if (progress->file_offset < progress->header_length) {
+            // Остаток заголовка файла не нужен
+            take = progress->header_length - progress->file_offset;
+            take = take < len ? take : len;
+        } else if (progress->element_remaining == 0) {
+            // Заголовок подэлемента
+            take = OTA_SUBELEMENT_HEADER_SIZE - ota_data.header_fill;
+            take = take < len ? take : len;
+            memcpy(&ota_data.header_buf[ota_data.header_fill], data, take);
+            ota_data.header_fill += take;
+            
+            if (ota_data.header_fill == OTA_SUBELEMENT_HEADER_SIZE) {
+                ota_data.header_fill = 0;
+                progress->element_tag = ota_get_le16(&ota_data.header_buf[0]);
+                progress->element_remaining = ota_get_le32(&ota_data.header_buf[2]);
+                
+                if (progress->element_tag == OTA_TAG_UPGRADE_IMAGE &&
+                    (progress->image_written != 0 || progress->element_remaining > ota_data.partition->size)) {
+                    ESP_LOGE(TAG, "Образ приложения не помещается в раздел или повторяется");
+                    return ESP_ERR_INVALID_SIZE;
+                }
+            }
+        } else {
+            // Данные подэлемента: образ приложения пишется во флеш, остальное пропускается
+            take = progress->element_remaining < len ? progress->element_remaining : len;
+            
+            if (progress->element_tag == OTA_TAG_UPGRADE_IMAGE) {
+                uint32_t space = OTA_SECTOR_SIZE - ota_data.sector_fill;
+                take = take < space ? take : space;
+                memcpy(&sector_buf[ota_data.sector_fill], data, take);
+                ota_data.sector_fill += take;
+            }
+            progress->element_remaining -= take;
+        }
+        
+        data += take;
+        len -= take;
+        progress->file_offset += take;
+        
+        // Сектор заполнен: прогресс сохраняется ровно на границе сектора
+        if (ota_data.sector_fill == OTA_SECTOR_SIZE) {
+            esp_err_t err = ota_flush_sector();
+            if (err != ESP_OK) {
+                return err;
+            }
+        }
+    }
+    
+    return ESP_OK;
+}
+
+/**
+ * @brief Отправка команды серверу OTA
+ */
+static esp_err_t ota_send(uint8_t cmd_id, const uint8_t *payload, uint16_t len)
+{
+    esp_err_t err = esp_zigbee_send_ota_command(cmd_id, payload, len);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Не удалось отправить команду OTA 0x%02X: %s", cmd_id, esp_err_to_name(err));
+    }
+    
+    ota_data.deadline_ms = ota_now_ms() + OTA_RESPONSE_TIMEOUT_MS;
+    return err;
+}
+
+/**
+ * @brief Отправка Upgrade End Request с итоговым статусом
+ */
+static void ota_send_upgrade_end(uint8_t status)
+{
+    // Итог загрузки попадает в журнал событий
+    event_history_record(EVENT_TYPE_OTA_RESULT, EVENT_SOURCE_SYSTEM, status);
+    
+    uint8_t payload[9];
+    payload[0] = status;
+    ota_put_image_id(&payload[1], &ota_data.progress.image);
+    ota_send(OTA_CMD_UPGRADE_END_REQ, payload, sizeof(payload));
+}
+
+/**
+ * @brief Прерывание загрузки с уведомлением сервера
+ */
+static void ota_abort_download(uint8_t status)
+{
+    ESP_LOGE(TAG, "Загрузка обновления прервана, статус: 0x%02X", status);
+    
+    ota_send_upgrade_end(status);
+    ota_clear_progress();
+    ota_data.image_available = false;
+    ota_data.sector_fill = 0;
+    ota_data.header_fill = 0;
+    ota_data.download_progress = 0;
+    ota_data.state = OTA_STATE_ERROR;
+}
+
+/**
+ * @brief Завершение загрузки: проверка образа и выбор раздела загрузки
+ */
+static void ota_finish_download(void)
+{
+    if (ota_flush_sector() != ESP_OK) {
+        ota_abort_download(OTA_STATUS_ABORT);
+        return;
+    }
+    
+    if (ota_data.progress.image_written == 0 || ota_data.progress.element_remaining != 0) {
+        ESP_LOGE(TAG, "Файл OTA не содержит полного образа приложения");
+        ota_abort_download(OTA_STATUS_INVALID_IMAGE);
+        return;
+    }
+    
+    // Проверка образа выполняется при выборе раздела загрузки
+    esp_err_t err = esp_ota_set_boot_partition(ota_data.partition);
+    if (err != ESP_OK) {
+        if (err == ESP_ERR_OTA_VALIDATE_FAILED) {
+            ESP_LOGE(TAG, "Ошибка валидации образа после загрузки");
+        }
+        ESP_LOGE(TAG, "Ошибка завершения OTA: %s", esp_err_to_name(err));
+        ota_abort_download(OTA_STATUS_INVALID_IMAGE);
+        return;
+    }
+    
+    esp_app_desc_t app_desc;
+    if (esp_ota_get_partition_description(ota_data.partition, &app_desc) == ESP_OK) {
+        strncpy(ota_data.new_version, app_desc.version, OTA_VERSION_BUFFER_SIZE - 1);
+        ota_data.new_version[OTA_VERSION_BUFFER_SIZE - 1] = '\0';
+    }
+    
+    // Статистика загрузки для подбора размера блока и страницы
+    int64_t duration_ms = ota_now_ms() - ota_data.transfer_start_ms;
+    ESP_LOGI(TAG, "Обновление загружено за %lld мс: %lu байт, запросов: %lu, таймаутов: %lu, блок: %d, страницы: %s",
+             (long long)duration_ms, (unsigned long)ota_data.progress.image.image_size,
+             (unsigned long)ota_data.transfer_requests, (unsigned long)ota_data.transfer_timeouts,
+             ota_data.config.block_size, ota_data.config.page_mode ? "да" : "нет");
+    
+    ota_send_upgrade_end(OTA_STATUS_SUCCESS);
+    ota_clear_progress();
+    ota_data.image_available = false;
+    ota_data.download_progress = 100;
+    ota_data.state = OTA_STATE_READY_TO_APPLY;
+    
+    ESP_LOGI(TAG, "Обновление успешно загружено. Новая версия: %s", ota_data.new_version);
+}
+
+/**
+ * @brief Запрос следующего блока или страницы с текущего смещения
+ */
+static void ota_request_next(void)
+{
+    const ota_progress_t *progress = &ota_data.progress;
+    uint8_t payload[18];
+    uint8_t *p = payload;
+    
+    *p++ = 0x00;  // Поле управления: без адреса узла и минимального периода
+    p = ota_put_image_id(p, &progress->image);
+    p = ota_put_le32(p, progress->file_offset);
+    *p++ = ota_data.config.block_size;
+    
+    ota_data.waiting_for_data = false;
+    ota_data.transfer_requests++;
+    
+    if (!ota_data.config.page_mode) {
+        ota_send(OTA_CMD_IMAGE_BLOCK_REQ, payload, p - payload);
+        return;
+    }
+    
+    uint32_t remaining = progress->image.image_size - progress->file_offset;
+    uint16_t page_size = remaining < ota_data.config.page_size ? remaining : ota_data.config.page_size;
+    ota_data.page_end = progress->file_offset + page_size;
+    
+    p = ota_put_le16(p, page_size);
+    p = ota_put_le16(p, ota_data.config.response_spacing_ms);
+    ota_send(OTA_CMD_IMAGE_PAGE_REQ, payload, p - payload);
+}
+
+/**
+ * @brief Начало или продолжение загрузки предложенного сервером файла
+ */
+static esp_err_t ota_start_download(void)
+{
+    ota_data.download_requested = false;
+    
+    if (!ota_data.image_available) {
+        // Сначала нужно узнать, какой файл предлагает сервер
+        ota_data.download_requested = true;
+        return ota_check_for_update();
+    }
+    
+    ota_data.partition = esp_ota_get_next_update_partition(NULL);
+    if (ota_data.partition == NULL) {
+        ESP_LOGE(TAG, "Не найден раздел для обновления");
+        ota_data.state = OTA_STATE_ERROR;
+        return ESP_ERR_NOT_FOUND;
+    }
+    
+    // Продолжать можно только запись в тот же раздел
+    if (ota_data.progress.partition_address != ota_data.partition->address) {
+        ota_image_t image = ota_data.progress.image;
+        memset(&ota_data.progress, 0, sizeof(ota_progress_t));
+        ota_data.progress.image = image;
+        ota_data.progress.partition_address = ota_data.partition->address;
+    }
+    
+    if (ota_data.progress.file_offset > 0) {
+        ESP_LOGI(TAG, "Продолжение загрузки с %lu из %lu байт",
+                 (unsigned long)ota_data.progress.file_offset, (unsigned long)ota_data.progress.image.image_size);
+    } else {
+        ESP_LOGI(TAG, "Загрузка обновления: %lu байт", (unsigned long)ota_data.progress.image.image_size);
+    }
+    
+    ota_data.state = OTA_STATE_DOWNLOADING;
+    ota_data.download_progress = (uint8_t)((uint64_t)ota_data.progress.file_offset * 100 /
+                                           ota_data.progress.image.image_size);
+    ota_data.sector_fill = 0;
+    ota_data.header_fill = 0;
+    ota_data.retries = 0;
+    ota_data.transfer_start_ms = ota_now_ms();
+    ota_data.transfer_requests = 0;
+    ota_data.transfer_timeouts = 0;
+    
+    ota_request_next();
+    
+    return ESP_OK;
+}
+
+/**
+ * @brief Обработка Query Next Image Response
+ */
+static void ota_handle_query_response(const uint8_t *payload, uint8_t len)
+{
+    if (ota_data.state != OTA_STATE_CHECKING || len < 1) {
+        return;
+    }
+    
+    if (payload[0] != OTA_STATUS_SUCCESS || len < 13) {
+        ESP_LOGI(TAG, "Обновлений не найдено (статус 0x%02X)", payload[0]);
+        ota_data.download_requested = false;
+        ota_data.state = OTA_STATE_IDLE;
+        return;
+    }
+    
+    ota_image_t image = {
+        .manuf_code = ota_get_le16(&payload[1]),
+        .image_type = ota_get_le16(&payload[3]),
+        .file_version = ota_get_le32(&payload[5]),
+        .image_size = ota_get_le32(&payload[9])
+    };
+    
+    if (image.manuf_code != ESP_ZIGBEE_MANUFACTURER_CODE || image.image_type != ota_data.config.image_type ||
+        image.image_size <= OTA_FILE_FIXED_HEADER_SIZE) {
+        ESP_LOGW(TAG, "Сервер предложил чужой образ: производитель 0x%04X, тип 0x%04X",
+                 image.manuf_code, image.image_type);
+        ota_data.state = OTA_STATE_IDLE;
+        return;
+    }
+    
+    ESP_LOGI(TAG, "Доступно обновление: версия файла 0x%08lX, размер %lu байт",
+             (unsigned long)image.file_version, (unsigned long)image.image_size);
+    
+    // Сохраненный прогресс относится к другому файлу - загрузка начинается заново
+    if (memcmp(&image, &ota_data.progress.image, sizeof(ota_image_t)) != 0) {
+        memset(&ota_data.progress, 0, sizeof(ota_progress_t));
+        ota_data.progress.image = image;
+    }
+    
+    ota_data.image_available = true;
+    ota_data.state = OTA_STATE_IDLE;
+    
+    if (ota_data.download_requested || ota_data.config.auto_update) {
+        ota_start_download();
+    }
+}
+
+/**
+ * @brief Обработка Image Block Response
+ */
+static void ota_handle_block_response(const uint8_t *payload, uint8_t len)
+{
+    if (ota_data.state != OTA_STATE_DOWNLOADING || len < 1) {
+        return;
+    }
+    
+    switch (payload[0]) {
+        case OTA_STATUS_SUCCESS:
+            break;
+        
+        case OTA_STATUS_WAIT_FOR_DATA:
+            if (len >= 9) {
+                // Сервер назначил время следующего запроса
+                uint32_t current_time = ota_get_le32(&payload[1]);
+                uint32_t request_time = ota_get_le32(&payload[5]);
+                uint32_t delay_s = request_time > current_time ? request_time - current_time : 1;
+                ota_data.waiting_for_data = true;
+                ota_data.deadline_ms = ota_now_ms() + (int64_t)delay_s * 1000;
+            }
+            return;
+        
+        case OTA_STATUS_ABORT:
+            ota_abort_download(OTA_STATUS_ABORT);
+            return;
+        
+        default:
+            ESP_LOGW(TAG, "Неожиданный статус блока: 0x%02X", payload[0]);
+            return;
+    }
+    
+    if (len < 14 || !ota_image_id_matches(&payload[1])) {
+        return;
+    }
+    
+    uint32_t offset = ota_get_le32(&payload[9]);
+    uint8_t data_size = payload[13];
+    
+    // Повтор или блок после потерянного: ждем повторного запроса с нужного смещения
+    if (offset != ota_data.progress.file_offset || data_size == 0 || data_size > len - 14 ||
+        offset + data_size > ota_data.progress.image.image_size) {
+        return;
+    }
+    
+    esp_err_t err = ota_parse_chunk(&payload[14], data_size);
+    if (err != ESP_OK) {
+        ota_abort_download(err == ESP_ERR_INVALID_VERSION || err == ESP_ERR_INVALID_SIZE ?
+                           OTA_STATUS_INVALID_IMAGE : OTA_STATUS_ABORT);
+        return;
+    }
+    
+    ota_data.retries = 0;
+    ota_data.download_progress = (uint8_t)((uint64_t)ota_data.progress.file_offset * 100 /
+                                           ota_data.progress.image.image_size);
+    
+    if (ota_data.progress.file_offset >= ota_data.progress.image.image_size) {
+        ota_finish_download();
+    } else if (!ota_data.config.page_mode || ota_data.progress.file_offset >= ota_data.page_end) {
+        ota_request_next();
+    } else {
+        // Страница еще передается
+        ota_data.deadline_ms = ota_now_ms() + OTA_RESPONSE_TIMEOUT_MS;
+    }
+}
+
+/**
+ * @brief Обработка Upgrade End Response
+ */
+static void ota_handle_end_response(const uint8_t *payload, uint8_t len)
+{
+    if (ota_data.state != OTA_STATE_READY_TO_APPLY || len < 16 || !ota_data.config.auto_update) {
+        return;
+    }
+    
+    uint32_t current_time = ota_get_le32(&payload[8]);
+    uint32_t upgrade_time = ota_get_le32(&payload[12]);
+    
+    // 0xFFFFFFFF - сервер разрешит обновление отдельной командой
+    if (upgrade_time == 0xFFFFFFFF) {
+        return;
+    }
+    
+    uint32_t delay_s = upgrade_time > current_time ? upgrade_time - current_time : 0;
+    ota_data.apply_at_ms = ota_now_ms() + (int64_t)delay_s * 1000;
+    ESP_LOGI(TAG, "Применение обновления через %lu с", (unsigned long)delay_s);
+}
+
+/**
+ * @brief Обработка команды сервера OTA в задаче OTA
+ */
+static void ota_handle_message(const ota_msg_t *msg)
+{
+    switch (msg->cmd_id) {
+        case OTA_CMD_IMAGE_NOTIFY:
+            // Сервер сообщил о новом образе - проверяем, подходит ли он
+            if (ota_data.state == OTA_STATE_IDLE || ota_data.state == OTA_STATE_ERROR) {
+                ota_check_for_update();
+            }
+            break;
+        
+        case OTA_CMD_QUERY_NEXT_IMAGE_RSP:
+            ota_handle_query_response(msg->payload, msg->len);
+            break;
+        
+        case OTA_CMD_IMAGE_BLOCK_RSP:
+            ota_handle_block_response(msg->payload, msg->len);
+            break;
+        
+        case OTA_CMD_UPGRADE_END_RSP:
+            ota_handle_end_response(msg->payload, msg->len);
+            break;
+        
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief Проверка сроков ожидания ответов сервера
+ */
+static void ota_check_deadlines(void)
+{
+    int64_t now = ota_now_ms();
+    
+    if (ota_data.apply_at_ms != 0 && now >= ota_data.apply_at_ms) {
+        ota_data.apply_at_ms = 0;
+        xEventGroupSetBits(ota_data.event_group, OTA_EVENT_APPLY_UPDATE);
+    }
+    
+    if (now < ota_data.deadline_ms) {
+        return;
+    }
+    
+    if (ota_data.state == OTA_STATE_CHECKING) {
+        ESP_LOGW(TAG, "Сервер обновлений не ответил");
+        ota_data.download_requested = false;
+        ota_data.state = OTA_STATE_ERROR;
+        return;
+    }
+    
+    if (ota_data.state != OTA_STATE_DOWNLOADING) {
+        return;
+    }
+    
+    if (ota_data.waiting_for_data) {
+        ota_request_next();
+        return;
+    }
+    
+    // Потерян запрос или ответ: повтор с первого недостающего байта
+    ota_data.transfer_timeouts++;
+    if (++ota_data.retries > OTA_MAX_RETRIES) {
+        // Прогресс сохранен - загрузка продолжится при следующей проверке
+        ESP_LOGE(TAG, "Сервер обновлений не отвечает, загрузка приостановлена на %lu байт",
+                 (unsigned long)ota_data.progress.file_offset);
+        
+        // Незаписанный буфер сектора теряется: возврат к последнему сохраненному сектору
+        ota_data.sector_fill = 0;
+        ota_data.header_fill = 0;
+        ota_load_progress();
+        ota_data.image_available = false;
+        ota_data.state = OTA_STATE_ERROR;
+        return;
+    }
+    
+    // Незаписанный буфер сектора будет получен заново после сохраненного смещения
+    ota_request_next();
+}
 
 /**
  * @brief Инициализация модуля OTA
@@ -63,6 +797,14 @@ esp_err_t ota_init(ota_config_t *config)
     // Копирование конфигурации
     memcpy(&ota_data.config, config, sizeof(ota_config_t));
     
+    // Ограничение параметров обмена
+    if (ota_data.config.block_size == 0 || ota_data.config.block_size > OTA_MAX_BLOCK_SIZE) {
+        ota_data.config.block_size = OTA_DEFAULT_BLOCK_SIZE;
+    }
+    if (ota_data.config.page_size < ota_data.config.block_size) {
+        ota_data.config.page_size = OTA_DEFAULT_PAGE_SIZE;
+    }
+    
     // Получение текущей версии прошивки
     const esp_app_desc_t *app_desc = esp_app_get_description();
     if (app_desc != NULL) {
@@ -84,6 +826,19 @@ esp_err_t ota_init(ota_config_t *config)
         return ESP_ERR_NO_MEM;
     }
     
+    // Очередь команд сервера из контекста стека ZigBee
+    ota_data.msg_queue = xQueueCreate(OTA_MSG_QUEUE_DEPTH, sizeof(ota_msg_t));
+    if (ota_data.msg_queue == NULL) {
+        ESP_LOGE(TAG, "Ошибка создания очереди команд OTA");
+        return ESP_ERR_NO_MEM;
+    }
+    
+    // Прерванная загрузка продолжится, если сервер предложит тот же файл
+    if (ota_load_progress()) {
+        ESP_LOGI(TAG, "Найдена прерванная загрузка: %lu из %lu байт",
+                 (unsigned long)ota_data.progress.file_offset, (unsigned long)ota_data.progress.image.image_size);
+    }
+    
     // Установка начального состояния
     ota_data.state = OTA_STATE_IDLE;
     ota_data.download_progress = 0;
@@ -134,9 +889,10 @@ esp_err_t ota_stop(void)
         ota_data.task_handle = NULL;
     }
     
-    // Сброс состояния
+    // Сброс состояния (сохраненный прогресс загрузки остается в NVS)
     ota_data.state = OTA_STATE_IDLE;
     ota_data.download_progress = 0;
+    ota_data.image_available = false;
     
     ESP_LOGI(TAG, "Модуль OTA остановлен");
     
@@ -151,7 +907,7 @@ esp_err_t ota_check_update(void)
     ESP_LOGI(TAG, "Запрос на проверку обновлений");
     
     // Проверка состояния
-    if (ota_data.state != OTA_STATE_IDLE) {
+    if (ota_data.state != OTA_STATE_IDLE && ota_data.state != OTA_STATE_ERROR) {
         ESP_LOGW(TAG, "OTA уже активен, состояние: %d", ota_data.state);
         return ESP_ERR_INVALID_STATE;
     }
@@ -170,7 +926,7 @@ esp_err_t ota_download_update(void)
     ESP_LOGI(TAG, "Запрос на загрузку обновления");
     
     // Проверка состояния
-    if (ota_data.state != OTA_STATE_IDLE && ota_data.state != OTA_STATE_CHECKING) {
+    if (ota_data.state != OTA_STATE_IDLE && ota_data.state != OTA_STATE_ERROR) {
         ESP_LOGW(TAG, "OTA уже активен, состояние: %d", ota_data.state);
         return ESP_ERR_INVALID_STATE;
     }
@@ -232,62 +988,28 @@ esp_err_t ota_get_firmware_version(char *version, size_t version_len)
 }
 
 /**
- * @brief Обработчик событий HTTP-клиента
- */
-static esp_err_t http_event_handler(esp_http_client_event_t *evt)
-{
-    switch (evt->event_id) {
-        case HTTP_EVENT_ON_CONNECTED:
-            ESP_LOGI(TAG, "HTTP клиент подключен");
-            break;
-        case HTTP_EVENT_ON_DATA:
-            {
-                // Подсчет прогресса загрузки
-                esp_http_client_fetch_headers(evt->client);
-                int content_length = esp_http_client_get_content_length(evt->client);
-                if (content_length > 0) {
-                    static int total_received = 0;
-                    total_received += evt->data_len;
-                    ota_data.download_progress = (uint8_t)((total_received * 100) / content_length);
-                }
-            }
-            break;
-        case HTTP_EVENT_DISCONNECTED:
-            ESP_LOGI(TAG, "HTTP клиент отключен");
-            break;
-        default:
-            break;
-    }
-    return ESP_OK;
-}
-
-/**
- * @brief Проверка заголовка образа
+ * @brief Обработка команды сервера OTA Upgrade (контекст стека ZigBee)
  */
-static esp_err_t validate_image_header(esp_app_desc_t *new_app_info)
+void ota_handle_zigbee_command(uint8_t cmd_id, const uint8_t *payload, uint16_t len)
 {
-    if (new_app_info == NULL) {
-        return ESP_ERR_INVALID_ARG;
+    if (ota_data.msg_queue == NULL) {
+        return;
     }
     
-    ESP_LOGI(TAG, "Проверка заголовка образа: '%s'", new_app_info->version);
-    
-    const esp_partition_t *running = esp_ota_get_running_partition();
-    esp_app_desc_t running_app_info;
+    ota_msg_t msg = {
+        .cmd_id = cmd_id,
+        .len = len < OTA_MSG_MAX_PAYLOAD ? len : OTA_MSG_MAX_PAYLOAD
+    };
+    memcpy(msg.payload, payload, msg.len);
     
-    if (esp_ota_get_partition_description(running, &running_app_info) == ESP_OK) {
-        ESP_LOGI(TAG, "Текущая версия: %s, новая версия: %s", 
-                 running_app_info.version, new_app_info->version);
-        
-        // Здесь можно реализовать проверку версии
-        // Для демонстрации считаем, что новая версия всегда принимается
+    // При переполнении блок теряется и будет запрошен повторно
+    if (xQueueSend(ota_data.msg_queue, &msg, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "Очередь команд OTA переполнена");
     }
-    
-    return ESP_OK;
 }
 
 /**
- * @brief Проверка наличия обновления
+ * @brief Проверка наличия обновления (Query Next Image Request)
  */
 static esp_err_t ota_check_for_update(void)
 {
@@ -296,165 +1018,23 @@ static esp_err_t ota_check_for_update(void)
     // Обновление состояния
     ota_data.state = OTA_STATE_CHECKING;
     
-    // Настройка HTTP-клиента
-    esp_http_client_config_t config = {
-        .url = ota_data.config.server_url,
-        .event_handler = http_event_handler,
-        .keep_alive_enable = true,
-        .skip_cert_common_name_check = true,
-    };
-    
-    // Инициализация HTTP-клиента
-    esp_http_client_handle_t client = esp_http_client_init(&config);
-    if (client == NULL) {
-        ESP_LOGE(TAG, "Ошибка инициализации HTTP-клиента");
-        ota_data.state = OTA_STATE_ERROR;
-        return ESP_FAIL;
-    }
-    
-    // Выполнение HEAD-запроса для проверки доступности обновления
-    esp_err_t err = esp_http_client_perform(client);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Ошибка HTTP-запроса: %s", esp_err_to_name(err));
-        esp_http_client_cleanup(client);
-        ota_data.state = OTA_STATE_ERROR;
-        return err;
-    }
-    
-    // Проверка статуса ответа
-    int status_code = esp_http_client_get_status_code(client);
-    ESP_LOGI(TAG, "Статус HTTP-ответа: %d", status_code);
-    
-    // Проверка версии прошивки
-    // Если доступна новая версия, тогда обновляем состояние
-    if (status_code == 200) {
-        ESP_LOGI(TAG, "Доступно обновление");
-        
-        // В реальном устройстве здесь будет проверка версии из заголовков HTTP
-        // и сравнение с текущей версией
-        
-        // Для демонстрации считаем, что всегда доступно обновление
-        ota_data.state = OTA_STATE_IDLE;  // Готовы к загрузке
-    } else {
-        ESP_LOGI(TAG, "Обновлений не найдено");
-        ota_data.state = OTA_STATE_IDLE;
-    }
-    
-    // Освобождение ресурсов HTTP-клиента
-    esp_http_client_cleanup(client);
-    
-    return ESP_OK;
-}
-
-/**
- * @brief Загрузка и применение обновления
- */
-static esp_err_t ota_download_and_apply_update(void)
-{
-    ESP_LOGI(TAG, "Загрузка и применение обновления...");
-    
-    // Обновление состояния
-    ota_data.state = OTA_STATE_DOWNLOADING;
-    ota_data.download_progress = 0;
-    
-    // Настройка HTTP-клиента для OTA
-    esp_http_client_config_t config = {
-        .url = ota_data.config.server_url,
-        .event_handler = http_event_handler,
-        .keep_alive_enable = true,
-        .skip_cert_common_name_check = true,
-    };
-    
-    // Настройка параметров OTA
-    esp_https_ota_config_t ota_config = {
-        .http_config = &config,
+    ota_image_t current = {
+        .manuf_code = ESP_ZIGBEE_MANUFACTURER_CODE,
+        .image_type = ota_data.config.image_type,
+        .file_version = ota_data.config.file_version
     };
     
-    // Инициализация OTA
-    esp_https_ota_handle_t https_ota_handle = NULL;
-    esp_err_t err = esp_https_ota_begin(&ota_config, &https_ota_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Ошибка инициализации OTA: %s", esp_err_to_name(err));
-        ota_data.state = OTA_STATE_ERROR;
-        return err;
-    }
-    
-    // Получение информации о новом образе
-    esp_app_desc_t app_desc;
-    err = esp_https_ota_get_img_desc(https_ota_handle, &app_desc);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Ошибка получения описания образа: %s", esp_err_to_name(err));
-        esp_https_ota_abort(https_ota_handle);
-        ota_data.state = OTA_STATE_ERROR;
-        return err;
-    }
-    
-    // Проверка заголовка образа
-    err = validate_image_header(&app_desc);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Ошибка валидации образа: %s", esp_err_to_name(err));
-        esp_https_ota_abort(https_ota_handle);
-        ota_data.state = OTA_STATE_ERROR;
-        return err;
-    }
-    
-    // Загрузка образа
-    while (1) {
-        err = esp_https_ota_perform(https_ota_handle);
-        if (err != ESP_ERR_HTTPS_OTA_IN_PROGRESS) {
-            break;
-        }
-        
-        // Обновление прогресса
-        ota_data.download_progress = (uint8_t)(esp_https_ota_get_image_len_read(https_ota_handle) * 100 / 
-                                                 esp_https_ota_get_image_size(https_ota_handle));
-        
-        // Короткая задержка
-        vTaskDelay(pdMS_TO_TICKS(100));
-    }
-    
-    // Проверка результата загрузки
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Ошибка загрузки образа: %s", esp_err_to_name(err));
-        esp_https_ota_abort(https_ota_handle);
-        ota_data.state = OTA_STATE_ERROR;
-        return err;
-    }
+    uint8_t payload[9];
+    payload[0] = 0x00;  // Поле управления: без версии аппаратуры
+    ota_put_image_id(&payload[1], &current);
     
-    // Завершение OTA и проверка результата
-    err = esp_https_ota_finish(https_ota_handle);
+    esp_err_t err = ota_send(OTA_CMD_QUERY_NEXT_IMAGE_REQ, payload, sizeof(payload));
     if (err != ESP_OK) {
-        if (err == ESP_ERR_OTA_VALIDATE_FAILED) {
-            ESP_LOGE(TAG, "Ошибка валидации образа после загрузки");
-        }
-        ESP_LOGE(TAG, "Ошибка завершения OTA: %s", esp_err_to_name(err));
+        ota_data.download_requested = false;
         ota_data.state = OTA_STATE_ERROR;
-        return err;
     }
     
-    // Обновление состояния
-    ota_data.state = OTA_STATE_READY_TO_APPLY;
-    ota_data.download_progress = 100;
-    
-    // Сохранение новой версии
-    strncpy(ota_data.new_version, app_desc.version, OTA_VERSION_BUFFER_SIZE - 1);
-    ota_data.new_version[OTA_VERSION_BUFFER_SIZE - 1] = '\0';
-    
-    ESP_LOGI(TAG, "Обновление успешно загружено. Новая версия: %s", ota_data.new_version);
-    
-    // Если включено автоматическое обновление
-    if (ota_data.config.auto_update) {
-        ESP_LOGI(TAG, "Автоматическое применение обновления...");
-        ota_data.state = OTA_STATE_APPLYING;
-        
-        // Небольшая задержка перед перезагрузкой
-        vTaskDelay(pdMS_TO_TICKS(3000));
-        
-        ESP_LOGI(TAG, "Перезагрузка для применения обновления");
-        esp_restart();
-    }
-    
-    return ESP_OK;
+    return err;
 }
 
 /**
@@ -466,25 +1046,27 @@ void ota_task_handler(void *pvParameter)
     
     // Бесконечный цикл обработки
     while (1) {
-        // Проверка событий OTA
-        EventBits_t bits = xEventGroupWaitBits(
-            ota_data.event_group,
-            OTA_EVENT_CHECK_UPDATE | OTA_EVENT_START_DOWNLOAD | OTA_EVENT_APPLY_UPDATE,
-            pdTRUE,  // Сброс битов после чтения
-            pdFALSE, // Любое событие
-            pdMS_TO_TICKS(1000)  // Таймаут 1 секунда
-        );
+        // Команды сервера обрабатываются по мере поступления
+        ota_msg_t msg;
+        if (xQueueReceive(ota_data.msg_queue, &msg, pdMS_TO_TICKS(OTA_POLL_INTERVAL_MS)) == pdTRUE) {
+            ota_handle_message(&msg);
+        }
+        
+        // Проверка событий OTA (сброс битов после чтения)
+        EventBits_t bits = xEventGroupClearBits(ota_data.event_group, OTA_EVENT_ALL);
+        
+        bool idle = (ota_data.state == OTA_STATE_IDLE || ota_data.state == OTA_STATE_ERROR);
         
         // Обработка события проверки обновлений
-        if (bits & OTA_EVENT_CHECK_UPDATE) {
+        if ((bits & OTA_EVENT_CHECK_UPDATE) && idle) {
             ESP_LOGI(TAG, "Обработка события проверки обновлений");
             ota_check_for_update();
         }
         
         // Обработка события загрузки обновления
-        if (bits & OTA_EVENT_START_DOWNLOAD) {
+        if ((bits & OTA_EVENT_START_DOWNLOAD) && idle) {
             ESP_LOGI(TAG, "Обработка события загрузки обновления");
-            ota_download_and_apply_update();
+            ota_start_download();
         }
         
         // Обработка события применения обновления
@@ -501,8 +1083,12 @@ void ota_task_handler(void *pvParameter)
             esp_restart();
         }
         
+        // Повтор потерянных запросов
+        ota_check_deadlines();
+        
         // Проверка необходимости автоматической проверки обновлений
-        if (ota_data.config.auto_check && ota_data.state == OTA_STATE_IDLE) {
+        if (ota_data.config.auto_check &&
+            (ota_data.state == OTA_STATE_IDLE || ota_data.state == OTA_STATE_ERROR)) {
             static uint32_t last_check_time = 0;
             uint32_t current_time = xTaskGetTickCount() * portTICK_PERIOD_MS;
             
@@ -512,11 +1098,8 @@ void ota_task_handler(void *pvParameter)
                 ota_check_for_update();
             }
         }
-        
-        // Короткая задержка
-        vTaskDelay(pdMS_TO_TICKS(100));
     }
     
     // На случай выхода из цикла
     vTaskDelete(NULL);
-} 
\ No newline at end of file
+}
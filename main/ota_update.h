@@ -1,6 +1,6 @@
 /**
  * @file ota_update.h
- * @brief Модуль OTA-обновлений для умного окна
+ * @brief Модуль OTA-обновлений для умного окна (клиент кластера OTA Upgrade ZigBee)
  */
 
 #ifndef OTA_UPDATE_H
@@ -10,6 +10,11 @@
 #include <stdbool.h>
 #include "esp_err.h"
 
+/**
+ * @brief Максимальный размер блока образа в одном ответе (без фрагментации APS)
+ */
+#define OTA_MAX_BLOCK_SIZE 64
+
 /**
  * @brief Состояние OTA-обновления
  */
@@ -26,8 +31,13 @@ typedef enum {
  * @brief Структура конфигурации OTA
  */
 typedef struct {
-    char server_url[128];         ///< URL сервера обновлений
     char firmware_version[16];    ///< Текущая версия прошивки
+    uint32_t file_version;        ///< Версия файла OTA ZigBee текущей прошивки
+    uint16_t image_type;          ///< Тип образа OTA ZigBee
+    uint8_t block_size;           ///< Размер запрашиваемого блока (байт, до OTA_MAX_BLOCK_SIZE)
+    bool page_mode;               ///< Запрос страницами (Image Page Request) вместо отдельных блоков
+    uint16_t page_size;           ///< Размер страницы в режиме страниц (байт)
+    uint16_t response_spacing_ms; ///< Интервал между блоками страницы (мс)
     uint32_t check_interval_ms;   ///< Интервал проверки обновлений в миллисекундах
     bool auto_check;              ///< Автоматическая проверка обновлений
     bool auto_update;             ///< Автоматическое применение обновлений
@@ -99,6 +109,18 @@ uint8_t ota_get_download_progress(void);
  */
 esp_err_t ota_get_firmware_version(char *version, size_t version_len);
 
+/**
+ * @brief Обработка команды сервера OTA Upgrade
+ * 
+ * Колбэк библиотеки ZigBee (esp_zigbee_ota_cb_t): вызывается в контексте
+ * стека, только копирует команду в очередь задачи OTA.
+ * 
+ * @param cmd_id Идентификатор команды ZCL
+ * @param payload Полезная нагрузка команды
+ * @param len Длина полезной нагрузки
+ */
+void ota_handle_zigbee_command(uint8_t cmd_id, const uint8_t *payload, uint16_t len);
+
 /**
  * @brief Обработчик OTA-задачи
  * 
@@ -4,6 +4,7 @@
  */
 
 #include "power_management.h"
+#include "device_config.h"
 #include "esp_log.h"
 #include "esp_sleep.h"
 #include "esp_adc/adc_oneshot.h"
@@ -29,8 +30,7 @@ static const char* TAG = "POWER_MGMT";
 #define BATTERY_FULL_VOLTAGE        4200  // 4.2V для Li-ion аккумулятора
 #define BATTERY_EMPTY_VOLTAGE       3000  // 3.0V для Li-ion аккумулятора
 
-// Периоды проверки и ожидания
-#define POWER_CHECK_INTERVAL_MS     10000  // 10 секунд между проверками питания
+// Маска пробуждения (период проверки питания настраивается, см. device_config.h)
 #define WAKE_UP_GPIO_MASK           ((1ULL << POWER_SOURCE_GPIO))
 
 // Структура данных для управления питанием
@@ -456,7 +456,10 @@ esp_err_t power_deep_sleep(uint64_t sleep_duration_ms)
     ESP_LOGI(TAG, "Настройка пробуждения по GPIO");
     esp_sleep_enable_ext1_wakeup(WAKE_UP_GPIO_MASK, ESP_EXT1_WAKEUP_ANY_HIGH);
     
-    // Сохранение состояния перед переходом в сон (при необходимости)
+    // Сохранение состояния перед переходом в сон
+    if (power_state.config.on_before_sleep) {
+        power_state.config.on_before_sleep();
+    }
     
     // Переход в глубокий сон
     ESP_LOGI(TAG, "Переход в глубокий сон...");
@@ -493,7 +496,7 @@ void power_task_handler(void *pvParameter)
         uint32_t current_time = xTaskGetTickCount() * portTICK_PERIOD_MS;
         
         // Периодическое обновление статуса питания
-        if (current_time - last_check_time >= POWER_CHECK_INTERVAL_MS) {
+        if (current_time - last_check_time >= device_config_get(CONFIG_KEY_POWER_CHECK_INTERVAL_MS)) {
             // Обновление информации об источнике питания
             power_source_t current_source = power_check_external_source() ? 
                                            POWER_SOURCE_EXTERNAL : POWER_SOURCE_BATTERY;
@@ -501,6 +504,10 @@ void power_task_handler(void *pvParameter)
             if (current_source != power_state.config.source) {
                 power_state.config.source = current_source;
                 ESP_LOGI(TAG, "Изменен источник питания: %d", current_source);
+                
+                if (power_state.config.on_source_change) {
+                    power_state.config.on_source_change(current_source);
+                }
             }
             
             // Обновление статуса батареи
@@ -511,7 +518,8 @@ void power_task_handler(void *pvParameter)
         }
         
         // Проверка необходимости перехода в спящий режим
-        if (power_state.config.enable_auto_sleep) {
+        // (на внешнем питании устройство работает маршрутизатором и не засыпает)
+        if (power_state.config.enable_auto_sleep && power_state.config.source == POWER_SOURCE_BATTERY) {
             uint32_t inactivity_time = current_time - power_state.last_activity_time;
             
             if (inactivity_time >= power_state.config.sleep_timeout_ms) {
@@ -521,9 +529,6 @@ void power_task_handler(void *pvParameter)
                 // Переход в режим сна
                 power_set_mode(POWER_MODE_SLEEP);
                 
-                // В реальном устройстве здесь может быть дополнительная логика
-                // для сохранения состояния перед переходом в глубокий сон
-                
                 // Переход в глубокий сон
                 power_deep_sleep(0); // Бесконечный сон до внешнего пробуждения
             }
@@ -27,6 +27,20 @@ typedef enum {
     POWER_SOURCE_EXTERNAL = 1  ///< Внешнее питание
 } power_source_t;
 
+/**
+ * @brief Тип колбэка смены источника питания
+ * 
+ * Вызывается из задачи управления питанием.
+ */
+typedef void (*power_source_cb_t)(power_source_t source);
+
+/**
+ * @brief Тип колбэка подготовки ко сну
+ * 
+ * Вызывается перед переходом в глубокий сон для записи несохраненных данных.
+ */
+typedef void (*power_sleep_cb_t)(void);
+
 /**
  * @brief Структура конфигурации управления питанием
  */
@@ -36,6 +50,8 @@ typedef struct {
     uint16_t critical_battery_threshold; ///< Критический порог заряда батареи (мВ)
     uint32_t sleep_timeout_ms;        ///< Время до перехода в режим сна (мс)
     bool enable_auto_sleep;           ///< Автоматический переход в режим сна
+    power_source_cb_t on_source_change; ///< Колбэк смены источника питания (NULL - не используется)
+    power_sleep_cb_t on_before_sleep; ///< Колбэк перед глубоким сном (NULL - не используется)
 } power_config_t;
 
 /**
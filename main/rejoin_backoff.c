@@ -0,0 +1,45 @@
+/**
+ * @file rejoin_backoff.c
+ * @brief Расписание попыток переподключения к сети ZigBee
+ */
+
+#include "rejoin_backoff.h"
+#include "esp_log.h"
+#include "esp_random.h"
+
+static const char *TAG = "REJOIN_BACKOFF";
+
+/**
+ * @brief Начало расписания после потери сети
+ */
+uint32_t rejoin_backoff_start(rejoin_backoff_t *backoff)
+{
+    backoff->attempt = 0;
+    backoff->budget = REJOIN_ATTEMPT_BUDGET;
+    
+    return esp_random() % REJOIN_START_SPREAD_MS;
+}
+
+/**
+ * @brief Учет очередной попытки
+ */
+uint32_t rejoin_backoff_next(rejoin_backoff_t *backoff)
+{
+    backoff->attempt++;
+    
+    if (--backoff->budget == 0) {
+        ESP_LOGW(TAG, "Бюджет попыток исчерпан, пауза %d мин", REJOIN_REST_MS / 60000);
+        backoff->budget = REJOIN_ATTEMPT_BUDGET;
+        return REJOIN_REST_MS;
+    }
+    
+    uint32_t delay = REJOIN_MAX_DELAY_MS;
+    if (backoff->attempt < 20) {
+        delay = REJOIN_BASE_DELAY_MS << backoff->attempt;
+        if (delay > REJOIN_MAX_DELAY_MS) {
+            delay = REJOIN_MAX_DELAY_MS;
+        }
+    }
+    
+    return delay / 2 + esp_random() % (delay / 2 + 1);
+}
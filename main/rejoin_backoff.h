@@ -0,0 +1,46 @@
+/**
+ * @file rejoin_backoff.h
+ * @brief Расписание попыток переподключения к сети ZigBee
+ * 
+ * Задержка между попытками растет экспоненциально со случайной половиной
+ * интервала, чтобы устройства, одновременно потерявшие сеть, не обращались
+ * к координатору в один момент. После исчерпания бюджета попыток
+ * выдерживается долгая пауза (ограничение расхода энергии).
+ */
+
+#ifndef REJOIN_BACKOFF_H
+#define REJOIN_BACKOFF_H
+
+#include <stdint.h>
+
+#define REJOIN_BASE_DELAY_MS    1000     // Базовая задержка между попытками (мс)
+#define REJOIN_MAX_DELAY_MS     300000   // Максимальная задержка между попытками (5 минут)
+#define REJOIN_START_SPREAD_MS  5000     // Разброс первой попытки после потери сети (мс)
+#define REJOIN_ATTEMPT_BUDGET   16       // Попыток до паузы
+#define REJOIN_REST_MS          3600000  // Пауза после исчерпания бюджета попыток (1 час)
+
+/**
+ * @brief Состояние расписания попыток
+ */
+typedef struct {
+    uint32_t attempt;           // Выполнено попыток с потери сети
+    uint32_t budget;            // Осталось попыток до паузы
+} rejoin_backoff_t;
+
+/**
+ * @brief Начало расписания после потери сети
+ * 
+ * @param backoff Состояние расписания
+ * @return uint32_t Задержка до первой попытки, мс (случайная в пределах REJOIN_START_SPREAD_MS)
+ */
+uint32_t rejoin_backoff_start(rejoin_backoff_t *backoff);
+
+/**
+ * @brief Учет очередной попытки
+ * 
+ * @param backoff Состояние расписания (номер попытки увеличивается)
+ * @return uint32_t Задержка до следующей попытки, мс (REJOIN_REST_MS после исчерпания бюджета)
+ */
+uint32_t rejoin_backoff_next(rejoin_backoff_t *backoff);
+
+#endif /* REJOIN_BACKOFF_H */
@@ -0,0 +1,85 @@
+/**
+ * @file report_dest.c
+ * @brief Список получателей отчетов, предвычисленный по таблице привязок
+ */
+
+#include "report_dest.h"
+#include <string.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+
+static const char *TAG = "REPORT_DEST";
+
+// Список перестраивается в контексте стека, читается задачами приложения
+static struct {
+    report_dest_t dests[REPORT_DEST_MAX];
+    uint8_t count;
+    uint32_t table_scans;
+} dest_ctx;
+
+static portMUX_TYPE dest_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief Перестроение списка получателей по таблице привязок
+ */
+uint8_t report_dest_rebuild(report_dest_table_read_t read_table, uint8_t endpoint, uint16_t cluster_id)
+{
+    report_dest_binding_t bindings[REPORT_DEST_BINDING_SCAN_MAX];
+    report_dest_t dests[REPORT_DEST_MAX];
+    uint8_t count = 0;
+    
+    uint8_t total = read_table(bindings, REPORT_DEST_BINDING_SCAN_MAX);
+    
+    for (uint8_t i = 0; i < total; i++) {
+        // Интересуют только привязки кластера отчетов нашего эндпоинта
+        if (bindings[i].src_endpoint != endpoint || bindings[i].cluster_id != cluster_id) {
+            continue;
+        }
+        
+        if (count >= REPORT_DEST_MAX) {
+            ESP_LOGW(TAG, "Слишком много привязок, лишние получатели пропущены");
+            break;
+        }
+        
+        dests[count++] = bindings[i].dest;
+    }
+    
+    // Без привязок отчеты по-прежнему уходят координатору
+    if (count == 0) {
+        memset(&dests[0], 0, sizeof(dests[0]));
+        dests[0].addr_mode = REPORT_DEST_ADDR_MODE_SHORT;
+        dests[0].addr.addr_short = REPORT_DEST_COORDINATOR_ADDR;
+        dests[0].endpoint = REPORT_DEST_COORDINATOR_EP;
+        count = 1;
+    }
+    
+    portENTER_CRITICAL(&dest_lock);
+    memcpy(dest_ctx.dests, dests, count * sizeof(report_dest_t));
+    dest_ctx.count = count;
+    dest_ctx.table_scans++;
+    portEXIT_CRITICAL(&dest_lock);
+    
+    ESP_LOGI(TAG, "Список получателей отчетов обновлен: %d (привязок в таблице: %d)", count, total);
+    return count;
+}
+
+/**
+ * @brief Снимок списка получателей
+ */
+uint8_t report_dest_snapshot(report_dest_t *dests)
+{
+    portENTER_CRITICAL(&dest_lock);
+    uint8_t count = dest_ctx.count;
+    memcpy(dests, dest_ctx.dests, count * sizeof(report_dest_t));
+    portEXIT_CRITICAL(&dest_lock);
+    
+    return count;
+}
+
+/**
+ * @brief Число чтений таблицы привязок с запуска
+ */
+uint32_t report_dest_table_scans(void)
+{
+    return dest_ctx.table_scans;
+}
@@ -0,0 +1,81 @@
+/**
+ * @file report_dest.h
+ * @brief Список получателей отчетов, предвычисленный по таблице привязок
+ * 
+ * Список перестраивается при изменении таблицы привязок и подключении к
+ * сети. Отправка отчета берет снимок готового списка и таблицу привязок
+ * не читает. Без подходящих привязок отчеты получает координатор.
+ */
+
+#ifndef REPORT_DEST_H
+#define REPORT_DEST_H
+
+#include <stdint.h>
+
+#define REPORT_DEST_MAX             8        // Максимум получателей отчетов из таблицы привязок
+#define REPORT_DEST_BINDING_SCAN_MAX 32      // Привязок, читаемых из таблицы стека за одно перестроение
+#define REPORT_DEST_COORDINATOR_ADDR 0x0000  // Адрес координатора (получатель по умолчанию)
+#define REPORT_DEST_COORDINATOR_EP  1        // Эндпоинт координатора
+
+// Режимы адресации APS (значения esp_zb_zcl_address_mode_t и поля dst_addr_mode привязки)
+#define REPORT_DEST_ADDR_MODE_GROUP 0x01     // Адрес группы, без эндпоинта
+#define REPORT_DEST_ADDR_MODE_SHORT 0x02     // Короткий адрес и эндпоинт
+#define REPORT_DEST_ADDR_MODE_IEEE  0x03     // IEEE адрес и эндпоинт
+
+/**
+ * @brief Получатель отчетов
+ */
+typedef struct {
+    uint8_t addr_mode;          // Режим адресации APS (REPORT_DEST_ADDR_MODE_*)
+    union {
+        uint16_t addr_short;    // Короткий адрес узла или адрес группы
+        uint8_t addr_long[8];   // IEEE адрес узла
+    } addr;
+    uint8_t endpoint;           // Эндпоинт получателя (не используется для групп)
+} report_dest_t;
+
+/**
+ * @brief Запись таблицы привязок, нужная для выбора получателей
+ */
+typedef struct {
+    uint8_t src_endpoint;       // Эндпоинт устройства
+    uint16_t cluster_id;        // Привязанный кластер
+    report_dest_t dest;         // Получатель
+} report_dest_binding_t;
+
+/**
+ * @brief Чтение таблицы привязок стека
+ * 
+ * @param bindings Буфер записей
+ * @param max Размер буфера
+ * @return uint8_t Число прочитанных записей
+ */
+typedef uint8_t (*report_dest_table_read_t)(report_dest_binding_t *bindings, uint8_t max);
+
+/**
+ * @brief Перестроение списка получателей по таблице привязок
+ * 
+ * В список попадают привязки кластера cluster_id эндпоинта endpoint в
+ * порядке таблицы, не больше REPORT_DEST_MAX.
+ * 
+ * @param read_table Чтение таблицы привязок
+ * @param endpoint Эндпоинт устройства
+ * @param cluster_id Кластер отчетов
+ * @return uint8_t Число получателей
+ */
+uint8_t report_dest_rebuild(report_dest_table_read_t read_table, uint8_t endpoint, uint16_t cluster_id);
+
+/**
+ * @brief Снимок списка получателей
+ * 
+ * @param dests Буфер на REPORT_DEST_MAX записей
+ * @return uint8_t Число получателей
+ */
+uint8_t report_dest_snapshot(report_dest_t *dests);
+
+/**
+ * @brief Число чтений таблицы привязок с запуска
+ */
+uint32_t report_dest_table_scans(void);
+
+#endif /* REPORT_DEST_H */
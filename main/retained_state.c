@@ -0,0 +1,188 @@
+/**
+ * @file retained_state.c
+ * @brief Реализация копии состояния устройства в RTC-памяти
+ */
+
+#include "retained_state.h"
+#include <string.h>
+#include <stddef.h>
+#include <sys/time.h>
+#include "esp_log.h"
+#include "esp_attr.h"
+#include "esp_system.h"
+#include "esp_sleep.h"
+#include "esp_rom_crc.h"
+
+// Определение тега для логов
+static const char* TAG = "RETAINED_STATE";
+
+// Признак и версия записи в RTC-памяти
+#define RETAINED_STATE_MAGIC    0x53544D57  // "WMTS"
+#define RETAINED_STATE_VERSION  2
+
+// Флаги записи
+#define RETAINED_FLAG_CALIBRATED     (1 << 0)
+#define RETAINED_FLAG_NETWORK_VALID  (1 << 1)
+#define RETAINED_FLAG_TIME_VALID     (1 << 2)
+
+// Запись в RTC-памяти
+typedef struct {
+    uint32_t magic;                     // RETAINED_STATE_MAGIC
+    uint8_t version;                    // RETAINED_STATE_VERSION
+    uint8_t window_mode;                // Режим окна
+    uint8_t gap_percentage;             // Процент открытия зазора
+    uint8_t flags;                      // RETAINED_FLAG_*
+    uint8_t handle_angle;               // Угол сервопривода ручки
+    uint8_t gap_angle;                  // Угол сервопривода зазора
+    uint16_t reserved;                  // Выравнивание
+    esp_zigbee_network_info_t network;  // Параметры сети ZigBee
+    uint32_t local_time;                // Местное время на момент сна (с)
+    int64_t rtc_time_us;                // Системные часы на момент сна (мкс)
+    uint32_t crc;                       // CRC32 предыдущих полей
+} retained_record_t;
+
+// Память не обнуляется при запуске; при холодном запуске содержимое
+// случайно и отбрасывается по причине сброса и CRC32
+static RTC_NOINIT_ATTR retained_record_t retained_record;
+
+// Прототипы вспомогательных функций
+static uint32_t retained_record_crc(const retained_record_t *record);
+static bool retained_record_valid(const retained_record_t *record);
+static bool retained_is_warm_wake(void);
+static int64_t retained_rtc_time_us(void);
+
+/**
+ * @brief Запись копии состояния в RTC-память
+ */
+void retained_state_store(const retained_state_t *state)
+{
+    if (state == NULL) {
+        return;
+    }
+    
+    retained_record_t record;
+    memset(&record, 0, sizeof(record));
+    
+    record.magic = RETAINED_STATE_MAGIC;
+    record.version = RETAINED_STATE_VERSION;
+    record.window_mode = (uint8_t)state->window_mode;
+    record.gap_percentage = state->gap_percentage;
+    record.flags = (state->calibrated ? RETAINED_FLAG_CALIBRATED : 0) |
+                   (state->network_valid ? RETAINED_FLAG_NETWORK_VALID : 0) |
+                   (state->time_valid ? RETAINED_FLAG_TIME_VALID : 0);
+    record.handle_angle = state->handle_angle;
+    record.gap_angle = state->gap_angle;
+    if (state->network_valid) {
+        memcpy(&record.network, &state->network, sizeof(record.network));
+    }
+    if (state->time_valid) {
+        record.local_time = state->sleep_local_time;
+        record.rtc_time_us = retained_rtc_time_us();
+    }
+    record.crc = retained_record_crc(&record);
+    
+    memcpy(&retained_record, &record, sizeof(retained_record));
+    
+    ESP_LOGI(TAG, "Состояние сохранено в RTC-память: режим=%d, зазор=%d%%",
+             record.window_mode, record.gap_percentage);
+}
+
+/**
+ * @brief Получение копии состояния после пробуждения
+ */
+bool retained_state_restore(retained_state_t *state)
+{
+    if (state == NULL) {
+        return false;
+    }
+    
+    bool warm_wake = retained_is_warm_wake();
+    bool valid = warm_wake && retained_record_valid(&retained_record);
+    
+    if (valid) {
+        memset(state, 0, sizeof(*state));
+        state->window_mode = (window_mode_t)retained_record.window_mode;
+        state->gap_percentage = retained_record.gap_percentage;
+        state->calibrated = (retained_record.flags & RETAINED_FLAG_CALIBRATED) != 0;
+        state->handle_angle = retained_record.handle_angle;
+        state->gap_angle = retained_record.gap_angle;
+        state->network_valid = (retained_record.flags & RETAINED_FLAG_NETWORK_VALID) != 0;
+        memcpy(&state->network, &retained_record.network, sizeof(state->network));
+        
+        // Время сна отсчитывается системными часами; если они сбились, время
+        // не восстанавливается и запрашивается у хаба
+        int64_t slept_us = retained_rtc_time_us() - retained_record.rtc_time_us;
+        state->time_valid = (retained_record.flags & RETAINED_FLAG_TIME_VALID) != 0 && slept_us >= 0;
+        if (state->time_valid) {
+            state->sleep_local_time = retained_record.local_time;
+            state->local_time = retained_record.local_time + (uint32_t)(slept_us / 1000000);
+        }
+        
+        ESP_LOGI(TAG, "Состояние восстановлено из RTC-памяти: режим=%d, зазор=%d%%",
+                 state->window_mode, state->gap_percentage);
+    } else if (warm_wake) {
+        ESP_LOGW(TAG, "Копия состояния в RTC-памяти недействительна, чтение из NVS");
+    }
+    
+    // Копия одноразовая: следующий запуск без сна не должен ее использовать
+    retained_state_invalidate();
+    
+    return valid;
+}
+
+/**
+ * @brief Признание копии состояния недействительной
+ */
+void retained_state_invalidate(void)
+{
+    retained_record.magic = 0;
+}
+
+/**
+ * @brief Расчет CRC32 записи
+ */
+static uint32_t retained_record_crc(const retained_record_t *record)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)record, offsetof(retained_record_t, crc));
+}
+
+/**
+ * @brief Проверка целостности записи
+ */
+static bool retained_record_valid(const retained_record_t *record)
+{
+    if (record->magic != RETAINED_STATE_MAGIC || record->version != RETAINED_STATE_VERSION) {
+        return false;
+    }
+    
+    if (record->window_mode > WINDOW_MODE_VENT || record->gap_percentage > 100) {
+        return false;
+    }
+    
+    return record->crc == retained_record_crc(record);
+}
+
+/**
+ * @brief Проверка пробуждения из глубокого сна по таймеру или GPIO
+ */
+static bool retained_is_warm_wake(void)
+{
+    if (esp_reset_reason() != ESP_RST_DEEPSLEEP) {
+        return false;
+    }
+    
+    esp_sleep_wakeup_cause_t cause = esp_sleep_get_wakeup_cause();
+    return cause == ESP_SLEEP_WAKEUP_TIMER ||
+           cause == ESP_SLEEP_WAKEUP_EXT1 ||
+           cause == ESP_SLEEP_WAKEUP_GPIO;
+}
+
+/**
+ * @brief Системные часы (идут во время глубокого сна)
+ */
+static int64_t retained_rtc_time_us(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
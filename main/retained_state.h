@@ -0,0 +1,66 @@
+/**
+ * @file retained_state.h
+ * @brief Копия состояния устройства в RTC-памяти для быстрого пробуждения
+ * 
+ * Перед глубоким сном состояние окна, углы сервоприводов и параметры сети
+ * ZigBee копируются в RTC-память, которая сохраняется во время сна. После
+ * пробуждения по таймеру или GPIO копия используется вместо чтения NVS;
+ * при холодном запуске копия игнорируется. Местное время переносится через
+ * сон по системным часам, которые идут от RTC-таймера и во время сна.
+ */
+
+#ifndef RETAINED_STATE_H
+#define RETAINED_STATE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "servo_control.h"
+#include "esp_zigbee_lib.h"
+
+/**
+ * @brief Состояние, сохраняемое на время глубокого сна
+ */
+typedef struct {
+    window_mode_t window_mode;          ///< Режим окна
+    uint8_t gap_percentage;             ///< Процент открытия зазора
+    bool calibrated;                    ///< Флаг калибровки
+    uint8_t handle_angle;               ///< Угол сервопривода ручки (градусы)
+    uint8_t gap_angle;                  ///< Угол сервопривода зазора (градусы)
+    bool network_valid;                 ///< Устройство входило в сеть ZigBee
+    esp_zigbee_network_info_t network;  ///< Сохраненные в NVS параметры сети
+    bool time_valid;                    ///< Часы расписания синхронизированы
+    uint32_t sleep_local_time;          ///< Местное время на момент сна (с)
+    uint32_t local_time;                ///< Местное время после пробуждения (с, заполняется при восстановлении)
+} retained_state_t;
+
+/**
+ * @brief Запись копии состояния в RTC-память
+ * 
+ * Вызывается непосредственно перед глубоким сном, после записи
+ * несохраненных изменений в NVS.
+ * 
+ * @param state Состояние устройства
+ */
+void retained_state_store(const retained_state_t *state);
+
+/**
+ * @brief Получение копии состояния после пробуждения
+ * 
+ * Копия принимается только после пробуждения из глубокого сна по таймеру
+ * или GPIO и только при совпадении CRC32. Копия одноразовая: после вызова
+ * она становится недействительной.
+ * 
+ * @param state Указатель для записи состояния
+ * @return bool true, если копия действительна и NVS можно не читать
+ */
+bool retained_state_restore(retained_state_t *state);
+
+/**
+ * @brief Признание копии состояния недействительной
+ * 
+ * Используется, если NVS не удалось привести в соответствие с текущим
+ * состоянием: при следующем запуске состояние будет прочитано из NVS.
+ */
+void retained_state_invalidate(void);
+
+#endif /* RETAINED_STATE_H */
@@ -0,0 +1,223 @@
+/**
+ * @file scene_table.c
+ * @brief Реализация таблицы сцен ZigBee для умного окна
+ */
+
+#include "scene_table.h"
+#include <string.h>
+#include "esp_log.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+
+static const char *TAG = "SCENE_TABLE";
+
+// Хранение таблицы в NVS одним блобом
+#define SCENE_NVS_NAMESPACE "scenes"
+#define SCENE_NVS_KEY_TABLE "table"
+
+// Запись сцены (5 байт)
+typedef struct __attribute__((packed)) {
+    uint16_t group_id;        // Идентификатор группы
+    uint8_t scene_id;         // Идентификатор сцены
+    uint8_t window_mode;      // Режим окна
+    uint8_t gap_percentage;   // Процент открытия зазора
+} scene_entry_t;
+
+// Таблица сцен: занятые записи хранятся подряд в начале массива. Таблицу
+// изменяет только исполнитель команд; изменения выполняются под блокировкой,
+// потому что стек ZigBee проверяет наличие сцены из своей задачи
+static scene_entry_t scenes[SCENE_TABLE_SIZE];
+static uint8_t scene_count = 0;
+static portMUX_TYPE scenes_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief Поиск индекса сцены в таблице
+ */
+static int scene_table_find(uint16_t group_id, uint8_t scene_id)
+{
+    for (int i = 0; i < scene_count; i++) {
+        if (scenes[i].group_id == group_id && scenes[i].scene_id == scene_id) {
+            return i;
+        }
+    }
+    
+    return -1;
+}
+
+/**
+ * @brief Запись таблицы сцен в NVS
+ */
+static esp_err_t scene_table_save(void)
+{
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(SCENE_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Ошибка открытия NVS: %s", esp_err_to_name(err));
+        return err;
+    }
+    
+    // Сохраняем только занятые записи
+    if (scene_count > 0) {
+        err = nvs_set_blob(handle, SCENE_NVS_KEY_TABLE, scenes, scene_count * sizeof(scene_entry_t));
+    } else {
+        err = nvs_erase_key(handle, SCENE_NVS_KEY_TABLE);
+        if (err == ESP_ERR_NVS_NOT_FOUND) {
+            err = ESP_OK;
+        }
+    }
+    
+    if (err == ESP_OK) {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Ошибка сохранения таблицы сцен: %s", esp_err_to_name(err));
+    }
+    
+    return err;
+}
+
+/**
+ * @brief Инициализация таблицы сцен и загрузка ее из NVS
+ */
+esp_err_t scene_table_init(void)
+{
+    scene_count = 0;
+    
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(SCENE_NVS_NAMESPACE, NVS_READONLY, &handle);
+    if (err != ESP_OK) {
+        // Сцены еще не сохранялись
+        return ESP_OK;
+    }
+    
+    size_t size = sizeof(scenes);
+    err = nvs_get_blob(handle, SCENE_NVS_KEY_TABLE, scenes, &size);
+    nvs_close(handle);
+    
+    if (err == ESP_OK && size % sizeof(scene_entry_t) == 0) {
+        scene_count = size / sizeof(scene_entry_t);
+    } else if (err != ESP_ERR_NVS_NOT_FOUND) {
+        ESP_LOGW(TAG, "Таблица сцен повреждена, используется пустая таблица");
+    }
+    
+    ESP_LOGI(TAG, "Загружено сцен: %d", scene_count);
+    return ESP_OK;
+}
+
+/**
+ * @brief Сохранение сцены (существующая сцена перезаписывается)
+ */
+esp_err_t scene_table_store(uint16_t group_id, uint8_t scene_id, window_mode_t mode, uint8_t gap_percentage)
+{
+    if (mode > WINDOW_MODE_VENT || gap_percentage > 100) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    int index = scene_table_find(group_id, scene_id);
+    if (index < 0) {
+        if (scene_count >= SCENE_TABLE_SIZE) {
+            ESP_LOGW(TAG, "Таблица сцен заполнена");
+            return ESP_ERR_NO_MEM;
+        }
+        index = scene_count;
+    } else if (scenes[index].window_mode == mode && scenes[index].gap_percentage == gap_percentage) {
+        // Содержимое сцены не изменилось - запись во флеш не нужна
+        return ESP_OK;
+    }
+    
+    scene_entry_t entry = {
+        .group_id = group_id,
+        .scene_id = scene_id,
+        .window_mode = (uint8_t)mode,
+        .gap_percentage = gap_percentage
+    };
+    
+    taskENTER_CRITICAL(&scenes_lock);
+    scenes[index] = entry;
+    if (index == scene_count) {
+        scene_count++;
+    }
+    taskEXIT_CRITICAL(&scenes_lock);
+    
+    ESP_LOGI(TAG, "Сохранена сцена %d группы 0x%04X: режим=%d, зазор=%d%%", 
+             scene_id, group_id, mode, gap_percentage);
+    
+    return scene_table_save();
+}
+
+/**
+ * @brief Поиск сцены
+ */
+esp_err_t scene_table_recall(uint16_t group_id, uint8_t scene_id, window_mode_t *mode, uint8_t *gap_percentage)
+{
+    if (mode == NULL || gap_percentage == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    int index = scene_table_find(group_id, scene_id);
+    if (index < 0) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    
+    *mode = (window_mode_t)scenes[index].window_mode;
+    *gap_percentage = scenes[index].gap_percentage;
+    
+    return ESP_OK;
+}
+
+/**
+ * @brief Проверка наличия сцены
+ */
+bool scene_table_contains(uint16_t group_id, uint8_t scene_id)
+{
+    taskENTER_CRITICAL(&scenes_lock);
+    bool found = scene_table_find(group_id, scene_id) >= 0;
+    taskEXIT_CRITICAL(&scenes_lock);
+    
+    return found;
+}
+
+/**
+ * @brief Удаление сцены
+ */
+esp_err_t scene_table_remove(uint16_t group_id, uint8_t scene_id)
+{
+    int index = scene_table_find(group_id, scene_id);
+    if (index < 0) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    
+    // Сдвигаем хвост таблицы на место удаленной записи
+    taskENTER_CRITICAL(&scenes_lock);
+    memmove(&scenes[index], &scenes[index + 1], (scene_count - index - 1) * sizeof(scene_entry_t));
+    scene_count--;
+    taskEXIT_CRITICAL(&scenes_lock);
+    
+    return scene_table_save();
+}
+
+/**
+ * @brief Удаление всех сцен группы
+ */
+esp_err_t scene_table_remove_group(uint16_t group_id)
+{
+    uint8_t kept = 0;
+    
+    taskENTER_CRITICAL(&scenes_lock);
+    uint8_t count = scene_count;
+    for (int i = 0; i < count; i++) {
+        if (scenes[i].group_id != group_id) {
+            scenes[kept++] = scenes[i];
+        }
+    }
+    scene_count = kept;
+    taskEXIT_CRITICAL(&scenes_lock);
+    
+    if (kept == count) {
+        return ESP_OK;
+    }
+    
+    return scene_table_save();
+}
@@ -0,0 +1,76 @@
+/**
+ * @file scene_table.h
+ * @brief Таблица сцен ZigBee (кластер Scenes) для умного окна
+ */
+
+#ifndef SCENE_TABLE_H
+#define SCENE_TABLE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "servo_control.h"
+
+/**
+ * @brief Максимальное количество сцен в таблице
+ */
+#define SCENE_TABLE_SIZE 16
+
+/**
+ * @brief Инициализация таблицы сцен и загрузка ее из NVS
+ * 
+ * @return esp_err_t ESP_OK при успешной инициализации
+ */
+esp_err_t scene_table_init(void);
+
+/**
+ * @brief Сохранение сцены (существующая сцена перезаписывается)
+ * 
+ * @param group_id Идентификатор группы
+ * @param scene_id Идентификатор сцены
+ * @param mode Режим окна
+ * @param gap_percentage Процент открытия зазора
+ * @return esp_err_t ESP_OK при успешном сохранении, ESP_ERR_NO_MEM если таблица заполнена
+ */
+esp_err_t scene_table_store(uint16_t group_id, uint8_t scene_id, window_mode_t mode, uint8_t gap_percentage);
+
+/**
+ * @brief Поиск сцены
+ * 
+ * @param group_id Идентификатор группы
+ * @param scene_id Идентификатор сцены
+ * @param mode Указатель для записи режима окна
+ * @param gap_percentage Указатель для записи процента открытия зазора
+ * @return esp_err_t ESP_OK если сцена найдена, ESP_ERR_NOT_FOUND в противном случае
+ */
+esp_err_t scene_table_recall(uint16_t group_id, uint8_t scene_id, window_mode_t *mode, uint8_t *gap_percentage);
+
+/**
+ * @brief Проверка наличия сцены
+ * 
+ * Может вызываться из контекста стека ZigBee одновременно с изменением таблицы.
+ * 
+ * @param group_id Идентификатор группы
+ * @param scene_id Идентификатор сцены
+ * @return bool true, если сцена есть в таблице
+ */
+bool scene_table_contains(uint16_t group_id, uint8_t scene_id);
+
+/**
+ * @brief Удаление сцены
+ * 
+ * @param group_id Идентификатор группы
+ * @param scene_id Идентификатор сцены
+ * @return esp_err_t ESP_OK при успешном удалении, ESP_ERR_NOT_FOUND если сцены нет
+ */
+esp_err_t scene_table_remove(uint16_t group_id, uint8_t scene_id);
+
+/**
+ * @brief Удаление всех сцен группы
+ * 
+ * @param group_id Идентификатор группы
+ * @return esp_err_t ESP_OK при успешном удалении
+ */
+esp_err_t scene_table_remove_group(uint16_t group_id);
+
+#endif /* SCENE_TABLE_H */
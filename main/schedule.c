@@ -0,0 +1,355 @@
+/**
+ * @file schedule.c
+ * @brief Реализация локального расписания умного окна
+ */
+
+#include "schedule.h"
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
+
+static const char *TAG = "SCHEDULE";
+
+// Хранение расписания в NVS одним блобом
+#define SCHEDULE_NVS_NAMESPACE "schedule"
+#define SCHEDULE_NVS_KEY_TABLE "table"
+
+#define SECONDS_PER_DAY 86400
+
+// 2000-01-01 (начало отсчета времени ZigBee) - суббота
+#define EPOCH_WEEKDAY 5
+
+// Запись расписания (5 байт)
+typedef struct __attribute__((packed)) {
+    uint8_t weekdays;         // Маска дней недели (0 - запись свободна)
+    uint16_t minute_of_day;   // Время срабатывания в минутах от полуночи
+    uint8_t window_mode;      // Режим окна
+    uint8_t gap_percentage;   // Процент открытия зазора
+} schedule_entry_t;
+
+// Таблица расписания: индекс записи задается хабом
+static schedule_entry_t entries[SCHEDULE_SIZE];
+
+// Контекст расписания
+static struct {
+    schedule_due_cb_t due_cb;       // Колбэк наступления срока
+    esp_timer_handle_t timer;       // Одиночный таймер ближайшей записи
+    bool time_valid;                // Часы синхронизированы
+    uint32_t sync_local_time;       // Местное время при синхронизации (с)
+    int64_t sync_timer_us;          // Показание esp_timer при синхронизации (мкс)
+    uint32_t next_due;              // Время ближайшей записи (с), 0 - нет записей
+} schedule_ctx = {
+    .due_cb = NULL,
+    .timer = NULL,
+    .time_valid = false,
+    .next_due = 0
+};
+
+/**
+ * @brief Текущее местное время в секундах от 2000-01-01
+ */
+static uint32_t schedule_now(void)
+{
+    int64_t elapsed_us = esp_timer_get_time() - schedule_ctx.sync_timer_us;
+    return schedule_ctx.sync_local_time + (uint32_t)(elapsed_us / 1000000);
+}
+
+/**
+ * @brief Ближайшее срабатывание записи строго после заданного времени
+ */
+static uint32_t schedule_next_occurrence(const schedule_entry_t *entry, uint32_t after)
+{
+    uint32_t day = after / SECONDS_PER_DAY;
+    
+    // Через неделю запись с непустой маской сработает наверняка
+    for (uint32_t d = 0; d <= 7; d++) {
+        uint8_t weekday = (day + d + EPOCH_WEEKDAY) % 7;
+        if (!(entry->weekdays & (1 << weekday))) {
+            continue;
+        }
+        
+        uint32_t time = (day + d) * SECONDS_PER_DAY + entry->minute_of_day * 60;
+        if (time > after) {
+            return time;
+        }
+    }
+    
+    return 0;
+}
+
+/**
+ * @brief Взвод таймера на ближайшую запись после заданного времени
+ */
+static void schedule_arm(uint32_t after)
+{
+    esp_timer_stop(schedule_ctx.timer);
+    schedule_ctx.next_due = 0;
+    
+    if (!schedule_ctx.time_valid) {
+        return;
+    }
+    
+    for (int i = 0; i < SCHEDULE_SIZE; i++) {
+        if (entries[i].weekdays == 0) {
+            continue;
+        }
+        
+        uint32_t time = schedule_next_occurrence(&entries[i], after);
+        if (time != 0 && (schedule_ctx.next_due == 0 || time < schedule_ctx.next_due)) {
+            schedule_ctx.next_due = time;
+        }
+    }
+    
+    if (schedule_ctx.next_due == 0) {
+        return;
+    }
+    
+    // Пропущенная запись (например, после смены времени) выполняется сразу
+    uint32_t now = schedule_now();
+    uint64_t delay_us = 0;
+    if (schedule_ctx.next_due > now) {
+        delay_us = (uint64_t)(schedule_ctx.next_due - now) * 1000000;
+    }
+    
+    esp_timer_start_once(schedule_ctx.timer, delay_us);
+    ESP_LOGI(TAG, "Следующая запись расписания через %llu с", (unsigned long long)(delay_us / 1000000));
+}
+
+/**
+ * @brief Колбэк таймера расписания
+ */
+static void schedule_timer_callback(void *arg)
+{
+    if (schedule_ctx.due_cb) {
+        schedule_ctx.due_cb();
+    }
+}
+
+/**
+ * @brief Запись расписания в NVS
+ */
+static esp_err_t schedule_save(void)
+{
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(SCHEDULE_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Ошибка открытия NVS: %s", esp_err_to_name(err));
+        return err;
+    }
+    
+    err = nvs_set_blob(handle, SCHEDULE_NVS_KEY_TABLE, entries, sizeof(entries));
+    if (err == ESP_OK) {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Ошибка сохранения расписания: %s", esp_err_to_name(err));
+    }
+    
+    return err;
+}
+
+/**
+ * @brief Инициализация расписания и загрузка его из NVS
+ */
+esp_err_t schedule_init(schedule_due_cb_t due_cb)
+{
+    schedule_ctx.due_cb = due_cb;
+    memset(entries, 0, sizeof(entries));
+    
+    esp_timer_create_args_t timer_args = {
+        .callback = &schedule_timer_callback,
+        .name = "schedule_timer"
+    };
+    
+    esp_err_t err = esp_timer_create(&timer_args, &schedule_ctx.timer);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Не удалось создать таймер расписания: %s", esp_err_to_name(err));
+        return err;
+    }
+    
+    nvs_handle_t handle;
+    err = nvs_open(SCHEDULE_NVS_NAMESPACE, NVS_READONLY, &handle);
+    if (err != ESP_OK) {
+        // Расписание еще не сохранялось
+        return ESP_OK;
+    }
+    
+    size_t size = sizeof(entries);
+    err = nvs_get_blob(handle, SCHEDULE_NVS_KEY_TABLE, entries, &size);
+    nvs_close(handle);
+    
+    if (err != ESP_OK || size != sizeof(entries)) {
+        if (err != ESP_ERR_NVS_NOT_FOUND) {
+            ESP_LOGW(TAG, "Расписание повреждено, используется пустое расписание");
+        }
+        memset(entries, 0, sizeof(entries));
+    }
+    
+    return ESP_OK;
+}
+
+/**
+ * @brief Установка текущего местного времени
+ */
+esp_err_t schedule_set_time(uint32_t local_time)
+{
+    if (schedule_ctx.time_valid) {
+        int32_t drift = (int32_t)(local_time - schedule_now());
+        ESP_LOGI(TAG, "Синхронизация времени, расхождение часов: %ld с", (long)drift);
+    }
+    
+    schedule_ctx.sync_local_time = local_time;
+    schedule_ctx.sync_timer_us = esp_timer_get_time();
+    schedule_ctx.time_valid = true;
+    
+    schedule_arm(local_time);
+    return ESP_OK;
+}
+
+/**
+ * @brief Продолжение хода часов после глубокого сна
+ */
+esp_err_t schedule_resume_time(uint32_t sleep_time, uint32_t local_time)
+{
+    if (local_time < sleep_time) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    schedule_ctx.sync_local_time = local_time;
+    schedule_ctx.sync_timer_us = esp_timer_get_time();
+    schedule_ctx.time_valid = true;
+    ESP_LOGI(TAG, "Время продолжено после сна длительностью %lu с", (unsigned long)(local_time - sleep_time));
+    
+    schedule_arm(sleep_time);
+    return ESP_OK;
+}
+
+/**
+ * @brief Время до ближайшей записи расписания
+ */
+bool schedule_get_next_due_in(uint32_t *seconds)
+{
+    uint32_t next_due = schedule_ctx.next_due;
+    if (seconds == NULL || !schedule_ctx.time_valid || next_due == 0) {
+        return false;
+    }
+    
+    uint32_t now = schedule_now();
+    *seconds = next_due > now ? next_due - now : 0;
+    return true;
+}
+
+/**
+ * @brief Проверка, синхронизированы ли часы
+ */
+bool schedule_is_time_valid(void)
+{
+    return schedule_ctx.time_valid;
+}
+
+/**
+ * @brief Получение текущего местного времени
+ */
+bool schedule_get_time(uint32_t *local_time)
+{
+    if (local_time == NULL || !schedule_ctx.time_valid) {
+        return false;
+    }
+    
+    *local_time = schedule_now();
+    return true;
+}
+
+/**
+ * @brief Запись расписания (существующая запись перезаписывается)
+ */
+esp_err_t schedule_set_entry(uint8_t index, uint8_t weekdays, uint8_t hour, uint8_t minute,
+                             window_mode_t mode, uint8_t gap_percentage)
+{
+    if (index >= SCHEDULE_SIZE || (weekdays & SCHEDULE_EVERY_DAY) == 0 ||
+        hour > 23 || minute > 59 || mode > WINDOW_MODE_VENT || gap_percentage > 100) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    schedule_entry_t entry = {
+        .weekdays = weekdays & SCHEDULE_EVERY_DAY,
+        .minute_of_day = hour * 60 + minute,
+        .window_mode = (uint8_t)mode,
+        .gap_percentage = gap_percentage
+    };
+    
+    // Содержимое записи не изменилось - запись во флеш не нужна
+    if (memcmp(&entries[index], &entry, sizeof(entry)) == 0) {
+        return ESP_OK;
+    }
+    
+    entries[index] = entry;
+    ESP_LOGI(TAG, "Запись расписания %d: дни=0x%02X, %02d:%02d, режим=%d, зазор=%d%%",
+             index, entry.weekdays, hour, minute, mode, gap_percentage);
+    
+    if (schedule_ctx.time_valid) {
+        schedule_arm(schedule_now());
+    }
+    
+    return schedule_save();
+}
+
+/**
+ * @brief Удаление записи расписания
+ */
+esp_err_t schedule_clear_entry(uint8_t index)
+{
+    if (index == SCHEDULE_ALL_ENTRIES) {
+        memset(entries, 0, sizeof(entries));
+    } else if (index < SCHEDULE_SIZE) {
+        if (entries[index].weekdays == 0) {
+            return ESP_OK;
+        }
+        memset(&entries[index], 0, sizeof(schedule_entry_t));
+    } else {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    if (schedule_ctx.time_valid) {
+        schedule_arm(schedule_now());
+    }
+    
+    return schedule_save();
+}
+
+/**
+ * @brief Выполнение записей, срок которых наступил, и перевзвод таймера
+ */
+esp_err_t schedule_run_due(schedule_action_cb_t action_cb)
+{
+    if (action_cb == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    if (!schedule_ctx.time_valid || schedule_ctx.next_due == 0) {
+        return ESP_OK;
+    }
+    
+    // Таймер мог быть взведен до синхронизации времени - срок еще не наступил
+    uint32_t now = schedule_now();
+    if (now < schedule_ctx.next_due) {
+        schedule_arm(now);
+        return ESP_OK;
+    }
+    
+    uint32_t due = schedule_ctx.next_due;
+    
+    for (int i = 0; i < SCHEDULE_SIZE; i++) {
+        if (entries[i].weekdays != 0 && schedule_next_occurrence(&entries[i], due - 1) == due) {
+            ESP_LOGI(TAG, "Выполнение записи расписания %d: режим=%d, зазор=%d%%",
+                     i, entries[i].window_mode, entries[i].gap_percentage);
+            action_cb((window_mode_t)entries[i].window_mode, entries[i].gap_percentage);
+        }
+    }
+    
+    schedule_arm(due);
+    return ESP_OK;
+}
@@ -0,0 +1,141 @@
+/**
+ * @file schedule.h
+ * @brief Локальное расписание умного окна (работает без хаба)
+ */
+
+#ifndef SCHEDULE_H
+#define SCHEDULE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "servo_control.h"
+
+/**
+ * @brief Максимальное количество записей расписания
+ */
+#define SCHEDULE_SIZE 16
+
+/**
+ * @brief Индекс для удаления всех записей расписания
+ */
+#define SCHEDULE_ALL_ENTRIES 0xFF
+
+/**
+ * @brief Дни недели (маска записи расписания)
+ */
+#define SCHEDULE_MONDAY    (1 << 0)
+#define SCHEDULE_TUESDAY   (1 << 1)
+#define SCHEDULE_WEDNESDAY (1 << 2)
+#define SCHEDULE_THURSDAY  (1 << 3)
+#define SCHEDULE_FRIDAY    (1 << 4)
+#define SCHEDULE_SATURDAY  (1 << 5)
+#define SCHEDULE_SUNDAY    (1 << 6)
+#define SCHEDULE_EVERY_DAY 0x7F
+
+/**
+ * @brief Колбэк наступления срока записи расписания
+ * 
+ * Вызывается из задачи таймеров esp_timer и должен только передать
+ * событие задаче, которая затем вызовет schedule_run_due().
+ */
+typedef void (*schedule_due_cb_t)(void);
+
+/**
+ * @brief Колбэк выполнения действия расписания
+ * 
+ * @param mode Режим окна
+ * @param gap_percentage Процент открытия зазора
+ */
+typedef void (*schedule_action_cb_t)(window_mode_t mode, uint8_t gap_percentage);
+
+/**
+ * @brief Инициализация расписания и загрузка его из NVS
+ * 
+ * Все функции модуля, кроме due_cb, вызываются из одной задачи.
+ * 
+ * @param due_cb Колбэк наступления срока записи
+ * @return esp_err_t ESP_OK при успешной инициализации
+ */
+esp_err_t schedule_init(schedule_due_cb_t due_cb);
+
+/**
+ * @brief Установка текущего местного времени
+ * 
+ * Таймер перевзводится на ближайшую запись с учетом нового времени.
+ * 
+ * @param local_time Местное время в секундах от 2000-01-01 00:00
+ * @return esp_err_t ESP_OK при успешной установке
+ */
+esp_err_t schedule_set_time(uint32_t local_time);
+
+/**
+ * @brief Продолжение хода часов после глубокого сна
+ * 
+ * Время берется из копии в RTC-памяти без запроса к хабу. Таймер
+ * взводится на запись после момента засыпания, поэтому запись, срок
+ * которой наступил во время сна, выполняется сразу.
+ * 
+ * @param sleep_time Местное время на момент сна (с)
+ * @param local_time Текущее местное время (с)
+ * @return esp_err_t ESP_ERR_INVALID_ARG, если текущее время раньше момента сна
+ */
+esp_err_t schedule_resume_time(uint32_t sleep_time, uint32_t local_time);
+
+/**
+ * @brief Время до ближайшей записи расписания
+ * 
+ * Используется перед глубоким сном для пробуждения по таймеру; может
+ * вызываться из любой задачи.
+ * 
+ * @param seconds Указатель для записи времени до срока (0 - срок наступил)
+ * @return bool false, если часы не синхронизированы или записей нет
+ */
+bool schedule_get_next_due_in(uint32_t *seconds);
+
+/**
+ * @brief Проверка, синхронизированы ли часы
+ * 
+ * @return bool true, если время было установлено
+ */
+bool schedule_is_time_valid(void);
+
+/**
+ * @brief Получение текущего местного времени
+ * 
+ * @param local_time Указатель для записи времени в секундах от 2000-01-01 00:00
+ * @return bool false, если часы еще не синхронизированы
+ */
+bool schedule_get_time(uint32_t *local_time);
+
+/**
+ * @brief Запись расписания (существующая запись перезаписывается)
+ * 
+ * @param index Индекс записи (0 - SCHEDULE_SIZE-1)
+ * @param weekdays Маска дней недели (SCHEDULE_MONDAY...)
+ * @param hour Час (0-23)
+ * @param minute Минута (0-59)
+ * @param mode Режим окна
+ * @param gap_percentage Процент открытия зазора (0-100)
+ * @return esp_err_t ESP_OK при успешной записи
+ */
+esp_err_t schedule_set_entry(uint8_t index, uint8_t weekdays, uint8_t hour, uint8_t minute,
+                             window_mode_t mode, uint8_t gap_percentage);
+
+/**
+ * @brief Удаление записи расписания
+ * 
+ * @param index Индекс записи или SCHEDULE_ALL_ENTRIES
+ * @return esp_err_t ESP_OK при успешном удалении
+ */
+esp_err_t schedule_clear_entry(uint8_t index);
+
+/**
+ * @brief Выполнение записей, срок которых наступил, и перевзвод таймера
+ * 
+ * @param action_cb Колбэк выполнения действия
+ * @return esp_err_t ESP_OK при успешном выполнении
+ */
+esp_err_t schedule_run_due(schedule_action_cb_t action_cb);
+
+#endif /* SCHEDULE_H */
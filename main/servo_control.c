@@ -4,6 +4,7 @@
  */
 
 #include "servo_control.h"
+#include "device_config.h"
 #include "esp_log.h"
 #include "driver/mcpwm_prelude.h"
 #include "driver/gpio.h"
@@ -22,16 +23,12 @@ static const char* TAG = "SERVO_CONTROL";
 #define SERVO_MAX_PULSEWIDTH_US 2500  // Максимальная длительность импульса в микросекундах
 #define SERVO_FREQUENCY         50    // Частота PWM (50Hz для большинства сервоприводов)
 
-// Задержка плавного движения сервопривода (мс)
-#define SERVO_SMOOTH_DELAY_MS   15
-
-// Максимальное значение датчика тока для обнаружения сопротивления
-#define DEFAULT_RESISTANCE_THRESHOLD 2000
-
-// Углы поворота для разных режимов
+// Угол закрытого положения (углы открытия и проветривания, задержка плавного
+// движения и порог сопротивления настраиваются, см. device_config.h)
 #define ANGLE_CLOSED 0    // Закрыто - 0 градусов
-#define ANGLE_OPEN   90   // Открыто - 90 градусов
-#define ANGLE_VENT   180  // Проветривание - 180 градусов
+
+// Угол полностью открытого зазора
+#define ANGLE_GAP_MAX 90
 
 // Определения для ADC измерения тока
 #define SERVO_CURRENT_ADC_UNIT     ADC_UNIT_1           // Блок АЦП (ADC1)
@@ -54,10 +51,8 @@ typedef struct {
 // Переменные состояния
 static servo_t handle_servo = {0};              // Сервопривод ручки
 static servo_t gap_servo = {0};                 // Сервопривод зазора
-static window_mode_t current_window_mode = WINDOW_MODE_CLOSED;  // Текущий режим окна
-static uint8_t current_gap_percentage = 0;                      // Текущий процент зазора
-static uint16_t resistance_threshold = DEFAULT_RESISTANCE_THRESHOLD; // Порог сопротивления
 static bool resistance_detected = false;                        // Флаг обнаружения сопротивления
+static servo_motion_start_cb_t motion_start_cb = NULL;          // Функция начала движения
 
 // Добавляем переменные для ADC
 static adc_oneshot_unit_handle_t adc1_handle;
@@ -65,29 +60,46 @@ static adc_cali_handle_t adc1_cali_handle;
 static bool adc_cali_enabled = false;
 
 // Прототипы вспомогательных функций
-static esp_err_t setup_servo(servo_t *servo, uint8_t gpio_pin);
+static esp_err_t setup_servo(servo_t *servo, uint8_t gpio_pin, uint8_t initial_angle);
 static esp_err_t set_servo_angle(servo_t *servo, int angle);
 static esp_err_t move_servo_smooth(servo_t *servo, int target_angle);
 
 /**
  * @brief Инициализация сервоприводов
  */
-esp_err_t servo_init(uint8_t handle_servo_pin, uint8_t gap_servo_pin)
+esp_err_t servo_init(uint8_t handle_servo_pin, uint8_t gap_servo_pin, const servo_position_t *position)
 {
     ESP_LOGI(TAG, "Инициализация сервоприводов: ручка на пине %d, зазор на пине %d", 
              handle_servo_pin, gap_servo_pin);
     
+    // Без известного положения сервоприводы начинают с закрытого окна
+    servo_position_t initial = {
+        .mode = WINDOW_MODE_CLOSED,
+        .gap_percentage = 0,
+        .handle_angle = ANGLE_CLOSED,
+        .gap_angle = 0
+    };
+    if (position != NULL) {
+        if (position->mode > WINDOW_MODE_VENT || position->gap_percentage > 100) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        initial = *position;
+    }
+    
+    ESP_LOGI(TAG, "Начальное положение: режим %d, ручка %d°, зазор %d°",
+             initial.mode, initial.handle_angle, initial.gap_angle);
+    
     esp_err_t ret;
     
     // Инициализация сервопривода ручки
-    ret = setup_servo(&handle_servo, handle_servo_pin);
+    ret = setup_servo(&handle_servo, handle_servo_pin, initial.handle_angle);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Ошибка инициализации сервопривода ручки");
         return ret;
     }
     
     // Инициализация сервопривода зазора
-    ret = setup_servo(&gap_servo, gap_servo_pin);
+    ret = setup_servo(&gap_servo, gap_servo_pin, initial.gap_angle);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Ошибка инициализации сервопривода зазора");
         return ret;
@@ -100,9 +112,6 @@ esp_err_t servo_init(uint8_t handle_servo_pin, uint8_t gap_servo_pin)
         // Продолжаем работу, но без функции измерения тока
     }
     
-    // Установка начальных значений
-    current_window_mode = WINDOW_MODE_CLOSED;
-    current_gap_percentage = 0;
     resistance_detected = false;
     
     ESP_LOGI(TAG, "Сервоприводы успешно инициализированы");
@@ -112,12 +121,12 @@ esp_err_t servo_init(uint8_t handle_servo_pin, uint8_t gap_servo_pin)
 /**
  * @brief Настройка одного сервопривода
  */
-static esp_err_t setup_servo(servo_t *servo, uint8_t gpio_pin)
+static esp_err_t setup_servo(servo_t *servo, uint8_t gpio_pin, uint8_t initial_angle)
 {
     // Сохраняем пин GPIO
     servo->gpio_pin = gpio_pin;
-    servo->current_angle = 0;
-    servo->target_angle = 0;
+    servo->current_angle = initial_angle;
+    servo->target_angle = initial_angle;
     servo->is_enabled = false;
     
     // Настройка таймера
@@ -166,16 +175,16 @@ static esp_err_t setup_servo(servo_t *servo, uint8_t gpio_pin)
         MCPWM_GEN_COMPARE_EVENT_ACTION(MCPWM_TIMER_DIRECTION_UP, servo->comparator, MCPWM_GEN_ACTION_LOW)),
         TAG, "Ошибка установки действия LOW");
     
+    // Отмечаем, что сервопривод включен
+    servo->is_enabled = true;
+    
+    // Первый импульс сразу задает сохраненный угол, сервопривод не возвращается в 0 градусов
+    ESP_RETURN_ON_ERROR(set_servo_angle(servo, initial_angle), TAG, "Ошибка установки начального угла");
+    
     // Запуск таймера
     ESP_RETURN_ON_ERROR(mcpwm_timer_enable(servo->timer), TAG, "Ошибка включения таймера");
     ESP_RETURN_ON_ERROR(mcpwm_timer_start_stop(servo->timer, MCPWM_TIMER_START), TAG, "Ошибка запуска таймера");
     
-    // Установка начального положения в 0 градусов
-    set_servo_angle(servo, 0);
-    
-    // Отмечаем, что сервопривод включен
-    servo->is_enabled = true;
-    
     return ESP_OK;
 }
 
@@ -223,9 +232,16 @@ static esp_err_t move_servo_smooth(servo_t *servo, int target_angle)
     // Текущий угол
     int current = servo->current_angle;
     
+    // Скорость движения задается паузой между шагами в 1 градус
+    TickType_t step_delay = pdMS_TO_TICKS(device_config_get(CONFIG_KEY_SERVO_STEP_DELAY_MS));
+    
     // Плавное перемещение
     ESP_LOGI(TAG, "Плавное перемещение сервопривода от %d° к %d°", current, target_angle);
     
+    if (current != target_angle && motion_start_cb != NULL) {
+        motion_start_cb();
+    }
+    
     if (current < target_angle) {
         // Увеличение угла
         for (int angle = current; angle <= target_angle; angle++) {
@@ -238,7 +254,7 @@ static esp_err_t move_servo_smooth(servo_t *servo, int target_angle)
                 return ESP_ERR_TIMEOUT;
             }
             
-            vTaskDelay(pdMS_TO_TICKS(SERVO_SMOOTH_DELAY_MS));
+            vTaskDelay(step_delay);
         }
     } else if (current > target_angle) {
         // Уменьшение угла
@@ -252,7 +268,7 @@ static esp_err_t move_servo_smooth(servo_t *servo, int target_angle)
                 return ESP_ERR_TIMEOUT;
             }
             
-            vTaskDelay(pdMS_TO_TICKS(SERVO_SMOOTH_DELAY_MS));
+            vTaskDelay(step_delay);
         }
     }
     
@@ -277,10 +293,10 @@ esp_err_t servo_set_window_mode(window_mode_t mode)
             target_angle = ANGLE_CLOSED;
             break;
         case WINDOW_MODE_OPEN:
-            target_angle = ANGLE_OPEN;
+            target_angle = device_config_get(CONFIG_KEY_ANGLE_OPEN);
             break;
         case WINDOW_MODE_VENT:
-            target_angle = ANGLE_VENT;
+            target_angle = device_config_get(CONFIG_KEY_ANGLE_VENT);
             break;
         default:
             ESP_LOGE(TAG, "Неизвестный режим окна: %d", mode);
@@ -290,15 +306,9 @@ esp_err_t servo_set_window_mode(window_mode_t mode)
     // Плавное перемещение к целевому углу
     esp_err_t ret = move_servo_smooth(&handle_servo, target_angle);
     
-    // Если режим окна изменился успешно, обновляем текущий режим
-    if (ret == ESP_OK) {
-        current_window_mode = mode;
-        
-        // Если окно закрыто, устанавливаем зазор в 0
-        if (mode == WINDOW_MODE_CLOSED) {
-            current_gap_percentage = 0;
-            move_servo_smooth(&gap_servo, 0);
-        }
+    // Если окно закрыто, устанавливаем зазор в 0
+    if (ret == ESP_OK && mode == WINDOW_MODE_CLOSED) {
+        move_servo_smooth(&gap_servo, 0);
     }
     
     return ret;
@@ -311,8 +321,8 @@ esp_err_t servo_set_gap(uint8_t percentage)
 {
     ESP_LOGI(TAG, "Установка зазора окна: %d%%", percentage);
     
-    // Проверка, что окно в режиме открыто
-    if (current_window_mode != WINDOW_MODE_OPEN) {
+    // Проверка, что ручка в положении открыто (режим окна хранит модуль состояния)
+    if (handle_servo.current_angle != (int)device_config_get(CONFIG_KEY_ANGLE_OPEN)) {
         ESP_LOGW(TAG, "Настройка зазора доступна только в режиме OPEN");
         return ESP_ERR_INVALID_STATE;
     }
@@ -323,33 +333,58 @@ esp_err_t servo_set_gap(uint8_t percentage)
     }
     
     // Преобразование процента в угол (0-90 градусов)
-    int target_angle = percentage * 90 / 100;
+    int target_angle = percentage * ANGLE_GAP_MAX / 100;
     
     // Плавное перемещение к целевому углу
-    esp_err_t ret = move_servo_smooth(&gap_servo, target_angle);
-    
-    // Если зазор изменился успешно, обновляем текущий процент
-    if (ret == ESP_OK) {
-        current_gap_percentage = percentage;
-    }
-    
-    return ret;
+    return move_servo_smooth(&gap_servo, target_angle);
 }
 
 /**
- * @brief Получение текущего режима окна
+ * @brief Получение текущего угла сервопривода ручки
  */
-window_mode_t servo_get_window_mode(void)
+uint8_t servo_get_handle_angle(void)
 {
-    return current_window_mode;
+    return (uint8_t)handle_servo.current_angle;
 }
 
 /**
- * @brief Получение текущего положения зазора
+ * @brief Получение текущего угла сервопривода зазора
  */
-uint8_t servo_get_gap(void)
+uint8_t servo_get_gap_angle(void)
 {
-    return current_gap_percentage;
+    return (uint8_t)gap_servo.current_angle;
+}
+
+/**
+ * @brief Расчет углов сервоприводов для сохраненного режима и зазора
+ */
+void servo_position_from_state(window_mode_t mode, uint8_t gap_percentage, servo_position_t *position)
+{
+    if (gap_percentage > 100) {
+        gap_percentage = 100;
+    }
+    
+    position->mode = mode;
+    position->gap_percentage = gap_percentage;
+    
+    switch (mode) {
+        case WINDOW_MODE_OPEN:
+            position->handle_angle = (uint8_t)device_config_get(CONFIG_KEY_ANGLE_OPEN);
+            break;
+        case WINDOW_MODE_VENT:
+            position->handle_angle = (uint8_t)device_config_get(CONFIG_KEY_ANGLE_VENT);
+            break;
+        default:
+            position->mode = WINDOW_MODE_CLOSED;
+            position->handle_angle = ANGLE_CLOSED;
+            break;
+    }
+    
+    // В закрытом окне зазор всегда закрыт
+    if (position->mode == WINDOW_MODE_CLOSED) {
+        position->gap_percentage = 0;
+    }
+    position->gap_angle = (uint8_t)(position->gap_percentage * ANGLE_GAP_MAX / 100);
 }
 
 /**
@@ -357,8 +392,7 @@ uint8_t servo_get_gap(void)
  */
 esp_err_t servo_set_resistance_threshold(uint16_t threshold)
 {
-    resistance_threshold = threshold;
-    return ESP_OK;
+    return device_config_set(CONFIG_KEY_RESISTANCE_THRESHOLD, threshold);
 }
 
 /**
@@ -466,6 +500,7 @@ bool servo_check_resistance(void)
     }
     
     // Проверка превышения порога
+    uint16_t resistance_threshold = (uint16_t)device_config_get(CONFIG_KEY_RESISTANCE_THRESHOLD);
     if (current_value > resistance_threshold) {
         ESP_LOGW(TAG, "Обнаружено сопротивление! Значение тока: %d, порог: %d", 
                  current_value, resistance_threshold);
@@ -493,6 +528,14 @@ void servo_simulate_resistance(bool enable)
     }
 }
 
+/**
+ * @brief Регистрация функции начала движения
+ */
+void servo_set_motion_start_cb(servo_motion_start_cb_t cb)
+{
+    motion_start_cb = cb;
+}
+
 /**
  * @brief Отключение сервоприводов
  */
@@ -560,16 +603,12 @@ esp_err_t servo_calibrate(void)
     vTaskDelay(pdMS_TO_TICKS(500));
     
     // Перемещение на 90 градусов
-    ESP_RETURN_ON_ERROR(move_servo_smooth(&gap_servo, 90), TAG, "Ошибка калибровки на 90°");
+    ESP_RETURN_ON_ERROR(move_servo_smooth(&gap_servo, ANGLE_GAP_MAX), TAG, "Ошибка калибровки на 90°");
     vTaskDelay(pdMS_TO_TICKS(500));
     
     // Возврат на 0 градусов
     ESP_RETURN_ON_ERROR(move_servo_smooth(&gap_servo, 0), TAG, "Ошибка возврата на 0°");
     
-    // Устанавливаем режим окна и зазор
-    current_window_mode = WINDOW_MODE_CLOSED;
-    current_gap_percentage = 0;
-    
     ESP_LOGI(TAG, "Калибровка завершена успешно");
     
     return ESP_OK;
@@ -19,14 +19,44 @@ typedef enum {
     WINDOW_MODE_VENT = 2     ///< Окно в режиме проветривания (поворот на 180 градусов)
 } window_mode_t;
 
+/**
+ * @brief Положение окна и углы сервоприводов
+ */
+typedef struct {
+    window_mode_t mode;         ///< Режим окна
+    uint8_t gap_percentage;     ///< Процент открытия зазора (0-100)
+    uint8_t handle_angle;       ///< Угол сервопривода ручки (градусы)
+    uint8_t gap_angle;          ///< Угол сервопривода зазора (градусы)
+} servo_position_t;
+
+/**
+ * @brief Функция, вызываемая перед первым шагом движения сервопривода
+ */
+typedef void (*servo_motion_start_cb_t)(void);
+
 /**
  * @brief Инициализация сервоприводов
  * 
+ * ШИМ запускается сразу с углами начального положения, поэтому после
+ * перезагрузки окно остается в сохраненном положении без движения.
+ * 
  * @param handle_servo_pin Пин GPIO для сервопривода управления ручкой
  * @param gap_servo_pin Пин GPIO для сервопривода управления зазором
+ * @param position Начальное положение (NULL - закрытое окно)
  * @return esp_err_t ESP_OK при успешной инициализации
  */
-esp_err_t servo_init(uint8_t handle_servo_pin, uint8_t gap_servo_pin);
+esp_err_t servo_init(uint8_t handle_servo_pin, uint8_t gap_servo_pin, const servo_position_t *position);
+
+/**
+ * @brief Расчет углов сервоприводов для сохраненного режима и зазора
+ * 
+ * Используется при холодном запуске, когда известны только режим и зазор.
+ * 
+ * @param mode Режим окна
+ * @param gap_percentage Процент открытия зазора (0-100)
+ * @param position Указатель для записи положения
+ */
+void servo_position_from_state(window_mode_t mode, uint8_t gap_percentage, servo_position_t *position);
 
 /**
  * @brief Изменение режима окна
@@ -45,18 +75,18 @@ esp_err_t servo_set_window_mode(window_mode_t mode);
 esp_err_t servo_set_gap(uint8_t percentage);
 
 /**
- * @brief Получение текущего режима окна
+ * @brief Получение текущего угла сервопривода ручки
  * 
- * @return window_mode_t Текущий режим окна
+ * @return uint8_t Угол в градусах (0-180)
  */
-window_mode_t servo_get_window_mode(void);
+uint8_t servo_get_handle_angle(void);
 
 /**
- * @brief Получение текущего положения зазора
+ * @brief Получение текущего угла сервопривода зазора
  * 
- * @return uint8_t Текущий процент открытия (0-100)
+ * @return uint8_t Угол в градусах (0-90)
  */
-uint8_t servo_get_gap(void);
+uint8_t servo_get_gap_angle(void);
 
 /**
  * @brief Остановка сервоприводов при обнаружении механического сопротивления
@@ -87,6 +117,16 @@ esp_err_t servo_disable(void);
  */
 esp_err_t servo_calibrate(void);
 
+/**
+ * @brief Регистрация функции начала движения
+ * 
+ * Функция вызывается в задаче, выполняющей перемещение, перед первым шагом
+ * каждого сервопривода. Перемещение в текущий угол ее не вызывает.
+ * 
+ * @param cb Функция начала движения (NULL - не вызывать)
+ */
+void servo_set_motion_start_cb(servo_motion_start_cb_t cb);
+
 /**
  * @brief Включение режима симуляции сопротивления для тестирования
  * 
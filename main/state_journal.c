@@ -0,0 +1,479 @@
+/**
+ * @file state_journal.c
+ * @brief Реализация журнала положений окна
+ * 
+ * Первая ячейка каждого сектора занята заголовком с номером сектора по
+ * порядку заполнения, остальные - записями положения. Запись идет в
+ * последний начатый сектор; при его заполнении начинается следующий по
+ * кругу, а сектор за ним стирается заранее. Так в журнале всегда есть
+ * стертый сектор, отделяющий самые новые записи от самых старых.
+ */
+
+#include "state_journal.h"
+#include <string.h>
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+static const char *TAG = "STATE_JOURNAL";
+
+#define JOURNAL_SECTOR_MAGIC    0x314A5753  // "SWJ1"
+#define JOURNAL_CELL_SIZE       16          // Размер заголовка и записи
+#define JOURNAL_MIN_SECTORS     3           // Текущий, стертый заранее и хотя бы один с историей
+
+// Заголовок сектора
+typedef struct __attribute__((packed)) {
+    uint32_t magic;             // JOURNAL_SECTOR_MAGIC
+    uint32_t sector_sequence;   // Номер сектора по порядку заполнения
+    uint32_t reserved;          // 0xFFFFFFFF
+    uint32_t crc;               // CRC32 предыдущих полей
+} journal_sector_header_t;
+
+// Запись положения
+typedef struct __attribute__((packed)) {
+    uint32_t sequence;          // Порядковый номер записи
+    uint8_t window_mode;        // Режим окна
+    uint8_t gap_percentage;     // Процент открытия зазора
+    uint8_t handle_angle;       // Угол сервопривода ручки
+    uint8_t reserved[5];        // 0xFF
+    uint32_t crc;               // CRC32 предыдущих полей
+} journal_record_t;
+
+// Состояние журнала
+static struct {
+    bool initialized;                   // Журнал открыт
+    state_journal_flash_t flash;        // Доступ к флеш-памяти
+    uint32_t sector_count;              // Количество секторов
+    uint32_t cells_per_sector;          // Ячеек в секторе, включая заголовок
+    uint32_t head_sector;               // Сектор, в который идет запись
+    uint32_t head_sequence;             // Номер сектора head_sector (0 - журнал пуст)
+    uint32_t next_cell;                 // Следующая свободная ячейка head_sector
+    uint32_t next_sequence;             // Номер следующей записи
+    bool has_latest;                    // Есть действительная запись
+    state_journal_entry_t latest;       // Последняя запись
+    SemaphoreHandle_t lock;             // Блокировка журнала
+} journal = {
+    .initialized = false,
+    .has_latest = false,
+    .lock = NULL
+};
+
+/**
+ * @brief Смещение ячейки сектора
+ */
+static uint32_t journal_cell_offset(uint32_t sector, uint32_t cell)
+{
+    return sector * journal.flash.sector_size + cell * JOURNAL_CELL_SIZE;
+}
+
+/**
+ * @brief Чтение заголовка сектора
+ * 
+ * @return true, если заголовок действителен
+ */
+static bool journal_read_header(uint32_t sector, uint32_t *sector_sequence)
+{
+    journal_sector_header_t header;
+    
+    if (journal.flash.read(journal.flash.ctx, journal_cell_offset(sector, 0), &header, sizeof(header)) != ESP_OK) {
+        return false;
+    }
+    
+    if (header.magic != JOURNAL_SECTOR_MAGIC ||
+        header.crc != esp_rom_crc32_le(0, (const uint8_t *)&header, offsetof(journal_sector_header_t, crc))) {
+        return false;
+    }
+    
+    *sector_sequence = header.sector_sequence;
+    return true;
+}
+
+/**
+ * @brief Проверка, что ячейка не записывалась
+ */
+static bool journal_cell_erased(uint32_t sector, uint32_t cell)
+{
+    uint8_t data[JOURNAL_CELL_SIZE];
+    
+    if (journal.flash.read(journal.flash.ctx, journal_cell_offset(sector, cell), data, sizeof(data)) != ESP_OK) {
+        return false;
+    }
+    
+    for (size_t i = 0; i < sizeof(data); i++) {
+        if (data[i] != 0xFF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Проверка, что сектор полностью стерт
+ */
+static bool journal_sector_erased(uint32_t sector)
+{
+    for (uint32_t cell = 0; cell < journal.cells_per_sector; cell++) {
+        if (!journal_cell_erased(sector, cell)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Чтение записи положения
+ * 
+ * @return true, если запись действительна
+ */
+static bool journal_read_record(uint32_t sector, uint32_t cell, state_journal_entry_t *entry)
+{
+    journal_record_t record;
+    
+    if (journal.flash.read(journal.flash.ctx, journal_cell_offset(sector, cell), &record, sizeof(record)) != ESP_OK) {
+        return false;
+    }
+    
+    if (record.crc != esp_rom_crc32_le(0, (const uint8_t *)&record, offsetof(journal_record_t, crc)) ||
+        record.window_mode > WINDOW_MODE_VENT || record.gap_percentage > 100) {
+        return false;
+    }
+    
+    entry->sequence = record.sequence;
+    entry->window_mode = (window_mode_t)record.window_mode;
+    entry->gap_percentage = record.gap_percentage;
+    entry->handle_angle = record.handle_angle;
+    return true;
+}
+
+/**
+ * @brief Поиск сектора, в который шла запись
+ * 
+ * Если сектор 0 начат в текущем круге, секторы 0...head имеют возрастающие
+ * номера больше номера сектора 0, а следующие за head стерты или остались
+ * от прошлого круга с меньшими номерами - граница ищется двоичным поиском.
+ * Если сектор 0 стерт заранее, запись шла в последний сектор.
+ * 
+ * @return true, если найден хотя бы один начатый сектор
+ */
+static bool journal_find_head(uint32_t *head, uint32_t *head_sequence)
+{
+    uint32_t first_sequence;
+    uint32_t sequence;
+    
+    if (journal_read_header(0, &first_sequence)) {
+        uint32_t low = 0;
+        uint32_t high = journal.sector_count - 1;
+        
+        while (low < high) {
+            uint32_t mid = low + (high - low + 1) / 2;
+            if (journal_read_header(mid, &sequence) && sequence > first_sequence) {
+                low = mid;
+            } else {
+                high = mid - 1;
+            }
+        }
+        
+        *head = low;
+        return journal_read_header(low, head_sequence);
+    }
+    
+    if (journal_read_header(journal.sector_count - 1, &sequence)) {
+        *head = journal.sector_count - 1;
+        *head_sequence = sequence;
+        return true;
+    }
+    
+    // Раскладка не соответствует ожидаемой (например, раздел использовался ранее) -
+    // выбирается сектор с наибольшим номером
+    bool found = false;
+    for (uint32_t sector = 1; sector < journal.sector_count - 1; sector++) {
+        if (journal_read_header(sector, &sequence) && (!found || sequence > *head_sequence)) {
+            *head = sector;
+            *head_sequence = sequence;
+            found = true;
+        }
+    }
+    return found;
+}
+
+/**
+ * @brief Поиск первой свободной ячейки сектора
+ * 
+ * Ячейки заполняются по порядку, поэтому записанные (в том числе
+ * оборванные) ячейки образуют начало сектора.
+ */
+static uint32_t journal_find_free_cell(uint32_t sector)
+{
+    uint32_t low = 1;
+    uint32_t high = journal.cells_per_sector;
+    
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        if (journal_cell_erased(sector, mid)) {
+            high = mid;
+        } else {
+            low = mid + 1;
+        }
+    }
+    return low;
+}
+
+/**
+ * @brief Поиск последней действительной записи в ячейках сектора до end_cell
+ */
+static bool journal_find_latest_in(uint32_t sector, uint32_t end_cell, state_journal_entry_t *entry)
+{
+    for (uint32_t cell = end_cell; cell > 1; cell--) {
+        if (journal_read_record(sector, cell - 1, entry)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Начало нового сектора и стирание следующего за ним
+ */
+static esp_err_t journal_start_sector(uint32_t sector, uint32_t sector_sequence)
+{
+    esp_err_t err;
+    
+    // Сектор мог остаться нестертым после отключения питания во время стирания
+    if (!journal_sector_erased(sector)) {
+        err = journal.flash.erase_sector(journal.flash.ctx, journal_cell_offset(sector, 0));
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Ошибка стирания сектора %lu: %s", (unsigned long)sector, esp_err_to_name(err));
+            return err;
+        }
+    }
+    
+    journal_sector_header_t header = {
+        .magic = JOURNAL_SECTOR_MAGIC,
+        .sector_sequence = sector_sequence,
+        .reserved = 0xFFFFFFFF
+    };
+    header.crc = esp_rom_crc32_le(0, (const uint8_t *)&header, offsetof(journal_sector_header_t, crc));
+    
+    err = journal.flash.write(journal.flash.ctx, journal_cell_offset(sector, 0), &header, sizeof(header));
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Ошибка записи заголовка сектора %lu: %s", (unsigned long)sector, esp_err_to_name(err));
+        return err;
+    }
+    
+    // Стирание заранее: в следующем секторе самые старые записи
+    uint32_t next = (sector + 1) % journal.sector_count;
+    if (!journal_sector_erased(next)) {
+        err = journal.flash.erase_sector(journal.flash.ctx, journal_cell_offset(next, 0));
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Ошибка стирания сектора %lu: %s", (unsigned long)next, esp_err_to_name(err));
+        }
+    }
+    
+    return ESP_OK;
+}
+
+/**
+ * @brief Открытие журнала и поиск последней записи
+ */
+esp_err_t state_journal_init(const state_journal_flash_t *flash)
+{
+    if (flash == NULL || flash->read == NULL || flash->write == NULL || flash->erase_sector == NULL ||
+        flash->sector_size < 2 * JOURNAL_CELL_SIZE || flash->sector_size % JOURNAL_CELL_SIZE != 0 ||
+        flash->size % flash->sector_size != 0 || flash->size / flash->sector_size < JOURNAL_MIN_SECTORS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    if (journal.lock == NULL) {
+        journal.lock = xSemaphoreCreateMutex();
+        if (journal.lock == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    
+    xSemaphoreTake(journal.lock, portMAX_DELAY);
+    
+    memcpy(&journal.flash, flash, sizeof(state_journal_flash_t));
+    journal.sector_count = flash->size / flash->sector_size;
+    journal.cells_per_sector = flash->sector_size / JOURNAL_CELL_SIZE;
+    journal.has_latest = false;
+    journal.next_sequence = 1;
+    
+    uint32_t head;
+    uint32_t head_sequence;
+    
+    if (journal_find_head(&head, &head_sequence)) {
+        journal.head_sector = head;
+        journal.head_sequence = head_sequence;
+        journal.next_cell = journal_find_free_cell(head);
+        
+        // Если в текущем секторе нет целых записей, последняя запись - в предыдущем
+        journal.has_latest = journal_find_latest_in(head, journal.next_cell, &journal.latest);
+        if (!journal.has_latest) {
+            uint32_t prev = (head + journal.sector_count - 1) % journal.sector_count;
+            uint32_t prev_sequence;
+            if (journal_read_header(prev, &prev_sequence) && prev_sequence + 1 == head_sequence) {
+                journal.has_latest = journal_find_latest_in(prev, journal_find_free_cell(prev), &journal.latest);
+            }
+        }
+        
+        if (journal.has_latest) {
+            journal.next_sequence = journal.latest.sequence + 1;
+        }
+        
+        // Стирание следующего сектора могло прерваться отключением питания
+        uint32_t next = (head + 1) % journal.sector_count;
+        if (!journal_sector_erased(next)) {
+            journal.flash.erase_sector(journal.flash.ctx, journal_cell_offset(next, 0));
+        }
+    } else {
+        // Пустой журнал: первая запись начнет сектор 0
+        journal.head_sector = journal.sector_count - 1;
+        journal.head_sequence = 0;
+        journal.next_cell = journal.cells_per_sector;
+    }
+    
+    journal.initialized = true;
+    xSemaphoreGive(journal.lock);
+    
+    if (journal.has_latest) {
+        ESP_LOGI(TAG, "Журнал открыт: запись %lu, режим=%d, зазор=%d%%, сектор %lu/%lu",
+                 (unsigned long)journal.latest.sequence, journal.latest.window_mode,
+                 journal.latest.gap_percentage, (unsigned long)journal.head_sector,
+                 (unsigned long)journal.sector_count);
+    } else {
+        ESP_LOGI(TAG, "Журнал открыт: записей нет");
+    }
+    
+    return ESP_OK;
+}
+
+/**
+ * @brief Чтение из раздела журнала
+ */
+static esp_err_t journal_partition_read(void *ctx, uint32_t offset, void *data, size_t len)
+{
+    return esp_partition_read((const esp_partition_t *)ctx, offset, data, len);
+}
+
+/**
+ * @brief Запись в раздел журнала
+ */
+static esp_err_t journal_partition_write(void *ctx, uint32_t offset, const void *data, size_t len)
+{
+    return esp_partition_write((const esp_partition_t *)ctx, offset, data, len);
+}
+
+/**
+ * @brief Стирание сектора раздела журнала
+ */
+static esp_err_t journal_partition_erase_sector(void *ctx, uint32_t offset)
+{
+    const esp_partition_t *partition = (const esp_partition_t *)ctx;
+    return esp_partition_erase_range(partition, offset, partition->erase_size);
+}
+
+/**
+ * @brief Открытие журнала в разделе флеш-памяти
+ */
+esp_err_t state_journal_init_partition(const char *label)
+{
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                                                ESP_PARTITION_SUBTYPE_ANY, label);
+    if (partition == NULL) {
+        ESP_LOGW(TAG, "Раздел журнала \"%s\" не найден", label);
+        return ESP_ERR_NOT_FOUND;
+    }
+    
+    state_journal_flash_t flash = {
+        .read = journal_partition_read,
+        .write = journal_partition_write,
+        .erase_sector = journal_partition_erase_sector,
+        .ctx = (void *)partition,
+        .size = partition->size,
+        .sector_size = partition->erase_size
+    };
+    
+    return state_journal_init(&flash);
+}
+
+/**
+ * @brief Добавление записи о положении окна
+ */
+esp_err_t state_journal_append(window_mode_t mode, uint8_t gap_percentage, uint8_t handle_angle)
+{
+    if (!journal.initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    xSemaphoreTake(journal.lock, portMAX_DELAY);
+    
+    esp_err_t err;
+    
+    // Текущий сектор заполнен - переход к следующему по кругу
+    if (journal.next_cell >= journal.cells_per_sector) {
+        uint32_t sector = (journal.head_sector + 1) % journal.sector_count;
+        err = journal_start_sector(sector, journal.head_sequence + 1);
+        if (err != ESP_OK) {
+            xSemaphoreGive(journal.lock);
+            return err;
+        }
+        
+        journal.head_sector = sector;
+        journal.head_sequence++;
+        journal.next_cell = 1;
+    }
+    
+    journal_record_t record = {
+        .sequence = journal.next_sequence,
+        .window_mode = (uint8_t)mode,
+        .gap_percentage = gap_percentage,
+        .handle_angle = handle_angle,
+        .reserved = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF }
+    };
+    record.crc = esp_rom_crc32_le(0, (const uint8_t *)&record, offsetof(journal_record_t, crc));
+    
+    err = journal.flash.write(journal.flash.ctx, journal_cell_offset(journal.head_sector, journal.next_cell),
+                              &record, sizeof(record));
+    
+    // Ячейка могла быть записана частично, поэтому повторно не используется
+    journal.next_cell++;
+    
+    if (err == ESP_OK) {
+        journal.latest.sequence = record.sequence;
+        journal.latest.window_mode = mode;
+        journal.latest.gap_percentage = gap_percentage;
+        journal.latest.handle_angle = handle_angle;
+        journal.has_latest = true;
+        journal.next_sequence++;
+    } else {
+        ESP_LOGE(TAG, "Ошибка записи в журнал: %s", esp_err_to_name(err));
+    }
+    
+    xSemaphoreGive(journal.lock);
+    return err;
+}
+
+/**
+ * @brief Получение последней записи журнала
+ */
+esp_err_t state_journal_get_latest(state_journal_entry_t *entry)
+{
+    if (entry == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    if (!journal.initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    xSemaphoreTake(journal.lock, portMAX_DELAY);
+    bool found = journal.has_latest;
+    if (found) {
+        *entry = journal.latest;
+    }
+    xSemaphoreGive(journal.lock);
+    
+    return found ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
@@ -0,0 +1,86 @@
+/**
+ * @file state_journal.h
+ * @brief Журнал положений окна в отдельном разделе флеш-памяти
+ * 
+ * Каждое изменение положения дописывается записью фиксированного размера.
+ * Секторы используются по кругу, следующий сектор стирается заранее,
+ * поэтому запись положения не требует стирания и не изнашивает NVS.
+ */
+
+#ifndef STATE_JOURNAL_H
+#define STATE_JOURNAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "servo_control.h"
+
+/**
+ * @brief Метка раздела журнала в таблице разделов
+ */
+#define STATE_JOURNAL_PARTITION_LABEL "journal"
+
+/**
+ * @brief Доступ к флеш-памяти журнала
+ * 
+ * Смещения отсчитываются от начала области журнала. Запись может только
+ * сбрасывать биты, стирание переводит сектор в 0xFF.
+ */
+typedef struct {
+    esp_err_t (*read)(void *ctx, uint32_t offset, void *data, size_t len);          ///< Чтение
+    esp_err_t (*write)(void *ctx, uint32_t offset, const void *data, size_t len);   ///< Запись
+    esp_err_t (*erase_sector)(void *ctx, uint32_t offset);                           ///< Стирание сектора
+    void *ctx;                  ///< Контекст, передаваемый в функции доступа
+    uint32_t size;              ///< Размер области журнала (кратен sector_size)
+    uint32_t sector_size;       ///< Размер сектора стирания
+} state_journal_flash_t;
+
+/**
+ * @brief Запись журнала
+ */
+typedef struct {
+    uint32_t sequence;          ///< Порядковый номер записи
+    window_mode_t window_mode;  ///< Режим окна
+    uint8_t gap_percentage;     ///< Процент открытия зазора
+    uint8_t handle_angle;       ///< Угол сервопривода ручки (градусы)
+} state_journal_entry_t;
+
+/**
+ * @brief Открытие журнала и поиск последней записи
+ * 
+ * Структура flash копируется. Последняя действительная запись находится
+ * двоичным поиском по заголовкам секторов и по записям в последнем секторе;
+ * записи, оборванные отключением питания, отбрасываются по CRC32.
+ * 
+ * @param flash Доступ к флеш-памяти (не менее трех секторов)
+ * @return esp_err_t ESP_OK при успешном открытии
+ */
+esp_err_t state_journal_init(const state_journal_flash_t *flash);
+
+/**
+ * @brief Открытие журнала в разделе флеш-памяти
+ * 
+ * @param label Метка раздела данных
+ * @return esp_err_t ESP_ERR_NOT_FOUND, если раздела нет в таблице разделов
+ */
+esp_err_t state_journal_init_partition(const char *label);
+
+/**
+ * @brief Добавление записи о положении окна
+ * 
+ * @param mode Режим окна
+ * @param gap_percentage Процент открытия зазора
+ * @param handle_angle Угол сервопривода ручки (градусы)
+ * @return esp_err_t ESP_OK при успешной записи
+ */
+esp_err_t state_journal_append(window_mode_t mode, uint8_t gap_percentage, uint8_t handle_angle);
+
+/**
+ * @brief Получение последней записи журнала
+ * 
+ * @param entry Указатель для записи
+ * @return esp_err_t ESP_ERR_NOT_FOUND, если журнал пуст
+ */
+esp_err_t state_journal_get_latest(state_journal_entry_t *entry);
+
+#endif /* STATE_JOURNAL_H */
@@ -4,22 +4,75 @@
  */
 
 #include "state_management.h"
+#include "state_journal.h"
+#include "seqlock.h"
+#include "event_bus.h"
 #include "esp_log.h"
 #include "nvs_flash.h"
 #include "nvs.h"
+#include <stddef.h>
 #include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_rom_crc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
 
 // Определение тега для логов
 static const char* TAG = "STATE_MGMT";
 
+// Параметры отложенной записи
+#define STATE_PERSIST_DEBOUNCE_MS    2000    // Пауза без изменений перед записью
+#define STATE_PERSIST_MAX_DELAY_MS   30000   // Максимальная задержка записи при непрерывных изменениях
+#define STATE_PERSIST_TASK_PRIORITY  1       // Ниже всех задач устройства
+#define STATE_PERSIST_STACK_SIZE     2048
+
+// Биты измененных полей
+#define STATE_DIRTY_WINDOW_MODE      (1 << 0)
+#define STATE_DIRTY_GAP_PERCENTAGE   (1 << 1)
+#define STATE_DIRTY_CALIBRATED       (1 << 2)
+#define STATE_DIRTY_HOOKS            (1 << 3)    // Данные модулей, записываемые вместе с состоянием
+
+// Максимальное число модулей, записывающих данные вместе с состоянием
+#define STATE_MAX_FLUSH_HOOKS        2
+
 // Имя пространства имен NVS для хранения состояния
 #define NVS_NAMESPACE "window_state"
 
-// Ключи для параметров в NVS
-#define NVS_KEY_WINDOW_MODE    "window_mode"
-#define NVS_KEY_GAP_PERCENTAGE "gap_pct"
-#define NVS_KEY_CALIBRATED     "calibrated"
-#define NVS_KEY_ACTIVITY_TIME  "activity_time"
+// Состояние хранится одной записью с версией и CRC32
+#define NVS_KEY_STATE          "state"
+#define STATE_RECORD_VERSION   2
+
+// Ключи устаревшего формата (одно поле - один ключ), переносятся в запись при загрузке
+#define NVS_KEY_LEGACY_WINDOW_MODE  "window_mode"
+#define NVS_KEY_LEGACY_MODE         "mode"          // Формат прошивки esp32-h2-zigbee-window
+#define NVS_KEY_LEGACY_HANDLE_POS   "handle_pos"    // Формат прошивки esp32-h2-zigbee-window
+#define NVS_KEY_LEGACY_GAP          "gap_pct"
+#define NVS_KEY_LEGACY_CALIBRATED   "calibrated"
+#define NVS_KEY_LEGACY_ACTIVITY     "activity_time"
+#define LEGACY_MODE_CUSTOM          3               // Пользовательский режим прошивки esp32-h2
+
+// Флаги записи состояния
+#define STATE_RECORD_FLAG_CALIBRATED (1 << 0)
+
+// Запись состояния в NVS
+typedef struct __attribute__((packed)) {
+    uint8_t version;            // Версия формата (STATE_RECORD_VERSION)
+    uint8_t window_mode;        // Режим окна
+    uint8_t gap_percentage;     // Процент открытия зазора
+    uint8_t flags;              // STATE_RECORD_FLAG_*
+    uint32_t journal_sequence;  // Номер последней записи журнала на момент сохранения
+    uint32_t crc;               // CRC32 предыдущих полей
+} state_record_t;
+
+// Запись версии 1 (без номера записи журнала)
+typedef struct __attribute__((packed)) {
+    uint8_t version;
+    uint8_t window_mode;
+    uint8_t gap_percentage;
+    uint8_t flags;
+    uint32_t crc;
+} state_record_v1_t;
 
 // Текущее состояние устройства
 static device_state_t current_state = {
@@ -33,6 +86,52 @@ static device_state_t current_state = {
 // Handle для NVS
 static nvs_handle_t nvs_handle;
 
+// Значения, записанные во флеш (время активности не сохраняется - оно отсчитывается от загрузки)
+static device_state_t persisted_state;
+
+// Номер записи журнала, учтенный в записи NVS
+static uint32_t persisted_journal_sequence = 0;
+
+// Измененные и еще не записанные поля
+static uint32_t dirty_mask = 0;
+static portMUX_TYPE state_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Публикация текущего состояния: писатели упорядочены state_lock,
+// читатели получают согласованный снимок без блокировки
+static seqlock_t state_seq = SEQLOCK_INITIALIZER;
+
+// Положение окна пишется в журнал, если раздел журнала есть в таблице разделов
+static bool journal_ready = false;
+
+// Положение, ожидающее записи в журнал задачей отложенной записи
+static bool journal_pending = false;
+
+// Задача отложенной записи и блокировка записи в NVS
+static TaskHandle_t persist_task = NULL;
+static SemaphoreHandle_t persist_mutex = NULL;
+
+// Функции записи данных других модулей
+static state_flush_hook_t flush_hooks[STATE_MAX_FLUSH_HOOKS];
+static int flush_hook_count = 0;
+
+// Прототипы вспомогательных функций
+static void state_mark_dirty(uint32_t fields);
+static void state_publish_begin(void);
+static void state_publish_end(void);
+static device_state_t state_snapshot(void);
+static void state_persist_position(void);
+static void state_write_journal(void);
+static void state_flush_journal(void);
+static uint32_t state_journal_sequence(void);
+static esp_err_t state_write_dirty(uint32_t dirty, const device_state_t *snapshot, uint32_t journal_sequence);
+static esp_err_t state_run_flush_hooks(void);
+static esp_err_t state_read_record(state_record_t *record);
+static esp_err_t state_migrate_legacy(state_record_t *record);
+static void state_record_seal(state_record_t *record);
+static void state_persist_task(void *pvParameter);
+static void state_shutdown_handler(void);
+static void state_on_position_changed(const event_bus_event_t *event, void *ctx);
+
 /**
  * @brief Инициализация модуля управления состоянием
  */
@@ -49,60 +148,124 @@ esp_err_t state_init(void)
     
     // Инициализация текущего времени последней активности
     current_state.last_activity_time = esp_timer_get_time() / 1000; // мс
+    persisted_state = current_state;
+    
+    // Журнал положений (без него положение сохраняется в NVS)
+    journal_ready = (state_journal_init_partition(STATE_JOURNAL_PARTITION_LABEL) == ESP_OK);
+    if (!journal_ready) {
+        ESP_LOGW(TAG, "Журнал положений недоступен, положение сохраняется в NVS");
+    }
+    
+    persist_mutex = xSemaphoreCreateMutex();
+    if (persist_mutex == NULL) {
+        ESP_LOGE(TAG, "Не удалось создать мьютекс записи состояния");
+        nvs_close(nvs_handle);
+        return ESP_ERR_NO_MEM;
+    }
+    
+    // Изменения записываются низкоприоритетной задачей после паузы
+    if (xTaskCreate(state_persist_task, "state_persist", STATE_PERSIST_STACK_SIZE, NULL,
+                    STATE_PERSIST_TASK_PRIORITY, &persist_task) != pdPASS) {
+        ESP_LOGE(TAG, "Не удалось создать задачу записи состояния");
+        vSemaphoreDelete(persist_mutex);
+        persist_mutex = NULL;
+        nvs_close(nvs_handle);
+        return ESP_ERR_NO_MEM;
+    }
+    
+    // Несохраненные изменения записываются перед программной перезагрузкой
+    err = esp_register_shutdown_handler(state_shutdown_handler);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Не удалось зарегистрировать обработчик перезагрузки: %s", esp_err_to_name(err));
+    }
+    
+    // Новое положение окна поступает через шину событий
+    err = event_bus_subscribe(EVENT_BUS_POSITION_CHANGED, state_on_position_changed, NULL);
+    if (err != ESP_OK) {
+        return err;
+    }
     
     ESP_LOGI(TAG, "Модуль управления состоянием инициализирован");
     return ESP_OK;
 }
 
 /**
- * @brief Сохранение текущего состояния в энергонезависимую память
+ * @brief Сохранение измененных полей в энергонезависимую память
  */
 esp_err_t state_save(void)
 {
-    ESP_LOGI(TAG, "Сохранение состояния: режим=%d, зазор=%d%%, калибровка=%d", 
-            current_state.window_mode, current_state.gap_percentage, current_state.calibrated);
+    if (persist_mutex == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
     
-    esp_err_t err;
+    xSemaphoreTake(persist_mutex, portMAX_DELAY);
     
-    // Сохранение режима окна
-    err = nvs_set_u8(nvs_handle, NVS_KEY_WINDOW_MODE, (uint8_t)current_state.window_mode);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Ошибка сохранения режима окна: %s", esp_err_to_name(err));
-        return err;
-    }
+    // Ожидающее положение попадает в журнал или в снимок измененных полей
+    state_write_journal();
     
-    // Сохранение процента открытия зазора
-    err = nvs_set_u8(nvs_handle, NVS_KEY_GAP_PERCENTAGE, current_state.gap_percentage);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Ошибка сохранения процента зазора: %s", esp_err_to_name(err));
-        return err;
+    // Номер журнала читается до снимка: положение в снимке не старше
+    // записи журнала с этим номером
+    uint32_t journal_sequence = state_journal_sequence();
+    
+    // Снимок измененных полей
+    taskENTER_CRITICAL(&state_lock);
+    uint32_t dirty = dirty_mask;
+    device_state_t snapshot = current_state;
+    dirty_mask = 0;
+    taskEXIT_CRITICAL(&state_lock);
+    
+    esp_err_t err = state_write_dirty(dirty, &snapshot, journal_sequence);
+    if (err == ESP_OK && (dirty & STATE_DIRTY_HOOKS)) {
+        err = state_run_flush_hooks();
     }
     
-    // Сохранение флага калибровки
-    err = nvs_set_u8(nvs_handle, NVS_KEY_CALIBRATED, (uint8_t)(current_state.calibrated ? 1 : 0));
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Ошибка сохранения флага калибровки: %s", esp_err_to_name(err));
-        return err;
+        // Поля остаются измененными до следующей попытки
+        taskENTER_CRITICAL(&state_lock);
+        dirty_mask |= dirty;
+        taskEXIT_CRITICAL(&state_lock);
     }
     
-    // Сохранение времени последней активности
-    err = nvs_set_u32(nvs_handle, NVS_KEY_ACTIVITY_TIME, (uint32_t)current_state.last_activity_time);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Ошибка сохранения времени активности: %s", esp_err_to_name(err));
-        return err;
+    xSemaphoreGive(persist_mutex);
+    return err;
+}
+
+/**
+ * @brief Регистрация функции записи данных вместе с состоянием
+ */
+esp_err_t state_register_flush_hook(state_flush_hook_t hook)
+{
+    if (hook == NULL) {
+        return ESP_ERR_INVALID_ARG;
     }
     
-    // Запись изменений в NVS
-    err = nvs_commit(nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Ошибка фиксации изменений в NVS: %s", esp_err_to_name(err));
-        return err;
+    if (flush_hook_count >= STATE_MAX_FLUSH_HOOKS) {
+        ESP_LOGE(TAG, "Превышено число функций записи");
+        return ESP_ERR_NO_MEM;
     }
     
-    ESP_LOGI(TAG, "Состояние успешно сохранено");
+    flush_hooks[flush_hook_count++] = hook;
     return ESP_OK;
 }
 
+/**
+ * @brief Запрос отложенной записи данных зарегистрированных модулей
+ */
+void state_request_flush(void)
+{
+    state_mark_dirty(STATE_DIRTY_HOOKS);
+}
+
+/**
+ * @brief Запрос записи данных модулей перед сном или перезагрузкой
+ */
+void state_request_flush_on_save(void)
+{
+    taskENTER_CRITICAL(&state_lock);
+    dirty_mask |= STATE_DIRTY_HOOKS;
+    taskEXIT_CRITICAL(&state_lock);
+}
+
 /**
  * @brief Загрузка состояния из энергонезависимой памяти
  */
@@ -110,58 +273,74 @@ esp_err_t state_load(void)
 {
     ESP_LOGI(TAG, "Загрузка состояния из памяти");
     
-    esp_err_t err;
-    uint8_t value_u8;
-    uint32_t value_u32;
+    state_record_t record;
     
-    // Загрузка режима окна
-    err = nvs_get_u8(nvs_handle, NVS_KEY_WINDOW_MODE, &value_u8);
-    if (err == ESP_OK) {
-        // Проверка значения на допустимость
-        if (value_u8 <= WINDOW_MODE_VENT) {
-            current_state.window_mode = (window_mode_t)value_u8;
-        } else {
-            current_state.window_mode = WINDOW_MODE_CLOSED;
-        }
-    } else if (err != ESP_ERR_NVS_NOT_FOUND) {
-        ESP_LOGE(TAG, "Ошибка загрузки режима окна: %s", esp_err_to_name(err));
+    // Одно чтение записи вместо поиска каждого ключа
+    esp_err_t err = state_read_record(&record);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        err = state_migrate_legacy(&record);
     }
     
-    // Загрузка процента открытия зазора
-    err = nvs_get_u8(nvs_handle, NVS_KEY_GAP_PERCENTAGE, &value_u8);
-    if (err == ESP_OK) {
-        // Проверка значения на допустимость
-        if (value_u8 <= 100) {
-            current_state.gap_percentage = value_u8;
-        } else {
-            current_state.gap_percentage = 0;
-        }
-    } else if (err != ESP_ERR_NVS_NOT_FOUND) {
-        ESP_LOGE(TAG, "Ошибка загрузки процента зазора: %s", esp_err_to_name(err));
-    }
+    device_state_t loaded = state_snapshot();
+    uint32_t journal_sequence = 0;
     
-    // Загрузка флага калибровки
-    err = nvs_get_u8(nvs_handle, NVS_KEY_CALIBRATED, &value_u8);
     if (err == ESP_OK) {
-        current_state.calibrated = (value_u8 == 1);
+        loaded.window_mode = (window_mode_t)record.window_mode;
+        loaded.gap_percentage = record.gap_percentage;
+        loaded.calibrated = (record.flags & STATE_RECORD_FLAG_CALIBRATED) != 0;
+        journal_sequence = record.journal_sequence;
     } else if (err != ESP_ERR_NVS_NOT_FOUND) {
-        ESP_LOGE(TAG, "Ошибка загрузки флага калибровки: %s", esp_err_to_name(err));
+        // Поврежденное состояние не применяется: окно считается закрытым
+        // и некалиброванным, запись будет перезаписана при первом изменении
+        ESP_LOGE(TAG, "Сохраненное состояние отклонено: %s", esp_err_to_name(err));
     }
     
-    // Загрузка времени последней активности
-    err = nvs_get_u32(nvs_handle, NVS_KEY_ACTIVITY_TIME, &value_u32);
-    if (err == ESP_OK) {
-        current_state.last_activity_time = value_u32;
-    } else if (err != ESP_ERR_NVS_NOT_FOUND) {
-        ESP_LOGE(TAG, "Ошибка загрузки времени активности: %s", esp_err_to_name(err));
+    // Положение из журнала применяется, только если запись журнала новее записи NVS
+    // (после неудачной записи в журнал положение сохраняется только в NVS)
+    state_journal_entry_t entry;
+    if (journal_ready && state_journal_get_latest(&entry) == ESP_OK && entry.sequence > journal_sequence) {
+        loaded.window_mode = entry.window_mode;
+        loaded.gap_percentage = entry.gap_percentage;
     }
     
+    // Загруженные значения совпадают с записанными
+    state_publish_begin();
+    current_state = loaded;
+    persisted_state = loaded;
+    persisted_journal_sequence = journal_sequence;
+    dirty_mask = 0;
+    state_publish_end();
+    
     ESP_LOGI(TAG, "Загружено состояние: режим=%d, зазор=%d%%, калибровка=%d", 
-            current_state.window_mode, current_state.gap_percentage, current_state.calibrated);
+            loaded.window_mode, loaded.gap_percentage, loaded.calibrated);
             
     return ESP_OK;
 }
 
+/**
+ * @brief Восстановление состояния без чтения энергонезависимой памяти
+ */
+esp_err_t state_restore(window_mode_t mode, uint8_t gap_percentage, bool calibrated)
+{
+    if (mode > WINDOW_MODE_VENT || gap_percentage > 100) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    // Перед сном изменения были записаны, поэтому значения совпадают с NVS
+    state_publish_begin();
+    current_state.window_mode = mode;
+    current_state.gap_percentage = gap_percentage;
+    current_state.calibrated = calibrated;
+    persisted_state = current_state;
+    dirty_mask = 0;
+    state_publish_end();
+    
+    ESP_LOGI(TAG, "Восстановлено состояние: режим=%d, зазор=%d%%, калибровка=%d",
+            mode, gap_percentage, calibrated);
+    
+    return ESP_OK;
+}
+
 /**
  * @brief Сброс состояния к заводским настройкам
  */
@@ -169,29 +348,45 @@ esp_err_t state_reset(void)
 {
     ESP_LOGI(TAG, "Сброс состояния к заводским настройкам");
     
-    // Сброс текущего состояния
+    uint32_t now = esp_timer_get_time() / 1000; // мс
+    
+    if (persist_mutex != NULL) {
+        xSemaphoreTake(persist_mutex, portMAX_DELAY);
+    }
+    
+    // Сброс текущего состояния (после очистки NVS загружаются те же значения)
+    state_publish_begin();
     current_state.window_mode = WINDOW_MODE_CLOSED;
     current_state.gap_percentage = 0;
     current_state.calibrated = false;
-    current_state.last_activity_time = esp_timer_get_time() / 1000; // мс
+    current_state.last_activity_time = now;
     current_state.resistance_detected = false;
+    persisted_state = current_state;
+    persisted_journal_sequence = 0;
+    dirty_mask = 0;
+    journal_pending = false;
+    state_publish_end();
     
     // Очистка всех записей в пространстве имен
     esp_err_t err = nvs_erase_all(nvs_handle);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Ошибка очистки NVS: %s", esp_err_to_name(err));
-        return err;
+    } else {
+        // Запись изменений в NVS
+        err = nvs_commit(nvs_handle);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Ошибка фиксации изменений в NVS: %s", esp_err_to_name(err));
+        }
     }
     
-    // Запись изменений в NVS
-    err = nvs_commit(nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Ошибка фиксации изменений в NVS: %s", esp_err_to_name(err));
-        return err;
+    if (persist_mutex != NULL) {
+        xSemaphoreGive(persist_mutex);
     }
     
-    ESP_LOGI(TAG, "Состояние успешно сброшено");
-    return ESP_OK;
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Состояние успешно сброшено");
+    }
+    return err;
 }
 
 /**
@@ -199,7 +394,7 @@ esp_err_t state_reset(void)
  */
 device_state_t state_get_current(void)
 {
-    return current_state;
+    return state_snapshot();
 }
 
 /**
@@ -214,11 +409,15 @@ esp_err_t state_update_window_mode(window_mode_t mode)
     }
     
     ESP_LOGI(TAG, "Обновление режима окна: %d -> %d", current_state.window_mode, mode);
-    current_state.window_mode = mode;
     
-    // Обновление времени последней активности
-    current_state.last_activity_time = esp_timer_get_time() / 1000; // мс
+    // Обновление режима и времени последней активности
+    uint32_t now = esp_timer_get_time() / 1000; // мс
+    state_publish_begin();
+    current_state.window_mode = mode;
+    current_state.last_activity_time = now;
+    state_publish_end();
     
+    state_persist_position();
     return ESP_OK;
 }
 
@@ -234,11 +433,38 @@ esp_err_t state_update_gap_percentage(uint8_t percentage)
     }
     
     ESP_LOGI(TAG, "Обновление процента зазора: %d%% -> %d%%", current_state.gap_percentage, percentage);
+    
+    // Обновление зазора и времени последней активности
+    uint32_t now = esp_timer_get_time() / 1000; // мс
+    state_publish_begin();
     current_state.gap_percentage = percentage;
+    current_state.last_activity_time = now;
+    state_publish_end();
     
-    // Обновление времени последней активности
-    current_state.last_activity_time = esp_timer_get_time() / 1000; // мс
+    state_persist_position();
+    return ESP_OK;
+}
+
+/**
+ * @brief Обновление положения окна
+ */
+esp_err_t state_update_position(window_mode_t mode, uint8_t gap_percentage)
+{
+    // Проверка на допустимость положения
+    if (mode > WINDOW_MODE_VENT || gap_percentage > 100) {
+        ESP_LOGE(TAG, "Недопустимое положение окна: режим=%d, зазор=%d%%", mode, gap_percentage);
+        return ESP_ERR_INVALID_ARG;
+    }
     
+    // Обновление положения и времени последней активности
+    uint32_t now = esp_timer_get_time() / 1000; // мс
+    state_publish_begin();
+    current_state.window_mode = mode;
+    current_state.gap_percentage = gap_percentage;
+    current_state.last_activity_time = now;
+    state_publish_end();
+    
+    state_persist_position();
     return ESP_OK;
 }
 
@@ -248,8 +474,12 @@ esp_err_t state_update_gap_percentage(uint8_t percentage)
 esp_err_t state_update_calibration(bool calibrated)
 {
     ESP_LOGI(TAG, "Обновление флага калибровки: %d -> %d", current_state.calibrated, calibrated);
+    
+    state_publish_begin();
     current_state.calibrated = calibrated;
+    state_publish_end();
     
+    state_mark_dirty(STATE_DIRTY_CALIBRATED);
     return ESP_OK;
 }
 
@@ -258,7 +488,10 @@ esp_err_t state_update_calibration(bool calibrated)
  */
 esp_err_t state_update_activity_time(void)
 {
-    current_state.last_activity_time = esp_timer_get_time() / 1000; // мс
+    uint32_t now = esp_timer_get_time() / 1000; // мс
+    state_publish_begin();
+    current_state.last_activity_time = now;
+    state_publish_end();
     return ESP_OK;
 }
 
@@ -267,14 +500,19 @@ esp_err_t state_update_activity_time(void)
  */
 esp_err_t state_update_resistance_detected(bool detected)
 {
-    if (current_state.resistance_detected != detected) {
-        ESP_LOGI(TAG, "Обновление флага сопротивления: %d -> %d", current_state.resistance_detected, detected);
+    // Флаг проверяется каждую секунду, публикация только при изменении
+    if (state_snapshot().resistance_detected != detected) {
+        ESP_LOGI(TAG, "Обновление флага сопротивления: %d -> %d", !detected, detected);
+        uint32_t now = esp_timer_get_time() / 1000; // мс
+        
+        state_publish_begin();
         current_state.resistance_detected = detected;
         
         // Если обнаружено сопротивление, обновляем время активности
         if (detected) {
-            current_state.last_activity_time = esp_timer_get_time() / 1000; // мс
+            current_state.last_activity_time = now;
         }
+        state_publish_end();
     }
     
     return ESP_OK;
@@ -285,7 +523,7 @@ esp_err_t state_update_resistance_detected(bool detected)
  */
 bool state_is_calibration_required(void)
 {
-    return !current_state.calibrated;
+    return !state_snapshot().calibrated;
 }
 
 /**
@@ -294,7 +532,7 @@ bool state_is_calibration_required(void)
 uint32_t state_get_inactivity_time(void)
 {
     uint32_t current_time = esp_timer_get_time() / 1000; // мс
-    return current_time - current_state.last_activity_time;
+    return current_time - state_snapshot().last_activity_time;
 }
 
 /**
@@ -302,5 +540,386 @@ uint32_t state_get_inactivity_time(void)
  */
 bool state_is_resistance_detected(void)
 {
-    return current_state.resistance_detected;
-} 
\ No newline at end of file
+    return state_snapshot().resistance_detected;
+}
+
+/**
+ * @brief Начало изменения текущего состояния
+ */
+static void state_publish_begin(void)
+{
+    taskENTER_CRITICAL(&state_lock);
+    seqlock_write_begin(&state_seq);
+}
+
+/**
+ * @brief Публикация измененного состояния для читателей
+ */
+static void state_publish_end(void)
+{
+    seqlock_write_end(&state_seq);
+    taskEXIT_CRITICAL(&state_lock);
+}
+
+/**
+ * @brief Согласованный снимок текущего состояния без блокировки
+ * 
+ * Копия повторяется, если во время чтения состояние было изменено.
+ */
+static device_state_t state_snapshot(void)
+{
+    device_state_t snapshot;
+    uint32_t seq;
+    
+    do {
+        seq = seqlock_read_begin(&state_seq);
+        snapshot = current_state;
+    } while (seqlock_read_retry(&state_seq, seq));
+    
+    return snapshot;
+}
+
+/**
+ * @brief Пометка полей измененными и запуск отложенной записи
+ */
+static void state_mark_dirty(uint32_t fields)
+{
+    taskENTER_CRITICAL(&state_lock);
+    dirty_mask |= fields;
+    taskEXIT_CRITICAL(&state_lock);
+    
+    if (persist_task != NULL) {
+        xTaskNotifyGive(persist_task);
+    }
+}
+
+/**
+ * @brief Номер последней записи журнала (0, если журнала или записей нет)
+ */
+static uint32_t state_journal_sequence(void)
+{
+    state_journal_entry_t entry;
+    if (journal_ready && state_journal_get_latest(&entry) == ESP_OK) {
+        return entry.sequence;
+    }
+    return 0;
+}
+
+/**
+ * @brief Запись состояния, если измененные поля отличаются от записанных во флеш
+ * 
+ * Вызывается под persist_mutex. Если записывать нечего, фиксация NVS
+ * не выполняется. Положение, не попавшее в журнал, записывается и при
+ * совпадении с записанным: журнал мог получить более новую запись, и номер
+ * журнала в записи NVS должен ее перекрыть.
+ */
+static esp_err_t state_write_dirty(uint32_t dirty, const device_state_t *snapshot, uint32_t journal_sequence)
+{
+    bool position_behind_journal = (dirty & (STATE_DIRTY_WINDOW_MODE | STATE_DIRTY_GAP_PERCENTAGE)) != 0 &&
+                                   journal_sequence != persisted_journal_sequence;
+    
+    if (dirty == 0 ||
+        (snapshot->window_mode == persisted_state.window_mode &&
+         snapshot->gap_percentage == persisted_state.gap_percentage &&
+         snapshot->calibrated == persisted_state.calibrated &&
+         !position_behind_journal)) {
+        return ESP_OK;
+    }
+    
+    state_record_t record = {
+        .version = STATE_RECORD_VERSION,
+        .window_mode = (uint8_t)snapshot->window_mode,
+        .gap_percentage = snapshot->gap_percentage,
+        .flags = snapshot->calibrated ? STATE_RECORD_FLAG_CALIBRATED : 0,
+        .journal_sequence = journal_sequence
+    };
+    state_record_seal(&record);
+    
+    // Запись целиком заменяет предыдущую, поэтому поля не расходятся при сбое питания
+    esp_err_t err = nvs_set_blob(nvs_handle, NVS_KEY_STATE, &record, sizeof(record));
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Ошибка сохранения состояния: %s", esp_err_to_name(err));
+        return err;
+    }
+    
+    err = nvs_commit(nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Ошибка фиксации изменений в NVS: %s", esp_err_to_name(err));
+        return err;
+    }
+    
+    persisted_state.window_mode = snapshot->window_mode;
+    persisted_state.gap_percentage = snapshot->gap_percentage;
+    persisted_state.calibrated = snapshot->calibrated;
+    persisted_journal_sequence = journal_sequence;
+    
+    ESP_LOGI(TAG, "Состояние сохранено: режим=%d, зазор=%d%%, калибровка=%d",
+             snapshot->window_mode, snapshot->gap_percentage, snapshot->calibrated);
+    return ESP_OK;
+}
+
+/**
+ * @brief Расчет CRC32 записи состояния
+ */
+static void state_record_seal(state_record_t *record)
+{
+    record->crc = esp_rom_crc32_le(0, (const uint8_t *)record, offsetof(state_record_t, crc));
+}
+
+/**
+ * @brief Чтение и проверка записи состояния
+ * 
+ * @return ESP_ERR_NVS_NOT_FOUND, если записи нет; ESP_ERR_INVALID_SIZE,
+ *         ESP_ERR_INVALID_CRC или ESP_ERR_INVALID_VERSION для поврежденной записи
+ */
+static esp_err_t state_read_record(state_record_t *record)
+{
+    union {
+        state_record_t current;
+        state_record_v1_t v1;
+    } stored;
+    
+    size_t size = sizeof(stored);
+    esp_err_t err = nvs_get_blob(nvs_handle, NVS_KEY_STATE, &stored, &size);
+    if (err == ESP_ERR_NVS_INVALID_LENGTH) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+    
+    if (size == 0) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    
+    // Более новые форматы не читаются (откат прошивки после обновления)
+    if (stored.current.version > STATE_RECORD_VERSION) {
+        return ESP_ERR_INVALID_VERSION;
+    }
+    
+    // Переходы со старых версий записи: каждая версия приводится к следующей
+    // до STATE_RECORD_VERSION
+    if (stored.current.version == 1) {
+        if (size != sizeof(state_record_v1_t)) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        if (esp_rom_crc32_le(0, (const uint8_t *)&stored.v1, offsetof(state_record_v1_t, crc)) != stored.v1.crc) {
+            return ESP_ERR_INVALID_CRC;
+        }
+        
+        // Версия 1 не хранила номер журнала: журнал, если он есть, новее
+        state_record_t upgraded = {
+            .version = 2,
+            .window_mode = stored.v1.window_mode,
+            .gap_percentage = stored.v1.gap_percentage,
+            .flags = stored.v1.flags,
+            .journal_sequence = 0
+        };
+        state_record_seal(&upgraded);
+        stored.current = upgraded;
+        size = sizeof(state_record_t);
+    }
+    
+    if (size != sizeof(state_record_t)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    
+    *record = stored.current;
+    uint32_t crc = record->crc;
+    state_record_seal(record);
+    if (record->crc != crc) {
+        return ESP_ERR_INVALID_CRC;
+    }
+    
+    if (record->window_mode > WINDOW_MODE_VENT || record->gap_percentage > 100) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    return ESP_OK;
+}
+
+/**
+ * @brief Перенос состояния из ключей устаревшего формата в запись
+ * 
+ * Понимает раскладку ключей обеих прошивок ("window_mode" и "mode"/"handle_pos").
+ * После записи новой записи старые ключи удаляются.
+ * 
+ * @return ESP_ERR_NVS_NOT_FOUND, если старых ключей нет
+ */
+static esp_err_t state_migrate_legacy(state_record_t *record)
+{
+    uint8_t mode;
+    uint8_t gap = 0;
+    uint8_t calibrated = 0;
+    
+    esp_err_t err = nvs_get_u8(nvs_handle, NVS_KEY_LEGACY_WINDOW_MODE, &mode);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        err = nvs_get_u8(nvs_handle, NVS_KEY_LEGACY_MODE, &mode);
+        
+        // Пользовательский режим esp32-h2 соответствует открытому окну с заданным зазором
+        if (err == ESP_OK && mode == LEGACY_MODE_CUSTOM) {
+            mode = WINDOW_MODE_OPEN;
+        }
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+    
+    nvs_get_u8(nvs_handle, NVS_KEY_LEGACY_GAP, &gap);
+    nvs_get_u8(nvs_handle, NVS_KEY_LEGACY_CALIBRATED, &calibrated);
+    
+    record->version = STATE_RECORD_VERSION;
+    record->window_mode = mode <= WINDOW_MODE_VENT ? mode : WINDOW_MODE_CLOSED;
+    record->gap_percentage = gap <= 100 ? gap : 0;
+    record->flags = calibrated == 1 ? STATE_RECORD_FLAG_CALIBRATED : 0;
+    record->journal_sequence = 0;
+    state_record_seal(record);
+    
+    err = nvs_set_blob(nvs_handle, NVS_KEY_STATE, record, sizeof(state_record_t));
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Ошибка записи перенесенного состояния: %s", esp_err_to_name(err));
+        return ESP_OK; // Значения прочитаны, перенос повторится при следующей загрузке
+    }
+    
+    static const char *legacy_keys[] = {
+        NVS_KEY_LEGACY_WINDOW_MODE, NVS_KEY_LEGACY_MODE, NVS_KEY_LEGACY_HANDLE_POS,
+        NVS_KEY_LEGACY_GAP, NVS_KEY_LEGACY_CALIBRATED, NVS_KEY_LEGACY_ACTIVITY
+    };
+    for (size_t i = 0; i < sizeof(legacy_keys) / sizeof(legacy_keys[0]); i++) {
+        nvs_erase_key(nvs_handle, legacy_keys[i]);
+    }
+    
+    err = nvs_commit(nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Ошибка фиксации перенесенного состояния: %s", esp_err_to_name(err));
+    } else {
+        ESP_LOGI(TAG, "Состояние перенесено из ключей устаревшего формата");
+    }
+    
+    return ESP_OK;
+}
+
+/**
+ * @brief Вызов функций записи зарегистрированных модулей
+ * 
+ * Вызывается под persist_mutex. Ошибка одного модуля не мешает записи
+ * остальных; возвращается первая ошибка.
+ */
+static esp_err_t state_run_flush_hooks(void)
+{
+    esp_err_t result = ESP_OK;
+    
+    for (int i = 0; i < flush_hook_count; i++) {
+        esp_err_t err = flush_hooks[i]();
+        if (err != ESP_OK && result == ESP_OK) {
+            result = err;
+        }
+    }
+    
+    return result;
+}
+
+/**
+ * @brief Сохранение текущего положения окна
+ * 
+ * Запись в журнал выполняет задача отложенной записи сразу после
+ * уведомления, вызывающая задача флеш не ждет. Без журнала положение
+ * сохраняется в NVS отложенной записью.
+ */
+static void state_persist_position(void)
+{
+    if (!journal_ready || persist_task == NULL) {
+        state_mark_dirty(STATE_DIRTY_WINDOW_MODE | STATE_DIRTY_GAP_PERCENTAGE);
+        return;
+    }
+    
+    taskENTER_CRITICAL(&state_lock);
+    journal_pending = true;
+    taskEXIT_CRITICAL(&state_lock);
+    
+    xTaskNotifyGive(persist_task);
+}
+
+/**
+ * @brief Запись ожидающего положения в журнал
+ * 
+ * Вызывается под persist_mutex. Серия положений, накопившаяся до записи,
+ * дает одну запись с последним положением. Если запись не удалась,
+ * положение сохраняется в NVS отложенной записью.
+ */
+static void state_write_journal(void)
+{
+    taskENTER_CRITICAL(&state_lock);
+    bool pending = journal_pending;
+    journal_pending = false;
+    window_mode_t mode = current_state.window_mode;
+    uint8_t gap_percentage = current_state.gap_percentage;
+    taskEXIT_CRITICAL(&state_lock);
+    
+    if (!pending) {
+        return;
+    }
+    
+    if (state_journal_append(mode, gap_percentage, servo_get_handle_angle()) != ESP_OK) {
+        state_mark_dirty(STATE_DIRTY_WINDOW_MODE | STATE_DIRTY_GAP_PERCENTAGE);
+    }
+}
+
+/**
+ * @brief Запись ожидающего положения в журнал из задачи отложенной записи
+ */
+static void state_flush_journal(void)
+{
+    xSemaphoreTake(persist_mutex, portMAX_DELAY);
+    state_write_journal();
+    xSemaphoreGive(persist_mutex);
+}
+
+/**
+ * @brief Задача отложенной записи состояния
+ * 
+ * Положение окна дописывается в журнал при каждом уведомлении. Запись NVS
+ * выполняется после STATE_PERSIST_DEBOUNCE_MS без новых изменений, но не
+ * позже STATE_PERSIST_MAX_DELAY_MS после первого изменения, поэтому серия
+ * команд приводит к одной фиксации NVS.
+ */
+static void state_persist_task(void *pvParameter)
+{
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        state_flush_journal();
+        
+        taskENTER_CRITICAL(&state_lock);
+        bool dirty = (dirty_mask != 0);
+        taskEXIT_CRITICAL(&state_lock);
+        if (!dirty) {
+            continue;
+        }
+        TickType_t first_change = xTaskGetTickCount();
+        
+        // Ожидание паузы в изменениях
+        while (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(STATE_PERSIST_DEBOUNCE_MS)) > 0 &&
+               (xTaskGetTickCount() - first_change) < pdMS_TO_TICKS(STATE_PERSIST_MAX_DELAY_MS)) {
+            state_flush_journal();
+        }
+        
+        state_save();
+    }
+}
+
+/**
+ * @brief Запись несохраненных изменений перед перезагрузкой
+ */
+static void state_shutdown_handler(void)
+{
+    state_save();
+}
+
+/**
+ * @brief Обработчик события смены положения окна
+ */
+static void state_on_position_changed(const event_bus_event_t *event, void *ctx)
+{
+    // Каждое положение сохраняется, чтобы после сброса окно знало, где оно стоит
+    state_update_position(event->position.mode, event->position.gap_percentage);
+}
@@ -11,6 +11,13 @@
 #include "esp_err.h"
 #include "servo_control.h"
 
+/**
+ * @brief Функция записи данных модуля вместе с состоянием
+ * 
+ * @return esp_err_t ESP_OK при успешной записи
+ */
+typedef esp_err_t (*state_flush_hook_t)(void);
+
 /**
  * @brief Структура данных состояния устройства
  */
@@ -30,12 +37,42 @@ typedef struct {
 esp_err_t state_init(void);
 
 /**
- * @brief Сохранение текущего состояния в энергонезависимую память
+ * @brief Немедленная запись несохраненных изменений в энергонезависимую память
+ * 
+ * Обычно изменения записывает фоновая задача через 2 с после последнего
+ * изменения. Функция вызывается перед сном и перезагрузкой и также
+ * дописывает в журнал положение, еще не записанное фоновой задачей; если
+ * изменений нет, флеш не затрагивается.
  * 
  * @return esp_err_t ESP_OK при успешном сохранении
  */
 esp_err_t state_save(void);
 
+/**
+ * @brief Регистрация функции записи данных вместе с состоянием
+ * 
+ * Функция вызывается задачей отложенной записи и из state_save() после
+ * state_request_flush(), поэтому данные модуля записываются с той же
+ * задержкой и перед сном или перезагрузкой.
+ * 
+ * @param hook Функция записи
+ * @return esp_err_t ESP_ERR_NO_MEM, если зарегистрировано слишком много функций
+ */
+esp_err_t state_register_flush_hook(state_flush_hook_t hook);
+
+/**
+ * @brief Запрос отложенной записи данных зарегистрированных модулей
+ */
+void state_request_flush(void);
+
+/**
+ * @brief Запрос записи данных зарегистрированных модулей перед сном или перезагрузкой
+ * 
+ * Фоновая задача не запускается: данные записываются в state_save() или
+ * вместе со следующей отложенной записью состояния.
+ */
+void state_request_flush_on_save(void);
+
 /**
  * @brief Загрузка состояния из энергонезависимой памяти
  * 
@@ -43,6 +80,20 @@ esp_err_t state_save(void);
  */
 esp_err_t state_load(void);
 
+/**
+ * @brief Восстановление состояния без чтения энергонезависимой памяти
+ * 
+ * Используется вместо state_load() после пробуждения из глубокого сна,
+ * когда состояние взято из RTC-памяти. Значения считаются совпадающими
+ * с записанными в NVS, так как перед сном выполняется state_save().
+ * 
+ * @param mode Режим окна
+ * @param gap_percentage Процент открытия зазора (0-100)
+ * @param calibrated Флаг калибровки
+ * @return esp_err_t ESP_OK при успешном восстановлении
+ */
+esp_err_t state_restore(window_mode_t mode, uint8_t gap_percentage, bool calibrated);
+
 /**
  * @brief Сброс состояния к заводским настройкам
  * 
@@ -53,6 +104,9 @@ esp_err_t state_reset(void);
 /**
  * @brief Получение текущего состояния устройства
  * 
+ * Снимок согласован и читается без блокировки: если состояние изменилось
+ * во время копирования, копия повторяется.
+ * 
  * @return device_state_t Структура с текущим состоянием
  */
 device_state_t state_get_current(void);
@@ -73,6 +127,18 @@ esp_err_t state_update_window_mode(window_mode_t mode);
  */
 esp_err_t state_update_gap_percentage(uint8_t percentage);
 
+/**
+ * @brief Обновление положения окна после движения
+ * 
+ * Положение дописывается в журнал положений фоновой задачей сразу после
+ * изменения; вызывающая задача запись во флеш не ждет.
+ * 
+ * @param mode Режим окна
+ * @param gap_percentage Процент открытия зазора (0-100)
+ * @return esp_err_t ESP_OK при успешном обновлении
+ */
+esp_err_t state_update_position(window_mode_t mode, uint8_t gap_percentage);
+
 /**
  * @brief Обновление флага калибровки
  * 
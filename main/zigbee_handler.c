@@ -6,18 +6,70 @@
  */
 
 #include "zigbee_handler.h"
+#include <string.h>
+#include <stddef.h>
 #include "esp_log.h"
 #include "esp_err.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/timers.h"
+#include "freertos/queue.h"
+#include "nvs.h"
 #include "servo_control.h"
+#include "latency_stats.h"
+#include "scene_table.h"
+#include "schedule.h"
+#include "automation.h"
+#include "ota_update.h"
+#include "state_management.h"
+#include "event_history.h"
+#include "event_bus.h"
+#include "device_config.h"
+#include "esp_system.h"
+#include "esp_random.h"
+#include "esp_rom_crc.h"
 
 // Включение библиотеки ZigBee (esp_zb) из компонентов ESP-IDF
 #include "esp_zigbee_lib.h"
 
 static const char *TAG = "ZIGBEE_HANDLER";
 
+// Хранение параметров сети в NVS
+#define ZIGBEE_NVS_NAMESPACE        "zigbee_net"
+#define ZIGBEE_NVS_KEY_NETWORK      "network"
+#define ZIGBEE_NVS_KEY_ROLE         "role"
+#define ZIGBEE_NETWORK_RECORD_VERSION 2
+
+// Продвижение счетчика кадров при восстановлении, чтобы не повторить уже
+// использованные значения. Счетчик сохраняется, когда он ушел от сохраненного
+// на половину шага, поэтому между проверками допустимо еще полшага кадров
+#define ZIGBEE_FRAME_COUNTER_SAVE_STEP  1024
+#define ZIGBEE_FRAME_COUNTER_SAVE_DELTA (ZIGBEE_FRAME_COUNTER_SAVE_STEP / 2)
+
+// Период проверки счетчика кадров. Маршрутизатор пересылает чужие кадры,
+// а канал 802.15.4 пропускает не более ~250 кадров в секунду, поэтому за
+// секунду счетчик не успевает пройти полшага. Конечное устройство передает
+// только свои кадры и проверяется реже, чтобы не прерывать сон
+#define ZIGBEE_FRAME_COUNTER_CHECK_ROUTER_MS     1000
+#define ZIGBEE_FRAME_COUNTER_CHECK_END_DEVICE_MS 10000
+
+// Запись параметров сети в NVS
+typedef struct {
+    uint8_t version;
+    esp_zigbee_network_info_t info;
+    uint32_t crc;                       // CRC32 всех предыдущих байтов записи
+} zigbee_network_record_t;
+
+// Запись версии 1 (без контрольной суммы)
+typedef struct {
+    uint8_t version;
+    esp_zigbee_network_info_t info;
+} zigbee_network_record_v1_t;
+
+// Сохраненные параметры сети
+static esp_zigbee_network_info_t saved_network;
+static bool network_saved = false;
+
 // Текущие настройки ZigBee
 static zigbee_config_t current_config;
 static zigbee_state_t current_state = ZIGBEE_STATE_DISCONNECTED;
@@ -25,15 +77,114 @@ static zigbee_state_t current_state = ZIGBEE_STATE_DISCONNECTED;
 // Таймер режима сопряжения
 static TimerHandle_t pairing_timer = NULL;
 
-// Текущие значения состояния окна
-static uint8_t current_window_mode = 0; // WINDOW_MODE_CLOSED
-static uint8_t current_gap_percentage = 0;
+// Максимальная случайная задержка отчета после групповой команды (мс),
+// чтобы ответы всех окон группы не сталкивались в эфире
+#define ZIGBEE_GROUP_REPORT_JITTER_MS 2000
+
+// Таймер отложенного отчета после групповой команды и трасса команды,
+// по которой он отправляется (трасса используется только исполнителем)
+static TimerHandle_t report_jitter_timer = NULL;
+static latency_trace_t report_jitter_trace;
+
+// Трасса команды, отчет о которой ожидает APS-подтверждения: задержка
+// отчета отмечается по подтверждению в контексте стека. Новый отчет
+// замещает неподтвержденный вместе с его трассой
+static latency_trace_t report_pending_trace;
+static bool report_pending = false;
+static portMUX_TYPE report_trace_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Трасса команды, выполняющей движение (только задача исполнителя): начало
+// движения отмечается сервоприводом перед первым шагом
+static const latency_trace_t *motion_trace = NULL;
+static bool motion_started = false;
+
+// Исполнитель команд: колбэк стека только копирует команду в очередь,
+// движение сервоприводов выполняется в отдельной задаче
+#define ZIGBEE_CMD_QUEUE_DEPTH      8
+#define ZIGBEE_CMD_MAX_DATA_LEN     DEVICE_CONFIG_PACKET_MAX_LEN  // Самые длинные данные - пакет конфигурации
+#define ZIGBEE_CMD_TASK_STACK_SIZE  4096
+#define ZIGBEE_CMD_TASK_PRIORITY    4    // Ниже задачи стека ZigBee
+
+// Внутренние команды исполнителя (не пересекаются с esp_zigbee_cmd_t)
+#define ZIGBEE_LOCAL_CMD_TIME_SYNC     0xF0  // Получено время от координатора (данные: LE32)
+#define ZIGBEE_LOCAL_CMD_SCHEDULE_DUE  0xF1  // Наступил срок записи расписания
+#define ZIGBEE_LOCAL_CMD_SENSOR_EVENT  0xF2  // Событие датчика (данные: тип, адрес LE16, эндпоинт, значение LE32)
+#define ZIGBEE_LOCAL_CMD_ROLE_SWITCH   0xF3  // Смена роли в сети (данные: роль)
+#define ZIGBEE_LOCAL_CMD_CALIBRATE     0xF4  // Отложенная калибровка после загрузки
+#define ZIGBEE_LOCAL_CMD_RESTORE       0xF5  // Возврат в сохраненное положение и отключение после загрузки
+#define ZIGBEE_LOCAL_CMD_PERSIST_NETWORK 0xF6 // Проверка счетчика кадров и сохранение параметров сети
+#define ZIGBEE_LOCAL_CMD_GROUP_REPORT  0xF7  // Истекла случайная задержка отчета после групповой команды
+
+// Период синхронизации часов с координатором (6 часов)
+#define ZIGBEE_TIME_SYNC_INTERVAL_MS   (6 * 3600 * 1000)
+
+// Копия принятой команды для исполнителя
+typedef struct {
+    uint8_t cmd;
+    uint8_t len;
+    uint8_t data[ZIGBEE_CMD_MAX_DATA_LEN];
+    esp_zigbee_cmd_info_t info;
+    latency_trace_t trace;
+} zigbee_command_t;
+
+// Статическая очередь команд
+static StaticQueue_t cmd_queue_buffer;
+static uint8_t cmd_queue_storage[ZIGBEE_CMD_QUEUE_DEPTH * sizeof(zigbee_command_t)];
+static QueueHandle_t cmd_queue = NULL;
+
+// Таймер периодической синхронизации времени
+static TimerHandle_t time_sync_timer = NULL;
+
+// Таймер проверки счетчика кадров
+static TimerHandle_t frame_counter_timer = NULL;
+
+// Выдержка нового источника питания перед сменой роли: на батарее маршрутизатор
+// быстро разряжает ее, а переход в маршрутизатор не должен срабатывать на кратких включениях
+#define ZIGBEE_ROLE_TO_ROUTER_DELAY_MS      60000
+#define ZIGBEE_ROLE_TO_END_DEVICE_DELAY_MS  5000
+
+// Роль в сети, с которой запущен стек, и роль, ожидающая выдержки источника питания
+static esp_zigbee_role_t current_role = ESP_ZIGBEE_ROLE_END_DEVICE;
+static esp_zigbee_role_t pending_role = ESP_ZIGBEE_ROLE_END_DEVICE;
+static TimerHandle_t role_switch_timer = NULL;
 
 // Прототипы функций колбэков для библиотеки ZigBee
 static void zigbee_on_connected(void);
 static void zigbee_on_disconnected(void);
-static void zigbee_on_command(uint8_t cmd, const uint8_t *data, uint16_t len);
+static bool zigbee_on_command(uint8_t cmd, const uint8_t *data, uint16_t len,
+                              const esp_zigbee_cmd_info_t *info);
+static void zigbee_command_task(void *pvParameters);
+static void zigbee_execute_command(const zigbee_command_t *command);
+static void zigbee_post_local_command(uint8_t cmd, const uint8_t *data, uint8_t len);
+static void zigbee_on_time(uint32_t local_time);
+static void zigbee_on_schedule_due(void);
+static void zigbee_on_sensor(const esp_zigbee_sensor_event_t *event);
+static void zigbee_apply_local_action(window_mode_t mode, uint8_t gap_percentage, event_source_t source);
+static void zigbee_apply_schedule_action(window_mode_t mode, uint8_t gap_percentage);
+static void zigbee_run_calibration(event_source_t source);
+static uint8_t zigbee_gap_after_move(window_mode_t mode, uint8_t gap_percentage);
+static void zigbee_restore_position(void);
+static void zigbee_publish_history_page(uint32_t from_sequence);
+static void zigbee_publish_config(void);
+static void time_sync_timer_callback(TimerHandle_t xTimer);
+static void frame_counter_timer_callback(TimerHandle_t xTimer);
+static void role_switch_timer_callback(TimerHandle_t xTimer);
+static void zigbee_switch_role(esp_zigbee_role_t role);
+static void zigbee_persist_role(void);
+static bool zigbee_load_role(esp_zigbee_role_t *role);
 static void pairing_timer_callback(TimerHandle_t xTimer);
+static void report_jitter_timer_callback(TimerHandle_t xTimer);
+static void zigbee_send_group_report(void);
+static void zigbee_report_track(const latency_trace_t *trace);
+static void zigbee_on_report_sent(void);
+static void zigbee_motion_begin(const latency_trace_t *trace);
+static void zigbee_motion_end(void);
+static void zigbee_on_motion_start(void);
+static void zigbee_publish_latency_stats(void);
+static void zigbee_load_network(void);
+static void zigbee_persist_network(void);
+static void zigbee_network_record_seal(zigbee_network_record_t *record);
+static esp_err_t zigbee_write_network(const esp_zigbee_network_info_t *info);
 
 /**
  * @brief Инициализация модуля ZigBee
@@ -64,16 +215,145 @@ esp_err_t zigbee_init(const zigbee_config_t *config)
         return ESP_ERR_NO_MEM;
     }
     
+    // Создание таймера отложенного отчета
+    report_jitter_timer = xTimerCreate(
+        "report_jitter",
+        pdMS_TO_TICKS(ZIGBEE_GROUP_REPORT_JITTER_MS),
+        pdFALSE,             // Одиночный таймер
+        NULL,                // ID таймера не используется
+        report_jitter_timer_callback
+    );
+    
+    if (report_jitter_timer == NULL) {
+        ESP_LOGE(TAG, "Не удалось создать таймер отложенного отчета");
+        return ESP_ERR_NO_MEM;
+    }
+    
+    servo_set_motion_start_cb(zigbee_on_motion_start);
+    
+    // Создание очереди и задачи исполнителя команд
+    cmd_queue = xQueueCreateStatic(ZIGBEE_CMD_QUEUE_DEPTH, sizeof(zigbee_command_t),
+                                   cmd_queue_storage, &cmd_queue_buffer);
+    
+    BaseType_t task_created = xTaskCreate(
+        zigbee_command_task,
+        "zigbee_cmd",
+        ZIGBEE_CMD_TASK_STACK_SIZE,
+        NULL,
+        ZIGBEE_CMD_TASK_PRIORITY,
+        NULL
+    );
+    
+    if (task_created != pdPASS) {
+        ESP_LOGE(TAG, "Не удалось создать задачу исполнителя команд");
+        return ESP_ERR_NO_MEM;
+    }
+    
+    // Создание таймера синхронизации времени
+    time_sync_timer = xTimerCreate(
+        "time_sync",
+        pdMS_TO_TICKS(ZIGBEE_TIME_SYNC_INTERVAL_MS),
+        pdTRUE,              // Периодический таймер
+        NULL,                // ID таймера не используется
+        time_sync_timer_callback
+    );
+    
+    if (time_sync_timer == NULL) {
+        ESP_LOGE(TAG, "Не удалось создать таймер синхронизации времени");
+        return ESP_ERR_NO_MEM;
+    }
+    
+    // Создание таймера проверки счетчика кадров (период задается по роли при подключении)
+    frame_counter_timer = xTimerCreate(
+        "frame_counter",
+        pdMS_TO_TICKS(ZIGBEE_FRAME_COUNTER_CHECK_END_DEVICE_MS),
+        pdTRUE,              // Периодический таймер
+        NULL,                // ID таймера не используется
+        frame_counter_timer_callback
+    );
+    
+    if (frame_counter_timer == NULL) {
+        ESP_LOGE(TAG, "Не удалось создать таймер проверки счетчика кадров");
+        return ESP_ERR_NO_MEM;
+    }
+    
+    // Создание таймера выдержки перед сменой роли
+    role_switch_timer = xTimerCreate(
+        "role_switch",
+        pdMS_TO_TICKS(ZIGBEE_ROLE_TO_ROUTER_DELAY_MS),
+        pdFALSE,             // Одиночный таймер
+        NULL,                // ID таймера не используется
+        role_switch_timer_callback
+    );
+    
+    if (role_switch_timer == NULL) {
+        ESP_LOGE(TAG, "Не удалось создать таймер смены роли");
+        return ESP_ERR_NO_MEM;
+    }
+    
+    // Загрузка локального расписания
+    esp_err_t schedule_err = schedule_init(zigbee_on_schedule_due);
+    if (schedule_err != ESP_OK) {
+        ESP_LOGE(TAG, "Ошибка инициализации расписания: %s", esp_err_to_name(schedule_err));
+        return schedule_err;
+    }
+    
+    // Загрузка правил локальной автоматизации
+    esp_err_t automation_err = automation_init();
+    if (automation_err != ESP_OK) {
+        ESP_LOGE(TAG, "Ошибка инициализации правил автоматизации: %s", esp_err_to_name(automation_err));
+        return automation_err;
+    }
+    
+    // Загрузка таблицы сцен
+    esp_err_t scene_err = scene_table_init();
+    if (scene_err != ESP_OK) {
+        ESP_LOGE(TAG, "Ошибка инициализации таблицы сцен: %s", esp_err_to_name(scene_err));
+        return scene_err;
+    }
+    
+    // Загрузка параметров сети, в которую устройство уже входило
+    // (после глубокого сна копия из RTC-памяти совпадает с записью в NVS)
+    if (config->saved_network != NULL) {
+        saved_network = *config->saved_network;
+        network_saved = true;
+    } else {
+        zigbee_load_network();
+    }
+    
+    esp_zigbee_network_info_t restore_network = saved_network;
+    restore_network.nwk_frame_counter += ZIGBEE_FRAME_COUNTER_SAVE_STEP;
+    
+    // Роль выбирается по источнику питания при загрузке; при смене роли
+    // устройство возвращается в сохраненную сеть повторным подключением
+    current_role = config->mains_powered ? ESP_ZIGBEE_ROLE_ROUTER : ESP_ZIGBEE_ROLE_END_DEVICE;
+    pending_role = current_role;
+    
+    esp_zigbee_role_t stored_role;
+    bool role_changed = network_saved && zigbee_load_role(&stored_role) && stored_role != current_role;
+    if (role_changed) {
+        ESP_LOGI(TAG, "Сеть сохранена в роли %s, вход повторным подключением",
+                 stored_role == ESP_ZIGBEE_ROLE_ROUTER ? "маршрутизатора" : "конечного устройства");
+    }
+    
     // Конфигурация ZigBee библиотеки
     esp_zigbee_config_t zb_config = {
         .device_name = config->device_name,
         .pan_id = config->pan_id,
         .channel = config->channel,
+        .restore_network = network_saved ? &restore_network : NULL,
+        .role = current_role,
+        .rejoin_network = role_changed,
         .auto_join = true,                    // Автоматическое подключение
         .join_timeout_ms = 30000,            // Таймаут подключения (30 секунд)
         .on_connected = zigbee_on_connected,
         .on_disconnected = zigbee_on_disconnected,
-        .on_command = zigbee_on_command
+        .on_command = zigbee_on_command,
+        .on_time = zigbee_on_time,
+        .on_sensor = zigbee_on_sensor,
+        .on_ota = ota_handle_zigbee_command,
+        .on_scene_lookup = scene_table_contains,
+        .on_report_sent = zigbee_on_report_sent
     };
     
     // Инициализация библиотеки ZigBee
@@ -151,6 +431,27 @@ esp_err_t zigbee_stop(void)
     return ESP_OK;
 }
 
+/**
+ * @brief Проверка наличия сохраненных параметров сети
+ */
+bool zigbee_has_saved_network(void)
+{
+    return network_saved;
+}
+
+/**
+ * @brief Получение параметров сети в том виде, в котором они записаны в NVS
+ */
+bool zigbee_get_saved_network(esp_zigbee_network_info_t *info)
+{
+    if (info == NULL || !network_saved) {
+        return false;
+    }
+    
+    *info = saved_network;
+    return true;
+}
+
 /**
  * @brief Получение текущего состояния подключения ZigBee
  */
@@ -217,24 +518,21 @@ esp_err_t zigbee_report_state(void)
 {
     ESP_LOGI(TAG, "Отправка состояния через ZigBee");
     
-    if (current_state != ZIGBEE_STATE_CONNECTED) {
-        ESP_LOGW(TAG, "ZigBee не подключен, невозможно отправить состояние");
-        return ESP_ERR_INVALID_STATE;
-    }
-    
-    // Получение текущего режима и зазора
-    uint8_t mode = servo_get_window_mode();
-    uint8_t gap = servo_get_gap();
+    // Текущий режим и зазор из модуля состояния
+    device_state_t state = state_get_current();
     
     // Отправка состояния через библиотеку ZigBee
-    esp_err_t err = esp_zigbee_report_window_state(mode, gap);
+    esp_err_t err = esp_zigbee_report_window_state(state.window_mode, state.gap_percentage);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Ошибка отправки состояния: %s", esp_err_to_name(err));
         return err;
     }
     
-    current_window_mode = mode;
-    current_gap_percentage = gap;
+    // Вместе с периодическим отчетом обновляем гистограммы задержек
+    zigbee_publish_latency_stats();
+    
+    // и сохраняем продвинувшийся счетчик кадров
+    zigbee_persist_network();
     
     return ESP_OK;
 }
@@ -246,18 +544,12 @@ esp_err_t zigbee_send_window_mode(uint8_t mode)
 {
     ESP_LOGI(TAG, "Отправка режима окна: %d", mode);
     
-    if (current_state != ZIGBEE_STATE_CONNECTED) {
-        ESP_LOGW(TAG, "ZigBee не подключен, невозможно отправить режим");
-        return ESP_ERR_INVALID_STATE;
-    }
-    
     esp_err_t err = esp_zigbee_report_window_mode(mode);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Ошибка отправки режима: %s", esp_err_to_name(err));
         return err;
     }
     
-    current_window_mode = mode;
     return ESP_OK;
 }
 
@@ -268,18 +560,12 @@ esp_err_t zigbee_send_gap_position(uint8_t gap_percentage)
 {
     ESP_LOGI(TAG, "Отправка положения зазора: %d%%", gap_percentage);
     
-    if (current_state != ZIGBEE_STATE_CONNECTED) {
-        ESP_LOGW(TAG, "ZigBee не подключен, невозможно отправить положение зазора");
-        return ESP_ERR_INVALID_STATE;
-    }
-    
     esp_err_t err = esp_zigbee_report_position(gap_percentage);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Ошибка отправки положения зазора: %s", esp_err_to_name(err));
         return err;
     }
     
-    current_gap_percentage = gap_percentage;
     return ESP_OK;
 }
 
@@ -290,11 +576,6 @@ esp_err_t zigbee_send_alert(zigbee_alert_type_t alert_type, uint8_t value)
 {
     ESP_LOGI(TAG, "Отправка уведомления: тип=%d, значение=%d", alert_type, value);
     
-    if (current_state != ZIGBEE_STATE_CONNECTED) {
-        ESP_LOGW(TAG, "ZigBee не подключен, невозможно отправить уведомление");
-        return ESP_ERR_INVALID_STATE;
-    }
-    
     esp_zigbee_alert_type_t zb_alert_type;
     switch (alert_type) {
         case ZIGBEE_ALERT_LOW_BATTERY:
@@ -337,8 +618,24 @@ static void zigbee_on_connected(void)
         esp_zigbee_enable_pairing(false);
     }
     
-    // Отправляем текущее состояние
+    // Запоминаем параметры сети и роль, в которой они получены,
+    // для быстрого возврата после перезагрузки
+    zigbee_persist_network();
+    zigbee_persist_role();
+    
+    // Синхронизируем часы расписания и продолжаем синхронизацию периодически
+    esp_zigbee_request_time();
+    xTimerStart(time_sync_timer, 0);
+    
+    // Счетчик кадров растет и без отчетов (пересылка, загрузка обновления)
+    xTimerChangePeriod(frame_counter_timer,
+                       pdMS_TO_TICKS(current_role == ESP_ZIGBEE_ROLE_ROUTER ?
+                                     ZIGBEE_FRAME_COUNTER_CHECK_ROUTER_MS :
+                                     ZIGBEE_FRAME_COUNTER_CHECK_END_DEVICE_MS), 0);
+    
+    // Отправляем текущее состояние и параметры устройства
     zigbee_report_state();
+    zigbee_publish_config();
 }
 
 /**
@@ -348,27 +645,308 @@ static void zigbee_on_disconnected(void)
 {
     ESP_LOGW(TAG, "Отключено от сети ZigBee");
     current_state = ZIGBEE_STATE_DISCONNECTED;
+    
+    // Без сети синхронизация невозможна; расписание продолжает работать по внутренним часам
+    xTimerStop(time_sync_timer, 0);
+    xTimerStop(frame_counter_timer, 0);
 }
 
 /**
  * @brief Колбэк при получении команды от сети ZigBee
+ * 
+ * @return bool true, если команда поставлена в очередь исполнителя
  */
-static void zigbee_on_command(uint8_t cmd, const uint8_t *data, uint16_t len)
+static bool zigbee_on_command(uint8_t cmd, const uint8_t *data, uint16_t len,
+                              const esp_zigbee_cmd_info_t *info)
 {
+    // Колбэк выполняется в контексте стека: только копируем команду,
+    // чтобы не задерживать esp_zb_main_loop_iteration()
+    zigbee_command_t command = {
+        .cmd = cmd
+    };
+    
+    // Отметка приема команды
+    latency_trace_begin(&command.trace);
+    
+    if (len > ZIGBEE_CMD_MAX_DATA_LEN) {
+        ESP_LOGW(TAG, "Слишком длинные данные команды %d: %d байт", cmd, len);
+        return false;
+    }
+    
+    command.len = (uint8_t)len;
+    if (len > 0) {
+        memcpy(command.data, data, len);
+    }
+    if (info != NULL) {
+        command.info = *info;
+    }
+    
+    if (xQueueSend(cmd_queue, &command, 0) != pdPASS) {
+        ESP_LOGW(TAG, "Очередь команд заполнена, команда %d отброшена", cmd);
+        return false;
+    }
+    
+    return true;
+}
+
+/**
+ * @brief Постановка внутренней команды в очередь исполнителя
+ */
+static void zigbee_post_local_command(uint8_t cmd, const uint8_t *data, uint8_t len)
+{
+    zigbee_command_t command = {
+        .cmd = cmd,
+        .len = len
+    };
+    
+    latency_trace_begin(&command.trace);
+    if (len > 0) {
+        memcpy(command.data, data, len);
+    }
+    
+    if (xQueueSend(cmd_queue, &command, 0) != pdPASS) {
+        ESP_LOGW(TAG, "Очередь команд заполнена, внутренняя команда %d отброшена", cmd);
+    }
+}
+
+/**
+ * @brief Колбэк получения времени от координатора
+ */
+static void zigbee_on_time(uint32_t local_time)
+{
+    uint8_t data[4] = {
+        local_time & 0xFF,
+        (local_time >> 8) & 0xFF,
+        (local_time >> 16) & 0xFF,
+        (local_time >> 24) & 0xFF
+    };
+    
+    zigbee_post_local_command(ZIGBEE_LOCAL_CMD_TIME_SYNC, data, sizeof(data));
+}
+
+/**
+ * @brief Колбэк наступления срока записи расписания (контекст esp_timer)
+ */
+static void zigbee_on_schedule_due(void)
+{
+    zigbee_post_local_command(ZIGBEE_LOCAL_CMD_SCHEDULE_DUE, NULL, 0);
+}
+
+/**
+ * @brief Колбэк события привязанного датчика (контекст стека)
+ */
+static void zigbee_on_sensor(const esp_zigbee_sensor_event_t *event)
+{
+    uint8_t data[8] = {
+        (uint8_t)event->type,
+        event->src_addr & 0xFF,
+        (event->src_addr >> 8) & 0xFF,
+        event->src_endpoint,
+        event->value & 0xFF,
+        (event->value >> 8) & 0xFF,
+        (event->value >> 16) & 0xFF,
+        (event->value >> 24) & 0xFF
+    };
+    
+    zigbee_post_local_command(ZIGBEE_LOCAL_CMD_SENSOR_EVENT, data, sizeof(data));
+}
+
+/**
+ * @brief Фиксация нового положения окна после движения
+ */
+static void zigbee_position_changed(window_mode_t mode, uint8_t gap_percentage, event_source_t source)
+{
+    // Сохранение состояния, журнал и уведомления подписаны на событие
+    event_bus_event_t event = {
+        .id = EVENT_BUS_POSITION_CHANGED,
+        .position = {
+            .mode = mode,
+            .gap_percentage = gap_percentage,
+            .source = source
+        }
+    };
+    event_bus_publish(&event);
+}
+
+/**
+ * @brief Зазор после перемещения в режим
+ * 
+ * Зазор устанавливается только в режиме открыто, закрытие сбрасывает его,
+ * а в режиме проветривания сервопривод зазора остается на месте.
+ */
+static uint8_t zigbee_gap_after_move(window_mode_t mode, uint8_t gap_percentage)
+{
+    switch (mode) {
+        case WINDOW_MODE_OPEN:
+            return gap_percentage;
+        case WINDOW_MODE_CLOSED:
+            return 0;
+        default:
+            return state_get_current().gap_percentage;
+    }
+}
+
+/**
+ * @brief Калибровка сервоприводов в задаче исполнителя команд
+ */
+static void zigbee_run_calibration(event_source_t source)
+{
+    esp_err_t err = servo_calibrate();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Ошибка калибровки: %s", esp_err_to_name(err));
+        return;
+    }
+    
+    state_update_calibration(true);
+    
+    // Калибровка заканчивается в закрытом положении
+    zigbee_position_changed(WINDOW_MODE_CLOSED, 0, source);
+    if (current_state == ZIGBEE_STATE_CONNECTED) {
+        zigbee_report_state();
+    }
+}
+
+/**
+ * @brief Запрос калибровки сервоприводов в фоне
+ */
+void zigbee_request_calibration(void)
+{
+    // Калибровка выполняется исполнителем, поэтому не пересекается с движением по командам
+    zigbee_post_local_command(ZIGBEE_LOCAL_CMD_CALIBRATE, NULL, 0);
+}
+
+/**
+ * @brief Возврат в сохраненное положение и отключение сервоприводов в фоне
+ */
+void zigbee_request_position_restore(void)
+{
+    // Отключение в той же очереди, что и калибровка, не прерывает ее движение
+    zigbee_post_local_command(ZIGBEE_LOCAL_CMD_RESTORE, NULL, 0);
+}
+
+/**
+ * @brief Возврат в сохраненное положение в задаче исполнителя команд
+ */
+static void zigbee_restore_position(void)
+{
+    device_state_t saved = state_get_current();
+    servo_position_t expected;
+    servo_position_from_state(saved.window_mode, saved.gap_percentage, &expected);
+    
+    // Сервоприводы запущены в сохраненном положении, движение нужно только при расхождении
+    if (servo_get_handle_angle() != expected.handle_angle ||
+        (saved.window_mode == WINDOW_MODE_OPEN && servo_get_gap_angle() != expected.gap_angle)) {
+        ESP_LOGI(TAG, "Восстановление последнего состояния: режим=%d, зазор=%d%%",
+                 saved.window_mode, saved.gap_percentage);
+        
+        esp_err_t err = servo_set_window_mode(saved.window_mode);
+        if (err == ESP_OK && saved.window_mode == WINDOW_MODE_OPEN) {
+            err = servo_set_gap(saved.gap_percentage);
+        }
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Ошибка восстановления положения: %s", esp_err_to_name(err));
+        }
+    }
+    
+    // Отключение сервоприводов после установки
+    servo_disable();
+}
+
+/**
+ * @brief Выполнение действия по расписанию
+ */
+static void zigbee_apply_schedule_action(window_mode_t mode, uint8_t gap_percentage)
+{
+    zigbee_apply_local_action(mode, gap_percentage, EVENT_SOURCE_SCHEDULE);
+}
+
+/**
+ * @brief Выполнение локального действия (расписание или правило автоматизации)
+ */
+static void zigbee_apply_local_action(window_mode_t mode, uint8_t gap_percentage, event_source_t source)
+{
+    esp_err_t err = servo_set_window_mode(mode);
+    if (err == ESP_OK && mode == WINDOW_MODE_OPEN) {
+        err = servo_set_gap(gap_percentage);
+    }
+    
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Ошибка выполнения локального действия: %s", esp_err_to_name(err));
+        return;
+    }
+    
+    zigbee_position_changed(mode, zigbee_gap_after_move(mode, gap_percentage), source);
+    
+    // Хаб узнает о локальном изменении из отчета
+    if (current_state == ZIGBEE_STATE_CONNECTED) {
+        zigbee_report_state();
+    }
+}
+
+/**
+ * @brief Колбэк таймера синхронизации времени
+ */
+static void time_sync_timer_callback(TimerHandle_t xTimer)
+{
+    esp_zigbee_request_time();
+}
+
+/**
+ * @brief Колбэк таймера проверки счетчика кадров
+ */
+static void frame_counter_timer_callback(TimerHandle_t xTimer)
+{
+    // Запись в NVS выполняется исполнителем, а не задачей таймеров
+    zigbee_post_local_command(ZIGBEE_LOCAL_CMD_PERSIST_NETWORK, NULL, 0);
+}
+
+/**
+ * @brief Задача исполнителя команд ZigBee
+ */
+static void zigbee_command_task(void *pvParameters)
+{
+    zigbee_command_t command;
+    
+    while (1) {
+        if (xQueueReceive(cmd_queue, &command, portMAX_DELAY) == pdPASS) {
+            zigbee_execute_command(&command);
+        }
+    }
+}
+
+/**
+ * @brief Выполнение команды ZigBee
+ */
+static void zigbee_execute_command(const zigbee_command_t *command)
+{
+    uint8_t cmd = command->cmd;
+    const uint8_t *data = command->data;
+    uint16_t len = command->len;
+    const esp_zigbee_cmd_info_t *info = &command->info;
+    const latency_trace_t *trace = &command->trace;
+    
     ESP_LOGI(TAG, "Получена команда ZigBee: %d", cmd);
     
     switch (cmd) {
         case ESP_ZIGBEE_CMD_SET_MODE:
             if (len >= 1) {
                 uint8_t mode = data[0];
+                latency_trace_mark(trace, LATENCY_STAGE_DISPATCH);
                 ESP_LOGI(TAG, "Команда изменения режима: %d", mode);
                 
                 // Применяем новый режим к сервоприводу
+                zigbee_motion_begin(trace);
                 esp_err_t err = servo_set_window_mode(mode);
+                zigbee_motion_end();
                 if (err == ESP_OK) {
                     // Обновляем текущий режим и отправляем подтверждение
-                    current_window_mode = mode;
-                    zigbee_send_window_mode(mode);
+                    zigbee_position_changed(mode, zigbee_gap_after_move(mode, state_get_current().gap_percentage),
+                                            EVENT_SOURCE_ZIGBEE);
+                    latency_trace_mark(trace, LATENCY_STAGE_REPORT_QUEUED);
+                    zigbee_report_track(trace);
+                    if (zigbee_send_window_mode(mode) != ESP_OK) {
+                        zigbee_report_track(NULL);
+                    }
                 }
             }
             break;
@@ -376,26 +954,191 @@ static void zigbee_on_command(uint8_t cmd, const uint8_t *data, uint16_t len)
         case ESP_ZIGBEE_CMD_SET_POSITION:
             if (len >= 1) {
                 uint8_t position = data[0];
+                latency_trace_mark(trace, LATENCY_STAGE_DISPATCH);
                 ESP_LOGI(TAG, "Команда изменения положения: %d%%", position);
                 
                 // Применяем новое положение к сервоприводу
+                zigbee_motion_begin(trace);
                 esp_err_t err = servo_set_gap(position);
+                zigbee_motion_end();
                 if (err == ESP_OK) {
                     // Обновляем текущее положение и отправляем подтверждение
-                    current_gap_percentage = position;
-                    zigbee_send_gap_position(position);
+                    zigbee_position_changed(state_get_current().window_mode, position, EVENT_SOURCE_ZIGBEE);
+                    latency_trace_mark(trace, LATENCY_STAGE_REPORT_QUEUED);
+                    zigbee_report_track(trace);
+                    if (zigbee_send_gap_position(position) != ESP_OK) {
+                        zigbee_report_track(NULL);
+                    }
                 }
             }
             break;
             
         case ESP_ZIGBEE_CMD_CALIBRATE:
+            latency_trace_mark(trace, LATENCY_STAGE_DISPATCH);
             ESP_LOGI(TAG, "Команда калибровки");
             
             // Запускаем калибровку сервоприводов
-            esp_err_t err = servo_calibrate();
+            zigbee_run_calibration(EVENT_SOURCE_ZIGBEE);
+            break;
+            
+        case ZIGBEE_LOCAL_CMD_CALIBRATE:
+            zigbee_run_calibration(EVENT_SOURCE_SYSTEM);
+            break;
+            
+        case ZIGBEE_LOCAL_CMD_RESTORE:
+            zigbee_restore_position();
+            break;
+            
+        case ESP_ZIGBEE_CMD_STORE_SCENE:
+            if (len >= 3) {
+                uint16_t group_id = data[0] | (data[1] << 8);
+                uint8_t scene_id = data[2];
+                
+                // Сцена запоминает текущее положение окна
+                device_state_t state = state_get_current();
+                scene_table_store(group_id, scene_id, state.window_mode, state.gap_percentage);
+            }
+            break;
+            
+        case ESP_ZIGBEE_CMD_RECALL_SCENE:
+            if (len >= 3) {
+                uint16_t group_id = data[0] | (data[1] << 8);
+                uint8_t scene_id = data[2];
+                window_mode_t mode;
+                uint8_t gap;
+                
+                if (scene_table_recall(group_id, scene_id, &mode, &gap) != ESP_OK) {
+                    ESP_LOGW(TAG, "Сцена %d группы 0x%04X не найдена", scene_id, group_id);
+                    break;
+                }
+                latency_trace_mark(trace, LATENCY_STAGE_DISPATCH);
+                ESP_LOGI(TAG, "Вызов сцены %d: режим=%d, зазор=%d%%", scene_id, mode, gap);
+                
+                zigbee_motion_begin(trace);
+                esp_err_t err = servo_set_window_mode(mode);
+                if (err == ESP_OK && mode == WINDOW_MODE_OPEN) {
+                    err = servo_set_gap(gap);
+                }
+                zigbee_motion_end();
+                
+                if (err == ESP_OK) {
+                    zigbee_position_changed(mode, zigbee_gap_after_move(mode, gap), EVENT_SOURCE_ZIGBEE);
+                    latency_trace_mark(trace, LATENCY_STAGE_REPORT_QUEUED);
+                    
+                    if (info->group_addressed) {
+                        // Окна группы отвечают со случайной задержкой
+                        uint32_t jitter_ms = 1 + esp_random() % ZIGBEE_GROUP_REPORT_JITTER_MS;
+                        report_jitter_trace = *trace;
+                        xTimerChangePeriod(report_jitter_timer, pdMS_TO_TICKS(jitter_ms), 0);
+                    } else {
+                        zigbee_report_track(trace);
+                        if (zigbee_report_state() != ESP_OK) {
+                            zigbee_report_track(NULL);
+                        }
+                    }
+                }
+            }
+            break;
+            
+        case ESP_ZIGBEE_CMD_REMOVE_SCENE:
+            if (len >= 3) {
+                scene_table_remove(data[0] | (data[1] << 8), data[2]);
+            }
+            break;
+            
+        case ESP_ZIGBEE_CMD_REMOVE_ALL_SCENES:
+            if (len >= 2) {
+                scene_table_remove_group(data[0] | (data[1] << 8));
+            }
+            break;
+            
+        case ESP_ZIGBEE_CMD_SET_SCHEDULE:
+            if (len >= 6) {
+                esp_err_t err = schedule_set_entry(data[0], data[1], data[2], data[3],
+                                                   (window_mode_t)data[4], data[5]);
+                if (err != ESP_OK) {
+                    ESP_LOGW(TAG, "Неверная запись расписания %d: %s", data[0], esp_err_to_name(err));
+                }
+            }
+            break;
+            
+        case ESP_ZIGBEE_CMD_CLEAR_SCHEDULE:
+            if (len >= 1) {
+                schedule_clear_entry(data[0]);
+            }
+            break;
+            
+        case ZIGBEE_LOCAL_CMD_TIME_SYNC:
+            schedule_set_time(data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24));
+            break;
+            
+        case ZIGBEE_LOCAL_CMD_SCHEDULE_DUE:
+            schedule_run_due(zigbee_apply_schedule_action);
+            break;
+            
+        case ESP_ZIGBEE_CMD_SET_RULE:
+            if (len >= 7) {
+                esp_err_t err = automation_set_rule(data[0], (esp_zigbee_sensor_type_t)data[1],
+                                                    (automation_condition_t)data[2],
+                                                    (int16_t)(data[3] | (data[4] << 8)),
+                                                    (window_mode_t)data[5], data[6]);
+                if (err != ESP_OK) {
+                    ESP_LOGW(TAG, "Неверное правило %d: %s", data[0], esp_err_to_name(err));
+                }
+            }
+            break;
+            
+        case ESP_ZIGBEE_CMD_CLEAR_RULE:
+            if (len >= 1) {
+                automation_clear_rule(data[0]);
+            }
+            break;
+            
+        case ZIGBEE_LOCAL_CMD_SENSOR_EVENT: {
+            esp_zigbee_sensor_event_t event = {
+                .type = (esp_zigbee_sensor_type_t)data[0],
+                .src_addr = data[1] | (data[2] << 8),
+                .src_endpoint = data[3],
+                .value = (int32_t)(data[4] | (data[5] << 8) | (data[6] << 16) | ((uint32_t)data[7] << 24))
+            };
+            window_mode_t mode;
+            uint8_t gap;
+            
+            if (automation_evaluate(&event, &mode, &gap)) {
+                latency_trace_mark(trace, LATENCY_STAGE_DISPATCH);
+                zigbee_apply_local_action(mode, gap, EVENT_SOURCE_AUTOMATION);
+            }
+            break;
+        }
+            
+        case ESP_ZIGBEE_CMD_READ_HISTORY:
+            if (len >= 4) {
+                zigbee_publish_history_page(data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24));
+            }
+            break;
+            
+        case ESP_ZIGBEE_CMD_WRITE_CONFIG: {
+            esp_err_t err = device_config_import(data, len);
             if (err != ESP_OK) {
-                ESP_LOGE(TAG, "Ошибка калибровки: %s", esp_err_to_name(err));
+                ESP_LOGW(TAG, "Конфигурация отклонена: %s", esp_err_to_name(err));
             }
+            // Атрибут показывает хабу фактически действующие значения
+            zigbee_publish_config();
+            break;
+        }
+            
+        case ZIGBEE_LOCAL_CMD_ROLE_SWITCH:
+            if (len >= 1) {
+                zigbee_switch_role((esp_zigbee_role_t)data[0]);
+            }
+            break;
+            
+        case ZIGBEE_LOCAL_CMD_PERSIST_NETWORK:
+            zigbee_persist_network();
+            break;
+            
+        case ZIGBEE_LOCAL_CMD_GROUP_REPORT:
+            zigbee_send_group_report();
             break;
             
         default:
@@ -404,6 +1147,131 @@ static void zigbee_on_command(uint8_t cmd, const uint8_t *data, uint16_t len)
     }
 }
 
+/**
+ * @brief Уведомление о смене источника питания
+ */
+void zigbee_power_source_changed(bool mains_powered)
+{
+    esp_zigbee_role_t role = mains_powered ? ESP_ZIGBEE_ROLE_ROUTER : ESP_ZIGBEE_ROLE_END_DEVICE;
+    
+    if (role == current_role) {
+        // Источник питания вернулся до истечения выдержки
+        if (xTimerIsTimerActive(role_switch_timer)) {
+            xTimerStop(role_switch_timer, 0);
+            ESP_LOGI(TAG, "Смена роли отменена: источник питания восстановлен");
+        }
+        pending_role = current_role;
+        return;
+    }
+    
+    uint32_t delay_ms = (role == ESP_ZIGBEE_ROLE_ROUTER) ?
+                        ZIGBEE_ROLE_TO_ROUTER_DELAY_MS : ZIGBEE_ROLE_TO_END_DEVICE_DELAY_MS;
+    pending_role = role;
+    
+    // Изменение периода перезапускает выдержку
+    xTimerChangePeriod(role_switch_timer, pdMS_TO_TICKS(delay_ms), 0);
+    ESP_LOGI(TAG, "Смена роли на %s через %lu мс",
+             role == ESP_ZIGBEE_ROLE_ROUTER ? "маршрутизатор" : "конечное устройство",
+             (unsigned long)delay_ms);
+}
+
+/**
+ * @brief Колбэк таймера выдержки перед сменой роли
+ */
+static void role_switch_timer_callback(TimerHandle_t xTimer)
+{
+    uint8_t role = (uint8_t)pending_role;
+    
+    // Смена выполняется исполнителем после уже принятых команд
+    zigbee_post_local_command(ZIGBEE_LOCAL_CMD_ROLE_SWITCH, &role, 1);
+}
+
+/**
+ * @brief Смена роли в сети: сохранение состояния и перезапуск стека
+ * 
+ * Роль задается только при инициализации стека, поэтому устройство
+ * перезапускается и возвращается в сохраненную сеть в новой роли.
+ */
+static void zigbee_switch_role(esp_zigbee_role_t role)
+{
+    if (role == current_role || role != pending_role) {
+        return;
+    }
+    
+    ESP_LOGI(TAG, "Смена роли в сети: %s",
+             role == ESP_ZIGBEE_ROLE_ROUTER ? "маршрутизатор" : "спящее конечное устройство");
+    
+    // Параметры сети и положение окна нужны сразу после перезапуска
+    zigbee_persist_network();
+    state_save();
+    
+    // Родитель удаляет запись о прежней роли и ожидает повторного подключения;
+    // роль в NVS обновится после подключения в новой роли
+    esp_err_t err = esp_zigbee_leave(true);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Выход из сети перед сменой роли: %s", esp_err_to_name(err));
+    }
+    
+    esp_restart();
+}
+
+/**
+ * @brief Чтение роли, в которой сохранена сеть
+ * 
+ * @param role Роль из NVS
+ * @return bool true, если роль сохранена
+ */
+static bool zigbee_load_role(esp_zigbee_role_t *role)
+{
+    nvs_handle_t handle;
+    if (nvs_open(ZIGBEE_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        return false;
+    }
+    
+    uint8_t stored_role;
+    esp_err_t err = nvs_get_u8(handle, ZIGBEE_NVS_KEY_ROLE, &stored_role);
+    nvs_close(handle);
+    
+    if (err != ESP_OK || (stored_role != ESP_ZIGBEE_ROLE_ROUTER && stored_role != ESP_ZIGBEE_ROLE_END_DEVICE)) {
+        return false;
+    }
+    
+    *role = (esp_zigbee_role_t)stored_role;
+    return true;
+}
+
+/**
+ * @brief Сохранение роли, в которой получены параметры сети, при ее изменении
+ */
+static void zigbee_persist_role(void)
+{
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(ZIGBEE_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Ошибка открытия NVS: %s", esp_err_to_name(err));
+        return;
+    }
+    
+    uint8_t stored_role = 0xFF;
+    nvs_get_u8(handle, ZIGBEE_NVS_KEY_ROLE, &stored_role);
+    
+    if (stored_role != (uint8_t)current_role) {
+        if (stored_role != 0xFF) {
+            ESP_LOGI(TAG, "Роль изменилась с %d на %d", stored_role, current_role);
+        }
+        
+        err = nvs_set_u8(handle, ZIGBEE_NVS_KEY_ROLE, (uint8_t)current_role);
+        if (err == ESP_OK) {
+            err = nvs_commit(handle);
+        }
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Ошибка сохранения роли: %s", esp_err_to_name(err));
+        }
+    }
+    
+    nvs_close(handle);
+}
+
 /**
  * @brief Колбэк таймера режима сопряжения
  */
@@ -413,4 +1281,264 @@ static void pairing_timer_callback(TimerHandle_t xTimer)
     
     // Отключаем режим сопряжения
     esp_zigbee_enable_pairing(false);
-} 
\ No newline at end of file
+}
+
+/**
+ * @brief Публикация гистограмм задержек в атрибуте производителя
+ */
+static void zigbee_publish_latency_stats(void)
+{
+    uint8_t buf[ESP_ZIGBEE_MANUF_ATTR_MAX_LEN];
+    size_t len = 0;
+    
+    if (latency_stats_export(buf, sizeof(buf), &len) != ESP_OK) {
+        ESP_LOGW(TAG, "Не удалось выгрузить гистограммы задержек");
+        return;
+    }
+    
+    esp_zigbee_set_manuf_attribute(ESP_ZIGBEE_MANUF_ATTR_LATENCY_HIST, buf, len);
+}
+
+/**
+ * @brief Выгрузка страницы журнала событий в атрибут производителя
+ * 
+ * Хаб читает атрибут после команды и запрашивает следующую страницу
+ * с номера из заголовка, пока страница не окажется пустой.
+ */
+static void zigbee_publish_history_page(uint32_t from_sequence)
+{
+    uint8_t buf[ESP_ZIGBEE_MANUF_ATTR_MAX_LEN];
+    size_t len = 0;
+    
+    if (event_history_export(from_sequence, buf, sizeof(buf), &len) != ESP_OK) {
+        ESP_LOGW(TAG, "Не удалось выгрузить журнал событий");
+        return;
+    }
+    
+    esp_zigbee_set_manuf_attribute(ESP_ZIGBEE_MANUF_ATTR_HISTORY_PAGE, buf, len);
+}
+
+/**
+ * @brief Публикация текущих параметров устройства в атрибуте производителя
+ */
+static void zigbee_publish_config(void)
+{
+    uint8_t buf[DEVICE_CONFIG_PACKET_MAX_LEN];
+    size_t len = 0;
+    
+    if (device_config_export(buf, sizeof(buf), &len) != ESP_OK) {
+        ESP_LOGW(TAG, "Не удалось выгрузить конфигурацию");
+        return;
+    }
+    
+    esp_zigbee_set_manuf_attribute(ESP_ZIGBEE_MANUF_ATTR_CONFIG, buf, len);
+}
+
+/**
+ * @brief Загрузка сохраненных параметров сети из NVS
+ */
+static void zigbee_load_network(void)
+{
+    nvs_handle_t handle;
+    network_saved = false;
+    
+    esp_err_t err = nvs_open(ZIGBEE_NVS_NAMESPACE, NVS_READONLY, &handle);
+    if (err != ESP_OK) {
+        // Пространство имен еще не создано - устройство не входило в сеть
+        return;
+    }
+    
+    union {
+        zigbee_network_record_t current;
+        zigbee_network_record_v1_t v1;
+    } stored;
+    size_t size = sizeof(stored);
+    err = nvs_get_blob(handle, ZIGBEE_NVS_KEY_NETWORK, &stored, &size);
+    nvs_close(handle);
+    
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        return;
+    }
+    
+    bool valid = false;
+    bool legacy = false;
+    if (err == ESP_OK && size == sizeof(zigbee_network_record_t) &&
+        stored.current.version == ZIGBEE_NETWORK_RECORD_VERSION) {
+        uint32_t crc = stored.current.crc;
+        zigbee_network_record_seal(&stored.current);
+        valid = stored.current.crc == crc;
+    } else if (err == ESP_OK && size == sizeof(zigbee_network_record_v1_t) && stored.v1.version == 1) {
+        // Версия 1 не содержит контрольной суммы: запись перезаписывается с ней
+        valid = true;
+        legacy = true;
+    }
+    
+    if (!valid) {
+        ESP_LOGW(TAG, "Сохраненные параметры сети недействительны");
+        return;
+    }
+    
+    saved_network = legacy ? stored.v1.info : stored.current.info;
+    network_saved = true;
+    
+    if (legacy && zigbee_write_network(&saved_network) != ESP_OK) {
+        ESP_LOGW(TAG, "Не удалось обновить формат параметров сети");
+    }
+    
+    ESP_LOGI(TAG, "Загружены параметры сети: PAN=0x%04X, канал=%d, адрес=0x%04X",
+             saved_network.pan_id, saved_network.channel, saved_network.short_address);
+}
+
+/**
+ * @brief Сохранение параметров текущей сети в NVS при их изменении
+ */
+static void zigbee_persist_network(void)
+{
+    esp_zigbee_network_info_t info;
+    
+    if (esp_zigbee_get_network_info(&info) != ESP_OK) {
+        return;
+    }
+    
+    // Сохраняем только при смене сети, адреса или родителя,
+    // а счетчик кадров - не чаще чем раз в ZIGBEE_FRAME_COUNTER_SAVE_DELTA кадров
+    if (network_saved &&
+        info.pan_id == saved_network.pan_id &&
+        memcmp(info.extended_pan_id, saved_network.extended_pan_id, sizeof(info.extended_pan_id)) == 0 &&
+        info.channel == saved_network.channel &&
+        info.short_address == saved_network.short_address &&
+        info.parent_address == saved_network.parent_address &&
+        info.nwk_frame_counter - saved_network.nwk_frame_counter < ZIGBEE_FRAME_COUNTER_SAVE_DELTA) {
+        return;
+    }
+    
+    if (zigbee_write_network(&info) != ESP_OK) {
+        return;
+    }
+    
+    saved_network = info;
+    network_saved = true;
+    ESP_LOGI(TAG, "Параметры сети сохранены: PAN=0x%04X, канал=%d", info.pan_id, info.channel);
+}
+
+/**
+ * @brief Расчет контрольной суммы записи параметров сети
+ */
+static void zigbee_network_record_seal(zigbee_network_record_t *record)
+{
+    record->crc = esp_rom_crc32_le(0, (const uint8_t *)record, offsetof(zigbee_network_record_t, crc));
+}
+
+/**
+ * @brief Запись параметров сети в NVS с контрольной суммой
+ */
+static esp_err_t zigbee_write_network(const esp_zigbee_network_info_t *info)
+{
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(ZIGBEE_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Ошибка открытия NVS: %s", esp_err_to_name(err));
+        return err;
+    }
+    
+    zigbee_network_record_t record;
+    memset(&record, 0, sizeof(record));
+    record.version = ZIGBEE_NETWORK_RECORD_VERSION;
+    record.info = *info;
+    zigbee_network_record_seal(&record);
+    
+    err = nvs_set_blob(handle, ZIGBEE_NVS_KEY_NETWORK, &record, sizeof(record));
+    if (err == ESP_OK) {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Ошибка сохранения параметров сети: %s", esp_err_to_name(err));
+    }
+    return err;
+}
+
+/**
+ * @brief Колбэк таймера отложенного отчета после групповой команды
+ */
+static void report_jitter_timer_callback(TimerHandle_t xTimer)
+{
+    // Отчет с записью в NVS отправляет исполнитель, а не задача таймеров
+    zigbee_post_local_command(ZIGBEE_LOCAL_CMD_GROUP_REPORT, NULL, 0);
+}
+
+/**
+ * @brief Отложенный отчет после групповой команды (задача исполнителя)
+ */
+static void zigbee_send_group_report(void)
+{
+    zigbee_report_track(&report_jitter_trace);
+    if (zigbee_report_state() != ESP_OK) {
+        zigbee_report_track(NULL);
+    }
+}
+
+/**
+ * @brief Ожидание подтверждения отчета, отправляемого по команде
+ * 
+ * Вызывается до отправки: подтверждение может прийти раньше, чем
+ * исполнитель вернется из отправки. NULL - отчет не отправлен.
+ */
+static void zigbee_report_track(const latency_trace_t *trace)
+{
+    taskENTER_CRITICAL(&report_trace_lock);
+    if (trace != NULL) {
+        report_pending_trace = *trace;
+    }
+    report_pending = (trace != NULL);
+    taskEXIT_CRITICAL(&report_trace_lock);
+}
+
+/**
+ * @brief Колбэк подтверждения отчета атрибутов (контекст стека)
+ */
+static void zigbee_on_report_sent(void)
+{
+    taskENTER_CRITICAL(&report_trace_lock);
+    bool pending = report_pending;
+    latency_trace_t trace = report_pending_trace;
+    report_pending = false;
+    taskEXIT_CRITICAL(&report_trace_lock);
+    
+    if (pending) {
+        latency_trace_mark(&trace, LATENCY_STAGE_REPORT_SENT);
+    }
+}
+
+/**
+ * @brief Начало перемещения по команде с трассой
+ */
+static void zigbee_motion_begin(const latency_trace_t *trace)
+{
+    motion_started = false;
+    motion_trace = trace;
+}
+
+/**
+ * @brief Окончание перемещения: конец движения отмечается, только если оно началось
+ */
+static void zigbee_motion_end(void)
+{
+    if (motion_started) {
+        latency_trace_mark(motion_trace, LATENCY_STAGE_MOTION_END);
+    }
+    motion_trace = NULL;
+}
+
+/**
+ * @brief Колбэк сервопривода перед первым шагом движения
+ */
+static void zigbee_on_motion_start(void)
+{
+    // Второй сервопривод той же команды начало движения не отмечает
+    if (motion_trace != NULL && !motion_started) {
+        latency_trace_mark(motion_trace, LATENCY_STAGE_MOTION_START);
+        motion_started = true;
+    }
+}
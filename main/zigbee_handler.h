@@ -11,6 +11,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include "esp_err.h"
+#include "esp_zigbee_lib.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -55,6 +56,8 @@ typedef struct {
     uint16_t pan_id;            // Идентификатор сети
     uint8_t channel;            // Номер канала
     zigbee_device_type_t dev_type; // Тип устройства
+    bool mains_powered;         // Внешнее питание: устройство работает маршрутизатором
+    const esp_zigbee_network_info_t *saved_network; // Параметры сети из RTC-памяти (NULL - чтение из NVS)
 } zigbee_config_t;
 
 /**
@@ -86,6 +89,21 @@ esp_err_t zigbee_stop(void);
  */
 zigbee_state_t zigbee_get_state(void);
 
+/**
+ * @brief Проверка наличия сохраненных параметров сети
+ * 
+ * @return bool true, если устройство уже входило в сеть и может вернуться в нее без сопряжения
+ */
+bool zigbee_has_saved_network(void);
+
+/**
+ * @brief Получение параметров сети в том виде, в котором они записаны в NVS
+ * 
+ * @param info Указатель для записи параметров
+ * @return bool true, если устройство уже входило в сеть
+ */
+bool zigbee_get_saved_network(esp_zigbee_network_info_t *info);
+
 /**
  * @brief Активация режима сопряжения
  * 
@@ -94,6 +112,33 @@ zigbee_state_t zigbee_get_state(void);
  */
 esp_err_t zigbee_enable_pairing_mode(uint16_t duration_sec);
 
+/**
+ * @brief Уведомление о смене источника питания
+ * 
+ * Если новый источник продержится заданное время, устройство сохраняет
+ * новую роль (маршрутизатор на внешнем питании, спящее конечное устройство
+ * на батарее), перезапускается и возвращается в сохраненную сеть в этой роли.
+ * 
+ * @param mains_powered true - внешнее питание, false - батарея
+ */
+void zigbee_power_source_changed(bool mains_powered);
+
+/**
+ * @brief Запрос калибровки сервоприводов в фоне
+ * 
+ * Калибровка ставится в очередь исполнителя команд и выполняется после
+ * загрузки вместе с остальными перемещениями окна. Вызывается после zigbee_init().
+ */
+void zigbee_request_calibration(void);
+
+/**
+ * @brief Возврат в сохраненное положение и отключение сервоприводов в фоне
+ * 
+ * Выполняется исполнителем команд после уже поставленной калибровки, поэтому
+ * отключение сервоприводов не прерывает ее. Вызывается после zigbee_init().
+ */
+void zigbee_request_position_restore(void);
+
 /**
  * @brief Обработка входящих команд ZigBee
  * 
@@ -127,6 +172,8 @@ esp_err_t zigbee_send_gap_position(uint8_t gap_percentage);
 /**
  * @brief Отправка уведомления через ZigBee
  * 
+ * Без подключения к сети уведомление отправляется после подключения.
+ * 
  * @param alert_type Тип уведомления
  * @param value Значение (зависит от типа уведомления)
  * @return esp_err_t ESP_OK при успешной отправке
@@ -0,0 +1,17 @@
+/**
+ * @file esp_attr.h
+ * @brief Атрибуты размещения ESP-IDF для сборки на хосте
+ * 
+ * Переменные RTC_NOINIT_ATTR собираются в секцию rtc_noinit, содержимое
+ * которой fake_rtc сохраняет между имитируемыми запусками.
+ */
+
+#ifndef FAKE_ESP_ATTR_H
+#define FAKE_ESP_ATTR_H
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define RTC_DATA_ATTR       __attribute__((section("rtc_noinit")))
+#define RTC_NOINIT_ATTR     __attribute__((section("rtc_noinit")))
+
+#endif /* FAKE_ESP_ATTR_H */
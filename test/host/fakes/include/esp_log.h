@@ -0,0 +1,33 @@
+/**
+ * @file esp_log.h
+ * @brief Журналирование ESP-IDF для сборки на хосте
+ * 
+ * Уровень вывода задается переменной окружения HOST_LOG_LEVEL
+ * (0 - ничего, 1 - E, 2 - W, 3 - I, 4 - D); по умолчанию выводятся
+ * только ошибки и предупреждения.
+ */
+
+#ifndef FAKE_ESP_LOG_H
+#define FAKE_ESP_LOG_H
+
+#include "esp_err.h"
+
+typedef enum {
+    ESP_LOG_NONE = 0,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+    ESP_LOG_VERBOSE
+} esp_log_level_t;
+
+void fake_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+    __attribute__((format(printf, 3, 4)));
+
+#define ESP_LOGE(tag, format, ...) fake_log_write(ESP_LOG_ERROR, tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) fake_log_write(ESP_LOG_WARN, tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) fake_log_write(ESP_LOG_INFO, tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) fake_log_write(ESP_LOG_DEBUG, tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) fake_log_write(ESP_LOG_VERBOSE, tag, format, ##__VA_ARGS__)
+
+#endif /* FAKE_ESP_LOG_H */
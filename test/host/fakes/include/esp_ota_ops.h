@@ -0,0 +1,38 @@
+/**
+ * @file esp_ota_ops.h
+ * @brief Функции OTA ESP-IDF для сборки на хосте
+ * 
+ * Раздел для обновления - раздел флеш с меткой FAKE_OTA_PARTITION_LABEL,
+ * подключенный fake_flash_attach(). Образ считается верным, если
+ * начинается с FAKE_OTA_IMAGE_MAGIC; описание приложения читается по
+ * смещению FAKE_OTA_APP_DESC_OFFSET, как в образе ESP-IDF.
+ */
+
+#ifndef FAKE_ESP_OTA_OPS_H
+#define FAKE_ESP_OTA_OPS_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_partition.h"
+
+#define FAKE_OTA_PARTITION_LABEL    "ota_1"
+#define FAKE_OTA_IMAGE_MAGIC        0xE9
+#define FAKE_OTA_APP_DESC_OFFSET    32      // Заголовок образа (24 байта) и заголовок сегмента (8 байт)
+#define FAKE_OTA_CURRENT_VERSION    "1.0.0"
+
+#define ESP_APP_DESC_MAGIC_WORD     0xABCD5432
+
+typedef struct {
+    uint32_t magic_word;
+    uint32_t secure_version;
+    uint32_t reserv1[2];
+    char version[32];
+    char project_name[32];
+} esp_app_desc_t;
+
+const esp_app_desc_t *esp_app_get_description(void);
+const esp_partition_t *esp_ota_get_next_update_partition(const esp_partition_t *start_from);
+esp_err_t esp_ota_get_partition_description(const esp_partition_t *partition, esp_app_desc_t *app_desc);
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t *partition);
+
+#endif /* FAKE_ESP_OTA_OPS_H */
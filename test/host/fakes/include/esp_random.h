@@ -0,0 +1,18 @@
+/**
+ * @file esp_random.h
+ * @brief Генератор случайных чисел для сборки на хосте
+ * 
+ * Последовательность воспроизводима: начальное значение задается
+ * fake_random_seed().
+ */
+
+#ifndef FAKE_ESP_RANDOM_H
+#define FAKE_ESP_RANDOM_H
+
+#include <stdint.h>
+
+uint32_t esp_random(void);
+
+void fake_random_seed(uint32_t seed);
+
+#endif /* FAKE_ESP_RANDOM_H */
@@ -0,0 +1,16 @@
+/**
+ * @file esp_rom_crc.h
+ * @brief CRC32 из ПЗУ ESP для сборки на хосте
+ */
+
+#ifndef FAKE_ESP_ROM_CRC_H
+#define FAKE_ESP_ROM_CRC_H
+
+#include <stdint.h>
+
+/**
+ * @brief CRC32 (полином 0xEDB88320) с тем же соглашением, что и в ПЗУ
+ */
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len);
+
+#endif /* FAKE_ESP_ROM_CRC_H */
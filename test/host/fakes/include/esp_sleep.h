@@ -0,0 +1,40 @@
+/**
+ * @file esp_sleep.h
+ * @brief Режимы сна ESP-IDF для сборки на хосте
+ */
+
+#ifndef FAKE_ESP_SLEEP_H
+#define FAKE_ESP_SLEEP_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef enum {
+    ESP_SLEEP_WAKEUP_UNDEFINED = 0,
+    ESP_SLEEP_WAKEUP_ALL,
+    ESP_SLEEP_WAKEUP_EXT0,
+    ESP_SLEEP_WAKEUP_EXT1,
+    ESP_SLEEP_WAKEUP_TIMER,
+    ESP_SLEEP_WAKEUP_TOUCHPAD,
+    ESP_SLEEP_WAKEUP_ULP,
+    ESP_SLEEP_WAKEUP_GPIO
+} esp_sleep_wakeup_cause_t;
+
+typedef enum {
+    ESP_EXT1_WAKEUP_ANY_LOW = 0,
+    ESP_EXT1_WAKEUP_ANY_HIGH = 1
+} esp_sleep_ext1_wakeup_mode_t;
+
+esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause(void);
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t time_in_us);
+esp_err_t esp_sleep_enable_ext1_wakeup(uint64_t io_mask, esp_sleep_ext1_wakeup_mode_t mode);
+
+/**
+ * @brief Переход в глубокий сон
+ * 
+ * Сохраняет RTC-память и завершает имитируемый запуск
+ * (процесс завершается с кодом FAKE_EXIT_DEEP_SLEEP).
+ */
+void esp_deep_sleep_start(void) __attribute__((noreturn));
+
+#endif /* FAKE_ESP_SLEEP_H */
@@ -0,0 +1,40 @@
+/**
+ * @file esp_system.h
+ * @brief Системные функции ESP-IDF для сборки на хосте
+ */
+
+#ifndef FAKE_ESP_SYSTEM_H
+#define FAKE_ESP_SYSTEM_H
+
+#include "esp_err.h"
+#include "esp_random.h"
+
+typedef enum {
+    ESP_RST_UNKNOWN = 0,
+    ESP_RST_POWERON,
+    ESP_RST_EXT,
+    ESP_RST_SW,
+    ESP_RST_PANIC,
+    ESP_RST_INT_WDT,
+    ESP_RST_TASK_WDT,
+    ESP_RST_WDT,
+    ESP_RST_DEEPSLEEP,
+    ESP_RST_BROWNOUT,
+    ESP_RST_SDIO
+} esp_reset_reason_t;
+
+typedef void (*shutdown_handler_t)(void);
+
+esp_reset_reason_t esp_reset_reason(void);
+esp_err_t esp_register_shutdown_handler(shutdown_handler_t handler);
+esp_err_t esp_unregister_shutdown_handler(shutdown_handler_t handler);
+
+/**
+ * @brief Программная перезагрузка
+ * 
+ * Вызывает обработчики перезагрузки и завершает имитируемый запуск
+ * (процесс завершается с кодом FAKE_EXIT_RESTART).
+ */
+void esp_restart(void) __attribute__((noreturn));
+
+#endif /* FAKE_ESP_SYSTEM_H */
@@ -0,0 +1,144 @@
+/**
+ * @file fake_host.h
+ * @brief Управление имитацией платформы в тестах на хосте
+ * 
+ * Каждый имитируемый запуск устройства выполняется в отдельном процессе
+ * (fake_run_boot()), поэтому статическое состояние модулей начинается с
+ * нуля, как после сброса. Между запусками сохраняются NVS, разделы
+ * флеш-памяти и RTC-память - каждый в своем файле.
+ */
+
+#ifndef FAKE_HOST_H
+#define FAKE_HOST_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_system.h"
+#include "esp_sleep.h"
+#include "esp_partition.h"
+
+/**
+ * @brief Код завершения процесса после esp_restart()
+ */
+#define FAKE_EXIT_RESTART       64
+
+/**
+ * @brief Код завершения процесса после esp_deep_sleep_start()
+ */
+#define FAKE_EXIT_DEEP_SLEEP    65
+
+/**
+ * @brief Подключение файла раздела флеш-памяти
+ * 
+ * Если файла нет, он создается стертым (0xFF). Запись во флеш только
+ * сбрасывает биты, как в NOR-флеш.
+ * 
+ * @param label Метка раздела данных
+ * @param path Путь к файлу раздела
+ * @param size Размер раздела
+ * @param sector_size Размер сектора стирания
+ * @return esp_err_t ESP_OK при успешном подключении
+ */
+esp_err_t fake_flash_attach(const char *label, const char *path, uint32_t size, uint32_t sector_size);
+
+/**
+ * @brief Отключение питания после заданного числа байтов записи или стирания
+ * 
+ * Операция, на которой заканчивается запас, выполняется частично; после
+ * этого все операции с флеш возвращают ESP_FAIL до конца запуска.
+ * 
+ * @param bytes Запас байтов (отрицательное значение - без отключения)
+ */
+void fake_flash_cut_after(int64_t bytes);
+
+/**
+ * @brief Длительность каждой записи во флеш (0 - без задержки)
+ * 
+ * Задача, вызвавшая запись, ждет заданное время до возврата.
+ * 
+ * @param delay_ms Задержка записи, мс
+ */
+void fake_flash_set_write_delay_ms(uint32_t delay_ms);
+
+/**
+ * @brief Проверка, что питание флеш-памяти было отключено
+ */
+bool fake_flash_power_lost(void);
+
+/**
+ * @brief Число байтов, записанных и стертых с начала запуска
+ */
+uint64_t fake_flash_bytes_programmed(void);
+
+/**
+ * @brief Число стираний секторов с начала запуска
+ */
+uint32_t fake_flash_erase_count(void);
+
+/**
+ * @brief Раздел, выбранный esp_ota_set_boot_partition() в этом запуске
+ * 
+ * @return const esp_partition_t* Раздел или NULL, если раздел не выбирался
+ */
+const esp_partition_t *fake_ota_boot_partition(void);
+
+/**
+ * @brief Подключение файла содержимого NVS
+ * 
+ * @param path Путь к файлу (NULL - NVS только в памяти процесса)
+ * @return esp_err_t ESP_OK при успешной загрузке
+ */
+esp_err_t fake_nvs_attach(const char *path);
+
+/**
+ * @brief Имитация ошибки записи NVS
+ * 
+ * @param err Код ошибки для всех последующих записей (ESP_OK - без ошибок)
+ */
+void fake_nvs_fail_writes(esp_err_t err);
+
+/**
+ * @brief Число записей и удалений ключей NVS с начала запуска
+ */
+uint32_t fake_nvs_write_count(void);
+
+/**
+ * @brief Число записей одного ключа NVS с начала запуска
+ */
+uint32_t fake_nvs_key_write_count(const char *name_space, const char *key);
+
+/**
+ * @brief Причина сброса и пробуждения для текущего запуска
+ * 
+ * Вызывается до fake_rtc_attach(): RTC-память сохраняется только после
+ * глубокого сна и программной перезагрузки.
+ */
+void fake_system_set_boot_reason(esp_reset_reason_t reason, esp_sleep_wakeup_cause_t wakeup_cause);
+
+/**
+ * @brief Подключение файла RTC-памяти
+ * 
+ * При включении питания RTC-память заполняется случайными данными, при
+ * теплом сбросе загружается из файла. Перед глубоким сном и
+ * перезагрузкой содержимое записывается в файл.
+ * 
+ * @param path Путь к файлу RTC-памяти
+ */
+void fake_rtc_attach(const char *path);
+
+/**
+ * @brief Запрошенное перед сном время пробуждения по таймеру (0 - не задано)
+ */
+uint64_t fake_sleep_timer_wakeup_us(void);
+
+/**
+ * @brief Выполнение одного запуска устройства в отдельном процессе
+ * 
+ * @param boot Функция запуска (возврат из нее - завершение с кодом 0)
+ * @param arg Аргумент функции
+ * @return int Код завершения процесса или -1, если процесс завершен сигналом
+ */
+int fake_run_boot(void (*boot)(void *arg), void *arg);
+
+#endif /* FAKE_HOST_H */
@@ -0,0 +1,69 @@
+/**
+ * @file FreeRTOS.h
+ * @brief Прослойка FreeRTOS поверх потоков POSIX для сборки на хосте
+ * 
+ * Задачи - потоки pthread, критические секции - один общий рекурсивный
+ * мьютекс, тик равен 1 мс. Приоритеты задач не учитываются.
+ */
+
+#ifndef FAKE_FREERTOS_H
+#define FAKE_FREERTOS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef int32_t BaseType_t;
+typedef uint32_t UBaseType_t;
+typedef uint32_t TickType_t;
+typedef uint32_t StackType_t;
+
+#define pdFALSE                 ((BaseType_t)0)
+#define pdTRUE                  ((BaseType_t)1)
+#define pdFAIL                  pdFALSE
+#define pdPASS                  pdTRUE
+#define errQUEUE_EMPTY          ((BaseType_t)0)
+#define errQUEUE_FULL           ((BaseType_t)0)
+
+#define configTICK_RATE_HZ      1000
+#define portTICK_PERIOD_MS      ((TickType_t)1000 / configTICK_RATE_HZ)
+#define portMAX_DELAY           ((TickType_t)0xffffffffUL)
+#define pdMS_TO_TICKS(ms)       ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000U))
+#define pdTICKS_TO_MS(ticks)    ((uint32_t)(((uint64_t)(ticks) * 1000U) / configTICK_RATE_HZ))
+
+#define tskIDLE_PRIORITY        ((UBaseType_t)0)
+#define tskNO_AFFINITY          0x7FFFFFFF
+
+// Спин-блокировка ESP-IDF: все блокировки отображаются на одну общую
+typedef struct {
+    uint32_t owner;
+    uint32_t count;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED { 0, 0 }
+
+void fake_critical_enter(void);
+void fake_critical_exit(void);
+
+#define taskENTER_CRITICAL(mux)         ((void)(mux), fake_critical_enter())
+#define taskEXIT_CRITICAL(mux)          ((void)(mux), fake_critical_exit())
+#define taskENTER_CRITICAL_ISR(mux)     taskENTER_CRITICAL(mux)
+#define taskEXIT_CRITICAL_ISR(mux)      taskEXIT_CRITICAL(mux)
+#define portENTER_CRITICAL(mux)         taskENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL(mux)          taskEXIT_CRITICAL(mux)
+#define portENTER_CRITICAL_ISR(mux)     taskENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_ISR(mux)      taskEXIT_CRITICAL(mux)
+
+#define portYIELD_FROM_ISR(x)           ((void)(x))
+
+// Статические буферы объектов не используются: объекты создаются в куче
+typedef struct {
+    uint8_t unused;
+} StaticQueue_t;
+
+typedef StaticQueue_t StaticSemaphore_t;
+typedef StaticQueue_t StaticTask_t;
+typedef StaticQueue_t StaticTimer_t;
+typedef StaticQueue_t StaticEventGroup_t;
+
+#endif /* FAKE_FREERTOS_H */
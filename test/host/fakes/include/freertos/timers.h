@@ -0,0 +1,26 @@
+/**
+ * @file timers.h
+ * @brief Программные таймеры FreeRTOS поверх потоков POSIX
+ * 
+ * Колбэки вызываются задачей службы таймеров, общей с esp_timer.
+ */
+
+#ifndef FAKE_FREERTOS_TIMERS_H
+#define FAKE_FREERTOS_TIMERS_H
+
+#include "FreeRTOS.h"
+
+typedef struct fake_timer *TimerHandle_t;
+typedef void (*TimerCallbackFunction_t)(TimerHandle_t timer);
+
+TimerHandle_t xTimerCreate(const char *name, TickType_t period, UBaseType_t auto_reload, void *timer_id,
+                           TimerCallbackFunction_t callback);
+BaseType_t xTimerStart(TimerHandle_t timer, TickType_t ticks_to_wait);
+BaseType_t xTimerStop(TimerHandle_t timer, TickType_t ticks_to_wait);
+BaseType_t xTimerReset(TimerHandle_t timer, TickType_t ticks_to_wait);
+BaseType_t xTimerChangePeriod(TimerHandle_t timer, TickType_t new_period, TickType_t ticks_to_wait);
+BaseType_t xTimerDelete(TimerHandle_t timer, TickType_t ticks_to_wait);
+BaseType_t xTimerIsTimerActive(TimerHandle_t timer);
+void *pvTimerGetTimerID(TimerHandle_t timer);
+
+#endif /* FAKE_FREERTOS_TIMERS_H */
@@ -0,0 +1,14 @@
+/**
+ * @file nvs_flash.h
+ * @brief Инициализация NVS ESP-IDF для сборки на хосте
+ */
+
+#ifndef FAKE_NVS_FLASH_H
+#define FAKE_NVS_FLASH_H
+
+#include "nvs.h"
+
+esp_err_t nvs_flash_init(void);
+esp_err_t nvs_flash_erase(void);
+
+#endif /* FAKE_NVS_FLASH_H */
@@ -0,0 +1,12 @@
+/**
+ * @file sdkconfig.h
+ * @brief Параметры menuconfig для сборки на хосте
+ */
+
+#ifndef FAKE_SDKCONFIG_H
+#define FAKE_SDKCONFIG_H
+
+// Kconfig.projbuild библиотеки ZigBee ESP32-H2
+#define CONFIG_ESP_ZB_TX_POWER  20
+
+#endif /* FAKE_SDKCONFIG_H */
@@ -0,0 +1,265 @@
+/**
+ * @file fake_flash.c
+ * @brief Разделы NOR-флеш в файлах с имитацией отключения питания
+ * 
+ * Запись только сбрасывает биты, стирание переводит сектор в 0xFF.
+ * Отключение питания задается запасом байтов: операция, на которой запас
+ * заканчивается, выполняется частично (запись - первые байты, стирание -
+ * начало сектора), после чего флеш недоступна до конца запуска.
+ */
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "esp_partition.h"
+#include "fake_host.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#define FAKE_FLASH_MAX_PARTITIONS   4
+
+// Раздел в файле
+typedef struct {
+    esp_partition_t partition;
+    uint8_t *data;
+    int fd;
+} fake_partition_t;
+
+static struct {
+    fake_partition_t partitions[FAKE_FLASH_MAX_PARTITIONS];
+    int count;
+    int64_t budget;
+    bool power_lost;
+    uint64_t bytes_programmed;
+    uint32_t erase_count;
+    uint32_t write_delay_ms;
+} flash = {
+    .count = 0,
+    .budget = -1
+};
+
+static portMUX_TYPE flash_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief Подключение файла раздела флеш-памяти
+ */
+esp_err_t fake_flash_attach(const char *label, const char *path, uint32_t size, uint32_t sector_size)
+{
+    if (label == NULL || path == NULL || sector_size == 0 || size % sector_size != 0 ||
+        flash.count >= FAKE_FLASH_MAX_PARTITIONS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    fake_partition_t *part = &flash.partitions[flash.count];
+    memset(part, 0, sizeof(*part));
+    
+    part->data = malloc(size);
+    if (part->data == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    memset(part->data, 0xFF, size);
+    
+    part->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (part->fd < 0) {
+        free(part->data);
+        return ESP_FAIL;
+    }
+    
+    // Существующий файл содержит раздел с прошлого запуска
+    ssize_t length = pread(part->fd, part->data, size, 0);
+    if (length < (ssize_t)size) {
+        memset(part->data + (length > 0 ? length : 0), 0xFF, size - (length > 0 ? length : 0));
+        pwrite(part->fd, part->data, size, 0);
+    }
+    
+    part->partition.type = ESP_PARTITION_TYPE_DATA;
+    part->partition.subtype = ESP_PARTITION_SUBTYPE_ANY;
+    part->partition.address = 0x110000 + (uint32_t)flash.count * 0x100000;
+    part->partition.size = size;
+    part->partition.erase_size = sector_size;
+    strncpy(part->partition.label, label, sizeof(part->partition.label) - 1);
+    flash.count++;
+    
+    return ESP_OK;
+}
+
+/**
+ * @brief Отключение питания после заданного числа байтов записи или стирания
+ */
+void fake_flash_cut_after(int64_t bytes)
+{
+    taskENTER_CRITICAL(&flash_lock);
+    flash.budget = bytes;
+    flash.power_lost = false;
+    taskEXIT_CRITICAL(&flash_lock);
+}
+
+/**
+ * @brief Длительность каждой записи во флеш
+ */
+void fake_flash_set_write_delay_ms(uint32_t delay_ms)
+{
+    flash.write_delay_ms = delay_ms;
+}
+
+/**
+ * @brief Проверка, что питание флеш-памяти было отключено
+ */
+bool fake_flash_power_lost(void)
+{
+    return flash.power_lost;
+}
+
+/**
+ * @brief Число байтов, записанных и стертых с начала запуска
+ */
+uint64_t fake_flash_bytes_programmed(void)
+{
+    return flash.bytes_programmed;
+}
+
+/**
+ * @brief Число стираний секторов с начала запуска
+ */
+uint32_t fake_flash_erase_count(void)
+{
+    return flash.erase_count;
+}
+
+/**
+ * @brief Раздел по указателю на описание
+ */
+static fake_partition_t *fake_flash_find(const esp_partition_t *partition)
+{
+    for (int i = 0; i < flash.count; i++) {
+        if (&flash.partitions[i].partition == partition) {
+            return &flash.partitions[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Списание байтов операции с запаса
+ * 
+ * @return Число байтов, которые успеют записаться
+ */
+static size_t fake_flash_consume(size_t size)
+{
+    if (flash.budget < 0) {
+        return size;
+    }
+    
+    if ((int64_t)size >= flash.budget) {
+        size_t done = (size_t)flash.budget;
+        flash.budget = 0;
+        flash.power_lost = true;
+        return done;
+    }
+    
+    flash.budget -= (int64_t)size;
+    return size;
+}
+
+/**
+ * @brief Поиск раздела
+ */
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label)
+{
+    for (int i = 0; i < flash.count; i++) {
+        const esp_partition_t *partition = &flash.partitions[i].partition;
+        if ((type == ESP_PARTITION_TYPE_ANY || partition->type == type) &&
+            (subtype == ESP_PARTITION_SUBTYPE_ANY || partition->subtype == subtype) &&
+            (label == NULL || strcmp(partition->label, label) == 0)) {
+            return partition;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Чтение из раздела
+ */
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size)
+{
+    fake_partition_t *part = fake_flash_find(partition);
+    if (part == NULL || dst == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (src_offset > partition->size || size > partition->size - src_offset) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    
+    taskENTER_CRITICAL(&flash_lock);
+    esp_err_t err = flash.power_lost ? ESP_FAIL : ESP_OK;
+    if (err == ESP_OK) {
+        memcpy(dst, part->data + src_offset, size);
+    }
+    taskEXIT_CRITICAL(&flash_lock);
+    
+    return err;
+}
+
+/**
+ * @brief Запись в раздел (биты только сбрасываются)
+ */
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size)
+{
+    fake_partition_t *part = fake_flash_find(partition);
+    if (part == NULL || src == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (dst_offset > partition->size || size > partition->size - dst_offset) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    
+    if (flash.write_delay_ms > 0) {
+        vTaskDelay(pdMS_TO_TICKS(flash.write_delay_ms));
+    }
+    
+    taskENTER_CRITICAL(&flash_lock);
+    esp_err_t err = ESP_FAIL;
+    if (!flash.power_lost) {
+        size_t done = fake_flash_consume(size);
+        for (size_t i = 0; i < done; i++) {
+            part->data[dst_offset + i] &= ((const uint8_t *)src)[i];
+        }
+        pwrite(part->fd, part->data + dst_offset, done, (off_t)dst_offset);
+        flash.bytes_programmed += done;
+        err = done == size ? ESP_OK : ESP_FAIL;
+    }
+    taskEXIT_CRITICAL(&flash_lock);
+    
+    return err;
+}
+
+/**
+ * @brief Стирание диапазона раздела
+ */
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size)
+{
+    fake_partition_t *part = fake_flash_find(partition);
+    if (part == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (offset % partition->erase_size != 0 || size % partition->erase_size != 0 ||
+        offset > partition->size || size > partition->size - offset) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    
+    taskENTER_CRITICAL(&flash_lock);
+    esp_err_t err = ESP_FAIL;
+    if (!flash.power_lost) {
+        size_t done = fake_flash_consume(size);
+        memset(part->data + offset, 0xFF, done);
+        pwrite(part->fd, part->data + offset, done, (off_t)offset);
+        flash.bytes_programmed += done;
+        flash.erase_count += (uint32_t)(size / partition->erase_size);
+        err = done == size ? ESP_OK : ESP_FAIL;
+    }
+    taskEXIT_CRITICAL(&flash_lock);
+    
+    return err;
+}
@@ -0,0 +1,43 @@
+/**
+ * @file fake_internal.h
+ * @brief Общие средства реализаций имитации платформы
+ */
+
+#ifndef FAKE_INTERNAL_H
+#define FAKE_INTERNAL_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+
+/**
+ * @brief Объект, которого можно ждать: мьютекс и условная переменная
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} fake_waitable_t;
+
+void fake_waitable_init(fake_waitable_t *waitable);
+void fake_waitable_destroy(fake_waitable_t *waitable);
+void fake_deadline_from_ticks(struct timespec *deadline, TickType_t ticks);
+bool fake_waitable_wait(fake_waitable_t *waitable, TickType_t ticks, const struct timespec *deadline);
+
+/**
+ * @brief Время с начала запуска (мкс)
+ */
+int64_t fake_time_now_us(void);
+
+/**
+ * @brief Запись RTC-памяти в файл перед завершением запуска
+ */
+void fake_rtc_save(void);
+
+/**
+ * @brief Завершение имитируемого запуска
+ */
+void fake_exit_boot(int code) __attribute__((noreturn));
+
+#endif /* FAKE_INTERNAL_H */
@@ -0,0 +1,493 @@
+/**
+ * @file fake_nvs.c
+ * @brief Хранилище NVS в памяти с копией в файле
+ * 
+ * Файл перезаписывается целиком (через временный файл и rename) после
+ * каждого изменения, поэтому завершение процесса в любой момент оставляет
+ * каждый ключ со старым или новым значением, как в настоящем NVS.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "nvs.h"
+#include "nvs_flash.h"
+#include "fake_host.h"
+#include "freertos/FreeRTOS.h"
+
+#define FAKE_NVS_MAX_ENTRIES    128
+#define FAKE_NVS_MAX_HANDLES    32
+#define FAKE_NVS_NAME_SIZE      16
+#define FAKE_NVS_MAX_BLOB       4000
+
+// Типы значений
+#define FAKE_NVS_TYPE_NAMESPACE 0x00
+#define FAKE_NVS_TYPE_U8        0x01
+#define FAKE_NVS_TYPE_U16       0x02
+#define FAKE_NVS_TYPE_U32       0x04
+#define FAKE_NVS_TYPE_BLOB      0x42
+
+// Запись NVS (пространство имен хранится записью с пустым ключом)
+typedef struct {
+    bool used;
+    char name_space[FAKE_NVS_NAME_SIZE];
+    char key[FAKE_NVS_NAME_SIZE];
+    uint8_t type;
+    uint32_t length;
+    uint8_t *data;
+    uint32_t write_count;
+} fake_nvs_entry_t;
+
+// Открытый handle
+typedef struct {
+    bool used;
+    bool read_only;
+    char name_space[FAKE_NVS_NAME_SIZE];
+} fake_nvs_handle_t;
+
+static struct {
+    fake_nvs_entry_t entries[FAKE_NVS_MAX_ENTRIES];
+    fake_nvs_handle_t handles[FAKE_NVS_MAX_HANDLES];
+    char path[256];
+    esp_err_t write_error;
+    uint32_t write_count;
+} nvs;
+
+static portMUX_TYPE nvs_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief Поиск записи
+ */
+static fake_nvs_entry_t *fake_nvs_find(const char *name_space, const char *key)
+{
+    for (int i = 0; i < FAKE_NVS_MAX_ENTRIES; i++) {
+        fake_nvs_entry_t *entry = &nvs.entries[i];
+        if (entry->used && strcmp(entry->name_space, name_space) == 0 && strcmp(entry->key, key) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Запись содержимого в файл
+ */
+static void fake_nvs_sync(void)
+{
+    if (nvs.path[0] == '\0') {
+        return;
+    }
+    
+    char tmp_path[sizeof(nvs.path) + 8];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", nvs.path);
+    
+    FILE *file = fopen(tmp_path, "wb");
+    if (file == NULL) {
+        return;
+    }
+    
+    for (int i = 0; i < FAKE_NVS_MAX_ENTRIES; i++) {
+        fake_nvs_entry_t *entry = &nvs.entries[i];
+        if (!entry->used) {
+            continue;
+        }
+        fwrite(entry->name_space, 1, FAKE_NVS_NAME_SIZE, file);
+        fwrite(entry->key, 1, FAKE_NVS_NAME_SIZE, file);
+        fwrite(&entry->type, 1, 1, file);
+        fwrite(&entry->length, sizeof(entry->length), 1, file);
+        fwrite(entry->data, 1, entry->length, file);
+    }
+    
+    fclose(file);
+    rename(tmp_path, nvs.path);
+}
+
+/**
+ * @brief Освобождение всех записей
+ */
+static void fake_nvs_clear(void)
+{
+    for (int i = 0; i < FAKE_NVS_MAX_ENTRIES; i++) {
+        free(nvs.entries[i].data);
+    }
+    memset(nvs.entries, 0, sizeof(nvs.entries));
+}
+
+/**
+ * @brief Добавление или замена записи
+ */
+static esp_err_t fake_nvs_store(const char *name_space, const char *key, uint8_t type,
+                                const void *data, uint32_t length)
+{
+    fake_nvs_entry_t *entry = fake_nvs_find(name_space, key);
+    
+    if (entry == NULL) {
+        for (int i = 0; i < FAKE_NVS_MAX_ENTRIES && entry == NULL; i++) {
+            if (!nvs.entries[i].used) {
+                entry = &nvs.entries[i];
+            }
+        }
+        if (entry == NULL) {
+            return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+        }
+        memset(entry, 0, sizeof(*entry));
+        strncpy(entry->name_space, name_space, FAKE_NVS_NAME_SIZE - 1);
+        strncpy(entry->key, key, FAKE_NVS_NAME_SIZE - 1);
+    }
+    
+    uint8_t *copy = malloc(length > 0 ? length : 1);
+    if (copy == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(copy, data, length);
+    
+    free(entry->data);
+    entry->used = true;
+    entry->type = type;
+    entry->length = length;
+    entry->data = copy;
+    entry->write_count++;
+    return ESP_OK;
+}
+
+/**
+ * @brief Подключение файла содержимого NVS
+ */
+esp_err_t fake_nvs_attach(const char *path)
+{
+    fake_nvs_clear();
+    nvs.path[0] = '\0';
+    
+    if (path == NULL) {
+        return ESP_OK;
+    }
+    
+    strncpy(nvs.path, path, sizeof(nvs.path) - 1);
+    
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return ESP_OK;
+    }
+    
+    char name_space[FAKE_NVS_NAME_SIZE];
+    char key[FAKE_NVS_NAME_SIZE];
+    uint8_t type;
+    uint32_t length;
+    uint8_t data[FAKE_NVS_MAX_BLOB];
+    esp_err_t err = ESP_OK;
+    
+    while (fread(name_space, 1, sizeof(name_space), file) == sizeof(name_space)) {
+        if (fread(key, 1, sizeof(key), file) != sizeof(key) ||
+            fread(&type, 1, 1, file) != 1 ||
+            fread(&length, sizeof(length), 1, file) != 1 ||
+            length > sizeof(data) || fread(data, 1, length, file) != length) {
+            err = ESP_ERR_INVALID_SIZE;
+            break;
+        }
+        fake_nvs_store(name_space, key, type, data, length);
+    }
+    fclose(file);
+    
+    // Счетчики записей относятся к текущему запуску
+    for (int i = 0; i < FAKE_NVS_MAX_ENTRIES; i++) {
+        nvs.entries[i].write_count = 0;
+    }
+    nvs.write_count = 0;
+    
+    return err;
+}
+
+/**
+ * @brief Имитация ошибки записи NVS
+ */
+void fake_nvs_fail_writes(esp_err_t err)
+{
+    nvs.write_error = err;
+}
+
+/**
+ * @brief Число записей и удалений ключей NVS с начала запуска
+ */
+uint32_t fake_nvs_write_count(void)
+{
+    return nvs.write_count;
+}
+
+/**
+ * @brief Число записей одного ключа NVS с начала запуска
+ */
+uint32_t fake_nvs_key_write_count(const char *name_space, const char *key)
+{
+    taskENTER_CRITICAL(&nvs_lock);
+    fake_nvs_entry_t *entry = fake_nvs_find(name_space, key);
+    uint32_t count = entry != NULL ? entry->write_count : 0;
+    taskEXIT_CRITICAL(&nvs_lock);
+    return count;
+}
+
+/**
+ * @brief Инициализация раздела NVS
+ */
+esp_err_t nvs_flash_init(void)
+{
+    return ESP_OK;
+}
+
+/**
+ * @brief Стирание раздела NVS
+ */
+esp_err_t nvs_flash_erase(void)
+{
+    taskENTER_CRITICAL(&nvs_lock);
+    fake_nvs_clear();
+    fake_nvs_sync();
+    taskEXIT_CRITICAL(&nvs_lock);
+    return ESP_OK;
+}
+
+/**
+ * @brief Открытие пространства имен
+ */
+esp_err_t nvs_open(const char *name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    if (name == NULL || out_handle == NULL || strlen(name) >= FAKE_NVS_NAME_SIZE) {
+        return name != NULL && out_handle != NULL ? ESP_ERR_NVS_INVALID_NAME : ESP_ERR_INVALID_ARG;
+    }
+    
+    esp_err_t err = ESP_OK;
+    
+    taskENTER_CRITICAL(&nvs_lock);
+    if (fake_nvs_find(name, "") == NULL) {
+        if (open_mode == NVS_READONLY) {
+            err = ESP_ERR_NVS_NOT_FOUND;
+        } else {
+            err = fake_nvs_store(name, "", FAKE_NVS_TYPE_NAMESPACE, NULL, 0);
+            fake_nvs_sync();
+        }
+    }
+    
+    if (err == ESP_OK) {
+        err = ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+        for (int i = 0; i < FAKE_NVS_MAX_HANDLES; i++) {
+            if (!nvs.handles[i].used) {
+                nvs.handles[i].used = true;
+                nvs.handles[i].read_only = (open_mode == NVS_READONLY);
+                strncpy(nvs.handles[i].name_space, name, FAKE_NVS_NAME_SIZE - 1);
+                nvs.handles[i].name_space[FAKE_NVS_NAME_SIZE - 1] = '\0';
+                *out_handle = (nvs_handle_t)(i + 1);
+                err = ESP_OK;
+                break;
+            }
+        }
+    }
+    taskEXIT_CRITICAL(&nvs_lock);
+    
+    return err;
+}
+
+/**
+ * @brief Открытый handle по номеру
+ */
+static fake_nvs_handle_t *fake_nvs_handle(nvs_handle_t handle)
+{
+    if (handle == 0 || handle > FAKE_NVS_MAX_HANDLES || !nvs.handles[handle - 1].used) {
+        return NULL;
+    }
+    return &nvs.handles[handle - 1];
+}
+
+/**
+ * @brief Закрытие пространства имен
+ */
+void nvs_close(nvs_handle_t handle)
+{
+    taskENTER_CRITICAL(&nvs_lock);
+    fake_nvs_handle_t *open_handle = fake_nvs_handle(handle);
+    if (open_handle != NULL) {
+        open_handle->used = false;
+    }
+    taskEXIT_CRITICAL(&nvs_lock);
+}
+
+/**
+ * @brief Фиксация изменений (записи применяются сразу)
+ */
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    return fake_nvs_handle(handle) != NULL ? ESP_OK : ESP_ERR_NVS_INVALID_HANDLE;
+}
+
+/**
+ * @brief Проверка возможности записи через handle
+ */
+static esp_err_t fake_nvs_check_write(fake_nvs_handle_t *open_handle, const char *key)
+{
+    if (open_handle == NULL) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    if (open_handle->read_only) {
+        return ESP_ERR_NVS_READ_ONLY;
+    }
+    if (key != NULL && (key[0] == '\0' || strlen(key) >= FAKE_NVS_NAME_SIZE)) {
+        return ESP_ERR_NVS_KEY_TOO_LONG;
+    }
+    return nvs.write_error;
+}
+
+/**
+ * @brief Запись значения
+ */
+static esp_err_t fake_nvs_set(nvs_handle_t handle, const char *key, uint8_t type, const void *data,
+                              size_t length)
+{
+    if (key == NULL || (data == NULL && length > 0)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    if (length > FAKE_NVS_MAX_BLOB) {
+        return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+    }
+    
+    taskENTER_CRITICAL(&nvs_lock);
+    fake_nvs_handle_t *open_handle = fake_nvs_handle(handle);
+    esp_err_t err = fake_nvs_check_write(open_handle, key);
+    if (err == ESP_OK) {
+        err = fake_nvs_store(open_handle->name_space, key, type, data, (uint32_t)length);
+    }
+    if (err == ESP_OK) {
+        nvs.write_count++;
+        fake_nvs_sync();
+    }
+    taskEXIT_CRITICAL(&nvs_lock);
+    
+    return err;
+}
+
+/**
+ * @brief Чтение значения
+ * 
+ * Значение другого типа не находится, как в настоящем NVS.
+ */
+static esp_err_t fake_nvs_get(nvs_handle_t handle, const char *key, uint8_t type, void *data, size_t *length)
+{
+    if (key == NULL || length == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    esp_err_t err = ESP_OK;
+    
+    taskENTER_CRITICAL(&nvs_lock);
+    fake_nvs_handle_t *open_handle = fake_nvs_handle(handle);
+    fake_nvs_entry_t *entry = open_handle != NULL ? fake_nvs_find(open_handle->name_space, key) : NULL;
+    
+    if (open_handle == NULL) {
+        err = ESP_ERR_NVS_INVALID_HANDLE;
+    } else if (entry == NULL || entry->type != type || key[0] == '\0') {
+        err = ESP_ERR_NVS_NOT_FOUND;
+    } else if (data == NULL) {
+        *length = entry->length;
+    } else if (*length < entry->length) {
+        *length = entry->length;
+        err = ESP_ERR_NVS_INVALID_LENGTH;
+    } else {
+        memcpy(data, entry->data, entry->length);
+        *length = entry->length;
+    }
+    taskEXIT_CRITICAL(&nvs_lock);
+    
+    return err;
+}
+
+/**
+ * @brief Удаление ключа
+ */
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+    if (key == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    taskENTER_CRITICAL(&nvs_lock);
+    fake_nvs_handle_t *open_handle = fake_nvs_handle(handle);
+    esp_err_t err = fake_nvs_check_write(open_handle, key);
+    fake_nvs_entry_t *entry = err == ESP_OK ? fake_nvs_find(open_handle->name_space, key) : NULL;
+    if (err == ESP_OK && entry == NULL) {
+        err = ESP_ERR_NVS_NOT_FOUND;
+    }
+    if (err == ESP_OK) {
+        free(entry->data);
+        memset(entry, 0, sizeof(*entry));
+        nvs.write_count++;
+        fake_nvs_sync();
+    }
+    taskEXIT_CRITICAL(&nvs_lock);
+    
+    return err;
+}
+
+/**
+ * @brief Удаление всех ключей пространства имен
+ */
+esp_err_t nvs_erase_all(nvs_handle_t handle)
+{
+    taskENTER_CRITICAL(&nvs_lock);
+    fake_nvs_handle_t *open_handle = fake_nvs_handle(handle);
+    esp_err_t err = fake_nvs_check_write(open_handle, NULL);
+    if (err == ESP_OK) {
+        for (int i = 0; i < FAKE_NVS_MAX_ENTRIES; i++) {
+            fake_nvs_entry_t *entry = &nvs.entries[i];
+            if (entry->used && entry->key[0] != '\0' && strcmp(entry->name_space, open_handle->name_space) == 0) {
+                free(entry->data);
+                memset(entry, 0, sizeof(*entry));
+            }
+        }
+        nvs.write_count++;
+        fake_nvs_sync();
+    }
+    taskEXIT_CRITICAL(&nvs_lock);
+    
+    return err;
+}
+
+esp_err_t nvs_set_u8(nvs_handle_t handle, const char *key, uint8_t value)
+{
+    return fake_nvs_set(handle, key, FAKE_NVS_TYPE_U8, &value, sizeof(value));
+}
+
+esp_err_t nvs_set_u16(nvs_handle_t handle, const char *key, uint16_t value)
+{
+    return fake_nvs_set(handle, key, FAKE_NVS_TYPE_U16, &value, sizeof(value));
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char *key, uint32_t value)
+{
+    return fake_nvs_set(handle, key, FAKE_NVS_TYPE_U32, &value, sizeof(value));
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    return fake_nvs_set(handle, key, FAKE_NVS_TYPE_BLOB, value, length);
+}
+
+esp_err_t nvs_get_u8(nvs_handle_t handle, const char *key, uint8_t *out_value)
+{
+    size_t length = sizeof(*out_value);
+    return out_value != NULL ? fake_nvs_get(handle, key, FAKE_NVS_TYPE_U8, out_value, &length) : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t nvs_get_u16(nvs_handle_t handle, const char *key, uint16_t *out_value)
+{
+    size_t length = sizeof(*out_value);
+    return out_value != NULL ? fake_nvs_get(handle, key, FAKE_NVS_TYPE_U16, out_value, &length) : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char *key, uint32_t *out_value)
+{
+    size_t length = sizeof(*out_value);
+    return out_value != NULL ? fake_nvs_get(handle, key, FAKE_NVS_TYPE_U32, out_value, &length) : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+{
+    return fake_nvs_get(handle, key, FAKE_NVS_TYPE_BLOB, out_value, length);
+}
@@ -0,0 +1,73 @@
+/**
+ * @file fake_ota.c
+ * @brief Выбор раздела загрузки и описание приложения на хосте
+ */
+
+#include <string.h>
+#include "esp_ota_ops.h"
+#include "fake_host.h"
+
+static const esp_partition_t *boot_partition = NULL;
+
+/**
+ * @brief Описание текущего приложения
+ */
+const esp_app_desc_t *esp_app_get_description(void)
+{
+    static const esp_app_desc_t app_desc = {
+        .magic_word = ESP_APP_DESC_MAGIC_WORD,
+        .version = FAKE_OTA_CURRENT_VERSION,
+        .project_name = "smart_window"
+    };
+    return &app_desc;
+}
+
+/**
+ * @brief Раздел для записи обновления
+ */
+const esp_partition_t *esp_ota_get_next_update_partition(const esp_partition_t *start_from)
+{
+    return esp_partition_find_first(ESP_PARTITION_TYPE_ANY, ESP_PARTITION_SUBTYPE_ANY, FAKE_OTA_PARTITION_LABEL);
+}
+
+/**
+ * @brief Описание приложения в образе раздела
+ */
+esp_err_t esp_ota_get_partition_description(const esp_partition_t *partition, esp_app_desc_t *app_desc)
+{
+    if (partition == NULL || app_desc == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    esp_err_t err = esp_partition_read(partition, FAKE_OTA_APP_DESC_OFFSET, app_desc, sizeof(*app_desc));
+    if (err != ESP_OK) {
+        return err;
+    }
+    return app_desc->magic_word == ESP_APP_DESC_MAGIC_WORD ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+/**
+ * @brief Выбор раздела загрузки с проверкой образа
+ */
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t *partition)
+{
+    if (partition == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    uint8_t magic;
+    if (esp_partition_read(partition, 0, &magic, sizeof(magic)) != ESP_OK || magic != FAKE_OTA_IMAGE_MAGIC) {
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+    
+    boot_partition = partition;
+    return ESP_OK;
+}
+
+/**
+ * @brief Раздел, выбранный для следующей загрузки
+ */
+const esp_partition_t *fake_ota_boot_partition(void)
+{
+    return boot_partition;
+}
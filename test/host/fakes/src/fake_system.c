@@ -0,0 +1,324 @@
+/**
+ * @file fake_system.c
+ * @brief Системные функции, журнал, CRC, сон и RTC-память на хосте
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "esp_random.h"
+#include "esp_system.h"
+#include "esp_sleep.h"
+#include "fake_host.h"
+#include "freertos/FreeRTOS.h"
+#include "fake_internal.h"
+
+#define FAKE_MAX_SHUTDOWN_HANDLERS  8
+
+// Границы секции RTC-памяти (определяются компоновщиком, если секция есть)
+extern uint8_t __start_rtc_noinit[] __attribute__((weak));
+extern uint8_t __stop_rtc_noinit[] __attribute__((weak));
+
+static struct {
+    esp_reset_reason_t reset_reason;
+    esp_sleep_wakeup_cause_t wakeup_cause;
+    uint64_t sleep_timer_us;
+    shutdown_handler_t shutdown_handlers[FAKE_MAX_SHUTDOWN_HANDLERS];
+    char rtc_path[256];
+    uint32_t random_state;
+    int log_level;
+} sys = {
+    .reset_reason = ESP_RST_POWERON,
+    .wakeup_cause = ESP_SLEEP_WAKEUP_UNDEFINED,
+    .random_state = 0x12345678,
+    .log_level = -1
+};
+
+static portMUX_TYPE sys_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief Имя кода ошибки
+ */
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code) {
+        case ESP_OK: return "ESP_OK";
+        case ESP_FAIL: return "ESP_FAIL";
+        case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+        case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+        case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+        case ESP_ERR_INVALID_CRC: return "ESP_ERR_INVALID_CRC";
+        case ESP_ERR_INVALID_VERSION: return "ESP_ERR_INVALID_VERSION";
+        case ESP_ERR_NVS_NOT_FOUND: return "ESP_ERR_NVS_NOT_FOUND";
+        case ESP_ERR_NVS_INVALID_LENGTH: return "ESP_ERR_NVS_INVALID_LENGTH";
+        case ESP_ERR_NVS_NOT_ENOUGH_SPACE: return "ESP_ERR_NVS_NOT_ENOUGH_SPACE";
+        case ESP_ERR_NVS_READ_ONLY: return "ESP_ERR_NVS_READ_ONLY";
+        default: return "UNKNOWN_ERROR";
+    }
+}
+
+/**
+ * @brief Обработка ошибки в ESP_ERROR_CHECK
+ */
+void fake_esp_error_check_failed(esp_err_t rc, const char *file, int line, const char *expression)
+{
+    fprintf(stderr, "ESP_ERROR_CHECK failed: %s (0x%x) at %s:%d: %s\n",
+            esp_err_to_name(rc), rc, file, line, expression);
+    abort();
+}
+
+/**
+ * @brief Вывод сообщения журнала
+ */
+void fake_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    static const char letters[] = "NEWIDV";
+    
+    if (sys.log_level < 0) {
+        const char *env = getenv("HOST_LOG_LEVEL");
+        sys.log_level = env != NULL ? atoi(env) : ESP_LOG_WARN;
+    }
+    
+    if ((int)level > sys.log_level) {
+        return;
+    }
+    
+    char message[512];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+    
+    fprintf(stderr, "%c (%lld) %s: %s\n", letters[level], (long long)(fake_time_now_us() / 1000), tag, message);
+}
+
+/**
+ * @brief CRC32 с тем же соглашением, что и esp_rom_crc32_le
+ */
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+    crc = ~crc;
+    for (uint32_t i = 0; i < len; i++) {
+        crc ^= buf[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & (0U - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+/**
+ * @brief Случайное число (xorshift32)
+ */
+uint32_t esp_random(void)
+{
+    taskENTER_CRITICAL(&sys_lock);
+    uint32_t x = sys.random_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    sys.random_state = x;
+    taskEXIT_CRITICAL(&sys_lock);
+    return x;
+}
+
+/**
+ * @brief Начальное значение генератора случайных чисел
+ */
+void fake_random_seed(uint32_t seed)
+{
+    sys.random_state = seed != 0 ? seed : 0x12345678;
+}
+
+/**
+ * @brief Причина сброса
+ */
+esp_reset_reason_t esp_reset_reason(void)
+{
+    return sys.reset_reason;
+}
+
+/**
+ * @brief Причина пробуждения
+ */
+esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause(void)
+{
+    return sys.wakeup_cause;
+}
+
+/**
+ * @brief Причина сброса и пробуждения для текущего запуска
+ */
+void fake_system_set_boot_reason(esp_reset_reason_t reason, esp_sleep_wakeup_cause_t wakeup_cause)
+{
+    sys.reset_reason = reason;
+    sys.wakeup_cause = wakeup_cause;
+}
+
+/**
+ * @brief Регистрация обработчика перезагрузки
+ */
+esp_err_t esp_register_shutdown_handler(shutdown_handler_t handler)
+{
+    for (int i = 0; i < FAKE_MAX_SHUTDOWN_HANDLERS; i++) {
+        if (sys.shutdown_handlers[i] == NULL) {
+            sys.shutdown_handlers[i] = handler;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+/**
+ * @brief Удаление обработчика перезагрузки
+ */
+esp_err_t esp_unregister_shutdown_handler(shutdown_handler_t handler)
+{
+    for (int i = 0; i < FAKE_MAX_SHUTDOWN_HANDLERS; i++) {
+        if (sys.shutdown_handlers[i] == handler) {
+            sys.shutdown_handlers[i] = NULL;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_INVALID_STATE;
+}
+
+/**
+ * @brief Завершение имитируемого запуска
+ */
+void fake_exit_boot(int code)
+{
+    fflush(stdout);
+    fflush(stderr);
+    _exit(code);
+}
+
+/**
+ * @brief Программная перезагрузка
+ */
+void esp_restart(void)
+{
+    for (int i = FAKE_MAX_SHUTDOWN_HANDLERS - 1; i >= 0; i--) {
+        if (sys.shutdown_handlers[i] != NULL) {
+            sys.shutdown_handlers[i]();
+        }
+    }
+    
+    fake_rtc_save();
+    fake_exit_boot(FAKE_EXIT_RESTART);
+}
+
+/**
+ * @brief Пробуждение по таймеру
+ */
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t time_in_us)
+{
+    sys.sleep_timer_us = time_in_us;
+    return ESP_OK;
+}
+
+/**
+ * @brief Пробуждение по уровню GPIO
+ */
+esp_err_t esp_sleep_enable_ext1_wakeup(uint64_t io_mask, esp_sleep_ext1_wakeup_mode_t mode)
+{
+    return ESP_OK;
+}
+
+/**
+ * @brief Запрошенное перед сном время пробуждения по таймеру
+ */
+uint64_t fake_sleep_timer_wakeup_us(void)
+{
+    return sys.sleep_timer_us;
+}
+
+/**
+ * @brief Переход в глубокий сон
+ */
+void esp_deep_sleep_start(void)
+{
+    fake_rtc_save();
+    fake_exit_boot(FAKE_EXIT_DEEP_SLEEP);
+}
+
+/**
+ * @brief Подключение файла RTC-памяти
+ */
+void fake_rtc_attach(const char *path)
+{
+    strncpy(sys.rtc_path, path, sizeof(sys.rtc_path) - 1);
+    
+    if (__start_rtc_noinit == NULL || __stop_rtc_noinit == NULL) {
+        return;
+    }
+    
+    size_t size = (size_t)(__stop_rtc_noinit - __start_rtc_noinit);
+    bool retained = sys.reset_reason == ESP_RST_DEEPSLEEP || sys.reset_reason == ESP_RST_SW ||
+                    sys.reset_reason == ESP_RST_PANIC;
+    
+    FILE *file = retained ? fopen(path, "rb") : NULL;
+    if (file != NULL && fread(__start_rtc_noinit, 1, size, file) == size) {
+        fclose(file);
+        return;
+    }
+    if (file != NULL) {
+        fclose(file);
+    }
+    
+    // После включения питания содержимое RTC-памяти не определено
+    for (size_t i = 0; i < size; i++) {
+        __start_rtc_noinit[i] = (uint8_t)esp_random();
+    }
+}
+
+/**
+ * @brief Запись RTC-памяти в файл
+ */
+void fake_rtc_save(void)
+{
+    if (sys.rtc_path[0] == '\0' || __start_rtc_noinit == NULL || __stop_rtc_noinit == NULL) {
+        return;
+    }
+    
+    FILE *file = fopen(sys.rtc_path, "wb");
+    if (file != NULL) {
+        fwrite(__start_rtc_noinit, 1, (size_t)(__stop_rtc_noinit - __start_rtc_noinit), file);
+        fclose(file);
+    }
+}
+
+/**
+ * @brief Выполнение одного запуска устройства в отдельном процессе
+ */
+int fake_run_boot(void (*boot)(void *arg), void *arg)
+{
+    fflush(stdout);
+    fflush(stderr);
+    
+    pid_t pid = fork();
+    if (pid < 0) {
+        return -1;
+    }
+    
+    if (pid == 0) {
+        boot(arg);
+        fake_exit_boot(0);
+    }
+    
+    int status;
+    if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status)) {
+        return -1;
+    }
+    return WEXITSTATUS(status);
+}
@@ -0,0 +1,375 @@
+/**
+ * @file fake_timer.c
+ * @brief Служба таймеров: esp_timer и программные таймеры FreeRTOS
+ * 
+ * Все таймеры обслуживаются одним потоком; колбэки вызываются без
+ * блокировки службы, поэтому из них можно перезапускать таймеры.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/timers.h"
+#include "fake_internal.h"
+
+// Таймер esp_timer или FreeRTOS
+struct fake_timer {
+    bool rtos;                              // Программный таймер FreeRTOS
+    esp_timer_cb_t esp_callback;            // Колбэк esp_timer
+    void *arg;                              // Аргумент колбэка esp_timer
+    TimerCallbackFunction_t rtos_callback;  // Колбэк таймера FreeRTOS
+    void *id;                               // Идентификатор таймера FreeRTOS
+    int64_t period_us;                      // Период (для однократного - задержка)
+    bool periodic;                          // Периодический таймер
+    bool active;                            // Таймер запущен
+    bool deleted;                           // Таймер удален
+    int64_t expiry_us;                      // Время срабатывания
+    struct fake_timer *next;                // Следующий таймер службы
+};
+
+// Служба таймеров
+static struct {
+    pthread_once_t once;
+    fake_waitable_t wait;
+    struct fake_timer *timers;
+} service = {
+    .once = PTHREAD_ONCE_INIT,
+    .timers = NULL
+};
+
+static pthread_once_t base_once = PTHREAD_ONCE_INIT;
+static struct timespec time_base;
+
+/**
+ * @brief Фиксация начала отсчета времени
+ */
+static void fake_time_init(void)
+{
+    clock_gettime(CLOCK_MONOTONIC, &time_base);
+}
+
+/**
+ * @brief Время с начала запуска (мкс)
+ */
+int64_t fake_time_now_us(void)
+{
+    struct timespec now;
+    
+    pthread_once(&base_once, fake_time_init);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)(now.tv_sec - time_base.tv_sec) * 1000000 + (now.tv_nsec - time_base.tv_nsec) / 1000;
+}
+
+/**
+ * @brief Перевод времени запуска в абсолютное время монотонных часов
+ */
+static void fake_time_to_timespec(int64_t time_us, struct timespec *ts)
+{
+    int64_t ns = (int64_t)time_base.tv_nsec + (time_us % 1000000) * 1000;
+    
+    ts->tv_sec = time_base.tv_sec + (time_t)(time_us / 1000000) + (time_t)(ns / 1000000000);
+    ts->tv_nsec = (long)(ns % 1000000000);
+}
+
+/**
+ * @brief Поток службы таймеров
+ */
+static void *fake_timer_service(void *arg)
+{
+    pthread_mutex_lock(&service.wait.lock);
+    
+    for (;;) {
+        struct fake_timer *next = NULL;
+        for (struct fake_timer *timer = service.timers; timer != NULL; timer = timer->next) {
+            if (timer->active && (next == NULL || timer->expiry_us < next->expiry_us)) {
+                next = timer;
+            }
+        }
+        
+        if (next == NULL) {
+            pthread_cond_wait(&service.wait.cond, &service.wait.lock);
+            continue;
+        }
+        
+        if (next->expiry_us > fake_time_now_us()) {
+            struct timespec deadline;
+            fake_time_to_timespec(next->expiry_us, &deadline);
+            pthread_cond_timedwait(&service.wait.cond, &service.wait.lock, &deadline);
+            continue;
+        }
+        
+        if (next->periodic) {
+            next->expiry_us += next->period_us;
+        } else {
+            next->active = false;
+        }
+        
+        pthread_mutex_unlock(&service.wait.lock);
+        if (next->rtos) {
+            next->rtos_callback(next);
+        } else {
+            next->esp_callback(next->arg);
+        }
+        pthread_mutex_lock(&service.wait.lock);
+    }
+    
+    return NULL;
+}
+
+/**
+ * @brief Запуск потока службы таймеров
+ */
+static void fake_timer_service_start(void)
+{
+    pthread_t thread;
+    
+    pthread_once(&base_once, fake_time_init);
+    fake_waitable_init(&service.wait);
+    pthread_create(&thread, NULL, fake_timer_service, NULL);
+    pthread_detach(thread);
+}
+
+/**
+ * @brief Создание таймера и регистрация в службе
+ */
+static struct fake_timer *fake_timer_create(void)
+{
+    pthread_once(&service.once, fake_timer_service_start);
+    
+    struct fake_timer *timer = calloc(1, sizeof(struct fake_timer));
+    if (timer == NULL) {
+        return NULL;
+    }
+    
+    pthread_mutex_lock(&service.wait.lock);
+    timer->next = service.timers;
+    service.timers = timer;
+    pthread_mutex_unlock(&service.wait.lock);
+    
+    return timer;
+}
+
+/**
+ * @brief Запуск таймера
+ */
+static void fake_timer_arm(struct fake_timer *timer, int64_t period_us, bool periodic)
+{
+    pthread_mutex_lock(&service.wait.lock);
+    timer->period_us = period_us;
+    timer->periodic = periodic;
+    timer->expiry_us = fake_time_now_us() + period_us;
+    timer->active = !timer->deleted;
+    pthread_cond_broadcast(&service.wait.cond);
+    pthread_mutex_unlock(&service.wait.lock);
+}
+
+/**
+ * @brief Остановка таймера
+ * 
+ * @return true, если таймер был запущен
+ */
+static bool fake_timer_disarm(struct fake_timer *timer, bool delete_timer)
+{
+    pthread_mutex_lock(&service.wait.lock);
+    bool was_active = timer->active;
+    timer->active = false;
+    if (delete_timer) {
+        // Объект не освобождается: его колбэк может выполняться в этот момент
+        timer->deleted = true;
+    }
+    pthread_mutex_unlock(&service.wait.lock);
+    
+    return was_active;
+}
+
+/**
+ * @brief Создание таймера esp_timer
+ */
+esp_err_t esp_timer_create(const esp_timer_create_args_t *create_args, esp_timer_handle_t *out_handle)
+{
+    if (create_args == NULL || create_args->callback == NULL || out_handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    struct fake_timer *timer = fake_timer_create();
+    if (timer == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    
+    timer->esp_callback = create_args->callback;
+    timer->arg = create_args->arg;
+    *out_handle = timer;
+    return ESP_OK;
+}
+
+/**
+ * @brief Однократный запуск таймера esp_timer
+ */
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    if (timer == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    if (esp_timer_is_active(timer)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    fake_timer_arm(timer, (int64_t)timeout_us, false);
+    return ESP_OK;
+}
+
+/**
+ * @brief Периодический запуск таймера esp_timer
+ */
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period)
+{
+    if (timer == NULL || period == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    if (esp_timer_is_active(timer)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    fake_timer_arm(timer, (int64_t)period, true);
+    return ESP_OK;
+}
+
+/**
+ * @brief Остановка таймера esp_timer
+ */
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    if (timer == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    return fake_timer_disarm(timer, false) ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+/**
+ * @brief Удаление таймера esp_timer
+ */
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    if (timer == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    if (esp_timer_is_active(timer)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    fake_timer_disarm(timer, true);
+    return ESP_OK;
+}
+
+/**
+ * @brief Проверка, что таймер esp_timer запущен
+ */
+bool esp_timer_is_active(esp_timer_handle_t timer)
+{
+    pthread_mutex_lock(&service.wait.lock);
+    bool active = timer->active;
+    pthread_mutex_unlock(&service.wait.lock);
+    return active;
+}
+
+/**
+ * @brief Время с начала запуска (мкс)
+ */
+int64_t esp_timer_get_time(void)
+{
+    return fake_time_now_us();
+}
+
+/**
+ * @brief Создание программного таймера FreeRTOS
+ */
+TimerHandle_t xTimerCreate(const char *name, TickType_t period, UBaseType_t auto_reload, void *timer_id,
+                           TimerCallbackFunction_t callback)
+{
+    if (callback == NULL || period == 0) {
+        return NULL;
+    }
+    
+    struct fake_timer *timer = fake_timer_create();
+    if (timer == NULL) {
+        return NULL;
+    }
+    
+    timer->rtos = true;
+    timer->rtos_callback = callback;
+    timer->id = timer_id;
+    timer->period_us = (int64_t)pdTICKS_TO_MS(period) * 1000;
+    timer->periodic = auto_reload != pdFALSE;
+    return timer;
+}
+
+/**
+ * @brief Запуск программного таймера
+ */
+BaseType_t xTimerStart(TimerHandle_t timer, TickType_t ticks_to_wait)
+{
+    fake_timer_arm(timer, timer->period_us, timer->periodic);
+    return pdPASS;
+}
+
+/**
+ * @brief Остановка программного таймера
+ */
+BaseType_t xTimerStop(TimerHandle_t timer, TickType_t ticks_to_wait)
+{
+    fake_timer_disarm(timer, false);
+    return pdPASS;
+}
+
+/**
+ * @brief Перезапуск программного таймера
+ */
+BaseType_t xTimerReset(TimerHandle_t timer, TickType_t ticks_to_wait)
+{
+    return xTimerStart(timer, ticks_to_wait);
+}
+
+/**
+ * @brief Изменение периода и запуск программного таймера
+ */
+BaseType_t xTimerChangePeriod(TimerHandle_t timer, TickType_t new_period, TickType_t ticks_to_wait)
+{
+    if (new_period == 0) {
+        return pdFAIL;
+    }
+    
+    fake_timer_arm(timer, (int64_t)pdTICKS_TO_MS(new_period) * 1000, timer->periodic);
+    return pdPASS;
+}
+
+/**
+ * @brief Удаление программного таймера
+ */
+BaseType_t xTimerDelete(TimerHandle_t timer, TickType_t ticks_to_wait)
+{
+    fake_timer_disarm(timer, true);
+    return pdPASS;
+}
+
+/**
+ * @brief Проверка, что программный таймер запущен
+ */
+BaseType_t xTimerIsTimerActive(TimerHandle_t timer)
+{
+    return esp_timer_is_active(timer) ? pdTRUE : pdFALSE;
+}
+
+/**
+ * @brief Идентификатор программного таймера
+ */
+void *pvTimerGetTimerID(TimerHandle_t timer)
+{
+    return timer->id;
+}
@@ -0,0 +1,807 @@
+/**
+ * @file freertos_shim.c
+ * @brief Задачи, очереди, семафоры и группы событий FreeRTOS поверх потоков POSIX
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+#include "fake_internal.h"
+
+// Задача: поток и значение уведомления
+struct fake_task {
+    pthread_t thread;
+    TaskFunction_t code;
+    void *parameters;
+    char name[16];
+    fake_waitable_t wait;
+    uint32_t notify_value;
+    bool notify_pending;
+};
+
+// Очередь: кольцевой буфер элементов
+struct fake_queue {
+    fake_waitable_t wait;
+    uint8_t *storage;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t head;
+    UBaseType_t count;
+};
+
+// Семафор; мьютекс - двоичный семафор, изначально свободный
+struct fake_semaphore {
+    fake_waitable_t wait;
+    UBaseType_t count;
+    UBaseType_t max_count;
+};
+
+// Группа событий
+struct fake_event_group {
+    fake_waitable_t wait;
+    EventBits_t bits;
+};
+
+// Общая блокировка критических секций
+static pthread_mutex_t critical_lock = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+
+// Задача текущего потока (создается при первом обращении для потоков, созданных не xTaskCreate)
+static __thread struct fake_task *current_task = NULL;
+
+/**
+ * @brief Инициализация объекта ожидания на монотонных часах
+ */
+void fake_waitable_init(fake_waitable_t *waitable)
+{
+    pthread_condattr_t attr;
+    
+    pthread_mutex_init(&waitable->lock, NULL);
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&waitable->cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+/**
+ * @brief Освобождение объекта ожидания
+ */
+void fake_waitable_destroy(fake_waitable_t *waitable)
+{
+    pthread_cond_destroy(&waitable->cond);
+    pthread_mutex_destroy(&waitable->lock);
+}
+
+/**
+ * @brief Момент окончания ожидания в тиках
+ */
+void fake_deadline_from_ticks(struct timespec *deadline, TickType_t ticks)
+{
+    clock_gettime(CLOCK_MONOTONIC, deadline);
+    
+    uint64_t ns = (uint64_t)pdTICKS_TO_MS(ticks) * 1000000ULL + (uint64_t)deadline->tv_nsec;
+    deadline->tv_sec += (time_t)(ns / 1000000000ULL);
+    deadline->tv_nsec = (long)(ns % 1000000000ULL);
+}
+
+/**
+ * @brief Ожидание сигнала объекта (вызывается под waitable->lock)
+ * 
+ * @return false, если срок ожидания истек
+ */
+bool fake_waitable_wait(fake_waitable_t *waitable, TickType_t ticks, const struct timespec *deadline)
+{
+    if (ticks == 0) {
+        return false;
+    }
+    
+    if (ticks == portMAX_DELAY) {
+        pthread_cond_wait(&waitable->cond, &waitable->lock);
+        return true;
+    }
+    
+    return pthread_cond_timedwait(&waitable->cond, &waitable->lock, deadline) != ETIMEDOUT;
+}
+
+/**
+ * @brief Вход в критическую секцию
+ */
+void fake_critical_enter(void)
+{
+    pthread_mutex_lock(&critical_lock);
+}
+
+/**
+ * @brief Выход из критической секции
+ */
+void fake_critical_exit(void)
+{
+    pthread_mutex_unlock(&critical_lock);
+}
+
+/**
+ * @brief Точка входа потока задачи
+ */
+static void *fake_task_entry(void *arg)
+{
+    struct fake_task *task = (struct fake_task *)arg;
+    
+    current_task = task;
+    task->code(task->parameters);
+    
+    // Задача FreeRTOS не должна возвращаться; на хосте поток просто завершается
+    return NULL;
+}
+
+/**
+ * @brief Создание задачи
+ */
+BaseType_t xTaskCreate(TaskFunction_t task_code, const char *name, uint32_t stack_depth,
+                       void *parameters, UBaseType_t priority, TaskHandle_t *created_task)
+{
+    struct fake_task *task = calloc(1, sizeof(struct fake_task));
+    if (task == NULL) {
+        return pdFAIL;
+    }
+    
+    task->code = task_code;
+    task->parameters = parameters;
+    strncpy(task->name, name != NULL ? name : "", sizeof(task->name) - 1);
+    fake_waitable_init(&task->wait);
+    
+    // Указатель на задачу должен быть известен до ее первого шага
+    if (created_task != NULL) {
+        *created_task = task;
+    }
+    
+    if (pthread_create(&task->thread, NULL, fake_task_entry, task) != 0) {
+        if (created_task != NULL) {
+            *created_task = NULL;
+        }
+        fake_waitable_destroy(&task->wait);
+        free(task);
+        return pdFAIL;
+    }
+    pthread_detach(task->thread);
+    
+    return pdPASS;
+}
+
+/**
+ * @brief Создание задачи на заданном ядре
+ */
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task_code, const char *name, uint32_t stack_depth,
+                                   void *parameters, UBaseType_t priority, TaskHandle_t *created_task,
+                                   BaseType_t core_id)
+{
+    return xTaskCreate(task_code, name, stack_depth, parameters, priority, created_task);
+}
+
+/**
+ * @brief Удаление задачи
+ * 
+ * Удалить можно только текущую задачу; объект задачи не освобождается,
+ * так как на него могут ссылаться другие задачи.
+ */
+void vTaskDelete(TaskHandle_t task)
+{
+    if (task == NULL || task == current_task) {
+        pthread_exit(NULL);
+    }
+}
+
+/**
+ * @brief Задержка задачи
+ */
+void vTaskDelay(TickType_t ticks)
+{
+    struct timespec deadline;
+    
+    fake_deadline_from_ticks(&deadline, ticks);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR) {
+    }
+}
+
+/**
+ * @brief Передача процессора другим задачам
+ */
+void fake_task_yield(void)
+{
+    sched_yield();
+}
+
+/**
+ * @brief Задержка до заданного момента
+ */
+void vTaskDelayUntil(TickType_t *previous_wake_time, TickType_t time_increment)
+{
+    TickType_t wake_time = *previous_wake_time + time_increment;
+    TickType_t now = xTaskGetTickCount();
+    
+    if ((int32_t)(wake_time - now) > 0) {
+        vTaskDelay(wake_time - now);
+    }
+    *previous_wake_time = wake_time;
+}
+
+/**
+ * @brief Счетчик тиков с начала запуска
+ */
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(fake_time_now_us() / (1000000 / configTICK_RATE_HZ));
+}
+
+/**
+ * @brief Задача текущего потока
+ */
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    if (current_task == NULL) {
+        current_task = calloc(1, sizeof(struct fake_task));
+        if (current_task != NULL) {
+            current_task->thread = pthread_self();
+            strncpy(current_task->name, "main", sizeof(current_task->name) - 1);
+            fake_waitable_init(&current_task->wait);
+        }
+    }
+    return current_task;
+}
+
+/**
+ * @brief Имя задачи
+ */
+const char *pcTaskGetName(TaskHandle_t task)
+{
+    if (task == NULL) {
+        task = xTaskGetCurrentTaskHandle();
+    }
+    return task->name;
+}
+
+/**
+ * @brief Ожидание уведомления как счетного семафора
+ */
+uint32_t ulTaskNotifyTake(BaseType_t clear_count_on_exit, TickType_t ticks_to_wait)
+{
+    struct fake_task *task = xTaskGetCurrentTaskHandle();
+    struct timespec deadline;
+    uint32_t value;
+    
+    fake_deadline_from_ticks(&deadline, ticks_to_wait);
+    
+    pthread_mutex_lock(&task->wait.lock);
+    while (task->notify_value == 0 && fake_waitable_wait(&task->wait, ticks_to_wait, &deadline)) {
+    }
+    
+    value = task->notify_value;
+    if (value > 0) {
+        task->notify_value = clear_count_on_exit ? 0 : value - 1;
+    }
+    task->notify_pending = false;
+    pthread_mutex_unlock(&task->wait.lock);
+    
+    return value;
+}
+
+/**
+ * @brief Уведомление задачи с увеличением значения
+ */
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    return xTaskNotify(task, 0, eIncrement);
+}
+
+/**
+ * @brief Уведомление задачи из прерывания
+ */
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higher_priority_task_woken)
+{
+    xTaskNotifyGive(task);
+    if (higher_priority_task_woken != NULL) {
+        *higher_priority_task_woken = pdFALSE;
+    }
+}
+
+/**
+ * @brief Уведомление задачи
+ */
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action)
+{
+    BaseType_t result = pdPASS;
+    
+    if (task == NULL) {
+        return pdFAIL;
+    }
+    
+    pthread_mutex_lock(&task->wait.lock);
+    switch (action) {
+        case eSetBits:
+            task->notify_value |= value;
+            break;
+        case eIncrement:
+            task->notify_value++;
+            break;
+        case eSetValueWithOverwrite:
+            task->notify_value = value;
+            break;
+        case eSetValueWithoutOverwrite:
+            if (task->notify_pending) {
+                result = pdFAIL;
+            } else {
+                task->notify_value = value;
+            }
+            break;
+        case eNoAction:
+        default:
+            break;
+    }
+    task->notify_pending = true;
+    pthread_cond_broadcast(&task->wait.cond);
+    pthread_mutex_unlock(&task->wait.lock);
+    
+    return result;
+}
+
+/**
+ * @brief Уведомление задачи из прерывания
+ */
+BaseType_t xTaskNotifyFromISR(TaskHandle_t task, uint32_t value, eNotifyAction action,
+                              BaseType_t *higher_priority_task_woken)
+{
+    if (higher_priority_task_woken != NULL) {
+        *higher_priority_task_woken = pdFALSE;
+    }
+    return xTaskNotify(task, value, action);
+}
+
+/**
+ * @brief Ожидание уведомления со значением
+ */
+BaseType_t xTaskNotifyWait(uint32_t bits_to_clear_on_entry, uint32_t bits_to_clear_on_exit,
+                           uint32_t *notification_value, TickType_t ticks_to_wait)
+{
+    struct fake_task *task = xTaskGetCurrentTaskHandle();
+    struct timespec deadline;
+    BaseType_t result;
+    
+    fake_deadline_from_ticks(&deadline, ticks_to_wait);
+    
+    pthread_mutex_lock(&task->wait.lock);
+    if (!task->notify_pending) {
+        task->notify_value &= ~bits_to_clear_on_entry;
+    }
+    while (!task->notify_pending && fake_waitable_wait(&task->wait, ticks_to_wait, &deadline)) {
+    }
+    
+    if (notification_value != NULL) {
+        *notification_value = task->notify_value;
+    }
+    result = task->notify_pending ? pdPASS : pdFAIL;
+    if (task->notify_pending) {
+        task->notify_value &= ~bits_to_clear_on_exit;
+        task->notify_pending = false;
+    }
+    pthread_mutex_unlock(&task->wait.lock);
+    
+    return result;
+}
+
+/**
+ * @brief Создание очереди
+ */
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    struct fake_queue *queue = calloc(1, sizeof(struct fake_queue));
+    if (queue == NULL) {
+        return NULL;
+    }
+    
+    queue->storage = calloc(length, item_size > 0 ? item_size : 1);
+    if (queue->storage == NULL) {
+        free(queue);
+        return NULL;
+    }
+    
+    queue->length = length;
+    queue->item_size = item_size;
+    fake_waitable_init(&queue->wait);
+    return queue;
+}
+
+/**
+ * @brief Создание очереди в статическом буфере (буфер не используется)
+ */
+QueueHandle_t xQueueCreateStatic(UBaseType_t length, UBaseType_t item_size, uint8_t *storage,
+                                 StaticQueue_t *queue_buffer)
+{
+    return xQueueCreate(length, item_size);
+}
+
+/**
+ * @brief Удаление очереди
+ */
+void vQueueDelete(QueueHandle_t queue)
+{
+    if (queue == NULL) {
+        return;
+    }
+    
+    fake_waitable_destroy(&queue->wait);
+    free(queue->storage);
+    free(queue);
+}
+
+/**
+ * @brief Помещение элемента в начало или конец очереди
+ */
+static BaseType_t fake_queue_send(QueueHandle_t queue, const void *item, TickType_t ticks_to_wait,
+                                  bool to_front, bool overwrite)
+{
+    struct timespec deadline;
+    
+    fake_deadline_from_ticks(&deadline, ticks_to_wait);
+    
+    pthread_mutex_lock(&queue->wait.lock);
+    while (!overwrite && queue->count >= queue->length &&
+           fake_waitable_wait(&queue->wait, ticks_to_wait, &deadline)) {
+    }
+    
+    if (overwrite && queue->count >= queue->length) {
+        queue->count = 0;
+    }
+    
+    if (queue->count >= queue->length) {
+        pthread_mutex_unlock(&queue->wait.lock);
+        return errQUEUE_FULL;
+    }
+    
+    UBaseType_t index;
+    if (to_front) {
+        queue->head = (queue->head + queue->length - 1) % queue->length;
+        index = queue->head;
+    } else {
+        index = (queue->head + queue->count) % queue->length;
+    }
+    memcpy(queue->storage + index * queue->item_size, item, queue->item_size);
+    queue->count++;
+    
+    pthread_cond_broadcast(&queue->wait.cond);
+    pthread_mutex_unlock(&queue->wait.lock);
+    return pdPASS;
+}
+
+/**
+ * @brief Помещение элемента в конец очереди
+ */
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks_to_wait)
+{
+    return fake_queue_send(queue, item, ticks_to_wait, false, false);
+}
+
+/**
+ * @brief Помещение элемента в конец очереди
+ */
+BaseType_t xQueueSendToBack(QueueHandle_t queue, const void *item, TickType_t ticks_to_wait)
+{
+    return fake_queue_send(queue, item, ticks_to_wait, false, false);
+}
+
+/**
+ * @brief Помещение элемента в начало очереди
+ */
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void *item, TickType_t ticks_to_wait)
+{
+    return fake_queue_send(queue, item, ticks_to_wait, true, false);
+}
+
+/**
+ * @brief Помещение элемента в очередь из прерывания
+ */
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void *item, BaseType_t *higher_priority_task_woken)
+{
+    if (higher_priority_task_woken != NULL) {
+        *higher_priority_task_woken = pdFALSE;
+    }
+    return fake_queue_send(queue, item, 0, false, false);
+}
+
+/**
+ * @brief Замена содержимого очереди длины 1
+ */
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void *item)
+{
+    return fake_queue_send(queue, item, 0, false, true);
+}
+
+/**
+ * @brief Извлечение или чтение элемента из начала очереди
+ */
+static BaseType_t fake_queue_receive(QueueHandle_t queue, void *buffer, TickType_t ticks_to_wait, bool remove)
+{
+    struct timespec deadline;
+    
+    fake_deadline_from_ticks(&deadline, ticks_to_wait);
+    
+    pthread_mutex_lock(&queue->wait.lock);
+    while (queue->count == 0 && fake_waitable_wait(&queue->wait, ticks_to_wait, &deadline)) {
+    }
+    
+    if (queue->count == 0) {
+        pthread_mutex_unlock(&queue->wait.lock);
+        return errQUEUE_EMPTY;
+    }
+    
+    memcpy(buffer, queue->storage + queue->head * queue->item_size, queue->item_size);
+    if (remove) {
+        queue->head = (queue->head + 1) % queue->length;
+        queue->count--;
+        pthread_cond_broadcast(&queue->wait.cond);
+    }
+    
+    pthread_mutex_unlock(&queue->wait.lock);
+    return pdPASS;
+}
+
+/**
+ * @brief Извлечение элемента из очереди
+ */
+BaseType_t xQueueReceive(QueueHandle_t queue, void *buffer, TickType_t ticks_to_wait)
+{
+    return fake_queue_receive(queue, buffer, ticks_to_wait, true);
+}
+
+/**
+ * @brief Чтение элемента без извлечения
+ */
+BaseType_t xQueuePeek(QueueHandle_t queue, void *buffer, TickType_t ticks_to_wait)
+{
+    return fake_queue_receive(queue, buffer, ticks_to_wait, false);
+}
+
+/**
+ * @brief Очистка очереди
+ */
+BaseType_t xQueueReset(QueueHandle_t queue)
+{
+    pthread_mutex_lock(&queue->wait.lock);
+    queue->head = 0;
+    queue->count = 0;
+    pthread_cond_broadcast(&queue->wait.cond);
+    pthread_mutex_unlock(&queue->wait.lock);
+    return pdPASS;
+}
+
+/**
+ * @brief Число элементов в очереди
+ */
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    pthread_mutex_lock(&queue->wait.lock);
+    UBaseType_t count = queue->count;
+    pthread_mutex_unlock(&queue->wait.lock);
+    return count;
+}
+
+/**
+ * @brief Число свободных мест в очереди
+ */
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue)
+{
+    pthread_mutex_lock(&queue->wait.lock);
+    UBaseType_t spaces = queue->length - queue->count;
+    pthread_mutex_unlock(&queue->wait.lock);
+    return spaces;
+}
+
+/**
+ * @brief Создание семафора
+ */
+static SemaphoreHandle_t fake_semaphore_create(UBaseType_t max_count, UBaseType_t initial_count)
+{
+    struct fake_semaphore *semaphore = calloc(1, sizeof(struct fake_semaphore));
+    if (semaphore == NULL) {
+        return NULL;
+    }
+    
+    semaphore->count = initial_count;
+    semaphore->max_count = max_count;
+    fake_waitable_init(&semaphore->wait);
+    return semaphore;
+}
+
+/**
+ * @brief Создание мьютекса
+ */
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return fake_semaphore_create(1, 1);
+}
+
+/**
+ * @brief Создание мьютекса в заданной памяти (память не используется)
+ */
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t *mutex_buffer)
+{
+    return xSemaphoreCreateMutex();
+}
+
+/**
+ * @brief Создание двоичного семафора
+ */
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return fake_semaphore_create(1, 0);
+}
+
+/**
+ * @brief Создание счетного семафора
+ */
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial_count)
+{
+    return fake_semaphore_create(max_count, initial_count);
+}
+
+/**
+ * @brief Удаление семафора
+ */
+void vSemaphoreDelete(SemaphoreHandle_t semaphore)
+{
+    if (semaphore == NULL) {
+        return;
+    }
+    
+    fake_waitable_destroy(&semaphore->wait);
+    free(semaphore);
+}
+
+/**
+ * @brief Захват семафора
+ */
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks_to_wait)
+{
+    struct timespec deadline;
+    
+    fake_deadline_from_ticks(&deadline, ticks_to_wait);
+    
+    pthread_mutex_lock(&semaphore->wait.lock);
+    while (semaphore->count == 0 && fake_waitable_wait(&semaphore->wait, ticks_to_wait, &deadline)) {
+    }
+    
+    BaseType_t result = pdFAIL;
+    if (semaphore->count > 0) {
+        semaphore->count--;
+        result = pdPASS;
+    }
+    pthread_mutex_unlock(&semaphore->wait.lock);
+    
+    return result;
+}
+
+/**
+ * @brief Освобождение семафора
+ */
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+    BaseType_t result = pdFAIL;
+    
+    pthread_mutex_lock(&semaphore->wait.lock);
+    if (semaphore->count < semaphore->max_count) {
+        semaphore->count++;
+        result = pdPASS;
+        pthread_cond_broadcast(&semaphore->wait.cond);
+    }
+    pthread_mutex_unlock(&semaphore->wait.lock);
+    
+    return result;
+}
+
+/**
+ * @brief Освобождение семафора из прерывания
+ */
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t semaphore, BaseType_t *higher_priority_task_woken)
+{
+    if (higher_priority_task_woken != NULL) {
+        *higher_priority_task_woken = pdFALSE;
+    }
+    return xSemaphoreGive(semaphore);
+}
+
+/**
+ * @brief Создание группы событий
+ */
+EventGroupHandle_t xEventGroupCreate(void)
+{
+    struct fake_event_group *group = calloc(1, sizeof(struct fake_event_group));
+    if (group == NULL) {
+        return NULL;
+    }
+    
+    fake_waitable_init(&group->wait);
+    return group;
+}
+
+/**
+ * @brief Удаление группы событий
+ */
+void vEventGroupDelete(EventGroupHandle_t group)
+{
+    if (group == NULL) {
+        return;
+    }
+    
+    fake_waitable_destroy(&group->wait);
+    free(group);
+}
+
+/**
+ * @brief Установка битов группы событий
+ */
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    pthread_mutex_lock(&group->wait.lock);
+    group->bits |= bits;
+    EventBits_t result = group->bits;
+    pthread_cond_broadcast(&group->wait.cond);
+    pthread_mutex_unlock(&group->wait.lock);
+    return result;
+}
+
+/**
+ * @brief Сброс битов группы событий
+ */
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    pthread_mutex_lock(&group->wait.lock);
+    EventBits_t result = group->bits;
+    group->bits &= ~bits;
+    pthread_mutex_unlock(&group->wait.lock);
+    return result;
+}
+
+/**
+ * @brief Текущие биты группы событий
+ */
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group)
+{
+    pthread_mutex_lock(&group->wait.lock);
+    EventBits_t result = group->bits;
+    pthread_mutex_unlock(&group->wait.lock);
+    return result;
+}
+
+/**
+ * @brief Ожидание битов группы событий
+ */
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear_on_exit,
+                                BaseType_t wait_for_all, TickType_t ticks_to_wait)
+{
+    struct timespec deadline;
+    
+    fake_deadline_from_ticks(&deadline, ticks_to_wait);
+    
+    pthread_mutex_lock(&group->wait.lock);
+    for (;;) {
+        EventBits_t set = group->bits & bits;
+        bool satisfied = wait_for_all ? (set == bits) : (set != 0);
+        if (satisfied || !fake_waitable_wait(&group->wait, ticks_to_wait, &deadline)) {
+            break;
+        }
+    }
+    
+    EventBits_t result = group->bits;
+    EventBits_t set = result & bits;
+    if (clear_on_exit && (wait_for_all ? (set == bits) : (set != 0))) {
+        group->bits &= ~bits;
+    }
+    pthread_mutex_unlock(&group->wait.lock);
+    
+    return result;
+}
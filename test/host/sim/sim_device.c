@@ -0,0 +1,175 @@
+/**
+ * @file sim_device.c
+ * @brief Запуск устройства на хосте в порядке init_device() из main.c
+ */
+
+#include <stdio.h>
+#include "sim_device.h"
+#include "sim_servo.h"
+#include "host_test.h"
+#include "fake_host.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "device_config.h"
+#include "state_management.h"
+#include "state_journal.h"
+#include "event_history.h"
+#include "retained_state.h"
+#include "servo_control.h"
+#include "zigbee_handler.h"
+#include "schedule.h"
+
+#define SIM_DEVICE_JOURNAL_SECTOR_SIZE  4096
+#define SIM_DEVICE_JOURNAL_SECTORS      3
+
+// Источник питания при загрузке
+static bool sim_device_mains_powered = false;
+
+/**
+ * @brief Имя файла памяти устройства
+ */
+static void sim_device_file(char *path, size_t size, const char *files, const char *suffix)
+{
+    snprintf(path, size, "%s_%s.bin", files, suffix);
+}
+
+/**
+ * @brief Подключение памяти устройства и инициализация модулей
+ */
+bool sim_device_boot(const char *files, esp_reset_reason_t reason, esp_sleep_wakeup_cause_t wakeup_cause)
+{
+    char path[128];
+    
+    fake_system_set_boot_reason(reason, wakeup_cause);
+    sim_device_file(path, sizeof(path), files, "rtc");
+    fake_rtc_attach(path);
+    sim_device_file(path, sizeof(path), files, "nvs");
+    TEST_ASSERT_ESP_OK(fake_nvs_attach(path));
+    sim_device_file(path, sizeof(path), files, "journal");
+    TEST_ASSERT_ESP_OK(fake_flash_attach(STATE_JOURNAL_PARTITION_LABEL, path,
+                                         SIM_DEVICE_JOURNAL_SECTOR_SIZE * SIM_DEVICE_JOURNAL_SECTORS,
+                                         SIM_DEVICE_JOURNAL_SECTOR_SIZE));
+    
+    // Порядок инициализации совпадает с init_device()
+    retained_state_t retained;
+    bool warm_wake = retained_state_restore(&retained);
+    
+    TEST_ASSERT_ESP_OK(device_config_init());
+    TEST_ASSERT_ESP_OK(state_init());
+    TEST_ASSERT_ESP_OK(event_history_init());
+    
+    if (warm_wake) {
+        TEST_ASSERT_ESP_OK(state_restore(retained.window_mode, retained.gap_percentage, retained.calibrated));
+    } else {
+        TEST_ASSERT_ESP_OK(state_load());
+    }
+    
+    servo_position_t position;
+    if (warm_wake) {
+        position = (servo_position_t) {
+            .mode = retained.window_mode,
+            .gap_percentage = retained.gap_percentage,
+            .handle_angle = retained.handle_angle,
+            .gap_angle = retained.gap_angle
+        };
+    } else {
+        device_state_t saved = state_get_current();
+        servo_position_from_state(saved.window_mode, saved.gap_percentage, &position);
+    }
+    TEST_ASSERT_ESP_OK(servo_init(0, 1, &position));
+    
+    zigbee_config_t zigbee_config = {
+        .device_name = "Smart Window",
+        .manufacturer = "Custom",
+        .model = "ESP32-H2-Window-1.0",
+        .dev_type = ZIGBEE_DEVICE_TYPE_COVER,
+        .mains_powered = sim_device_mains_powered,
+        .saved_network = (warm_wake && retained.network_valid) ? &retained.network : NULL
+    };
+    TEST_ASSERT_ESP_OK(zigbee_init(&zigbee_config));
+    
+    if (warm_wake && retained.time_valid) {
+        TEST_ASSERT_ESP_OK(schedule_resume_time(retained.sleep_local_time, retained.local_time));
+    }
+    
+    if (state_is_calibration_required()) {
+        zigbee_request_calibration();
+    }
+    
+    // Запуск сервисов и основной задачи
+    TEST_ASSERT_ESP_OK(zigbee_start());
+    zigbee_request_position_restore();
+    
+    return warm_wake;
+}
+
+/**
+ * @brief Источник питания для следующего запуска
+ */
+void sim_device_set_mains_powered(bool mains_powered)
+{
+    sim_device_mains_powered = mains_powered;
+}
+
+/**
+ * @brief Удаление файлов памяти устройства
+ */
+void sim_device_erase(const char *files)
+{
+    static const char *suffixes[] = { "rtc", "nvs", "journal" };
+    char path[128];
+    
+    for (size_t i = 0; i < sizeof(suffixes) / sizeof(suffixes[0]); i++) {
+        sim_device_file(path, sizeof(path), files, suffixes[i]);
+        remove(path);
+    }
+}
+
+/**
+ * @brief Ожидание отключения сервоприводов
+ */
+bool sim_device_wait_servo_idle(uint32_t timeout_ms)
+{
+    for (uint32_t waited = 0; waited < timeout_ms; waited += 10) {
+        if (!sim_servo_is_enabled()) {
+            return true;
+        }
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    return !sim_servo_is_enabled();
+}
+
+/**
+ * @brief Подготовка к глубокому сну
+ */
+void sim_device_prepare_sleep(void)
+{
+    // Как on_before_sleep(): пробуждение к записи расписания,
+    // копия в RTC-памяти только после записи NVS
+    uint32_t due_in;
+    if (schedule_get_next_due_in(&due_in)) {
+        esp_sleep_enable_timer_wakeup((uint64_t)(due_in > 0 ? due_in : 1) * 1000000);
+    }
+    TEST_ASSERT_ESP_OK(state_save());
+    
+    device_state_t state = state_get_current();
+    retained_state_t retained = {
+        .window_mode = state.window_mode,
+        .gap_percentage = state.gap_percentage,
+        .calibrated = state.calibrated,
+        .handle_angle = servo_get_handle_angle(),
+        .gap_angle = servo_get_gap_angle()
+    };
+    retained.network_valid = zigbee_get_saved_network(&retained.network);
+    retained.time_valid = schedule_get_time(&retained.sleep_local_time);
+    retained_state_store(&retained);
+}
+
+/**
+ * @brief Подготовка к глубокому сну и переход в сон
+ */
+void sim_device_deep_sleep(void)
+{
+    sim_device_prepare_sleep();
+    esp_deep_sleep_start();
+}
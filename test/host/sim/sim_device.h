@@ -0,0 +1,64 @@
+/**
+ * @file sim_device.h
+ * @brief Запуск устройства на хосте в порядке init_device() из main.c
+ * 
+ * Модули main/ работают с имитацией сервоприводов и библиотеки ZigBee;
+ * управление питанием и OTA не запускаются. NVS, раздел журнала и
+ * RTC-память хранятся в файлах с общим префиксом и переживают запуски.
+ */
+
+#ifndef SIM_DEVICE_H
+#define SIM_DEVICE_H
+
+#include <stdbool.h>
+#include "esp_system.h"
+#include "esp_sleep.h"
+
+/**
+ * @brief Подключение памяти устройства и инициализация модулей
+ * 
+ * @param files Префикс файлов NVS, журнала и RTC-памяти
+ * @param reason Причина сброса для этого запуска
+ * @param wakeup_cause Причина пробуждения (для ESP_RST_DEEPSLEEP)
+ * @return bool true, если состояние взято из RTC-памяти (пробуждение из сна)
+ */
+bool sim_device_boot(const char *files, esp_reset_reason_t reason, esp_sleep_wakeup_cause_t wakeup_cause);
+
+/**
+ * @brief Источник питания для следующего sim_device_boot()
+ * 
+ * @param mains_powered true - внешнее питание (роль маршрутизатора)
+ */
+void sim_device_set_mains_powered(bool mains_powered);
+
+/**
+ * @brief Удаление файлов памяти устройства (первое включение)
+ * 
+ * @param files Префикс файлов
+ */
+void sim_device_erase(const char *files);
+
+/**
+ * @brief Ожидание отключения сервоприводов после возврата в сохраненное положение
+ * 
+ * @param timeout_ms Время ожидания, мс
+ * @return bool true, если сервоприводы отключены
+ */
+bool sim_device_wait_servo_idle(uint32_t timeout_ms);
+
+/**
+ * @brief Подготовка к глубокому сну как on_before_sleep() без перехода в сон
+ * 
+ * Взводит таймер пробуждения к записи расписания, записывает NVS и копию
+ * состояния в RTC-память.
+ */
+void sim_device_prepare_sleep(void);
+
+/**
+ * @brief Подготовка к глубокому сну как on_before_sleep() и переход в сон
+ * 
+ * Процесс запуска завершается с кодом FAKE_EXIT_DEEP_SLEEP.
+ */
+void sim_device_deep_sleep(void);
+
+#endif /* SIM_DEVICE_H */
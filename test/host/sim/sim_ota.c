@@ -0,0 +1,13 @@
+/**
+ * @file sim_ota.c
+ * @brief Обработчик команд OTA для тестов на хосте (обновление не имитируется)
+ */
+
+#include "ota_update.h"
+
+/**
+ * @brief Команда сервера OTA Upgrade
+ */
+void ota_handle_zigbee_command(uint8_t cmd_id, const uint8_t *payload, uint16_t len)
+{
+}
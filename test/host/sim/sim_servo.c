@@ -0,0 +1,310 @@
+/**
+ * @file sim_servo.c
+ * @brief Имитация сервоприводов окна для тестов на хосте
+ */
+
+#include "sim_servo.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#define TAG "SIM_SERVO"
+
+// Углы режимов (значения device_config по умолчанию)
+#define SIM_ANGLE_CLOSED    0
+#define SIM_ANGLE_OPEN      90
+#define SIM_ANGLE_VENT      180
+#define SIM_ANGLE_GAP_MAX   90
+
+// Состояние имитации
+static struct {
+    int handle_angle;
+    int gap_angle;
+    bool enabled;
+    bool resistance;
+    uint32_t step_delay_ms;
+    uint32_t move_steps;
+    uint32_t calibrations;
+    bool calibrating;
+    volatile int64_t motion_start_us;
+    volatile int64_t motion_end_us;
+    servo_motion_start_cb_t motion_start_cb;
+} sim;
+
+// Прототипы вспомогательных функций
+static esp_err_t sim_servo_move(int *angle, int target);
+static int sim_servo_mode_angle(window_mode_t mode);
+
+/**
+ * @brief Инициализация сервоприводов
+ */
+esp_err_t servo_init(uint8_t handle_servo_pin, uint8_t gap_servo_pin, const servo_position_t *position)
+{
+    servo_position_t initial = {
+        .mode = WINDOW_MODE_CLOSED,
+        .gap_percentage = 0,
+        .handle_angle = SIM_ANGLE_CLOSED,
+        .gap_angle = 0
+    };
+    if (position != NULL) {
+        if (position->mode > WINDOW_MODE_VENT || position->gap_percentage > 100) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        initial = *position;
+    }
+    
+    // Первый импульс сразу задает начальный угол, движения нет
+    sim.handle_angle = initial.handle_angle;
+    sim.gap_angle = initial.gap_angle;
+    sim.enabled = true;
+    sim.resistance = false;
+    
+    ESP_LOGI(TAG, "Начальное положение: режим %d, ручка %d°, зазор %d°",
+             initial.mode, initial.handle_angle, initial.gap_angle);
+    return ESP_OK;
+}
+
+/**
+ * @brief Расчет углов сервоприводов для сохраненного режима и зазора
+ */
+void servo_position_from_state(window_mode_t mode, uint8_t gap_percentage, servo_position_t *position)
+{
+    if (mode > WINDOW_MODE_VENT) {
+        mode = WINDOW_MODE_CLOSED;
+    }
+    if (gap_percentage > 100) {
+        gap_percentage = 100;
+    }
+    
+    // В закрытом окне зазор всегда закрыт
+    if (mode == WINDOW_MODE_CLOSED) {
+        gap_percentage = 0;
+    }
+    
+    position->mode = mode;
+    position->gap_percentage = gap_percentage;
+    position->handle_angle = (uint8_t)sim_servo_mode_angle(mode);
+    position->gap_angle = (uint8_t)(gap_percentage * SIM_ANGLE_GAP_MAX / 100);
+}
+
+/**
+ * @brief Изменение режима окна
+ */
+esp_err_t servo_set_window_mode(window_mode_t mode)
+{
+    if (mode > WINDOW_MODE_VENT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    esp_err_t ret = sim_servo_move(&sim.handle_angle, sim_servo_mode_angle(mode));
+    if (ret == ESP_OK && mode == WINDOW_MODE_CLOSED) {
+        sim_servo_move(&sim.gap_angle, 0);
+    }
+    return ret;
+}
+
+/**
+ * @brief Управление зазором окна
+ */
+esp_err_t servo_set_gap(uint8_t percentage)
+{
+    if (sim.handle_angle != SIM_ANGLE_OPEN) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (percentage > 100) {
+        percentage = 100;
+    }
+    
+    return sim_servo_move(&sim.gap_angle, percentage * SIM_ANGLE_GAP_MAX / 100);
+}
+
+/**
+ * @brief Текущий угол сервопривода ручки
+ */
+uint8_t servo_get_handle_angle(void)
+{
+    return (uint8_t)sim.handle_angle;
+}
+
+/**
+ * @brief Текущий угол сервопривода зазора
+ */
+uint8_t servo_get_gap_angle(void)
+{
+    return (uint8_t)sim.gap_angle;
+}
+
+/**
+ * @brief Порог сопротивления (в имитации не используется)
+ */
+esp_err_t servo_set_resistance_threshold(uint16_t resistance_threshold)
+{
+    return ESP_OK;
+}
+
+/**
+ * @brief Проверка имитируемого сопротивления
+ */
+bool servo_check_resistance(void)
+{
+    return sim.resistance;
+}
+
+/**
+ * @brief Включение имитации сопротивления
+ */
+void servo_simulate_resistance(bool enable)
+{
+    sim.resistance = enable;
+}
+
+/**
+ * @brief Регистрация функции начала движения
+ */
+void servo_set_motion_start_cb(servo_motion_start_cb_t cb)
+{
+    sim.motion_start_cb = cb;
+}
+
+/**
+ * @brief Отключение сервоприводов
+ */
+esp_err_t servo_disable(void)
+{
+    sim.enabled = false;
+    return ESP_OK;
+}
+
+/**
+ * @brief Калибровка: полный ход обоих сервоприводов и возврат в закрытое положение
+ */
+esp_err_t servo_calibrate(void)
+{
+    sim.enabled = true;
+    sim.calibrating = true;
+    sim.calibrations++;
+    
+    esp_err_t ret = sim_servo_move(&sim.handle_angle, SIM_ANGLE_CLOSED);
+    if (ret == ESP_OK) {
+        ret = sim_servo_move(&sim.handle_angle, SIM_ANGLE_VENT);
+    }
+    if (ret == ESP_OK) {
+        ret = sim_servo_move(&sim.handle_angle, SIM_ANGLE_CLOSED);
+    }
+    if (ret == ESP_OK) {
+        ret = sim_servo_move(&sim.gap_angle, SIM_ANGLE_GAP_MAX);
+    }
+    if (ret == ESP_OK) {
+        ret = sim_servo_move(&sim.gap_angle, 0);
+    }
+    
+    sim.calibrating = false;
+    return ret;
+}
+
+/**
+ * @brief Освобождение ресурсов
+ */
+esp_err_t servo_deinit(void)
+{
+    return servo_disable();
+}
+
+/**
+ * @brief Пауза между шагами движения
+ */
+void sim_servo_set_step_delay_ms(uint32_t delay_ms)
+{
+    sim.step_delay_ms = delay_ms;
+}
+
+/**
+ * @brief Число шагов движения с начала запуска
+ */
+uint32_t sim_servo_move_steps(void)
+{
+    return sim.move_steps;
+}
+
+/**
+ * @brief Число калибровок с начала запуска
+ */
+uint32_t sim_servo_calibrations(void)
+{
+    return sim.calibrations;
+}
+
+/**
+ * @brief Сервоприводы включены
+ */
+bool sim_servo_is_enabled(void)
+{
+    return sim.enabled;
+}
+
+/**
+ * @brief Сброс отметок времени движения
+ */
+void sim_servo_motion_reset(void)
+{
+    sim.motion_start_us = 0;
+    sim.motion_end_us = 0;
+}
+
+/**
+ * @brief Время первого и последнего шага
+ */
+bool sim_servo_motion_times(int64_t *start_us, int64_t *end_us)
+{
+    *start_us = sim.motion_start_us;
+    *end_us = sim.motion_end_us;
+    return sim.motion_start_us != 0;
+}
+
+/**
+ * @brief Движение по одному градусу с проверкой сопротивления
+ */
+static esp_err_t sim_servo_move(int *angle, int target)
+{
+    if (!sim.enabled) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    if (*angle != target && sim.motion_start_cb != NULL) {
+        sim.motion_start_cb();
+    }
+    
+    while (*angle != target) {
+        if (sim.resistance) {
+            return ESP_ERR_TIMEOUT;
+        }
+        
+        if (sim.motion_start_us == 0) {
+            sim.motion_start_us = esp_timer_get_time();
+        }
+        
+        *angle += (*angle < target) ? 1 : -1;
+        if (!sim.calibrating) {
+            sim.move_steps++;
+        }
+        vTaskDelay(pdMS_TO_TICKS(sim.step_delay_ms));
+        sim.motion_end_us = esp_timer_get_time();
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Угол ручки для режима окна
+ */
+static int sim_servo_mode_angle(window_mode_t mode)
+{
+    switch (mode) {
+        case WINDOW_MODE_OPEN:
+            return SIM_ANGLE_OPEN;
+        case WINDOW_MODE_VENT:
+            return SIM_ANGLE_VENT;
+        default:
+            return SIM_ANGLE_CLOSED;
+    }
+}
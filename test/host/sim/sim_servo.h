@@ -0,0 +1,51 @@
+/**
+ * @file sim_servo.h
+ * @brief Имитация сервоприводов окна для тестов на хосте
+ * 
+ * Реализует servo_control.h без ШИМ и АЦП: углы меняются по одному градусу
+ * с заданной паузой, движения и калибровки подсчитываются.
+ */
+
+#ifndef SIM_SERVO_H
+#define SIM_SERVO_H
+
+#include <stdint.h>
+#include "servo_control.h"
+
+/**
+ * @brief Пауза между шагами движения в 1 градус
+ * 
+ * @param delay_ms Пауза, мс (0 - движение без задержки)
+ */
+void sim_servo_set_step_delay_ms(uint32_t delay_ms);
+
+/**
+ * @brief Число шагов движения с начала запуска (калибровка не учитывается)
+ */
+uint32_t sim_servo_move_steps(void);
+
+/**
+ * @brief Число калибровок с начала запуска
+ */
+uint32_t sim_servo_calibrations(void);
+
+/**
+ * @brief Сервоприводы включены (ШИМ подается)
+ */
+bool sim_servo_is_enabled(void);
+
+/**
+ * @brief Сброс отметок времени движения перед командой
+ */
+void sim_servo_motion_reset(void);
+
+/**
+ * @brief Время первого и последнего шага после sim_servo_motion_reset()
+ * 
+ * @param start_us Время первого шага (esp_timer_get_time())
+ * @param end_us Время завершения последнего шага
+ * @return bool true, если было движение
+ */
+bool sim_servo_motion_times(int64_t *start_us, int64_t *end_us);
+
+#endif /* SIM_SERVO_H */
@@ -0,0 +1,238 @@
+/**
+ * @file sim_zb_radio.c
+ * @brief Имитация радиотракта библиотеки ZigBee ESP32-H2 для тестов на хосте
+ */
+
+#include <string.h>
+#include "sim_zb_radio.h"
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+#define SIM_ZB_RADIO_HANDLES        32      // Дескрипторов кадров с отложенным статусом
+#define SIM_ZB_RADIO_FRAME_QUEUE    64      // Переданных кадров, ожидающих теста
+
+// Модель канала по затуханию
+#define SIM_ZB_PARENT_POWER_DBM     20      // Мощность передачи родителя (дБм)
+#define SIM_ZB_RX_SENSITIVITY_DBM   (-100)  // Чувствительность приемников (дБм)
+#define SIM_ZB_FADE_MARGIN_DB       6       // Запас, ниже которого растут потери (дБ)
+
+static const char *TAG = "SIM_ZB_RADIO";
+
+// Состояние имитации
+static struct {
+    zb_radio_callbacks_t callbacks;
+    sim_zb_radio_link_t link;
+    bool parent_up;
+    int8_t tx_power_dbm;
+    uint32_t join_attempts;
+    QueueHandle_t frames;
+    esp_timer_handle_t confirm_timers[SIM_ZB_RADIO_HANDLES];
+    zb_radio_confirm_t confirms[SIM_ZB_RADIO_HANDLES];
+} sim = {
+    .parent_up = true
+};
+
+static portMUX_TYPE sim_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief Уровень подтверждений родителя и вероятность потери попытки на заданной мощности
+ */
+static uint32_t sim_zb_radio_link_model(const sim_zb_radio_link_t *link, int8_t tx_power_dbm,
+                                        uint8_t *lqi, int8_t *rssi)
+{
+    uint32_t loss_percent = link->loss_percent;
+    *lqi = link->lqi;
+    *rssi = link->rssi;
+    
+    if (link->path_loss_db == 0) {
+        return loss_percent;
+    }
+    
+    int32_t rx_rssi = SIM_ZB_PARENT_POWER_DBM - link->path_loss_db;
+    int32_t rx_lqi = (rx_rssi - SIM_ZB_RX_SENSITIVITY_DBM) * 255 / 80;
+    *rssi = (int8_t)rx_rssi;
+    *lqi = (uint8_t)(rx_lqi < 1 ? 1 : (rx_lqi > 255 ? 255 : rx_lqi));
+    
+    // Запас уровня кадра устройства у родителя
+    int32_t margin = tx_power_dbm - link->path_loss_db - SIM_ZB_RX_SENSITIVITY_DBM;
+    if (margin <= 0) {
+        return 100;
+    }
+    if (margin < SIM_ZB_FADE_MARGIN_DB) {
+        loss_percent += (100 - loss_percent) * (SIM_ZB_FADE_MARGIN_DB - margin) / SIM_ZB_FADE_MARGIN_DB;
+    }
+    
+    return loss_percent;
+}
+
+/**
+ * @brief Отложенный статус отправки (задача таймеров)
+ */
+static void sim_zb_radio_confirm_timer(void *arg)
+{
+    uint8_t handle = (uint8_t)(uintptr_t)arg;
+    
+    taskENTER_CRITICAL(&sim_lock);
+    zb_radio_confirm_t confirm = sim.confirms[handle];
+    taskEXIT_CRITICAL(&sim_lock);
+    
+    sim.callbacks.on_confirm(handle, &confirm);
+}
+
+esp_err_t zb_radio_init(const zb_radio_callbacks_t *callbacks)
+{
+    if (callbacks == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    sim.callbacks = *callbacks;
+    if (sim.frames == NULL) {
+        sim.frames = xQueueCreate(SIM_ZB_RADIO_FRAME_QUEUE, sizeof(sim_zb_radio_frame_t));
+    }
+    
+    return sim.frames != NULL ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+esp_err_t zb_radio_send(uint8_t handle, const zb_radio_frame_t *frame)
+{
+    if (frame == NULL || handle >= SIM_ZB_RADIO_HANDLES) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    taskENTER_CRITICAL(&sim_lock);
+    sim_zb_radio_link_t link = sim.link;
+    int8_t tx_power_dbm = sim.tx_power_dbm;
+    taskEXIT_CRITICAL(&sim_lock);
+    
+    // Попытка и повторы MAC, пока нет подтверждения
+    zb_radio_confirm_t confirm = {
+        .acked = false,
+        .attempts = 0
+    };
+    uint32_t loss_percent = sim_zb_radio_link_model(&link, tx_power_dbm, &confirm.lqi, &confirm.rssi);
+    do {
+        confirm.attempts++;
+        confirm.acked = (esp_random() % 100) >= loss_percent;
+    } while (!confirm.acked && confirm.attempts <= link.max_retries);
+    
+    sim_zb_radio_frame_t sent = {
+        .type = frame->type,
+        .param1 = frame->param1,
+        .param2 = frame->param2,
+        .attempts = confirm.attempts,
+        .acked = confirm.acked,
+        .tx_power_dbm = tx_power_dbm,
+        .time_us = esp_timer_get_time()
+    };
+    if (xQueueSend(sim.frames, &sent, 0) != pdPASS) {
+        ESP_LOGW(TAG, "Очередь переданных кадров заполнена");
+    }
+    
+    if (link.ack_delay_ms == 0) {
+        sim.callbacks.on_confirm(handle, &confirm);
+        return ESP_OK;
+    }
+    
+    if (sim.confirm_timers[handle] == NULL) {
+        esp_timer_create_args_t args = {
+            .callback = sim_zb_radio_confirm_timer,
+            .arg = (void *)(uintptr_t)handle,
+            .name = "sim_zb_confirm"
+        };
+        esp_err_t err = esp_timer_create(&args, &sim.confirm_timers[handle]);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    
+    taskENTER_CRITICAL(&sim_lock);
+    sim.confirms[handle] = confirm;
+    taskEXIT_CRITICAL(&sim_lock);
+    
+    esp_timer_stop(sim.confirm_timers[handle]);
+    return esp_timer_start_once(sim.confirm_timers[handle], (uint64_t)link.ack_delay_ms * 1000);
+}
+
+bool zb_radio_join(bool scan)
+{
+    taskENTER_CRITICAL(&sim_lock);
+    sim.join_attempts++;
+    bool joined = sim.parent_up;
+    taskEXIT_CRITICAL(&sim_lock);
+    
+    return joined;
+}
+
+void zb_radio_set_tx_power(int8_t tx_power_dbm)
+{
+    taskENTER_CRITICAL(&sim_lock);
+    sim.tx_power_dbm = tx_power_dbm;
+    taskEXIT_CRITICAL(&sim_lock);
+}
+
+/**
+ * @brief Настройка канала
+ */
+void sim_zb_radio_set_link(const sim_zb_radio_link_t *link)
+{
+    taskENTER_CRITICAL(&sim_lock);
+    sim.link = *link;
+    taskEXIT_CRITICAL(&sim_lock);
+}
+
+/**
+ * @brief Наличие родителя
+ */
+void sim_zb_radio_set_parent(bool up)
+{
+    taskENTER_CRITICAL(&sim_lock);
+    bool lost = sim.parent_up && !up;
+    sim.parent_up = up;
+    taskEXIT_CRITICAL(&sim_lock);
+    
+    if (lost && sim.callbacks.on_link_lost) {
+        sim.callbacks.on_link_lost();
+    }
+}
+
+/**
+ * @brief Команда координатора
+ */
+void sim_zb_radio_send_command(uint8_t cmd, const uint8_t *data, uint8_t len)
+{
+    taskENTER_CRITICAL(&sim_lock);
+    sim_zb_radio_link_t link = sim.link;
+    int8_t tx_power_dbm = sim.tx_power_dbm;
+    taskEXIT_CRITICAL(&sim_lock);
+    
+    uint8_t lqi;
+    int8_t rssi;
+    sim_zb_radio_link_model(&link, tx_power_dbm, &lqi, &rssi);
+    
+    if (sim.callbacks.on_command) {
+        sim.callbacks.on_command(cmd, data, len, lqi, rssi);
+    }
+}
+
+/**
+ * @brief Ожидание очередного переданного кадра
+ */
+bool sim_zb_radio_wait_frame(sim_zb_radio_frame_t *frame, uint32_t timeout_ms)
+{
+    return sim.frames != NULL && xQueueReceive(sim.frames, frame, pdMS_TO_TICKS(timeout_ms)) == pdPASS;
+}
+
+/**
+ * @brief Количество попыток входа в сеть
+ */
+uint32_t sim_zb_radio_join_attempts(void)
+{
+    taskENTER_CRITICAL(&sim_lock);
+    uint32_t attempts = sim.join_attempts;
+    taskEXIT_CRITICAL(&sim_lock);
+    
+    return attempts;
+}
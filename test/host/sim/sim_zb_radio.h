@@ -0,0 +1,82 @@
+/**
+ * @file sim_zb_radio.h
+ * @brief Имитация радиотракта библиотеки ZigBee ESP32-H2 (zb_radio.h) для тестов на хосте
+ * 
+ * Заменяет zb_radio.c при сборке esp32-h2-zigbee-window/components/esp_zigbee_lib
+ * на хосте. Кадры устройства теряются с заданной вероятностью и повторяются
+ * на уровне MAC, статус отправки приходит из задачи таймеров после задержки
+ * подтверждения. При заданном затухании до родителя уровень подтверждений
+ * и потери зависят от мощности передачи устройства. Тест подает команды координатора, обрывает связь с родителем
+ * и получает переданные кадры.
+ */
+
+#ifndef SIM_ZB_RADIO_H
+#define SIM_ZB_RADIO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "zb_radio.h"
+
+/**
+ * @brief Параметры канала до родителя
+ */
+typedef struct {
+    uint8_t loss_percent;           ///< Вероятность потери попытки (0-100 %)
+    uint8_t max_retries;            ///< Повторов MAC после потери попытки
+    uint32_t ack_delay_ms;          ///< Задержка статуса отправки (0 - до возврата из zb_radio_send())
+    uint8_t lqi;                    ///< LQI подтверждений и команд
+    int8_t rssi;                    ///< RSSI подтверждений и команд (дБм)
+    uint8_t path_loss_db;           ///< Затухание до родителя (дБ); 0 - постоянные lqi, rssi и потери
+} sim_zb_radio_link_t;
+
+/**
+ * @brief Переданный устройством кадр
+ */
+typedef struct {
+    zb_radio_frame_type_t type;     ///< Тип кадра
+    uint8_t param1;                 ///< Режим окна или тип уведомления
+    uint8_t param2;                 ///< Процент открытия или значение уведомления
+    uint8_t attempts;               ///< Попыток в эфире
+    bool acked;                     ///< Получено APS-подтверждение
+    int8_t tx_power_dbm;            ///< Мощность передачи (дБм)
+    int64_t time_us;                ///< Время передачи (esp_timer_get_time())
+} sim_zb_radio_frame_t;
+
+/**
+ * @brief Настройка канала (по умолчанию - без потерь и без задержки)
+ * 
+ * @param link Параметры канала
+ */
+void sim_zb_radio_set_link(const sim_zb_radio_link_t *link);
+
+/**
+ * @brief Наличие родителя: обрыв вызывает on_link_lost, вход в сеть без родителя не удается
+ * 
+ * @param up true - родитель доступен
+ */
+void sim_zb_radio_set_parent(bool up);
+
+/**
+ * @brief Команда координатора (доставляется в on_command из задачи теста)
+ * 
+ * @param cmd Код команды
+ * @param data Данные команды
+ * @param len Длина данных
+ */
+void sim_zb_radio_send_command(uint8_t cmd, const uint8_t *data, uint8_t len);
+
+/**
+ * @brief Ожидание очередного переданного кадра
+ * 
+ * @param frame Кадр
+ * @param timeout_ms Таймаут ожидания, мс
+ * @return bool true, если кадр получен
+ */
+bool sim_zb_radio_wait_frame(sim_zb_radio_frame_t *frame, uint32_t timeout_ms);
+
+/**
+ * @brief Количество попыток входа в сеть
+ */
+uint32_t sim_zb_radio_join_attempts(void);
+
+#endif /* SIM_ZB_RADIO_H */
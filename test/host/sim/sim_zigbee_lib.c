@@ -0,0 +1,539 @@
+/**
+ * @file sim_zigbee_lib.c
+ * @brief Имитация библиотеки ZigBee для тестов на хосте
+ */
+
+#include <string.h>
+#include "sim_zigbee_lib.h"
+#include "cmd_dedup.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+#define TAG "SIM_ZIGBEE"
+
+#define SIM_ZIGBEE_EVENT_QUEUE_DEPTH    16
+#define SIM_ZIGBEE_REPORT_QUEUE_DEPTH   64
+#define SIM_ZIGBEE_MAX_DATA_LEN         64
+#define SIM_ZIGBEE_MAX_MANUF_ATTRS      4
+
+// Слоты отчетов без сети, как в библиотеке: атрибуты и по одному на тип уведомления
+#define SIM_ZIGBEE_SLOT_ATTRS           0
+#define SIM_ZIGBEE_SLOT_ALERT_BASE      1
+#define SIM_ZIGBEE_SLOT_COUNT           (SIM_ZIGBEE_SLOT_ALERT_BASE + ESP_ZIGBEE_ALERT_PROTECTION + 1)
+
+// События задачи стека
+typedef enum {
+    SIM_ZIGBEE_EVENT_JOIN,
+    SIM_ZIGBEE_EVENT_LEAVE,
+    SIM_ZIGBEE_EVENT_COMMAND,
+    SIM_ZIGBEE_EVENT_ACK
+} sim_zigbee_event_kind_t;
+
+typedef struct {
+    sim_zigbee_event_kind_t kind;
+    uint8_t cmd;
+    uint16_t len;
+    uint8_t data[SIM_ZIGBEE_MAX_DATA_LEN];
+    esp_zigbee_cmd_info_t info;
+    int64_t due_us;
+} sim_zigbee_event_t;
+
+// Значение собственного атрибута
+typedef struct {
+    uint16_t attr_id;
+    uint16_t len;
+    uint8_t data[ESP_ZIGBEE_MANUF_ATTR_MAX_LEN];
+} sim_zigbee_manuf_attr_t;
+
+// Состояние имитации
+static struct {
+    esp_zigbee_config_t config;
+    bool initialized;
+    volatile bool connected;
+    uint32_t join_delay_ms;
+    uint32_t ack_delay_ms;
+    QueueHandle_t events;
+    QueueHandle_t reports;
+    TaskHandle_t task;
+    sim_zigbee_manuf_attr_t manuf_attrs[SIM_ZIGBEE_MAX_MANUF_ATTRS];
+    int manuf_attr_count;
+    sim_zigbee_report_t held[SIM_ZIGBEE_SLOT_COUNT];
+    bool held_valid[SIM_ZIGBEE_SLOT_COUNT];
+    uint8_t next_tsn;
+    uint32_t nwk_frame_counter;
+    sim_zigbee_command_stats_t command_stats;
+} sim;
+
+static portMUX_TYPE sim_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Прототипы вспомогательных функций
+static void sim_zigbee_task(void *arg);
+static esp_err_t sim_zigbee_post_report(sim_zigbee_report_kind_t kind, uint8_t value, uint8_t extra);
+static void sim_zigbee_flush_held(void);
+static void sim_zigbee_deliver_command(const sim_zigbee_event_t *event);
+static void sim_zigbee_expect_ack(sim_zigbee_report_kind_t kind);
+
+/**
+ * @brief Инициализация ZigBee устройства
+ */
+esp_err_t esp_zigbee_init(const esp_zigbee_config_t *config)
+{
+    if (config == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    sim.config = *config;
+    sim.nwk_frame_counter = config->restore_network != NULL ? config->restore_network->nwk_frame_counter : 0;
+    sim.events = xQueueCreate(SIM_ZIGBEE_EVENT_QUEUE_DEPTH, sizeof(sim_zigbee_event_t));
+    sim.reports = xQueueCreate(SIM_ZIGBEE_REPORT_QUEUE_DEPTH, sizeof(sim_zigbee_report_t));
+    if (sim.events == NULL || sim.reports == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    
+    if (xTaskCreate(sim_zigbee_task, "zb_stack", 4096, NULL, 5, &sim.task) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    
+    sim.initialized = true;
+    return ESP_OK;
+}
+
+/**
+ * @brief Запуск: подключение к сети через join_delay_ms
+ */
+esp_err_t esp_zigbee_start(void)
+{
+    if (!sim.initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    if (sim.config.auto_join) {
+        sim_zigbee_event_t event = { .kind = SIM_ZIGBEE_EVENT_JOIN };
+        xQueueSend(sim.events, &event, portMAX_DELAY);
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Остановка: выход из сети
+ */
+esp_err_t esp_zigbee_stop(void)
+{
+    if (!sim.initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    sim_zigbee_event_t event = { .kind = SIM_ZIGBEE_EVENT_LEAVE };
+    xQueueSend(sim.events, &event, portMAX_DELAY);
+    return ESP_OK;
+}
+
+/**
+ * @brief Выход из сети с уведомлением родителя
+ */
+esp_err_t esp_zigbee_leave(bool rejoin)
+{
+    if (!sim.initialized || !sim.connected) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    sim_zigbee_event_t event = { .kind = SIM_ZIGBEE_EVENT_LEAVE };
+    xQueueSend(sim.events, &event, portMAX_DELAY);
+    return ESP_OK;
+}
+
+/**
+ * @brief Установка типа устройства
+ */
+esp_err_t esp_zigbee_set_device_type(esp_zigbee_device_type_t device_type)
+{
+    return ESP_OK;
+}
+
+/**
+ * @brief Режим сопряжения
+ */
+esp_err_t esp_zigbee_enable_pairing(bool enable)
+{
+    return ESP_OK;
+}
+
+/**
+ * @brief Параметры сети имитации
+ */
+esp_err_t esp_zigbee_get_network_info(esp_zigbee_network_info_t *info)
+{
+    if (info == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!sim.connected) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    memset(info, 0, sizeof(*info));
+    info->pan_id = 0x1A62;
+    info->channel = 15;
+    info->short_address = 0x4C21;
+    info->parent_address = 0x0000;
+    taskENTER_CRITICAL(&sim_lock);
+    info->nwk_frame_counter = sim.nwk_frame_counter;
+    taskEXIT_CRITICAL(&sim_lock);
+    return ESP_OK;
+}
+
+/**
+ * @brief Запрос времени (координатор имитации время не сообщает)
+ */
+esp_err_t esp_zigbee_request_time(void)
+{
+    return sim.connected ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+/**
+ * @brief Команда клиента OTA (сервер обновлений не имитируется)
+ */
+esp_err_t esp_zigbee_send_ota_command(uint8_t cmd_id, const uint8_t *payload, uint16_t len)
+{
+    return sim.connected ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+/**
+ * @brief Обработка входящих команд (выполняется задачей стека)
+ */
+esp_err_t esp_zigbee_process_commands(void)
+{
+    return ESP_ERR_NOT_FOUND;
+}
+
+/**
+ * @brief Отправка состояния окна
+ */
+esp_err_t esp_zigbee_report_window_state(esp_zigbee_window_mode_t mode, uint8_t position)
+{
+    return sim_zigbee_post_report(SIM_ZIGBEE_REPORT_STATE, (uint8_t)mode, position);
+}
+
+/**
+ * @brief Отправка режима окна
+ */
+esp_err_t esp_zigbee_report_window_mode(uint8_t mode)
+{
+    return sim_zigbee_post_report(SIM_ZIGBEE_REPORT_MODE, mode, 0);
+}
+
+/**
+ * @brief Отправка положения окна
+ */
+esp_err_t esp_zigbee_report_position(uint8_t position)
+{
+    return sim_zigbee_post_report(SIM_ZIGBEE_REPORT_POSITION, position, 0);
+}
+
+/**
+ * @brief Отправка уведомления
+ */
+esp_err_t esp_zigbee_send_alert(esp_zigbee_alert_type_t alert_type, uint8_t value)
+{
+    return sim_zigbee_post_report(SIM_ZIGBEE_REPORT_ALERT, (uint8_t)alert_type, value);
+}
+
+/**
+ * @brief Обновление значения собственного атрибута
+ */
+esp_err_t esp_zigbee_set_manuf_attribute(uint16_t attr_id, const uint8_t *data, uint16_t len)
+{
+    if (data == NULL || len > ESP_ZIGBEE_MANUF_ATTR_MAX_LEN) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    esp_err_t err = ESP_ERR_NO_MEM;
+    
+    taskENTER_CRITICAL(&sim_lock);
+    for (int i = 0; i < SIM_ZIGBEE_MAX_MANUF_ATTRS; i++) {
+        sim_zigbee_manuf_attr_t *attr = &sim.manuf_attrs[i];
+        if (i == sim.manuf_attr_count) {
+            attr->attr_id = attr_id;
+            sim.manuf_attr_count++;
+        }
+        if (attr->attr_id == attr_id) {
+            memcpy(attr->data, data, len);
+            attr->len = len;
+            err = ESP_OK;
+            break;
+        }
+    }
+    taskEXIT_CRITICAL(&sim_lock);
+    
+    return err;
+}
+
+/**
+ * @brief Задержка подключения к сети
+ */
+void sim_zigbee_set_join_delay_ms(uint32_t delay_ms)
+{
+    sim.join_delay_ms = delay_ms;
+}
+
+/**
+ * @brief Задержка APS-подтверждения отчетов атрибутов
+ */
+void sim_zigbee_set_ack_delay_ms(uint32_t delay_ms)
+{
+    sim.ack_delay_ms = delay_ms;
+}
+
+/**
+ * @brief Устройство подключено к сети
+ */
+bool sim_zigbee_is_connected(void)
+{
+    return sim.connected;
+}
+
+/**
+ * @brief Роль и способ входа в сеть, переданные при инициализации
+ */
+esp_zigbee_role_t sim_zigbee_get_role(bool *rejoin_network)
+{
+    *rejoin_network = sim.config.rejoin_network;
+    return sim.config.role;
+}
+
+/**
+ * @brief Команда хаба
+ */
+int64_t sim_zigbee_send_command(uint8_t cmd, const uint8_t *data, uint16_t len, const esp_zigbee_cmd_info_t *info)
+{
+    sim_zigbee_event_t event = {
+        .kind = SIM_ZIGBEE_EVENT_COMMAND,
+        .cmd = cmd,
+        .len = len > SIM_ZIGBEE_MAX_DATA_LEN ? SIM_ZIGBEE_MAX_DATA_LEN : len
+    };
+    
+    if (event.len > 0) {
+        memcpy(event.data, data, event.len);
+    }
+    if (info != NULL) {
+        event.info = *info;
+    } else {
+        // Координатор нумерует свои команды по порядку
+        taskENTER_CRITICAL(&sim_lock);
+        event.info.tsn = sim.next_tsn++;
+        taskEXIT_CRITICAL(&sim_lock);
+    }
+    
+    int64_t now = esp_timer_get_time();
+    xQueueSend(sim.events, &event, portMAX_DELAY);
+    return now;
+}
+
+/**
+ * @brief Ожидание следующего отправленного кадра
+ */
+bool sim_zigbee_wait_report(sim_zigbee_report_t *report, uint32_t timeout_ms)
+{
+    return sim.reports != NULL && xQueueReceive(sim.reports, report, pdMS_TO_TICKS(timeout_ms)) == pdPASS;
+}
+
+/**
+ * @brief Последнее значение собственного атрибута
+ */
+int sim_zigbee_get_manuf_attribute(uint16_t attr_id, uint8_t *data)
+{
+    int len = -1;
+    
+    taskENTER_CRITICAL(&sim_lock);
+    for (int i = 0; i < sim.manuf_attr_count; i++) {
+        if (sim.manuf_attrs[i].attr_id == attr_id) {
+            len = sim.manuf_attrs[i].len;
+            memcpy(data, sim.manuf_attrs[i].data, (size_t)len);
+            break;
+        }
+    }
+    taskEXIT_CRITICAL(&sim_lock);
+    
+    return len;
+}
+
+/**
+ * @brief Передача кадров без участия приложения
+ */
+void sim_zigbee_send_frames(uint32_t count)
+{
+    taskENTER_CRITICAL(&sim_lock);
+    sim.nwk_frame_counter += count;
+    taskEXIT_CRITICAL(&sim_lock);
+}
+
+/**
+ * @brief Счетчики доставки команд
+ */
+void sim_zigbee_get_command_stats(sim_zigbee_command_stats_t *stats)
+{
+    taskENTER_CRITICAL(&sim_lock);
+    *stats = sim.command_stats;
+    taskEXIT_CRITICAL(&sim_lock);
+}
+
+/**
+ * @brief Задача стека: подключение и доставка команд в колбэки
+ */
+static void sim_zigbee_task(void *arg)
+{
+    sim_zigbee_event_t event;
+    
+    for (;;) {
+        if (xQueueReceive(sim.events, &event, portMAX_DELAY) != pdPASS) {
+            continue;
+        }
+        
+        switch (event.kind) {
+            case SIM_ZIGBEE_EVENT_JOIN:
+                vTaskDelay(pdMS_TO_TICKS(sim.join_delay_ms));
+                sim.connected = true;
+                if (sim.config.on_connected != NULL) {
+                    sim.config.on_connected();
+                }
+                sim_zigbee_flush_held();
+                break;
+                
+            case SIM_ZIGBEE_EVENT_LEAVE:
+                sim.connected = false;
+                if (sim.config.on_disconnected != NULL) {
+                    sim.config.on_disconnected();
+                }
+                break;
+                
+            case SIM_ZIGBEE_EVENT_COMMAND:
+                if (sim.connected && sim.config.on_command != NULL) {
+                    sim_zigbee_deliver_command(&event);
+                }
+                break;
+                
+            case SIM_ZIGBEE_EVENT_ACK: {
+                int64_t wait_us = event.due_us - esp_timer_get_time();
+                if (wait_us > 0) {
+                    vTaskDelay(pdMS_TO_TICKS((wait_us + 999) / 1000));
+                }
+                if (sim.connected && sim.config.on_report_sent != NULL) {
+                    sim.config.on_report_sent();
+                }
+                break;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Доставка команды в колбэк с подавлением повторов, как в библиотеке
+ */
+static void sim_zigbee_deliver_command(const sim_zigbee_event_t *event)
+{
+    if (cmd_dedup_is_duplicate(event->cmd, &event->info)) {
+        taskENTER_CRITICAL(&sim_lock);
+        sim.command_stats.duplicates++;
+        taskEXIT_CRITICAL(&sim_lock);
+        return;
+    }
+    
+    int64_t start_us = esp_timer_get_time();
+    bool accepted = sim.config.on_command(event->cmd, event->data, event->len, &event->info);
+    int64_t callback_us = esp_timer_get_time() - start_us;
+    
+    if (accepted) {
+        cmd_dedup_record(event->cmd, &event->info);
+    }
+    
+    taskENTER_CRITICAL(&sim_lock);
+    if (accepted) {
+        sim.command_stats.accepted++;
+    } else {
+        sim.command_stats.rejected++;
+    }
+    if (callback_us > sim.command_stats.callback_max_us) {
+        sim.command_stats.callback_max_us = callback_us;
+    }
+    taskEXIT_CRITICAL(&sim_lock);
+}
+
+/**
+ * @brief Передача отправленного кадра тесту
+ * 
+ * Без сети кадр остается в слоте и замещает прежнее значение того же
+ * слота; слоты отправляются после подключения.
+ */
+static esp_err_t sim_zigbee_post_report(sim_zigbee_report_kind_t kind, uint8_t value, uint8_t extra)
+{
+    if (!sim.initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (kind == SIM_ZIGBEE_REPORT_ALERT && value > ESP_ZIGBEE_ALERT_PROTECTION) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    sim_zigbee_report_t report = {
+        .kind = kind,
+        .value = value,
+        .extra = extra,
+        .time_us = esp_timer_get_time()
+    };
+    
+    if (!sim.connected) {
+        int slot = kind == SIM_ZIGBEE_REPORT_ALERT ? SIM_ZIGBEE_SLOT_ALERT_BASE + value : SIM_ZIGBEE_SLOT_ATTRS;
+        taskENTER_CRITICAL(&sim_lock);
+        sim.held[slot] = report;
+        sim.held_valid[slot] = true;
+        taskEXIT_CRITICAL(&sim_lock);
+        return ESP_OK;
+    }
+    
+    if (xQueueSend(sim.reports, &report, 0) != pdPASS) {
+        ESP_LOGW(TAG, "Очередь отчетов заполнена");
+    }
+    sim_zigbee_expect_ack(kind);
+    return ESP_OK;
+}
+
+/**
+ * @brief APS-подтверждение отчета атрибутов через ack_delay_ms (в задаче стека)
+ */
+static void sim_zigbee_expect_ack(sim_zigbee_report_kind_t kind)
+{
+    if (kind == SIM_ZIGBEE_REPORT_ALERT) {
+        return;
+    }
+    
+    sim_zigbee_event_t event = {
+        .kind = SIM_ZIGBEE_EVENT_ACK,
+        .due_us = esp_timer_get_time() + (int64_t)sim.ack_delay_ms * 1000
+    };
+    if (xQueueSend(sim.events, &event, 0) != pdPASS) {
+        ESP_LOGW(TAG, "Очередь событий заполнена, подтверждение отчета потеряно");
+    }
+}
+
+/**
+ * @brief Отправка кадров, накопленных в слотах без сети
+ */
+static void sim_zigbee_flush_held(void)
+{
+    for (int slot = 0; slot < SIM_ZIGBEE_SLOT_COUNT; slot++) {
+        taskENTER_CRITICAL(&sim_lock);
+        bool valid = sim.held_valid[slot];
+        sim_zigbee_report_t report = sim.held[slot];
+        sim.held_valid[slot] = false;
+        taskEXIT_CRITICAL(&sim_lock);
+        
+        if (valid) {
+            report.time_us = esp_timer_get_time();
+            if (xQueueSend(sim.reports, &report, 0) != pdPASS) {
+                ESP_LOGW(TAG, "Очередь отчетов заполнена");
+            }
+            sim_zigbee_expect_ack(report.kind);
+        }
+    }
+}
@@ -0,0 +1,124 @@
+/**
+ * @file sim_zigbee_lib.h
+ * @brief Имитация библиотеки ZigBee (esp_zigbee_lib.h) для тестов на хосте
+ * 
+ * Колбэки стека вызываются из отдельной задачи "стека", как в прошивке.
+ * Тест подает команды хаба и получает отправленные устройством отчеты
+ * с отметками времени.
+ */
+
+#ifndef SIM_ZIGBEE_LIB_H
+#define SIM_ZIGBEE_LIB_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_zigbee_lib.h"
+
+/**
+ * @brief Вид отправленного устройством кадра
+ */
+typedef enum {
+    SIM_ZIGBEE_REPORT_STATE,        ///< esp_zigbee_report_window_state()
+    SIM_ZIGBEE_REPORT_MODE,         ///< esp_zigbee_report_window_mode()
+    SIM_ZIGBEE_REPORT_POSITION,     ///< esp_zigbee_report_position()
+    SIM_ZIGBEE_REPORT_ALERT         ///< esp_zigbee_send_alert()
+} sim_zigbee_report_kind_t;
+
+/**
+ * @brief Отправленный устройством кадр
+ */
+typedef struct {
+    sim_zigbee_report_kind_t kind;  ///< Вид кадра
+    uint8_t value;                  ///< Режим, положение или тип уведомления
+    uint8_t extra;                  ///< Положение (для отчета состояния) или значение уведомления
+    int64_t time_us;                ///< Время отправки (esp_timer_get_time())
+} sim_zigbee_report_t;
+
+/**
+ * @brief Счетчики доставки команд в колбэк on_command
+ */
+typedef struct {
+    uint32_t accepted;              ///< Команды, принятые приложением
+    uint32_t rejected;              ///< Команды, отклоненные приложением (например, очередь заполнена)
+    uint32_t duplicates;            ///< Повторы принятых команд, не переданные приложению
+    int64_t callback_max_us;        ///< Наибольшее время выполнения колбэка, мкс
+} sim_zigbee_command_stats_t;
+
+/**
+ * @brief Задержка подключения к сети после esp_zigbee_start()
+ * 
+ * @param delay_ms Задержка, мс
+ */
+void sim_zigbee_set_join_delay_ms(uint32_t delay_ms);
+
+/**
+ * @brief Задержка APS-подтверждения отчетов атрибутов (колбэк on_report_sent)
+ * 
+ * Подтверждения доставляются задачей стека по порядку; пока она ждет
+ * подтверждения, команды хаба не доставляются.
+ * 
+ * @param delay_ms Задержка от отправки отчета, мс
+ */
+void sim_zigbee_set_ack_delay_ms(uint32_t delay_ms);
+
+/**
+ * @brief Устройство подключено к сети
+ */
+bool sim_zigbee_is_connected(void);
+
+/**
+ * @brief Роль и способ входа в сеть из конфигурации esp_zigbee_init()
+ * 
+ * @param rejoin_network Вход в сохраненную сеть повторным подключением
+ * @return esp_zigbee_role_t Роль в сети
+ */
+esp_zigbee_role_t sim_zigbee_get_role(bool *rejoin_network);
+
+/**
+ * @brief Команда хаба (доставляется в колбэк on_command из задачи стека)
+ * 
+ * Повторы принятых команд (тот же источник, TSN и команда) подавляются
+ * так же, как в библиотеке. Команды без сведений об источнике нумеруются
+ * по порядку.
+ * 
+ * @param cmd Команда esp_zigbee_cmd_t
+ * @param data Данные команды
+ * @param len Длина данных
+ * @param info Источник команды (NULL - одиночная команда от координатора)
+ * @return int64_t Время передачи команды стеку (esp_timer_get_time())
+ */
+int64_t sim_zigbee_send_command(uint8_t cmd, const uint8_t *data, uint16_t len, const esp_zigbee_cmd_info_t *info);
+
+/**
+ * @brief Передача кадров без участия приложения (пересылка чужих кадров маршрутизатором)
+ * 
+ * @param count Число кадров, на которое продвигается счетчик кадров сети
+ */
+void sim_zigbee_send_frames(uint32_t count);
+
+/**
+ * @brief Счетчики доставки команд с начала запуска
+ * 
+ * @param stats Счетчики
+ */
+void sim_zigbee_get_command_stats(sim_zigbee_command_stats_t *stats);
+
+/**
+ * @brief Ожидание следующего отправленного устройством кадра
+ * 
+ * @param report Кадр
+ * @param timeout_ms Время ожидания, мс
+ * @return bool true, если кадр получен
+ */
+bool sim_zigbee_wait_report(sim_zigbee_report_t *report, uint32_t timeout_ms);
+
+/**
+ * @brief Последнее значение собственного атрибута производителя
+ * 
+ * @param attr_id Идентификатор атрибута (ESP_ZIGBEE_MANUF_ATTR_*)
+ * @param data Буфер (не менее ESP_ZIGBEE_MANUF_ATTR_MAX_LEN байт)
+ * @return int Длина значения или -1, если атрибут не записывался
+ */
+int sim_zigbee_get_manuf_attribute(uint16_t attr_id, uint8_t *data);
+
+#endif /* SIM_ZIGBEE_LIB_H */
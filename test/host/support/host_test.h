@@ -0,0 +1,50 @@
+/**
+ * @file host_test.h
+ * @brief Проверки для тестов на хосте
+ * 
+ * Невыполненная проверка завершает процесс с кодом 1, поэтому проверки
+ * можно использовать и внутри имитируемого запуска (fake_run_boot()).
+ */
+
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+#include <stdio.h>
+#include <unistd.h>
+#include "esp_err.h"
+
+#define TEST_FAIL(...) do {                                                     \
+        fprintf(stderr, "%s:%d: ", __FILE__, __LINE__);                         \
+        fprintf(stderr, __VA_ARGS__);                                           \
+        fprintf(stderr, "\n");                                                  \
+        fflush(stderr);                                                         \
+        _exit(1);                                                               \
+    } while (0)
+
+#define TEST_ASSERT(cond) do {                                                  \
+        if (!(cond)) {                                                          \
+            TEST_FAIL("проверка не выполнена: %s", #cond);                      \
+        }                                                                       \
+    } while (0)
+
+#define TEST_ASSERT_EQUAL(expected, actual) do {                                \
+        long long expected_ = (long long)(expected);                            \
+        long long actual_ = (long long)(actual);                                \
+        if (expected_ != actual_) {                                             \
+            TEST_FAIL("%s: ожидалось %lld, получено %lld", #actual, expected_, actual_); \
+        }                                                                       \
+    } while (0)
+
+#define TEST_ASSERT_ESP_OK(expr) do {                                           \
+        esp_err_t err_ = (expr);                                                \
+        if (err_ != ESP_OK) {                                                   \
+            TEST_FAIL("%s: %s (0x%x)", #expr, esp_err_to_name(err_), err_);     \
+        }                                                                       \
+    } while (0)
+
+#define TEST_RUN(test) do {                                                     \
+        fprintf(stderr, "-- %s\n", #test);                                      \
+        test();                                                                 \
+    } while (0)
+
+#endif /* HOST_TEST_H */
@@ -0,0 +1,134 @@
+/**
+ * @file test_automation.c
+ * @brief Правила локальной автоматизации: срабатывание по переходу и хранение в NVS
+ * 
+ * Каждый запуск выполняется в отдельном процессе, таблица правил
+ * сохраняется в файле NVS между запусками.
+ */
+
+#include <stdio.h>
+#include "host_test.h"
+#include "fake_host.h"
+#include "automation.h"
+
+#define NVS_FILE                "test_automation_nvs.bin"
+#define SENSOR_ADDR             0x5A21
+#define SENSOR_ENDPOINT         1
+#define IAS_ZONE_ALARM1         0x0001
+#define TEMPERATURE_COOL        2500    // 25 °C
+#define TEMPERATURE_HOT         2700    // 27 °C, выше порога правила по умолчанию
+#define RULE_ON_OFF_INDEX       2
+#define RULE_ON_OFF_GAP         30
+
+/**
+ * @brief Проверка события и результата правила
+ * 
+ * @return bool true, если сработало правило
+ */
+static bool sensor_event(esp_zigbee_sensor_type_t type, int32_t value, window_mode_t *mode, uint8_t *gap)
+{
+    esp_zigbee_sensor_event_t event = {
+        .type = type,
+        .src_addr = SENSOR_ADDR,
+        .src_endpoint = SENSOR_ENDPOINT,
+        .value = value
+    };
+    return automation_evaluate(&event, mode, gap);
+}
+
+/**
+ * @brief Запуск 1: правила по умолчанию срабатывают только на переходе условия
+ */
+static void boot_defaults(void *arg)
+{
+    window_mode_t mode;
+    uint8_t gap;
+    
+    TEST_ASSERT_ESP_OK(fake_nvs_attach(NVS_FILE));
+    TEST_ASSERT_ESP_OK(automation_init());
+    
+    // Тревога зоны IAS закрывает окно один раз, повторные отчеты не срабатывают
+    TEST_ASSERT(sensor_event(ESP_ZIGBEE_SENSOR_IAS_ZONE, IAS_ZONE_ALARM1, &mode, &gap));
+    TEST_ASSERT_EQUAL(WINDOW_MODE_CLOSED, mode);
+    TEST_ASSERT_EQUAL(0, gap);
+    TEST_ASSERT(!sensor_event(ESP_ZIGBEE_SENSOR_IAS_ZONE, IAS_ZONE_ALARM1, &mode, &gap));
+    
+    // После снятия тревоги правило снова готово к срабатыванию
+    TEST_ASSERT(!sensor_event(ESP_ZIGBEE_SENSOR_IAS_ZONE, 0, &mode, &gap));
+    TEST_ASSERT(sensor_event(ESP_ZIGBEE_SENSOR_IAS_ZONE, IAS_ZONE_ALARM1, &mode, &gap));
+    
+    // Температура выше порога включает проветривание
+    TEST_ASSERT(!sensor_event(ESP_ZIGBEE_SENSOR_TEMPERATURE, TEMPERATURE_COOL, &mode, &gap));
+    TEST_ASSERT(sensor_event(ESP_ZIGBEE_SENSOR_TEMPERATURE, TEMPERATURE_HOT, &mode, &gap));
+    TEST_ASSERT_EQUAL(WINDOW_MODE_VENT, mode);
+    TEST_ASSERT(!sensor_event(ESP_ZIGBEE_SENSOR_TEMPERATURE, TEMPERATURE_HOT + 100, &mode, &gap));
+    
+    // Событие без правил не срабатывает
+    TEST_ASSERT(!sensor_event(ESP_ZIGBEE_SENSOR_ON_OFF, 1, &mode, &gap));
+    
+    // Правило хаба для команды On/Off
+    TEST_ASSERT_ESP_OK(automation_set_rule(RULE_ON_OFF_INDEX, ESP_ZIGBEE_SENSOR_ON_OFF, AUTOMATION_COND_EQUAL, 1,
+                                           WINDOW_MODE_OPEN, RULE_ON_OFF_GAP));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG,
+                      automation_set_rule(AUTOMATION_RULES_SIZE, ESP_ZIGBEE_SENSOR_ON_OFF, AUTOMATION_COND_EQUAL, 1,
+                                          WINDOW_MODE_OPEN, RULE_ON_OFF_GAP));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG,
+                      automation_set_rule(RULE_ON_OFF_INDEX, ESP_ZIGBEE_SENSOR_ON_OFF, AUTOMATION_COND_EQUAL, 1,
+                                          WINDOW_MODE_OPEN, 101));
+}
+
+/**
+ * @brief Запуск 2: правило хаба загружено из NVS, затем удаление всех правил
+ */
+static void boot_saved_rule(void *arg)
+{
+    window_mode_t mode;
+    uint8_t gap;
+    
+    TEST_ASSERT_ESP_OK(fake_nvs_attach(NVS_FILE));
+    TEST_ASSERT_ESP_OK(automation_init());
+    
+    TEST_ASSERT(sensor_event(ESP_ZIGBEE_SENSOR_ON_OFF, 1, &mode, &gap));
+    TEST_ASSERT_EQUAL(WINDOW_MODE_OPEN, mode);
+    TEST_ASSERT_EQUAL(RULE_ON_OFF_GAP, gap);
+    
+    // Правила по умолчанию сохранены вместе с правилом хаба
+    TEST_ASSERT(sensor_event(ESP_ZIGBEE_SENSOR_IAS_ZONE, IAS_ZONE_ALARM1, &mode, &gap));
+    TEST_ASSERT_EQUAL(WINDOW_MODE_CLOSED, mode);
+    
+    TEST_ASSERT_ESP_OK(automation_clear_rule(AUTOMATION_ALL_RULES));
+}
+
+/**
+ * @brief Запуск 3: удаленные правила не восстанавливаются значениями по умолчанию
+ */
+static void boot_cleared(void *arg)
+{
+    window_mode_t mode;
+    uint8_t gap;
+    
+    TEST_ASSERT_ESP_OK(fake_nvs_attach(NVS_FILE));
+    TEST_ASSERT_ESP_OK(automation_init());
+    
+    TEST_ASSERT(!sensor_event(ESP_ZIGBEE_SENSOR_IAS_ZONE, IAS_ZONE_ALARM1, &mode, &gap));
+    TEST_ASSERT(!sensor_event(ESP_ZIGBEE_SENSOR_TEMPERATURE, TEMPERATURE_HOT, &mode, &gap));
+    TEST_ASSERT(!sensor_event(ESP_ZIGBEE_SENSOR_ON_OFF, 1, &mode, &gap));
+}
+
+/**
+ * @brief Правила срабатывают по переходу условия и переживают перезапуск
+ */
+static void test_rules_fire_on_transition(void)
+{
+    remove(NVS_FILE);
+    
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_defaults, NULL));
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_saved_rule, NULL));
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_cleared, NULL));
+}
+
+int main(void)
+{
+    TEST_RUN(test_rules_fire_on_transition);
+    return 0;
+}
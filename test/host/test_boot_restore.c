@@ -0,0 +1,240 @@
+/**
+ * @file test_boot_restore.c
+ * @brief Запуск без движения окна: сервоприводы стартуют в сохраненном положении
+ * 
+ * Проверяется, что при холодном запуске и после глубокого сна окно не
+ * двигается, а фоновая калибровка не прерывается отключением сервоприводов
+ * после загрузки.
+ */
+
+#include <stdio.h>
+#include "host_test.h"
+#include "fake_host.h"
+#include "sim_device.h"
+#include "sim_servo.h"
+#include "state_management.h"
+#include "schedule.h"
+
+#define DEVICE_FILES        "test_boot_restore"
+#define DEVICE_RTC_FILE     DEVICE_FILES "_rtc.bin"
+#define RETAINED_OFFSET_WINDOW_MODE  5   // Режим окна в записи RTC-памяти (после magic и version)
+#define SERVO_IDLE_TIMEOUT  5000
+#define OPEN_HANDLE_ANGLE   90      // Ручка в режиме открыто
+#define OPEN_50_GAP_ANGLE   45      // Зазор 50% от 90°
+#define SCHEDULE_TIME       (9 * 86400 + 10 * 3600)  // Местное время перед сном: 10:00
+#define SCHEDULE_HOUR       10      // Запись расписания на 10:30
+#define SCHEDULE_MINUTE     30
+#define SCHEDULE_DUE_IN     (30 * 60)
+
+/**
+ * @brief Запуск 0: сохранение открытого окна и признака калибровки
+ */
+static void boot_seed_open(void *arg)
+{
+    sim_device_boot(DEVICE_FILES, ESP_RST_POWERON, ESP_SLEEP_WAKEUP_UNDEFINED);
+    TEST_ASSERT(sim_device_wait_servo_idle(SERVO_IDLE_TIMEOUT));
+    
+    TEST_ASSERT_ESP_OK(state_update_position(WINDOW_MODE_OPEN, 50));
+    TEST_ASSERT_ESP_OK(state_update_calibration(true));
+    TEST_ASSERT_ESP_OK(state_save());
+}
+
+/**
+ * @brief Холодный запуск: положение из NVS, движения нет, затем глубокий сон
+ */
+static void boot_cold_then_sleep(void *arg)
+{
+    TEST_ASSERT(!sim_device_boot(DEVICE_FILES, ESP_RST_POWERON, ESP_SLEEP_WAKEUP_UNDEFINED));
+    TEST_ASSERT(sim_device_wait_servo_idle(SERVO_IDLE_TIMEOUT));
+    
+    TEST_ASSERT_EQUAL(0, sim_servo_move_steps());
+    TEST_ASSERT_EQUAL(0, sim_servo_calibrations());
+    TEST_ASSERT_EQUAL(OPEN_HANDLE_ANGLE, servo_get_handle_angle());
+    TEST_ASSERT_EQUAL(OPEN_50_GAP_ANGLE, servo_get_gap_angle());
+    
+    sim_device_deep_sleep();
+}
+
+/**
+ * @brief Пробуждение из сна: положение из RTC-памяти, движения нет
+ */
+static void boot_warm(void *arg)
+{
+    TEST_ASSERT(sim_device_boot(DEVICE_FILES, ESP_RST_DEEPSLEEP, ESP_SLEEP_WAKEUP_TIMER));
+    TEST_ASSERT(sim_device_wait_servo_idle(SERVO_IDLE_TIMEOUT));
+    
+    TEST_ASSERT_EQUAL(0, sim_servo_move_steps());
+    TEST_ASSERT_EQUAL(0, sim_servo_calibrations());
+    TEST_ASSERT_EQUAL(OPEN_HANDLE_ANGLE, servo_get_handle_angle());
+    TEST_ASSERT_EQUAL(OPEN_50_GAP_ANGLE, servo_get_gap_angle());
+}
+
+/**
+ * @brief Холодный запуск и пробуждение из сна без движения окна
+ */
+static void test_no_motion_on_boot(void)
+{
+    sim_device_erase(DEVICE_FILES);
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_seed_open, NULL));
+    TEST_ASSERT_EQUAL(FAKE_EXIT_DEEP_SLEEP, fake_run_boot(boot_cold_then_sleep, NULL));
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_warm, NULL));
+}
+
+/**
+ * @brief Запуск, в котором копия в RTC-памяти не принимается: положение из NVS
+ */
+static void boot_expect_nvs_fallback(void *arg)
+{
+    esp_reset_reason_t reason = *(const esp_reset_reason_t *)arg;
+    esp_sleep_wakeup_cause_t wakeup_cause = reason == ESP_RST_DEEPSLEEP ? ESP_SLEEP_WAKEUP_TIMER
+                                                                        : ESP_SLEEP_WAKEUP_UNDEFINED;
+    
+    TEST_ASSERT(!sim_device_boot(DEVICE_FILES, reason, wakeup_cause));
+    TEST_ASSERT(sim_device_wait_servo_idle(SERVO_IDLE_TIMEOUT));
+    
+    device_state_t state = state_get_current();
+    TEST_ASSERT_EQUAL(WINDOW_MODE_OPEN, state.window_mode);
+    TEST_ASSERT_EQUAL(50, state.gap_percentage);
+    TEST_ASSERT_EQUAL(0, sim_servo_move_steps());
+    TEST_ASSERT_EQUAL(OPEN_HANDLE_ANGLE, servo_get_handle_angle());
+    TEST_ASSERT_EQUAL(OPEN_50_GAP_ANGLE, servo_get_gap_angle());
+}
+
+/**
+ * @brief Изменение одного байта копии состояния в RTC-памяти
+ */
+static void rtc_corrupt(size_t offset)
+{
+    FILE *file = fopen(DEVICE_RTC_FILE, "r+b");
+    TEST_ASSERT(file != NULL);
+    
+    TEST_ASSERT_EQUAL(0, fseek(file, (long)offset, SEEK_SET));
+    int value = fgetc(file);
+    TEST_ASSERT(value != EOF);
+    TEST_ASSERT_EQUAL(0, fseek(file, (long)offset, SEEK_SET));
+    TEST_ASSERT(fputc(value ^ 0x01, file) != EOF);
+    fclose(file);
+}
+
+/**
+ * @brief Копия с неверной CRC отбрасывается, состояние читается из NVS
+ */
+static void test_corrupt_retained_rejected(void)
+{
+    esp_reset_reason_t reason = ESP_RST_DEEPSLEEP;
+    
+    sim_device_erase(DEVICE_FILES);
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_seed_open, NULL));
+    TEST_ASSERT_EQUAL(FAKE_EXIT_DEEP_SLEEP, fake_run_boot(boot_cold_then_sleep, NULL));
+    rtc_corrupt(RETAINED_OFFSET_WINDOW_MODE);
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_expect_nvs_fallback, &reason));
+}
+
+/**
+ * @brief После программного сброса копия не используется, хотя RTC-память сохранилась
+ */
+static void test_retained_ignored_after_reset(void)
+{
+    esp_reset_reason_t reason = ESP_RST_SW;
+    
+    sim_device_erase(DEVICE_FILES);
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_seed_open, NULL));
+    TEST_ASSERT_EQUAL(FAKE_EXIT_DEEP_SLEEP, fake_run_boot(boot_cold_then_sleep, NULL));
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_expect_nvs_fallback, &reason));
+}
+
+/**
+ * @brief Синхронизация часов и запись расписания, затем глубокий сон
+ */
+static void boot_schedule_then_sleep(void *arg)
+{
+    uint32_t due_in;
+    
+    sim_device_boot(DEVICE_FILES, ESP_RST_POWERON, ESP_SLEEP_WAKEUP_UNDEFINED);
+    TEST_ASSERT(sim_device_wait_servo_idle(SERVO_IDLE_TIMEOUT));
+    
+    TEST_ASSERT_ESP_OK(schedule_set_time(SCHEDULE_TIME));
+    TEST_ASSERT_ESP_OK(schedule_set_entry(0, SCHEDULE_EVERY_DAY, SCHEDULE_HOUR, SCHEDULE_MINUTE,
+                                          WINDOW_MODE_OPEN, 50));
+    TEST_ASSERT(schedule_get_next_due_in(&due_in));
+    
+    // Таймер пробуждения взведен на срок ближайшей записи
+    sim_device_prepare_sleep();
+    TEST_ASSERT_EQUAL((uint64_t)due_in * 1000000, fake_sleep_timer_wakeup_us());
+    TEST_ASSERT(due_in <= SCHEDULE_DUE_IN && due_in + 2 >= SCHEDULE_DUE_IN);
+    
+    esp_deep_sleep_start();
+}
+
+/**
+ * @brief Пробуждение по таймеру: часы продолжают ход без синхронизации с хабом
+ */
+static void boot_schedule_wake(void *arg)
+{
+    uint32_t local_time;
+    uint32_t due_in;
+    
+    TEST_ASSERT(sim_device_boot(DEVICE_FILES, ESP_RST_DEEPSLEEP, ESP_SLEEP_WAKEUP_TIMER));
+    
+    TEST_ASSERT(schedule_get_time(&local_time));
+    TEST_ASSERT(local_time >= SCHEDULE_TIME && local_time <= SCHEDULE_TIME + 5);
+    TEST_ASSERT(schedule_get_next_due_in(&due_in));
+    TEST_ASSERT(due_in <= SCHEDULE_DUE_IN && due_in + 5 >= SCHEDULE_DUE_IN);
+}
+
+/**
+ * @brief Холодный запуск: время не переносится
+ */
+static void boot_schedule_cold(void *arg)
+{
+    uint32_t local_time;
+    
+    TEST_ASSERT(!sim_device_boot(DEVICE_FILES, ESP_RST_POWERON, ESP_SLEEP_WAKEUP_UNDEFINED));
+    TEST_ASSERT(!schedule_get_time(&local_time));
+}
+
+/**
+ * @brief Расписание будит устройство, время переносится через сон в RTC-памяти
+ */
+static void test_schedule_survives_sleep(void)
+{
+    sim_device_erase(DEVICE_FILES);
+    TEST_ASSERT_EQUAL(FAKE_EXIT_DEEP_SLEEP, fake_run_boot(boot_schedule_then_sleep, NULL));
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_schedule_wake, NULL));
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_schedule_cold, NULL));
+}
+
+/**
+ * @brief Первое включение: калибровка в фоне завершается до отключения сервоприводов
+ */
+static void boot_first_power_on(void *arg)
+{
+    // Медленное движение: отключение после загрузки пришлось бы на середину калибровки
+    sim_servo_set_step_delay_ms(1);
+    
+    sim_device_boot(DEVICE_FILES, ESP_RST_POWERON, ESP_SLEEP_WAKEUP_UNDEFINED);
+    TEST_ASSERT(sim_device_wait_servo_idle(SERVO_IDLE_TIMEOUT));
+    
+    TEST_ASSERT_EQUAL(1, sim_servo_calibrations());
+    TEST_ASSERT(!state_is_calibration_required());
+    TEST_ASSERT_EQUAL(0, sim_servo_move_steps());
+}
+
+/**
+ * @brief Калибровка не прерывается отключением сервоприводов после загрузки
+ */
+static void test_calibration_not_interrupted(void)
+{
+    sim_device_erase(DEVICE_FILES);
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_first_power_on, NULL));
+}
+
+int main(void)
+{
+    TEST_RUN(test_no_motion_on_boot);
+    TEST_RUN(test_calibration_not_interrupted);
+    TEST_RUN(test_schedule_survives_sleep);
+    TEST_RUN(test_corrupt_retained_rejected);
+    TEST_RUN(test_retained_ignored_after_reset);
+    return 0;
+}
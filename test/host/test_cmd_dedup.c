@@ -0,0 +1,172 @@
+/**
+ * @file test_cmd_dedup.c
+ * @brief Кэш последних команд: подавление повторов, вытеснение и время проверки
+ * 
+ * Хаб и настенный контроллер повторяют команды с тем же TSN, как при
+ * потере подтверждения APS. Повтор подавляется, пока запись команды в
+ * кэше; команда с другим источником, эндпоинтом, командой или TSN
+ * выполняется. Проверка вызывается для каждой входящей команды в задаче
+ * стека, ее время замеряется для попадания и промаха.
+ */
+
+#include <stdio.h>
+#include "host_test.h"
+#include "esp_timer.h"
+#include "cmd_dedup.h"
+
+#define HUB_ADDR                0x0000
+#define HUB_ENDPOINT            1
+#define CONTROLLER_ADDR         0x4F21
+#define CONTROLLER_ENDPOINT     3
+#define CMD_OPEN                0x01
+#define CMD_CLOSE               0x02
+#define REPLAYS                 3       // Повторов каждой команды
+#define LOOKUPS                 1000000
+#define LOOKUP_MAX_NS           1000    // Допустимое среднее время проверки
+
+static esp_zigbee_cmd_info_t command_info(uint16_t src_addr, uint8_t src_endpoint, uint8_t tsn)
+{
+    esp_zigbee_cmd_info_t info = {
+        .src_addr = src_addr,
+        .src_endpoint = src_endpoint,
+        .tsn = tsn
+    };
+    return info;
+}
+
+/**
+ * @brief Команда проходит проверку и принимается к исполнению
+ * 
+ * @return bool true, если команда выполнена (не повтор)
+ */
+static bool deliver(uint8_t cmd, const esp_zigbee_cmd_info_t *info)
+{
+    if (cmd_dedup_is_duplicate(cmd, info)) {
+        return false;
+    }
+    cmd_dedup_record(cmd, info);
+    return true;
+}
+
+/**
+ * @brief Повторы принятых команд подавляются, включая повторы вперемешку
+ */
+static void test_replays_suppressed(void)
+{
+    uint32_t executed = 0;
+    
+    for (uint8_t tsn = 10; tsn < 10 + CMD_DEDUP_ENTRIES / 2; tsn++) {
+        esp_zigbee_cmd_info_t hub = command_info(HUB_ADDR, HUB_ENDPOINT, tsn);
+        esp_zigbee_cmd_info_t controller = command_info(CONTROLLER_ADDR, CONTROLLER_ENDPOINT, tsn);
+        
+        executed += deliver(CMD_OPEN, &hub);
+        executed += deliver(CMD_OPEN, &controller);
+        
+        // Повторы приходят вперемешку от обоих отправителей
+        for (int replay = 0; replay < REPLAYS; replay++) {
+            executed += deliver(CMD_OPEN, &controller);
+            executed += deliver(CMD_OPEN, &hub);
+        }
+    }
+    
+    TEST_ASSERT_EQUAL(CMD_DEDUP_ENTRIES, executed);
+}
+
+/**
+ * @brief Команда, отличающаяся хотя бы одним полем, - не повтор
+ */
+static void test_distinct_commands(void)
+{
+    esp_zigbee_cmd_info_t info = command_info(HUB_ADDR, HUB_ENDPOINT, 50);
+    
+    TEST_ASSERT(deliver(CMD_OPEN, &info));
+    TEST_ASSERT(!deliver(CMD_OPEN, &info));
+    
+    // Тот же TSN, другая команда
+    TEST_ASSERT(deliver(CMD_CLOSE, &info));
+    
+    // Тот же TSN от другого эндпоинта и другого узла
+    esp_zigbee_cmd_info_t other_endpoint = command_info(HUB_ADDR, HUB_ENDPOINT + 1, 50);
+    TEST_ASSERT(deliver(CMD_OPEN, &other_endpoint));
+    esp_zigbee_cmd_info_t other_node = command_info(CONTROLLER_ADDR, HUB_ENDPOINT, 50);
+    TEST_ASSERT(deliver(CMD_OPEN, &other_node));
+    
+    // Следующий TSN
+    info.tsn++;
+    TEST_ASSERT(deliver(CMD_OPEN, &info));
+}
+
+/**
+ * @brief Непринятая команда не запоминается, ее повтор выполняется
+ */
+static void test_rejected_not_recorded(void)
+{
+    esp_zigbee_cmd_info_t info = command_info(HUB_ADDR, HUB_ENDPOINT, 70);
+    
+    TEST_ASSERT(!cmd_dedup_is_duplicate(CMD_OPEN, &info));
+    TEST_ASSERT(!cmd_dedup_is_duplicate(CMD_OPEN, &info));
+    cmd_dedup_record(CMD_OPEN, &info);
+    TEST_ASSERT(cmd_dedup_is_duplicate(CMD_OPEN, &info));
+}
+
+/**
+ * @brief Самая старая запись вытесняется после CMD_DEDUP_ENTRIES новых команд
+ */
+static void test_oldest_evicted(void)
+{
+    esp_zigbee_cmd_info_t first = command_info(CONTROLLER_ADDR, CONTROLLER_ENDPOINT, 200);
+    
+    TEST_ASSERT(deliver(CMD_OPEN, &first));
+    for (uint8_t i = 1; i < CMD_DEDUP_ENTRIES; i++) {
+        esp_zigbee_cmd_info_t info = command_info(CONTROLLER_ADDR, CONTROLLER_ENDPOINT, 200 + i);
+        TEST_ASSERT(deliver(CMD_OPEN, &info));
+    }
+    TEST_ASSERT(cmd_dedup_is_duplicate(CMD_OPEN, &first));
+    
+    esp_zigbee_cmd_info_t next = command_info(CONTROLLER_ADDR, CONTROLLER_ENDPOINT, 200 + CMD_DEDUP_ENTRIES);
+    TEST_ASSERT(deliver(CMD_OPEN, &next));
+    TEST_ASSERT(!cmd_dedup_is_duplicate(CMD_OPEN, &first));
+}
+
+/**
+ * @brief Время проверки при заполненном кэше: попадание в последнюю принятую команду и промах
+ */
+static void test_lookup_time(void)
+{
+    for (uint8_t i = 0; i < CMD_DEDUP_ENTRIES; i++) {
+        esp_zigbee_cmd_info_t info = command_info(HUB_ADDR, HUB_ENDPOINT, i);
+        cmd_dedup_record(CMD_OPEN, &info);
+    }
+    esp_zigbee_cmd_info_t hit = command_info(HUB_ADDR, HUB_ENDPOINT, CMD_DEDUP_ENTRIES - 1);
+    esp_zigbee_cmd_info_t miss = command_info(HUB_ADDR, HUB_ENDPOINT, CMD_DEDUP_ENTRIES);
+    
+    uint32_t hits = 0;
+    int64_t start_us = esp_timer_get_time();
+    for (int i = 0; i < LOOKUPS; i++) {
+        hits += cmd_dedup_is_duplicate(CMD_OPEN, &hit);
+    }
+    int64_t hit_us = esp_timer_get_time() - start_us;
+    
+    start_us = esp_timer_get_time();
+    for (int i = 0; i < LOOKUPS; i++) {
+        hits += cmd_dedup_is_duplicate(CMD_OPEN, &miss);
+    }
+    int64_t miss_us = esp_timer_get_time() - start_us;
+    
+    printf("кэш команд: %d записей, проверка %lld нс при попадании, %lld нс при промахе\n",
+           CMD_DEDUP_ENTRIES, (long long)(hit_us * 1000 / LOOKUPS), (long long)(miss_us * 1000 / LOOKUPS));
+    
+    TEST_ASSERT_EQUAL(LOOKUPS, hits);
+    TEST_ASSERT(hit_us * 1000 / LOOKUPS < LOOKUP_MAX_NS);
+    TEST_ASSERT(miss_us * 1000 / LOOKUPS < LOOKUP_MAX_NS);
+}
+
+int main(void)
+{
+    TEST_RUN(test_replays_suppressed);
+    TEST_RUN(test_distinct_commands);
+    TEST_RUN(test_rejected_not_recorded);
+    TEST_RUN(test_oldest_evicted);
+    TEST_RUN(test_lookup_time);
+    return 0;
+}
@@ -0,0 +1,190 @@
+/**
+ * @file test_command_dedup.c
+ * @brief Повторы команд хаба: подавление принятых и выполнение отброшенных
+ * 
+ * Исполнитель команд задерживается медленным движением сервопривода, пока
+ * очередь команд не заполнится. Команда, не поместившаяся в очередь, не
+ * запоминается для подавления повторов: ее повтор хабом с тем же TSN
+ * выполняется, а повтор уже выполненной команды - нет. Колбэк команды
+ * выполняется в задаче стека и должен возвращаться сразу, даже когда
+ * исполнитель занят.
+ */
+
+#include <stdio.h>
+#include "host_test.h"
+#include "fake_host.h"
+#include "sim_device.h"
+#include "sim_servo.h"
+#include "sim_zigbee_lib.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#define DEVICE_FILES            "test_command_dedup"
+#define HUB_ADDR                0x0000
+#define HUB_ENDPOINT            1
+#define QUEUE_DEPTH             8       // ZIGBEE_CMD_QUEUE_DEPTH в zigbee_handler.c
+#define SLOW_STEP_DELAY_MS      20      // Шаг сервопривода, задерживающий исполнителя
+#define GAP_FAR                 90      // Положение, движение к которому занимает исполнителя
+#define GAP_FILL                10      // Положение команд, заполняющих очередь
+#define GAP_DROPPED             55      // Положение отброшенной команды
+#define TSN_FIRST               100
+#define CALLBACK_MAX_US         2000    // Допустимое время выполнения колбэка, мкс
+#define WAIT_TIMEOUT_MS         5000
+#define SERVO_IDLE_TIMEOUT      20000
+
+/**
+ * @brief Ожидание отчета заданного вида (прочие отчеты пропускаются)
+ */
+static bool wait_report(sim_zigbee_report_kind_t kind, sim_zigbee_report_t *report)
+{
+    while (sim_zigbee_wait_report(report, WAIT_TIMEOUT_MS)) {
+        if (report->kind == kind) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Пропуск всех уже отправленных отчетов
+ */
+static void drain_reports(void)
+{
+    sim_zigbee_report_t report;
+    while (sim_zigbee_wait_report(&report, 100)) {
+    }
+}
+
+/**
+ * @brief Команда положения от хаба с заданным TSN
+ */
+static void send_position(uint8_t gap, uint8_t tsn)
+{
+    esp_zigbee_cmd_info_t info = {
+        .src_addr = HUB_ADDR,
+        .src_endpoint = HUB_ENDPOINT,
+        .tsn = tsn
+    };
+    sim_zigbee_send_command(ESP_ZIGBEE_CMD_SET_POSITION, &gap, 1, &info);
+}
+
+/**
+ * @brief Подключенное устройство с откалиброванными сервоприводами в режиме открытия
+ */
+static void prepare_device(void)
+{
+    sim_device_erase(DEVICE_FILES);
+    sim_device_boot(DEVICE_FILES, ESP_RST_POWERON, ESP_SLEEP_WAKEUP_UNDEFINED);
+    TEST_ASSERT(sim_device_wait_servo_idle(SERVO_IDLE_TIMEOUT));
+    
+    for (uint32_t waited = 0; !sim_zigbee_is_connected(); waited += 10) {
+        TEST_ASSERT(waited < WAIT_TIMEOUT_MS);
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    drain_reports();
+    
+    sim_zigbee_report_t report;
+    sim_zigbee_send_command(ESP_ZIGBEE_CMD_CALIBRATE, NULL, 0, NULL);
+    TEST_ASSERT(wait_report(SIM_ZIGBEE_REPORT_STATE, &report));
+    
+    uint8_t mode = ESP_ZIGBEE_WINDOW_MODE_OPEN;
+    sim_zigbee_send_command(ESP_ZIGBEE_CMD_SET_MODE, &mode, 1, NULL);
+    TEST_ASSERT(wait_report(SIM_ZIGBEE_REPORT_MODE, &report));
+    drain_reports();
+}
+
+/**
+ * @brief Ожидание обработки колбэком заданного числа команд
+ */
+static void wait_delivered(uint32_t accepted, uint32_t rejected, uint32_t duplicates)
+{
+    sim_zigbee_command_stats_t stats;
+    
+    for (uint32_t waited = 0;; waited += 10) {
+        sim_zigbee_get_command_stats(&stats);
+        if (stats.accepted >= accepted && stats.rejected >= rejected && stats.duplicates >= duplicates) {
+            break;
+        }
+        TEST_ASSERT(waited < WAIT_TIMEOUT_MS);
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    
+    TEST_ASSERT_EQUAL(accepted, stats.accepted);
+    TEST_ASSERT_EQUAL(rejected, stats.rejected);
+    TEST_ASSERT_EQUAL(duplicates, stats.duplicates);
+}
+
+/**
+ * @brief Запуск: переполнение очереди команд и повторы хаба
+ */
+static void boot_queue_full_replay(void *arg)
+{
+    sim_zigbee_command_stats_t stats;
+    sim_zigbee_report_t report;
+    
+    prepare_device();
+    sim_zigbee_get_command_stats(&stats);
+    uint32_t accepted = stats.accepted;
+    uint8_t tsn = TSN_FIRST;
+    
+    // Исполнитель занят долгим движением
+    sim_servo_set_step_delay_ms(SLOW_STEP_DELAY_MS);
+    sim_servo_motion_reset();
+    send_position(GAP_FAR, tsn++);
+    int64_t start_us;
+    int64_t end_us;
+    for (uint32_t waited = 0; !sim_servo_motion_times(&start_us, &end_us); waited += 5) {
+        TEST_ASSERT(waited < WAIT_TIMEOUT_MS);
+        vTaskDelay(pdMS_TO_TICKS(5));
+    }
+    accepted++;
+    
+    // Очередь заполняется, следующая команда отбрасывается
+    for (int i = 0; i < QUEUE_DEPTH; i++) {
+        send_position(GAP_FILL, tsn++);
+    }
+    accepted += QUEUE_DEPTH;
+    uint8_t dropped_tsn = tsn;
+    send_position(GAP_DROPPED, dropped_tsn);
+    wait_delivered(accepted, 1, 0);
+    
+    // Колбэк не ждет исполнителя
+    sim_zigbee_get_command_stats(&stats);
+    printf("колбэк команды: наибольшее время %lld мкс при занятом исполнителе\n",
+           (long long)stats.callback_max_us);
+    TEST_ASSERT(stats.callback_max_us < CALLBACK_MAX_US);
+    
+    // Исполнитель выполняет очередь, отброшенная команда не выполнена
+    sim_servo_set_step_delay_ms(0);
+    for (int i = 0; i < QUEUE_DEPTH + 1; i++) {
+        TEST_ASSERT(wait_report(SIM_ZIGBEE_REPORT_POSITION, &report));
+    }
+    TEST_ASSERT_EQUAL(GAP_FILL, report.value);
+    TEST_ASSERT(!sim_zigbee_wait_report(&report, 100));
+    
+    // Повтор хаба с тем же TSN выполняется
+    send_position(GAP_DROPPED, dropped_tsn);
+    TEST_ASSERT(wait_report(SIM_ZIGBEE_REPORT_POSITION, &report));
+    TEST_ASSERT_EQUAL(GAP_DROPPED, report.value);
+    wait_delivered(accepted + 1, 1, 0);
+    
+    // Повторы выполненных команд подавляются
+    send_position(GAP_DROPPED, dropped_tsn);
+    send_position(GAP_FILL, dropped_tsn - 1);
+    wait_delivered(accepted + 1, 1, 2);
+    TEST_ASSERT(!sim_zigbee_wait_report(&report, 100));
+}
+
+/**
+ * @brief Повтор команды, отброшенной из-за заполненной очереди, выполняется
+ */
+static void test_queue_full_replay(void)
+{
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_queue_full_replay, NULL));
+}
+
+int main(void)
+{
+    TEST_RUN(test_queue_full_replay);
+    return 0;
+}
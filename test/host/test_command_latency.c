@@ -0,0 +1,285 @@
+/**
+ * @file test_command_latency.c
+ * @brief Задержки обработки команд хаба: p50/p99 от команды до движения и отчета
+ * 
+ * Команды подаются через имитацию библиотеки ZigBee (граница esp_zigbee_lib.h)
+ * и проходят через zigbee_handler.c и state_management.c прошивки до
+ * имитированных сервоприводов. Отметки времени берутся снаружи модулей:
+ * передача команды стеку, первый и последний шаг сервопривода, отправка
+ * отчета. Выводятся p50/p99 для начала движения, конца движения и отчета.
+ * Отдельно проверяются этапы, которые отмечает сама прошивка, и попадание
+ * отметки отправки отчета, сделанной по APS-подтверждению, в свою корзину.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "host_test.h"
+#include "fake_host.h"
+#include "sim_device.h"
+#include "sim_servo.h"
+#include "sim_zigbee_lib.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "latency_stats.h"
+
+#define DEVICE_FILES            "test_command_latency"
+#define LATENCY_COMMANDS        100     // Команд в серии
+#define LATENCY_STEP_DELAY_MS   1       // Задержка шага сервопривода
+#define LATENCY_GAP_LOW         40      // Чередуемые положения зазора, %
+#define LATENCY_GAP_HIGH        50
+#define LATENCY_TIMEOUT_MS      2000
+#define SERVO_IDLE_TIMEOUT      5000
+#define LATENCY_GROUP_ID        0x0042
+#define LATENCY_SCENE_ID        3
+#define LATENCY_ACK_DELAY_MS    40      // Задержка APS-подтверждения отчета
+
+// Этапы обработки команды
+typedef enum {
+    LATENCY_SAMPLE_MOTION_START,
+    LATENCY_SAMPLE_MOTION_END,
+    LATENCY_SAMPLE_REPORT_SENT,
+    LATENCY_SAMPLE_COUNT
+} latency_sample_t;
+
+static const char *latency_sample_names[LATENCY_SAMPLE_COUNT] = {
+    "команда -> начало движения",
+    "команда -> конец движения",
+    "команда -> отчет отправлен"
+};
+
+/**
+ * @brief Сравнение для сортировки задержек
+ */
+static int latency_compare(const void *a, const void *b)
+{
+    int64_t left = *(const int64_t *)a;
+    int64_t right = *(const int64_t *)b;
+    return (left > right) - (left < right);
+}
+
+/**
+ * @brief Перцентиль отсортированной выборки
+ */
+static int64_t latency_percentile(const int64_t *sorted, size_t count, unsigned percent)
+{
+    size_t index = (count * percent) / 100;
+    return sorted[index < count ? index : count - 1];
+}
+
+/**
+ * @brief Ожидание отчета заданного вида (прочие отчеты пропускаются)
+ */
+static bool latency_wait_report(sim_zigbee_report_kind_t kind, sim_zigbee_report_t *report)
+{
+    while (sim_zigbee_wait_report(report, LATENCY_TIMEOUT_MS)) {
+        if (report->kind == kind) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Подключенное устройство с откалиброванными включенными сервоприводами
+ */
+static void latency_prepare_device(void)
+{
+    sim_device_boot(DEVICE_FILES, ESP_RST_POWERON, ESP_SLEEP_WAKEUP_UNDEFINED);
+    TEST_ASSERT(sim_device_wait_servo_idle(SERVO_IDLE_TIMEOUT));
+    
+    for (uint32_t waited = 0; !sim_zigbee_is_connected(); waited += 10) {
+        TEST_ASSERT(waited < LATENCY_TIMEOUT_MS);
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    
+    // Отчеты о подключении не относятся к командам теста
+    sim_zigbee_report_t report;
+    while (sim_zigbee_wait_report(&report, 50)) {
+    }
+    
+    // После загрузки сервоприводы отключены; калибровка по команде хаба включает их
+    sim_zigbee_send_command(ESP_ZIGBEE_CMD_CALIBRATE, NULL, 0, NULL);
+    TEST_ASSERT(latency_wait_report(SIM_ZIGBEE_REPORT_STATE, &report));
+    TEST_ASSERT(sim_servo_is_enabled());
+    
+    uint8_t mode = ESP_ZIGBEE_WINDOW_MODE_OPEN;
+    sim_zigbee_send_command(ESP_ZIGBEE_CMD_SET_MODE, &mode, 1, NULL);
+    TEST_ASSERT(latency_wait_report(SIM_ZIGBEE_REPORT_MODE, &report));
+}
+
+/**
+ * @brief Серия команд положения с измерением задержек
+ */
+static void boot_measure(void *arg)
+{
+    static int64_t samples[LATENCY_SAMPLE_COUNT][LATENCY_COMMANDS];
+    
+    latency_prepare_device();
+    sim_servo_set_step_delay_ms(LATENCY_STEP_DELAY_MS);
+    
+    for (int i = 0; i < LATENCY_COMMANDS; i++) {
+        uint8_t gap = (i % 2 == 0) ? LATENCY_GAP_LOW : LATENCY_GAP_HIGH;
+        sim_zigbee_report_t report;
+        int64_t start_us;
+        int64_t end_us;
+        
+        sim_servo_motion_reset();
+        int64_t command_us = sim_zigbee_send_command(ESP_ZIGBEE_CMD_SET_POSITION, &gap, 1, NULL);
+        
+        if (!latency_wait_report(SIM_ZIGBEE_REPORT_POSITION, &report)) {
+            TEST_FAIL("команда %d: нет отчета о положении", i);
+        }
+        TEST_ASSERT_EQUAL(gap, report.value);
+        TEST_ASSERT(sim_servo_motion_times(&start_us, &end_us));
+        
+        samples[LATENCY_SAMPLE_MOTION_START][i] = start_us - command_us;
+        samples[LATENCY_SAMPLE_MOTION_END][i] = end_us - command_us;
+        samples[LATENCY_SAMPLE_REPORT_SENT][i] = report.time_us - command_us;
+        
+        // Отчет отправляется только после завершения движения
+        TEST_ASSERT(start_us <= end_us && end_us <= report.time_us);
+    }
+    
+    fprintf(stderr, "   команд: %d, шаг сервопривода: %d мс\n", LATENCY_COMMANDS, LATENCY_STEP_DELAY_MS);
+    for (int stage = 0; stage < LATENCY_SAMPLE_COUNT; stage++) {
+        qsort(samples[stage], LATENCY_COMMANDS, sizeof(int64_t), latency_compare);
+        fprintf(stderr, "   p50 %6lld мкс, p99 %6lld мкс: %s\n",
+                (long long)latency_percentile(samples[stage], LATENCY_COMMANDS, 50),
+                (long long)latency_percentile(samples[stage], LATENCY_COMMANDS, 99),
+                latency_sample_names[stage]);
+    }
+}
+
+/**
+ * @brief Число отметок этапа в корзине гистограммы прошивки
+ */
+static uint32_t latency_bucket_count(latency_stage_t stage, int bucket)
+{
+    uint8_t buf[2 + LATENCY_STAGE_MAX * LATENCY_HIST_BUCKETS * sizeof(uint16_t)];
+    size_t len;
+    TEST_ASSERT_ESP_OK(latency_stats_export(buf, sizeof(buf), &len));
+    
+    const uint8_t *counter = &buf[2 + (stage * LATENCY_HIST_BUCKETS + bucket) * sizeof(uint16_t)];
+    return counter[0] | (counter[1] << 8);
+}
+
+/**
+ * @brief Число отметок этапа в гистограммах прошивки
+ */
+static uint32_t latency_stage_count(latency_stage_t stage)
+{
+    uint32_t count = 0;
+    for (int bucket = 0; bucket < LATENCY_HIST_BUCKETS; bucket++) {
+        count += latency_bucket_count(stage, bucket);
+    }
+    return count;
+}
+
+/**
+ * @brief Отметки этапов прошивкой: движение по сервоприводу, отчет группы по таймеру
+ */
+static void boot_stage_marks(void *arg)
+{
+    latency_prepare_device();
+    
+    uint8_t gap = LATENCY_GAP_LOW;
+    sim_zigbee_report_t report;
+    sim_zigbee_send_command(ESP_ZIGBEE_CMD_SET_POSITION, &gap, 1, NULL);
+    TEST_ASSERT(latency_wait_report(SIM_ZIGBEE_REPORT_POSITION, &report));
+    
+    esp_zigbee_cmd_info_t group = {
+        .group_addressed = true,
+        .group_id = LATENCY_GROUP_ID
+    };
+    uint8_t scene[3] = { LATENCY_GROUP_ID & 0xFF, LATENCY_GROUP_ID >> 8, LATENCY_SCENE_ID };
+    sim_zigbee_send_command(ESP_ZIGBEE_CMD_STORE_SCENE, scene, sizeof(scene), &group);
+    
+    gap = LATENCY_GAP_HIGH;
+    sim_zigbee_send_command(ESP_ZIGBEE_CMD_SET_POSITION, &gap, 1, NULL);
+    TEST_ASSERT(latency_wait_report(SIM_ZIGBEE_REPORT_POSITION, &report));
+    vTaskDelay(pdMS_TO_TICKS(50));
+    latency_stats_reset();
+    
+    // Команда без изменения положения не начинает движение
+    sim_zigbee_send_command(ESP_ZIGBEE_CMD_SET_POSITION, &gap, 1, NULL);
+    TEST_ASSERT(latency_wait_report(SIM_ZIGBEE_REPORT_POSITION, &report));
+    vTaskDelay(pdMS_TO_TICKS(50));
+    TEST_ASSERT_EQUAL(0, latency_stage_count(LATENCY_STAGE_MOTION_START));
+    TEST_ASSERT_EQUAL(0, latency_stage_count(LATENCY_STAGE_MOTION_END));
+    TEST_ASSERT_EQUAL(1, latency_stage_count(LATENCY_STAGE_REPORT_SENT));
+    
+    // Групповой вызов сцены: отчет отправляется таймером после случайной задержки
+    latency_stats_reset();
+    sim_zigbee_send_command(ESP_ZIGBEE_CMD_RECALL_SCENE, scene, sizeof(scene), &group);
+    TEST_ASSERT(latency_wait_report(SIM_ZIGBEE_REPORT_STATE, &report));
+    TEST_ASSERT_EQUAL(LATENCY_GAP_LOW, report.extra);
+    vTaskDelay(pdMS_TO_TICKS(50));
+    TEST_ASSERT_EQUAL(1, latency_stage_count(LATENCY_STAGE_MOTION_START));
+    TEST_ASSERT_EQUAL(1, latency_stage_count(LATENCY_STAGE_MOTION_END));
+    TEST_ASSERT_EQUAL(1, latency_stage_count(LATENCY_STAGE_REPORT_SENT));
+}
+
+/**
+ * @brief Отправка отчета отмечается по APS-подтверждению, а не при постановке в слот
+ */
+static void boot_report_ack(void *arg)
+{
+    latency_prepare_device();
+    
+    uint8_t gap = LATENCY_GAP_LOW;
+    sim_zigbee_report_t report;
+    sim_zigbee_send_command(ESP_ZIGBEE_CMD_SET_POSITION, &gap, 1, NULL);
+    TEST_ASSERT(latency_wait_report(SIM_ZIGBEE_REPORT_POSITION, &report));
+    vTaskDelay(pdMS_TO_TICKS(50));
+    
+    // Команда без движения: отчет ставится в слот сразу, подтверждается через LATENCY_ACK_DELAY_MS
+    sim_zigbee_set_ack_delay_ms(LATENCY_ACK_DELAY_MS);
+    latency_stats_reset();
+    sim_zigbee_send_command(ESP_ZIGBEE_CMD_SET_POSITION, &gap, 1, NULL);
+    TEST_ASSERT(latency_wait_report(SIM_ZIGBEE_REPORT_POSITION, &report));
+    vTaskDelay(pdMS_TO_TICKS(LATENCY_ACK_DELAY_MS * 2));
+    
+    TEST_ASSERT_EQUAL(1, latency_stage_count(LATENCY_STAGE_REPORT_QUEUED));
+    TEST_ASSERT_EQUAL(1, latency_stage_count(LATENCY_STAGE_REPORT_SENT));
+    
+    int ack_bucket = latency_bucket_index(LATENCY_ACK_DELAY_MS * 1000);
+    TEST_ASSERT_EQUAL(1, latency_bucket_count(LATENCY_STAGE_REPORT_SENT, ack_bucket));
+    for (int bucket = ack_bucket; bucket < LATENCY_HIST_BUCKETS; bucket++) {
+        TEST_ASSERT_EQUAL(0, latency_bucket_count(LATENCY_STAGE_REPORT_QUEUED, bucket));
+    }
+}
+
+/**
+ * @brief Задержка отправки отчета попадает в корзину задержки подтверждения
+ */
+static void test_report_sent_bucket(void)
+{
+    sim_device_erase(DEVICE_FILES);
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_report_ack, NULL));
+}
+
+/**
+ * @brief Этапы, отмеченные прошивкой, соответствуют движению и отправке отчета
+ */
+static void test_firmware_stage_marks(void)
+{
+    sim_device_erase(DEVICE_FILES);
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_stage_marks, NULL));
+}
+
+/**
+ * @brief Задержки команд положения от хаба
+ */
+static void test_set_position_latency(void)
+{
+    sim_device_erase(DEVICE_FILES);
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_measure, NULL));
+}
+
+int main(void)
+{
+    TEST_RUN(test_set_position_latency);
+    TEST_RUN(test_firmware_stage_marks);
+    TEST_RUN(test_report_sent_bucket);
+    return 0;
+}
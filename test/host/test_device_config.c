@@ -0,0 +1,172 @@
+/**
+ * @file test_device_config.c
+ * @brief Реестр параметров: запись по ZigBee, проверка диапазонов, сохранение в NVS
+ * 
+ * Пакет конфигурации приходит командой хаба и применяется только целиком.
+ * Действующие значения публикуются в атрибуте производителя, переживают
+ * перезапуск, а поврежденная запись в NVS заменяется значениями по умолчанию.
+ */
+
+#include <stdio.h>
+#include "host_test.h"
+#include "fake_host.h"
+#include "sim_device.h"
+#include "sim_zigbee_lib.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "nvs.h"
+#include "device_config.h"
+
+#define DEVICE_FILES            "test_device_config"
+#define DEVICE_NVS_FILE         DEVICE_FILES "_nvs.bin"
+#define CONFIG_NAMESPACE        "dev_config"
+#define CONFIG_KEY              "config"
+#define CONNECT_TIMEOUT_MS      2000
+#define APPLY_TIMEOUT_MS        500
+#define ANGLE_OPEN_DEFAULT      90
+#define ANGLE_OPEN_CUSTOM       120
+#define REPORT_INTERVAL_DEFAULT 10000
+
+/**
+ * @brief Ожидание подключения к сети
+ */
+static void config_wait_connected(void)
+{
+    for (uint32_t waited = 0; !sim_zigbee_is_connected(); waited += 10) {
+        TEST_ASSERT(waited < CONNECT_TIMEOUT_MS);
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+}
+
+/**
+ * @brief Значение параметра в пакете из атрибута производителя
+ */
+static bool config_attr_value(config_key_t key, uint32_t *value)
+{
+    uint8_t data[ESP_ZIGBEE_MANUF_ATTR_MAX_LEN];
+    int len = sim_zigbee_get_manuf_attribute(ESP_ZIGBEE_MANUF_ATTR_CONFIG, data);
+    if (len < 2 || data[0] != DEVICE_CONFIG_PACKET_VERSION) {
+        return false;
+    }
+    
+    int pos = 2;
+    for (int i = 0; i < data[1] && pos + 2 <= len; i++) {
+        uint8_t entry_key = data[pos];
+        int size = data[pos + 1] == CONFIG_TYPE_U8 ? 1 : (data[pos + 1] == CONFIG_TYPE_U16 ? 2 : 4);
+        pos += 2;
+        if (pos + size > len) {
+            return false;
+        }
+        
+        uint32_t entry_value = 0;
+        for (int byte = 0; byte < size; byte++) {
+            entry_value |= (uint32_t)data[pos + byte] << (8 * byte);
+        }
+        pos += size;
+        
+        if (entry_key == key) {
+            *value = entry_value;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Запись по ZigBee: допустимый пакет применяется, пакет с ошибкой - целиком отклоняется
+ */
+static void boot_write_config(void *arg)
+{
+    sim_device_boot(DEVICE_FILES, ESP_RST_POWERON, ESP_SLEEP_WAKEUP_UNDEFINED);
+    config_wait_connected();
+    TEST_ASSERT_EQUAL(ANGLE_OPEN_DEFAULT, device_config_get(CONFIG_KEY_ANGLE_OPEN));
+    
+    uint8_t valid[] = { DEVICE_CONFIG_PACKET_VERSION, 1, CONFIG_KEY_ANGLE_OPEN, CONFIG_TYPE_U8, ANGLE_OPEN_CUSTOM };
+    sim_zigbee_send_command(ESP_ZIGBEE_CMD_WRITE_CONFIG, valid, sizeof(valid), NULL);
+    for (uint32_t waited = 0; device_config_get(CONFIG_KEY_ANGLE_OPEN) != ANGLE_OPEN_CUSTOM; waited += 10) {
+        TEST_ASSERT(waited < APPLY_TIMEOUT_MS);
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    vTaskDelay(pdMS_TO_TICKS(50));
+    
+    uint32_t value = 0;
+    TEST_ASSERT(config_attr_value(CONFIG_KEY_ANGLE_OPEN, &value));
+    TEST_ASSERT_EQUAL(ANGLE_OPEN_CUSTOM, value);
+    
+    // Второй параметр вне диапазона: первый тоже не применяется
+    uint8_t invalid[] = {
+        DEVICE_CONFIG_PACKET_VERSION, 2,
+        CONFIG_KEY_REPORT_INTERVAL_MS, CONFIG_TYPE_U32, 0x88, 0x13, 0x00, 0x00,
+        CONFIG_KEY_ANGLE_VENT, CONFIG_TYPE_U8, 5
+    };
+    sim_zigbee_send_command(ESP_ZIGBEE_CMD_WRITE_CONFIG, invalid, sizeof(invalid), NULL);
+    vTaskDelay(pdMS_TO_TICKS(100));
+    
+    TEST_ASSERT_EQUAL(REPORT_INTERVAL_DEFAULT, device_config_get(CONFIG_KEY_REPORT_INTERVAL_MS));
+    TEST_ASSERT(config_attr_value(CONFIG_KEY_REPORT_INTERVAL_MS, &value));
+    TEST_ASSERT_EQUAL(REPORT_INTERVAL_DEFAULT, value);
+}
+
+/**
+ * @brief Значение параметра после перезапуска
+ */
+static void boot_expect_angle(void *arg)
+{
+    uint32_t expected = *(const uint32_t *)arg;
+    
+    sim_device_boot(DEVICE_FILES, ESP_RST_POWERON, ESP_SLEEP_WAKEUP_UNDEFINED);
+    TEST_ASSERT_EQUAL(expected, device_config_get(CONFIG_KEY_ANGLE_OPEN));
+}
+
+/**
+ * @brief Порча одного байта записи параметров в NVS
+ */
+static void boot_corrupt(void *arg)
+{
+    TEST_ASSERT_ESP_OK(fake_nvs_attach(DEVICE_NVS_FILE));
+    
+    nvs_handle_t handle;
+    TEST_ASSERT_ESP_OK(nvs_open(CONFIG_NAMESPACE, NVS_READWRITE, &handle));
+    
+    uint8_t record[DEVICE_CONFIG_PACKET_MAX_LEN * 2 + 4];
+    size_t size = sizeof(record);
+    TEST_ASSERT_ESP_OK(nvs_get_blob(handle, CONFIG_KEY, record, &size));
+    TEST_ASSERT(size > 4);
+    
+    record[size / 2] ^= 0x01;
+    TEST_ASSERT_ESP_OK(nvs_set_blob(handle, CONFIG_KEY, record, size));
+    TEST_ASSERT_ESP_OK(nvs_commit(handle));
+    nvs_close(handle);
+}
+
+/**
+ * @brief Записанный по ZigBee параметр переживает перезапуск
+ */
+static void test_config_written_and_persisted(void)
+{
+    uint32_t angle = ANGLE_OPEN_CUSTOM;
+    
+    sim_device_erase(DEVICE_FILES);
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_write_config, NULL));
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_expect_angle, &angle));
+}
+
+/**
+ * @brief Поврежденная запись параметров заменяется значениями по умолчанию
+ */
+static void test_corrupt_config_defaults(void)
+{
+    uint32_t angle = ANGLE_OPEN_DEFAULT;
+    
+    sim_device_erase(DEVICE_FILES);
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_write_config, NULL));
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_corrupt, NULL));
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_expect_angle, &angle));
+}
+
+int main(void)
+{
+    TEST_RUN(test_config_written_and_persisted);
+    TEST_RUN(test_corrupt_config_defaults);
+    return 0;
+}
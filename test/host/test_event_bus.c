@@ -0,0 +1,228 @@
+/**
+ * @file test_event_bus.c
+ * @brief Шина событий: порядок доставки, разделение типов и время публикации
+ * 
+ * Подписчики вызываются в задаче издателя в порядке подписки. События
+ * одного издателя доходят до каждого подписчика в порядке публикации,
+ * в том числе когда два издателя публикуют одновременно.
+ */
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "host_test.h"
+#include "esp_timer.h"
+#include "event_bus.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#define ORDER_LOG_SIZE          64
+#define PUBLISHER_EVENTS        100     // Событий каждого издателя (зазор 0-99)
+#define PUBLISH_TIMEOUT_MS      3000
+#define PUBLISHES               1000000
+#define PUBLISH_MAX_NS          2000    // Допустимое среднее время публикации
+
+// Журнал вызовов: номер подписчика и зазор события
+static struct {
+    uint8_t subscriber[ORDER_LOG_SIZE];
+    uint8_t gap[ORDER_LOG_SIZE];
+    uint32_t count;
+    volatile bool enabled;
+} order_log = { .enabled = true };
+
+// Наблюдения подписчика по источникам команд
+typedef struct {
+    int16_t last_gap[EVENT_SOURCE_AUTOMATION + 1];
+    uint32_t received[EVENT_SOURCE_AUTOMATION + 1];
+    uint32_t out_of_order;
+} source_observer_t;
+
+static source_observer_t observers[EVENT_BUS_MAX_SUBSCRIBERS];
+static volatile uint32_t publishers_done;
+static volatile uint32_t resistance_events;
+static volatile uint32_t bench_calls;
+
+static void log_position(const event_bus_event_t *event, void *ctx)
+{
+    if (!order_log.enabled) {
+        return;
+    }
+    
+    TEST_ASSERT(order_log.count < ORDER_LOG_SIZE);
+    TEST_ASSERT_EQUAL(EVENT_BUS_POSITION_CHANGED, event->id);
+    order_log.subscriber[order_log.count] = (uint8_t)(uintptr_t)ctx;
+    order_log.gap[order_log.count] = event->position.gap_percentage;
+    order_log.count++;
+}
+
+static void count_resistance(const event_bus_event_t *event, void *ctx)
+{
+    TEST_ASSERT_EQUAL(EVENT_BUS_RESISTANCE_DETECTED, event->id);
+    resistance_events++;
+}
+
+/**
+ * @brief Подписчик, проверяющий порядок событий каждого источника
+ * 
+ * Поля источника меняет только задача издателя этого источника.
+ */
+static void observe_source(const event_bus_event_t *event, void *ctx)
+{
+    source_observer_t *observer = ctx;
+    event_source_t source = event->position.source;
+    
+    if (event->position.gap_percentage != observer->last_gap[source] + 1) {
+        observer->out_of_order++;
+    }
+    observer->last_gap[source] = event->position.gap_percentage;
+    observer->received[source]++;
+}
+
+static void count_bench(const event_bus_event_t *event, void *ctx)
+{
+    bench_calls++;
+}
+
+static void publish_position(uint8_t gap, event_source_t source)
+{
+    event_bus_event_t event = {
+        .id = EVENT_BUS_POSITION_CHANGED,
+        .position = {
+            .mode = WINDOW_MODE_OPEN,
+            .gap_percentage = gap,
+            .source = source
+        }
+    };
+    TEST_ASSERT_ESP_OK(event_bus_publish(&event));
+}
+
+/**
+ * @brief Задача издателя: события с растущим зазором от одного источника
+ */
+static void publisher(void *arg)
+{
+    event_source_t source = (event_source_t)(uintptr_t)arg;
+    
+    for (uint8_t gap = 0; gap < PUBLISHER_EVENTS; gap++) {
+        publish_position(gap, source);
+        if (gap % 10 == 0) {
+            taskYIELD();
+        }
+    }
+    
+    publishers_done++;
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Обработчики вызываются в порядке подписки, события - в порядке публикации
+ * 
+ * Первым тестом, пока таблицы подписчиков пусты. Подписчики последующих
+ * тестов добавляются к уже подписанным.
+ */
+static void test_subscription_order(void)
+{
+    event_bus_event_t resistance = {
+        .id = EVENT_BUS_RESISTANCE_DETECTED,
+        .resistance = { .handle_angle = 45 }
+    };
+    
+    for (uintptr_t i = 0; i < 2; i++) {
+        TEST_ASSERT_ESP_OK(event_bus_subscribe(EVENT_BUS_POSITION_CHANGED, log_position, (void *)i));
+    }
+    TEST_ASSERT_ESP_OK(event_bus_subscribe(EVENT_BUS_RESISTANCE_DETECTED, count_resistance, NULL));
+    
+    publish_position(10, EVENT_SOURCE_ZIGBEE);
+    publish_position(20, EVENT_SOURCE_SCHEDULE);
+    TEST_ASSERT_ESP_OK(event_bus_publish(&resistance));
+    
+    // Подписчик 0, подписчик 1 для каждого события по очереди
+    static const uint8_t expected_subscriber[] = { 0, 1, 0, 1 };
+    static const uint8_t expected_gap[] = { 10, 10, 20, 20 };
+    TEST_ASSERT_EQUAL(4, order_log.count);
+    for (uint32_t i = 0; i < order_log.count; i++) {
+        TEST_ASSERT_EQUAL(expected_subscriber[i], order_log.subscriber[i]);
+        TEST_ASSERT_EQUAL(expected_gap[i], order_log.gap[i]);
+    }
+    
+    // Событие другого типа до подписчиков положения не дошло
+    TEST_ASSERT_EQUAL(1, resistance_events);
+}
+
+/**
+ * @brief Заполненная таблица и неизвестный тип события
+ */
+static void test_limits(void)
+{
+    event_bus_event_t unknown = { .id = EVENT_BUS_MAX };
+    
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, event_bus_subscribe(EVENT_BUS_MAX, log_position, NULL));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, event_bus_subscribe(EVENT_BUS_POSITION_CHANGED, NULL, NULL));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, event_bus_publish(&unknown));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, event_bus_publish(NULL));
+    
+    for (uint8_t i = 1; i < EVENT_BUS_MAX_SUBSCRIBERS; i++) {
+        TEST_ASSERT_ESP_OK(event_bus_subscribe(EVENT_BUS_RESISTANCE_DETECTED, count_bench, NULL));
+    }
+    TEST_ASSERT_EQUAL(ESP_ERR_NO_MEM, event_bus_subscribe(EVENT_BUS_RESISTANCE_DETECTED, count_bench, NULL));
+}
+
+/**
+ * @brief Два издателя одновременно: у каждого подписчика события источника по порядку
+ */
+static void test_concurrent_publishers(void)
+{
+    for (uint8_t i = 2; i < EVENT_BUS_MAX_SUBSCRIBERS; i++) {
+        for (int source = 0; source <= EVENT_SOURCE_AUTOMATION; source++) {
+            observers[i].last_gap[source] = -1;
+        }
+        TEST_ASSERT_ESP_OK(event_bus_subscribe(EVENT_BUS_POSITION_CHANGED, observe_source, &observers[i]));
+    }
+    
+    // Подписчики журнала остаются подписанными, но журнал больше не ведется
+    order_log.enabled = false;
+    TEST_ASSERT_EQUAL(pdPASS, xTaskCreate(publisher, "zigbee", 4096, (void *)EVENT_SOURCE_ZIGBEE, 5, NULL));
+    TEST_ASSERT_EQUAL(pdPASS, xTaskCreate(publisher, "schedule", 4096, (void *)EVENT_SOURCE_SCHEDULE, 5, NULL));
+    for (uint32_t waited = 0; publishers_done < 2; waited++) {
+        TEST_ASSERT(waited < PUBLISH_TIMEOUT_MS);
+        vTaskDelay(pdMS_TO_TICKS(1));
+    }
+    
+    for (uint8_t i = 2; i < EVENT_BUS_MAX_SUBSCRIBERS; i++) {
+        TEST_ASSERT_EQUAL(0, observers[i].out_of_order);
+        TEST_ASSERT_EQUAL(PUBLISHER_EVENTS, observers[i].received[EVENT_SOURCE_ZIGBEE]);
+        TEST_ASSERT_EQUAL(PUBLISHER_EVENTS, observers[i].received[EVENT_SOURCE_SCHEDULE]);
+    }
+}
+
+/**
+ * @brief Время публикации события всем подписчикам
+ */
+static void test_publish_time(void)
+{
+    event_bus_event_t event = {
+        .id = EVENT_BUS_RESISTANCE_DETECTED,
+        .resistance = { .handle_angle = 45 }
+    };
+    
+    bench_calls = 0;
+    int64_t start_us = esp_timer_get_time();
+    for (int i = 0; i < PUBLISHES; i++) {
+        event_bus_publish(&event);
+    }
+    int64_t elapsed_us = esp_timer_get_time() - start_us;
+    
+    printf("шина событий: %d публикаций, %d подписчиков, %lld нс на публикацию\n",
+           PUBLISHES, EVENT_BUS_MAX_SUBSCRIBERS, (long long)(elapsed_us * 1000 / PUBLISHES));
+    
+    TEST_ASSERT_EQUAL((uint64_t)PUBLISHES * (EVENT_BUS_MAX_SUBSCRIBERS - 1), bench_calls);
+    TEST_ASSERT(elapsed_us * 1000 / PUBLISHES < PUBLISH_MAX_NS);
+}
+
+int main(void)
+{
+    TEST_RUN(test_subscription_order);
+    TEST_RUN(test_limits);
+    TEST_RUN(test_concurrent_publishers);
+    TEST_RUN(test_publish_time);
+    return 0;
+}
@@ -0,0 +1,122 @@
+/**
+ * @file test_event_history.c
+ * @brief Журнал событий: запись в NVS по заполненным страницам и перед перезагрузкой
+ * 
+ * Отдельное событие не перезаписывает страницу журнала в NVS. Страница
+ * записывается отложенной записью, когда заполнится, незаполненная - при
+ * перезагрузке. При отключении питания теряются только события
+ * незаполненной страницы.
+ */
+
+#include <stdio.h>
+#include "host_test.h"
+#include "fake_host.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_system.h"
+#include "state_management.h"
+#include "event_history.h"
+
+#define NVS_FILE                "test_event_history_nvs.bin"
+#define HISTORY_NAMESPACE       "evt_history"
+#define HISTORY_PAGE_RECORDS    16
+#define PERSIST_WAIT_MS         2500    // Больше паузы отложенной записи состояния
+
+/**
+ * @brief Подключение NVS и инициализация журнала
+ */
+static void history_boot(void)
+{
+    TEST_ASSERT_ESP_OK(fake_nvs_attach(NVS_FILE));
+    TEST_ASSERT_ESP_OK(state_init());
+    TEST_ASSERT_ESP_OK(state_load());
+    TEST_ASSERT_ESP_OK(event_history_init());
+}
+
+/**
+ * @brief Добавление событий перезагрузки с данными по порядку
+ */
+static void history_record(int count)
+{
+    for (int i = 0; i < count; i++) {
+        TEST_ASSERT_ESP_OK(event_history_record(EVENT_TYPE_REBOOT, EVENT_SOURCE_SYSTEM, (uint16_t)i));
+    }
+}
+
+/**
+ * @brief Число сохраненных событий и номер следующего
+ */
+static int history_count(uint32_t *next_sequence)
+{
+    uint8_t buf[EVENT_HISTORY_PAGE_HEADER_SIZE + EVENT_HISTORY_SIZE * sizeof(event_record_t)];
+    size_t len;
+    TEST_ASSERT_ESP_OK(event_history_export(1, buf, sizeof(buf), &len));
+    
+    *next_sequence = buf[2] | (buf[3] << 8) | (buf[4] << 16) | ((uint32_t)buf[5] << 24);
+    return buf[1];
+}
+
+/**
+ * @brief Страница записывается один раз, когда заполнится; остаток - при перезагрузке
+ */
+static void boot_fill_and_restart(void *arg)
+{
+    history_boot();
+    
+    history_record(HISTORY_PAGE_RECORDS - 1);
+    vTaskDelay(pdMS_TO_TICKS(PERSIST_WAIT_MS));
+    TEST_ASSERT_EQUAL(0, fake_nvs_key_write_count(HISTORY_NAMESPACE, "page0"));
+    
+    history_record(1);
+    vTaskDelay(pdMS_TO_TICKS(PERSIST_WAIT_MS));
+    TEST_ASSERT_EQUAL(1, fake_nvs_key_write_count(HISTORY_NAMESPACE, "page0"));
+    
+    history_record(2);
+    vTaskDelay(pdMS_TO_TICKS(PERSIST_WAIT_MS));
+    TEST_ASSERT_EQUAL(0, fake_nvs_key_write_count(HISTORY_NAMESPACE, "page1"));
+    
+    esp_restart();
+}
+
+/**
+ * @brief Проверка сохраненных событий, затем события без записи и отключение питания
+ */
+static void boot_expect_and_lose_power(void *arg)
+{
+    uint32_t next_sequence;
+    
+    history_boot();
+    TEST_ASSERT_EQUAL(HISTORY_PAGE_RECORDS + 2, history_count(&next_sequence));
+    TEST_ASSERT_EQUAL(HISTORY_PAGE_RECORDS + 3, next_sequence);
+    
+    history_record(3);
+}
+
+/**
+ * @brief После отключения питания потеряны только события незаполненной страницы
+ */
+static void boot_expect_after_power_loss(void *arg)
+{
+    uint32_t next_sequence;
+    
+    history_boot();
+    TEST_ASSERT_EQUAL(HISTORY_PAGE_RECORDS + 2, history_count(&next_sequence));
+    TEST_ASSERT_EQUAL(HISTORY_PAGE_RECORDS + 3, next_sequence);
+}
+
+/**
+ * @brief Запись журнала в NVS по страницам и перед перезагрузкой
+ */
+static void test_history_flush_points(void)
+{
+    remove(NVS_FILE);
+    TEST_ASSERT_EQUAL(FAKE_EXIT_RESTART, fake_run_boot(boot_fill_and_restart, NULL));
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_expect_and_lose_power, NULL));
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_expect_after_power_loss, NULL));
+}
+
+int main(void)
+{
+    TEST_RUN(test_history_flush_points);
+    return 0;
+}
@@ -0,0 +1,227 @@
+/**
+ * @file test_h2_diagnostics.c
+ * @brief Счетчики кластера Diagnostics библиотеки ZigBee ESP32-H2
+ * 
+ * Каждый счетчик проверяется по событию имитации радиотракта, которое его
+ * изменяет: прием команды, подтвержденный кадр, повторы MAC и потеря
+ * подтверждения, смена родителя, потеря периодического отчета Diagnostics.
+ */
+
+#include <stdio.h>
+#include "host_test.h"
+#include "fake_host.h"
+#include "sim_zb_radio.h"
+#include "esp_zigbee_lib.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#define CONNECT_TIMEOUT_MS      8000
+#define FRAME_TIMEOUT_MS        3000
+#define TEST_CMD                0x05
+#define MAC_RETRIES             2
+#define DIAG_INTERVAL_MS        100
+#define DIAG_REPORTS            3
+
+// Уровень команд и подтверждений
+#define CMD_LQI                 180
+#define CMD_RSSI                (-70)
+#define ACK_LQI                 150
+#define ACK_RSSI                (-80)
+
+/**
+ * @brief Ожидание подключения к сети
+ */
+static void wait_connected(void)
+{
+    for (uint32_t waited = 0; esp_zigbee_get_state() != ESP_ZIGBEE_STATE_PAIRED; waited += 10) {
+        TEST_ASSERT(waited < CONNECT_TIMEOUT_MS);
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+}
+
+/**
+ * @brief Смена канала до родителя
+ */
+static void set_link(uint32_t loss_percent, uint8_t lqi, int8_t rssi)
+{
+    sim_zb_radio_link_t link = {
+        .loss_percent = loss_percent,
+        .max_retries = MAC_RETRIES,
+        .lqi = lqi,
+        .rssi = rssi
+    };
+    sim_zb_radio_set_link(&link);
+}
+
+/**
+ * @brief Библиотека подключена к сети
+ */
+static void start_connected(uint32_t diag_report_interval_ms, uint32_t loss_percent)
+{
+    esp_zigbee_config_t config = {
+        .device_name = "test_window",
+        .diag_report_interval_ms = diag_report_interval_ms
+    };
+    
+    set_link(loss_percent, CMD_LQI, CMD_RSSI);
+    TEST_ASSERT_ESP_OK(esp_zigbee_init(&config));
+    TEST_ASSERT_ESP_OK(esp_zigbee_start());
+    wait_connected();
+}
+
+/**
+ * @brief Ожидание обработки библиотекой статусов отправки отчетов
+ */
+static void wait_reliable(uint32_t frames_sent, uint32_t delivered)
+{
+    esp_zigbee_reliable_stats_t stats;
+    
+    for (uint32_t waited = 0;; waited += 10) {
+        TEST_ASSERT_ESP_OK(esp_zigbee_get_reliable_stats(&stats));
+        if (stats.frames_sent >= frames_sent && stats.delivered >= delivered) {
+            break;
+        }
+        TEST_ASSERT(waited < FRAME_TIMEOUT_MS);
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    
+    TEST_ASSERT_EQUAL(frames_sent, stats.frames_sent);
+    TEST_ASSERT_EQUAL(delivered, stats.delivered);
+}
+
+/**
+ * @brief Запуск: счетчики приема, передачи, повторов и смены родителя
+ */
+static void boot_counters(void *arg)
+{
+    esp_zigbee_diag_counters_t counters;
+    sim_zb_radio_frame_t frame;
+    
+    start_connected(0, 0);
+    
+    // Принятая команда: mac_rx и уровень последнего сообщения
+    uint8_t gap = 42;
+    sim_zb_radio_send_command(TEST_CMD, &gap, 1);
+    for (uint32_t waited = 0;; waited += 10) {
+        TEST_ASSERT_ESP_OK(esp_zigbee_get_diagnostics(&counters));
+        if (counters.mac_rx == 1) {
+            break;
+        }
+        TEST_ASSERT(waited < FRAME_TIMEOUT_MS);
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    TEST_ASSERT_EQUAL(CMD_LQI, counters.last_lqi);
+    TEST_ASSERT_EQUAL(CMD_RSSI, counters.last_rssi);
+    
+    // Подтвержденный кадр: mac_tx и уровень подтверждения
+    set_link(0, ACK_LQI, ACK_RSSI);
+    TEST_ASSERT_ESP_OK(esp_zigbee_report_window_state(ESP_ZIGBEE_WINDOW_MODE_OPEN, 10));
+    TEST_ASSERT(sim_zb_radio_wait_frame(&frame, FRAME_TIMEOUT_MS));
+    TEST_ASSERT_EQUAL(1, frame.attempts);
+    wait_reliable(1, 1);
+    
+    TEST_ASSERT_ESP_OK(esp_zigbee_get_diagnostics(&counters));
+    TEST_ASSERT_EQUAL(1, counters.mac_tx);
+    TEST_ASSERT_EQUAL(0, counters.mac_tx_retries);
+    TEST_ASSERT_EQUAL(ACK_LQI, counters.last_lqi);
+    TEST_ASSERT_EQUAL(ACK_RSSI, counters.last_rssi);
+    
+    // Кадр без подтверждения после всех повторов MAC
+    set_link(100, ACK_LQI, ACK_RSSI);
+    TEST_ASSERT_ESP_OK(esp_zigbee_report_window_state(ESP_ZIGBEE_WINDOW_MODE_OPEN, 20));
+    TEST_ASSERT(sim_zb_radio_wait_frame(&frame, FRAME_TIMEOUT_MS));
+    TEST_ASSERT_EQUAL(1 + MAC_RETRIES, frame.attempts);
+    TEST_ASSERT(!frame.acked);
+    wait_reliable(2 + MAC_RETRIES, 1);
+    
+    // Потеря подтверждения учитывается после числа попыток
+    for (uint32_t waited = 0;; waited += 10) {
+        TEST_ASSERT_ESP_OK(esp_zigbee_get_diagnostics(&counters));
+        if (counters.aps_ack_failures == 1) {
+            break;
+        }
+        TEST_ASSERT(waited < FRAME_TIMEOUT_MS);
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    TEST_ASSERT_EQUAL(2 + MAC_RETRIES, counters.mac_tx);
+    TEST_ASSERT_EQUAL(MAC_RETRIES, counters.mac_tx_retries);
+    TEST_ASSERT_EQUAL(1, counters.mac_tx_failures);
+    
+    // Повтор слота надежной доставки подтверждается
+    set_link(0, ACK_LQI, ACK_RSSI);
+    TEST_ASSERT(sim_zb_radio_wait_frame(&frame, FRAME_TIMEOUT_MS));
+    TEST_ASSERT(frame.acked);
+    wait_reliable(3 + MAC_RETRIES, 2);
+    
+    // Смена родителя учитывается после переподключения
+    sim_zb_radio_set_parent(false);
+    sim_zb_radio_set_parent(true);
+    wait_connected();
+    
+    TEST_ASSERT_ESP_OK(esp_zigbee_get_diagnostics(&counters));
+    TEST_ASSERT_EQUAL(1, counters.mac_rx);
+    TEST_ASSERT_EQUAL(3 + MAC_RETRIES, counters.mac_tx);
+    TEST_ASSERT_EQUAL(MAC_RETRIES, counters.mac_tx_retries);
+    TEST_ASSERT_EQUAL(1, counters.mac_tx_failures);
+    TEST_ASSERT_EQUAL(1, counters.aps_ack_failures);
+    TEST_ASSERT_EQUAL(1, counters.parent_changes);
+    TEST_ASSERT_EQUAL(0, counters.queue_overflows);
+    TEST_ASSERT_EQUAL(0, counters.report_drops);
+}
+
+/**
+ * @brief Запуск: периодический отчет Diagnostics и его потеря
+ */
+static void boot_periodic_report(void *arg)
+{
+    esp_zigbee_diag_counters_t counters;
+    esp_zigbee_reliable_stats_t stats;
+    sim_zb_radio_frame_t frame;
+    
+    start_connected(DIAG_INTERVAL_MS, 100);
+    
+    // Отчеты идут с заданным интервалом и не повторяются
+    uint32_t reports = 0;
+    int64_t first_us = 0;
+    while (reports < DIAG_REPORTS) {
+        TEST_ASSERT(sim_zb_radio_wait_frame(&frame, FRAME_TIMEOUT_MS));
+        TEST_ASSERT_EQUAL(ZB_RADIO_FRAME_DIAGNOSTICS, frame.type);
+        TEST_ASSERT(!frame.acked);
+        if (reports++ == 0) {
+            first_us = frame.time_us;
+        }
+    }
+    TEST_ASSERT(frame.time_us - first_us >= (int64_t)(DIAG_REPORTS - 1) * DIAG_INTERVAL_MS * 1000 * 9 / 10);
+    vTaskDelay(pdMS_TO_TICKS(DIAG_INTERVAL_MS / 2));
+    
+    // Каждый потерянный отчет - report_drops; надежная доставка не затронута
+    TEST_ASSERT_ESP_OK(esp_zigbee_get_diagnostics(&counters));
+    TEST_ASSERT(counters.report_drops >= DIAG_REPORTS);
+    TEST_ASSERT(counters.aps_ack_failures >= DIAG_REPORTS);
+    TEST_ASSERT(counters.mac_tx_failures >= DIAG_REPORTS);
+    TEST_ASSERT_ESP_OK(esp_zigbee_get_reliable_stats(&stats));
+    TEST_ASSERT_EQUAL(0, stats.frames_sent);
+}
+
+/**
+ * @brief Каждое событие радиотракта меняет свой счетчик
+ */
+static void test_counters(void)
+{
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_counters, NULL));
+}
+
+/**
+ * @brief Отчет Diagnostics отправляется периодически, потеря учитывается
+ */
+static void test_periodic_report(void)
+{
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_periodic_report, NULL));
+}
+
+int main(void)
+{
+    TEST_RUN(test_counters);
+    TEST_RUN(test_periodic_report);
+    return 0;
+}
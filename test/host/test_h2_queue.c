@@ -0,0 +1,235 @@
+/**
+ * @file test_h2_queue.c
+ * @brief Очередь сообщений библиотеки ZigBee ESP32-H2: пропускная способность, задержка и переполнение
+ * 
+ * Команды координатора проходят весь путь приема: радиотракт
+ * (sim_zb_radio_send_command), очередь сообщений, задача обработки и
+ * колбэк on_command. Каждая команда несет номер и время отправки, задержка
+ * считается от постановки в очередь до вызова колбэка.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "host_test.h"
+#include "fake_host.h"
+#include "sim_zb_radio.h"
+#include "esp_zigbee_lib.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#define CONNECT_TIMEOUT_MS      8000
+#define WAIT_TIMEOUT_MS         3000
+#define TEST_CMD                0x05
+
+// Замер пропускной способности
+#define BENCH_QUEUE_DEPTH       64
+#define BENCH_BATCH             32      // Команд подряд, затем ожидание обработки
+#define BENCH_BATCHES           300
+#define BENCH_MIN_RATE          1000    // Команд/с (прежняя задача обработки - не больше 100)
+#define BENCH_MAX_AVG_LATENCY_US 10000  // Прежняя фиксированная задержка после каждого сообщения
+
+// Переполнение очереди
+#define OVERFLOW_QUEUE_DEPTH    4
+#define OVERFLOW_EXTRA          3       // Команд сверх глубины очереди
+
+// Наблюдения колбэка команд
+static struct {
+    volatile uint32_t commands;
+    volatile bool hold;                 // Колбэк ждет, задача обработки занята
+    volatile bool busy;                 // Колбэк вызван
+    uint32_t sequence[BENCH_QUEUE_DEPTH];
+    bool in_order;
+    uint32_t next_sequence;
+    uint64_t latency_sum_us;
+    uint32_t latency_max_us;
+} seen;
+
+/**
+ * @brief Команда: номер и младшие 32 бита времени отправки
+ */
+static void on_command(uint8_t cmd, const uint8_t *data, uint16_t len)
+{
+    uint32_t now = (uint32_t)esp_timer_get_time();
+    uint32_t sequence;
+    uint32_t sent_us;
+    
+    TEST_ASSERT_EQUAL(TEST_CMD, cmd);
+    TEST_ASSERT_EQUAL(sizeof(sequence) + sizeof(sent_us), len);
+    memcpy(&sequence, data, sizeof(sequence));
+    memcpy(&sent_us, data + sizeof(sequence), sizeof(sent_us));
+    
+    seen.busy = true;
+    while (seen.hold) {
+        vTaskDelay(pdMS_TO_TICKS(1));
+    }
+    
+    uint32_t latency_us = now - sent_us;
+    seen.latency_sum_us += latency_us;
+    if (latency_us > seen.latency_max_us) {
+        seen.latency_max_us = latency_us;
+    }
+    
+    if (sequence != seen.next_sequence) {
+        seen.in_order = false;
+    }
+    seen.next_sequence = sequence + 1;
+    seen.sequence[seen.commands % BENCH_QUEUE_DEPTH] = sequence;
+    seen.commands++;
+}
+
+/**
+ * @brief Команда координатора с номером
+ */
+static void send_command(uint32_t sequence)
+{
+    uint8_t data[8];
+    uint32_t sent_us = (uint32_t)esp_timer_get_time();
+    
+    memcpy(data, &sequence, sizeof(sequence));
+    memcpy(data + sizeof(sequence), &sent_us, sizeof(sent_us));
+    sim_zb_radio_send_command(TEST_CMD, data, sizeof(data));
+}
+
+/**
+ * @brief Ожидание обработки заданного числа команд
+ */
+static void wait_commands(uint32_t count)
+{
+    for (uint32_t waited = 0; seen.commands < count; waited++) {
+        TEST_ASSERT(waited < WAIT_TIMEOUT_MS);
+        vTaskDelay(pdMS_TO_TICKS(1));
+    }
+}
+
+/**
+ * @brief Библиотека подключена к сети с заданной очередью
+ */
+static void start_connected(uint8_t queue_depth, esp_zigbee_queue_policy_t policy)
+{
+    esp_zigbee_config_t config = {
+        .device_name = "test_window",
+        .queue_depth = queue_depth,
+        .queue_policy = policy,
+        .on_command = on_command
+    };
+    sim_zb_radio_link_t link = { .lqi = 200, .rssi = -60 };
+    
+    seen.in_order = true;
+    sim_zb_radio_set_link(&link);
+    TEST_ASSERT_ESP_OK(esp_zigbee_init(&config));
+    TEST_ASSERT_ESP_OK(esp_zigbee_start());
+    
+    for (uint32_t waited = 0; esp_zigbee_get_state() != ESP_ZIGBEE_STATE_PAIRED; waited += 10) {
+        TEST_ASSERT(waited < CONNECT_TIMEOUT_MS);
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+}
+
+/**
+ * @brief Запуск: команды сериями, скорость обработки и задержка до колбэка
+ */
+static void boot_throughput(void *arg)
+{
+    esp_zigbee_diag_counters_t counters;
+    
+    start_connected(BENCH_QUEUE_DEPTH, ESP_ZIGBEE_QUEUE_DROP_OLDEST);
+    
+    uint32_t sequence = 0;
+    int64_t start_us = esp_timer_get_time();
+    for (int batch = 0; batch < BENCH_BATCHES; batch++) {
+        for (int i = 0; i < BENCH_BATCH; i++) {
+            send_command(sequence++);
+        }
+        wait_commands(sequence);
+    }
+    int64_t elapsed_us = esp_timer_get_time() - start_us;
+    
+    uint64_t rate = (uint64_t)sequence * 1000000 / (uint64_t)elapsed_us;
+    uint64_t avg_latency_us = seen.latency_sum_us / sequence;
+    printf("очередь: %lu команд за %lld мкс, %llu команд/с, задержка средняя %llu мкс, наибольшая %lu мкс\n",
+           (unsigned long)sequence, (long long)elapsed_us, (unsigned long long)rate,
+           (unsigned long long)avg_latency_us, (unsigned long)seen.latency_max_us);
+    fflush(stdout);
+    
+    TEST_ASSERT(seen.in_order);
+    TEST_ASSERT(rate >= BENCH_MIN_RATE);
+    TEST_ASSERT(avg_latency_us < BENCH_MAX_AVG_LATENCY_US);
+    
+    TEST_ASSERT_ESP_OK(esp_zigbee_get_diagnostics(&counters));
+    TEST_ASSERT_EQUAL(0, counters.queue_overflows);
+    TEST_ASSERT_EQUAL(sequence, counters.mac_rx);
+}
+
+/**
+ * @brief Запуск: занятая задача обработки, вытеснение старых команд и объединение отчетов
+ */
+static void boot_overflow(void *arg)
+{
+    esp_zigbee_diag_counters_t counters;
+    sim_zb_radio_frame_t frame;
+    
+    start_connected(OVERFLOW_QUEUE_DEPTH, ESP_ZIGBEE_QUEUE_COALESCE);
+    
+    // Задача обработки занята первой командой
+    seen.hold = true;
+    send_command(0);
+    for (uint32_t waited = 0; !seen.busy; waited++) {
+        TEST_ASSERT(waited < WAIT_TIMEOUT_MS);
+        vTaskDelay(pdMS_TO_TICKS(1));
+    }
+    
+    // Очередь заполняется, самые старые команды вытесняются; отправитель не ждет
+    uint32_t total = 1 + OVERFLOW_QUEUE_DEPTH + OVERFLOW_EXTRA;
+    int64_t start_us = esp_timer_get_time();
+    for (uint32_t sequence = 1; sequence < total; sequence++) {
+        send_command(sequence);
+    }
+    
+    // Отчеты о состоянии окна объединяются и место в очереди не занимают
+    for (uint8_t gap = 10; gap <= 50; gap += 10) {
+        TEST_ASSERT_ESP_OK(esp_zigbee_report_window_state(ESP_ZIGBEE_WINDOW_MODE_OPEN, gap));
+    }
+    TEST_ASSERT(esp_timer_get_time() - start_us < WAIT_TIMEOUT_MS * 1000 / 10);
+    
+    TEST_ASSERT_ESP_OK(esp_zigbee_get_diagnostics(&counters));
+    TEST_ASSERT_EQUAL(OVERFLOW_EXTRA, counters.queue_overflows);
+    
+    // Обработаны первая команда и последние OVERFLOW_QUEUE_DEPTH
+    seen.hold = false;
+    wait_commands(1 + OVERFLOW_QUEUE_DEPTH);
+    vTaskDelay(pdMS_TO_TICKS(50));
+    TEST_ASSERT_EQUAL(1 + OVERFLOW_QUEUE_DEPTH, seen.commands);
+    for (uint32_t i = 1; i <= OVERFLOW_QUEUE_DEPTH; i++) {
+        TEST_ASSERT_EQUAL(total - 1 - OVERFLOW_QUEUE_DEPTH + i, seen.sequence[i]);
+    }
+    
+    // Передан только последний отчет
+    TEST_ASSERT(sim_zb_radio_wait_frame(&frame, WAIT_TIMEOUT_MS));
+    TEST_ASSERT_EQUAL(ZB_RADIO_FRAME_REPORT, frame.type);
+    TEST_ASSERT_EQUAL(50, frame.param2);
+    TEST_ASSERT(!sim_zb_radio_wait_frame(&frame, 100));
+}
+
+/**
+ * @brief Очередь обрабатывается сериями без фиксированной задержки
+ */
+static void test_throughput(void)
+{
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_throughput, NULL));
+}
+
+/**
+ * @brief Переполнение вытесняет старые команды, отчеты объединяются
+ */
+static void test_overflow(void)
+{
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_overflow, NULL));
+}
+
+int main(void)
+{
+    TEST_RUN(test_throughput);
+    TEST_RUN(test_overflow);
+    return 0;
+}
@@ -0,0 +1,226 @@
+/**
+ * @file test_h2_tx_power.c
+ * @brief Адаптивная мощность передачи ESP32-H2: регулирование по статусам отправки и оценка энергии
+ * 
+ * Имитация радиотракта задает затухание до родителя: уровень подтверждений
+ * и потери попыток зависят от мощности, с которой передан кадр. Отчеты
+ * отправляются по одному, каждый следующий - после статуса предыдущего.
+ */
+
+#include <stdio.h>
+#include "host_test.h"
+#include "fake_host.h"
+#include "sim_zb_radio.h"
+#include "esp_zigbee_lib.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#define CONNECT_TIMEOUT_MS      8000
+#define FRAME_TIMEOUT_MS        3000
+#define RETRY_TIMEOUT_MS        20000   // Повторы слота надежной доставки с нарастающей задержкой
+#define MAC_RETRIES             3
+
+// Затухание до родителя (дБ)
+#define PATH_LOSS_NEAR          60      // Запас позволяет снизить мощность до минимума
+#define PATH_LOSS_FAR           105     // На минимальной мощности кадры не доходят
+#define PATH_LOSS_MID           85      // Запас 10 дБ сохраняется на -4 дБм
+
+#define TX_POWER_MIN_DBM        (-6)    // ZB_TXP_MIN_DBM в esp_zigbee_lib.c
+#define TX_POWER_MID_DBM        (-4)
+#define TX_POWER_MAX_DBM        20      // CONFIG_ESP_ZB_TX_POWER
+#define SETTLE_FRAMES           120
+
+// Заряд одной попытки на максимальной мощности по модели тока esp_zigbee_lib.c:
+// (11000 мкА + 100 мВт / 3.3 В / 30%) * 2000 мкс
+#define MAX_POWER_ATTEMPT_NC    224020
+
+/**
+ * @brief Ожидание подключения к сети
+ */
+static void wait_connected(void)
+{
+    for (uint32_t waited = 0; esp_zigbee_get_state() != ESP_ZIGBEE_STATE_PAIRED; waited += 10) {
+        TEST_ASSERT(waited < CONNECT_TIMEOUT_MS);
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+}
+
+/**
+ * @brief Библиотека подключена к сети с заданным затуханием до родителя
+ */
+static void start_connected(bool adaptive_tx_power, uint8_t path_loss_db)
+{
+    esp_zigbee_config_t config = {
+        .device_name = "test_window",
+        .adaptive_tx_power = adaptive_tx_power
+    };
+    sim_zb_radio_link_t link = {
+        .max_retries = MAC_RETRIES,
+        .path_loss_db = path_loss_db
+    };
+    
+    sim_zb_radio_set_link(&link);
+    TEST_ASSERT_ESP_OK(esp_zigbee_init(&config));
+    TEST_ASSERT_ESP_OK(esp_zigbee_start());
+    wait_connected();
+}
+
+/**
+ * @brief Смена затухания до родителя
+ */
+static void set_path_loss(uint8_t path_loss_db)
+{
+    sim_zb_radio_link_t link = {
+        .max_retries = MAC_RETRIES,
+        .path_loss_db = path_loss_db
+    };
+    sim_zb_radio_set_link(&link);
+}
+
+/**
+ * @brief Отчет и все его передачи до подтверждения
+ * 
+ * @return int8_t Мощность, на которой отчет подтвержден
+ */
+static int8_t report_until_acked(uint8_t gap, uint32_t timeout_ms)
+{
+    sim_zb_radio_frame_t frame;
+    
+    TEST_ASSERT_ESP_OK(esp_zigbee_report_window_state(ESP_ZIGBEE_WINDOW_MODE_OPEN, gap));
+    do {
+        TEST_ASSERT(sim_zb_radio_wait_frame(&frame, timeout_ms));
+    } while (frame.type != ZB_RADIO_FRAME_REPORT || frame.param2 != gap || !frame.acked);
+    
+    return frame.tx_power_dbm;
+}
+
+/**
+ * @brief Ожидание обработки библиотекой статуса последнего отчета
+ */
+static void wait_delivered(void)
+{
+    esp_zigbee_reliable_stats_t stats;
+    
+    for (uint32_t waited = 0;; waited += 10) {
+        TEST_ASSERT_ESP_OK(esp_zigbee_get_reliable_stats(&stats));
+        if (stats.delivered + stats.superseded == stats.submitted) {
+            break;
+        }
+        TEST_ASSERT(waited < FRAME_TIMEOUT_MS);
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+}
+
+/**
+ * @brief Серия отчетов, после которой мощность устанавливается
+ */
+static int8_t settle(uint32_t frames)
+{
+    int8_t tx_power_dbm = 0;
+    
+    for (uint32_t i = 0; i < frames; i++) {
+        tx_power_dbm = report_until_acked(i % 100 + 1, FRAME_TIMEOUT_MS);
+    }
+    wait_delivered();
+    
+    esp_zigbee_diag_counters_t counters;
+    TEST_ASSERT_ESP_OK(esp_zigbee_get_diagnostics(&counters));
+    TEST_ASSERT_EQUAL(tx_power_dbm, counters.tx_power_dbm);
+    return tx_power_dbm;
+}
+
+/**
+ * @brief Сэкономленная энергия передачи
+ */
+static void print_energy(const char *name, const esp_zigbee_tx_energy_stats_t *energy)
+{
+    uint64_t saved_nc = energy->baseline_charge_nc - energy->charge_nc;
+    
+    printf("%s: кадров %lu, попыток %lu, заряд %llu нКл из %llu нКл, "
+           "экономия %llu нКл на кадр (%llu%%)\n",
+           name, (unsigned long)energy->frames, (unsigned long)energy->attempts,
+           (unsigned long long)energy->charge_nc, (unsigned long long)energy->baseline_charge_nc,
+           (unsigned long long)(saved_nc / energy->frames),
+           (unsigned long long)(saved_nc * 100 / energy->baseline_charge_nc));
+    fflush(stdout);
+}
+
+/**
+ * @brief Запуск: снижение вблизи родителя, повышение при удалении, запас на среднем расстоянии
+ */
+static void boot_adaptive(void *arg)
+{
+    esp_zigbee_diag_counters_t counters;
+    esp_zigbee_tx_energy_stats_t energy;
+    
+    start_connected(true, PATH_LOSS_NEAR);
+    
+    // Кадры подтверждаются с первой попытки, мощность снижается до минимума
+    TEST_ASSERT_EQUAL(TX_POWER_MIN_DBM, settle(SETTLE_FRAMES));
+    TEST_ASSERT_ESP_OK(esp_zigbee_get_tx_energy_stats(&energy));
+    TEST_ASSERT_EQUAL((uint64_t)energy.attempts * MAX_POWER_ATTEMPT_NC, energy.baseline_charge_nc);
+    TEST_ASSERT(energy.charge_nc < energy.baseline_charge_nc);
+    print_energy("вблизи родителя", &energy);
+    
+    // Кадры на минимальной мощности теряются: мощность повышается, пока отчет
+    // не будет подтвержден
+    TEST_ASSERT_ESP_OK(esp_zigbee_get_diagnostics(&counters));
+    uint32_t increases = counters.tx_power_increases;
+    set_path_loss(PATH_LOSS_FAR);
+    int8_t tx_power_dbm = report_until_acked(1, RETRY_TIMEOUT_MS);
+    wait_delivered();
+    TEST_ASSERT(tx_power_dbm > TX_POWER_MIN_DBM);
+    TEST_ASSERT_ESP_OK(esp_zigbee_get_diagnostics(&counters));
+    TEST_ASSERT(counters.tx_power_increases > increases);
+    
+    // Низкий уровень подтверждений мощность не снижает
+    TEST_ASSERT(settle(SETTLE_FRAMES / 4) >= tx_power_dbm);
+    
+    // Снижение останавливается на запасе ZB_TXP_TARGET_MARGIN_DB
+    set_path_loss(PATH_LOSS_MID);
+    TEST_ASSERT_EQUAL(TX_POWER_MID_DBM, settle(SETTLE_FRAMES));
+    
+    // Базовая линия - те же попытки на максимальной мощности
+    TEST_ASSERT_ESP_OK(esp_zigbee_get_tx_energy_stats(&energy));
+    TEST_ASSERT_EQUAL((uint64_t)energy.attempts * MAX_POWER_ATTEMPT_NC, energy.baseline_charge_nc);
+    print_energy("все этапы", &energy);
+}
+
+/**
+ * @brief Запуск: без адаптивной мощности расход совпадает с базовой линией
+ */
+static void boot_fixed(void *arg)
+{
+    esp_zigbee_tx_energy_stats_t energy;
+    
+    start_connected(false, PATH_LOSS_NEAR);
+    TEST_ASSERT_EQUAL(TX_POWER_MAX_DBM, settle(SETTLE_FRAMES / 4));
+    
+    TEST_ASSERT_ESP_OK(esp_zigbee_get_tx_energy_stats(&energy));
+    TEST_ASSERT(energy.frames >= SETTLE_FRAMES / 4);
+    TEST_ASSERT_EQUAL((uint64_t)energy.attempts * MAX_POWER_ATTEMPT_NC, energy.baseline_charge_nc);
+    TEST_ASSERT_EQUAL(energy.baseline_charge_nc, energy.charge_nc);
+}
+
+/**
+ * @brief Мощность следует за затуханием до родителя, энергия считается по тем же попыткам
+ */
+static void test_adaptive_tx_power(void)
+{
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_adaptive, NULL));
+}
+
+/**
+ * @brief Постоянная максимальная мощность не дает экономии
+ */
+static void test_fixed_tx_power(void)
+{
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_fixed, NULL));
+}
+
+int main(void)
+{
+    TEST_RUN(test_adaptive_tx_power);
+    TEST_RUN(test_fixed_tx_power);
+    return 0;
+}
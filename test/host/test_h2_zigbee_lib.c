@@ -0,0 +1,232 @@
+/**
+ * @file test_h2_zigbee_lib.c
+ * @brief Библиотека ZigBee ESP32-H2 с имитацией радиотракта: команды, доставка отчетов, переподключение
+ * 
+ * esp32-h2-zigbee-window/components/esp_zigbee_lib собирается с
+ * sim/sim_zb_radio.c вместо zb_radio.c. Каждый запуск выполняется в
+ * отдельном процессе: состояние библиотеки статическое.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "host_test.h"
+#include "fake_host.h"
+#include "sim_zb_radio.h"
+#include "esp_zigbee_lib.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#define CONNECT_TIMEOUT_MS      8000    // Разброс первой попытки входа в сеть и одна повторная
+#define FRAME_TIMEOUT_MS        3000
+#define TEST_CMD                0x05
+#define TEST_LQI                200
+#define TEST_RSSI               (-60)
+#define ACK_DELAY_MS            200
+
+// Наблюдения колбэков библиотеки
+static struct {
+    volatile uint32_t commands;
+    uint8_t cmd;
+    uint8_t data[8];
+    uint16_t len;
+    volatile uint32_t disconnects;
+} seen;
+
+static void on_command(uint8_t cmd, const uint8_t *data, uint16_t len)
+{
+    seen.cmd = cmd;
+    seen.len = len;
+    memcpy(seen.data, data, len);
+    seen.commands++;
+}
+
+static void on_disconnected(void)
+{
+    seen.disconnects++;
+}
+
+/**
+ * @brief Ожидание подключения к сети
+ */
+static void wait_connected(void)
+{
+    for (uint32_t waited = 0; esp_zigbee_get_state() != ESP_ZIGBEE_STATE_PAIRED; waited += 10) {
+        TEST_ASSERT(waited < CONNECT_TIMEOUT_MS);
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+}
+
+/**
+ * @brief Библиотека подключена к сети с заданным каналом до родителя
+ */
+static void start_connected(const sim_zb_radio_link_t *link)
+{
+    esp_zigbee_config_t config = {
+        .device_name = "test_window",
+        .on_command = on_command,
+        .on_disconnected = on_disconnected
+    };
+    
+    sim_zb_radio_set_link(link);
+    TEST_ASSERT_ESP_OK(esp_zigbee_init(&config));
+    TEST_ASSERT_ESP_OK(esp_zigbee_start());
+    wait_connected();
+}
+
+/**
+ * @brief Запуск: команда координатора и подтвержденный отчет
+ */
+static void boot_command_and_report(void *arg)
+{
+    sim_zb_radio_link_t link = { .lqi = TEST_LQI, .rssi = TEST_RSSI };
+    sim_zb_radio_frame_t frame;
+    
+    start_connected(&link);
+    
+    // Команда доставляется в on_command из задачи обработки
+    uint8_t gap = 42;
+    sim_zb_radio_send_command(TEST_CMD, &gap, 1);
+    for (uint32_t waited = 0; seen.commands == 0; waited += 10) {
+        TEST_ASSERT(waited < FRAME_TIMEOUT_MS);
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    TEST_ASSERT_EQUAL(TEST_CMD, seen.cmd);
+    TEST_ASSERT_EQUAL(1, seen.len);
+    TEST_ASSERT_EQUAL(gap, seen.data[0]);
+    
+    esp_zigbee_diag_counters_t counters;
+    TEST_ASSERT_ESP_OK(esp_zigbee_get_diagnostics(&counters));
+    TEST_ASSERT_EQUAL(1, counters.mac_rx);
+    TEST_ASSERT_EQUAL(TEST_LQI, counters.last_lqi);
+    TEST_ASSERT_EQUAL(TEST_RSSI, counters.last_rssi);
+    
+    // Отчет передается радиотракту и подтверждается
+    TEST_ASSERT_ESP_OK(esp_zigbee_report_window_state(ESP_ZIGBEE_WINDOW_MODE_OPEN, 70));
+    TEST_ASSERT(sim_zb_radio_wait_frame(&frame, FRAME_TIMEOUT_MS));
+    TEST_ASSERT_EQUAL(ZB_RADIO_FRAME_REPORT, frame.type);
+    TEST_ASSERT_EQUAL(ESP_ZIGBEE_WINDOW_MODE_OPEN, frame.param1);
+    TEST_ASSERT_EQUAL(70, frame.param2);
+    
+    esp_zigbee_reliable_stats_t stats;
+    for (uint32_t waited = 0;; waited += 10) {
+        TEST_ASSERT_ESP_OK(esp_zigbee_get_reliable_stats(&stats));
+        if (stats.delivered == 1) {
+            break;
+        }
+        TEST_ASSERT(waited < FRAME_TIMEOUT_MS);
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    TEST_ASSERT_EQUAL(1, stats.submitted);
+    TEST_ASSERT_EQUAL(1, stats.frames_sent);
+}
+
+/**
+ * @brief Запуск: повтор неподтвержденного уведомления и замещение отчета, ждущего статуса
+ */
+static void boot_retry_and_supersede(void *arg)
+{
+    sim_zb_radio_link_t link = { .loss_percent = 100, .lqi = TEST_LQI, .rssi = TEST_RSSI };
+    sim_zb_radio_frame_t frame;
+    esp_zigbee_reliable_stats_t stats;
+    
+    start_connected(&link);
+    
+    // Потерянное уведомление повторяется слотом надежной доставки
+    TEST_ASSERT_ESP_OK(esp_zigbee_send_alert(ESP_ZIGBEE_ALERT_STUCK, 1));
+    TEST_ASSERT(sim_zb_radio_wait_frame(&frame, FRAME_TIMEOUT_MS));
+    TEST_ASSERT_EQUAL(ZB_RADIO_FRAME_ALERT, frame.type);
+    TEST_ASSERT(!frame.acked);
+    
+    link.loss_percent = 0;
+    sim_zb_radio_set_link(&link);
+    TEST_ASSERT(sim_zb_radio_wait_frame(&frame, FRAME_TIMEOUT_MS));
+    TEST_ASSERT_EQUAL(ZB_RADIO_FRAME_ALERT, frame.type);
+    TEST_ASSERT(frame.acked);
+    
+    // Статус первого отчета приходит после второго отчета: второй
+    // передается следом, первый не повторяется
+    link.ack_delay_ms = ACK_DELAY_MS;
+    sim_zb_radio_set_link(&link);
+    TEST_ASSERT_ESP_OK(esp_zigbee_report_window_state(ESP_ZIGBEE_WINDOW_MODE_OPEN, 10));
+    TEST_ASSERT(sim_zb_radio_wait_frame(&frame, FRAME_TIMEOUT_MS));
+    TEST_ASSERT_EQUAL(10, frame.param2);
+    TEST_ASSERT_ESP_OK(esp_zigbee_report_window_state(ESP_ZIGBEE_WINDOW_MODE_OPEN, 20));
+    
+    TEST_ASSERT(sim_zb_radio_wait_frame(&frame, FRAME_TIMEOUT_MS));
+    TEST_ASSERT_EQUAL(20, frame.param2);
+    TEST_ASSERT(!sim_zb_radio_wait_frame(&frame, ACK_DELAY_MS * 3));
+    
+    TEST_ASSERT_ESP_OK(esp_zigbee_get_reliable_stats(&stats));
+    TEST_ASSERT_EQUAL(3, stats.submitted);
+    TEST_ASSERT_EQUAL(1, stats.superseded);
+    TEST_ASSERT_EQUAL(2, stats.delivered);
+    TEST_ASSERT_EQUAL(4, stats.frames_sent);
+}
+
+/**
+ * @brief Запуск: потеря родителя, неудачные попытки входа и досылка отчета
+ */
+static void boot_rejoin(void *arg)
+{
+    sim_zb_radio_link_t link = { .lqi = TEST_LQI, .rssi = TEST_RSSI };
+    sim_zb_radio_frame_t frame;
+    
+    start_connected(&link);
+    uint32_t joins = sim_zb_radio_join_attempts();
+    
+    // Вход в сеть без родителя не удается
+    sim_zb_radio_set_parent(false);
+    TEST_ASSERT_EQUAL(1, seen.disconnects);
+    TEST_ASSERT_EQUAL(ESP_ZIGBEE_STATE_CONNECTING, esp_zigbee_get_state());
+    for (uint32_t waited = 0; sim_zb_radio_join_attempts() == joins; waited += 10) {
+        TEST_ASSERT(waited < CONNECT_TIMEOUT_MS);
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    TEST_ASSERT_EQUAL(ESP_ZIGBEE_STATE_CONNECTING, esp_zigbee_get_state());
+    
+    // Отчет без сети ждет в слоте и отправляется после переподключения
+    TEST_ASSERT_ESP_OK(esp_zigbee_report_window_state(ESP_ZIGBEE_WINDOW_MODE_VENTILATE, 30));
+    TEST_ASSERT(!sim_zb_radio_wait_frame(&frame, 100));
+    
+    sim_zb_radio_set_parent(true);
+    wait_connected();
+    TEST_ASSERT(sim_zb_radio_wait_frame(&frame, FRAME_TIMEOUT_MS));
+    TEST_ASSERT_EQUAL(ZB_RADIO_FRAME_REPORT, frame.type);
+    TEST_ASSERT_EQUAL(30, frame.param2);
+    
+    esp_zigbee_diag_counters_t counters;
+    TEST_ASSERT_ESP_OK(esp_zigbee_get_diagnostics(&counters));
+    TEST_ASSERT_EQUAL(1, counters.parent_changes);
+}
+
+/**
+ * @brief Команда доходит до приложения, отчет подтверждается
+ */
+static void test_command_and_report(void)
+{
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_command_and_report, NULL));
+}
+
+/**
+ * @brief Неподтвержденные значения повторяются, замещенные - нет
+ */
+static void test_retry_and_supersede(void)
+{
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_retry_and_supersede, NULL));
+}
+
+/**
+ * @brief Переподключение зависит только от доступности родителя
+ */
+static void test_rejoin(void)
+{
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_rejoin, NULL));
+}
+
+int main(void)
+{
+    TEST_RUN(test_command_and_report);
+    TEST_RUN(test_retry_and_supersede);
+    TEST_RUN(test_rejoin);
+    return 0;
+}
@@ -0,0 +1,251 @@
+/**
+ * @file test_network_record.c
+ * @brief Запись параметров сети ZigBee в NVS: контрольная сумма и переход с версии 1
+ * 
+ * Параметры сети сохраняются при подключении и читаются при следующем
+ * холодном запуске. Поврежденная запись отбрасывается, запись версии 1
+ * (без контрольной суммы) принимается и перезаписывается в новом формате.
+ * Счетчик кадров сети сохраняется и без отчетов устройства, поэтому после
+ * перезапуска он продолжается с неиспользованного значения.
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+#include "host_test.h"
+#include "fake_host.h"
+#include "sim_device.h"
+#include "sim_zigbee_lib.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "nvs.h"
+#include "zigbee_handler.h"
+
+#define DEVICE_FILES            "test_network_record"
+#define DEVICE_NVS_FILE         DEVICE_FILES "_nvs.bin"
+#define NETWORK_NAMESPACE       "zigbee_net"
+#define NETWORK_KEY             "network"
+#define NETWORK_MAX_RECORD      64
+#define CONNECT_TIMEOUT_MS      2000
+#define JOIN_DELAY_NEVER_MS     60000
+#define RELAY_BURSTS            3       // Серии пересланных кадров маршрутизатором
+#define RELAY_BURST_FRAMES      500     // Кадров в серии (меньше шага сохранения)
+#define RELAY_BURST_GAP_MS      1500    // Пауза между сериями (больше периода проверки)
+
+// Запись версии 1, как ее сохраняли прежние прошивки
+typedef struct {
+    uint8_t version;
+    esp_zigbee_network_info_t info;
+} network_record_v1_t;
+
+/**
+ * @brief Первый запуск: подключение к сети сохраняет ее параметры
+ */
+static void boot_join(void *arg)
+{
+    sim_device_boot(DEVICE_FILES, ESP_RST_POWERON, ESP_SLEEP_WAKEUP_UNDEFINED);
+    
+    for (uint32_t waited = 0; !sim_zigbee_is_connected(); waited += 10) {
+        TEST_ASSERT(waited < CONNECT_TIMEOUT_MS);
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    vTaskDelay(pdMS_TO_TICKS(50));
+    TEST_ASSERT(zigbee_has_saved_network());
+}
+
+/**
+ * @brief Холодный запуск без подключения: параметры сети только из NVS
+ */
+static void boot_expect_saved(void *arg)
+{
+    bool expected = *(const bool *)arg;
+    
+    sim_zigbee_set_join_delay_ms(JOIN_DELAY_NEVER_MS);
+    sim_device_boot(DEVICE_FILES, ESP_RST_POWERON, ESP_SLEEP_WAKEUP_UNDEFINED);
+    TEST_ASSERT_EQUAL(expected, zigbee_has_saved_network());
+    
+    if (expected) {
+        esp_zigbee_network_info_t info;
+        TEST_ASSERT(zigbee_get_saved_network(&info));
+        TEST_ASSERT_EQUAL(0x1A62, info.pan_id);
+        TEST_ASSERT_EQUAL(15, info.channel);
+        TEST_ASSERT_EQUAL(0x4C21, info.short_address);
+    }
+}
+
+/**
+ * @brief Порча одного байта параметров сети в сохраненной записи
+ */
+static void boot_corrupt(void *arg)
+{
+    TEST_ASSERT_ESP_OK(fake_nvs_attach(DEVICE_NVS_FILE));
+    
+    nvs_handle_t handle;
+    TEST_ASSERT_ESP_OK(nvs_open(NETWORK_NAMESPACE, NVS_READWRITE, &handle));
+    
+    uint8_t record[NETWORK_MAX_RECORD];
+    size_t size = sizeof(record);
+    TEST_ASSERT_ESP_OK(nvs_get_blob(handle, NETWORK_KEY, record, &size));
+    TEST_ASSERT(size > sizeof(network_record_v1_t));
+    
+    record[offsetof(network_record_v1_t, info) + offsetof(esp_zigbee_network_info_t, channel)] ^= 0x01;
+    TEST_ASSERT_ESP_OK(nvs_set_blob(handle, NETWORK_KEY, record, size));
+    TEST_ASSERT_ESP_OK(nvs_commit(handle));
+    nvs_close(handle);
+}
+
+/**
+ * @brief Запись версии 1, оставленная прежней прошивкой
+ */
+static void boot_write_v1(void *arg)
+{
+    TEST_ASSERT_ESP_OK(fake_nvs_attach(DEVICE_NVS_FILE));
+    
+    network_record_v1_t record = {
+        .version = 1,
+        .info = {
+            .pan_id = 0x1A62,
+            .channel = 15,
+            .short_address = 0x4C21
+        }
+    };
+    
+    nvs_handle_t handle;
+    TEST_ASSERT_ESP_OK(nvs_open(NETWORK_NAMESPACE, NVS_READWRITE, &handle));
+    TEST_ASSERT_ESP_OK(nvs_set_blob(handle, NETWORK_KEY, &record, sizeof(record)));
+    TEST_ASSERT_ESP_OK(nvs_commit(handle));
+    nvs_close(handle);
+}
+
+/**
+ * @brief Запись в NVS переведена в текущий формат с контрольной суммой
+ */
+static void boot_expect_sealed(void *arg)
+{
+    TEST_ASSERT_ESP_OK(fake_nvs_attach(DEVICE_NVS_FILE));
+    
+    nvs_handle_t handle;
+    TEST_ASSERT_ESP_OK(nvs_open(NETWORK_NAMESPACE, NVS_READONLY, &handle));
+    
+    uint8_t record[NETWORK_MAX_RECORD];
+    size_t size = sizeof(record);
+    TEST_ASSERT_ESP_OK(nvs_get_blob(handle, NETWORK_KEY, record, &size));
+    nvs_close(handle);
+    
+    TEST_ASSERT(size > sizeof(network_record_v1_t));
+    TEST_ASSERT(record[0] > 1);
+}
+
+/**
+ * @brief Ожидание подключения к сети
+ */
+static void wait_connected(void)
+{
+    for (uint32_t waited = 0; !sim_zigbee_is_connected(); waited += 10) {
+        TEST_ASSERT(waited < CONNECT_TIMEOUT_MS);
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+}
+
+/**
+ * @brief Маршрутизатор пересылает кадры без собственных отчетов
+ */
+static void boot_relay(void *arg)
+{
+    esp_zigbee_network_info_t info;
+    
+    sim_device_set_mains_powered(true);
+    sim_device_boot(DEVICE_FILES, ESP_RST_POWERON, ESP_SLEEP_WAKEUP_UNDEFINED);
+    wait_connected();
+    
+    for (int i = 0; i < RELAY_BURSTS; i++) {
+        sim_zigbee_send_frames(RELAY_BURST_FRAMES);
+        vTaskDelay(pdMS_TO_TICKS(RELAY_BURST_GAP_MS));
+    }
+    
+    // Последнее использованное значение передается следующему запуску через NVS
+    TEST_ASSERT_ESP_OK(esp_zigbee_get_network_info(&info));    
+    nvs_handle_t handle;
+    TEST_ASSERT_ESP_OK(nvs_open("test", NVS_READWRITE, &handle));
+    TEST_ASSERT_ESP_OK(nvs_set_u32(handle, "last_used", info.nwk_frame_counter));
+    TEST_ASSERT_ESP_OK(nvs_commit(handle));
+    nvs_close(handle);
+}
+
+/**
+ * @brief После перезапуска счетчик кадров больше любого использованного значения
+ */
+static void boot_expect_fresh_counter(void *arg)
+{
+    esp_zigbee_network_info_t info;
+    uint32_t last_used;
+    
+    sim_device_set_mains_powered(true);
+    sim_device_boot(DEVICE_FILES, ESP_RST_POWERON, ESP_SLEEP_WAKEUP_UNDEFINED);
+    wait_connected();
+    
+    nvs_handle_t handle;
+    TEST_ASSERT_ESP_OK(nvs_open("test", NVS_READONLY, &handle));
+    TEST_ASSERT_ESP_OK(nvs_get_u32(handle, "last_used", &last_used));
+    nvs_close(handle);
+    
+    TEST_ASSERT_ESP_OK(esp_zigbee_get_network_info(&info));
+    TEST_ASSERT(last_used >= RELAY_BURSTS * RELAY_BURST_FRAMES);
+    TEST_ASSERT(info.nwk_frame_counter > last_used);
+}
+
+/**
+ * @brief Параметры сети переживают перезапуск
+ */
+static void test_record_survives_reboot(void)
+{
+    bool saved = true;
+    
+    sim_device_erase(DEVICE_FILES);
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_join, NULL));
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_expect_saved, &saved));
+}
+
+/**
+ * @brief Поврежденная запись отбрасывается
+ */
+static void test_corrupt_record_rejected(void)
+{
+    bool saved = false;
+    
+    sim_device_erase(DEVICE_FILES);
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_join, NULL));
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_corrupt, NULL));
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_expect_saved, &saved));
+}
+
+/**
+ * @brief Запись версии 1 принимается и перезаписывается с контрольной суммой
+ */
+static void test_v1_record_upgraded(void)
+{
+    bool saved = true;
+    
+    sim_device_erase(DEVICE_FILES);
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_write_v1, NULL));
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_expect_saved, &saved));
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_expect_sealed, NULL));
+}
+
+/**
+ * @brief Счетчик кадров, продвинутый пересылкой, не повторяется после перезапуска
+ */
+static void test_relayed_frames_counted(void)
+{
+    sim_device_erase(DEVICE_FILES);
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_relay, NULL));
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_expect_fresh_counter, NULL));
+}
+
+int main(void)
+{
+    TEST_RUN(test_record_survives_reboot);
+    TEST_RUN(test_corrupt_record_rejected);
+    TEST_RUN(test_v1_record_upgraded);
+    TEST_RUN(test_relayed_frames_counted);
+    return 0;
+}
@@ -0,0 +1,304 @@
+/**
+ * @file test_ota_update.c
+ * @brief Загрузка обновления по кластеру OTA Upgrade: полная, продолжение и смена файла
+ * 
+ * Сервер OTA имитируется в самом тесте: esp_zigbee_send_ota_command()
+ * отвечает на запросы клиента сразу, передавая ответ в
+ * ota_handle_zigbee_command(). Раздел обновления и NVS хранятся в файлах,
+ * поэтому прерванная загрузка продолжается в следующем запуске.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "host_test.h"
+#include "fake_host.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_ota_ops.h"
+#include "nvs.h"
+#include "esp_zigbee_lib.h"
+#include "ota_update.h"
+
+#define NVS_FILE                "test_ota_update_nvs.bin"
+#define PARTITION_FILE          "test_ota_update_ota.bin"
+#define PARTITION_SIZE          (64 * 1024)
+#define PARTITION_SECTOR_SIZE   4096
+
+// Команды и формат файла кластера OTA Upgrade
+#define OTA_CMD_QUERY_NEXT_IMAGE_REQ    0x01
+#define OTA_CMD_QUERY_NEXT_IMAGE_RSP    0x02
+#define OTA_CMD_IMAGE_BLOCK_REQ         0x03
+#define OTA_CMD_IMAGE_BLOCK_RSP         0x05
+#define OTA_CMD_UPGRADE_END_REQ         0x06
+#define OTA_FILE_MAGIC                  0x0BEEF11E
+#define OTA_FILE_HEADER_LENGTH          56
+#define OTA_SUBELEMENT_HEADER_SIZE      6
+#define OTA_TAG_UPGRADE_IMAGE           0x0000
+#define OTA_TAG_SIGNATURE               0x0001
+#define OTA_SIGNATURE_SIZE              16
+
+// Загружаемый файл
+#define IMAGE_TYPE              0x0001
+#define CURRENT_FILE_VERSION    0x01000000
+#define NEW_FILE_VERSION        0x02000000
+#define NEW_VERSION             "2.0.0"
+#define IMAGE_SIZE              10000   // Два полных сектора и неполный третий
+#define IMAGE_OFFSET            (OTA_FILE_HEADER_LENGTH + OTA_SUBELEMENT_HEADER_SIZE)
+#define FILE_SIZE               (IMAGE_OFFSET + IMAGE_SIZE + OTA_SUBELEMENT_HEADER_SIZE + OTA_SIGNATURE_SIZE)
+
+#define BLOCK_SIZE              OTA_MAX_BLOCK_SIZE
+#define STALL_OFFSET            7000    // Сервер перестает отвечать внутри второго сектора
+#define DOWNLOAD_TIMEOUT_MS     5000
+#define END_STATUS_NONE         -1
+
+// Параметры запуска
+typedef struct {
+    uint32_t file_version;      // Версия файла, которую предлагает сервер
+    uint32_t stall_offset;      // Смещение, с которого сервер не отвечает (0 - отвечает всегда)
+    int64_t first_block_offset; // Ожидаемое смещение первого запроса блока
+} boot_args_t;
+
+// Имитация сервера OTA
+static struct {
+    uint8_t file[FILE_SIZE];
+    uint32_t file_version;
+    uint32_t stall_offset;
+    volatile bool stalled;
+    int64_t first_block_offset;
+    volatile int end_status;
+} server = {
+    .first_block_offset = -1,
+    .end_status = END_STATUS_NONE
+};
+
+/**
+ * @brief Запись 16-битного значения (little-endian)
+ */
+static uint8_t *put_le16(uint8_t *data, uint16_t value)
+{
+    data[0] = value & 0xFF;
+    data[1] = value >> 8;
+    return data + 2;
+}
+
+/**
+ * @brief Запись 32-битного значения (little-endian)
+ */
+static uint8_t *put_le32(uint8_t *data, uint32_t value)
+{
+    data = put_le16(data, value & 0xFFFF);
+    return put_le16(data, value >> 16);
+}
+
+/**
+ * @brief Чтение 32-битного значения (little-endian)
+ */
+static uint32_t get_le32(const uint8_t *data)
+{
+    return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+/**
+ * @brief Файл OTA: заголовок, образ приложения и подпись
+ */
+static void server_build_file(void)
+{
+    uint8_t *p = server.file;
+    memset(server.file, 0, sizeof(server.file));
+    
+    p = put_le32(p, OTA_FILE_MAGIC);
+    p = put_le16(p, 0x0100);
+    put_le16(p, OTA_FILE_HEADER_LENGTH);
+    
+    p = &server.file[OTA_FILE_HEADER_LENGTH];
+    p = put_le16(p, OTA_TAG_UPGRADE_IMAGE);
+    p = put_le32(p, IMAGE_SIZE);
+    
+    // Образ приложения с описанием новой версии
+    uint8_t *image = p;
+    for (uint32_t i = 0; i < IMAGE_SIZE; i++) {
+        image[i] = (uint8_t)(i * 7 + (i >> 8));
+    }
+    image[0] = FAKE_OTA_IMAGE_MAGIC;
+    esp_app_desc_t app_desc = {
+        .magic_word = ESP_APP_DESC_MAGIC_WORD,
+        .version = NEW_VERSION
+    };
+    memcpy(&image[FAKE_OTA_APP_DESC_OFFSET], &app_desc, sizeof(app_desc));
+    
+    p = image + IMAGE_SIZE;
+    p = put_le16(p, OTA_TAG_SIGNATURE);
+    p = put_le32(p, OTA_SIGNATURE_SIZE);
+    memset(p, 0x5A, OTA_SIGNATURE_SIZE);
+}
+
+/**
+ * @brief Идентификатор файла сервера (код производителя, тип, версия)
+ */
+static uint8_t *server_put_image_id(uint8_t *data)
+{
+    data = put_le16(data, ESP_ZIGBEE_MANUFACTURER_CODE);
+    data = put_le16(data, IMAGE_TYPE);
+    return put_le32(data, server.file_version);
+}
+
+/**
+ * @brief Команда клиента OTA серверу (ответ передается клиенту сразу)
+ */
+esp_err_t esp_zigbee_send_ota_command(uint8_t cmd_id, const uint8_t *payload, uint16_t len)
+{
+    uint8_t rsp[14 + BLOCK_SIZE];
+    uint8_t *p = rsp;
+    
+    switch (cmd_id) {
+        case OTA_CMD_QUERY_NEXT_IMAGE_REQ:
+            *p++ = 0x00;
+            p = server_put_image_id(p);
+            p = put_le32(p, FILE_SIZE);
+            ota_handle_zigbee_command(OTA_CMD_QUERY_NEXT_IMAGE_RSP, rsp, p - rsp);
+            break;
+        
+        case OTA_CMD_IMAGE_BLOCK_REQ: {
+            TEST_ASSERT(len >= 14);
+            uint32_t offset = get_le32(&payload[9]);
+            uint8_t size = payload[13];
+            
+            if (server.first_block_offset < 0) {
+                server.first_block_offset = offset;
+            }
+            if (server.stall_offset != 0 && offset >= server.stall_offset) {
+                server.stalled = true;
+                break;
+            }
+            
+            size = size < BLOCK_SIZE ? size : BLOCK_SIZE;
+            size = FILE_SIZE - offset < size ? FILE_SIZE - offset : size;
+            *p++ = 0x00;
+            p = server_put_image_id(p);
+            p = put_le32(p, offset);
+            *p++ = size;
+            memcpy(p, &server.file[offset], size);
+            ota_handle_zigbee_command(OTA_CMD_IMAGE_BLOCK_RSP, rsp, (p - rsp) + size);
+            break;
+        }
+        
+        case OTA_CMD_UPGRADE_END_REQ:
+            TEST_ASSERT(len >= 1);
+            server.end_status = payload[0];
+            break;
+        
+        default:
+            break;
+    }
+    
+    return ESP_OK;
+}
+
+/**
+ * @brief Запуск: загрузка обновления до конца или до остановки сервера
+ */
+static void boot_download(void *arg)
+{
+    const boot_args_t *args = arg;
+    
+    server_build_file();
+    server.file_version = args->file_version;
+    server.stall_offset = args->stall_offset;
+    
+    TEST_ASSERT_ESP_OK(fake_nvs_attach(NVS_FILE));
+    TEST_ASSERT_ESP_OK(fake_flash_attach(FAKE_OTA_PARTITION_LABEL, PARTITION_FILE,
+                                         PARTITION_SIZE, PARTITION_SECTOR_SIZE));
+    
+    ota_config_t config = {
+        .file_version = CURRENT_FILE_VERSION,
+        .image_type = IMAGE_TYPE,
+        .block_size = BLOCK_SIZE
+    };
+    TEST_ASSERT_ESP_OK(ota_init(&config));
+    TEST_ASSERT_ESP_OK(ota_start());
+    TEST_ASSERT_ESP_OK(ota_download_update());
+    
+    for (uint32_t waited = 0; ota_get_state() != OTA_STATE_READY_TO_APPLY && !server.stalled; waited += 10) {
+        TEST_ASSERT(waited < DOWNLOAD_TIMEOUT_MS);
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    
+    // Сервер пропал: запуск завершается отключением питания посреди загрузки
+    if (server.stalled) {
+        return;
+    }
+    
+    TEST_ASSERT_EQUAL(0, server.end_status);
+    TEST_ASSERT_EQUAL(100, ota_get_download_progress());
+    
+    const esp_partition_t *partition = esp_ota_get_next_update_partition(NULL);
+    TEST_ASSERT(partition != NULL);
+    TEST_ASSERT(fake_ota_boot_partition() == partition);
+    
+    // В раздел записан только образ приложения, без заголовка и подписи
+    static uint8_t written[IMAGE_SIZE];
+    TEST_ASSERT_ESP_OK(esp_partition_read(partition, 0, written, sizeof(written)));
+    TEST_ASSERT(memcmp(written, &server.file[IMAGE_OFFSET], IMAGE_SIZE) == 0);
+    
+    esp_app_desc_t app_desc;
+    TEST_ASSERT_ESP_OK(esp_ota_get_partition_description(partition, &app_desc));
+    TEST_ASSERT(strcmp(app_desc.version, NEW_VERSION) == 0);
+    
+    // Прогресс загрузки удален
+    nvs_handle_t handle;
+    uint8_t progress[64];
+    size_t size = sizeof(progress);
+    TEST_ASSERT_ESP_OK(nvs_open("ota", NVS_READONLY, &handle));
+    TEST_ASSERT_EQUAL(ESP_ERR_NVS_NOT_FOUND, nvs_get_blob(handle, "progress", progress, &size));
+    nvs_close(handle);
+    
+    TEST_ASSERT_EQUAL(args->first_block_offset, server.first_block_offset);
+}
+
+/**
+ * @brief Полная загрузка без перерывов
+ */
+static void test_full_download(void)
+{
+    boot_args_t full = { NEW_FILE_VERSION, 0, 0 };
+    
+    remove(NVS_FILE);
+    remove(PARTITION_FILE);
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_download, &full));
+}
+
+/**
+ * @brief После отключения питания загрузка продолжается с последнего записанного сектора
+ */
+static void test_resume_after_power_loss(void)
+{
+    boot_args_t stall = { NEW_FILE_VERSION, STALL_OFFSET, 0 };
+    boot_args_t resume = { NEW_FILE_VERSION, 0, IMAGE_OFFSET + PARTITION_SECTOR_SIZE };
+    
+    remove(NVS_FILE);
+    remove(PARTITION_FILE);
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_download, &stall));
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_download, &resume));
+}
+
+/**
+ * @brief Прогресс другого файла не используется: загрузка начинается заново
+ */
+static void test_new_file_restarts(void)
+{
+    boot_args_t stall = { NEW_FILE_VERSION, STALL_OFFSET, 0 };
+    boot_args_t other = { NEW_FILE_VERSION + 1, 0, 0 };
+    
+    remove(NVS_FILE);
+    remove(PARTITION_FILE);
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_download, &stall));
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_download, &other));
+}
+
+int main(void)
+{
+    TEST_RUN(test_full_download);
+    TEST_RUN(test_resume_after_power_loss);
+    TEST_RUN(test_new_file_restarts);
+    return 0;
+}
@@ -0,0 +1,155 @@
+/**
+ * @file test_rejoin_backoff.c
+ * @brief Переподключение многих устройств после пропадания координатора
+ * 
+ * Устройства одновременно теряют сеть, и ни одна попытка переподключения
+ * не удается. Время попыток каждого устройства считается по расписанию
+ * rejoin_backoff. Проверяется разброс первой попытки, границы задержек,
+ * разнесение попыток разных устройств во времени и число попыток в час.
+ */
+
+#include <stdio.h>
+#include "host_test.h"
+#include "rejoin_backoff.h"
+
+#define DEVICES                 50
+#define ATTEMPTS                40      // Попыток на устройство: больше двух бюджетов
+#define WINDOW_MS               1000    // Окно подсчета одновременных попыток
+#define PEAK_LIMIT              (DEVICES / 2)   // В среднем DEVICES / 5 за секунду разброса
+#define REJOIN_SCAN_FIRST       2       // Индекс первой попытки сканирования (после двух быстрых)
+#define HOUR_MS                 3600000ULL
+
+static uint64_t attempt_ms[DEVICES][ATTEMPTS];
+
+/**
+ * @brief Наибольшая задержка перед попыткой с заданным номером (без случайной части)
+ */
+static uint32_t backoff_limit_ms(uint32_t attempt)
+{
+    uint64_t delay = (uint64_t)REJOIN_BASE_DELAY_MS << (attempt < 20 ? attempt : 20);
+    return delay > REJOIN_MAX_DELAY_MS ? REJOIN_MAX_DELAY_MS : (uint32_t)delay;
+}
+
+/**
+ * @brief Наибольшее число попыток всех устройств в одном окне WINDOW_MS
+ */
+static uint32_t peak_attempts(uint32_t attempt_first, uint32_t attempt_last)
+{
+    uint32_t peak = 0;
+    
+    for (int d = 0; d < DEVICES; d++) {
+        for (uint32_t a = attempt_first; a <= attempt_last; a++) {
+            uint64_t start = attempt_ms[d][a];
+            uint32_t count = 0;
+            
+            for (int o = 0; o < DEVICES; o++) {
+                for (uint32_t b = attempt_first; b <= attempt_last; b++) {
+                    if (attempt_ms[o][b] >= start && attempt_ms[o][b] < start + WINDOW_MS) {
+                        count++;
+                    }
+                }
+            }
+            peak = count > peak ? count : peak;
+        }
+    }
+    
+    return peak;
+}
+
+/**
+ * @brief Расписание попыток всех устройств с момента потери сети
+ */
+static void test_schedule_bounds(void)
+{
+    for (int d = 0; d < DEVICES; d++) {
+        rejoin_backoff_t backoff;
+        uint64_t now = rejoin_backoff_start(&backoff);
+        TEST_ASSERT(now < REJOIN_START_SPREAD_MS);
+        TEST_ASSERT_EQUAL(REJOIN_ATTEMPT_BUDGET, backoff.budget);
+        
+        for (uint32_t a = 0; a < ATTEMPTS; a++) {
+            attempt_ms[d][a] = now;
+            uint32_t delay = rejoin_backoff_next(&backoff);
+            TEST_ASSERT_EQUAL(a + 1, backoff.attempt);
+            
+            // После каждого бюджета попыток - пауза, иначе задержка в [limit/2, limit]
+            if ((a + 1) % REJOIN_ATTEMPT_BUDGET == 0) {
+                TEST_ASSERT_EQUAL(REJOIN_REST_MS, delay);
+            } else {
+                uint32_t limit = backoff_limit_ms(a + 1);
+                TEST_ASSERT(delay >= limit / 2);
+                TEST_ASSERT(delay <= limit);
+            }
+            now += delay;
+        }
+    }
+}
+
+/**
+ * @brief Попытки разных устройств разнесены во времени
+ */
+static void test_jitter_spread(void)
+{
+    // Первые попытки занимают весь интервал разброса
+    uint64_t first_min = UINT64_MAX;
+    uint64_t first_max = 0;
+    for (int d = 0; d < DEVICES; d++) {
+        first_min = attempt_ms[d][0] < first_min ? attempt_ms[d][0] : first_min;
+        first_max = attempt_ms[d][0] > first_max ? attempt_ms[d][0] : first_max;
+    }
+    TEST_ASSERT(first_max - first_min > REJOIN_START_SPREAD_MS / 2);
+    
+    // Случайная половина задержки накапливается: k-е попытки расходятся все дальше
+    for (uint32_t a = 1; a < REJOIN_ATTEMPT_BUDGET; a++) {
+        uint64_t min = UINT64_MAX;
+        uint64_t max = 0;
+        for (int d = 0; d < DEVICES; d++) {
+            min = attempt_ms[d][a] < min ? attempt_ms[d][a] : min;
+            max = attempt_ms[d][a] > max ? attempt_ms[d][a] : max;
+        }
+        TEST_ASSERT(max - min >= backoff_limit_ms(a) / 4);
+    }
+    
+    // Без разброса все устройства обращались бы к координатору в одном окне:
+    // первая попытка после потери сети и каждая попытка сканирования
+    uint32_t first_peak = peak_attempts(0, 0);
+    uint32_t scan_peak = 0;
+    for (uint32_t a = REJOIN_SCAN_FIRST; a < REJOIN_ATTEMPT_BUDGET; a++) {
+        uint32_t peak = peak_attempts(a, a);
+        scan_peak = peak > scan_peak ? peak : scan_peak;
+    }
+    printf("%d устройств, попыток за %d мс: первая попытка - до %lu, сканирование - до %lu (без разброса - %d)\n",
+           DEVICES, WINDOW_MS, (unsigned long)first_peak, (unsigned long)scan_peak, DEVICES);
+    fflush(stdout);
+    TEST_ASSERT(first_peak <= PEAK_LIMIT);
+    TEST_ASSERT(scan_peak <= PEAK_LIMIT);
+}
+
+/**
+ * @brief Число попыток в любой час не превышает бюджета
+ */
+static void test_hourly_budget(void)
+{
+    uint32_t worst = 0;
+    
+    for (int d = 0; d < DEVICES; d++) {
+        for (uint32_t a = 0; a < ATTEMPTS; a++) {
+            uint32_t count = 0;
+            for (uint32_t b = a; b < ATTEMPTS && attempt_ms[d][b] < attempt_ms[d][a] + HOUR_MS; b++) {
+                count++;
+            }
+            worst = count > worst ? count : worst;
+        }
+    }
+    
+    printf("наибольшее число попыток устройства за час - %lu\n", (unsigned long)worst);
+    TEST_ASSERT(worst <= REJOIN_ATTEMPT_BUDGET);
+}
+
+int main(void)
+{
+    TEST_RUN(test_schedule_bounds);
+    TEST_RUN(test_jitter_spread);
+    TEST_RUN(test_hourly_budget);
+    return 0;
+}
@@ -0,0 +1,179 @@
+/**
+ * @file test_report_dest.c
+ * @brief Получатели отчетов из таблицы привязок: выбор, порядок и отсутствие просмотра таблицы на отчет
+ * 
+ * Таблица привязок стека имитируется в тесте. Отправка отчета в
+ * esp_zigbee_lib.c берет снимок списка report_dest_snapshot() и отправляет
+ * кадр каждому получателю снимка.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "host_test.h"
+#include "esp_timer.h"
+#include "report_dest.h"
+
+#define WINDOW_ENDPOINT         1
+#define OTHER_ENDPOINT          2
+#define WINDOW_COVERING_CLUSTER 0x0102
+#define ON_OFF_CLUSTER          0x0006
+#define WALL_CONTROLLER_ADDR    0x4F21
+#define WALL_CONTROLLER_EP      3
+#define ROOM_GROUP              0x0042
+#define REPORTS                 100000
+
+// Таблица привязок стека
+static struct {
+    report_dest_binding_t entries[REPORT_DEST_BINDING_SCAN_MAX];
+    uint8_t count;
+    uint32_t reads;
+} table;
+
+static const uint8_t HUB_IEEE[8] = { 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88 };
+
+static uint8_t read_table(report_dest_binding_t *bindings, uint8_t max)
+{
+    uint8_t count = table.count < max ? table.count : max;
+    
+    memcpy(bindings, table.entries, count * sizeof(report_dest_binding_t));
+    table.reads++;
+    return count;
+}
+
+/**
+ * @brief Привязка кластера эндпоинта к получателю
+ */
+static void bind(uint8_t src_endpoint, uint16_t cluster_id, uint8_t addr_mode, uint16_t addr_short,
+                 const uint8_t *addr_long, uint8_t endpoint)
+{
+    report_dest_binding_t *entry = &table.entries[table.count++];
+    
+    memset(entry, 0, sizeof(*entry));
+    entry->src_endpoint = src_endpoint;
+    entry->cluster_id = cluster_id;
+    entry->dest.addr_mode = addr_mode;
+    if (addr_long != NULL) {
+        memcpy(entry->dest.addr.addr_long, addr_long, sizeof(entry->dest.addr.addr_long));
+    } else {
+        entry->dest.addr.addr_short = addr_short;
+    }
+    entry->dest.endpoint = endpoint;
+}
+
+/**
+ * @brief Без привязок отчеты получает координатор
+ */
+static void test_coordinator_by_default(void)
+{
+    report_dest_t dests[REPORT_DEST_MAX];
+    
+    table.count = 0;
+    bind(WINDOW_ENDPOINT, ON_OFF_CLUSTER, REPORT_DEST_ADDR_MODE_SHORT, WALL_CONTROLLER_ADDR, NULL, 1);
+    
+    TEST_ASSERT_EQUAL(1, report_dest_rebuild(read_table, WINDOW_ENDPOINT, WINDOW_COVERING_CLUSTER));
+    TEST_ASSERT_EQUAL(1, report_dest_snapshot(dests));
+    TEST_ASSERT_EQUAL(REPORT_DEST_ADDR_MODE_SHORT, dests[0].addr_mode);
+    TEST_ASSERT_EQUAL(REPORT_DEST_COORDINATOR_ADDR, dests[0].addr.addr_short);
+    TEST_ASSERT_EQUAL(REPORT_DEST_COORDINATOR_EP, dests[0].endpoint);
+}
+
+/**
+ * @brief Отчеты расходятся группе, контроллеру и хабу в порядке таблицы
+ */
+static void test_fan_out(void)
+{
+    report_dest_t dests[REPORT_DEST_MAX];
+    
+    table.count = 0;
+    bind(WINDOW_ENDPOINT, WINDOW_COVERING_CLUSTER, REPORT_DEST_ADDR_MODE_GROUP, ROOM_GROUP, NULL, 0);
+    bind(WINDOW_ENDPOINT, ON_OFF_CLUSTER, REPORT_DEST_ADDR_MODE_SHORT, 0x1234, NULL, 1);
+    bind(WINDOW_ENDPOINT, WINDOW_COVERING_CLUSTER, REPORT_DEST_ADDR_MODE_SHORT, WALL_CONTROLLER_ADDR, NULL,
+         WALL_CONTROLLER_EP);
+    bind(OTHER_ENDPOINT, WINDOW_COVERING_CLUSTER, REPORT_DEST_ADDR_MODE_SHORT, 0x5678, NULL, 1);
+    bind(WINDOW_ENDPOINT, WINDOW_COVERING_CLUSTER, REPORT_DEST_ADDR_MODE_IEEE, 0, HUB_IEEE, 1);
+    
+    TEST_ASSERT_EQUAL(3, report_dest_rebuild(read_table, WINDOW_ENDPOINT, WINDOW_COVERING_CLUSTER));
+    TEST_ASSERT_EQUAL(3, report_dest_snapshot(dests));
+    
+    TEST_ASSERT_EQUAL(REPORT_DEST_ADDR_MODE_GROUP, dests[0].addr_mode);
+    TEST_ASSERT_EQUAL(ROOM_GROUP, dests[0].addr.addr_short);
+    
+    TEST_ASSERT_EQUAL(REPORT_DEST_ADDR_MODE_SHORT, dests[1].addr_mode);
+    TEST_ASSERT_EQUAL(WALL_CONTROLLER_ADDR, dests[1].addr.addr_short);
+    TEST_ASSERT_EQUAL(WALL_CONTROLLER_EP, dests[1].endpoint);
+    
+    TEST_ASSERT_EQUAL(REPORT_DEST_ADDR_MODE_IEEE, dests[2].addr_mode);
+    TEST_ASSERT(memcmp(dests[2].addr.addr_long, HUB_IEEE, sizeof(HUB_IEEE)) == 0);
+    
+    // Координатор без привязки отчетов не получает
+    for (int i = 0; i < 3; i++) {
+        TEST_ASSERT(dests[i].addr_mode == REPORT_DEST_ADDR_MODE_IEEE ||
+                    dests[i].addr.addr_short != REPORT_DEST_COORDINATOR_ADDR);
+    }
+}
+
+/**
+ * @brief Получателей не больше REPORT_DEST_MAX, лишние привязки пропускаются
+ */
+static void test_limit(void)
+{
+    report_dest_t dests[REPORT_DEST_MAX];
+    
+    table.count = 0;
+    for (uint16_t i = 0; i < REPORT_DEST_MAX + 4; i++) {
+        bind(WINDOW_ENDPOINT, WINDOW_COVERING_CLUSTER, REPORT_DEST_ADDR_MODE_SHORT, 0x1000 + i, NULL, 1);
+    }
+    
+    TEST_ASSERT_EQUAL(REPORT_DEST_MAX, report_dest_rebuild(read_table, WINDOW_ENDPOINT, WINDOW_COVERING_CLUSTER));
+    TEST_ASSERT_EQUAL(REPORT_DEST_MAX, report_dest_snapshot(dests));
+    TEST_ASSERT_EQUAL(0x1000 + REPORT_DEST_MAX - 1, dests[REPORT_DEST_MAX - 1].addr.addr_short);
+}
+
+/**
+ * @brief Отчеты читают готовый список: таблица читается только при перестроении
+ */
+static void test_no_scan_per_report(void)
+{
+    report_dest_t dests[REPORT_DEST_MAX];
+    uint32_t frames = 0;
+    
+    table.count = 0;
+    bind(WINDOW_ENDPOINT, WINDOW_COVERING_CLUSTER, REPORT_DEST_ADDR_MODE_GROUP, ROOM_GROUP, NULL, 0);
+    bind(WINDOW_ENDPOINT, WINDOW_COVERING_CLUSTER, REPORT_DEST_ADDR_MODE_SHORT, WALL_CONTROLLER_ADDR, NULL,
+         WALL_CONTROLLER_EP);
+    report_dest_rebuild(read_table, WINDOW_ENDPOINT, WINDOW_COVERING_CLUSTER);
+    
+    uint32_t reads = table.reads;
+    uint32_t scans = report_dest_table_scans();
+    int64_t start_us = esp_timer_get_time();
+    for (int report = 0; report < REPORTS; report++) {
+        uint8_t count = report_dest_snapshot(dests);
+        for (uint8_t i = 0; i < count; i++) {
+            frames++;
+        }
+    }
+    int64_t elapsed_us = esp_timer_get_time() - start_us;
+    
+    printf("получатели отчетов: %d отчетов, %lu кадров, чтений таблицы %lu, %lld нс на снимок списка\n",
+           REPORTS, (unsigned long)frames, (unsigned long)(table.reads - reads),
+           (long long)(elapsed_us * 1000 / REPORTS));
+    
+    TEST_ASSERT_EQUAL(2 * REPORTS, frames);
+    TEST_ASSERT_EQUAL(reads, table.reads);
+    TEST_ASSERT_EQUAL(scans, report_dest_table_scans());
+    
+    // Изменение таблицы привязок - одно чтение
+    bind(WINDOW_ENDPOINT, WINDOW_COVERING_CLUSTER, REPORT_DEST_ADDR_MODE_IEEE, 0, HUB_IEEE, 1);
+    TEST_ASSERT_EQUAL(3, report_dest_rebuild(read_table, WINDOW_ENDPOINT, WINDOW_COVERING_CLUSTER));
+    TEST_ASSERT_EQUAL(reads + 1, table.reads);
+    TEST_ASSERT_EQUAL(scans + 1, report_dest_table_scans());
+}
+
+int main(void)
+{
+    TEST_RUN(test_coordinator_by_default);
+    TEST_RUN(test_fan_out);
+    TEST_RUN(test_limit);
+    TEST_RUN(test_no_scan_per_report);
+    return 0;
+}
@@ -0,0 +1,75 @@
+/**
+ * @file test_report_slots.c
+ * @brief Отчеты и уведомления без сети: хранение в слотах до подключения
+ * 
+ * Значения, отправленные до подключения к сети, не отбрасываются: каждое
+ * ждет в своем слоте и уходит после подключения. Новое значение того же
+ * слота замещает прежнее, уведомления разных типов не мешают друг другу.
+ */
+
+#include <stdio.h>
+#include "host_test.h"
+#include "fake_host.h"
+#include "sim_device.h"
+#include "sim_zigbee_lib.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "zigbee_handler.h"
+
+#define DEVICE_FILES            "test_report_slots"
+#define CONNECT_TIMEOUT_MS      2000
+#define JOIN_DELAY_MS           300
+#define REPORT_WAIT_MS          200
+
+/**
+ * @brief Уведомления до подключения доставляются после него
+ */
+static void boot_offline_alerts(void *arg)
+{
+    sim_zigbee_set_join_delay_ms(JOIN_DELAY_MS);
+    sim_device_boot(DEVICE_FILES, ESP_RST_POWERON, ESP_SLEEP_WAKEUP_UNDEFINED);
+    TEST_ASSERT(!sim_zigbee_is_connected());
+    
+    TEST_ASSERT_ESP_OK(zigbee_send_alert(ZIGBEE_ALERT_LOW_BATTERY, 40));
+    TEST_ASSERT_ESP_OK(zigbee_send_alert(ZIGBEE_ALERT_RESISTANCE, 1));
+    TEST_ASSERT_ESP_OK(zigbee_send_alert(ZIGBEE_ALERT_LOW_BATTERY, 35));
+    
+    for (uint32_t waited = 0; !sim_zigbee_is_connected(); waited += 10) {
+        TEST_ASSERT(waited < CONNECT_TIMEOUT_MS);
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    
+    int low_battery = 0;
+    int stuck = 0;
+    sim_zigbee_report_t report;
+    while (sim_zigbee_wait_report(&report, REPORT_WAIT_MS)) {
+        if (report.kind != SIM_ZIGBEE_REPORT_ALERT) {
+            continue;
+        }
+        if (report.value == ESP_ZIGBEE_ALERT_LOW_BATTERY) {
+            // Отправлено только последнее значение слота
+            TEST_ASSERT_EQUAL(35, report.extra);
+            low_battery++;
+        } else if (report.value == ESP_ZIGBEE_ALERT_STUCK) {
+            stuck++;
+        }
+    }
+    
+    TEST_ASSERT_EQUAL(1, low_battery);
+    TEST_ASSERT_EQUAL(1, stuck);
+}
+
+/**
+ * @brief Уведомления без сети не теряются и замещаются в своем слоте
+ */
+static void test_offline_alerts_delivered(void)
+{
+    sim_device_erase(DEVICE_FILES);
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_offline_alerts, NULL));
+}
+
+int main(void)
+{
+    TEST_RUN(test_offline_alerts_delivered);
+    return 0;
+}
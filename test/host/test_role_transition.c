@@ -0,0 +1,112 @@
+/**
+ * @file test_role_transition.c
+ * @brief Смена роли в сети между запусками: вход повторным подключением
+ * 
+ * Роль, в которой получены параметры сети, хранится в NVS. Если источник
+ * питания при загрузке задает другую роль, сохраненные адрес и родитель
+ * недействительны и устройство входит в сеть повторным подключением,
+ * пока не подключится в новой роли.
+ */
+
+#include <stdio.h>
+#include "host_test.h"
+#include "fake_host.h"
+#include "sim_device.h"
+#include "sim_zigbee_lib.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "zigbee_handler.h"
+
+#define DEVICE_FILES            "test_role_transition"
+#define CONNECT_TIMEOUT_MS      2000
+#define JOIN_DELAY_NEVER_MS     60000
+
+// Ожидаемая конфигурация библиотеки при загрузке
+typedef struct {
+    bool mains_powered;
+    bool join;
+    esp_zigbee_role_t role;
+    bool rejoin_network;
+} role_boot_t;
+
+/**
+ * @brief Запуск с заданным источником питания и проверка роли
+ */
+static void boot_role(void *arg)
+{
+    const role_boot_t *expect = arg;
+    bool rejoin_network;
+    
+    sim_device_set_mains_powered(expect->mains_powered);
+    if (!expect->join) {
+        sim_zigbee_set_join_delay_ms(JOIN_DELAY_NEVER_MS);
+    }
+    sim_device_boot(DEVICE_FILES, ESP_RST_POWERON, ESP_SLEEP_WAKEUP_UNDEFINED);
+    
+    TEST_ASSERT_EQUAL(expect->role, sim_zigbee_get_role(&rejoin_network));
+    TEST_ASSERT_EQUAL(expect->rejoin_network, rejoin_network);
+    
+    if (expect->join) {
+        for (uint32_t waited = 0; !sim_zigbee_is_connected(); waited += 10) {
+            TEST_ASSERT(waited < CONNECT_TIMEOUT_MS);
+            vTaskDelay(pdMS_TO_TICKS(10));
+        }
+        vTaskDelay(pdMS_TO_TICKS(50));
+        TEST_ASSERT(zigbee_has_saved_network());
+    }
+}
+
+/**
+ * @brief Без сохраненной сети повторное подключение не требуется
+ */
+static void test_fresh_device(void)
+{
+    role_boot_t boot = { .mains_powered = true, .join = false, .role = ESP_ZIGBEE_ROLE_ROUTER };
+    
+    sim_device_erase(DEVICE_FILES);
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_role, &boot));
+}
+
+/**
+ * @brief Сеть сохранена на батарее, загрузка от внешнего питания
+ */
+static void test_battery_to_mains(void)
+{
+    role_boot_t battery = { .mains_powered = false, .join = true, .role = ESP_ZIGBEE_ROLE_END_DEVICE };
+    role_boot_t mains_offline = { .mains_powered = true, .join = false,
+                                  .role = ESP_ZIGBEE_ROLE_ROUTER, .rejoin_network = true };
+    role_boot_t mains_join = mains_offline;
+    role_boot_t mains = { .mains_powered = true, .join = false, .role = ESP_ZIGBEE_ROLE_ROUTER };
+    
+    mains_join.join = true;
+    
+    sim_device_erase(DEVICE_FILES);
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_role, &battery));
+    
+    // Пока устройство не подключилось в новой роли, каждая загрузка - повторное подключение
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_role, &mains_offline));
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_role, &mains_join));
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_role, &mains));
+}
+
+/**
+ * @brief Сеть сохранена маршрутизатором, загрузка от батареи
+ */
+static void test_mains_to_battery(void)
+{
+    role_boot_t mains = { .mains_powered = true, .join = true, .role = ESP_ZIGBEE_ROLE_ROUTER };
+    role_boot_t battery = { .mains_powered = false, .join = false,
+                            .role = ESP_ZIGBEE_ROLE_END_DEVICE, .rejoin_network = true };
+    
+    sim_device_erase(DEVICE_FILES);
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_role, &mains));
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_role, &battery));
+}
+
+int main(void)
+{
+    TEST_RUN(test_fresh_device);
+    TEST_RUN(test_battery_to_mains);
+    TEST_RUN(test_mains_to_battery);
+    return 0;
+}
@@ -0,0 +1,164 @@
+/**
+ * @file test_schedule.c
+ * @brief Расписание за месяц виртуального времени: точность срабатывания и число пробуждений
+ * 
+ * Устройство на батарее спит между записями расписания. Перед сном оно
+ * берет время до ближайшей записи (schedule_get_next_due_in()), а после
+ * пробуждения по таймеру продолжает ход часов (schedule_resume_time()).
+ * Сон занимает только виртуальное время, поэтому месяц проходит за доли
+ * секунды. Ожидаемые срабатывания считаются по календарю октября 2026 года
+ * независимо от модуля.
+ */
+
+#include <stdio.h>
+#include "host_test.h"
+#include "fake_host.h"
+#include "schedule.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#define SECONDS_PER_DAY         86400
+#define MONTH_START             (9770u * SECONDS_PER_DAY)   // 2026-10-01 00:00, четверг
+#define MONTH_START_WEEKDAY     3       // Понедельник - 0
+#define MONTH_DAYS              31
+#define MONTH_END               (MONTH_START + MONTH_DAYS * SECONDS_PER_DAY)
+#define DUE_TIMEOUT_MS          1000
+#define MAX_ACTIONS             128
+
+#define SCHEDULE_WORKDAYS       (SCHEDULE_MONDAY | SCHEDULE_TUESDAY | SCHEDULE_WEDNESDAY | \
+                                 SCHEDULE_THURSDAY | SCHEDULE_FRIDAY)
+#define SCHEDULE_WEEKEND        (SCHEDULE_SATURDAY | SCHEDULE_SUNDAY)
+
+// Записи расписания: утром в будни открыть, вечером закрыть, в выходные открыть позже;
+// по средам в 07:00 вторая запись - проветривание после открытия
+static const struct {
+    uint8_t weekdays;
+    uint8_t hour;
+    uint8_t minute;
+    window_mode_t mode;
+    uint8_t gap;
+} plan[] = {
+    { SCHEDULE_WORKDAYS, 7, 0, WINDOW_MODE_OPEN, 100 },
+    { SCHEDULE_WORKDAYS, 22, 30, WINDOW_MODE_CLOSED, 0 },
+    { SCHEDULE_WEEKEND, 9, 15, WINDOW_MODE_OPEN, 60 },
+    { SCHEDULE_WEDNESDAY, 7, 0, WINDOW_MODE_VENT, 20 },
+};
+
+#define PLAN_ENTRIES            (sizeof(plan) / sizeof(plan[0]))
+
+// Выполненные действия
+static struct {
+    volatile uint32_t due_calls;
+    uint32_t count;
+    uint32_t time[MAX_ACTIONS];
+    window_mode_t mode[MAX_ACTIONS];
+    uint8_t gap[MAX_ACTIONS];
+} actions;
+
+static void on_due(void)
+{
+    actions.due_calls++;
+}
+
+static void on_action(window_mode_t mode, uint8_t gap_percentage)
+{
+    uint32_t now;
+    
+    TEST_ASSERT(actions.count < MAX_ACTIONS);
+    TEST_ASSERT(schedule_get_time(&now));
+    actions.time[actions.count] = now;
+    actions.mode[actions.count] = mode;
+    actions.gap[actions.count] = gap_percentage;
+    actions.count++;
+}
+
+/**
+ * @brief Ожидание колбэка наступления срока
+ */
+static void wait_due(uint32_t due_calls)
+{
+    for (uint32_t waited = 0; actions.due_calls < due_calls; waited++) {
+        TEST_ASSERT(waited < DUE_TIMEOUT_MS);
+        vTaskDelay(pdMS_TO_TICKS(1));
+    }
+}
+
+/**
+ * @brief Запуск: месяц сна между записями расписания
+ */
+static void boot_month(void *arg)
+{
+    TEST_ASSERT_ESP_OK(fake_nvs_attach(NULL));
+    TEST_ASSERT_ESP_OK(schedule_init(on_due));
+    for (uint8_t i = 0; i < PLAN_ENTRIES; i++) {
+        TEST_ASSERT_ESP_OK(schedule_set_entry(i, plan[i].weekdays, plan[i].hour, plan[i].minute,
+                                              plan[i].mode, plan[i].gap));
+    }
+    TEST_ASSERT_ESP_OK(schedule_set_time(MONTH_START));
+    
+    // Сон до ближайшей записи, пробуждение по таймеру, выполнение и снова сон
+    uint32_t wakeups = 0;
+    uint32_t sleep_time;
+    uint32_t due_in;
+    TEST_ASSERT(schedule_get_time(&sleep_time));
+    while (schedule_get_next_due_in(&due_in) && sleep_time + due_in < MONTH_END) {
+        TEST_ASSERT(due_in > 0);
+        
+        wakeups++;
+        TEST_ASSERT_ESP_OK(schedule_resume_time(sleep_time, sleep_time + due_in));
+        wait_due(wakeups);
+        TEST_ASSERT_ESP_OK(schedule_run_due(on_action));
+        TEST_ASSERT(schedule_get_time(&sleep_time));
+    }
+    
+    // Ожидаемые срабатывания по календарю
+    uint32_t expected_wakeups = 0;
+    uint32_t expected = 0;
+    for (uint32_t day = 0; day < MONTH_DAYS; day++) {
+        uint8_t weekday_mask = 1 << ((MONTH_START_WEEKDAY + day) % 7);
+        uint32_t last_time = 0;
+        
+        for (uint32_t minute = 0; minute < 24 * 60; minute++) {
+            for (uint8_t i = 0; i < PLAN_ENTRIES; i++) {
+                if (!(plan[i].weekdays & weekday_mask) || plan[i].hour * 60 + plan[i].minute != minute) {
+                    continue;
+                }
+                
+                uint32_t time = MONTH_START + day * SECONDS_PER_DAY + minute * 60;
+                if (time != last_time) {
+                    expected_wakeups++;
+                    last_time = time;
+                }
+                
+                TEST_ASSERT(expected < actions.count);
+                TEST_ASSERT(actions.time[expected] - time <= 1);
+                TEST_ASSERT_EQUAL(plan[i].mode, actions.mode[expected]);
+                TEST_ASSERT_EQUAL(plan[i].gap, actions.gap[expected]);
+                expected++;
+            }
+        }
+    }
+    
+    printf("расписание: %d дней, %lu действий, %lu пробуждений (ожидалось %lu)\n",
+           MONTH_DAYS, (unsigned long)actions.count, (unsigned long)wakeups, (unsigned long)expected_wakeups);
+    
+    // 22 будних дня по две записи, 9 выходных, 4 среды с двумя действиями в 07:00
+    TEST_ASSERT_EQUAL(22 * 2 + 9 + 4, expected);
+    TEST_ASSERT_EQUAL(expected, actions.count);
+    TEST_ASSERT_EQUAL(expected_wakeups, wakeups);
+    TEST_ASSERT_EQUAL(wakeups, actions.due_calls);
+}
+
+/**
+ * @brief Каждая запись срабатывает вовремя, лишних пробуждений нет
+ */
+static void test_month(void)
+{
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_month, NULL));
+}
+
+int main(void)
+{
+    TEST_RUN(test_month);
+    return 0;
+}
@@ -0,0 +1,200 @@
+/**
+ * @file test_seqlock.c
+ * @brief Чтение без блокировки: читатели не должны видеть частично записанные данные
+ * 
+ * Писатель непрерывно меняет данные, несколько читателей одновременно
+ * делают снимки и проверяют их согласованность. Проверяется сам счетчик
+ * последовательности и снимок состояния state_get_current().
+ */
+
+#include <stdio.h>
+#include <stdatomic.h>
+#include "host_test.h"
+#include "fake_host.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "seqlock.h"
+#include "state_management.h"
+
+#define STRESS_DURATION_MS      1000
+#define STRESS_READERS          3
+#define STRESS_WORDS            64
+
+// Данные под счетчиком: все слова записываются одним значением
+typedef struct {
+    uint32_t words[STRESS_WORDS];
+} stress_data_t;
+
+static seqlock_t stress_seq = SEQLOCK_INITIALIZER;
+static stress_data_t stress_data;
+
+// Управление задачами теста
+static atomic_bool stress_stop;
+static atomic_uint stress_reads;
+static atomic_uint stress_retries;
+static atomic_uint stress_torn;
+static SemaphoreHandle_t stress_done;
+
+/**
+ * @brief Писатель: все слова получают новое значение
+ */
+static void seqlock_writer_task(void *arg)
+{
+    uint32_t value = 0;
+    
+    while (!atomic_load(&stress_stop)) {
+        value++;
+        seqlock_write_begin(&stress_seq);
+        for (int i = 0; i < STRESS_WORDS; i++) {
+            stress_data.words[i] = value;
+        }
+        seqlock_write_end(&stress_seq);
+        taskYIELD();
+    }
+    
+    xSemaphoreGive(stress_done);
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Читатель: снимок должен содержать одно значение во всех словах
+ */
+static void seqlock_reader_task(void *arg)
+{
+    uint32_t attempts = 0;
+    
+    while (!atomic_load(&stress_stop)) {
+        stress_data_t snapshot;
+        uint32_t seq;
+        
+        do {
+            seq = seqlock_read_begin(&stress_seq);
+            
+            // Уступка процессора посреди каждой второй копии: писатель успевает
+            // изменить данные даже на одноядерной машине
+            bool yield = (attempts++ % 2) == 0;
+            for (int i = 0; i < STRESS_WORDS; i++) {
+                snapshot.words[i] = stress_data.words[i];
+                if (yield && i == STRESS_WORDS / 2) {
+                    taskYIELD();
+                }
+            }
+            
+            if (!seqlock_read_retry(&stress_seq, seq)) {
+                break;
+            }
+            atomic_fetch_add(&stress_retries, 1);
+        } while (true);
+        
+        for (int i = 1; i < STRESS_WORDS; i++) {
+            if (snapshot.words[i] != snapshot.words[0]) {
+                atomic_fetch_add(&stress_torn, 1);
+                break;
+            }
+        }
+        atomic_fetch_add(&stress_reads, 1);
+    }
+    
+    xSemaphoreGive(stress_done);
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Писатель положения окна через state_update_position()
+ * 
+ * Чередует два положения; режим и зазор меняются одной записью.
+ */
+static void state_writer_task(void *arg)
+{
+    bool vent = false;
+    
+    while (!atomic_load(&stress_stop)) {
+        vent = !vent;
+        state_update_position(vent ? WINDOW_MODE_VENT : WINDOW_MODE_OPEN, vent ? 90 : 10);
+    }
+    
+    xSemaphoreGive(stress_done);
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Читатель снимка состояния: режим и зазор всегда из одной записи
+ */
+static void state_reader_task(void *arg)
+{
+    while (!atomic_load(&stress_stop)) {
+        device_state_t state = state_get_current();
+        
+        bool consistent = (state.window_mode == WINDOW_MODE_OPEN && state.gap_percentage == 10) ||
+                          (state.window_mode == WINDOW_MODE_VENT && state.gap_percentage == 90) ||
+                          (state.window_mode == WINDOW_MODE_CLOSED && state.gap_percentage == 0);
+        if (!consistent) {
+            atomic_fetch_add(&stress_torn, 1);
+        }
+        atomic_fetch_add(&stress_reads, 1);
+    }
+    
+    xSemaphoreGive(stress_done);
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Запуск писателя и читателей на STRESS_DURATION_MS
+ */
+static void stress_run(TaskFunction_t writer, TaskFunction_t reader)
+{
+    atomic_store(&stress_stop, false);
+    atomic_store(&stress_reads, 0);
+    atomic_store(&stress_retries, 0);
+    atomic_store(&stress_torn, 0);
+    stress_done = xSemaphoreCreateCounting(STRESS_READERS + 1, 0);
+    TEST_ASSERT(stress_done != NULL);
+    
+    TEST_ASSERT_EQUAL(pdPASS, xTaskCreate(writer, "writer", 4096, NULL, 5, NULL));
+    for (int i = 0; i < STRESS_READERS; i++) {
+        TEST_ASSERT_EQUAL(pdPASS, xTaskCreate(reader, "reader", 4096, NULL, 5, NULL));
+    }
+    
+    vTaskDelay(pdMS_TO_TICKS(STRESS_DURATION_MS));
+    atomic_store(&stress_stop, true);
+    for (int i = 0; i < STRESS_READERS + 1; i++) {
+        TEST_ASSERT_EQUAL(pdTRUE, xSemaphoreTake(stress_done, portMAX_DELAY));
+    }
+    vSemaphoreDelete(stress_done);
+    
+    fprintf(stderr, "   чтений: %u, повторов: %u\n", atomic_load(&stress_reads), atomic_load(&stress_retries));
+    TEST_ASSERT(atomic_load(&stress_reads) > 0);
+    TEST_ASSERT_EQUAL(0, atomic_load(&stress_torn));
+}
+
+/**
+ * @brief Счетчик последовательности под нагрузкой
+ */
+static void test_seqlock_no_torn_reads(void)
+{
+    stress_run(seqlock_writer_task, seqlock_reader_task);
+    
+    // Чтения действительно пересекались с записью
+    TEST_ASSERT(atomic_load(&stress_retries) > 0);
+}
+
+/**
+ * @brief Снимок состояния устройства под нагрузкой
+ */
+static void test_state_snapshot_no_torn_reads(void)
+{
+    // Без раздела журнала и файла NVS: положение помечается для отложенной записи
+    TEST_ASSERT_ESP_OK(fake_nvs_attach(NULL));
+    TEST_ASSERT_ESP_OK(state_init());
+    TEST_ASSERT_ESP_OK(state_load());
+    
+    stress_run(state_writer_task, state_reader_task);
+}
+
+int main(void)
+{
+    TEST_RUN(test_seqlock_no_torn_reads);
+    TEST_RUN(test_state_snapshot_no_torn_reads);
+    return 0;
+}
@@ -0,0 +1,199 @@
+/**
+ * @file test_state_journal.c
+ * @brief Журнал положений: восстановление после отключения питания на каждом байте
+ * 
+ * Серия записей повторяется с отключением питания после 0, 1, 2, ... байтов
+ * записи и стирания флеш-памяти. После каждого отключения журнал
+ * открывается заново и должен вернуть последнюю подтвержденную запись
+ * (или оборванную, если она успела записаться целиком) и продолжать работу.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "host_test.h"
+#include "fake_host.h"
+#include "esp_partition.h"
+#include "state_journal.h"
+
+#define JOURNAL_FILE            "test_state_journal.bin"
+#define JOURNAL_SECTOR_SIZE     256
+#define JOURNAL_SECTORS         3
+#define JOURNAL_APPENDS         60      // Несколько полных кругов по секторам
+#define JOURNAL_EXTRA_APPENDS   20      // Записи после восстановления
+
+// Байтов записи и стирания в последней серии
+static uint64_t series_bytes;
+
+/**
+ * @brief Положение окна для записи с порядковым номером
+ */
+static void journal_value(uint32_t index, window_mode_t *mode, uint8_t *gap, uint8_t *angle)
+{
+    *mode = (window_mode_t)(index % 3);
+    *gap = (uint8_t)((index * 7) % 101);
+    *angle = (uint8_t)(index % 181);
+}
+
+/**
+ * @brief Стирание всего раздела журнала без отключения питания
+ */
+static void journal_erase_all(void)
+{
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                                                ESP_PARTITION_SUBTYPE_ANY,
+                                                                STATE_JOURNAL_PARTITION_LABEL);
+    TEST_ASSERT(partition != NULL);
+    
+    fake_flash_cut_after(-1);
+    TEST_ASSERT_ESP_OK(esp_partition_erase_range(partition, 0, partition->size));
+}
+
+/**
+ * @brief Серия записей до отключения питания
+ * 
+ * @return Число подтвержденных записей
+ */
+static uint32_t journal_write_series(int64_t cut_after)
+{
+    journal_erase_all();
+    fake_flash_cut_after(cut_after);
+    
+    uint64_t start = fake_flash_bytes_programmed();
+    uint32_t acked = 0;
+    
+    if (state_journal_init_partition(STATE_JOURNAL_PARTITION_LABEL) != ESP_OK) {
+        series_bytes = fake_flash_bytes_programmed() - start;
+        return 0;
+    }
+    
+    for (uint32_t i = 1; i <= JOURNAL_APPENDS; i++) {
+        window_mode_t mode;
+        uint8_t gap;
+        uint8_t angle;
+        journal_value(i, &mode, &gap, &angle);
+        
+        if (state_journal_append(mode, gap, angle) != ESP_OK) {
+            break;
+        }
+        acked = i;
+    }
+    
+    series_bytes = fake_flash_bytes_programmed() - start;
+    return acked;
+}
+
+/**
+ * @brief Проверка записи журнала с ожидаемым порядковым номером
+ */
+static void journal_check_entry(const state_journal_entry_t *entry, uint32_t index)
+{
+    window_mode_t mode;
+    uint8_t gap;
+    uint8_t angle;
+    journal_value(index, &mode, &gap, &angle);
+    
+    TEST_ASSERT_EQUAL(index, entry->sequence);
+    TEST_ASSERT_EQUAL(mode, entry->window_mode);
+    TEST_ASSERT_EQUAL(gap, entry->gap_percentage);
+    TEST_ASSERT_EQUAL(angle, entry->handle_angle);
+}
+
+/**
+ * @brief Отключение питания на каждом байте серии записей
+ */
+static void test_power_cut_at_every_byte(void)
+{
+    // Полная серия без отключения задает число точек отключения
+    TEST_ASSERT_EQUAL(JOURNAL_APPENDS, journal_write_series(-1));
+    uint64_t total = series_bytes;
+    
+    for (int64_t cut = 0; cut <= (int64_t)total; cut++) {
+        uint32_t acked = journal_write_series(cut);
+        
+        if (cut < (int64_t)total && !fake_flash_power_lost()) {
+            TEST_FAIL("отключение после %lld байтов не сработало", (long long)cut);
+        }
+        
+        // Перезапуск: питание восстановлено, журнал открывается заново
+        fake_flash_cut_after(-1);
+        TEST_ASSERT_ESP_OK(state_journal_init_partition(STATE_JOURNAL_PARTITION_LABEL));
+        
+        state_journal_entry_t entry;
+        esp_err_t err = state_journal_get_latest(&entry);
+        if (err == ESP_ERR_NOT_FOUND) {
+            if (acked != 0) {
+                TEST_FAIL("отключение после %lld байтов: потеряно %lu подтвержденных записей",
+                          (long long)cut, (unsigned long)acked);
+            }
+        } else {
+            TEST_ASSERT_ESP_OK(err);
+            if (entry.sequence != acked && entry.sequence != acked + 1) {
+                TEST_FAIL("отключение после %lld байтов: подтверждено %lu, восстановлена запись %lu",
+                          (long long)cut, (unsigned long)acked, (unsigned long)entry.sequence);
+            }
+            journal_check_entry(&entry, entry.sequence);
+        }
+        
+        // Журнал продолжает работу после восстановления
+        uint32_t next = (err == ESP_OK) ? entry.sequence + 1 : 1;
+        for (uint32_t i = next; i < next + JOURNAL_EXTRA_APPENDS; i++) {
+            window_mode_t mode;
+            uint8_t gap;
+            uint8_t angle;
+            journal_value(i, &mode, &gap, &angle);
+            TEST_ASSERT_ESP_OK(state_journal_append(mode, gap, angle));
+        }
+        
+        TEST_ASSERT_ESP_OK(state_journal_init_partition(STATE_JOURNAL_PARTITION_LABEL));
+        TEST_ASSERT_ESP_OK(state_journal_get_latest(&entry));
+        journal_check_entry(&entry, next + JOURNAL_EXTRA_APPENDS - 1);
+    }
+    
+    fprintf(stderr, "   проверено точек отключения: %llu\n", (unsigned long long)total + 1);
+}
+
+/**
+ * @brief Первый запуск: запись серии в файл раздела
+ */
+static void boot_write(void *arg)
+{
+    TEST_ASSERT_ESP_OK(fake_flash_attach(STATE_JOURNAL_PARTITION_LABEL, JOURNAL_FILE,
+                                         JOURNAL_SECTOR_SIZE * JOURNAL_SECTORS, JOURNAL_SECTOR_SIZE));
+    TEST_ASSERT_EQUAL(JOURNAL_APPENDS, journal_write_series(-1));
+}
+
+/**
+ * @brief Второй запуск: журнал читается из файла раздела
+ */
+static void boot_read(void *arg)
+{
+    TEST_ASSERT_ESP_OK(fake_flash_attach(STATE_JOURNAL_PARTITION_LABEL, JOURNAL_FILE,
+                                         JOURNAL_SECTOR_SIZE * JOURNAL_SECTORS, JOURNAL_SECTOR_SIZE));
+    TEST_ASSERT_ESP_OK(state_journal_init_partition(STATE_JOURNAL_PARTITION_LABEL));
+    
+    state_journal_entry_t entry;
+    TEST_ASSERT_ESP_OK(state_journal_get_latest(&entry));
+    journal_check_entry(&entry, JOURNAL_APPENDS);
+}
+
+/**
+ * @brief Журнал сохраняется между запусками
+ */
+static void test_survives_reboot(void)
+{
+    remove(JOURNAL_FILE);
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_write, NULL));
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_read, NULL));
+}
+
+int main(void)
+{
+    TEST_RUN(test_survives_reboot);
+    
+    remove(JOURNAL_FILE);
+    TEST_ASSERT_ESP_OK(fake_flash_attach(STATE_JOURNAL_PARTITION_LABEL, JOURNAL_FILE,
+                                         JOURNAL_SECTOR_SIZE * JOURNAL_SECTORS, JOURNAL_SECTOR_SIZE));
+    TEST_RUN(test_power_cut_at_every_byte);
+    
+    return 0;
+}
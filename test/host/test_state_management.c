@@ -0,0 +1,485 @@
+/**
+ * @file test_state_management.c
+ * @brief Сохранение состояния: запись NVS, перенос старых форматов и журнал
+ * 
+ * Каждый запуск устройства выполняется в отдельном процессе, NVS и раздел
+ * журнала сохраняются в файлах между запусками.
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include "host_test.h"
+#include "fake_host.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "nvs.h"
+#include "esp_timer.h"
+#include "esp_rom_crc.h"
+#include "state_management.h"
+#include "state_journal.h"
+
+#define NVS_FILE                "test_state_management_nvs.bin"
+#define JOURNAL_FILE            "test_state_management_journal.bin"
+#define JOURNAL_SECTOR_SIZE     4096
+#define JOURNAL_SECTORS         3
+
+// Раскладка записи состояния в NVS (state_record_t, версия 2)
+#define STATE_NAMESPACE         "window_state"
+#define STATE_KEY               "state"
+#define STATE_RECORD_SIZE       12
+#define STATE_RECORD_V1_SIZE    8
+#define STATE_OFFSET_VERSION    0
+#define STATE_OFFSET_GAP        2
+#define STATE_OFFSET_CRC        8
+#define STATE_FLAG_CALIBRATED   (1 << 0)
+
+// Серия команд для проверки отложенной записи
+#define PERSIST_SERIES_COUNT    20
+#define PERSIST_SERIES_STEP_MS  50      // Меньше паузы перед записью (2000 мс)
+#define PERSIST_WAIT_MS         2500
+
+// Запись журнала на медленной флеш
+#define FLASH_WRITE_DELAY_MS    100
+#define UPDATE_MAX_US           20000   // Допустимое время state_update_position(), мкс
+
+// Содержимое NVS перед загрузкой состояния
+typedef enum {
+    SEED_LEGACY_KEYS,           // Ключи "window_mode"/"gap_pct"/"calibrated"
+    SEED_LEGACY_H2_KEYS,        // Ключи прошивки esp32-h2: "mode"/"handle_pos"/"gap_pct"
+    SEED_RECORD_V1,             // Запись версии 1 без номера журнала
+    SEED_CORRUPT_CRC,           // Сохраненная запись с измененным байтом
+    SEED_NEWER_VERSION,         // Сохраненная запись с версией новее прошивки
+    SEED_TRUNCATED              // Сохраненная запись неполной длины
+} seed_t;
+
+/**
+ * @brief Подключение памяти устройства и загрузка состояния
+ */
+static void boot_start(void)
+{
+    TEST_ASSERT_ESP_OK(fake_nvs_attach(NVS_FILE));
+    TEST_ASSERT_ESP_OK(fake_flash_attach(STATE_JOURNAL_PARTITION_LABEL, JOURNAL_FILE,
+                                         JOURNAL_SECTOR_SIZE * JOURNAL_SECTORS, JOURNAL_SECTOR_SIZE));
+    TEST_ASSERT_ESP_OK(state_init());
+    TEST_ASSERT_ESP_OK(state_load());
+}
+
+/**
+ * @brief Загрузка состояния без раздела журнала (положение хранится только в NVS)
+ */
+static void boot_start_nvs_only(void)
+{
+    TEST_ASSERT_ESP_OK(fake_nvs_attach(NVS_FILE));
+    TEST_ASSERT_ESP_OK(state_init());
+    TEST_ASSERT_ESP_OK(state_load());
+}
+
+/**
+ * @brief Проверка загруженного положения
+ */
+static void boot_expect(window_mode_t mode, uint8_t gap_percentage)
+{
+    device_state_t state = state_get_current();
+    TEST_ASSERT_EQUAL(mode, state.window_mode);
+    TEST_ASSERT_EQUAL(gap_percentage, state.gap_percentage);
+}
+
+/**
+ * @brief Чтение записи состояния напрямую из NVS
+ * 
+ * @return Длина записи (0, если записи нет)
+ */
+static size_t nvs_read_record(uint8_t *record, size_t size)
+{
+    nvs_handle_t handle;
+    TEST_ASSERT_ESP_OK(nvs_open(STATE_NAMESPACE, NVS_READWRITE, &handle));
+    esp_err_t err = nvs_get_blob(handle, STATE_KEY, record, &size);
+    nvs_close(handle);
+    return err == ESP_OK ? size : 0;
+}
+
+/**
+ * @brief Запись байтов записи состояния напрямую в NVS
+ */
+static void nvs_write_record(const uint8_t *record, size_t size)
+{
+    nvs_handle_t handle;
+    TEST_ASSERT_ESP_OK(nvs_open(STATE_NAMESPACE, NVS_READWRITE, &handle));
+    TEST_ASSERT_ESP_OK(nvs_set_blob(handle, STATE_KEY, record, size));
+    TEST_ASSERT_ESP_OK(nvs_commit(handle));
+    nvs_close(handle);
+}
+
+/**
+ * @brief Запуск: сохранение открытого окна и калибровки в запись NVS
+ */
+static void boot_save_record(void *arg)
+{
+    boot_start_nvs_only();
+    TEST_ASSERT_ESP_OK(state_update_position(WINDOW_MODE_OPEN, 60));
+    TEST_ASSERT_ESP_OK(state_update_calibration(true));
+    TEST_ASSERT_ESP_OK(state_save());
+    
+    uint8_t record[STATE_RECORD_SIZE];
+    TEST_ASSERT_EQUAL(STATE_RECORD_SIZE, nvs_read_record(record, sizeof(record)));
+}
+
+/**
+ * @brief Запуск: подготовка содержимого NVS в формате, заданном seed_t
+ */
+static void boot_seed(void *arg)
+{
+    seed_t seed = *(const seed_t *)arg;
+    TEST_ASSERT_ESP_OK(fake_nvs_attach(NVS_FILE));
+    
+    nvs_handle_t handle;
+    TEST_ASSERT_ESP_OK(nvs_open(STATE_NAMESPACE, NVS_READWRITE, &handle));
+    
+    uint8_t record[STATE_RECORD_SIZE];
+    size_t size = 0;
+    if (seed >= SEED_CORRUPT_CRC) {
+        size = nvs_read_record(record, sizeof(record));
+        TEST_ASSERT_EQUAL(STATE_RECORD_SIZE, size);
+    }
+    
+    switch (seed) {
+        case SEED_LEGACY_KEYS:
+            TEST_ASSERT_ESP_OK(nvs_set_u8(handle, "window_mode", WINDOW_MODE_VENT));
+            TEST_ASSERT_ESP_OK(nvs_set_u8(handle, "gap_pct", 30));
+            TEST_ASSERT_ESP_OK(nvs_set_u8(handle, "calibrated", 1));
+            TEST_ASSERT_ESP_OK(nvs_set_u32(handle, "activity_time", 12345));
+            break;
+        case SEED_LEGACY_H2_KEYS:
+            TEST_ASSERT_ESP_OK(nvs_set_u8(handle, "mode", 3));     // Пользовательский режим
+            TEST_ASSERT_ESP_OK(nvs_set_u8(handle, "handle_pos", 1));
+            TEST_ASSERT_ESP_OK(nvs_set_u8(handle, "gap_pct", 55));
+            break;
+        case SEED_RECORD_V1: {
+            uint8_t v1[STATE_RECORD_V1_SIZE] = { 1, WINDOW_MODE_OPEN, 25, STATE_FLAG_CALIBRATED };
+            uint32_t crc = esp_rom_crc32_le(0, v1, 4);
+            memcpy(&v1[4], &crc, sizeof(crc));
+            TEST_ASSERT_ESP_OK(nvs_set_blob(handle, STATE_KEY, v1, sizeof(v1)));
+            break;
+        }
+        case SEED_CORRUPT_CRC:
+            record[STATE_OFFSET_GAP] ^= 0x01;
+            TEST_ASSERT_ESP_OK(nvs_set_blob(handle, STATE_KEY, record, size));
+            break;
+        case SEED_NEWER_VERSION: {
+            // CRC верный: запись отклоняется только по версии
+            record[STATE_OFFSET_VERSION] = 3;
+            uint32_t crc = esp_rom_crc32_le(0, record, STATE_OFFSET_CRC);
+            memcpy(&record[STATE_OFFSET_CRC], &crc, sizeof(crc));
+            TEST_ASSERT_ESP_OK(nvs_set_blob(handle, STATE_KEY, record, size));
+            break;
+        }
+        case SEED_TRUNCATED:
+            TEST_ASSERT_ESP_OK(nvs_set_blob(handle, STATE_KEY, record, 5));
+            break;
+    }
+    
+    TEST_ASSERT_ESP_OK(nvs_commit(handle));
+    nvs_close(handle);
+}
+
+/**
+ * @brief Запуск: перенесенное из старых ключей состояние и удаление старых ключей
+ */
+static void boot_expect_migrated(void *arg)
+{
+    const device_state_t *expected = arg;
+    boot_start_nvs_only();
+    
+    device_state_t state = state_get_current();
+    TEST_ASSERT_EQUAL(expected->window_mode, state.window_mode);
+    TEST_ASSERT_EQUAL(expected->gap_percentage, state.gap_percentage);
+    TEST_ASSERT_EQUAL(expected->calibrated, state.calibrated);
+    
+    // Запись текущего формата заменила старые ключи
+    uint8_t record[STATE_RECORD_SIZE];
+    TEST_ASSERT_EQUAL(STATE_RECORD_SIZE, nvs_read_record(record, sizeof(record)));
+    
+    static const char *legacy_keys[] = { "window_mode", "mode", "handle_pos", "gap_pct", "calibrated" };
+    nvs_handle_t handle;
+    TEST_ASSERT_ESP_OK(nvs_open(STATE_NAMESPACE, NVS_READONLY, &handle));
+    for (size_t i = 0; i < sizeof(legacy_keys) / sizeof(legacy_keys[0]); i++) {
+        uint8_t value;
+        TEST_ASSERT_EQUAL(ESP_ERR_NVS_NOT_FOUND, nvs_get_u8(handle, legacy_keys[i], &value));
+    }
+    nvs_close(handle);
+}
+
+/**
+ * @brief Запуск: загруженное состояние совпадает с ожидаемым
+ */
+static void boot_expect_state(void *arg)
+{
+    const device_state_t *expected = arg;
+    boot_start_nvs_only();
+    
+    device_state_t state = state_get_current();
+    TEST_ASSERT_EQUAL(expected->window_mode, state.window_mode);
+    TEST_ASSERT_EQUAL(expected->gap_percentage, state.gap_percentage);
+    TEST_ASSERT_EQUAL(expected->calibrated, state.calibrated);
+}
+
+/**
+ * @brief Перенос состояния из ключей старого формата и последующая загрузка записи
+ */
+static void test_migrate_legacy(seed_t seed, window_mode_t mode, uint8_t gap_percentage, bool calibrated)
+{
+    device_state_t expected = {
+        .window_mode = mode,
+        .gap_percentage = gap_percentage,
+        .calibrated = calibrated
+    };
+    
+    remove(NVS_FILE);
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_seed, &seed));
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_expect_migrated, &expected));
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_expect_state, &expected));
+}
+
+/**
+ * @brief Ключи основной прошивки
+ */
+static void test_migrate_legacy_keys(void)
+{
+    test_migrate_legacy(SEED_LEGACY_KEYS, WINDOW_MODE_VENT, 30, true);
+}
+
+/**
+ * @brief Ключи прошивки esp32-h2: пользовательский режим становится открытым окном
+ */
+static void test_migrate_legacy_h2_keys(void)
+{
+    test_migrate_legacy(SEED_LEGACY_H2_KEYS, WINDOW_MODE_OPEN, 55, false);
+}
+
+/**
+ * @brief Запись версии 1 приводится к текущей версии
+ */
+static void test_migrate_record_v1(void)
+{
+    seed_t seed = SEED_RECORD_V1;
+    device_state_t expected = {
+        .window_mode = WINDOW_MODE_OPEN,
+        .gap_percentage = 25,
+        .calibrated = true
+    };
+    
+    remove(NVS_FILE);
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_seed, &seed));
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_expect_state, &expected));
+}
+
+/**
+ * @brief Поврежденная запись отклоняется: окно закрыто и не откалибровано
+ */
+static void test_reject_record(seed_t seed)
+{
+    device_state_t saved = {
+        .window_mode = WINDOW_MODE_OPEN,
+        .gap_percentage = 60,
+        .calibrated = true
+    };
+    device_state_t rejected = {
+        .window_mode = WINDOW_MODE_CLOSED,
+        .gap_percentage = 0,
+        .calibrated = false
+    };
+    
+    remove(NVS_FILE);
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_save_record, NULL));
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_expect_state, &saved));
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_seed, &seed));
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_expect_state, &rejected));
+}
+
+/**
+ * @brief Запись с неверной CRC
+ */
+static void test_reject_corrupt_crc(void)
+{
+    test_reject_record(SEED_CORRUPT_CRC);
+}
+
+/**
+ * @brief Запись более новой версии (откат прошивки)
+ */
+static void test_reject_newer_version(void)
+{
+    test_reject_record(SEED_NEWER_VERSION);
+}
+
+/**
+ * @brief Запись неполной длины
+ */
+static void test_reject_truncated(void)
+{
+    test_reject_record(SEED_TRUNCATED);
+}
+
+/**
+ * @brief Запуск 1: положение в журнале, затем отказ флеш и сохранение в NVS
+ */
+static void boot_journal_then_nvs(void *arg)
+{
+    boot_start();
+    boot_expect(WINDOW_MODE_CLOSED, 0);
+    
+    TEST_ASSERT_ESP_OK(state_update_position(WINDOW_MODE_OPEN, 40));
+    TEST_ASSERT_ESP_OK(state_save());
+    
+    // Запись в журнал не удается, положение уходит в NVS; оно совпадает
+    // с загруженным, но журнал уже содержит более новое
+    fake_flash_cut_after(0);
+    TEST_ASSERT_ESP_OK(state_update_position(WINDOW_MODE_CLOSED, 0));
+    TEST_ASSERT_ESP_OK(state_save());
+}
+
+/**
+ * @brief Запуск 2: положение из NVS новее записи журнала
+ */
+static void boot_expect_nvs_then_journal(void *arg)
+{
+    boot_start();
+    boot_expect(WINDOW_MODE_CLOSED, 0);
+    
+    // Журнал снова доступен, новая запись новее записи NVS
+    TEST_ASSERT_ESP_OK(state_update_position(WINDOW_MODE_OPEN, 70));
+    TEST_ASSERT_ESP_OK(state_save());
+}
+
+/**
+ * @brief Запуск 3: положение из журнала новее записи NVS
+ */
+static void boot_expect_journal(void *arg)
+{
+    boot_start();
+    boot_expect(WINDOW_MODE_OPEN, 70);
+}
+
+/**
+ * @brief После отказа журнала побеждает более новая запись NVS
+ */
+static void test_newer_source_wins(void)
+{
+    remove(NVS_FILE);
+    remove(JOURNAL_FILE);
+    
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_journal_then_nvs, NULL));
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_expect_nvs_then_journal, NULL));
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_expect_journal, NULL));
+}
+
+/**
+ * @brief Запуск 1: серия изменений положения дает одну запись NVS
+ */
+static void boot_series_coalesced(void *arg)
+{
+    boot_start_nvs_only();
+    boot_expect(WINDOW_MODE_CLOSED, 0);
+    uint32_t writes = fake_nvs_key_write_count(STATE_NAMESPACE, STATE_KEY);
+    
+    for (int i = 1; i <= PERSIST_SERIES_COUNT; i++) {
+        TEST_ASSERT_ESP_OK(state_update_gap_percentage((uint8_t)i));
+        vTaskDelay(pdMS_TO_TICKS(PERSIST_SERIES_STEP_MS));
+    }
+    
+    // Изменения идут чаще паузы, запись еще не выполнялась
+    TEST_ASSERT_EQUAL(writes, fake_nvs_key_write_count(STATE_NAMESPACE, STATE_KEY));
+    
+    vTaskDelay(pdMS_TO_TICKS(PERSIST_WAIT_MS));
+    TEST_ASSERT_EQUAL(writes + 1, fake_nvs_key_write_count(STATE_NAMESPACE, STATE_KEY));
+    
+    // Без новых изменений повторной записи нет
+    vTaskDelay(pdMS_TO_TICKS(PERSIST_WAIT_MS));
+    TEST_ASSERT_EQUAL(writes + 1, fake_nvs_key_write_count(STATE_NAMESPACE, STATE_KEY));
+}
+
+/**
+ * @brief Запуск 2: после отключения питания загружается последнее положение серии
+ */
+static void boot_expect_series_end(void *arg)
+{
+    boot_start_nvs_only();
+    boot_expect(WINDOW_MODE_CLOSED, PERSIST_SERIES_COUNT);
+}
+
+/**
+ * @brief Отложенная запись объединяет серию изменений в одну фиксацию NVS
+ */
+static void test_debounced_persist(void)
+{
+    remove(NVS_FILE);
+    remove(JOURNAL_FILE);
+    
+    // Запуск завершается без state_save(), как при отключении питания
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_series_coalesced, NULL));
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_expect_series_end, NULL));
+}
+
+/**
+ * @brief Запуск: положение пишется в журнал без ожидания флеш вызывающей задачей
+ */
+static void boot_journal_off_caller(void *arg)
+{
+    state_journal_entry_t entry;
+    
+    boot_start();
+    boot_expect(WINDOW_MODE_CLOSED, 0);
+    fake_flash_set_write_delay_ms(FLASH_WRITE_DELAY_MS);
+    
+    // Серия положений, пока первая запись журнала еще выполняется
+    int64_t start_us = esp_timer_get_time();
+    TEST_ASSERT_ESP_OK(state_update_position(WINDOW_MODE_OPEN, 40));
+    TEST_ASSERT_ESP_OK(state_update_position(WINDOW_MODE_VENT, 50));
+    TEST_ASSERT_ESP_OK(state_update_position(WINDOW_MODE_OPEN, 60));
+    int64_t elapsed_us = esp_timer_get_time() - start_us;
+    printf("state_update_position: 3 вызова за %lld мкс при записи флеш %d мс\n",
+           (long long)elapsed_us, FLASH_WRITE_DELAY_MS);
+    TEST_ASSERT(elapsed_us < UPDATE_MAX_US);
+    
+    // state_save() дописывает положение, еще не записанное задачей
+    TEST_ASSERT_ESP_OK(state_save());
+    TEST_ASSERT_ESP_OK(state_journal_get_latest(&entry));
+    TEST_ASSERT_EQUAL(WINDOW_MODE_OPEN, entry.window_mode);
+    TEST_ASSERT_EQUAL(60, entry.gap_percentage);
+}
+
+/**
+ * @brief Запуск 2: последнее положение серии загружается из журнала
+ */
+static void boot_expect_journal_series_end(void *arg)
+{
+    boot_start();
+    boot_expect(WINDOW_MODE_OPEN, 60);
+}
+
+/**
+ * @brief Задача, обновляющая положение, не ждет записи журнала
+ */
+static void test_journal_off_caller(void)
+{
+    remove(NVS_FILE);
+    remove(JOURNAL_FILE);
+    
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_journal_off_caller, NULL));
+    TEST_ASSERT_EQUAL(0, fake_run_boot(boot_expect_journal_series_end, NULL));
+}
+
+int main(void)
+{
+    TEST_RUN(test_migrate_legacy_keys);
+    TEST_RUN(test_migrate_legacy_h2_keys);
+    TEST_RUN(test_migrate_record_v1);
+    TEST_RUN(test_reject_corrupt_crc);
+    TEST_RUN(test_reject_newer_version);
+    TEST_RUN(test_reject_truncated);
+    TEST_RUN(test_newer_source_wins);
+    TEST_RUN(test_debounced_persist);
+    TEST_RUN(test_journal_off_caller);
+    return 0;
+}